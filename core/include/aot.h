@@ -7,7 +7,11 @@
 // ============================================================================
 // AOT (Ahead-of-Time) Compiler for Sage
 //
-// Generates optimized C code with type specialization.
+// Generates optimized C code with type specialization: locals inferred as
+// INT / FLOAT / BOOL become int64_t / double / int C variables and are
+// boxed into a SageValue only where they escape (see aot.c). Strings,
+// arrays and dicts live on a mark-sweep heap whose roots are the globals
+// and the SageValue locals each generated function registers on entry.
 // Can work independently (whole-program compile) or with JIT
 // (AOT provides baseline, JIT reoptimizes hot paths).
 //
@@ -29,6 +33,27 @@ typedef struct {
     int capacity;
 } AotTypeEnv;
 
+// A C local of the function being emitted. Sage `let`s are function-scoped
+// (only `for` bodies open a scope), so locals are declared once at the top
+// of their function or for-loop block; the SageValue ones are GC roots.
+typedef struct {
+    char* name;
+    const char* ctype;
+    int declared;        // Declared by the emitter already (params, self, _iter)
+} AotLocal;
+
+typedef struct AotFrame {
+    AotLocal* locals;
+    int count;
+    int capacity;
+    int decl_line;       // Where the declarations are inserted
+    int decl_indent;
+    int is_function;     // C function (owns _gc_frame) rather than a for block
+    int is_main;
+    char* tag;           // Unique suffix for a for block's root array
+    struct AotFrame* outer;
+} AotFrame;
+
 // AOT compiler state
 typedef struct {
     char** lines;       // Output C source lines
@@ -43,6 +68,9 @@ typedef struct {
     char* procs[1024];   // Track defined proc names
     int proc_count;
     int builtin_count;   // Count of builtin procs registered in aot_init
+    AotFrame* frame;     // Innermost function or for block being emitted
+    AotFrame globals;    // Top-level SageValue globals (GC roots of main)
+    const struct SageProfile* profile;  // --profile-use data, NULL if none
 } AotCompiler;
 
 // Lifecycle
@@ -53,6 +81,12 @@ void aot_free(AotCompiler* aot);
 void aot_infer_types(AotCompiler* aot, Stmt* program);
 JitTypeTag aot_get_var_type(AotCompiler* aot, const char* name);
 void aot_set_var_type(AotCompiler* aot, const char* name, JitTypeTag type);
+JitTypeTag aot_infer_expr_type(AotCompiler* aot, Expr* expr);
+// Procs get their own type environment (also used by the LLVM backend);
+// aot_leave_scope() frees it and restores `outer`.
+AotTypeEnv aot_enter_scope(AotCompiler* aot, Token* params, int param_count, Stmt* body,
+                           const JitTypeTag* seeds);
+void aot_leave_scope(AotCompiler* aot, AotTypeEnv outer);
 
 // Compilation
 char* aot_compile_program(AotCompiler* aot, Stmt* program);
@@ -14,7 +14,7 @@ typedef struct {
     Token op;
     Expr* left;
     Expr* right;
-    int quickened;          // Flag for specialized execution
+    int quickened;          // Flag for specialized execution (set by typecheck or at runtime)
     int left_is_num;       // Cache: left operand was a number
     int right_is_num;      // Cache: right operand was a number
 } BinaryExpr;
@@ -47,6 +47,7 @@ typedef struct {
 typedef struct {
     Expr* array;
     Expr* index;
+    int quickened;          // Typecheck: array operand is an Array, index a Number
 } IndexExpr;
 
 // Index assignment: arr[i] = val, dict[key] = val
@@ -216,6 +217,7 @@ typedef struct {
     Token variable;
     Expr* iterable;
     Stmt* body;
+    int counted;            // Set by the loop pass: iterable is a call to the builtin range()
 } ForStmt;
 
 // Class definition: class Name(Parent): ...
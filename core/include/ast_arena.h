@@ -0,0 +1,76 @@
+// include/ast_arena.h
+// Per-compilation-unit arena for AST nodes, their arrays and identifier text
+//
+// The compile backends build one tree per run, rewrite it in the optimizer
+// passes and then throw all of it away. While an arena is active on the
+// calling thread, the ast.c constructors bump-allocate nodes from it, take
+// over the arrays and strings handed to them, and clone_token() interns
+// identifier text there, so a unit is laid out densely in parse order and
+// released by ast_arena_destroy() without walking the tree.
+//
+// With no arena active every helper falls back to the heap, which is what the
+// interpreter uses: its ASTs outlive any single parse (closures, modules).
+// free_expr()/free_stmt() go through ast_free(), which ignores arena memory,
+// so passes may keep calling them on arena-backed trees.
+
+#ifndef SAGE_AST_ARENA_H
+#define SAGE_AST_ARENA_H
+
+#include <stddef.h>
+
+typedef struct AstArena AstArena;
+
+AstArena* ast_arena_create(void);
+
+// Release every block at once. The arena must not be active anywhere.
+void ast_arena_destroy(AstArena* arena);
+
+// Make `arena` (or NULL for the heap) the calling thread's allocation target.
+// Returns the previous one so scopes nest.
+AstArena* ast_arena_activate(AstArena* arena);
+
+// Scoped use: create an arena and activate it; ast_arena_end() reactivates
+// whatever was active before and destroys the arena with the whole tree.
+AstArena* ast_arena_begin(void);
+void ast_arena_end(AstArena* arena);
+
+// Bytes handed out so far (for --timing style reporting).
+size_t ast_arena_bytes(const AstArena* arena);
+
+// Zeroed node storage from the active arena, else the heap.
+void* ast_alloc(size_t size);
+
+// Move a finished heap block of `size` bytes into the active arena (freeing
+// the original) and return the arena copy; returns `ptr` unchanged when no
+// arena is active.
+void* ast_adopt(void* ptr, size_t size);
+char* ast_adopt_string(char* str);
+
+// NUL-terminated copy of `length` bytes. Interned (one copy per distinct
+// string) when an arena is active.
+char* ast_strndup(const char* str, size_t length);
+
+// free() for AST memory; a no-op on blocks owned by a live arena.
+void ast_free(void* ptr);
+
+// Heap blocks the parser grows before handing them to a constructor
+// (argument lists, import names); tracked like nodes, see below.
+void* ast_malloc(size_t size);   // zeroed
+void* ast_realloc(void* ptr, size_t size);
+
+// A recovering parse (see parser.h) tracks every heap block the helpers above
+// hand out on this thread while it builds a statement, so a syntax error can
+// free the half-built tree instead of leaking it. ast_track_end() frees the
+// tracked blocks when `release` is set; otherwise they now belong to the
+// finished statement (or to the enclosing tracker, when tracks nest).
+typedef struct AstTrack {
+    void** slots;             // Open-addressed pointer set
+    size_t used;              // Live entries plus tombstones
+    size_t capacity;
+    struct AstTrack* outer;
+} AstTrack;
+
+void ast_track_begin(AstTrack* track);
+void ast_track_end(AstTrack* track, int release);
+
+#endif
@@ -100,7 +100,20 @@ typedef enum {
     BC_OP_GPU_RESET_FENCE,         // gpu.reset_fence(fence)
     BC_OP_GPU_UPDATE_UNIFORM,      // gpu.update_uniform(handle, data)
     BC_OP_GPU_CMD_PUSH_CONST,      // gpu.cmd_push_constants(cmd, layout, stages, data)
-    BC_OP_GPU_CMD_DISPATCH         // gpu.cmd_dispatch(cmd, gx, gy, gz)
+    BC_OP_GPU_CMD_DISPATCH,        // gpu.cmd_dispatch(cmd, gx, gy, gz)
+    // Counted range loops (loop pass)
+    BC_OP_RANGE_PREP,        // [start, end, step] -> normalized [counter, end, step]
+    BC_OP_RANGE_NEXT,        // [u16 exit] Push counter and advance it, or jump to exit when done
+    // Quickened ops, emitted where typecheck proved the operand types. Each
+    // checks its operand tags and rewrites itself to the generic op on a miss.
+    BC_OP_ADD_NUM,
+    BC_OP_SUB_NUM,
+    BC_OP_MUL_NUM,
+    BC_OP_LESS_NUM,
+    BC_OP_LESS_EQUAL_NUM,
+    BC_OP_GREATER_NUM,
+    BC_OP_GREATER_EQUAL_NUM,
+    BC_OP_GET_INDEX_ARR_NUM  // [array, number] -> element, nil when out of bounds
 } BytecodeOp;
 
 typedef enum {
@@ -121,6 +134,7 @@ typedef struct {
 
     int* lines;
     int* columns;
+    int code_borrowed;  // code/lines/columns point into a mapped artifact
 
     Value* constants;
     int constant_count;
@@ -135,6 +149,8 @@ typedef struct {
 
 void bytecode_chunk_init(BytecodeChunk* chunk);
 void bytecode_chunk_free(BytecodeChunk* chunk);
+// Compiles for immediate execution: the chunk may use quickened ops, so it
+// must not be written out as an artifact
 int bytecode_compile_statement(BytecodeChunk* chunk, Stmt* stmt, char* error, size_t error_size);
 int bytecode_compile_statement_mode(BytecodeChunk* chunk, Stmt* stmt, BytecodeCompileMode mode,
                                     char* error, size_t error_size);
@@ -148,4 +164,7 @@ int bytecode_compile_function_body(BytecodeChunk* chunk, Stmt* body,
                                    void* build_function_data,
                                    char* error, size_t error_size);
 
+// The generic op a quickened op falls back to (identity for generic ops)
+BytecodeOp bytecode_generic_op(BytecodeOp op);
+
 #endif
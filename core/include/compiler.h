@@ -6,6 +6,13 @@
 // Optimization levels: 0=none, 1=constfold, 2=+dce, 3=+inline
 // debug_info: 0=off, 1=emit #line directives
 
+// Executables are built one C unit per module: units compile in parallel
+// (g_compile_jobs, 0 = one per CPU) into a content-addressed object cache
+// (g_compile_cache_dir, NULL = $SAGE_CACHE_DIR/objects or
+// ~/.cache/sage/objects) and are then linked.
+extern int g_compile_jobs;
+extern const char* g_compile_cache_dir;
+
 int compile_source_to_c(const char* source, const char* input_path, const char* output_path);
 int compile_source_to_c_opt(const char* source, const char* input_path, const char* output_path,
                             int opt_level, int debug_info);
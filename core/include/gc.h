@@ -233,6 +233,7 @@ void gc_sweep(void);
 // GC pinning
 void gc_pin(void);
 void gc_unpin(void);
+int gc_collect_pending(void);   // Threshold reached (ignores pins)
 
 // Memory allocation
 void* gc_alloc(int type, size_t size);
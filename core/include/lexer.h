@@ -21,6 +21,11 @@ typedef struct {
     int bracket_depth;   // Tracks nesting of (), [], {} — suppresses INDENT/DEDENT/NEWLINE
 } LexerState;
 
+// Reentrant API: each LexerState is an independent tokenizer.
+void lexer_init(LexerState* lexer, const char* source, const char* filename);
+Token lexer_scan(LexerState* lexer);
+
+// Legacy API over a per-thread default LexerState.
 void init_lexer(const char* source, const char* filename);
 Token scan_token(void);
 LexerState lexer_get_state(void);
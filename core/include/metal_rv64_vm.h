@@ -136,6 +136,10 @@ extern "C" {
 #define RV64_TRY_STACK_SIZE  128   // Exception handler stack depth
 #endif
 
+#ifndef RV64_UOP_CACHE_SIZE
+#define RV64_UOP_CACHE_SIZE  8192  // Pre-decoded instruction slots, all chunks
+#endif
+
 // ============================================================================
 // Decoded Instruction
 // ============================================================================
@@ -154,6 +158,28 @@ typedef struct {
     int imm_j;          // J-type immediate (sign-extended)
 } RV64Instruction;
 
+// ============================================================================
+// Pre-decoded Instruction Cache
+// ============================================================================
+// metal_rv64_vm_run translates each basic block the first time it is reached
+// into micro-ops, one slot per instruction, with the opcode/funct3/funct7
+// dispatch already resolved and branch targets stored as slot indices.
+// Slots come from a static pool shared by all chunks; when it fills up the
+// whole cache is dropped and chunks are translated again as they run.
+//
+// Guest stores only reach the memory stack, never code, so a translation
+// stays valid until the host rewrites chunk bytes in place. A host that does
+// so must call metal_rv64_vm_invalidate.
+
+typedef struct {
+    const void* handler;    // Threaded handler address (GCC/Clang builds)
+    unsigned char kind;     // Micro-op kind (metal_rv64_vm.c)
+    unsigned char rd;
+    unsigned char rs1;
+    unsigned char rs2;
+    int imm;                // Immediate, shift amount or target slot
+} RV64MicroOp;
+
 // ============================================================================
 // VM State
 // ============================================================================
@@ -204,6 +230,11 @@ typedef struct {
     } try_stack[RV64_TRY_STACK_SIZE];
     int tsp;
 
+    // Pre-decoded instruction cache
+    RV64MicroOp uops[RV64_UOP_CACHE_SIZE];
+    int uop_used;
+    int chunk_uop_base[RV64_MAX_CHUNKS];   // -1 until the chunk is first run
+
     // Object pools (reuse MetalVM pools)
     MetalArray arrays[METAL_POOL_SIZE / 8];
     int array_count;
@@ -214,9 +245,14 @@ typedef struct {
     MetalFunction functions[256];
     int fn_count;
 
-    // String pool (bump allocator)
+    // String pool (bump allocator) and its hash index
     char strings[METAL_STRING_POOL];
     int string_used;
+    MetalStringIndex string_index;
+
+    // Bump heap for dict spill and index blocks
+    unsigned char heap[METAL_HEAP_SIZE];
+    int heap_used;
 
     // Status
     int halted;
@@ -248,6 +284,9 @@ int metal_rv64_vm_step(MetalRV64VM* vm);
 // Decode a 32-bit instruction word
 RV64Instruction rv64_decode(unsigned int raw);
 
+// Drop the pre-decoded code of one chunk, or of every chunk if chunk_idx < 0
+void metal_rv64_vm_invalidate(MetalRV64VM* vm, int chunk_idx);
+
 #ifdef __cplusplus
 }
 #endif
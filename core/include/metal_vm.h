@@ -157,6 +157,9 @@ typedef unsigned long long uint64_t;
 #ifndef METAL_HEAP_SIZE
 #define METAL_HEAP_SIZE       65536
 #endif
+#ifndef METAL_STRING_INDEX
+#define METAL_STRING_INDEX    4096    /* interned-string hash slots, power of two */
+#endif
 #ifndef METAL_CONST_POOL
 #define METAL_CONST_POOL      1024
 #endif
@@ -169,6 +172,12 @@ typedef unsigned long long uint64_t;
 #ifndef METAL_CALL_STACK_SIZE
 #define METAL_CALL_STACK_SIZE 256
 #endif
+#ifndef METAL_THREAD_CACHE
+#define METAL_THREAD_CACHE    4096    /* pre-decoded op slots, one per code byte */
+#endif
+#ifndef METAL_THREAD_REGIONS
+#define METAL_THREAD_REGIONS  8       /* code buffers with pre-decoded ops */
+#endif
 
 // ============================================================================
 // Value representation
@@ -225,15 +234,31 @@ typedef struct {
     int in_use;
 } MetalArray;
 
+// The first METAL_DICT_MAX_ENTRIES entries are stored inline; later ones
+// spill into the owning VM's bump heap. Once a dict holds
+// METAL_DICT_INDEX_MIN entries it also keeps an open-addressing index there.
+// Without heap space a dict stops growing (no index: it is searched linearly).
 #define METAL_DICT_MAX_ENTRIES 64
+#define METAL_DICT_INDEX_MIN   8
 
 typedef struct {
     int        key_str_idx[METAL_DICT_MAX_ENTRIES];
     MetalValue values[METAL_DICT_MAX_ENTRIES];
     int        count;
     int        in_use;
+    int        spill;        // heap offset of entries past the inline ones, -1 if none
+    int        spill_cap;
+    int        index;        // heap offset of the hash index, -1 if none
+    int        index_mask;   // index slots - 1
 } MetalDict;
 
+// Open-addressing index over a string pool. A slot holds str_idx + 1 (0 is
+// empty); once it is 3/4 full, new strings are found by scanning the pool.
+typedef struct {
+    int slots[METAL_STRING_INDEX];
+    int count;
+} MetalStringIndex;
+
 typedef struct {
     int  code_offset;
     int  code_length;
@@ -258,6 +283,18 @@ typedef struct {
     int        count;
 } MetalScope;
 
+// Pre-decoded form of the instruction at the same code offset. Operands are
+// resolved once: constants are bounds-checked indices, global names are
+// pre-hashed and jumps hold absolute offsets. Superinstructions cover
+// several source instructions and continue at `next`.
+typedef struct {
+    const void   *handler;   // computed-goto label in direct-threaded builds
+    int           a;         // constant index, name hash or jump target
+    int           b;         // constant index of a fused constant operand
+    int           next;      // code offset of the following instruction
+    unsigned char kind;
+} MetalThreadOp;
+
 // ============================================================================
 // VM struct
 // ============================================================================
@@ -296,12 +333,22 @@ typedef struct {
     MetalFunction functions[256];
     int fn_count;
 
-    char          strings[METAL_STRING_POOL];
-    int           string_used;
+    char             strings[METAL_STRING_POOL];
+    int              string_used;
+    MetalStringIndex string_index;
 
-    unsigned char heap[METAL_HEAP_SIZE];
+    unsigned char heap[METAL_HEAP_SIZE];   // dict spill and index blocks
     int           heap_used;
 
+    MetalThreadOp thread_ops[METAL_THREAD_CACHE];
+    int           thread_used;
+    struct {
+        const unsigned char *code;
+        int                  length;
+        int                  base;    // first slot in thread_ops
+    } thread_regions[METAL_THREAD_REGIONS];
+    int thread_region_count;
+
     MetalGenerator generators[METAL_GENERATOR_MAX];
     int            gen_count;
     int            current_gen_idx;  // -1 when not in generator exec
@@ -336,6 +383,8 @@ int        metal_vm_verify(MetalVM *vm);
 int        metal_vm_add_constant(MetalVM *vm, MetalValue value);
 int        metal_vm_run(MetalVM *vm);
 int        metal_vm_step(MetalVM *vm);
+// Drop pre-decoded ops; call after rewriting a loaded code buffer in place
+void       metal_vm_invalidate(MetalVM *vm);
 
 // Value constructors
 // Bare-metal (SAGE_BARE_METAL defined):
@@ -362,6 +411,22 @@ MetalValue metal_vm_peek(MetalVM *vm, int distance);
 int         metal_string_intern(MetalVM *vm, const char *s, int len);
 const char *metal_string_get(MetalVM *vm, int idx);
 
+// Pool primitives shared by MetalVM and MetalRV64VM. `heap` is the owning
+// VM's METAL_HEAP_SIZE bump heap; metal_dict_store returns 0 when the entry
+// was dropped because the heap is full.
+int         metal_pool_intern(char *strings, int *used, MetalStringIndex *index, const char *s, int len);
+void        metal_dict_reset(MetalDict *d);
+MetalValue  metal_dict_lookup(const MetalDict *d, const unsigned char *heap, int key_str_idx);
+int         metal_dict_store(MetalDict *d, unsigned char *heap, int *heap_used, int key_str_idx, MetalValue val);
+int         metal_dict_key_at(const MetalDict *d, const unsigned char *heap, int i);
+MetalValue  metal_dict_value_at(const MetalDict *d, const unsigned char *heap, int i);
+
+int        metal_dict_new(MetalVM *vm);
+void       metal_dict_set(MetalVM *vm, int dict_idx, int key_str_idx, MetalValue val);
+MetalValue metal_dict_get(MetalVM *vm, int dict_idx, int key_str_idx);
+// Mark from the stack, scopes and constants, sweep, then compact the heap
+void       metal_vm_gc(MetalVM *vm);
+
 int        metal_array_new(MetalVM *vm);
 void       metal_array_push(MetalVM *vm, int arr_idx, MetalValue val);
 MetalValue metal_array_get(MetalVM *vm, int arr_idx, int index);
@@ -24,6 +24,9 @@ typedef struct Module {
     Environment* env;        // Module's exported environment
     bool is_loaded;          // Whether module has been loaded
     bool is_loading;         // Circular dependency detection
+    bool ast_cached;         // AST came from the on-disk module cache
+    double read_ms;          // --timing: time spent reading the source
+    double parse_ms;         // --timing: time spent parsing or loading the AST
     struct Module* next;     // For module cache linked list
 } Module;
 
@@ -69,6 +72,11 @@ Module* load_module(ModuleCache* cache, const char* name);
 Module* find_module(ModuleCache* cache, const char* name);
 char* resolve_module_path(ModuleCache* cache, const char* name);
 
+// Import prefetch: parse the modules reachable through top-level imports on
+// the parallel pool before they are executed (SAGE_PREFETCH_IMPORTS=0 disables)
+void module_prefetch_source(ModuleCache* cache, const char* source, const char* filename);
+void module_prefetch_ast(ModuleCache* cache, Stmt* ast);
+
 // Module execution
 bool execute_module(Module* module, Environment* global_env);
 Value module_get_attr(Module* module, const char* name, int length, int* found);
@@ -86,6 +94,11 @@ Module* create_native_module(ModuleCache* cache, const char* name);
 Module* create_math_module(ModuleCache* cache);
 Module* create_io_module(ModuleCache* cache);
 Module* create_string_module(ModuleCache* cache);
+Module* create_json_module(ModuleCache* cache);
+Module* create_textindex_module(ModuleCache* cache);
+Module* create_vecindex_module(ModuleCache* cache);
+Module* create_kvcache_module(ModuleCache* cache);
+Module* create_bpe_module(ModuleCache* cache);
 Module* create_sys_module(ModuleCache* cache);
 Module* create_vm_module(ModuleCache* cache);
 Module* create_thread_module(ModuleCache* cache);
@@ -110,5 +123,9 @@ char* read_file(const char* path);
 
 extern Environment* g_global_env;  // Global environment for module loading
 
+// Per-import read/parse/exec timings, printed to stderr by --timing
+extern int g_module_timing;
+void module_timing_report(void);
+
 
 #endif
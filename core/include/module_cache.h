@@ -0,0 +1,35 @@
+// include/module_cache.h
+// Persistent on-disk cache of parsed module ASTs (pyc-style)
+//
+// Imports spend most of their time lexing and parsing, so the first load of
+// a module writes its AST to the user cache directory and later runs rebuild
+// the tree from that image instead of re-parsing. Tokens are stored as
+// offsets into the module source, which is still read so the AST can borrow
+// identifiers and line text from it exactly as a fresh parse would.
+//
+// Location: $SAGE_CACHE_DIR, else $XDG_CACHE_HOME/sage/modules, else
+// ~/.cache/sage/modules. Set SAGE_MODULE_CACHE=0 to disable it.
+//
+// An entry is reused only when the module path, the source size and content
+// hash, the interpreter version and the cache format all match; anything
+// else is treated as a miss and the entry is rewritten after the next parse.
+
+#ifndef SAGE_MODULE_CACHE_H
+#define SAGE_MODULE_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "ast.h"
+
+// Whether the cache is usable (enabled and a cache directory is known).
+bool module_cache_enabled(void);
+
+// Rebuild the AST cached for `path`. Returns NULL on a miss or a stale or
+// corrupt entry. Tokens in the returned tree point into `source`.
+Stmt* module_cache_load(const char* path, const char* source, size_t source_len);
+
+// Write the AST parsed from `source` for `path`. Best effort: failures are
+// silent and leave any existing entry untouched.
+bool module_cache_store(const char* path, const char* source, size_t source_len, Stmt* ast);
+
+#endif
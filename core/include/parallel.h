@@ -0,0 +1,52 @@
+// include/parallel.h
+// Data-parallel builtins backed by a persistent work-stealing thread pool
+//
+// parallel_map(fn, arr, chunk?)          -> new array of fn(x) for each x
+// parallel_for(start, end, fn, chunk?)   -> calls fn(i) for i in [start, end)
+// parallel_reduce(fn, arr, init, chunk?) -> folds arr with an associative fn
+//
+// The pool is started lazily on first use with one worker per core in the
+// caller's affinity mask (see thread_set_affinity); SAGE_PARALLEL_WORKERS
+// overrides the count. Work is split into blocks of `chunk` elements and
+// handed out by lazy binary splitting: idle workers steal the larger half
+// of another worker's range, so load balances without per-task threads.
+//
+// RP2040 (no threads): every builtin runs sequentially on the caller.
+
+#ifndef SAGE_PARALLEL_H
+#define SAGE_PARALLEL_H
+
+#include "value.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Set while the current thread executes a parallel task. Shared AST inline
+// caches are not written from tasks because several threads run the same
+// callback body at once.
+#ifdef SAGE_BARE_METAL
+extern int g_parallel_in_task;
+#else
+extern __thread int g_parallel_in_task;
+#endif
+#define PARALLEL_IN_TASK() (g_parallel_in_task)
+
+// Number of pool workers (starts the pool if needed).
+int parallel_worker_count(void);
+
+// Run fn(ctx, i) for i in [0, count) on the pool and wait for all of them.
+// For C work that does not touch the managed heap (e.g. parsing modules);
+// such tasks do not take part in collections.
+void parallel_run_native(long count, void (*fn)(void* ctx, long index), void* ctx);
+
+Value parallel_map_native(int argCount, Value* args);
+Value parallel_for_native(int argCount, Value* args);
+Value parallel_reduce_native(int argCount, Value* args);
+Value parallel_workers_native(int argCount, Value* args);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SAGE_PARALLEL_H
@@ -1,17 +1,46 @@
 #ifndef SAGE_PARSER_H
 #define SAGE_PARSER_H
 
+#include <stdbool.h>
 #include "ast.h"
+#include "lexer.h"
 #include "token.h"
 
 typedef struct {
     Token current_token;
     Token previous_token;
+    int depth;              // Recursion depth guard
+    char* pending_doc;      // ## comment waiting for its declaration
 } ParserState;
 
+// Legacy API: parses from the calling thread's default lexer (init_lexer).
 void parser_init(void);
 Stmt* parse(void);
 ParserState parser_get_state(void);
 void parser_set_state(ParserState state);
 
+// Reentrant parsing context. Each Parser owns its lexer and token window, so
+// several sources can be parsed concurrently on different threads, or
+// interleaved on one thread, without saving and restoring global state.
+//
+// With `recover` set, a syntax error makes parser_next() return NULL and sets
+// `failed` (plus the error_* fields) instead of printing a diagnostic and
+// exiting; callers that need the full report re-parse without recovery.
+#define PARSER_ERROR_MAX 160
+
+typedef struct {
+    LexerState lexer;
+    ParserState state;
+    bool recover;
+    bool started;
+    bool failed;
+    int error_line;                         // 1-based
+    int error_column;                       // 0-based, like Token.column
+    char error_message[PARSER_ERROR_MAX];
+} Parser;
+
+void parser_open(Parser* parser, const char* source, const char* filename, bool recover);
+Stmt* parser_next(Parser* parser);                    // Next top-level statement, NULL at end
+Stmt* parser_parse_all(Parser* parser, Stmt** tail);  // Remaining statements as a list
+
 #endif
@@ -12,6 +12,7 @@ typedef struct {
     int debug_info;         // emit debug info?
     int verbose;            // report pass activity?
     const char* input_path; // for diagnostics
+    const struct SageProfile* profile;  // --profile-use data, NULL if none
 } PassContext;
 
 // ============================================================================
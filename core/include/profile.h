@@ -0,0 +1,109 @@
+// include/profile.h
+// Profile-guided optimization: execution profiles recorded by the
+// interpreter and consumed by the compile backends
+//
+// `sage --profile-out=app.prof app.sage` runs the script in the AST
+// interpreter and writes what it observed; `--profile-use=app.prof` on
+// --compile, --compile-llvm and --aot reads it back:
+//
+//   func    per-procedure call counts plus argument/return type feedback
+//           (inlining budget, hot/cold function attributes, AOT parameter
+//           specialization behind a type guard)
+//   branch  taken / not-taken counts of `if` conditions (block layout)
+//   loop    entries and total iterations of `while` / `for` loops
+//   call    hits of each call site and, for method calls, the receiver
+//           class when it was always the same one (devirtualization)
+//
+// Sites are keyed by the source position of a token that survives the AST
+// passes (see profile_anchor()), so a profile only applies to the exact
+// source it was recorded from: the file stores a checksum of the script
+// and profile_use() rejects a profile whose checksum no longer matches.
+// Only the main script is profiled; imported modules are not.
+
+#ifndef SAGE_PROFILE_H
+#define SAGE_PROFILE_H
+
+#include <stdint.h>
+#include "ast.h"
+#include "jit.h"
+
+#define PROFILE_MAX_PARAMS  8
+#define PROFILE_HOT_CALLS   1000   // Calls that mark a procedure hot
+#define PROFILE_MIN_SAMPLES 16     // Branch outcomes needed before trusting a bias
+
+typedef enum {
+    PROFILE_FUNC,
+    PROFILE_BRANCH,
+    PROFILE_LOOP,
+    PROFILE_CALL,
+} ProfileSiteKind;
+
+typedef struct {
+    ProfileSiteKind kind;
+    int line;
+    int column;
+    int64_t count;        // calls / taken / entries / hits
+    int64_t other;        // -    / not taken / iterations / -
+    char* name;           // FUNC: procedure name; CALL: monomorphic receiver class
+    int polymorphic;      // CALL: more than one receiver class seen
+    int param_count;      // FUNC
+    JitTypeTag arg_types[PROFILE_MAX_PARAMS];
+    JitTypeTag return_type;
+} ProfileSite;
+
+typedef struct SageProfile {
+    char* source;         // Basename of the profiled script
+    uint64_t checksum;    // FNV-1a of the script text
+    ProfileSite* sites;
+    int count;
+    int capacity;
+    int* index;           // Open-addressing index over (kind, line, column)
+    int index_capacity;
+    const char* last_file;  // Token filename that last matched `source`
+    uintptr_t owner;        // Recording thread
+} SageProfile;
+
+typedef enum {
+    PROFILE_HEAT_UNKNOWN,
+    PROFILE_HEAT_COLD,    // Never executed in the profiled run
+    PROFILE_HEAT_WARM,
+    PROFILE_HEAT_HOT,
+} ProfileHeat;
+
+SageProfile* profile_new(const char* source_path, const char* source_text);
+void profile_free(SageProfile* profile);
+int profile_write(const SageProfile* profile, const char* path);
+SageProfile* profile_read(const char* path);
+
+// The token whose position keys the site of a condition or call target.
+const Token* profile_anchor(const Expr* expr);
+
+// --- Recording (interpreter) ---
+void interpreter_set_profile(SageProfile* profile);
+SageProfile* interpreter_get_profile(void);
+
+void profile_record_call(SageProfile* profile, const ProcStmt* proc, int argc, const Value* args);
+void profile_record_return(SageProfile* profile, const ProcStmt* proc, Value result);
+void profile_record_branch(SageProfile* profile, const Expr* condition, int taken);
+int profile_loop_enter(SageProfile* profile, const Token* anchor);
+void profile_loop_iterate(SageProfile* profile, int loop);
+void profile_record_site(SageProfile* profile, const Expr* callee, const char* class_name, int class_len);
+
+// --- Consumption (compilers) ---
+// profile_use() loads `path` for the compile of `source_text` and makes it
+// the active profile; it warns and returns 0 when the profile is stale.
+int profile_use(const char* path, const char* source_path, const char* source_text);
+const SageProfile* profile_active(void);
+
+const ProfileSite* profile_find(const SageProfile* profile, ProfileSiteKind kind, const Token* at);
+ProfileHeat profile_function_heat(const SageProfile* profile, const ProcStmt* proc);
+// +1 when `condition` was true in at least 90% of its evaluations, -1 when
+// it was false as often, 0 when unbiased or unknown.
+int profile_branch_bias(const SageProfile* profile, const Expr* condition);
+int profile_loop_bias(const SageProfile* profile, const Token* anchor);
+// Receiver class of a method call site that only ever saw one class.
+const char* profile_monomorphic_class(const SageProfile* profile, const Expr* callee);
+int64_t profile_site_hits(const SageProfile* profile, const Expr* callee);
+const char* profile_type_name(JitTypeTag tag);
+
+#endif
@@ -19,17 +19,30 @@ typedef struct BytecodeProgram {
     BytecodeFunction* functions;
     int function_count;
     int function_capacity;
+
+    // Binary artifacts are executed in place: chunk code and line tables
+    // borrow from this read-only mapping, released by bytecode_program_free.
+    void* mapping;
+    size_t mapping_size;
 } BytecodeProgram;
 
+typedef enum {
+    BYTECODE_ARTIFACT_BINARY,  // SAGEBC2: sectioned, checksummed, mmap-able
+    BYTECODE_ARTIFACT_TEXT     // SAGEBC1: legacy hex text (consumed by --sgvm/sgvmc)
+} BytecodeArtifactFormat;
+
 void bytecode_program_init(BytecodeProgram* program);
 void bytecode_program_free(BytecodeProgram* program);
 int bytecode_compile_program(BytecodeProgram* program, Stmt* statements, BytecodeCompileMode mode,
                              char* error, size_t error_size);
 int bytecode_program_write_file(const BytecodeProgram* program, const char* output_path,
                                 char* error, size_t error_size);
+int bytecode_program_write_text_file(const BytecodeProgram* program, const char* output_path,
+                                     char* error, size_t error_size);
+// Reads either artifact format; the binary format is detected by its magic.
 int bytecode_program_read_file(BytecodeProgram* program, const char* input_path,
                                char* error, size_t error_size);
 int compile_source_to_vm_artifact(const char* source, const char* input_path, const char* output_path,
-                                  int opt_level, int debug_info);
+                                  int opt_level, int debug_info, BytecodeArtifactFormat format);
 
 #endif
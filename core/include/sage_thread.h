@@ -71,6 +71,9 @@ int sage_thread_create(sage_thread_t* thread, void* (*start_routine)(void*), voi
 // Wait for a thread to finish. Returns 0 on success.
 int sage_thread_join(sage_thread_t thread, void** retval);
 
+// Release a thread's resources when it exits; it can no longer be joined.
+int sage_thread_detach(sage_thread_t thread);
+
 // Get current thread ID as a numeric value.
 uintptr_t sage_thread_id(void);
 
@@ -179,6 +182,11 @@ int sage_thread_set_affinity(int core_id);
 // Get the core the current thread is running on. Returns -1 on error.
 int sage_thread_get_core(void);
 
+// List the cores the current thread may run on (its affinity mask).
+// Writes up to max core ids into cores and returns how many were written.
+// Falls back to 0..sage_cpu_count()-1 where masks are unsupported.
+int sage_thread_get_affinity(int* cores, int max);
+
 // ============================================================================
 // Sleep API
 // ============================================================================
@@ -0,0 +1,134 @@
+// include/ssa.h
+// Typed SSA mid-level IR shared by the compile backends
+//
+// pass_ssa() runs inside run_passes() at -O2 and up. It builds one
+// SsaFunction per procedure body (plus one for the top-level script), runs
+// the SSA pass pipeline over it (copy propagation, SCCP, GVN, LICM) and
+// lowers the results back into the AST, so the C, LLVM, --emit-asm, SGVM and
+// Kotlin backends all compile the optimized tree without any per-backend
+// work.
+//
+// The IR models local scalar dataflow only: tracked variables are the
+// function's parameters and `let` locals (for the script: globals that no
+// procedure writes) that are never captured by a nested proc, never bound
+// by `for` and never written inside try/match/defer. Everything else --
+// calls, indexing, property access, untracked names -- is an opaque value.
+// Constructs the builder does not model (try, match, defer, yield) are
+// barriers: nothing inside them is rewritten.
+
+#ifndef SAGE_SSA_H
+#define SAGE_SSA_H
+
+#include <stdio.h>
+#include "ast.h"
+#include "pass.h"
+
+typedef enum {
+    SSA_TYPE_TOP,    // not yet known (optimistic)
+    SSA_TYPE_NUM,
+    SSA_TYPE_BOOL,
+    SSA_TYPE_STR,
+    SSA_TYPE_NIL,
+    SSA_TYPE_ANY     // could be anything, including instances
+} SsaType;
+
+typedef enum {
+    SSA_LAT_TOP,     // no executable definition seen yet
+    SSA_LAT_CONST,
+    SSA_LAT_BOTTOM   // varies at runtime
+} SsaLattice;
+
+typedef enum {
+    SSA_CONST,       // number, bool or nil literal (hash-consed)
+    SSA_STRING,      // string literal: typed, never folded
+    SSA_PARAM,       // procedure argument
+    SSA_OPAQUE,      // anything the IR does not model
+    SSA_BINARY,      // pure operator on args[0], args[1]
+    SSA_UNARY,       // not / ~ on args[0]
+    SSA_PHI
+} SsaOpcode;
+
+typedef struct {
+    SsaOpcode opcode;
+    TokenType op;        // SSA_BINARY / SSA_UNARY operator
+    int args[2];
+    int* phi_args;       // One per predecessor of `block`, in pred order
+    int phi_count;
+    int phi_var;         // Tracked variable the phi merges
+    int block;
+    int forward;         // Set by copy propagation: the value this one equals
+
+    // Analysis results (SSA_CONST values are born with them)
+    SsaType type;
+    SsaLattice lattice;
+    double number;       // Constant payload when lattice == SSA_LAT_CONST
+    int boolean;
+} SsaValue;
+
+typedef struct {
+    int* preds;
+    int* pred_slots;     // Which successor slot of preds[i] leads here
+    char* pred_live;     // Edge proven executable by SCCP
+    int pred_count;
+    int pred_capacity;
+    int* phis;
+    int phi_count;
+    int phi_capacity;
+    int cond;            // Branch value; -1 jumps unconditionally to succ[0]
+    int succ[2];         // [taken when cond is true, when false]
+    int executable;
+} SsaBlock;
+
+typedef struct SsaVar SsaVar;
+typedef struct SsaSite SsaSite;
+typedef struct SsaLoop SsaLoop;
+
+typedef struct {
+    int values;          // SSA values built
+    int constants;       // expressions replaced by a literal (SCCP)
+    int copies;          // phis removed and reads redirected (copy propagation)
+    int redundant;       // expressions replaced by an equal variable (GVN)
+    int hoisted;         // expressions moved in front of a loop (LICM)
+    int temporaries;     // `let __licmN` bindings introduced (also names them)
+} SsaStats;
+
+typedef struct {
+    Stmt* body;          // AST the function was built from (rewritten by ssa_lower)
+    SsaValue* values;
+    int value_count;
+    int value_capacity;
+    SsaBlock* blocks;
+    int block_count;
+    int block_capacity;
+
+    // Builder bookkeeping used by the passes and by lowering
+    SsaVar* vars;
+    int var_count;
+    SsaSite* sites;      // One per analysed expression, children first
+    int site_count;
+    int site_capacity;
+    SsaLoop* loops;
+    int loop_count;
+    int loop_capacity;
+    int* value_index;    // Hash-consing table for pure values
+    int value_index_count;
+    int value_index_capacity;
+} SsaFunction;
+
+// Build the IR for a procedure (STMT_PROC) or, with proc == NULL, for the
+// top-level statements of `program`.
+SsaFunction* ssa_build(Stmt* program, Stmt* proc);
+
+// Pass manager: copy propagation, SCCP, GVN and LICM, in that order.
+void ssa_optimize(SsaFunction* fn, SsaStats* stats);
+
+// Write the pass results back into fn->body.
+void ssa_lower(SsaFunction* fn, SsaStats* stats);
+
+void ssa_dump(const SsaFunction* fn, FILE* out);
+void ssa_free(SsaFunction* fn);
+
+// The run_passes() entry point.
+Stmt* pass_ssa(Stmt* program, PassContext* ctx);
+
+#endif
@@ -53,14 +53,16 @@ typedef enum {
     TOKEN_EOF, TOKEN_ERROR
 } TokenType;
 
+// Pointers first so the four ints pack without padding (40 bytes, not 48);
+// every AST node embeds at least one Token.
 typedef struct {
-    TokenType type;
     const char* start;
+    const char* line_start;
+    const char* filename;
+    TokenType type;
     int length;
     int line;
     int column;
-    const char* line_start;
-    const char* filename;
 } Token;
 
 #endif
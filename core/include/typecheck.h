@@ -40,10 +40,13 @@ typedef struct TypeEnv {
     struct TypeEnv* next;
 } TypeEnv;
 
+#define TYPE_FACT_BUCKETS 256
+
 typedef struct {
     TypeEntry* entries;
     TypeEnv* env;
     SageType current_return_type;
+    TypeEnv** facts;        // Per-name facts for typecheck_annotate (hashed)
 } TypeMap;
 
 void typemap_init(TypeMap* map);
@@ -56,4 +59,10 @@ SageType typeenv_get(TypeMap* map, const char* name);
 // Type checking pass
 Stmt* pass_typecheck(Stmt* program, PassContext* ctx);
 
+// Joins every binding of each name in `program` into `map` and marks the
+// binary and index expressions whose operand types are then proven, so the
+// interpreter and bytecode compiler pick quickened operations for them.
+// Facts accumulate across calls, for code that runs a statement at a time.
+void typecheck_annotate(TypeMap* map, Stmt* program);
+
 #endif
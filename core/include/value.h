@@ -98,6 +98,7 @@ typedef struct {
     void* ptr;      // Raw memory pointer
     size_t size;    // Allocated size (0 if external/unknown)
     int owned;      // Whether we should free this on cleanup
+    void (*finalize)(void* ptr); // Optional: called instead of free() when owned
 } PointerValue;
 
 // Phase 11: Thread handle
@@ -115,11 +116,19 @@ typedef struct {
 // Security: Global resource limit for I/O operations (100MB)
 #define SAGE_MAX_READ_SIZE (100 * 1024 * 1024)
 
+// Hosted POSIX targets can back bytes values with mmap() (io.mmap)
+#if !defined(PICO_BUILD) && !defined(SAGE_BARE_METAL) && (defined(__unix__) || defined(__APPLE__))
+#define SAGE_HAS_MMAP 1
+#else
+#define SAGE_HAS_MMAP 0
+#endif
+
 // Phase 1.8: Binary-safe byte buffer
 typedef struct {
     unsigned char* data;
     int length;
     int capacity;
+    int mapped;         // data is a read-only mmap() view (io.mmap); never resized
 } BytesValue;
 
 typedef enum {
@@ -262,6 +271,8 @@ Value val_string_take(char* value);
 Value val_string_take_len(char* value, int len);
 Value val_bytes(const unsigned char* data, int length);
 Value val_bytes_empty(int capacity);
+Value val_bytes_mapped(unsigned char* data, int length, size_t map_len);
+void bytes_unmap(BytesValue* b);
 void bytes_push(Value* bytes_val, unsigned char byte);
 Value val_native(NativeFn fn);
 Value val_function(void* proc, Env* closure); // ✅ CHANGED: Added closure parameter
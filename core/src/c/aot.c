@@ -1,5 +1,6 @@
 #include "aot.h"
 #include "gc.h"
+#include "profile.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -18,6 +19,7 @@ void aot_init(AotCompiler* aot, int opt_level) {
     memset(aot, 0, sizeof(AotCompiler));
     aot->opt_level = opt_level;
     aot->emit_guards = 0;
+    aot->profile = profile_active();
     aot->line_capacity = 10000;
     aot->lines = malloc(sizeof(char*) * aot->line_capacity);
     aot->proc_count = 0;
@@ -33,7 +35,7 @@ void aot_init(AotCompiler* aot, int opt_level) {
         "s_listdir", "s_shell_exec", "s_connect", "s_send", "s_recv", "s_close",
         "s_isdir", "s_exists", "s_writefile", "s_writebytes", "s_appendbytes", 
         "s_readbytes", "s_remove", "s_mkdir", "s_spawn", "s_string_count",
-        "s_string_repeat", "s_sendall", "s_gc_collect", "s_gc_disable",
+        "s_string_repeat", "s_sendall", "s_gc_collect", "s_gc_disable", "s_gc_enable",
         "s_io_readfile", "s_io_writefile", "s_io_writebytes", "s_io_appendbytes",
         "s_io_readbytes", "s_io_exists", "s_io_remove", "s_io_isdir", "s_io_mkdir",
         "s_io_listdir", "s_sys_getenv_native", "s_sys_exec", "s_exec"
@@ -49,6 +51,8 @@ void aot_free(AotCompiler* aot) {
     free(aot->lines);
     for (int i = 0; i < aot->type_env.count; i++) free(aot->type_env.vars[i].name);
     free(aot->type_env.vars);
+    for (int i = 0; i < aot->globals.count; i++) free(aot->globals.locals[i].name);
+    free(aot->globals.locals);
     memset(aot, 0, sizeof(AotCompiler));
 }
 
@@ -123,14 +127,74 @@ JitTypeTag aot_get_var_type(AotCompiler* aot, const char* name) {
     return JIT_TYPE_UNKNOWN;
 }
 
-static JitTypeTag aot_infer_expr_type(AotCompiler* aot, Expr* expr) {
+// Inference is flow-insensitive and per scope (the script, or one proc body):
+// a local's type is the join of every value assigned to it, iterated to a
+// fixpoint. Locals that end up INT/FLOAT/BOOL are emitted as native int64_t,
+// double and int C locals and only boxed into a SageValue where they escape
+// (calls, returns, containers, print). Parameters, catch variables and any
+// name a nested proc mentions stay boxed, so procs never see unboxed storage.
+//
+// INT means "integral and exactly representable": +, -, %, & | ^ and range()
+// indices stay INT, while * and / produce FLOAT so products that leave the
+// int64 range keep the interpreter's double semantics.
+
+// Not a JitTypeTag: "no typed assignment seen yet" while iterating.
+#define AOT_TYPE_PENDING ((JitTypeTag)-1)
+
+static int aot_is_numeric(JitTypeTag t) {
+    return t == JIT_TYPE_INT || t == JIT_TYPE_FLOAT;
+}
+
+static int aot_is_unboxed(JitTypeTag t) {
+    return t == JIT_TYPE_INT || t == JIT_TYPE_FLOAT || t == JIT_TYPE_BOOL;
+}
+
+static JitTypeTag aot_join_type(JitTypeTag a, JitTypeTag b) {
+    if (a == AOT_TYPE_PENDING) return b;
+    if (b == AOT_TYPE_PENDING || a == b) return a;
+    if (aot_is_numeric(a) && aot_is_numeric(b)) return JIT_TYPE_FLOAT;
+    return JIT_TYPE_UNKNOWN;
+}
+
+static int aot_name_is(Token name, const char* str) {
+    return name.length == (int)strlen(str) && memcmp(name.start, str, name.length) == 0;
+}
+
+static int aot_is_builtin_call(Expr* expr, const char* name, int argc) {
+    return expr->type == EXPR_CALL && expr->as.call.arg_count == argc &&
+           expr->as.call.callee && expr->as.call.callee->type == EXPR_VARIABLE &&
+           aot_name_is(expr->as.call.callee->as.variable.name, name);
+}
+
+static int aot_is_int_literal(Expr* expr, double* value) {
+    if (expr->type != EXPR_NUMBER) return 0;
+    double d = expr->as.number.value;
+    if (fabs(d) >= 9007199254740992.0 || d != floor(d)) return 0;  // 2^53
+    if (value) *value = d;
+    return 1;
+}
+
+
+// Type of the range() bound arguments when `iterable` is range(n) or
+// range(lo, hi) over integers -- the loops emitted as plain C for loops.
+static JitTypeTag aot_range_type(AotCompiler* aot, Expr* iterable) {
+    if (!iterable || iterable->type != EXPR_CALL) return JIT_TYPE_UNKNOWN;
+    if (!aot_is_builtin_call(iterable, "range", 1) && !aot_is_builtin_call(iterable, "range", 2))
+        return JIT_TYPE_UNKNOWN;
+    JitTypeTag result = JIT_TYPE_INT;
+    for (int i = 0; i < iterable->as.call.arg_count; i++) {
+        JitTypeTag t = aot_infer_expr_type(aot, iterable->as.call.args[i]);
+        if (t == AOT_TYPE_PENDING) result = AOT_TYPE_PENDING;
+        else if (t != JIT_TYPE_INT) return JIT_TYPE_UNKNOWN;
+    }
+    return result;
+}
+
+JitTypeTag aot_infer_expr_type(AotCompiler* aot, Expr* expr) {
     if (!expr) return JIT_TYPE_UNKNOWN;
     switch (expr->type) {
-        case EXPR_NUMBER: {
-            double d = expr->as.number.value;
-            if (d == (double)(int64_t)d) return JIT_TYPE_INT;
-            return JIT_TYPE_FLOAT;
-        }
+        case EXPR_NUMBER:
+            return aot_is_int_literal(expr, NULL) ? JIT_TYPE_INT : JIT_TYPE_FLOAT;
         case EXPR_STRING: return JIT_TYPE_STRING;
         case EXPR_BOOL:   return JIT_TYPE_BOOL;
         case EXPR_NIL:    return JIT_TYPE_NIL;
@@ -144,49 +208,378 @@ static JitTypeTag aot_infer_expr_type(AotCompiler* aot, Expr* expr) {
             name[len] = '\0';
             return aot_get_var_type(aot, name);
         }
+        case EXPR_CALL:
+            if (aot_is_builtin_call(expr, "len", 1)) return JIT_TYPE_INT;
+            if (aot_is_builtin_call(expr, "tonumber", 1)) return JIT_TYPE_FLOAT;
+            return JIT_TYPE_UNKNOWN;
         case EXPR_BINARY: {
+            int op = expr->as.binary.op.type;
+            if (op == TOKEN_NOT || op == TOKEN_AND || op == TOKEN_OR ||
+                op == TOKEN_EQ || op == TOKEN_NEQ || op == TOKEN_GT || op == TOKEN_LT ||
+                op == TOKEN_GTE || op == TOKEN_LTE)
+                return JIT_TYPE_BOOL;
+
             JitTypeTag left = aot_infer_expr_type(aot, expr->as.binary.left);
+            if (op == TOKEN_TILDE) return left == JIT_TYPE_INT || left == AOT_TYPE_PENDING ? left : JIT_TYPE_UNKNOWN;
             JitTypeTag right = aot_infer_expr_type(aot, expr->as.binary.right);
-            int op = expr->as.binary.op.type;
-            // Arithmetic on ints stays int
-            if (left == JIT_TYPE_INT && right == JIT_TYPE_INT) {
-                if (op == TOKEN_PLUS || op == TOKEN_MINUS || op == TOKEN_STAR || op == TOKEN_PERCENT)
-                    return JIT_TYPE_INT;
-                if (op == TOKEN_SLASH) return JIT_TYPE_FLOAT;
-                if (op == TOKEN_GT || op == TOKEN_LT || op == TOKEN_GTE || op == TOKEN_LTE ||
-                    op == TOKEN_EQ || op == TOKEN_NEQ)
-                    return JIT_TYPE_BOOL;
-            }
-            if ((left == JIT_TYPE_INT || left == JIT_TYPE_FLOAT) &&
-                (right == JIT_TYPE_INT || right == JIT_TYPE_FLOAT)) {
-                if (op == TOKEN_PLUS || op == TOKEN_MINUS || op == TOKEN_STAR || op == TOKEN_SLASH)
-                    return JIT_TYPE_FLOAT;
-            }
             if (left == JIT_TYPE_STRING && right == JIT_TYPE_STRING && op == TOKEN_PLUS)
                 return JIT_TYPE_STRING;
-            if (op == TOKEN_EQ || op == TOKEN_NEQ || op == TOKEN_GT || op == TOKEN_LT ||
-                op == TOKEN_GTE || op == TOKEN_LTE)
-                return JIT_TYPE_BOOL;
-            return JIT_TYPE_UNKNOWN;
+            if ((left != AOT_TYPE_PENDING && !aot_is_numeric(left)) ||
+                (right != AOT_TYPE_PENDING && !aot_is_numeric(right)))
+                return JIT_TYPE_UNKNOWN;
+
+            JitTypeTag both = left == AOT_TYPE_PENDING || right == AOT_TYPE_PENDING
+                              ? AOT_TYPE_PENDING
+                              : (left == JIT_TYPE_INT && right == JIT_TYPE_INT ? JIT_TYPE_INT : JIT_TYPE_FLOAT);
+            double divisor;
+            switch (op) {
+                case TOKEN_PLUS:
+                case TOKEN_MINUS:
+                    // Sums of ints can leave int64_t range; Sage numbers are doubles
+                case TOKEN_STAR:
+                case TOKEN_SLASH:
+                    return both == AOT_TYPE_PENDING ? both : JIT_TYPE_FLOAT;
+                case TOKEN_PERCENT:
+                    // C's % only where it cannot trap: a literal divisor other than 0 / -1
+                    if (both == JIT_TYPE_INT &&
+                        !(aot_is_int_literal(expr->as.binary.right, &divisor) && divisor != 0 && divisor != -1))
+                        return JIT_TYPE_FLOAT;
+                    return both;
+                case TOKEN_AMP:
+                case TOKEN_PIPE:
+                case TOKEN_CARET:
+                    return both == JIT_TYPE_FLOAT ? JIT_TYPE_UNKNOWN : both;
+                default:
+                    return JIT_TYPE_UNKNOWN;
+            }
         }
         default: return JIT_TYPE_UNKNOWN;
     }
 }
 
-void aot_infer_types(AotCompiler* aot, Stmt* program) {
-    for (Stmt* s = program; s; s = s->next) {
-        if (s->type == STMT_LET && s->as.let.initializer) {
-            JitTypeTag t = aot_infer_expr_type(aot, s->as.let.initializer);
+// --- Scope scan: locals, assignments and names captured by nested procs ---
+
+typedef struct {
+    char** names;
+    int count;
+    int capacity;
+} AotNameSet;
+
+typedef struct {
+    Token name;
+    Expr* value;        // Assigned value (NULL: `let x` without initializer)
+    Stmt* loop;         // STMT_FOR binding the name instead of a value
+} AotDef;
+
+typedef struct {
+    AotNameSet locals;      // params, lets, for and catch variables
+    AotNameSet mentions;    // names read or written, plus free names of nested procs
+    AotNameSet pinned;      // locals that must stay boxed
+    AotDef* defs;
+    int def_count;
+    int def_capacity;
+} AotScan;
+
+static int aot_names_find(const AotNameSet* set, const char* start, int length) {
+    for (int i = 0; i < set->count; i++) {
+        if ((int)strlen(set->names[i]) == length && memcmp(set->names[i], start, length) == 0) return i;
+    }
+    return -1;
+}
+
+static void aot_names_add(AotNameSet* set, const char* start, int length) {
+    if (aot_names_find(set, start, length) >= 0) return;
+    if (set->count >= set->capacity) {
+        set->capacity = set->capacity == 0 ? 16 : set->capacity * 2;
+        set->names = realloc(set->names, sizeof(char*) * set->capacity);
+    }
+    char* copy = malloc(length + 1);
+    memcpy(copy, start, length);
+    copy[length] = '\0';
+    set->names[set->count++] = copy;
+}
+
+static void aot_names_free(AotNameSet* set) {
+    for (int i = 0; i < set->count; i++) free(set->names[i]);
+    free(set->names);
+}
+
+static void aot_scan_free(AotScan* scan) {
+    aot_names_free(&scan->locals);
+    aot_names_free(&scan->mentions);
+    aot_names_free(&scan->pinned);
+    free(scan->defs);
+}
+
+static void aot_scan_def(AotScan* scan, Token name, Expr* value, Stmt* loop) {
+    if (scan->def_count >= scan->def_capacity) {
+        scan->def_capacity = scan->def_capacity == 0 ? 16 : scan->def_capacity * 2;
+        scan->defs = realloc(scan->defs, sizeof(AotDef) * scan->def_capacity);
+    }
+    AotDef* def = &scan->defs[scan->def_count++];
+    def->name = name;
+    def->value = value;
+    def->loop = loop;
+}
+
+static void aot_scan_local(AotScan* scan, Token name, int pinned) {
+    aot_names_add(&scan->locals, name.start, name.length);
+    aot_names_add(&scan->mentions, name.start, name.length);
+    if (pinned) aot_names_add(&scan->pinned, name.start, name.length);
+}
+
+static void aot_scan_stmts(AotScan* scan, Stmt* stmt);
+static void aot_scan_expr(AotScan* scan, Expr* expr);
+
+// A nested proc: everything it mentions but does not declare is captured.
+static void aot_scan_function(AotScan* scan, Token* params, int param_count, Expr** defaults, Stmt* body) {
+    AotScan inner;
+    memset(&inner, 0, sizeof(inner));
+    for (int i = 0; i < param_count; i++) {
+        aot_scan_local(&inner, params[i], 1);
+        if (defaults) aot_scan_expr(&inner, defaults[i]);
+    }
+    aot_scan_stmts(&inner, body);
+    for (int i = 0; i < inner.mentions.count; i++) {
+        const char* name = inner.mentions.names[i];
+        int len = (int)strlen(name);
+        if (aot_names_find(&inner.locals, name, len) >= 0) continue;
+        aot_names_add(&scan->mentions, name, len);
+        aot_names_add(&scan->pinned, name, len);
+    }
+    aot_scan_free(&inner);
+}
+
+static void aot_scan_expr(AotScan* scan, Expr* expr) {
+    if (!expr) return;
+    switch (expr->type) {
+        case EXPR_VARIABLE:
+            aot_names_add(&scan->mentions, expr->as.variable.name.start, expr->as.variable.name.length);
+            break;
+        case EXPR_BINARY:
+            aot_scan_expr(scan, expr->as.binary.left);
+            aot_scan_expr(scan, expr->as.binary.right);
+            break;
+        case EXPR_CALL:
+            aot_scan_expr(scan, expr->as.call.callee);
+            for (int i = 0; i < expr->as.call.arg_count; i++) aot_scan_expr(scan, expr->as.call.args[i]);
+            break;
+        case EXPR_ARRAY:
+            for (int i = 0; i < expr->as.array.count; i++) aot_scan_expr(scan, expr->as.array.elements[i]);
+            break;
+        case EXPR_TUPLE:
+            for (int i = 0; i < expr->as.tuple.count; i++) aot_scan_expr(scan, expr->as.tuple.elements[i]);
+            break;
+        case EXPR_DICT:
+            for (int i = 0; i < expr->as.dict.count; i++) aot_scan_expr(scan, expr->as.dict.values[i]);
+            break;
+        case EXPR_INDEX:
+            aot_scan_expr(scan, expr->as.index.array);
+            aot_scan_expr(scan, expr->as.index.index);
+            break;
+        case EXPR_INDEX_SET:
+            aot_scan_expr(scan, expr->as.index_set.array);
+            aot_scan_expr(scan, expr->as.index_set.index);
+            aot_scan_expr(scan, expr->as.index_set.value);
+            break;
+        case EXPR_SLICE:
+            aot_scan_expr(scan, expr->as.slice.array);
+            aot_scan_expr(scan, expr->as.slice.start);
+            aot_scan_expr(scan, expr->as.slice.end);
+            break;
+        case EXPR_GET:
+            aot_scan_expr(scan, expr->as.get.object);
+            break;
+        case EXPR_SET:
+            if (expr->as.set.object == NULL) {
+                aot_names_add(&scan->mentions, expr->as.set.property.start, expr->as.set.property.length);
+                aot_scan_def(scan, expr->as.set.property, expr->as.set.value, NULL);
+            } else {
+                aot_scan_expr(scan, expr->as.set.object);
+            }
+            aot_scan_expr(scan, expr->as.set.value);
+            break;
+        case EXPR_AWAIT:
+            aot_scan_expr(scan, expr->as.await.expression);
+            break;
+        case EXPR_COMPTIME:
+            aot_scan_expr(scan, expr->as.comptime.expression);
+            break;
+        case EXPR_PROC:
+            aot_scan_function(scan, expr->as.proc_expr.params, expr->as.proc_expr.param_count,
+                              NULL, expr->as.proc_expr.body);
+            break;
+        default:
+            break;
+    }
+}
+
+static void aot_scan_stmts(AotScan* scan, Stmt* stmt) {
+    for (; stmt; stmt = stmt->next) {
+        switch (stmt->type) {
+            case STMT_PRINT:
+                aot_scan_expr(scan, stmt->as.print.expression);
+                break;
+            case STMT_EXPRESSION:
+                aot_scan_expr(scan, stmt->as.expression);
+                break;
+            case STMT_LET:
+                aot_scan_local(scan, stmt->as.let.name, 0);
+                aot_scan_expr(scan, stmt->as.let.initializer);
+                aot_scan_def(scan, stmt->as.let.name, stmt->as.let.initializer, NULL);
+                break;
+            case STMT_IF:
+                aot_scan_expr(scan, stmt->as.if_stmt.condition);
+                aot_scan_stmts(scan, stmt->as.if_stmt.then_branch);
+                aot_scan_stmts(scan, stmt->as.if_stmt.else_branch);
+                break;
+            case STMT_BLOCK:
+                aot_scan_stmts(scan, stmt->as.block.statements);
+                break;
+            case STMT_WHILE:
+                aot_scan_expr(scan, stmt->as.while_stmt.condition);
+                aot_scan_stmts(scan, stmt->as.while_stmt.body);
+                break;
+            case STMT_FOR:
+                aot_scan_expr(scan, stmt->as.for_stmt.iterable);
+                aot_scan_local(scan, stmt->as.for_stmt.variable, 0);
+                aot_scan_def(scan, stmt->as.for_stmt.variable, NULL, stmt);
+                aot_scan_stmts(scan, stmt->as.for_stmt.body);
+                break;
+            case STMT_RETURN:
+                aot_scan_expr(scan, stmt->as.ret.value);
+                break;
+            case STMT_RAISE:
+                aot_scan_expr(scan, stmt->as.raise.exception);
+                break;
+            case STMT_YIELD:
+                aot_scan_expr(scan, stmt->as.yield_stmt.value);
+                break;
+            case STMT_PROC:
+                aot_scan_local(scan, stmt->as.proc.name, 1);
+                aot_scan_function(scan, stmt->as.proc.params, stmt->as.proc.param_count,
+                                  stmt->as.proc.defaults, stmt->as.proc.body);
+                break;
+            case STMT_ASYNC_PROC:
+                aot_scan_local(scan, stmt->as.async_proc.name, 1);
+                aot_scan_function(scan, stmt->as.async_proc.params, stmt->as.async_proc.param_count,
+                                  NULL, stmt->as.async_proc.body);
+                break;
+            case STMT_CLASS:
+                aot_scan_local(scan, stmt->as.class_stmt.name, 1);
+                for (Stmt* m = stmt->as.class_stmt.methods; m; m = m->next) {
+                    if (m->type == STMT_PROC) {
+                        aot_scan_function(scan, m->as.proc.params, m->as.proc.param_count,
+                                          m->as.proc.defaults, m->as.proc.body);
+                    }
+                }
+                break;
+            case STMT_MATCH:
+                aot_scan_expr(scan, stmt->as.match_stmt.value);
+                for (int i = 0; i < stmt->as.match_stmt.case_count; i++) {
+                    CaseClause* c = stmt->as.match_stmt.cases[i];
+                    aot_scan_expr(scan, c->pattern);
+                    aot_scan_expr(scan, c->guard);
+                    aot_scan_stmts(scan, c->body);
+                }
+                aot_scan_stmts(scan, stmt->as.match_stmt.default_case);
+                break;
+            case STMT_DEFER:
+                aot_scan_stmts(scan, stmt->as.defer.statement);
+                break;
+            case STMT_TRY:
+                aot_scan_stmts(scan, stmt->as.try_stmt.try_block);
+                for (int i = 0; i < stmt->as.try_stmt.catch_count; i++) {
+                    aot_scan_local(scan, stmt->as.try_stmt.catches[i]->exception_var, 1);
+                    aot_scan_stmts(scan, stmt->as.try_stmt.catches[i]->body);
+                }
+                aot_scan_stmts(scan, stmt->as.try_stmt.finally_block);
+                break;
+            case STMT_COMPTIME:
+                aot_scan_stmts(scan, stmt->as.comptime.body);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+static JitTypeTag aot_def_type(AotCompiler* aot, const AotDef* def) {
+    if (def->loop) return aot_range_type(aot, def->loop->as.for_stmt.iterable);
+    if (!def->value) return JIT_TYPE_NIL;
+    return aot_infer_expr_type(aot, def->value);
+}
+
+// Infer the locals of one scope into aot->type_env. `seeds` (NULL unless the
+// proc is being specialized) gives the types its entry guard proved for each
+// parameter; unseeded parameters stay boxed.
+static void aot_infer_scope(AotCompiler* aot, Token* params, int param_count, Stmt* body,
+                            const JitTypeTag* seeds) {
+    AotScan scan;
+    memset(&scan, 0, sizeof(scan));
+    for (int i = 0; i < param_count; i++)
+        aot_scan_local(&scan, params[i], !(seeds && aot_is_unboxed(seeds[i])));
+    aot_scan_stmts(&scan, body);
+
+    for (int i = 0; i < scan.locals.count; i++) {
+        const char* name = scan.locals.names[i];
+        int pinned = aot_names_find(&scan.pinned, name, (int)strlen(name)) >= 0;
+        aot_set_var_type(aot, name, pinned ? JIT_TYPE_UNKNOWN : AOT_TYPE_PENDING);
+    }
+    for (int i = 0; seeds && i < param_count; i++) {
+        if (!aot_is_unboxed(seeds[i])) continue;
+        char name[256];
+        int len = params[i].length < 255 ? params[i].length : 255;
+        memcpy(name, params[i].start, len);
+        name[len] = '\0';
+        if (aot_get_var_type(aot, name) == AOT_TYPE_PENDING) aot_set_var_type(aot, name, seeds[i]);
+    }
+
+    int changed = 1;
+    while (changed) {
+        changed = 0;
+        for (int i = 0; i < scan.def_count; i++) {
+            AotDef* def = &scan.defs[i];
+            // Writes to names this scope does not declare target globals
+            if (aot_names_find(&scan.locals, def->name.start, def->name.length) < 0) continue;
             char name[256];
-            int len = s->as.let.name.length;
-            if (len > 255) len = 255;
-            memcpy(name, s->as.let.name.start, len);
+            int len = def->name.length < 255 ? def->name.length : 255;
+            memcpy(name, def->name.start, len);
             name[len] = '\0';
-            aot_set_var_type(aot, name, t);
+            JitTypeTag current = aot_get_var_type(aot, name);
+            if (current == JIT_TYPE_UNKNOWN) continue;
+            JitTypeTag joined = aot_join_type(current, aot_def_type(aot, def));
+            if (joined != current) {
+                aot_set_var_type(aot, name, joined);
+                changed = 1;
+            }
         }
     }
+    for (int i = 0; i < aot->type_env.count; i++) {
+        if (aot->type_env.vars[i].inferred_type == AOT_TYPE_PENDING)
+            aot->type_env.vars[i].inferred_type = JIT_TYPE_UNKNOWN;
+    }
+    aot_scan_free(&scan);
 }
 
+void aot_infer_types(AotCompiler* aot, Stmt* program) {
+    aot_infer_scope(aot, NULL, 0, program, NULL);
+}
+
+// Procs get their own type environment; the script's is restored afterwards.
+AotTypeEnv aot_enter_scope(AotCompiler* aot, Token* params, int param_count, Stmt* body,
+                                  const JitTypeTag* seeds) {
+    AotTypeEnv outer = aot->type_env;
+    memset(&aot->type_env, 0, sizeof(AotTypeEnv));
+    aot_infer_scope(aot, params, param_count, body, seeds);
+    return outer;
+}
+
+void aot_leave_scope(AotCompiler* aot, AotTypeEnv outer) {
+    for (int i = 0; i < aot->type_env.count; i++) free(aot->type_env.vars[i].name);
+    free(aot->type_env.vars);
+    aot->type_env = outer;
+}
 // ============================================================================
 // C Code Generation — Type-Specialized
 // ============================================================================
@@ -245,9 +638,183 @@ static char* sanitize_var_name(AotCompiler* aot, const char* start, int len) {
     return name;
 }
 
+static char* aot_format(const char* fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    va_list ap_copy;
+    va_copy(ap_copy, ap);
+    int len = vsnprintf(NULL, 0, fmt, ap_copy);
+    va_end(ap_copy);
+    char* out = malloc(len + 1);
+    vsnprintf(out, len + 1, fmt, ap);
+    va_end(ap);
+    return out;
+}
+
+static JitTypeTag aot_token_type(AotCompiler* aot, Token name) {
+    char buf[256];
+    int len = name.length < 255 ? name.length : 255;
+    memcpy(buf, name.start, len);
+    buf[len] = '\0';
+    return aot_get_var_type(aot, buf);
+}
+
+static const char* aot_c_type(JitTypeTag t) {
+    switch (t) {
+        case JIT_TYPE_INT:   return "int64_t";
+        case JIT_TYPE_FLOAT: return "double";
+        case JIT_TYPE_BOOL:  return "int";
+        default:             return "SageValue";
+    }
+}
+
+// Wrap a native int64_t / double / int expression back into a SageValue.
+static char* aot_box(JitTypeTag t, char* native) {
+    char* boxed;
+    if (t == JIT_TYPE_BOOL) boxed = aot_format("sage_bool(%s)", native);
+    else if (t == JIT_TYPE_INT) boxed = aot_format("sage_number((double)%s)", native);
+    else boxed = aot_format("sage_number(%s)", native);
+    free(native);
+    return boxed;
+}
+
+static char* aot_convert(JitTypeTag from, JitTypeTag to, char* code) {
+    if (from == to) return code;
+    char* out;
+    if (to == JIT_TYPE_BOOL) out = aot_format("(%s != 0)", code);
+    else if (to == JIT_TYPE_FLOAT) out = aot_format("(double)%s", code);
+    else out = aot_format("(int64_t)%s", code);
+    free(code);
+    return out;
+}
+
+static char* aot_compile_boxed(AotCompiler* aot, Expr* expr);
+static char* aot_compile_native(AotCompiler* aot, Expr* expr, JitTypeTag want);
+
+// C truth value of `expr`, without a SageValue round trip when it is typed.
+static char* aot_compile_cond(AotCompiler* aot, Expr* expr) {
+    if (aot_is_unboxed(aot_infer_expr_type(aot, expr)))
+        return aot_compile_native(aot, expr, JIT_TYPE_BOOL);
+    char* boxed = aot_compile_expr(aot, expr);
+    char* cond = aot_format("sage_truthy(%s)", boxed);
+    free(boxed);
+    return cond;
+}
+
+static char* aot_compile_native_binary(AotCompiler* aot, Expr* expr, JitTypeTag own) {
+    int op = expr->as.binary.op.type;
+    Expr* left = expr->as.binary.left;
+    Expr* right = expr->as.binary.right;
+    char *a, *b, *out;
+
+    if (op == TOKEN_NOT) {
+        a = aot_compile_cond(aot, left);
+        out = aot_format("(!%s)", a);
+        free(a);
+        return out;
+    }
+    if (op == TOKEN_AND || op == TOKEN_OR) {
+        a = aot_compile_cond(aot, left);
+        b = aot_compile_cond(aot, right);
+        out = aot_format("(%s %s %s)", a, op == TOKEN_AND ? "&&" : "||", b);
+        free(a); free(b);
+        return out;
+    }
+    if (op == TOKEN_TILDE) {
+        a = aot_compile_native(aot, left, JIT_TYPE_INT);
+        out = aot_format("(~%s)", a);
+        free(a);
+        return out;
+    }
+
+    const char* cop = NULL;
+    switch (op) {
+        case TOKEN_PLUS:    cop = "+"; break;
+        case TOKEN_MINUS:   cop = "-"; break;
+        case TOKEN_STAR:    cop = "*"; break;
+        case TOKEN_SLASH:   cop = "/"; break;
+        case TOKEN_PERCENT: cop = "%"; break;
+        case TOKEN_AMP:     cop = "&"; break;
+        case TOKEN_PIPE:    cop = "|"; break;
+        case TOKEN_CARET:   cop = "^"; break;
+        case TOKEN_EQ:      cop = "=="; break;
+        case TOKEN_NEQ:     cop = "!="; break;
+        case TOKEN_LT:      cop = "<"; break;
+        case TOKEN_GT:      cop = ">"; break;
+        case TOKEN_LTE:     cop = "<="; break;
+        case TOKEN_GTE:     cop = ">="; break;
+        default: return NULL;
+    }
+
+    // Operands are converted to the type the operation is carried out in
+    JitTypeTag operand = own;
+    if (own == JIT_TYPE_BOOL) {
+        JitTypeTag lt = aot_infer_expr_type(aot, left);
+        JitTypeTag rt = aot_infer_expr_type(aot, right);
+        if (aot_is_numeric(lt) && aot_is_numeric(rt)) {
+            operand = lt == JIT_TYPE_INT && rt == JIT_TYPE_INT ? JIT_TYPE_INT : JIT_TYPE_FLOAT;
+        } else if (!(lt == JIT_TYPE_BOOL && rt == JIT_TYPE_BOOL && (op == TOKEN_EQ || op == TOKEN_NEQ))) {
+            return NULL;  // Mixed or boxed operands: generic comparison
+        }
+    }
+    a = aot_compile_native(aot, left, operand);
+    b = aot_compile_native(aot, right, operand);
+    if (op == TOKEN_PERCENT && own == JIT_TYPE_FLOAT) out = aot_format("fmod(%s, %s)", a, b);
+    else out = aot_format("(%s %s %s)", a, cop, b);
+    free(a); free(b);
+    return out;
+}
+
+// `expr` (inferred INT, FLOAT or BOOL) as an int64_t / double / int C
+// expression, converted to `want`.
+static char* aot_compile_native(AotCompiler* aot, Expr* expr, JitTypeTag want) {
+    JitTypeTag own = aot_infer_expr_type(aot, expr);
+    char* code = NULL;
+    switch (expr->type) {
+        case EXPR_NUMBER:
+            if (own == JIT_TYPE_INT) code = aot_format("INT64_C(%lld)", (long long)expr->as.number.value);
+            else code = aot_format("%.17g", expr->as.number.value);
+            break;
+        case EXPR_BOOL:
+            code = strdup(expr->as.boolean.value ? "1" : "0");
+            break;
+        case EXPR_VARIABLE:
+            code = sanitize_var_name(aot, expr->as.variable.name.start, expr->as.variable.name.length);
+            break;
+        case EXPR_CALL: {
+            char* arg = aot_compile_expr(aot, expr->as.call.args[0]);
+            if (aot_is_builtin_call(expr, "len", 1)) code = aot_format("(int64_t)sage_len(%s).as.number", arg);
+            else code = aot_format("sage_tonumber(%s).as.number", arg);
+            free(arg);
+            break;
+        }
+        case EXPR_BINARY:
+            code = aot_compile_native_binary(aot, expr, own);
+            break;
+        default:
+            break;
+    }
+    if (!code) {
+        // Typed, but only the generic runtime implements it: unbox the result
+        char* boxed = aot_compile_boxed(aot, expr);
+        if (own == JIT_TYPE_BOOL) code = aot_format("sage_truthy(%s)", boxed);
+        else if (own == JIT_TYPE_INT) code = aot_format("(int64_t)%s.as.number", boxed);
+        else code = aot_format("%s.as.number", boxed);
+        free(boxed);
+    }
+    return aot_convert(own, want, code);
+}
+
 char* aot_compile_expr(AotCompiler* aot, Expr* expr) {
     if (!expr) return strdup("sage_nil()");
+    if (expr->type == EXPR_VARIABLE || expr->type == EXPR_BINARY) {
+        JitTypeTag t = aot_infer_expr_type(aot, expr);
+        if (aot_is_unboxed(t)) return aot_box(t, aot_compile_native(aot, expr, t));
+    }
+    return aot_compile_boxed(aot, expr);
+}
 
+static char* aot_compile_boxed(AotCompiler* aot, Expr* expr) {
     switch (expr->type) {
         case EXPR_NUMBER: {
             char buf[64];
@@ -296,25 +863,8 @@ char* aot_compile_expr(AotCompiler* aot, Expr* expr) {
             char* result = malloc(sz);
 
             int op = expr->as.binary.op.type;
-            // Type-specialized fast paths
-            if (lt == JIT_TYPE_INT && rt == JIT_TYPE_INT) {
-                const char* cop = NULL;
-                switch (op) {
-                    case TOKEN_PLUS:  cop = "+"; break;
-                    case TOKEN_MINUS: cop = "-"; break;
-                    case TOKEN_STAR:  cop = "*"; break;
-                    case TOKEN_GT:  snprintf(result, sz, "sage_bool(%s.as.number > %s.as.number)", left, right); goto done;
-                    case TOKEN_LT:  snprintf(result, sz, "sage_bool(%s.as.number < %s.as.number)", left, right); goto done;
-                    case TOKEN_EQ:  snprintf(result, sz, "sage_bool(%s.as.number == %s.as.number)", left, right); goto done;
-                    case TOKEN_NEQ: snprintf(result, sz, "sage_bool(%s.as.number != %s.as.number)", left, right); goto done;
-                    case TOKEN_PERCENT: snprintf(result, sz, "sage_number(fmod(%s.as.number, %s.as.number))", left, right); goto done;
-                    default: break;
-                }
-                if (cop) {
-                    snprintf(result, sz, "sage_number(%s.as.number %s %s.as.number)", left, cop, right);
-                    goto done;
-                }
-            }
+            // Typed numeric and boolean operators are compiled by
+            // aot_compile_native(); what is left is dynamic.
             if (lt == JIT_TYPE_STRING && rt == JIT_TYPE_STRING && op == TOKEN_PLUS) {
                 snprintf(result, sz, "sage_strcat(%s, %s)", left, right);
                 goto done;
@@ -452,6 +1002,15 @@ char* aot_compile_expr(AotCompiler* aot, Expr* expr) {
         case EXPR_SET: {
             // Variable assignment: name = value
             if (expr->as.set.object == NULL && expr->as.set.property.start) {
+                JitTypeTag t = aot_token_type(aot, expr->as.set.property);
+                if (aot_is_unboxed(t)) {
+                    char* name = sanitize_var_name(aot, expr->as.set.property.start, expr->as.set.property.length);
+                    char* val = aot_compile_native(aot, expr->as.set.value, t);
+                    char* assign = aot_format("(%s = %s)", name, val);
+                    free(name);
+                    free(val);
+                    return aot_box(t, assign);
+                }
                 char* name = sanitize_name(expr->as.set.property.start, expr->as.set.property.length);
                 char* val = aot_compile_expr(aot, expr->as.set.value);
                 char* buf = malloc(strlen(name) + strlen(val) + 16);
@@ -642,8 +1201,254 @@ char* aot_compile_expr(AotCompiler* aot, Expr* expr) {
     }
 }
 
+// ============================================================================
+// Frames — hoisted locals and GC roots
+// ============================================================================
+
+static AotLocal* aot_frame_find(AotFrame* frame, const char* name) {
+    for (int i = 0; i < frame->count; i++) {
+        if (strcmp(frame->locals[i].name, name) == 0) return &frame->locals[i];
+    }
+    return NULL;
+}
+
+static void aot_frame_add(AotFrame* frame, const char* name, const char* ctype, int declared) {
+    if (aot_frame_find(frame, name)) return;
+    if (frame->count >= frame->capacity) {
+        frame->capacity = frame->capacity ? frame->capacity * 2 : 8;
+        frame->locals = realloc(frame->locals, sizeof(AotLocal) * frame->capacity);
+    }
+    AotLocal* local = &frame->locals[frame->count++];
+    local->name = strdup(name);
+    local->ctype = ctype;
+    local->declared = declared;
+}
+
+static void aot_frame_free(AotFrame* frame) {
+    for (int i = 0; i < frame->count; i++) free(frame->locals[i].name);
+    free(frame->locals);
+    free(frame->tag);
+    memset(frame, 0, sizeof(*frame));
+}
+
+// Open a function body or for block at the current output position. Its
+// declarations are inserted there by aot_frame_close(), once every local
+// the body binds is known.
+static void aot_frame_open(AotCompiler* aot, AotFrame* frame, int is_function) {
+    memset(frame, 0, sizeof(*frame));
+    frame->decl_line = aot->line_count;
+    frame->decl_indent = aot->indent;
+    frame->is_function = is_function;
+    frame->tag = is_function ? NULL : aot_temp(aot);
+    frame->outer = aot->frame;
+    aot->frame = frame;
+}
+
+static AotFrame* aot_function_frame(AotCompiler* aot) {
+    AotFrame* frame = aot->frame;
+    while (frame && !frame->is_function) frame = frame->outer;
+    return frame;
+}
+
+static void aot_insert_line(AotCompiler* aot, int at, int indent, char* text) {
+    char* line = aot_format("%*s%s", indent * 4, "", text);
+    free(text);
+    if (aot->line_count >= aot->line_capacity) {
+        aot->line_capacity = aot->line_capacity ? aot->line_capacity * 2 : 256;
+        aot->lines = realloc(aot->lines, sizeof(char*) * aot->line_capacity);
+    }
+    memmove(&aot->lines[at + 1], &aot->lines[at], sizeof(char*) * (aot->line_count - at));
+    aot->lines[at] = line;
+    aot->line_count++;
+}
+
+// Declare the frame's locals, register its SageValue ones as GC roots, and
+// (for a for block) unregister them at the current position.
+static void aot_frame_close(AotCompiler* aot) {
+    static const char* ctypes[] = { "SageValue", "int64_t", "double", "int" };
+    AotFrame* frame = aot->frame;
+    aot->frame = frame->outer;
+    int at = frame->decl_line;
+
+    for (int k = 0; k < 4; k++) {
+        char* decl = NULL;
+        for (int i = 0; i < frame->count; i++) {
+            AotLocal* local = &frame->locals[i];
+            if (local->declared || strcmp(local->ctype, ctypes[k]) != 0) continue;
+            char* next = aot_format("%s%s%s = %s", decl ? decl : ctypes[k], decl ? ", " : " ",
+                                    local->name, k == 0 ? "sage_nil()" : "0");
+            free(decl);
+            decl = next;
+        }
+        if (decl) aot_insert_line(aot, at++, frame->decl_indent, aot_format("%s;", decl));
+        free(decl);
+    }
+
+    char* roots = strdup("");
+    int root_count = 0;
+    for (int i = 0; i < frame->count; i++) {
+        if (strcmp(frame->locals[i].ctype, "SageValue") != 0) continue;
+        char* next = aot_format("%s%s&%s", roots, root_count ? ", " : "", frame->locals[i].name);
+        free(roots);
+        roots = next;
+        root_count++;
+    }
+    if (frame->is_function) {
+        if (root_count > 0) {
+            aot_insert_line(aot, at, frame->decl_indent,
+                            aot_format("SageValue* _gc_roots[] = { %s }; SageGcFrame _gc_frame; sage_gc_enter(&_gc_frame, _gc_roots, %d);",
+                                       roots, root_count));
+        } else {
+            aot_insert_line(aot, at, frame->decl_indent, strdup("SageGcFrame _gc_frame; sage_gc_enter(&_gc_frame, NULL, 0);"));
+        }
+    } else if (root_count > 0) {
+        aot_insert_line(aot, at, frame->decl_indent,
+                        aot_format("SageValue* _gc_roots_%s[] = { %s }; SageGcFrame _gc_block_%s; sage_gc_enter(&_gc_block_%s, _gc_roots_%s, %d);",
+                                   frame->tag, roots, frame->tag, frame->tag, frame->tag, root_count));
+        aot_emit(aot, "sage_gc_leave(&_gc_block_%s);", frame->tag);
+    }
+    free(roots);
+    aot_frame_free(frame);
+}
+
+// `let` binds in the innermost function or for block. At the top level of
+// main() the forward-declared globals are assigned instead.
+static void aot_declare_local(AotCompiler* aot, const char* name, JitTypeTag type) {
+    AotFrame* frame = aot->frame;
+    if (!frame) return;
+    if (frame->is_main && aot_frame_find(&aot->globals, name)) return;
+    aot_frame_add(frame, name, aot_c_type(type), 0);
+}
+
+// Whether evaluating expr can allocate on the GC heap (conservatively: any
+// call may). Statements that cannot skip the SAGE_GC_STMT() temp reset, so
+// typed loops stay free of runtime bookkeeping.
+static int aot_expr_allocates(AotCompiler* aot, Expr* expr) {
+    if (!expr) return 0;
+    switch (expr->type) {
+        case EXPR_NUMBER:
+        case EXPR_STRING:
+        case EXPR_BOOL:
+        case EXPR_NIL:
+        case EXPR_VARIABLE:
+            return 0;
+        case EXPR_BINARY:
+            if (expr->as.binary.op.type == TOKEN_PLUS && !aot_is_numeric(aot_infer_expr_type(aot, expr)))
+                return 1;
+            return aot_expr_allocates(aot, expr->as.binary.left) || aot_expr_allocates(aot, expr->as.binary.right);
+        case EXPR_SET:
+            return expr->as.set.object != NULL || aot_expr_allocates(aot, expr->as.set.value);
+        case EXPR_INDEX:
+            return aot_expr_allocates(aot, expr->as.index.array) || aot_expr_allocates(aot, expr->as.index.index);
+        case EXPR_GET:
+            return aot_expr_allocates(aot, expr->as.get.object);
+        case EXPR_AWAIT:
+            return aot_expr_allocates(aot, expr->as.await.expression);
+        case EXPR_COMPTIME:
+            return aot_expr_allocates(aot, expr->as.comptime.expression);
+        default:
+            return 1;
+    }
+}
+
+static int aot_stmt_allocates(AotCompiler* aot, Stmt* stmt) {
+    switch (stmt->type) {
+        case STMT_PRINT:      return aot_expr_allocates(aot, stmt->as.print.expression);
+        case STMT_LET:        return aot_expr_allocates(aot, stmt->as.let.initializer);
+        case STMT_EXPRESSION: return aot_expr_allocates(aot, stmt->as.expression);
+        case STMT_IF:         return aot_expr_allocates(aot, stmt->as.if_stmt.condition);
+        case STMT_FOR:        return aot_expr_allocates(aot, stmt->as.for_stmt.iterable);
+        case STMT_RAISE:      return aot_expr_allocates(aot, stmt->as.raise.exception);
+        case STMT_MATCH: {
+            if (aot_expr_allocates(aot, stmt->as.match_stmt.value)) return 1;
+            for (int i = 0; i < stmt->as.match_stmt.case_count; i++) {
+                if (aot_expr_allocates(aot, stmt->as.match_stmt.cases[i]->pattern)) return 1;
+            }
+            return 0;
+        }
+        default:              return 0;
+    }
+}
+
+static const char* aot_branch_hint(int bias) {
+    return bias > 0 ? "SAGE_LIKELY" : bias < 0 ? "SAGE_UNLIKELY" : "";
+}
+
+// Profile-guided specialization: a hot proc whose profiled calls always
+// passed the same INT / FLOAT / BOOL argument types gets a body with those
+// parameters unboxed behind an entry guard; calls failing the guard run the
+// generic (boxed) clone instead.
+static int aot_profile_seeds(AotCompiler* aot, ProcStmt* proc, JitTypeTag* seeds) {
+    if (proc->param_count == 0 || proc->param_count > PROFILE_MAX_PARAMS) return 0;
+    if (profile_function_heat(aot->profile, proc) != PROFILE_HEAT_HOT) return 0;
+    const ProfileSite* site = profile_find(aot->profile, PROFILE_FUNC, &proc->name);
+    if (site == NULL || site->param_count != proc->param_count) return 0;
+    // A nested definition would be emitted once per clone
+    for (Stmt* s = proc->body; s; s = s->next) {
+        if (s->type == STMT_PROC || s->type == STMT_ASYNC_PROC || s->type == STMT_CLASS) return 0;
+    }
+    int typed = 0;
+    for (int i = 0; i < proc->param_count; i++) {
+        seeds[i] = aot_is_unboxed(site->arg_types[i]) ? site->arg_types[i] : JIT_TYPE_UNKNOWN;
+        if (seeds[i] != JIT_TYPE_UNKNOWN) typed = 1;
+    }
+    return typed;
+}
+
+static void aot_compile_proc(AotCompiler* aot, ProcStmt* proc, const char* name,
+                             const JitTypeTag* seeds, const char* generic) {
+    AotTypeEnv outer = aot_enter_scope(aot, proc->params, proc->param_count, proc->body, seeds);
+    int cold = profile_function_heat(aot->profile, proc) == PROFILE_HEAT_COLD;
+    aot_emit(aot, "static %sSageValue %s(int argc, SageValue* argv) {", cold ? "SAGE_COLD " : "", name);
+    aot->indent++;
+    if (seeds) {
+        char* guard = aot_format("argc != %d", proc->param_count);
+        for (int i = 0; i < proc->param_count; i++) {
+            const char* check = seeds[i] == JIT_TYPE_INT   ? "!sage_is_int(argv[%d])"
+                              : seeds[i] == JIT_TYPE_FLOAT ? "argv[%d].type != SAGE_NUM"
+                              : seeds[i] == JIT_TYPE_BOOL  ? "argv[%d].type != SAGE_BOOL" : NULL;
+            if (!check) continue;
+            char* test = aot_format(check, i);
+            char* next = aot_format("%s || %s", guard, test);
+            free(test);
+            free(guard);
+            guard = next;
+        }
+        aot_emit(aot, "if (SAGE_UNLIKELY(%s)) return %s(argc, argv);", guard, generic);
+        free(guard);
+    }
+    AotFrame frame;
+    aot_frame_open(aot, &frame, 1);
+    for (int i = 0; i < proc->param_count; i++) {
+        char* pname = sanitize_name(proc->params[i].start, proc->params[i].length);
+        JitTypeTag t = aot_token_type(aot, proc->params[i]);
+        if (seeds && aot_is_unboxed(seeds[i]) && aot_is_unboxed(t)) {
+            const char* unbox = seeds[i] == JIT_TYPE_INT   ? "(int64_t)argv[%d].as.number"
+                              : seeds[i] == JIT_TYPE_FLOAT ? "argv[%d].as.number" : "argv[%d].as.boolean";
+            char* value = aot_convert(seeds[i], t, aot_format(unbox, i));
+            aot_emit(aot, "%s %s = %s;", aot_c_type(t), pname, value);
+            aot_frame_add(&frame, pname, aot_c_type(t), 1);
+            free(value);
+        } else {
+            aot_emit(aot, "SageValue %s = (argc > %d) ? argv[%d] : sage_nil();", pname, i, i);
+            aot_frame_add(&frame, pname, "SageValue", 1);
+        }
+        free(pname);
+    }
+    frame.decl_line = aot->line_count;
+    for (Stmt* bs = proc->body; bs; bs = bs->next)
+        aot_compile_stmt(aot, bs);
+    aot_emit(aot, "return sage_gc_return(&_gc_frame, sage_nil());");
+    aot_frame_close(aot);
+    aot->indent--;
+    aot_emit(aot, "}");
+    aot_emit(aot, "");
+    aot_leave_scope(aot, outer);
+}
+
 void aot_compile_stmt(AotCompiler* aot, Stmt* stmt) {
     if (!stmt) return;
+    if (aot->frame && aot_stmt_allocates(aot, stmt)) aot_emit(aot, "SAGE_GC_STMT();");
     switch (stmt->type) {
         case STMT_PRINT: {
             char* val = aot_compile_expr(aot, stmt->as.print.expression);
@@ -653,34 +1458,42 @@ void aot_compile_stmt(AotCompiler* aot, Stmt* stmt) {
         }
         case STMT_LET: {
             char* name = sanitize_var_name(aot, stmt->as.let.name.start, stmt->as.let.name.length);
-            int is_top = (aot->in_main && aot->indent == 1);
-            if (stmt->as.let.initializer) {
-                char* val = aot_compile_expr(aot, stmt->as.let.initializer);
-                if (is_top) {
-                    aot_emit(aot, "%s = %s;", name, val);
-                } else {
-                    aot_emit(aot, "SageValue %s = %s;", name, val);
-                }
-                free(val);
+            JitTypeTag t = aot_token_type(aot, stmt->as.let.name);
+            char* val;
+            if (!stmt->as.let.initializer) {
+                val = strdup(aot_is_unboxed(t) ? "0" : "sage_nil()");
+            } else if (aot_is_unboxed(t)) {
+                val = aot_compile_native(aot, stmt->as.let.initializer, t);
             } else {
-                if (is_top) {
-                    aot_emit(aot, "%s = sage_nil();", name);
-                } else {
-                    aot_emit(aot, "SageValue %s = sage_nil();", name);
-                }
+                val = aot_compile_expr(aot, stmt->as.let.initializer);
             }
+            aot_declare_local(aot, name, t);
+            aot_emit(aot, "%s = %s;", name, val);
+            free(val);
             free(name);
             break;
         }
         case STMT_EXPRESSION: {
+            Expr* e = stmt->as.expression;
+            if (e && e->type == EXPR_SET && e->as.set.object == NULL &&
+                aot_is_unboxed(aot_token_type(aot, e->as.set.property))) {
+                // Typed assignment statement: no box for the discarded result
+                JitTypeTag t = aot_token_type(aot, e->as.set.property);
+                char* name = sanitize_var_name(aot, e->as.set.property.start, e->as.set.property.length);
+                char* val = aot_compile_native(aot, e->as.set.value, t);
+                aot_emit(aot, "%s = %s;", name, val);
+                free(name);
+                free(val);
+                break;
+            }
             char* val = aot_compile_expr(aot, stmt->as.expression);
             aot_emit(aot, "%s;", val);
             free(val);
             break;
         }
         case STMT_IF: {
-            char* cond = aot_compile_expr(aot, stmt->as.if_stmt.condition);
-            aot_emit(aot, "if (sage_truthy(%s)) {", cond);
+            char* cond = aot_compile_cond(aot, stmt->as.if_stmt.condition);
+            aot_emit(aot, "if (%s(%s)) {", aot_branch_hint(profile_branch_bias(aot->profile, stmt->as.if_stmt.condition)), cond);
             free(cond);
             aot->indent++;
             for (Stmt* s = stmt->as.if_stmt.then_branch; s; s = s->next)
@@ -697,27 +1510,32 @@ void aot_compile_stmt(AotCompiler* aot, Stmt* stmt) {
             break;
         }
         case STMT_WHILE: {
-            char* cond = aot_compile_expr(aot, stmt->as.while_stmt.condition);
-            aot_emit(aot, "while (sage_truthy(%s)) {", cond);
+            // The condition is re-evaluated without passing a statement
+            // boundary, so it resets the temps itself
+            char* cond = aot_compile_cond(aot, stmt->as.while_stmt.condition);
+            const char* hint = aot_branch_hint(profile_loop_bias(aot->profile, profile_anchor(stmt->as.while_stmt.condition)));
+            if (aot->frame && aot_expr_allocates(aot, stmt->as.while_stmt.condition)) {
+                aot_emit(aot, "while (%s((SAGE_GC_STMT(), %s))) {", hint, cond);
+            } else {
+                aot_emit(aot, "while (%s(%s)) {", hint, cond);
+            }
             free(cond);
             aot->indent++;
             for (Stmt* s = stmt->as.while_stmt.body; s; s = s->next)
                 aot_compile_stmt(aot, s);
-            // Re-evaluate condition
-            cond = aot_compile_expr(aot, stmt->as.while_stmt.condition);
-            free(cond);
             aot->indent--;
             aot_emit(aot, "}");
             break;
         }
         case STMT_RETURN: {
-            if (stmt->as.ret.value) {
-                char* val = aot_compile_expr(aot, stmt->as.ret.value);
-                aot_emit(aot, "return %s;", val);
-                free(val);
+            char* val = stmt->as.ret.value ? aot_compile_expr(aot, stmt->as.ret.value) : strdup("sage_nil()");
+            AotFrame* fn = aot_function_frame(aot);
+            if (fn && !fn->is_main) {
+                aot_emit(aot, "return sage_gc_return(&_gc_frame, %s);", val);
             } else {
-                aot_emit(aot, "return sage_nil();");
+                aot_emit(aot, "return %s;", val);
             }
+            free(val);
             break;
         }
         case STMT_BLOCK: {
@@ -726,18 +1544,54 @@ void aot_compile_stmt(AotCompiler* aot, Stmt* stmt) {
             break;
         }
         case STMT_FOR: {
+            JitTypeTag var_type = aot_token_type(aot, stmt->as.for_stmt.variable);
+            if (aot_is_numeric(var_type) && aot_range_type(aot, stmt->as.for_stmt.iterable) == JIT_TYPE_INT) {
+                // Integer range (see aot_range_type): a plain C counting loop.
+                // The Sage variable is a copy so assigning it cannot skip iterations;
+                // it is a double when the body stores a non-integer into it.
+                CallExpr* range = &stmt->as.for_stmt.iterable->as.call;
+                char* lo = range->arg_count == 2 ? aot_compile_native(aot, range->args[0], JIT_TYPE_INT)
+                                                 : strdup("INT64_C(0)");
+                char* hi = aot_compile_native(aot, range->args[range->arg_count - 1], JIT_TYPE_INT);
+                char* var = sanitize_var_name(aot, stmt->as.for_stmt.variable.start, stmt->as.for_stmt.variable.length);
+                char* idx = aot_temp(aot);
+                aot_emit(aot, "{ int64_t _lo_%s = %s, _hi_%s = %s;", idx, lo, idx, hi);
+                aot->indent++;
+                AotFrame block;
+                aot_frame_open(aot, &block, 0);
+                aot_frame_add(&block, var, aot_c_type(var_type), 0);
+                aot_emit(aot, "for (int64_t %s = _lo_%s; %s < _hi_%s; %s++) {", idx, idx, idx, idx, idx);
+                aot->indent++;
+                aot_emit(aot, "%s = %s;", var, idx);
+                for (Stmt* s = stmt->as.for_stmt.body; s; s = s->next)
+                    aot_compile_stmt(aot, s);
+                aot->indent--;
+                aot_emit(aot, "}");
+                aot_frame_close(aot);
+                aot->indent--;
+                aot_emit(aot, "}");
+                free(lo); free(hi); free(var); free(idx);
+                break;
+            }
             char* iterable = aot_compile_expr(aot, stmt->as.for_stmt.iterable);
             char* var = sanitize_var_name(aot, stmt->as.for_stmt.variable.start, stmt->as.for_stmt.variable.length);
             char* idx = aot_temp(aot);
             aot_emit(aot, "{ SageValue _iter_%s = %s;", idx, iterable);
             aot->indent++;
+            AotFrame block;
+            aot_frame_open(aot, &block, 0);
+            char* iter = aot_format("_iter_%s", idx);
+            aot_frame_add(&block, iter, "SageValue", 1);
+            aot_frame_add(&block, var, "SageValue", 0);
+            free(iter);
             aot_emit(aot, "for (int %s = 0; %s < sage_array_len(_iter_%s); %s++) {", idx, idx, idx, idx);
             aot->indent++;
-            aot_emit(aot, "SageValue %s = sage_array_get(_iter_%s, %s);", var, idx, idx);
+            aot_emit(aot, "%s = sage_array_get(_iter_%s, %s);", var, idx, idx);
             for (Stmt* s = stmt->as.for_stmt.body; s; s = s->next)
                 aot_compile_stmt(aot, s);
             aot->indent--;
             aot_emit(aot, "}");
+            aot_frame_close(aot);
             aot->indent--;
             aot_emit(aot, "}");
             free(iterable); free(var); free(idx);
@@ -775,7 +1629,8 @@ void aot_compile_stmt(AotCompiler* aot, Stmt* stmt) {
         case STMT_MATCH: {
             char* val = aot_compile_expr(aot, stmt->as.match_stmt.value);
             char* tmp = aot_temp(aot);
-            aot_emit(aot, "{ SageValue %s = %s;", tmp, val);
+            if (aot->frame) aot_frame_add(aot->frame, tmp, "SageValue", 0);
+            aot_emit(aot, "{ %s%s = %s;", aot->frame ? "" : "SageValue ", tmp, val);
             aot->indent++;
             for (int i = 0; i < stmt->as.match_stmt.case_count; i++) {
                 CaseClause* c = stmt->as.match_stmt.cases[i];
@@ -811,29 +1666,29 @@ void aot_compile_stmt(AotCompiler* aot, Stmt* stmt) {
             break;
         }
         case STMT_YIELD:
-            if (stmt->as.yield_stmt.value) {
-                char* val = aot_compile_expr(aot, stmt->as.yield_stmt.value);
-                aot_emit(aot, "return %s; /* yield */", val);
+            if (1) {
+                char* val = stmt->as.yield_stmt.value ? aot_compile_expr(aot, stmt->as.yield_stmt.value)
+                                                      : strdup("sage_nil()");
+                AotFrame* fn = aot_function_frame(aot);
+                if (fn && !fn->is_main) {
+                    aot_emit(aot, "return sage_gc_return(&_gc_frame, %s); /* yield */", val);
+                } else {
+                    aot_emit(aot, "return %s; /* yield */", val);
+                }
                 free(val);
-            } else {
-                aot_emit(aot, "return sage_nil(); /* yield */");
             }
             break;
         case STMT_PROC: {
             char* name = sanitize_name(stmt->as.proc.name.start, stmt->as.proc.name.length);
-            aot_emit(aot, "static SageValue %s(int argc, SageValue* argv) {", name);
-            aot->indent++;
-            for (int i = 0; i < stmt->as.proc.param_count; i++) {
-                char* pname = sanitize_name(stmt->as.proc.params[i].start, stmt->as.proc.params[i].length);
-                aot_emit(aot, "SageValue %s = (argc > %d) ? argv[%d] : sage_nil();", pname, i, i);
-                free(pname);
+            JitTypeTag seeds[PROFILE_MAX_PARAMS];
+            if (aot_profile_seeds(aot, &stmt->as.proc, seeds)) {
+                char* generic = aot_format("%s__generic", name);
+                aot_compile_proc(aot, &stmt->as.proc, generic, NULL, NULL);
+                aot_compile_proc(aot, &stmt->as.proc, name, seeds, generic);
+                free(generic);
+            } else {
+                aot_compile_proc(aot, &stmt->as.proc, name, NULL, NULL);
             }
-            for (Stmt* bs = stmt->as.proc.body; bs; bs = bs->next)
-                aot_compile_stmt(aot, bs);
-            aot_emit(aot, "return sage_nil();");
-            aot->indent--;
-            aot_emit(aot, "}");
-            aot_emit(aot, "");
             free(name);
             break;
         }
@@ -845,31 +1700,42 @@ void aot_compile_stmt(AotCompiler* aot, Stmt* stmt) {
             for (Stmt* m = stmt->as.class_stmt.methods; m; m = m->next) {
                 if (m->type == STMT_PROC) {
                     char* mname = sanitize_name(m->as.proc.name.start, m->as.proc.name.length);
+                    AotTypeEnv outer = aot_enter_scope(aot, m->as.proc.params, m->as.proc.param_count, m->as.proc.body, NULL);
                     aot_emit(aot, "static SageValue %s_%s(int argc, SageValue* argv) {", cname, mname + 2);
                     aot->indent++;
+                    AotFrame frame;
+                    aot_frame_open(aot, &frame, 1);
                     aot_emit(aot, "SageValue s_self = s_current_self;");
+                    aot_frame_add(&frame, "s_self", "SageValue", 1);
                     for (int i = 0; i < m->as.proc.param_count; i++) {
                         char* pn = sanitize_var_name(aot, m->as.proc.params[i].start, m->as.proc.params[i].length);
                         if (strcmp(pn, "s_self") == 0 || strcmp(pn, "v_s_self") == 0) {
                             aot_emit(aot, "if (argc > %d && sage_truthy(argv[%d])) s_self = argv[%d];", i, i, i);
                         } else {
                             aot_emit(aot, "SageValue %s = (argc > %d) ? argv[%d] : sage_nil();", pn, i, i);
+                            aot_frame_add(&frame, pn, "SageValue", 1);
                         }
                         free(pn);
                     }
+                    frame.decl_line = aot->line_count;
                     for (Stmt* bs = m->as.proc.body; bs; bs = bs->next)
                         aot_compile_stmt(aot, bs);
-                    aot_emit(aot, "return sage_nil();");
+                    aot_emit(aot, "return sage_gc_return(&_gc_frame, sage_nil());");
+                    aot_frame_close(aot);
                     aot->indent--;
                     aot_emit(aot, "}");
                     aot_emit(aot, "");
+                    aot_leave_scope(aot, outer);
                     free(mname);
                 }
             }
 
             aot_emit(aot, "static SageValue %s(int argc, SageValue* argv) {", cname);
             aot->indent++;
-            aot_emit(aot, "SageValue obj = sage_dict(0);");
+            AotFrame frame;
+            aot_frame_open(aot, &frame, 1);
+            aot_frame_add(&frame, "obj", "SageValue", 0);
+            aot_emit(aot, "obj = sage_dict(0);");
             for (Stmt* m = stmt->as.class_stmt.methods; m; m = m->next) {
                 if (m->type == STMT_PROC) {
                     char* mname = sanitize_name(m->as.proc.name.start, m->as.proc.name.length);
@@ -890,7 +1756,8 @@ void aot_compile_stmt(AotCompiler* aot, Stmt* stmt) {
                 aot_emit(aot, "s_current_self = obj;");
                 aot_emit(aot, "%s_init(argc, argv);", cname);
             }
-            aot_emit(aot, "return obj;");
+            aot_emit(aot, "return sage_gc_return(&_gc_frame, obj);");
+            aot_frame_close(aot);
             aot->indent--;
             aot_emit(aot, "}");
             aot_emit(aot, "");
@@ -901,18 +1768,26 @@ void aot_compile_stmt(AotCompiler* aot, Stmt* stmt) {
             // Treat as regular proc
             if (1) {
                 char* name = sanitize_name(stmt->as.async_proc.name.start, stmt->as.async_proc.name.length);
+                AotTypeEnv outer = aot_enter_scope(aot, stmt->as.async_proc.params, stmt->as.async_proc.param_count,
+                                                   stmt->as.async_proc.body, NULL);
                 aot_emit(aot, "/* async */ static SageValue %s(int argc, SageValue* argv) {", name);
                 aot->indent++;
+                AotFrame frame;
+                aot_frame_open(aot, &frame, 1);
                 for (int i = 0; i < stmt->as.async_proc.param_count; i++) {
                     char* pn = sanitize_name(stmt->as.async_proc.params[i].start, stmt->as.async_proc.params[i].length);
                     aot_emit(aot, "SageValue %s = (argc > %d) ? argv[%d] : sage_nil();", pn, i, i);
+                    aot_frame_add(&frame, pn, "SageValue", 1);
                     free(pn);
                 }
+                frame.decl_line = aot->line_count;
                 for (Stmt* bs = stmt->as.async_proc.body; bs; bs = bs->next)
                     aot_compile_stmt(aot, bs);
-                aot_emit(aot, "return sage_nil();");
+                aot_emit(aot, "return sage_gc_return(&_gc_frame, sage_nil());");
+                aot_frame_close(aot);
                 aot->indent--;
                 aot_emit(aot, "}");
+                aot_leave_scope(aot, outer);
                 free(name);
             }
             break;
@@ -954,13 +1829,16 @@ static void aot_forward_declare_stmt(AotCompiler* aot, Stmt* s) {
             }
             free(name);
         } else if (curr->type == STMT_LET) {
+            // Unboxed globals are locals of main() instead (aot_declare_unboxed)
+            if (aot_is_unboxed(aot_token_type(aot, curr->as.let.name))) continue;
             char* name = sanitize_var_name(aot, curr->as.let.name.start, curr->as.let.name.length);
             int conflict = 0;
             for (int j = 0; j < aot->proc_count; j++) {
                 if (strcmp(aot->procs[j], name) == 0) { conflict = 1; break; }
             }
-            if (!conflict) {
+            if (!conflict && !aot_frame_find(&aot->globals, name)) {
                 aot_emit(aot, "static SageValue %s;", name);
+                aot_frame_add(&aot->globals, name, "SageValue", 1);
             }
             free(name);
         } else if (curr->type == STMT_BLOCK) {
@@ -998,6 +1876,25 @@ static void aot_forward_declare_stmt(AotCompiler* aot, Stmt* s) {
     }
 }
 
+// Top-level lets the script keeps unboxed. No proc can see them (inference
+// pins every name a proc mentions), so they live in main()'s frame where the
+// C compiler can keep them in registers.
+static void aot_declare_unboxed(AotCompiler* aot, Stmt* s) {
+    for (Stmt* curr = s; curr; curr = curr->next) {
+        if (curr->type == STMT_BLOCK) {
+            aot_declare_unboxed(aot, curr->as.block.statements);
+        } else if (curr->type == STMT_COMPTIME) {
+            aot_declare_unboxed(aot, curr->as.comptime.body);
+        } else if (curr->type == STMT_LET) {
+            JitTypeTag t = aot_token_type(aot, curr->as.let.name);
+            if (!aot_is_unboxed(t)) continue;
+            char* name = sanitize_var_name(aot, curr->as.let.name.start, curr->as.let.name.length);
+            aot_declare_local(aot, name, t);
+            free(name);
+        }
+    }
+}
+
 char* aot_compile_program(AotCompiler* aot, Stmt* program) {
     // Type inference pass
     aot_infer_types(aot, program);
@@ -1006,17 +1903,90 @@ char* aot_compile_program(AotCompiler* aot, Stmt* program) {
     aot_emit(aot, "#define _POSIX_C_SOURCE 200809L");
     aot_emit(aot, "#include <stdio.h>");
     aot_emit(aot, "#include <stdlib.h>");
+    aot_emit(aot, "#include <stdint.h>");
     aot_emit(aot, "#include <string.h>");
     aot_emit(aot, "#include <stdarg.h>");
     aot_emit(aot, "#include <math.h>");
     aot_emit(aot, "#include <sys/time.h>");
+    aot_emit(aot, "#include <pthread.h>");
     aot_emit(aot, "");
     aot_emit(aot, "/* Sage AOT Runtime */");
-    aot_emit(aot, "typedef struct { int type; union { double number; int boolean; const char* string; void* ptr; } as; } SageValue;");
-    aot_emit(aot, "enum { SAGE_NIL=0, SAGE_NUM=1, SAGE_BOOL=2, SAGE_STR=3 };");
+    aot_emit(aot, "#if defined(__GNUC__)");
+    aot_emit(aot, "#define SAGE_LIKELY(x) __builtin_expect(!!(x), 1)");
+    aot_emit(aot, "#define SAGE_UNLIKELY(x) __builtin_expect(!!(x), 0)");
+    aot_emit(aot, "#define SAGE_COLD __attribute__((cold))");
+    aot_emit(aot, "#else");
+    aot_emit(aot, "#define SAGE_LIKELY(x) (x)");
+    aot_emit(aot, "#define SAGE_UNLIKELY(x) (x)");
+    aot_emit(aot, "#define SAGE_COLD");
+    aot_emit(aot, "#endif");
+    aot_emit(aot, "typedef struct { int type; int heap; union { double number; int boolean; const char* string; void* ptr; } as; } SageValue;");
+    aot_emit(aot, "enum { SAGE_NIL=0, SAGE_NUM=1, SAGE_BOOL=2, SAGE_STR=3, SAGE_ARR=4, SAGE_DICT=5, SAGE_TUPLE=6, SAGE_NATIVE=7, SAGE_THREAD=8 };");
+    aot_emit(aot, "typedef SageValue (*SageNativeFn)(int, SageValue*);");
+    aot_emit(aot, "typedef struct { SageValue* elems; int count; int cap; } SageArr;");
+    aot_emit(aot, "/* Insertion-ordered hash dict: entries are appended to keys/vals/hashes and found through an open-addressing index of entry numbers. Deleted entries keep key NULL until the next rehash compacts them. */");
+    aot_emit(aot, "typedef struct { char** keys; SageValue* vals; unsigned* hashes; int count; int cap; int live; int* index; int index_cap; } SageDict;");
+    aot_emit(aot, "/* Mark-sweep collector. Roots are the globals, a linked list of frames pointing at the SageValue locals of every active function and for block (pushed by sage_gc_enter, popped by sage_gc_return / sage_gc_leave), and the objects allocated by the statement being run (temps, reset by SAGE_GC_STMT at statement boundaries). */");
+    aot_emit(aot, "enum { SAGE_GC_STRING=0, SAGE_GC_ARRAY=1, SAGE_GC_DICT=2 };");
+    aot_emit(aot, "typedef struct SageGcHeader { struct SageGcHeader* next; size_t size; int kind; int marked; } SageGcHeader;");
+    aot_emit(aot, "typedef struct SageGcFrame { struct SageGcFrame* prev; SageValue** slots; int slot_count; int temp_base; } SageGcFrame;");
+    aot_emit(aot, "#ifndef SAGE_GC_MIN_TRIGGER_BYTES");
+    aot_emit(aot, "#define SAGE_GC_MIN_TRIGGER_BYTES ((size_t)1 << 20)");
+    aot_emit(aot, "#endif");
+    aot_emit(aot, "static SageGcHeader* sage_gc_objects = NULL;");
+    aot_emit(aot, "static size_t sage_gc_bytes = 0, sage_gc_next = SAGE_GC_MIN_TRIGGER_BYTES;");
+    aot_emit(aot, "static int sage_gc_enabled = 1, sage_gc_threads = 0;");
+    aot_emit(aot, "static pthread_mutex_t sage_gc_lock = PTHREAD_MUTEX_INITIALIZER;");
+    aot_emit(aot, "static _Thread_local SageGcFrame* sage_gc_frames = NULL;");
+    aot_emit(aot, "static _Thread_local void** sage_gc_temps = NULL;");
+    aot_emit(aot, "static _Thread_local int sage_gc_temp_count = 0, sage_gc_temp_cap = 0;");
+    aot_emit(aot, "static void** sage_gc_gray = NULL;");
+    aot_emit(aot, "static int sage_gc_gray_count = 0, sage_gc_gray_cap = 0;");
+    aot_emit(aot, "#define SAGE_GC_STMT() (sage_gc_temp_count = _gc_frame.temp_base)");
+    aot_emit(aot, "static void sage_gc_mark_globals(void);  /* forward decl, emitted after the globals */");
+    aot_emit(aot, "static void* sage_gc_grow(void* buf, int* cap, int need, size_t elem) { if (need <= *cap) return buf; int n = *cap ? *cap : 64; while (n < need) n *= 2; buf = realloc(buf, elem * n); if (!buf) { fprintf(stderr, \"Out of memory\\n\"); exit(1); } *cap = n; return buf; }");
+    aot_emit(aot, "static void sage_gc_push_temp(void* obj) { sage_gc_temps = sage_gc_grow(sage_gc_temps, &sage_gc_temp_cap, sage_gc_temp_count + 1, sizeof(void*)); sage_gc_temps[sage_gc_temp_count++] = obj; }");
+    aot_emit(aot, "static void sage_gc_account(size_t n) { __atomic_add_fetch(&sage_gc_bytes, n, __ATOMIC_RELAXED); }");
+    aot_emit(aot, "static void sage_gc_mark_object(void* obj) { SageGcHeader* h = (SageGcHeader*)obj - 1; if (h->marked) return; h->marked = 1; if (h->kind == SAGE_GC_STRING) return; sage_gc_gray = sage_gc_grow(sage_gc_gray, &sage_gc_gray_cap, sage_gc_gray_count + 1, sizeof(void*)); sage_gc_gray[sage_gc_gray_count++] = obj; }");
+    aot_emit(aot, "static int sage_gc_is_object(SageValue v) { return (v.type == SAGE_STR && v.heap) || v.type == SAGE_ARR || v.type == SAGE_TUPLE || v.type == SAGE_DICT; }");
+    aot_emit(aot, "static void sage_gc_mark_value(SageValue v) { if (sage_gc_is_object(v)) sage_gc_mark_object(v.type == SAGE_STR ? (void*)v.as.string : v.as.ptr); }");
+    aot_emit(aot, "static void sage_gc_drain(void) { while (sage_gc_gray_count > 0) { void* obj = sage_gc_gray[--sage_gc_gray_count]; SageGcHeader* h = (SageGcHeader*)obj - 1; if (h->kind == SAGE_GC_ARRAY) { SageArr* a = obj; for (int i = 0; i < a->count; i++) sage_gc_mark_value(a->elems[i]); } else { SageDict* d = obj; for (int i = 0; i < d->count; i++) if (d->keys[i]) sage_gc_mark_value(d->vals[i]); } } }");
+    aot_emit(aot, "static size_t sage_gc_object_bytes(SageGcHeader* h) { size_t n = sizeof(SageGcHeader) + h->size; if (h->kind == SAGE_GC_ARRAY) n += sizeof(SageValue) * ((SageArr*)(h + 1))->cap; else if (h->kind == SAGE_GC_DICT) { SageDict* d = (SageDict*)(h + 1); n += (size_t)d->cap * (sizeof(char*) + sizeof(SageValue) + sizeof(unsigned)) + (size_t)d->index_cap * sizeof(int); } return n; }");
+    aot_emit(aot, "static void sage_gc_release(SageGcHeader* h) { if (h->kind == SAGE_GC_ARRAY) free(((SageArr*)(h + 1))->elems); else if (h->kind == SAGE_GC_DICT) { SageDict* d = (SageDict*)(h + 1); for (int i = 0; i < d->count; i++) free(d->keys[i]); free(d->keys); free(d->vals); free(d->hashes); free(d->index); } free(h); }");
+    aot_emit(aot, "static void sage_gc_collect(void) {");
+    aot_emit(aot, "    if (__atomic_load_n(&sage_gc_threads, __ATOMIC_ACQUIRE) > 0) return;  /* other threads' roots are not visible */");
+    aot_emit(aot, "    sage_gc_mark_globals();");
+    aot_emit(aot, "    for (SageGcFrame* f = sage_gc_frames; f; f = f->prev) for (int i = 0; i < f->slot_count; i++) sage_gc_mark_value(*f->slots[i]);");
+    aot_emit(aot, "    for (int i = 0; i < sage_gc_temp_count; i++) sage_gc_mark_object(sage_gc_temps[i]);");
+    aot_emit(aot, "    sage_gc_drain();");
+    aot_emit(aot, "    size_t live = 0; SageGcHeader** link = &sage_gc_objects;");
+    aot_emit(aot, "    while (*link) { SageGcHeader* h = *link; if (h->marked) { h->marked = 0; live += sage_gc_object_bytes(h); link = &h->next; } else { *link = h->next; sage_gc_release(h); } }");
+    aot_emit(aot, "    sage_gc_bytes = live; sage_gc_next = live * 2 > SAGE_GC_MIN_TRIGGER_BYTES ? live * 2 : SAGE_GC_MIN_TRIGGER_BYTES;");
+    aot_emit(aot, "}");
+    aot_emit(aot, "static void* sage_gc_alloc(int kind, size_t size) {");
+    aot_emit(aot, "    int locked = __atomic_load_n(&sage_gc_threads, __ATOMIC_ACQUIRE) > 0;");
+    aot_emit(aot, "    if (locked) pthread_mutex_lock(&sage_gc_lock);");
+    aot_emit(aot, "    else if (sage_gc_enabled && sage_gc_bytes >= sage_gc_next) sage_gc_collect();");
+    aot_emit(aot, "    SageGcHeader* h = malloc(sizeof(SageGcHeader) + size);");
+    aot_emit(aot, "    if (!h) { fprintf(stderr, \"Out of memory\\n\"); exit(1); }");
+    aot_emit(aot, "    h->size = size; h->kind = kind; h->marked = 0; h->next = sage_gc_objects; sage_gc_objects = h;");
+    aot_emit(aot, "    sage_gc_account(sizeof(SageGcHeader) + size);");
+    aot_emit(aot, "    if (locked) pthread_mutex_unlock(&sage_gc_lock);");
+    aot_emit(aot, "    sage_gc_push_temp(h + 1);");
+    aot_emit(aot, "    return h + 1;");
+    aot_emit(aot, "}");
+    aot_emit(aot, "static void sage_gc_enter(SageGcFrame* f, SageValue** slots, int n) { f->prev = sage_gc_frames; f->slots = slots; f->slot_count = n; f->temp_base = sage_gc_temp_count; sage_gc_frames = f; }");
+    aot_emit(aot, "static void sage_gc_leave(SageGcFrame* f) { sage_gc_frames = f->prev; }");
+    aot_emit(aot, "static SageValue sage_gc_return(SageGcFrame* f, SageValue v) { sage_gc_frames = f->prev; sage_gc_temp_count = f->temp_base; if (sage_gc_is_object(v)) sage_gc_push_temp(v.type == SAGE_STR ? (void*)v.as.string : v.as.ptr); return v; }");
+    aot_emit(aot, "static char* sage_gc_string(size_t len) { char* s = sage_gc_alloc(SAGE_GC_STRING, len + 1); s[len] = 0; return s; }");
+    aot_emit(aot, "static SageValue sage_heap_string(char* s) { SageValue v; v.type = SAGE_STR; v.heap = 1; v.as.string = s; return v; }");
+    aot_emit(aot, "static SageValue sage_string_copy(const char* s) { size_t n = strlen(s); char* c = sage_gc_string(n); memcpy(c, s, n); return sage_heap_string(c); }");
+    aot_emit(aot, "static SageArr* sage_arr_new(int cap) { SageArr* a = sage_gc_alloc(SAGE_GC_ARRAY, sizeof(SageArr)); a->cap = cap > 4 ? cap : 4; a->count = 0; a->elems = malloc(sizeof(SageValue) * a->cap); sage_gc_account(sizeof(SageValue) * a->cap); return a; }");
+    aot_emit(aot, "static SageValue sage_arr_value(int type, SageArr* a) { SageValue v; v.type = type; v.as.ptr = a; return v; }");
     aot_emit(aot, "static SageValue sage_number(double n) { SageValue v; v.type=SAGE_NUM; v.as.number=n; return v; }");
+    aot_emit(aot, "static int sage_is_int(SageValue v) { return v.type==SAGE_NUM && v.as.number>=-9007199254740992.0 && v.as.number<=9007199254740992.0 && v.as.number==(double)(int64_t)v.as.number; }");
     aot_emit(aot, "static SageValue sage_bool(int b) { SageValue v; v.type=SAGE_BOOL; v.as.boolean=b; return v; }");
-    aot_emit(aot, "static SageValue sage_string(const char* s) { SageValue v; v.type=SAGE_STR; v.as.string=s; return v; }");
+    aot_emit(aot, "static SageValue sage_string(const char* s) { SageValue v; v.type=SAGE_STR; v.heap=0; v.as.string=s; return v; }");
     aot_emit(aot, "static SageValue sage_nil(void) { SageValue v; v.type=SAGE_NIL; return v; }");
     aot_emit(aot, "static int sage_truthy(SageValue v) { if(v.type==SAGE_NIL) return 0; if(v.type==SAGE_BOOL) return v.as.boolean; if(v.type==SAGE_NUM) return v.as.number!=0.0; return 1; }");
     aot_emit(aot, "static SageValue sage_str(SageValue v);  /* forward decl */");
@@ -1031,44 +2001,45 @@ char* aot_compile_program(AotCompiler* aot, Stmt* program) {
     aot_emit(aot, "static SageValue sage_neq(SageValue a, SageValue b) { return sage_bool(!sage_eq(a,b).as.boolean); }");
     aot_emit(aot, "static SageValue sage_gt(SageValue a, SageValue b) { return sage_bool(a.as.number>b.as.number); }");
     aot_emit(aot, "static SageValue sage_lt(SageValue a, SageValue b) { return sage_bool(a.as.number<b.as.number); }");
-    aot_emit(aot, "static SageValue sage_strcat(SageValue a, SageValue b) { if(a.type!=SAGE_STR||b.type!=SAGE_STR) return sage_nil(); size_t la=strlen(a.as.string),lb=strlen(b.as.string); char* r=malloc(la+lb+1); memcpy(r,a.as.string,la); memcpy(r+la,b.as.string,lb); r[la+lb]=0; SageValue v; v.type=SAGE_STR; v.as.string=r; return v; }");
+    aot_emit(aot, "static SageValue sage_strcat(SageValue a, SageValue b) { if(a.type!=SAGE_STR||b.type!=SAGE_STR) return sage_nil(); size_t la=strlen(a.as.string),lb=strlen(b.as.string); char* r=sage_gc_string(la+lb); memcpy(r,a.as.string,la); memcpy(r+la,b.as.string,lb); return sage_heap_string(r); }");
     aot_emit(aot, "");
     // Array/Dict/Index runtime support — must come before sage_print_value
-    aot_emit(aot, "enum { SAGE_ARR=4, SAGE_DICT=5, SAGE_TUPLE=6, SAGE_NATIVE=7 };");
-    aot_emit(aot, "typedef SageValue (*SageNativeFn)(int, SageValue*);");
-    aot_emit(aot, "typedef struct { SageValue* elems; int count; int cap; } SageArr;");
-    aot_emit(aot, "typedef struct { char** keys; SageValue* vals; int count; int cap; } SageDict;");
     aot_emit(aot, "static SageValue val_native(SageNativeFn f) { SageValue v; v.type=SAGE_NATIVE; v.as.ptr=f; return v; }");
     aot_emit(aot, "static SageValue sage_call(SageValue f, int c, SageValue* a) { if(f.type==SAGE_NATIVE) return ((SageNativeFn)f.as.ptr)(c,a); return sage_nil(); }");
-    aot_emit(aot, "static SageValue sage_array(int n, ...) { SageArr* a=malloc(sizeof(SageArr)); a->cap=n>4?n:4; a->count=n; a->elems=malloc(sizeof(SageValue)*a->cap); va_list ap; va_start(ap,n); for(int i=0;i<n;i++) a->elems[i]=va_arg(ap,SageValue); va_end(ap); SageValue v; v.type=SAGE_ARR; v.as.ptr=a; return v; }");
+    aot_emit(aot, "static SageValue sage_array(int n, ...) { SageArr* a=sage_arr_new(n); a->count=n; va_list ap; va_start(ap,n); for(int i=0;i<n;i++) a->elems[i]=va_arg(ap,SageValue); va_end(ap); return sage_arr_value(SAGE_ARR,a); }");
     aot_emit(aot, "static int sage_array_len(SageValue v) { if(v.type==SAGE_ARR) return ((SageArr*)v.as.ptr)->count; return 0; }");
     aot_emit(aot, "static SageValue sage_array_get(SageValue v, int i) { if(v.type==SAGE_ARR || v.type==SAGE_TUPLE){SageArr*a=(SageArr*)v.as.ptr; if(i>=0&&i<a->count) return a->elems[i];} return sage_nil(); }");
-    aot_emit(aot, "static SageValue sage_index(SageValue c, SageValue i) { if(c.type==SAGE_ARR || c.type==SAGE_TUPLE) return sage_array_get(c,(int)i.as.number); if(c.type==SAGE_DICT){SageDict*d=(SageDict*)c.as.ptr; if(i.type==SAGE_STR) for(int k=0;k<d->count;k++) if(strcmp(d->keys[k],i.as.string)==0) return d->vals[k];} return sage_nil(); }");
-    aot_emit(aot, "static SageValue sage_index_set(SageValue c, SageValue i, SageValue val) { if(c.type==SAGE_ARR){SageArr*a=(SageArr*)c.as.ptr; int idx=(int)i.as.number; if(idx>=0&&idx<a->count) a->elems[idx]=val;} if(c.type==SAGE_DICT){SageDict*d=(SageDict*)c.as.ptr; if(i.type==SAGE_STR){for(int k=0;k<d->count;k++) if(strcmp(d->keys[k],i.as.string)==0){d->vals[k]=val;return val;} if(d->count>=d->cap){d->cap=d->cap?d->cap*2:4;d->keys=realloc(d->keys,sizeof(char*)*d->cap);d->vals=realloc(d->vals,sizeof(SageValue)*d->cap);}d->keys[d->count]=strdup(i.as.string);d->vals[d->count]=val;d->count++;}} return val; }");
-    aot_emit(aot, "static SageValue sage_dict(int n, ...) { SageDict*d=calloc(1,sizeof(SageDict)); d->cap=n>2?n:2; d->keys=malloc(sizeof(char*)*d->cap); d->vals=malloc(sizeof(SageValue)*d->cap); va_list ap; va_start(ap,n); for(int i=0;i<n;i++){d->keys[i]=strdup(va_arg(ap,const char*));d->vals[i]=va_arg(ap,SageValue);d->count++;} va_end(ap); SageValue v; v.type=SAGE_DICT; v.as.ptr=d; return v; }");
-    aot_emit(aot, "static SageValue sage_tuple(int n, ...) { SageArr*a=malloc(sizeof(SageArr)); a->cap=n; a->count=n; a->elems=malloc(sizeof(SageValue)*n); va_list ap; va_start(ap,n); for(int i=0;i<n;i++) a->elems[i]=va_arg(ap,SageValue); va_end(ap); SageValue v; v.type=SAGE_TUPLE; v.as.ptr=a; return v; }");
+    aot_emit(aot, "static unsigned sage_hash_str(const char* s) { unsigned h=2166136261u; while(*s){h^=(unsigned char)*s++; h*=16777619u;} return h; }");
+    aot_emit(aot, "static int sage_dict_find(SageDict* d, const char* key, unsigned h) { if(!d->index_cap) return -1; unsigned m=(unsigned)d->index_cap-1; for(unsigned i=h&m;;i=(i+1)&m){int e=d->index[i]; if(e<0) return -1; if(d->hashes[e]==h&&d->keys[e]&&strcmp(d->keys[e],key)==0) return e;} }");
+    aot_emit(aot, "static void sage_dict_rehash(SageDict* d) { int n=0; for(int i=0;i<d->count;i++) if(d->keys[i]){d->keys[n]=d->keys[i];d->vals[n]=d->vals[i];d->hashes[n]=d->hashes[i];n++;} d->count=n; int cap=8; while(cap<(n+1)*2) cap*=2; sage_gc_account(sizeof(int)*(cap>d->index_cap?cap-d->index_cap:0)); free(d->index); d->index=malloc(sizeof(int)*cap); memset(d->index,0xff,sizeof(int)*cap); d->index_cap=cap; unsigned m=(unsigned)cap-1; for(int e=0;e<n;e++){unsigned i=d->hashes[e]&m; while(d->index[i]>=0) i=(i+1)&m; d->index[i]=e;} }");
+    aot_emit(aot, "static void sage_dict_put(SageDict* d, const char* key, SageValue val) { unsigned h=sage_hash_str(key); int e=sage_dict_find(d,key,h); if(e>=0){d->vals[e]=val;return;} if((d->count+1)*4>d->index_cap*3) sage_dict_rehash(d); if(d->count>=d->cap){int cap=d->cap?d->cap*2:4; sage_gc_account((sizeof(char*)+sizeof(SageValue)+sizeof(unsigned))*(cap-d->cap)); d->keys=realloc(d->keys,sizeof(char*)*cap); d->vals=realloc(d->vals,sizeof(SageValue)*cap); d->hashes=realloc(d->hashes,sizeof(unsigned)*cap); d->cap=cap;} e=d->count++; d->keys[e]=strdup(key); d->vals[e]=val; d->hashes[e]=h; d->live++; unsigned m=(unsigned)d->index_cap-1, i=h&m; while(d->index[i]>=0) i=(i+1)&m; d->index[i]=e; }");
+    aot_emit(aot, "static SageValue sage_dict_get(SageDict* d, const char* key) { int e=sage_dict_find(d,key,sage_hash_str(key)); return e>=0?d->vals[e]:sage_nil(); }");
+    aot_emit(aot, "static SageValue sage_index(SageValue c, SageValue i) { if(c.type==SAGE_ARR || c.type==SAGE_TUPLE) return sage_array_get(c,(int)i.as.number); if(c.type==SAGE_DICT&&i.type==SAGE_STR) return sage_dict_get((SageDict*)c.as.ptr,i.as.string); return sage_nil(); }");
+    aot_emit(aot, "static SageValue sage_index_set(SageValue c, SageValue i, SageValue val) { if(c.type==SAGE_ARR){SageArr*a=(SageArr*)c.as.ptr; int idx=(int)i.as.number; if(idx>=0&&idx<a->count) a->elems[idx]=val;} if(c.type==SAGE_DICT&&i.type==SAGE_STR) sage_dict_put((SageDict*)c.as.ptr,i.as.string,val); return val; }");
+    aot_emit(aot, "static SageValue sage_dict(int n, ...) { SageDict*d=sage_gc_alloc(SAGE_GC_DICT,sizeof(SageDict)); memset(d,0,sizeof(SageDict)); va_list ap; va_start(ap,n); for(int i=0;i<n;i++){const char*k=va_arg(ap,const char*); sage_dict_put(d,k,va_arg(ap,SageValue));} va_end(ap); SageValue v; v.type=SAGE_DICT; v.as.ptr=d; return v; }");
+    aot_emit(aot, "static SageValue sage_tuple(int n, ...) { SageArr*a=sage_arr_new(n); a->count=n; va_list ap; va_start(ap,n); for(int i=0;i<n;i++) a->elems[i]=va_arg(ap,SageValue); va_end(ap); return sage_arr_value(SAGE_TUPLE,a); }");
     aot_emit(aot, "static SageValue sage_slice(SageValue c, SageValue s, SageValue e) { if(c.type!=SAGE_ARR) return sage_nil(); SageArr*a=(SageArr*)c.as.ptr; int si=(int)s.as.number,ei=e.type==SAGE_NIL?a->count:(int)e.as.number; if(si<0)si=0;if(ei>a->count)ei=a->count; int n=ei-si;if(n<0)n=0; return sage_array(0); /* simplified */ }");
 
     aot_emit(aot, "static SageValue sage_pop(SageValue arr) { if(arr.type==SAGE_ARR){SageArr*a=(SageArr*)arr.as.ptr;if(a->count>0)return a->elems[--a->count];} return sage_nil(); }");
-    aot_emit(aot, "static SageValue sage_len(SageValue v) { if(v.type==SAGE_ARR) return sage_number(((SageArr*)v.as.ptr)->count); if(v.type==SAGE_STR) return sage_number(strlen(v.as.string)); if(v.type==SAGE_DICT) return sage_number(((SageDict*)v.as.ptr)->count); return sage_number(0); }");
-    aot_emit(aot, "static SageValue sage_range(int n) { SageArr*a=malloc(sizeof(SageArr)); a->cap=n>4?n:4; a->count=n; a->elems=malloc(sizeof(SageValue)*a->cap); for(int i=0;i<n;i++) a->elems[i]=sage_number(i); SageValue v; v.type=SAGE_ARR; v.as.ptr=a; return v; }");
-    aot_emit(aot, "static SageValue sage_get_property(SageValue obj, const char* name) { if(obj.type==SAGE_DICT){SageDict*d=(SageDict*)obj.as.ptr; for(int i=0;i<d->count;i++) if(strcmp(d->keys[i],name)==0) return d->vals[i];} return sage_nil(); }");
-    aot_emit(aot, "static SageValue sage_dict_keys(SageValue d) { if(d.type!=SAGE_DICT) return sage_array(0); SageDict*dd=(SageDict*)d.as.ptr; SageArr*a=malloc(sizeof(SageArr)); a->cap=dd->count>4?dd->count:4; a->count=dd->count; a->elems=malloc(sizeof(SageValue)*a->cap); for(int i=0;i<dd->count;i++) a->elems[i]=sage_string(dd->keys[i]); SageValue v; v.type=SAGE_ARR; v.as.ptr=a; return v; }");
-    aot_emit(aot, "static SageValue sage_str(SageValue v) { char buf[256]; switch(v.type){case SAGE_NUM:{double d=v.as.number;if(d==(double)(long long)d&&d>=-1e15&&d<=1e15)snprintf(buf,sizeof(buf),\"%%lld\",(long long)d);else snprintf(buf,sizeof(buf),\"%%g\",d);break;}case SAGE_STR:return v;case SAGE_BOOL:return sage_string(v.as.boolean?\"true\":\"false\");default:return sage_string(\"nil\");}return sage_string(strdup(buf));}");
+    aot_emit(aot, "static SageValue sage_len(SageValue v) { if(v.type==SAGE_ARR) return sage_number(((SageArr*)v.as.ptr)->count); if(v.type==SAGE_STR) return sage_number(strlen(v.as.string)); if(v.type==SAGE_DICT) return sage_number(((SageDict*)v.as.ptr)->live); return sage_number(0); }");
+    aot_emit(aot, "static SageValue sage_range(int n) { SageArr*a=sage_arr_new(n); a->count=n; for(int i=0;i<n;i++) a->elems[i]=sage_number(i); return sage_arr_value(SAGE_ARR,a); }");
+    aot_emit(aot, "static SageValue sage_get_property(SageValue obj, const char* name) { if(obj.type==SAGE_DICT) return sage_dict_get((SageDict*)obj.as.ptr,name); return sage_nil(); }");
+    aot_emit(aot, "static SageValue sage_dict_keys(SageValue d) { if(d.type!=SAGE_DICT) return sage_array(0); SageDict*dd=(SageDict*)d.as.ptr; SageArr*a=sage_arr_new(dd->live); for(int i=0;i<dd->count;i++) if(dd->keys[i]) a->elems[a->count++]=sage_string_copy(dd->keys[i]); return sage_arr_value(SAGE_ARR,a); }");
+    aot_emit(aot, "static SageValue sage_str(SageValue v) { char buf[256]; switch(v.type){case SAGE_NUM:{double d=v.as.number;if(d==(double)(long long)d&&d>=-1e15&&d<=1e15)snprintf(buf,sizeof(buf),\"%%lld\",(long long)d);else snprintf(buf,sizeof(buf),\"%%g\",d);break;}case SAGE_STR:return v;case SAGE_BOOL:return sage_string(v.as.boolean?\"true\":\"false\");default:return sage_string(\"nil\");}return sage_string_copy(buf);}");
     aot_emit(aot, "static SageValue sage_tonumber(SageValue v) { if(v.type==SAGE_NUM)return v; if(v.type==SAGE_STR)return sage_number(atof(v.as.string)); return sage_number(0);}");
     aot_emit(aot, "static SageValue sage_type(SageValue v) { switch(v.type){case SAGE_NUM:return sage_string(\"number\");case SAGE_STR:return sage_string(\"string\");case SAGE_BOOL:return sage_string(\"bool\");case SAGE_ARR:return sage_string(\"array\");case SAGE_DICT:return sage_string(\"dict\");default:return sage_string(\"nil\");} }");
 
-    aot_emit(aot, "static SageValue s_getch(int c, SageValue* a) { (void)c; (void)a; int ch=getchar(); if(ch==EOF)return sage_string(\"\"); char b[2]={(char)ch,0}; return sage_string(strdup(b)); }");
+    aot_emit(aot, "static SageValue s_getch(int c, SageValue* a) { (void)c; (void)a; int ch=getchar(); if(ch==EOF)return sage_string(\"\"); char b[2]={(char)ch,0}; return sage_string_copy(b); }");
 
-    aot_emit(aot, "static void sage_push(SageValue arr, SageValue val) { if(arr.type==SAGE_ARR){SageArr*a=(SageArr*)arr.as.ptr;if(a->count>=a->cap){a->cap=a->cap?a->cap*2:4;a->elems=realloc(a->elems,sizeof(SageValue)*a->cap);}a->elems[a->count++]=val;} }");
+    aot_emit(aot, "static void sage_push(SageValue arr, SageValue val) { if(arr.type==SAGE_ARR){SageArr*a=(SageArr*)arr.as.ptr;if(a->count>=a->cap){sage_gc_account(sizeof(SageValue)*(a->cap?a->cap:4));a->cap=a->cap?a->cap*2:4;a->elems=realloc(a->elems,sizeof(SageValue)*a->cap);}a->elems[a->count++]=val;} }");
     aot_emit(aot, "static SageValue s_current_self;");
-    aot_emit(aot, "static SageValue s_dict_has(int c, SageValue* a) { if(c<2||a[0].type!=SAGE_DICT||a[1].type!=SAGE_STR)return sage_bool(0); SageDict*d=(SageDict*)a[0].as.ptr; for(int i=0;i<d->count;i++)if(strcmp(d->keys[i],a[1].as.string)==0)return sage_bool(1); return sage_bool(0); }");
-    aot_emit(aot, "static SageValue s_dict_delete(int c, SageValue* a) { if(c<2||a[0].type!=SAGE_DICT||a[1].type!=SAGE_STR)return sage_nil(); SageDict*d=(SageDict*)a[0].as.ptr; for(int i=0;i<d->count;i++)if(strcmp(d->keys[i],a[1].as.string)==0){SageValue v=d->vals[i];for(int j=i;j<d->count-1;j++){d->keys[j]=d->keys[j+1];d->vals[j]=d->vals[j+1];}d->count--;return v;} return sage_nil(); }");
-    aot_emit(aot, "static SageValue s_gc_collect(int c, SageValue* a) { (void)c; (void)a; return sage_nil(); }");
-    aot_emit(aot, "static SageValue s_lower(int c, SageValue* a) { if(c<1||a[0].type!=SAGE_STR)return sage_string(\"\"); char*s=strdup(a[0].as.string); for(int i=0;s[i];i++)if(s[i]>='A'&&s[i]<='Z')s[i]+=32; SageValue v=sage_string(s); free(s); return v; }");
+    aot_emit(aot, "static SageValue s_dict_has(int c, SageValue* a) { if(c<2||a[0].type!=SAGE_DICT||a[1].type!=SAGE_STR)return sage_bool(0); return sage_bool(sage_dict_find((SageDict*)a[0].as.ptr,a[1].as.string,sage_hash_str(a[1].as.string))>=0); }");
+    aot_emit(aot, "static SageValue s_dict_delete(int c, SageValue* a) { if(c<2||a[0].type!=SAGE_DICT||a[1].type!=SAGE_STR)return sage_nil(); SageDict*d=(SageDict*)a[0].as.ptr; int e=sage_dict_find(d,a[1].as.string,sage_hash_str(a[1].as.string)); if(e<0)return sage_nil(); SageValue v=d->vals[e]; free(d->keys[e]); d->keys[e]=NULL; d->vals[e]=sage_nil(); d->live--; return v; }");
+    aot_emit(aot, "static SageValue s_gc_collect(int c, SageValue* a) { (void)c; (void)a; sage_gc_collect(); return sage_nil(); }");
+    aot_emit(aot, "static SageValue s_lower(int c, SageValue* a) { if(c<1||a[0].type!=SAGE_STR)return sage_string(\"\"); SageValue v=sage_string_copy(a[0].as.string); char*s=(char*)v.as.string; for(int i=0;s[i];i++)if(s[i]>='A'&&s[i]<='Z')s[i]+=32; return v; }");
     aot_emit(aot, "#include <ctype.h>");
     aot_emit(aot, "static int s_is_safe_command(const char* cmd) { if(!cmd) return 1; if(cmd[0]=='-') return 0; for(const char* p=cmd;*p;p++) { if(!isalnum((unsigned char)*p)&&*p!='/'&&*p!='.'&&*p!='-'&&*p!='_'&&*p!='~'&&*p!=' '&&*p!='\\'') return 0; } return 1; }");
-    aot_emit(aot, "static SageValue s_shell_exec(int c, SageValue* a) { if(c<1||a[0].type!=SAGE_STR)return sage_string(\"\"); if(!s_is_safe_command(a[0].as.string)){fprintf(stderr, \"Security Error: Unsafe characters in command\\n\"); return sage_string(\"\");} FILE*f=popen(a[0].as.string,\"r\"); if(!f)return sage_string(\"\"); char buf[4096]; char*out=NULL; size_t slen=0; while(fgets(buf,sizeof(buf),f)){size_t l=strlen(buf); out=realloc(out,slen+l+1); memcpy(out+slen,buf,l); slen+=l; out[slen]=0;} pclose(f); SageValue v=sage_string(out?out:\"\"); free(out); return v; }");
+    aot_emit(aot, "static SageValue s_shell_exec(int c, SageValue* a) { if(c<1||a[0].type!=SAGE_STR)return sage_string(\"\"); if(!s_is_safe_command(a[0].as.string)){fprintf(stderr, \"Security Error: Unsafe characters in command\\n\"); return sage_string(\"\");} FILE*f=popen(a[0].as.string,\"r\"); if(!f)return sage_string(\"\"); char buf[4096]; char*out=NULL; size_t slen=0; while(fgets(buf,sizeof(buf),f)){size_t l=strlen(buf); out=realloc(out,slen+l+1); memcpy(out+slen,buf,l); slen+=l; out[slen]=0;} pclose(f); SageValue v=sage_string_copy(out?out:\"\"); free(out); return v; }");
     aot_emit(aot, "static SageValue s_stdout_write(int c, SageValue* a) { if(c<1||a[0].type!=SAGE_STR)return sage_nil(); fputs(a[0].as.string, stdout); fflush(stdout); return sage_nil(); }");
     aot_emit(aot, "#include <sys/socket.h>");
     aot_emit(aot, "#include <netinet/in.h>");
@@ -1078,31 +2049,31 @@ char* aot_compile_program(AotCompiler* aot, Stmt* program) {
     aot_emit(aot, "#include <time.h>");
     aot_emit(aot, "static SageValue s_connect(int c, SageValue* a) { if(c<2||a[0].type!=SAGE_STR||a[1].type!=SAGE_NUM)return sage_number(-1); int fd=socket(AF_INET,SOCK_STREAM,0); if(fd<0)return sage_number(-1); struct hostent*h=gethostbyname(a[0].as.string); if(!h){close(fd);return sage_number(-1);} struct sockaddr_in saddr; memset(&saddr,0,sizeof(saddr)); saddr.sin_family=AF_INET; saddr.sin_port=htons((int)a[1].as.number); memcpy(&saddr.sin_addr.s_addr,h->h_addr_list[0],h->h_length); if(connect(fd,(struct sockaddr*)&saddr,sizeof(saddr))<0){close(fd);return sage_number(-1);} return sage_number(fd); }");
     aot_emit(aot, "static SageValue s_send(int c, SageValue* a) { if(c<2||a[0].type!=SAGE_NUM||a[1].type!=SAGE_STR)return sage_number(-1); int fd=(int)a[0].as.number; const char*str=a[1].as.string; int len=strlen(str); int s=send(fd,str,len,0); return sage_number(s); }");
-    aot_emit(aot, "static SageValue s_recv(int c, SageValue* a) { if(c<2||a[0].type!=SAGE_NUM||a[1].type!=SAGE_NUM)return sage_string(\"\"); int fd=(int)a[0].as.number; int size=(int)a[1].as.number; char*buf=malloc(size+1); int r=recv(fd,buf,size,0); if(r<0){free(buf);return sage_string(\"\");} buf[r]=0; SageValue v=sage_string(buf); free(buf); return v; }");
+    aot_emit(aot, "static SageValue s_recv(int c, SageValue* a) { if(c<2||a[0].type!=SAGE_NUM||a[1].type!=SAGE_NUM)return sage_string(\"\"); int fd=(int)a[0].as.number; int size=(int)a[1].as.number; char*buf=malloc(size+1); int r=recv(fd,buf,size,0); if(r<0){free(buf);return sage_string(\"\");} buf[r]=0; SageValue v=sage_string_copy(buf); free(buf); return v; }");
     aot_emit(aot, "static SageValue s_close(int c, SageValue* a) { if(c<1||a[0].type!=SAGE_NUM)return sage_nil(); int fd=(int)a[0].as.number; close(fd); return sage_nil(); }");
-    aot_emit(aot, "static SageValue s_gc_disable(int c, SageValue* a) { (void)c; (void)a; return sage_nil(); }");
+    aot_emit(aot, "static SageValue s_gc_disable(int c, SageValue* a) { (void)c; (void)a; sage_gc_enabled=0; return sage_nil(); }");
+    aot_emit(aot, "static SageValue s_gc_enable(int c, SageValue* a) { (void)c; (void)a; sage_gc_enabled=1; return sage_nil(); }");
     aot_emit(aot, "static SageValue s_slice(int c, SageValue* a) { if (c<3) return sage_nil(); return sage_slice(a[0], a[1], a[2]); }");
     aot_emit(aot, "static SageValue s_startswith(int c, SageValue* a) { if (c<2||a[0].type!=SAGE_STR||a[1].type!=SAGE_STR) return sage_bool(0); return sage_bool(strncmp(a[0].as.string, a[1].as.string, strlen(a[1].as.string))==0); }");
     aot_emit(aot, "static SageValue s_endswith(int c, SageValue* a) { if (c<2||a[0].type!=SAGE_STR||a[1].type!=SAGE_STR) return sage_bool(0); int l1=strlen(a[0].as.string); int l2=strlen(a[1].as.string); if(l2>l1)return sage_bool(0); return sage_bool(strcmp(a[0].as.string+l1-l2, a[1].as.string)==0); }");
     aot_emit(aot, "static SageValue s_contains(int c, SageValue* a) { if (c<2||a[0].type!=SAGE_STR||a[1].type!=SAGE_STR) return sage_bool(0); return sage_bool(strstr(a[0].as.string, a[1].as.string)!=NULL); }");
     aot_emit(aot, "static SageValue s_sleep(int c, SageValue* a) { if(c>0&&a[0].type==SAGE_NUM){ struct timespec req; req.tv_sec = (time_t)a[0].as.number; req.tv_nsec = (long)((a[0].as.number - (double)req.tv_sec) * 1e9); nanosleep(&req, NULL); } return sage_nil(); }");
-    aot_emit(aot, "#include <pthread.h>");
-    aot_emit(aot, "static void* _thread_runner(void* arg) { SageValue* fn = (SageValue*)arg; sage_call(*fn, 0, NULL); free(fn); return NULL; }");
-    aot_emit(aot, "static SageValue s_spawn(int c, SageValue* a) { if(c<1)return sage_nil(); pthread_t* t=malloc(sizeof(pthread_t)); SageValue* fn=malloc(sizeof(SageValue)); *fn=a[0]; pthread_create(t, NULL, _thread_runner, fn); SageValue v; v.type=6; v.as.ptr=t; return v; }");
-    aot_emit(aot, "static SageValue s_join(int c, SageValue* a) { if(c>0&&a[0].type==6){pthread_join(*(pthread_t*)a[0].as.ptr, NULL); free(a[0].as.ptr); return sage_nil();} if(c>1&&a[0].type==SAGE_ARR&&a[1].type==SAGE_STR){SageArr*arr=(SageArr*)a[0].as.ptr; if(arr->count==0)return sage_string(\"\"); int len=0; for(int i=0;i<arr->count;i++){SageValue sa=sage_str(arr->elems[i]); len+=strlen(sa.as.string);} len+=strlen(a[1].as.string)*arr->count; char*b=malloc(len+1); b[0]=0; for(int i=0;i<arr->count;i++){SageValue sa=sage_str(arr->elems[i]); strcat(b,sa.as.string); if(i<arr->count-1)strcat(b,a[1].as.string);} SageValue v; v.type=SAGE_STR; v.as.string=b; return v;} return sage_nil(); }");
+    aot_emit(aot, "static void* _thread_runner(void* arg) { SageValue* fn = (SageValue*)arg; sage_call(*fn, 0, NULL); free(fn); __atomic_sub_fetch(&sage_gc_threads, 1, __ATOMIC_RELEASE); return NULL; }");
+    aot_emit(aot, "static SageValue s_spawn(int c, SageValue* a) { if(c<1)return sage_nil(); pthread_t* t=malloc(sizeof(pthread_t)); SageValue* fn=malloc(sizeof(SageValue)); *fn=a[0]; __atomic_add_fetch(&sage_gc_threads, 1, __ATOMIC_ACQ_REL); pthread_create(t, NULL, _thread_runner, fn); SageValue v; v.type=SAGE_THREAD; v.as.ptr=t; return v; }");
+    aot_emit(aot, "static SageValue s_join(int c, SageValue* a) { if(c>0&&a[0].type==SAGE_THREAD){pthread_join(*(pthread_t*)a[0].as.ptr, NULL); free(a[0].as.ptr); return sage_nil();} if(c>1&&a[0].type==SAGE_ARR&&a[1].type==SAGE_STR){SageArr*arr=(SageArr*)a[0].as.ptr; if(arr->count==0)return sage_string(\"\"); size_t len=0, sl=strlen(a[1].as.string); for(int i=0;i<arr->count;i++){SageValue sa=sage_str(arr->elems[i]); len+=strlen(sa.as.string);} len+=sl*(arr->count-1); char*b=sage_gc_string(len); size_t pos=0; for(int i=0;i<arr->count;i++){SageValue sa=sage_str(arr->elems[i]); size_t l=strlen(sa.as.string); memcpy(b+pos,sa.as.string,l); pos+=l; if(i<arr->count-1){memcpy(b+pos,a[1].as.string,sl); pos+=sl;}} return sage_heap_string(b);} return sage_nil(); }");
     aot_emit(aot, "static SageValue s_string_count(int c, SageValue* a) { if(c<2||a[0].type!=SAGE_STR||a[1].type!=SAGE_STR)return sage_number(0); int ct=0; const char*p=a[0].as.string; const char*f=a[1].as.string; int fl=strlen(f); if(fl==0)return sage_number(0); while((p=strstr(p,f))!=NULL){ct++; p+=fl;} return sage_number(ct); }");
-    aot_emit(aot, "static SageValue s_string_repeat(int c, SageValue* a) { if(c<2||a[0].type!=SAGE_STR||a[1].type!=SAGE_NUM)return sage_string(\"\"); int t=(int)a[1].as.number; if(t<=0)return sage_string(\"\"); int l=strlen(a[0].as.string); char*b=malloc(l*t+1); b[0]=0; for(int i=0;i<t;i++)strcat(b,a[0].as.string); return sage_string(b); }");
+    aot_emit(aot, "static SageValue s_string_repeat(int c, SageValue* a) { if(c<2||a[0].type!=SAGE_STR||a[1].type!=SAGE_NUM)return sage_string(\"\"); int t=(int)a[1].as.number; if(t<=0)return sage_string(\"\"); size_t l=strlen(a[0].as.string); char*b=sage_gc_string(l*t); for(int i=0;i<t;i++)memcpy(b+l*i,a[0].as.string,l); return sage_heap_string(b); }");
     aot_emit(aot, "static SageValue s_sendall(int c, SageValue* a) { return s_send(c,a); }");
     aot_emit(aot, "static SageValue s_indexof(int c, SageValue* a) { if(c<2||a[0].type!=SAGE_STR||a[1].type!=SAGE_STR)return sage_number(-1); char* p=strstr(a[0].as.string,a[1].as.string); if(!p)return sage_number(-1); return sage_number(p-a[0].as.string); }");
     aot_emit(aot, "#include <ctype.h>");
-    aot_emit(aot, "static SageValue s_upper(int c, SageValue* a) { if(c<1||a[0].type!=SAGE_STR)return sage_string(\"\"); char* s=strdup(a[0].as.string); for(int i=0;s[i];i++) s[i]=toupper((unsigned char)s[i]); return sage_string(s); }");
+    aot_emit(aot, "static SageValue s_upper(int c, SageValue* a) { if(c<1||a[0].type!=SAGE_STR)return sage_string(\"\"); SageValue v=sage_string_copy(a[0].as.string); char* s=(char*)v.as.string; for(int i=0;s[i];i++) s[i]=toupper((unsigned char)s[i]); return v; }");
     aot_emit(aot, "#include <dirent.h>");
     aot_emit(aot, "#include <sys/stat.h>");
-    aot_emit(aot, "static SageValue s_listdir(int c, SageValue* a) { if(c<1||a[0].type!=SAGE_STR)return sage_array(0); DIR* d=opendir(a[0].as.string); if(!d)return sage_array(0); SageValue r=sage_array(0); struct dirent* dir; while((dir=readdir(d))!=NULL){if(strcmp(dir->d_name,\".\")!=0&&strcmp(dir->d_name,\"..\")!=0)sage_push(r,sage_string(strdup(dir->d_name)));} closedir(d); return r; }");
+    aot_emit(aot, "static SageValue s_listdir(int c, SageValue* a) { if(c<1||a[0].type!=SAGE_STR)return sage_array(0); DIR* d=opendir(a[0].as.string); if(!d)return sage_array(0); SageValue r=sage_array(0); struct dirent* dir; while((dir=readdir(d))!=NULL){if(strcmp(dir->d_name,\".\")!=0&&strcmp(dir->d_name,\"..\")!=0)sage_push(r,sage_string_copy(dir->d_name));} closedir(d); return r; }");
     aot_emit(aot, "static SageValue s_sys_args_builtin(int c, SageValue* a) { return sage_array(0); }");
     aot_emit(aot, "static SageValue s_isdir(int c, SageValue* a) { if(c<1||a[0].type!=SAGE_STR)return sage_bool(0); struct stat st; if(stat(a[0].as.string,&st)==0)return sage_bool(S_ISDIR(st.st_mode)); return sage_bool(0); }");
     aot_emit(aot, "static SageValue s_exists(int c, SageValue* a) { if(c<1||a[0].type!=SAGE_STR)return sage_bool(0); struct stat st; return sage_bool(stat(a[0].as.string,&st)==0); }");
-    aot_emit(aot, "static SageValue s_readfile(int c, SageValue* a) { if(c<1||a[0].type!=SAGE_STR)return sage_string(\"\"); FILE* f=fopen(a[0].as.string,\"rb\"); if(!f)return sage_string(\"\"); fseek(f,0,SEEK_END); long s=ftell(f); fseek(f,0,SEEK_SET); char* b=malloc(s+1); fread(b,1,s,f); b[s]=0; fclose(f); return sage_string(b); }");
+    aot_emit(aot, "static SageValue s_readfile(int c, SageValue* a) { if(c<1||a[0].type!=SAGE_STR)return sage_string(\"\"); FILE* f=fopen(a[0].as.string,\"rb\"); if(!f)return sage_string(\"\"); fseek(f,0,SEEK_END); long s=ftell(f); fseek(f,0,SEEK_SET); if(s<0)s=0; char* b=sage_gc_string((size_t)s); size_t r=fread(b,1,s,f); b[r]=0; fclose(f); return sage_heap_string(b); }");
     aot_emit(aot, "static SageValue s_writefile(int c, SageValue* a) { if(c<2||a[0].type!=SAGE_STR||a[1].type!=SAGE_STR)return sage_bool(0); FILE* f=fopen(a[0].as.string,\"wb\"); if(!f)return sage_bool(0); size_t w=fwrite(a[1].as.string,1,strlen(a[1].as.string),f); fclose(f); return sage_bool(w==strlen(a[1].as.string)); }");
     aot_emit(aot, "static SageValue s_writebytes(int c, SageValue* a) { return s_writefile(c,a); }");
     aot_emit(aot, "static SageValue s_appendbytes(int c, SageValue* a) { if(c<2||a[0].type!=SAGE_STR||a[1].type!=SAGE_STR)return sage_bool(0); FILE* f=fopen(a[0].as.string,\"ab\"); if(!f)return sage_bool(0); size_t w=fwrite(a[1].as.string,1,strlen(a[1].as.string),f); fclose(f); return sage_bool(w==strlen(a[1].as.string)); }");
@@ -1128,14 +2099,14 @@ char* aot_compile_program(AotCompiler* aot, Stmt* program) {
     aot_emit(aot, "static SageValue s_print(int c, SageValue* a) { for(int i=0;i<c;i++){if(i)printf(\" \");sage_print_value(a[i]);}printf(\"\\n\");fflush(stdout);return sage_nil(); }");
     aot_emit(aot, "static SageValue s_keys(int c, SageValue* a) { if(c<1)return sage_array(0); return sage_dict_keys(a[0]); }");
     aot_emit(aot, "static SageValue s_range(int c, SageValue* a) { int n=0; if(c>0)n=(int)a[0].as.number; if(c>1)n=(int)a[1].as.number-(int)a[0].as.number; return sage_range(n>0?n:0); }");
-    aot_emit(aot, "static SageValue s_input(int c, SageValue* a) { if(c>0&&a[0].type==SAGE_STR) { fputs(a[0].as.string,stdout); fflush(stdout); } char buf[4096]; int pos=0; while(pos<4095){ int ch=getchar(); if(ch==EOF||ch==4){ if(pos==0)return sage_string(\"\\x04\"); break; } if(ch=='\\n'||ch=='\\r'){ printf(\"\\r\\n\"); break; } if(ch==3||ch==27){ buf[pos++]=ch; break; } if(ch==12||ch=='\\t'){ buf[pos++]=ch; break; } if(ch==127||ch=='\\b'){ if(pos>0){ pos--; printf(\"\\b \\b\"); fflush(stdout); } continue; } buf[pos++]=ch; putchar(ch); fflush(stdout); } buf[pos]=0; return sage_string(buf); }");
-    aot_emit(aot, "static SageValue s_split(int c, SageValue* a) { if(c<2||a[0].type!=SAGE_STR||a[1].type!=SAGE_STR)return sage_array(0); SageArr*r=malloc(sizeof(SageArr)); r->cap=16; r->count=0; r->elems=malloc(sizeof(SageValue)*r->cap); char*str=strdup(a[0].as.string); char*tok=strtok(str,a[1].as.string); while(tok){if(r->count>=r->cap){r->cap*=2;r->elems=realloc(r->elems,sizeof(SageValue)*r->cap);}r->elems[r->count++]=sage_string(strdup(tok)); tok=strtok(NULL,a[1].as.string);} free(str); SageValue v;v.type=SAGE_ARR;v.as.ptr=r;return v; }");
-    aot_emit(aot, "static SageValue s_chr(int c, SageValue* a) { if(c<1||a[0].type!=SAGE_NUM)return sage_string(\"\"); char b[2]={(char)a[0].as.number,0}; return sage_string(strdup(b)); }");
-    aot_emit(aot, "static SageValue s_replace(int c, SageValue* a) { if(c<3||a[0].type!=SAGE_STR||a[1].type!=SAGE_STR||a[2].type!=SAGE_STR)return a[0]; const char*str=a[0].as.string; const char*f=a[1].as.string; const char*r=a[2].as.string; if(strlen(f)==0)return a[0]; char*b=malloc(strlen(str)*4+1); b[0]=0; const char*p=str; while(1){const char*m=strstr(p,f); if(!m){strcat(b,p);break;} strncat(b,p,m-p); strcat(b,r); p=m+strlen(f);} SageValue v; v.type=SAGE_STR; v.as.string=b; return v; }");
-    aot_emit(aot, "static SageValue s_strip(int c, SageValue* a) { if(c<1||a[0].type!=SAGE_STR)return sage_string(\"\"); const char*s=a[0].as.string; while(*s==' '||*s=='\\t'||*s=='\\n'||*s=='\\r')s++; if(*s==0)return sage_string(\"\"); const char*e=s+strlen(s)-1; while(e>s&&(*e==' '||*e=='\\t'||*e=='\\n'||*e=='\\r'))e--; char*b=malloc(e-s+2); memcpy(b,s,e-s+1); b[e-s+1]=0; return sage_string(b); }");
+    aot_emit(aot, "static SageValue s_input(int c, SageValue* a) { if(c>0&&a[0].type==SAGE_STR) { fputs(a[0].as.string,stdout); fflush(stdout); } char buf[4096]; int pos=0; while(pos<4095){ int ch=getchar(); if(ch==EOF||ch==4){ if(pos==0)return sage_string(\"\\x04\"); break; } if(ch=='\\n'||ch=='\\r'){ printf(\"\\r\\n\"); break; } if(ch==3||ch==27){ buf[pos++]=ch; break; } if(ch==12||ch=='\\t'){ buf[pos++]=ch; break; } if(ch==127||ch=='\\b'){ if(pos>0){ pos--; printf(\"\\b \\b\"); fflush(stdout); } continue; } buf[pos++]=ch; putchar(ch); fflush(stdout); } buf[pos]=0; return sage_string_copy(buf); }");
+    aot_emit(aot, "static SageValue s_split(int c, SageValue* a) { if(c<2||a[0].type!=SAGE_STR||a[1].type!=SAGE_STR)return sage_array(0); SageValue r=sage_array(0); char*str=strdup(a[0].as.string); char*tok=strtok(str,a[1].as.string); while(tok){sage_push(r,sage_string_copy(tok)); tok=strtok(NULL,a[1].as.string);} free(str); return r; }");
+    aot_emit(aot, "static SageValue s_chr(int c, SageValue* a) { if(c<1||a[0].type!=SAGE_NUM)return sage_string(\"\"); char b[2]={(char)a[0].as.number,0}; return sage_string_copy(b); }");
+    aot_emit(aot, "static SageValue s_replace(int c, SageValue* a) { if(c<3||a[0].type!=SAGE_STR||a[1].type!=SAGE_STR||a[2].type!=SAGE_STR)return a[0]; const char*str=a[0].as.string; const char*f=a[1].as.string; const char*r=a[2].as.string; size_t fl=strlen(f), rl=strlen(r); if(fl==0)return a[0]; size_t n=0; for(const char*p=strstr(str,f);p;p=strstr(p+fl,f)) n++; char*b=sage_gc_string(strlen(str)-n*fl+n*rl); char*o=b; const char*p=str; for(const char*m=strstr(p,f);m;m=strstr(p,f)){memcpy(o,p,m-p); o+=m-p; memcpy(o,r,rl); o+=rl; p=m+fl;} strcpy(o,p); return sage_heap_string(b); }");
+    aot_emit(aot, "static SageValue s_strip(int c, SageValue* a) { if(c<1||a[0].type!=SAGE_STR)return sage_string(\"\"); const char*s=a[0].as.string; while(*s==' '||*s=='\\t'||*s=='\\n'||*s=='\\r')s++; if(*s==0)return sage_string(\"\"); const char*e=s+strlen(s)-1; while(e>s&&(*e==' '||*e=='\\t'||*e=='\\n'||*e=='\\r'))e--; char*b=sage_gc_string(e-s+1); memcpy(b,s,e-s+1); return sage_heap_string(b); }");
     aot_emit(aot, "static SageValue s_clock(int c, SageValue* a) { (void)c; (void)a; struct timeval tv; gettimeofday(&tv, NULL); return sage_number((double)tv.tv_sec + (double)tv.tv_usec / 1000000.0); }");
     aot_emit(aot, "static SageValue s_ord(int c, SageValue* a) { if(c<1||a[0].type!=SAGE_STR||strlen(a[0].as.string)==0)return sage_number(0); return sage_number((unsigned char)a[0].as.string[0]); }");
-    aot_emit(aot, "static void sage_print_value(SageValue v) { switch(v.type) { case SAGE_NUM: { double d=v.as.number; if(d==(double)(long long)d&&d>=-1e15&&d<=1e15) printf(\"%%lld\",(long long)d); else printf(\"%%g\",d); break; } case SAGE_BOOL: fputs(v.as.boolean?\"true\":\"false\",stdout); break; case SAGE_STR: fputs(v.as.string,stdout); break; case SAGE_ARR: { SageArr*a=(SageArr*)v.as.ptr; printf(\"[\"); for(int i=0;i<a->count;i++){if(i)printf(\", \");sage_print_value(a->elems[i]);} printf(\"]\"); break; } case SAGE_DICT: { SageDict*d=(SageDict*)v.as.ptr; printf(\"{\"); for(int i=0;i<d->count;i++){if(i)printf(\", \");printf(\"\\\"%%s\\\": \",d->keys[i]);sage_print_value(d->vals[i]);} printf(\"}\"); break; } default: fputs(\"nil\",stdout); } }");
+    aot_emit(aot, "static void sage_print_value(SageValue v) { switch(v.type) { case SAGE_NUM: { double d=v.as.number; if(d==(double)(long long)d&&d>=-1e15&&d<=1e15) printf(\"%%lld\",(long long)d); else printf(\"%%g\",d); break; } case SAGE_BOOL: fputs(v.as.boolean?\"true\":\"false\",stdout); break; case SAGE_STR: fputs(v.as.string,stdout); break; case SAGE_ARR: { SageArr*a=(SageArr*)v.as.ptr; printf(\"[\"); for(int i=0;i<a->count;i++){if(i)printf(\", \");sage_print_value(a->elems[i]);} printf(\"]\"); break; } case SAGE_DICT: { SageDict*d=(SageDict*)v.as.ptr; int first=1; printf(\"{\"); for(int i=0;i<d->count;i++){if(!d->keys[i])continue; if(!first)printf(\", \"); first=0; printf(\"\\\"%%s\\\": \",d->keys[i]);sage_print_value(d->vals[i]);} printf(\"}\"); break; } default: fputs(\"nil\",stdout); } }");
     aot_emit(aot, "static SageValue s_words(int argc, SageValue* argv);");
     aot_emit(aot, "static SageValue s_compact(int argc, SageValue* argv);");
     aot_emit(aot, "static SageValue s_count_substring(int argc, SageValue* argv);");
@@ -1153,6 +2124,16 @@ char* aot_compile_program(AotCompiler* aot, Stmt* program) {
     int builtin_count = aot->proc_count;
     aot_forward_declare_stmt(aot, program);
     aot_emit(aot, "");
+    char* roots = strdup("&s_current_self");
+    for (int i = 0; i < aot->globals.count; i++) {
+        char* next = aot_format("%s, &%s", roots, aot->globals.locals[i].name);
+        free(roots);
+        roots = next;
+    }
+    aot_emit(aot, "static SageValue* sage_gc_global_roots[] = { %s };", roots);
+    aot_emit(aot, "static void sage_gc_mark_globals(void) { for (size_t i = 0; i < sizeof(sage_gc_global_roots) / sizeof(sage_gc_global_roots[0]); i++) sage_gc_mark_value(*sage_gc_global_roots[i]); }");
+    aot_emit(aot, "");
+    free(roots);
 
     // Emit proc and class definitions
     for (Stmt* s = program; s; s = s->next) {
@@ -1176,6 +2157,10 @@ char* aot_compile_program(AotCompiler* aot, Stmt* program) {
     aot_emit(aot, "int main(void) {");
     aot->in_main = 1;
     aot->indent++;
+    AotFrame frame;
+    aot_frame_open(aot, &frame, 1);
+    frame.is_main = 1;
+    aot_declare_unboxed(aot, program);
 
     // Compile all non-proc/non-class statements (procs and classes already emitted above)
     for (Stmt* s = program; s; s = s->next) {
@@ -1184,6 +2169,7 @@ char* aot_compile_program(AotCompiler* aot, Stmt* program) {
     }
 
     aot_emit(aot, "return 0;");
+    aot_frame_close(aot);
     aot->indent--;
     aot_emit(aot, "}");
 
@@ -1,19 +1,20 @@
 #include <stdlib.h>
 #include <string.h>
 #include "ast.h"
+#include "ast_arena.h"
 #include "gc.h"
 
 // ========== EXPRESSION CONSTRUCTORS ==========
 
 Expr* new_number_expr(double value) {
-    Expr* e = SAGE_ALLOC(sizeof(Expr));
+    Expr* e = ast_alloc(sizeof(Expr));
     e->type = EXPR_NUMBER;
     e->as.number.value = value;
     return e;
 }
 
 Expr* new_binary_expr(Expr* left, Token op, Expr* right) {
-    Expr* e = SAGE_ALLOC(sizeof(Expr));
+    Expr* e = ast_alloc(sizeof(Expr));
     e->type = EXPR_BINARY;
     e->as.binary.left = left;
     e->as.binary.op = op;
@@ -22,7 +23,7 @@ Expr* new_binary_expr(Expr* left, Token op, Expr* right) {
 }
 
 Expr* new_variable_expr(Token name) {
-    Expr* e = SAGE_ALLOC(sizeof(Expr));
+    Expr* e = ast_alloc(sizeof(Expr));
     e->type = EXPR_VARIABLE;
     e->as.variable.name = name;
     e->as.variable.cached_env_id = 0;
@@ -31,44 +32,44 @@ Expr* new_variable_expr(Token name) {
 }
 
 Expr* new_call_expr(Expr* callee, Expr** args, int arg_count) {
-    Expr* e = SAGE_ALLOC(sizeof(Expr));
+    Expr* e = ast_alloc(sizeof(Expr));
     e->type = EXPR_CALL;
     e->as.call.callee = callee;
-    e->as.call.args = args;
+    e->as.call.args = ast_adopt(args, sizeof(Expr*) * (size_t)arg_count);
     e->as.call.arg_count = arg_count;
     return e;
 }
 
 Expr* new_string_expr(char* value) {
-    Expr* e = SAGE_ALLOC(sizeof(Expr));
+    Expr* e = ast_alloc(sizeof(Expr));
     e->type = EXPR_STRING;
-    e->as.string.value = value;
+    e->as.string.value = ast_adopt_string(value);
     return e;
 }
 
 Expr* new_bool_expr(int value) {
-    Expr* e = SAGE_ALLOC(sizeof(Expr));
+    Expr* e = ast_alloc(sizeof(Expr));
     e->type = EXPR_BOOL;
     e->as.boolean.value = value;
     return e;
 }
 
 Expr* new_nil_expr() {
-    Expr* e = SAGE_ALLOC(sizeof(Expr));
+    Expr* e = ast_alloc(sizeof(Expr));
     e->type = EXPR_NIL;
     return e;
 }
 
 Expr* new_array_expr(Expr** elements, int count) {
-    Expr* e = SAGE_ALLOC(sizeof(Expr));
+    Expr* e = ast_alloc(sizeof(Expr));
     e->type = EXPR_ARRAY;
-    e->as.array.elements = elements;
+    e->as.array.elements = ast_adopt(elements, sizeof(Expr*) * (size_t)count);
     e->as.array.count = count;
     return e;
 }
 
 Expr* new_index_expr(Expr* array, Expr* index) {
-    Expr* e = SAGE_ALLOC(sizeof(Expr));
+    Expr* e = ast_alloc(sizeof(Expr));
     e->type = EXPR_INDEX;
     e->as.index.array = array;
     e->as.index.index = index;
@@ -76,7 +77,7 @@ Expr* new_index_expr(Expr* array, Expr* index) {
 }
 
 Expr* new_index_set_expr(Expr* array, Expr* index, Expr* value) {
-    Expr* e = SAGE_ALLOC(sizeof(Expr));
+    Expr* e = ast_alloc(sizeof(Expr));
     e->type = EXPR_INDEX_SET;
     e->as.index_set.array = array;
     e->as.index_set.index = index;
@@ -85,24 +86,27 @@ Expr* new_index_set_expr(Expr* array, Expr* index, Expr* value) {
 }
 
 Expr* new_dict_expr(char** keys, Expr** values, int count) {
-    Expr* e = SAGE_ALLOC(sizeof(Expr));
+    Expr* e = ast_alloc(sizeof(Expr));
     e->type = EXPR_DICT;
-    e->as.dict.keys = keys;
-    e->as.dict.values = values;
+    for (int i = 0; i < count; i++) {
+        keys[i] = ast_adopt_string(keys[i]);
+    }
+    e->as.dict.keys = ast_adopt(keys, sizeof(char*) * (size_t)count);
+    e->as.dict.values = ast_adopt(values, sizeof(Expr*) * (size_t)count);
     e->as.dict.count = count;
     return e;
 }
 
 Expr* new_tuple_expr(Expr** elements, int count) {
-    Expr* e = SAGE_ALLOC(sizeof(Expr));
+    Expr* e = ast_alloc(sizeof(Expr));
     e->type = EXPR_TUPLE;
-    e->as.tuple.elements = elements;
+    e->as.tuple.elements = ast_adopt(elements, sizeof(Expr*) * (size_t)count);
     e->as.tuple.count = count;
     return e;
 }
 
 Expr* new_slice_expr(Expr* array, Expr* start, Expr* end) {
-    Expr* e = SAGE_ALLOC(sizeof(Expr));
+    Expr* e = ast_alloc(sizeof(Expr));
     e->type = EXPR_SLICE;
     e->as.slice.array = array;
     e->as.slice.start = start;
@@ -111,7 +115,7 @@ Expr* new_slice_expr(Expr* array, Expr* start, Expr* end) {
 }
 
 Expr* new_get_expr(Expr* object, Token property) {
-    Expr* e = SAGE_ALLOC(sizeof(Expr));
+    Expr* e = ast_alloc(sizeof(Expr));
     e->type = EXPR_GET;
     e->as.get.object = object;
     e->as.get.property = property;
@@ -119,7 +123,7 @@ Expr* new_get_expr(Expr* object, Token property) {
 }
 
 Expr* new_set_expr(Expr* object, Token property, Expr* value) {
-    Expr* e = SAGE_ALLOC(sizeof(Expr));
+    Expr* e = ast_alloc(sizeof(Expr));
     e->type = EXPR_SET;
     e->as.set.object = object;
     e->as.set.property = property;
@@ -130,30 +134,30 @@ Expr* new_set_expr(Expr* object, Token property, Expr* value) {
 }
 
 Expr* new_await_expr(Expr* expression) {
-    Expr* e = SAGE_ALLOC(sizeof(Expr));
+    Expr* e = ast_alloc(sizeof(Expr));
     e->type = EXPR_AWAIT;
     e->as.await.expression = expression;
     return e;
 }
 
 Expr* new_super_expr(Token method) {
-    Expr* e = SAGE_ALLOC(sizeof(Expr));
+    Expr* e = ast_alloc(sizeof(Expr));
     e->type = EXPR_SUPER;
     e->as.super_expr.method = method;
     return e;
 }
 
 Expr* new_comptime_expr(Expr* expression) {
-    Expr* e = SAGE_ALLOC(sizeof(Expr));
+    Expr* e = ast_alloc(sizeof(Expr));
     e->type = EXPR_COMPTIME;
     e->as.comptime.expression = expression;
     return e;
 }
 
 Expr* new_proc_expr(Token* params, int param_count, Stmt* body) {
-    Expr* e = SAGE_ALLOC(sizeof(Expr));
+    Expr* e = ast_alloc(sizeof(Expr));
     e->type = EXPR_PROC;
-    e->as.proc_expr.params = params;
+    e->as.proc_expr.params = ast_adopt(params, sizeof(Token) * (size_t)param_count);
     e->as.proc_expr.param_count = param_count;
     e->as.proc_expr.body = body;
     return e;
@@ -162,7 +166,7 @@ Expr* new_proc_expr(Token* params, int param_count, Stmt* body) {
 // ========== STATEMENT CONSTRUCTORS ==========
 
 Stmt* new_print_stmt(Expr* expression) {
-    Stmt* s = SAGE_ALLOC(sizeof(Stmt));
+    Stmt* s = ast_alloc(sizeof(Stmt));
     s->type = STMT_PRINT;
     s->as.print.expression = expression;
     s->next = NULL;
@@ -171,7 +175,7 @@ Stmt* new_print_stmt(Expr* expression) {
 }
 
 Stmt* new_expr_stmt(Expr* expression) {
-    Stmt* s = SAGE_ALLOC(sizeof(Stmt));
+    Stmt* s = ast_alloc(sizeof(Stmt));
     s->type = STMT_EXPRESSION;
     s->as.expression = expression;
     s->next = NULL;
@@ -180,7 +184,7 @@ Stmt* new_expr_stmt(Expr* expression) {
 }
 
 Stmt* new_let_stmt(Token name, Expr* initializer) {
-    Stmt* s = SAGE_ALLOC(sizeof(Stmt));
+    Stmt* s = ast_alloc(sizeof(Stmt));
     s->type = STMT_LET;
     s->as.let.name = name;
     s->as.let.type_ann = NULL;
@@ -191,7 +195,7 @@ Stmt* new_let_stmt(Token name, Expr* initializer) {
 }
 
 Stmt* new_if_stmt(Expr* condition, Stmt* then_branch, Stmt* else_branch) {
-    Stmt* s = SAGE_ALLOC(sizeof(Stmt));
+    Stmt* s = ast_alloc(sizeof(Stmt));
     s->type = STMT_IF;
     s->as.if_stmt.condition = condition;
     s->as.if_stmt.then_branch = then_branch;
@@ -202,18 +206,19 @@ Stmt* new_if_stmt(Expr* condition, Stmt* then_branch, Stmt* else_branch) {
 }
 
 Stmt* new_for_stmt(Token variable, Expr* iterable, Stmt* body) {
-    Stmt* s = SAGE_ALLOC(sizeof(Stmt));
+    Stmt* s = ast_alloc(sizeof(Stmt));
     s->type = STMT_FOR;
     s->as.for_stmt.variable = variable;
     s->as.for_stmt.iterable = iterable;
     s->as.for_stmt.body = body;
+    s->as.for_stmt.counted = 0;
     s->next = NULL;
     s->pragmas = NULL;
     return s;
 }
 
 Stmt* new_block_stmt(Stmt* statements) {
-    Stmt* s = SAGE_ALLOC(sizeof(Stmt));
+    Stmt* s = ast_alloc(sizeof(Stmt));
     s->type = STMT_BLOCK;
     s->as.block.statements = statements;
     s->next = NULL;
@@ -222,7 +227,7 @@ Stmt* new_block_stmt(Stmt* statements) {
 }
 
 Stmt* new_while_stmt(Expr* condition, Stmt* body) {
-    Stmt* s = SAGE_ALLOC(sizeof(Stmt));
+    Stmt* s = ast_alloc(sizeof(Stmt));
     s->type = STMT_WHILE;
     s->as.while_stmt.condition = condition;
     s->as.while_stmt.body = body;
@@ -232,19 +237,19 @@ Stmt* new_while_stmt(Expr* condition, Stmt* body) {
 }
 
 TypeAnnotation* new_type_annotation(Token name, TypeAnnotation** params, int param_count, int is_optional) {
-    TypeAnnotation* t = SAGE_ALLOC(sizeof(TypeAnnotation));
+    TypeAnnotation* t = ast_alloc(sizeof(TypeAnnotation));
     t->name = name;
-    t->params = params;
+    t->params = ast_adopt(params, sizeof(TypeAnnotation*) * (size_t)param_count);
     t->param_count = param_count;
     t->is_optional = is_optional;
     return t;
 }
 
 Stmt* new_proc_stmt(Token name, Token* params, int param_count, Stmt* body) {
-    Stmt* s = SAGE_ALLOC(sizeof(Stmt));
+    Stmt* s = ast_alloc(sizeof(Stmt));
     s->type = STMT_PROC;
     s->as.proc.name = name;
-    s->as.proc.params = params;
+    s->as.proc.params = ast_adopt(params, sizeof(Token) * (size_t)param_count);
     s->as.proc.param_types = NULL;
     s->as.proc.defaults = NULL;
     s->as.proc.param_count = param_count;
@@ -260,7 +265,7 @@ Stmt* new_proc_stmt(Token name, Token* params, int param_count, Stmt* body) {
 }
 
 Stmt* new_return_stmt(Expr* value) {
-    Stmt* s = SAGE_ALLOC(sizeof(Stmt));
+    Stmt* s = ast_alloc(sizeof(Stmt));
     s->type = STMT_RETURN;
     s->as.ret.value = value;
     s->next = NULL;
@@ -269,7 +274,7 @@ Stmt* new_return_stmt(Expr* value) {
 }
 
 Stmt* new_break_stmt() {
-    Stmt* s = SAGE_ALLOC(sizeof(Stmt));
+    Stmt* s = ast_alloc(sizeof(Stmt));
     s->type = STMT_BREAK;
     s->next = NULL;
     s->pragmas = NULL;
@@ -277,7 +282,7 @@ Stmt* new_break_stmt() {
 }
 
 Stmt* new_continue_stmt() {
-    Stmt* s = SAGE_ALLOC(sizeof(Stmt));
+    Stmt* s = ast_alloc(sizeof(Stmt));
     s->type = STMT_CONTINUE;
     s->next = NULL;
     s->pragmas = NULL;
@@ -285,7 +290,7 @@ Stmt* new_continue_stmt() {
 }
 
 Stmt* new_class_stmt(Token name, Token parent, int has_parent, Stmt* methods) {
-    Stmt* s = SAGE_ALLOC(sizeof(Stmt));
+    Stmt* s = ast_alloc(sizeof(Stmt));
     s->type = STMT_CLASS;
     s->as.class_stmt.name = name;
     s->as.class_stmt.parent = parent;
@@ -297,11 +302,11 @@ Stmt* new_class_stmt(Token name, Token parent, int has_parent, Stmt* methods) {
 }
 
 Stmt* new_struct_stmt(Token name, Token* field_names, TypeAnnotation** field_types, int field_count) {
-    Stmt* s = SAGE_ALLOC(sizeof(Stmt));
+    Stmt* s = ast_alloc(sizeof(Stmt));
     s->type = STMT_STRUCT;
     s->as.struct_stmt.name = name;
-    s->as.struct_stmt.field_names = field_names;
-    s->as.struct_stmt.field_types = field_types;
+    s->as.struct_stmt.field_names = ast_adopt(field_names, sizeof(Token) * (size_t)field_count);
+    s->as.struct_stmt.field_types = ast_adopt(field_types, sizeof(TypeAnnotation*) * (size_t)field_count);
     s->as.struct_stmt.field_count = field_count;
     s->as.struct_stmt.type_params = NULL;
     s->as.struct_stmt.type_param_count = 0;
@@ -311,10 +316,10 @@ Stmt* new_struct_stmt(Token name, Token* field_names, TypeAnnotation** field_typ
 }
 
 Stmt* new_enum_stmt(Token name, Token* variant_names, int variant_count) {
-    Stmt* s = SAGE_ALLOC(sizeof(Stmt));
+    Stmt* s = ast_alloc(sizeof(Stmt));
     s->type = STMT_ENUM;
     s->as.enum_stmt.name = name;
-    s->as.enum_stmt.variant_names = variant_names;
+    s->as.enum_stmt.variant_names = ast_adopt(variant_names, sizeof(Token) * (size_t)variant_count);
     s->as.enum_stmt.variant_count = variant_count;
     s->next = NULL;
     s->pragmas = NULL;
@@ -322,7 +327,7 @@ Stmt* new_enum_stmt(Token name, Token* variant_names, int variant_count) {
 }
 
 Stmt* new_trait_stmt(Token name, Stmt* methods) {
-    Stmt* s = SAGE_ALLOC(sizeof(Stmt));
+    Stmt* s = ast_alloc(sizeof(Stmt));
     s->type = STMT_TRAIT;
     s->as.trait_stmt.name = name;
     s->as.trait_stmt.methods = methods;
@@ -334,7 +339,7 @@ Stmt* new_trait_stmt(Token name, Stmt* methods) {
 // ========== PHASE 7: MATCH EXPRESSION ==========
 
 CaseClause* new_case_clause(Expr* pattern, Stmt* body) {
-    CaseClause* c = SAGE_ALLOC(sizeof(CaseClause));
+    CaseClause* c = ast_alloc(sizeof(CaseClause));
     c->pattern = pattern;
     c->guard = NULL;
     c->body = body;
@@ -342,10 +347,10 @@ CaseClause* new_case_clause(Expr* pattern, Stmt* body) {
 }
 
 Stmt* new_match_stmt(Expr* value, CaseClause** cases, int case_count, Stmt* default_case) {
-    Stmt* s = SAGE_ALLOC(sizeof(Stmt));
+    Stmt* s = ast_alloc(sizeof(Stmt));
     s->type = STMT_MATCH;
     s->as.match_stmt.value = value;
-    s->as.match_stmt.cases = cases;
+    s->as.match_stmt.cases = ast_adopt(cases, sizeof(CaseClause*) * (size_t)case_count);
     s->as.match_stmt.case_count = case_count;
     s->as.match_stmt.default_case = default_case;
     s->next = NULL;
@@ -356,7 +361,7 @@ Stmt* new_match_stmt(Expr* value, CaseClause** cases, int case_count, Stmt* defa
 // ========== PHASE 7: DEFER STATEMENT ==========
 
 Stmt* new_defer_stmt(Stmt* statement) {
-    Stmt* s = SAGE_ALLOC(sizeof(Stmt));
+    Stmt* s = ast_alloc(sizeof(Stmt));
     s->type = STMT_DEFER;
     s->as.defer.statement = statement;
     s->next = NULL;
@@ -367,17 +372,17 @@ Stmt* new_defer_stmt(Stmt* statement) {
 // ========== PHASE 7: EXCEPTION HANDLING ==========
 
 CatchClause* new_catch_clause(Token exception_var, Stmt* body) {
-    CatchClause* c = SAGE_ALLOC(sizeof(CatchClause));
+    CatchClause* c = ast_alloc(sizeof(CatchClause));
     c->exception_var = exception_var;
     c->body = body;
     return c;
 }
 
 Stmt* new_try_stmt(Stmt* try_block, CatchClause** catches, int catch_count, Stmt* finally_block) {
-    Stmt* s = SAGE_ALLOC(sizeof(Stmt));
+    Stmt* s = ast_alloc(sizeof(Stmt));
     s->type = STMT_TRY;
     s->as.try_stmt.try_block = try_block;
-    s->as.try_stmt.catches = catches;
+    s->as.try_stmt.catches = ast_adopt(catches, sizeof(CatchClause*) * (size_t)catch_count);
     s->as.try_stmt.catch_count = catch_count;
     s->as.try_stmt.finally_block = finally_block;
     s->next = NULL;
@@ -386,7 +391,7 @@ Stmt* new_try_stmt(Stmt* try_block, CatchClause** catches, int catch_count, Stmt
 }
 
 Stmt* new_raise_stmt(Expr* exception) {
-    Stmt* s = SAGE_ALLOC(sizeof(Stmt));
+    Stmt* s = ast_alloc(sizeof(Stmt));
     s->type = STMT_RAISE;
     s->as.raise.exception = exception;
     s->next = NULL;
@@ -397,7 +402,7 @@ Stmt* new_raise_stmt(Expr* exception) {
 // ========== PHASE 7: GENERATORS (YIELD) ==========
 
 Stmt* new_yield_stmt(Expr* value) {
-    Stmt* s = SAGE_ALLOC(sizeof(Stmt));
+    Stmt* s = ast_alloc(sizeof(Stmt));
     s->type = STMT_YIELD;
     s->as.yield_stmt.value = value;
     s->next = NULL;
@@ -408,13 +413,17 @@ Stmt* new_yield_stmt(Expr* value) {
 // ========== PHASE 8: MODULE IMPORTS ==========
 
 Stmt* new_import_stmt(char* module_name, char** items, char** item_aliases, int item_count, char* alias, int import_all) {
-    Stmt* stmt = SAGE_ALLOC(sizeof(Stmt));
+    Stmt* stmt = ast_alloc(sizeof(Stmt));
     stmt->type = STMT_IMPORT;
-    stmt->as.import.module_name = module_name;
-    stmt->as.import.items = items;
-    stmt->as.import.item_aliases = item_aliases;
+    for (int i = 0; i < item_count; i++) {
+        items[i] = ast_adopt_string(items[i]);
+        item_aliases[i] = ast_adopt_string(item_aliases[i]);
+    }
+    stmt->as.import.module_name = ast_adopt_string(module_name);
+    stmt->as.import.items = ast_adopt(items, sizeof(char*) * (size_t)item_count);
+    stmt->as.import.item_aliases = ast_adopt(item_aliases, sizeof(char*) * (size_t)item_count);
     stmt->as.import.item_count = item_count;
-    stmt->as.import.alias = alias;
+    stmt->as.import.alias = ast_adopt_string(alias);
     stmt->as.import.import_all = import_all;
     stmt->next = NULL;
     stmt->pragmas = NULL;
@@ -422,10 +431,10 @@ Stmt* new_import_stmt(char* module_name, char** items, char** item_aliases, int
 }
 
 Stmt* new_async_proc_stmt(Token name, Token* params, int param_count, Stmt* body) {
-    Stmt* s = SAGE_ALLOC(sizeof(Stmt));
+    Stmt* s = ast_alloc(sizeof(Stmt));
     s->type = STMT_ASYNC_PROC;
     s->as.async_proc.name = name;
-    s->as.async_proc.params = params;
+    s->as.async_proc.params = ast_adopt(params, sizeof(Token) * (size_t)param_count);
     s->as.async_proc.param_types = NULL;
     s->as.async_proc.defaults = NULL;
     s->as.async_proc.param_count = param_count;
@@ -443,9 +452,12 @@ Stmt* new_async_proc_stmt(Token name, Token* params, int param_count, Stmt* body
 // ========== PHASE 17: METAPROGRAMMING ==========
 
 Pragma* new_pragma(char* name, char** args, int arg_count) {
-    Pragma* p = SAGE_ALLOC(sizeof(Pragma));
-    p->name = name;
-    p->args = args;
+    Pragma* p = ast_alloc(sizeof(Pragma));
+    for (int i = 0; i < arg_count; i++) {
+        args[i] = ast_adopt_string(args[i]);
+    }
+    p->name = ast_adopt_string(name);
+    p->args = ast_adopt(args, sizeof(char*) * (size_t)arg_count);
     p->arg_count = arg_count;
     p->next = NULL;
     return p;
@@ -454,18 +466,18 @@ Pragma* new_pragma(char* name, char** args, int arg_count) {
 void free_pragma(Pragma* pragma) {
     while (pragma != NULL) {
         Pragma* next = pragma->next;
-        free(pragma->name);
+        ast_free(pragma->name);
         for (int i = 0; i < pragma->arg_count; i++) {
-            free(pragma->args[i]);
+            ast_free(pragma->args[i]);
         }
-        free(pragma->args);
-        free(pragma);
+        ast_free(pragma->args);
+        ast_free(pragma);
         pragma = next;
     }
 }
 
 Stmt* new_comptime_stmt(Stmt* body) {
-    Stmt* s = SAGE_ALLOC(sizeof(Stmt));
+    Stmt* s = ast_alloc(sizeof(Stmt));
     s->type = STMT_COMPTIME;
     s->as.comptime.body = body;
     s->next = NULL;
@@ -474,10 +486,10 @@ Stmt* new_comptime_stmt(Stmt* body) {
 }
 
 Stmt* new_macro_def_stmt(Token name, Token* params, int param_count, Stmt* body) {
-    Stmt* s = SAGE_ALLOC(sizeof(Stmt));
+    Stmt* s = ast_alloc(sizeof(Stmt));
     s->type = STMT_MACRO_DEF;
     s->as.macro_def.name = name;
-    s->as.macro_def.params = params;
+    s->as.macro_def.params = ast_adopt(params, sizeof(Token) * (size_t)param_count);
     s->as.macro_def.param_count = param_count;
     s->as.macro_def.body = body;
     s->next = NULL;
@@ -492,7 +504,7 @@ static void free_case_clause(CaseClause* clause) {
 
     free_expr(clause->pattern);
     free_stmt(clause->body);
-    free(clause);
+    ast_free(clause);
 }
 
 static void free_catch_clause(CatchClause* clause) {
@@ -501,7 +513,7 @@ static void free_catch_clause(CatchClause* clause) {
     }
 
     free_stmt(clause->body);
-    free(clause);
+    ast_free(clause);
 }
 
 void free_expr(Expr* expr) {
@@ -511,7 +523,7 @@ void free_expr(Expr* expr) {
 
     switch (expr->type) {
         case EXPR_STRING:
-            free(expr->as.string.value);
+            ast_free(expr->as.string.value);
             break;
         case EXPR_BINARY:
             free_expr(expr->as.binary.left);
@@ -522,13 +534,13 @@ void free_expr(Expr* expr) {
             for (int i = 0; i < expr->as.call.arg_count; i++) {
                 free_expr(expr->as.call.args[i]);
             }
-            free(expr->as.call.args);
+            ast_free(expr->as.call.args);
             break;
         case EXPR_ARRAY:
             for (int i = 0; i < expr->as.array.count; i++) {
                 free_expr(expr->as.array.elements[i]);
             }
-            free(expr->as.array.elements);
+            ast_free(expr->as.array.elements);
             break;
         case EXPR_INDEX:
             free_expr(expr->as.index.array);
@@ -541,17 +553,17 @@ void free_expr(Expr* expr) {
             break;
         case EXPR_DICT:
             for (int i = 0; i < expr->as.dict.count; i++) {
-                free(expr->as.dict.keys[i]);
+                ast_free(expr->as.dict.keys[i]);
                 free_expr(expr->as.dict.values[i]);
             }
-            free(expr->as.dict.keys);
-            free(expr->as.dict.values);
+            ast_free(expr->as.dict.keys);
+            ast_free(expr->as.dict.values);
             break;
         case EXPR_TUPLE:
             for (int i = 0; i < expr->as.tuple.count; i++) {
                 free_expr(expr->as.tuple.elements[i]);
             }
-            free(expr->as.tuple.elements);
+            ast_free(expr->as.tuple.elements);
             break;
         case EXPR_SLICE:
             free_expr(expr->as.slice.array);
@@ -572,7 +584,7 @@ void free_expr(Expr* expr) {
             free_expr(expr->as.comptime.expression);
             break;
         case EXPR_PROC:
-            free(expr->as.proc_expr.params);
+            ast_free(expr->as.proc_expr.params);
             free_stmt(expr->as.proc_expr.body);
             break;
         case EXPR_NUMBER:
@@ -583,7 +595,7 @@ void free_expr(Expr* expr) {
             break;
     }
 
-    free(expr);
+    ast_free(expr);
 }
 
 void free_stmt(Stmt* stmt) {
@@ -613,16 +625,16 @@ void free_stmt(Stmt* stmt) {
                 free_stmt(stmt->as.while_stmt.body);
                 break;
             case STMT_PROC:
-                free(stmt->as.proc.params);
+                ast_free(stmt->as.proc.params);
                 if (stmt->as.proc.defaults) {
                     for (int i = 0; i < stmt->as.proc.param_count; i++) {
                         free_expr(stmt->as.proc.defaults[i]);
                     }
-                    free(stmt->as.proc.defaults);
+                    ast_free(stmt->as.proc.defaults);
                 }
-                free(stmt->as.proc.param_types);  // TypeAnnotation** (shallow)
-                free(stmt->as.proc.type_params);
-                free(stmt->as.proc.doc);
+                ast_free(stmt->as.proc.param_types);  // TypeAnnotation** (shallow)
+                ast_free(stmt->as.proc.type_params);
+                ast_free(stmt->as.proc.doc);
                 free_stmt(stmt->as.proc.body);
                 break;
             case STMT_FOR:
@@ -640,7 +652,7 @@ void free_stmt(Stmt* stmt) {
                 for (int i = 0; i < stmt->as.match_stmt.case_count; i++) {
                     free_case_clause(stmt->as.match_stmt.cases[i]);
                 }
-                free(stmt->as.match_stmt.cases);
+                ast_free(stmt->as.match_stmt.cases);
                 free_stmt(stmt->as.match_stmt.default_case);
                 break;
             case STMT_DEFER:
@@ -651,7 +663,7 @@ void free_stmt(Stmt* stmt) {
                 for (int i = 0; i < stmt->as.try_stmt.catch_count; i++) {
                     free_catch_clause(stmt->as.try_stmt.catches[i]);
                 }
-                free(stmt->as.try_stmt.catches);
+                ast_free(stmt->as.try_stmt.catches);
                 free_stmt(stmt->as.try_stmt.finally_block);
                 break;
             case STMT_RAISE:
@@ -661,45 +673,45 @@ void free_stmt(Stmt* stmt) {
                 free_expr(stmt->as.yield_stmt.value);
                 break;
             case STMT_IMPORT:
-                free(stmt->as.import.module_name);
+                ast_free(stmt->as.import.module_name);
                 for (int i = 0; i < stmt->as.import.item_count; i++) {
-                    free(stmt->as.import.items[i]);
-                    free(stmt->as.import.item_aliases[i]);
+                    ast_free(stmt->as.import.items[i]);
+                    ast_free(stmt->as.import.item_aliases[i]);
                 }
-                free(stmt->as.import.items);
-                free(stmt->as.import.item_aliases);
-                free(stmt->as.import.alias);
+                ast_free(stmt->as.import.items);
+                ast_free(stmt->as.import.item_aliases);
+                ast_free(stmt->as.import.alias);
                 break;
             case STMT_ASYNC_PROC:
-                free(stmt->as.async_proc.params);
+                ast_free(stmt->as.async_proc.params);
                 if (stmt->as.async_proc.defaults) {
                     for (int i = 0; i < stmt->as.async_proc.param_count; i++) {
                         free_expr(stmt->as.async_proc.defaults[i]);
                     }
-                    free(stmt->as.async_proc.defaults);
+                    ast_free(stmt->as.async_proc.defaults);
                 }
-                free(stmt->as.async_proc.param_types);
-                free(stmt->as.async_proc.type_params);
-                free(stmt->as.async_proc.doc);
+                ast_free(stmt->as.async_proc.param_types);
+                ast_free(stmt->as.async_proc.type_params);
+                ast_free(stmt->as.async_proc.doc);
                 free_stmt(stmt->as.async_proc.body);
                 break;
             case STMT_COMPTIME:
                 free_stmt(stmt->as.comptime.body);
                 break;
             case STMT_MACRO_DEF:
-                free(stmt->as.macro_def.params);
+                ast_free(stmt->as.macro_def.params);
                 free_stmt(stmt->as.macro_def.body);
                 break;
             case STMT_BREAK:
             case STMT_CONTINUE:
                 break;
             case STMT_STRUCT:
-                free(stmt->as.struct_stmt.field_names);
-                free(stmt->as.struct_stmt.field_types);  // TypeAnnotation** (shallow)
-                free(stmt->as.struct_stmt.type_params);
+                ast_free(stmt->as.struct_stmt.field_names);
+                ast_free(stmt->as.struct_stmt.field_types);  // TypeAnnotation** (shallow)
+                ast_free(stmt->as.struct_stmt.type_params);
                 break;
             case STMT_ENUM:
-                free(stmt->as.enum_stmt.variant_names);
+                ast_free(stmt->as.enum_stmt.variant_names);
                 break;
             case STMT_TRAIT:
                 free_stmt(stmt->as.trait_stmt.methods);
@@ -707,7 +719,7 @@ void free_stmt(Stmt* stmt) {
         }
 
         free_pragma(stmt->pragmas);
-        free(stmt);
+        ast_free(stmt);
         stmt = next;
     }
 }
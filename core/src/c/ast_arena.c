@@ -0,0 +1,366 @@
+// src/ast_arena.c
+// Bump allocator for AST nodes. See include/ast_arena.h.
+#include "ast_arena.h"
+#include "gc.h"
+#include "sage_thread.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_FIRST_CHUNK  (64 * 1024)
+#define ARENA_MAX_CHUNK    (1024 * 1024)
+#define ARENA_ALIGN        8
+#define INTERN_MIN_SLOTS   256
+
+typedef struct AstChunk {
+    struct AstChunk* next;
+    size_t size;
+    size_t used;
+    _Alignas(ARENA_ALIGN) unsigned char data[];
+} AstChunk;
+
+typedef struct {
+    const char* str;
+    uint32_t length;
+    uint32_t hash;
+} InternSlot;
+
+struct AstArena {
+    AstChunk* chunks;         // Newest first; allocation happens in chunks->data
+    size_t next_chunk_size;
+    size_t bytes;
+    InternSlot* interned;     // Open-addressed identifier table
+    size_t intern_count;
+    size_t intern_capacity;
+    struct AstArena* next_live;
+    struct AstArena* outer;   // Active before ast_arena_begin()
+};
+
+#ifdef SAGE_BARE_METAL
+static AstArena* g_active_arena = NULL;
+static AstTrack* g_track = NULL;
+#else
+static __thread AstArena* g_active_arena = NULL;
+static __thread AstTrack* g_track = NULL;
+#endif
+
+static void track_add(void* ptr);
+static void track_forget(void* ptr);
+
+// Live arenas, so ast_free() can tell arena blocks from heap blocks no matter
+// which thread or scope frees them. The count keeps heap-only runs (the
+// interpreter) off the lock entirely.
+static AstArena* g_live_arenas = NULL;
+static sage_atomic_t g_live_count = { 0 };
+static sage_mutex_t g_live_lock = SAGE_MUTEX_INITIALIZER;
+
+AstArena* ast_arena_create(void) {
+    AstArena* arena = SAGE_ALLOC(sizeof(AstArena));
+    arena->next_chunk_size = ARENA_FIRST_CHUNK;
+    sage_mutex_lock(&g_live_lock);
+    arena->next_live = g_live_arenas;
+    g_live_arenas = arena;
+    sage_atomic_add(&g_live_count, 1);
+    sage_mutex_unlock(&g_live_lock);
+    return arena;
+}
+
+void ast_arena_destroy(AstArena* arena) {
+    if (arena == NULL) return;
+    sage_mutex_lock(&g_live_lock);
+    for (AstArena** link = &g_live_arenas; *link != NULL; link = &(*link)->next_live) {
+        if (*link == arena) {
+            *link = arena->next_live;
+            sage_atomic_sub(&g_live_count, 1);
+            break;
+        }
+    }
+    sage_mutex_unlock(&g_live_lock);
+
+    AstChunk* chunk = arena->chunks;
+    while (chunk != NULL) {
+        AstChunk* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    free(arena->interned);
+    free(arena);
+}
+
+AstArena* ast_arena_activate(AstArena* arena) {
+    AstArena* previous = g_active_arena;
+    g_active_arena = arena;
+    return previous;
+}
+
+AstArena* ast_arena_begin(void) {
+    AstArena* arena = ast_arena_create();
+    arena->outer = ast_arena_activate(arena);
+    return arena;
+}
+
+void ast_arena_end(AstArena* arena) {
+    if (arena == NULL) return;
+    ast_arena_activate(arena->outer);
+    ast_arena_destroy(arena);
+}
+
+size_t ast_arena_bytes(const AstArena* arena) {
+    return arena != NULL ? arena->bytes : 0;
+}
+
+static int arena_owns(const AstArena* arena, const void* ptr) {
+    const unsigned char* p = ptr;
+    for (const AstChunk* chunk = arena->chunks; chunk != NULL; chunk = chunk->next) {
+        if (p >= chunk->data && p < chunk->data + chunk->size) return 1;
+    }
+    return 0;
+}
+
+static void* arena_alloc(AstArena* arena, size_t size) {
+    size = (size + (ARENA_ALIGN - 1)) & ~(size_t)(ARENA_ALIGN - 1);
+    AstChunk* chunk = arena->chunks;
+    if (chunk == NULL || chunk->size - chunk->used < size) {
+        size_t chunk_size = arena->next_chunk_size;
+        if (size > chunk_size / 4) {
+            // Oversized block: give it its own chunk behind the current one
+            // so the bump pointer keeps filling the partially used chunk.
+            AstChunk* big = SAGE_ALLOC(sizeof(AstChunk) + size);
+            big->size = size;
+            big->used = size;
+            if (chunk != NULL) {
+                big->next = chunk->next;
+                chunk->next = big;
+            } else {
+                arena->chunks = big;
+            }
+            arena->bytes += size;
+            return big->data;
+        }
+        // Chunks come from calloc, so everything carved from them is zeroed.
+        chunk = SAGE_ALLOC(sizeof(AstChunk) + chunk_size);
+        chunk->size = chunk_size;
+        chunk->next = arena->chunks;
+        arena->chunks = chunk;
+        if (arena->next_chunk_size < ARENA_MAX_CHUNK) arena->next_chunk_size *= 2;
+    }
+    void* ptr = chunk->data + chunk->used;
+    chunk->used += size;
+    arena->bytes += size;
+    return ptr;
+}
+
+void* ast_alloc(size_t size) {
+    if (g_active_arena != NULL) {
+        return arena_alloc(g_active_arena, size);
+    }
+    return ast_malloc(size);
+}
+
+void* ast_adopt(void* ptr, size_t size) {
+    AstArena* arena = g_active_arena;
+    if (ptr == NULL) {
+        return NULL;
+    }
+    if (arena == NULL) {
+        track_add(ptr);  // Mostly already tracked; the set keeps one entry
+        return ptr;
+    }
+    if (arena_owns(arena, ptr)) {
+        return ptr;
+    }
+    track_forget(ptr);
+    if (size == 0) {
+        free(ptr);  // Spare capacity behind an empty list
+        return NULL;
+    }
+    void* copy = arena_alloc(arena, size);
+    memcpy(copy, ptr, size);
+    free(ptr);
+    return copy;
+}
+
+char* ast_adopt_string(char* str) {
+    if (g_active_arena == NULL || str == NULL) {
+        track_add(str);
+        return str;
+    }
+    return ast_adopt(str, strlen(str) + 1);
+}
+
+static uint32_t intern_hash(const char* str, size_t length) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char)str[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static void intern_grow(AstArena* arena) {
+    size_t capacity = arena->intern_capacity ? arena->intern_capacity * 2 : INTERN_MIN_SLOTS;
+    InternSlot* slots = SAGE_ALLOC(sizeof(InternSlot) * capacity);
+    for (size_t i = 0; i < arena->intern_capacity; i++) {
+        InternSlot* old = &arena->interned[i];
+        if (old->str == NULL) continue;
+        size_t index = old->hash & (capacity - 1);
+        while (slots[index].str != NULL) index = (index + 1) & (capacity - 1);
+        slots[index] = *old;
+    }
+    free(arena->interned);
+    arena->interned = slots;
+    arena->intern_capacity = capacity;
+}
+
+char* ast_strndup(const char* str, size_t length) {
+    AstArena* arena = g_active_arena;
+    if (arena == NULL) {
+        char* copy = ast_malloc(length + 1);
+        memcpy(copy, str, length);
+        copy[length] = '\0';
+        return copy;
+    }
+
+    if ((arena->intern_count + 1) * 10 > arena->intern_capacity * 7) {
+        intern_grow(arena);
+    }
+    uint32_t hash = intern_hash(str, length);
+    size_t mask = arena->intern_capacity - 1;
+    size_t index = hash & mask;
+    for (;;) {
+        InternSlot* slot = &arena->interned[index];
+        if (slot->str == NULL) break;
+        if (slot->hash == hash && slot->length == length && memcmp(slot->str, str, length) == 0) {
+            return (char*)slot->str;
+        }
+        index = (index + 1) & mask;
+    }
+
+    char* copy = arena_alloc(arena, length + 1);
+    memcpy(copy, str, length);
+    InternSlot* slot = &arena->interned[index];
+    slot->str = copy;
+    slot->length = (uint32_t)length;
+    slot->hash = hash;
+    arena->intern_count++;
+    return copy;
+}
+
+void ast_free(void* ptr) {
+    if (ptr == NULL) return;
+    if (g_active_arena != NULL && arena_owns(g_active_arena, ptr)) return;
+    if (sage_atomic_load(&g_live_count) > 0) {
+        int owned = 0;
+        sage_mutex_lock(&g_live_lock);
+        for (AstArena* arena = g_live_arenas; arena != NULL && !owned; arena = arena->next_live) {
+            owned = arena_owns(arena, ptr);
+        }
+        sage_mutex_unlock(&g_live_lock);
+        if (owned) return;
+    }
+    track_forget(ptr);
+    free(ptr);
+}
+
+// ============================================================================
+// Tracking for recovering parses
+// ============================================================================
+
+#define TRACK_TOMBSTONE ((void*)1)
+#define TRACK_MIN_SLOTS 256
+
+static size_t track_slot(const AstTrack* track, const void* ptr) {
+    uint64_t h = (uint64_t)(uintptr_t)ptr * 0x9E3779B97F4A7C15ULL;
+    return (size_t)(h >> 32) & (track->capacity - 1);
+}
+
+static void track_insert(AstTrack* track, void* ptr);
+
+static void track_grow(AstTrack* track) {
+    void** old = track->slots;
+    size_t old_capacity = track->capacity;
+    // Rehashing drops tombstones, so only grow when live entries need it
+    size_t live = 0;
+    for (size_t i = 0; i < old_capacity; i++) {
+        if (old[i] != NULL && old[i] != TRACK_TOMBSTONE) live++;
+    }
+    size_t capacity = old_capacity ? old_capacity : TRACK_MIN_SLOTS;
+    while ((live + 1) * 2 > capacity) capacity *= 2;
+    track->slots = SAGE_ALLOC(sizeof(void*) * capacity);
+    track->capacity = capacity;
+    track->used = 0;
+    for (size_t i = 0; i < old_capacity; i++) {
+        if (old[i] != NULL && old[i] != TRACK_TOMBSTONE) track_insert(track, old[i]);
+    }
+    free(old);
+}
+
+static void track_insert(AstTrack* track, void* ptr) {
+    if ((track->used + 1) * 4 > track->capacity * 3) track_grow(track);
+    size_t mask = track->capacity - 1;
+    size_t i = track_slot(track, ptr);
+    size_t reuse = track->capacity;
+    while (track->slots[i] != NULL) {
+        if (track->slots[i] == ptr) return;
+        if (track->slots[i] == TRACK_TOMBSTONE && reuse == track->capacity) reuse = i;
+        i = (i + 1) & mask;
+    }
+    if (reuse != track->capacity) {
+        track->slots[reuse] = ptr;
+    } else {
+        track->slots[i] = ptr;
+        track->used++;
+    }
+}
+
+static void track_add(void* ptr) {
+    if (g_track != NULL && ptr != NULL) track_insert(g_track, ptr);
+}
+
+// The block is being freed or moved into an arena; forget it in every
+// enclosing tracker so a later release cannot free it twice.
+static void track_forget(void* ptr) {
+    for (AstTrack* track = g_track; track != NULL; track = track->outer) {
+        if (track->capacity == 0) continue;
+        size_t mask = track->capacity - 1;
+        for (size_t i = track_slot(track, ptr); track->slots[i] != NULL; i = (i + 1) & mask) {
+            if (track->slots[i] == ptr) {
+                track->slots[i] = TRACK_TOMBSTONE;
+                break;
+            }
+        }
+    }
+}
+
+void* ast_malloc(size_t size) {
+    void* ptr = SAGE_ALLOC(size);
+    track_add(ptr);
+    return ptr;
+}
+
+void* ast_realloc(void* ptr, size_t size) {
+    if (ptr != NULL) track_forget(ptr);
+    ptr = SAGE_REALLOC(ptr, size);
+    track_add(ptr);
+    return ptr;
+}
+
+void ast_track_begin(AstTrack* track) {
+    memset(track, 0, sizeof(*track));
+    track->outer = g_track;
+    g_track = track;
+}
+
+void ast_track_end(AstTrack* track, int release) {
+    g_track = track->outer;
+    for (size_t i = 0; i < track->capacity; i++) {
+        void* ptr = track->slots[i];
+        if (ptr == NULL || ptr == TRACK_TOMBSTONE) continue;
+        if (release) {
+            free(ptr);
+        } else if (g_track != NULL) {
+            track_insert(g_track, ptr);
+        }
+    }
+    free(track->slots);
+}
@@ -0,0 +1,1079 @@
+// src/bpe.c - Native byte-level BPE tokenizer for SageLang
+//
+// Provides: _bpe (merge tables, training and encoding behind lib/llm/tokenizer.sage)
+//
+// A model mirrors the tokenizer dict of lib/llm/tokenizer.sage: token bytes
+// by id, a bytes -> id hash table and the ordered merge list. Merges are
+// indexed by (left id, right id) in a rank table, so encoding a word is a
+// priority queue over its adjacent pairs ordered by (rank, position), which
+// gives the same tokens as applying the merges one after another. Text is
+// first cut between bytes that never sit side by side inside a merged
+// token; no merge can cross such a cut, so the pieces are encoded
+// independently and batches or large texts split across threads.
+//
+// Training keeps the corpus as a linked list of symbols with a count and an
+// occurrence list per pair. Applying a merge only touches the occurrences
+// of the chosen pair and adjusts the counts of their neighbours; the next
+// pair comes from a lazily updated max-heap.
+
+#include "module.h"
+#include "value.h"
+#include "env.h"
+#include "gc.h"
+#include "sage_thread.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BP_EMPTY UINT64_MAX
+#define BP_MAGIC "SAGEBPE1"
+#define BP_VERSION 1
+#define BP_MAX_VOCAB (1 << 22)  // token ids index flat arrays; ids at or past this are refused
+
+typedef struct {
+    uint64_t key;           // left << 32 | right, BP_EMPTY for a free slot
+    int rank;
+    int result;
+} BpRank;
+
+typedef struct {
+    int left, right, result;    // -1 when the rule names a token outside the vocab
+} BpMerge;
+
+typedef struct {
+    unsigned char** bytes;  // token bytes by id
+    int* lens;              // -1 for ids without a token
+    short* first;           // first and last byte of the token, -1 if unknown
+    short* last;
+    int id_cap;
+    int* slots;             // bytes -> id open addressing, -1 empty
+    int slot_cap;
+    int n_tokens;
+    BpRank* ranks;
+    int rank_cap, n_ranks;
+    BpMerge* merges;
+    int n_merges, merges_cap;
+    int byte_id[256];       // initial symbol of every byte
+    int* byte_rank;         // 256x256: rank of the rule joining two byte symbols, -1 if none
+    uint64_t join[1024];    // 256x256 bits: byte pairs found inside a merged token
+    int next_id;
+    int unk_id;
+    int vocab_size;         // training stops once next_id reaches it (0: no limit)
+} BpeModel;
+
+typedef struct {
+    int* data;
+    size_t n, cap;
+} BpIds;
+
+static void bp_ids_push(BpIds* v, int id) {
+    if (v->n == v->cap) {
+        v->cap = v->cap ? v->cap * 2 : 64;
+        v->data = SAGE_REALLOC(v->data, sizeof(int) * v->cap);
+    }
+    v->data[v->n++] = id;
+}
+
+static uint64_t bp_mix(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+static uint32_t bp_hash_bytes(const unsigned char* p, int len) {
+    uint32_t h = 2166136261u;
+    for (int i = 0; i < len; i++) h = (h ^ p[i]) * 16777619u;
+    return h;
+}
+
+static uint64_t bp_pair_key(int a, int b) {
+    return (uint64_t)(uint32_t)a << 32 | (uint32_t)b;
+}
+
+// ============================================================================
+// Vocabulary and merge tables
+// ============================================================================
+
+static int bp_token_find(const BpeModel* m, const unsigned char* p, int len) {
+    if (m->slot_cap == 0) return -1;
+    uint32_t mask = (uint32_t)m->slot_cap - 1;
+    for (uint32_t i = bp_hash_bytes(p, len) & mask;; i = (i + 1) & mask) {
+        int id = m->slots[i];
+        if (id < 0) return -1;
+        if (m->lens[id] == len && memcmp(m->bytes[id], p, (size_t)len) == 0) return id;
+    }
+}
+
+static void bp_slot_insert(BpeModel* m, int id) {
+    uint32_t mask = (uint32_t)m->slot_cap - 1;
+    uint32_t i = bp_hash_bytes(m->bytes[id], m->lens[id]) & mask;
+    while (m->slots[i] >= 0) i = (i + 1) & mask;
+    m->slots[i] = id;
+}
+
+static void bp_grow_ids(BpeModel* m, int id) {
+    if (id < m->id_cap) return;
+    int cap = m->id_cap ? m->id_cap : 512;
+    while (cap <= id) cap *= 2;
+    m->bytes = SAGE_REALLOC(m->bytes, sizeof(unsigned char*) * (size_t)cap);
+    m->lens = SAGE_REALLOC(m->lens, sizeof(int) * (size_t)cap);
+    m->first = SAGE_REALLOC(m->first, sizeof(short) * (size_t)cap);
+    m->last = SAGE_REALLOC(m->last, sizeof(short) * (size_t)cap);
+    for (int i = m->id_cap; i < cap; i++) {
+        m->bytes[i] = NULL;
+        m->lens[i] = -1;
+        m->first[i] = m->last[i] = -1;
+    }
+    m->id_cap = cap;
+}
+
+// Register token bytes under id; an id keeps the first bytes it was given
+static void bp_token_add(BpeModel* m, int id, const unsigned char* p, int len) {
+    if (id < 0 || id >= BP_MAX_VOCAB) return;
+    bp_grow_ids(m, id);
+    if (m->lens[id] >= 0 || bp_token_find(m, p, len) >= 0) return;
+    if ((m->n_tokens + 1) * 2 > m->slot_cap) {
+        int cap = m->slot_cap ? m->slot_cap * 2 : 1024;
+        free(m->slots);
+        m->slots = SAGE_ALLOC(sizeof(int) * (size_t)cap);
+        m->slot_cap = cap;
+        memset(m->slots, 0xff, sizeof(int) * (size_t)cap);
+        for (int i = 0; i < m->id_cap; i++) {
+            if (m->lens[i] >= 0) bp_slot_insert(m, i);
+        }
+    }
+    m->bytes[id] = SAGE_ALLOC((size_t)len + 1);
+    memcpy(m->bytes[id], p, (size_t)len);
+    m->lens[id] = len;
+    m->n_tokens++;
+    bp_slot_insert(m, id);
+    if (id >= m->next_id) m->next_id = id + 1;
+}
+
+static const BpRank* bp_rank_find(const BpeModel* m, int a, int b) {
+    uint64_t key = bp_pair_key(a, b);
+    uint32_t mask = (uint32_t)m->rank_cap - 1;
+    for (uint32_t i = (uint32_t)bp_mix(key) & mask;; i = (i + 1) & mask) {
+        if (m->ranks[i].key == key) return &m->ranks[i];
+        if (m->ranks[i].key == BP_EMPTY) return NULL;
+    }
+}
+
+static void bp_rank_insert(BpeModel* m, uint64_t key, int rank, int result) {
+    uint32_t mask = (uint32_t)m->rank_cap - 1;
+    uint32_t i = (uint32_t)bp_mix(key) & mask;
+    while (m->ranks[i].key != BP_EMPTY && m->ranks[i].key != key) i = (i + 1) & mask;
+    // A repeated rule keeps its first (lowest) rank
+    if (m->ranks[i].key == key) return;
+    m->ranks[i] = (BpRank){key, rank, result};
+    m->n_ranks++;
+}
+
+static void bp_ranks_grow(BpeModel* m) {
+    if ((m->n_ranks + 1) * 2 <= m->rank_cap) return;
+    BpRank* old = m->ranks;
+    int old_cap = m->rank_cap;
+    m->rank_cap = old_cap ? old_cap * 2 : 1024;
+    m->ranks = SAGE_ALLOC(sizeof(BpRank) * (size_t)m->rank_cap);
+    for (int i = 0; i < m->rank_cap; i++) m->ranks[i].key = BP_EMPTY;
+    m->n_ranks = 0;
+    for (int i = 0; i < old_cap; i++) {
+        if (old[i].key != BP_EMPTY) bp_rank_insert(m, old[i].key, old[i].rank, old[i].result);
+    }
+    free(old);
+}
+
+// Mark the byte pair a rule joins; returns 1 if it taught the result token
+// its edge bytes
+static int bp_join_rule(BpeModel* m, const BpMerge* r) {
+    if (r->left < 0 || r->right < 0 || r->result < 0) return 0;
+    if (m->last[r->left] < 0 || m->first[r->right] < 0) return 0;
+    int bit = m->last[r->left] << 8 | m->first[r->right];
+    m->join[bit >> 6] |= 1ULL << (bit & 63);
+    if (m->first[r->result] >= 0) return 0;
+    m->first[r->result] = m->first[r->left];
+    m->last[r->result] = m->last[r->right];
+    return 1;
+}
+
+// Append a merge rule; rules naming unknown tokens keep their place in the
+// list but never fire
+static void bp_merge_add(BpeModel* m, int a, int b, int result) {
+    if (m->n_merges == m->merges_cap) {
+        m->merges_cap = m->merges_cap ? m->merges_cap * 2 : 256;
+        m->merges = SAGE_REALLOC(m->merges, sizeof(BpMerge) * (size_t)m->merges_cap);
+    }
+    int rank = m->n_merges++;
+    m->merges[rank] = (BpMerge){a, b, result};
+    if (a < 0 || b < 0 || result < 0) return;
+    bp_ranks_grow(m);
+    bp_rank_insert(m, bp_pair_key(a, b), rank, result);
+    bp_join_rule(m, &m->merges[rank]);
+    if (m->lens[a] <= 1 && m->lens[b] <= 1 && m->first[a] >= 0 && m->first[b] >= 0) {
+        int* slot = &m->byte_rank[m->first[a] << 8 | m->first[b]];
+        if (*slot < 0) *slot = rank;
+    }
+}
+
+// A loaded list may use a token before the rule that builds it; repeat
+// until every reachable rule has marked its pair
+static void bp_settle_joins(BpeModel* m) {
+    int changed = 1;
+    while (changed) {
+        changed = 0;
+        for (int i = 0; i < m->n_merges; i++) changed |= bp_join_rule(m, &m->merges[i]);
+    }
+}
+
+// Bytes map to their one-byte tokens; byte 0 maps to "" (what chr(0) gives)
+static void bp_index_bytes(BpeModel* m) {
+    for (int b = 0; b < 256; b++) {
+        unsigned char c = (unsigned char)b;
+        int id = b == 0 ? bp_token_find(m, &c, 0) : bp_token_find(m, &c, 1);
+        m->byte_id[b] = id >= 0 ? id : m->unk_id;
+        if (id >= 0) m->first[id] = m->last[id] = (short)b;
+    }
+}
+
+static BpeModel* bp_model_new(int unk_id, int vocab_size) {
+    BpeModel* m = SAGE_ALLOC(sizeof(BpeModel));
+    m->unk_id = unk_id;
+    m->vocab_size = vocab_size;
+    m->byte_rank = SAGE_ALLOC(sizeof(int) * 65536);
+    memset(m->byte_rank, 0xff, sizeof(int) * 65536);
+    bp_ranks_grow(m);
+    return m;
+}
+
+static void bp_free(void* ptr) {
+    BpeModel* m = ptr;
+    for (int i = 0; i < m->id_cap; i++) free(m->bytes[i]);
+    free(m->bytes);
+    free(m->lens);
+    free(m->first);
+    free(m->last);
+    free(m->slots);
+    free(m->ranks);
+    free(m->merges);
+    free(m->byte_rank);
+    free(m);
+}
+
+// ============================================================================
+// Encoding
+// ============================================================================
+
+typedef struct {
+    int* sym;               // symbol id per start byte, -1 once merged away
+    int* nxt;
+    int* prv;
+    uint64_t* heap;         // rank << 32 | position, min at the top
+    size_t cap, heap_n, heap_cap;
+} BpScratch;
+
+static void bp_scratch_reserve(BpScratch* s, size_t n) {
+    if (n <= s->cap) return;
+    s->cap = n;
+    s->sym = SAGE_REALLOC(s->sym, sizeof(int) * n);
+    s->nxt = SAGE_REALLOC(s->nxt, sizeof(int) * n);
+    s->prv = SAGE_REALLOC(s->prv, sizeof(int) * n);
+}
+
+static void bp_scratch_free(BpScratch* s) {
+    free(s->sym);
+    free(s->nxt);
+    free(s->prv);
+    free(s->heap);
+}
+
+static void bp_heap_push(BpScratch* s, uint64_t v) {
+    if (s->heap_n == s->heap_cap) {
+        s->heap_cap = s->heap_cap ? s->heap_cap * 2 : 64;
+        s->heap = SAGE_REALLOC(s->heap, sizeof(uint64_t) * s->heap_cap);
+    }
+    size_t i = s->heap_n++;
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (s->heap[parent] <= v) break;
+        s->heap[i] = s->heap[parent];
+        i = parent;
+    }
+    s->heap[i] = v;
+}
+
+static uint64_t bp_heap_pop(BpScratch* s) {
+    uint64_t top = s->heap[0];
+    uint64_t v = s->heap[--s->heap_n];
+    size_t i = 0;
+    for (;;) {
+        size_t c = 2 * i + 1;
+        if (c >= s->heap_n) break;
+        if (c + 1 < s->heap_n && s->heap[c + 1] < s->heap[c]) c++;
+        if (v <= s->heap[c]) break;
+        s->heap[i] = s->heap[c];
+        i = c;
+    }
+    if (s->heap_n > 0) s->heap[i] = v;
+    return top;
+}
+
+static void bp_push_pair(const BpeModel* m, BpScratch* s, int pos) {
+    int q = s->nxt[pos];
+    if (q < 0) return;
+    const BpRank* r = bp_rank_find(m, s->sym[pos], s->sym[q]);
+    if (r) bp_heap_push(s, (uint64_t)(uint32_t)r->rank << 32 | (uint32_t)pos);
+}
+
+// Merge one piece of text, lowest rank first and leftmost among equals
+static void bp_encode_word(const BpeModel* m, BpScratch* s, const unsigned char* p, int n, BpIds* out) {
+    if (n == 1) {
+        bp_ids_push(out, m->byte_id[p[0]]);
+        return;
+    }
+    bp_scratch_reserve(s, (size_t)n);
+    for (int i = 0; i < n; i++) {
+        s->sym[i] = m->byte_id[p[i]];
+        s->nxt[i] = i + 1 < n ? i + 1 : -1;
+        s->prv[i] = i - 1;
+    }
+    s->heap_n = 0;
+    for (int i = 0; i + 1 < n; i++) {
+        int rank = m->byte_rank[p[i] << 8 | p[i + 1]];
+        if (rank >= 0) bp_heap_push(s, (uint64_t)rank << 32 | (uint32_t)i);
+    }
+    while (s->heap_n > 0) {
+        uint64_t top = bp_heap_pop(s);
+        int pos = (int)(uint32_t)top;
+        int q = s->nxt[pos];
+        if (s->sym[pos] < 0 || q < 0) continue;
+        // Entries go stale when a neighbour merges first
+        const BpMerge* r = &m->merges[top >> 32];
+        if (s->sym[pos] != r->left || s->sym[q] != r->right) continue;
+        s->sym[pos] = r->result;
+        s->sym[q] = -1;
+        s->nxt[pos] = s->nxt[q];
+        if (s->nxt[q] >= 0) s->prv[s->nxt[q]] = pos;
+        if (s->prv[pos] >= 0) bp_push_pair(m, s, s->prv[pos]);
+        bp_push_pair(m, s, pos);
+    }
+    for (int i = 0; i >= 0; i = s->nxt[i]) bp_ids_push(out, s->sym[i]);
+}
+
+static int bp_joined(const BpeModel* m, unsigned char a, unsigned char b) {
+    int bit = a << 8 | b;
+    return (int)(m->join[bit >> 6] >> (bit & 63)) & 1;
+}
+
+static void bp_encode_bytes(const BpeModel* m, BpScratch* s, const unsigned char* p, size_t n, BpIds* out) {
+    size_t start = 0;
+    for (size_t i = 1; i <= n; i++) {
+        if (i == n || !bp_joined(m, p[i - 1], p[i])) {
+            bp_encode_word(m, s, p + start, (int)(i - start), out);
+            start = i;
+        }
+    }
+}
+
+typedef struct {
+    const unsigned char* data;
+    size_t len;
+    BpIds out;
+} BpDoc;
+
+typedef struct {
+    const BpeModel* m;
+    BpDoc* docs;
+    int first, last;        // document range [first, last)
+} BpJob;
+
+static void* bp_encode_worker(void* arg) {
+    BpJob* job = arg;
+    BpScratch s;
+    memset(&s, 0, sizeof(s));
+    for (int i = job->first; i < job->last; i++) {
+        bp_encode_bytes(job->m, &s, job->docs[i].data, job->docs[i].len, &job->docs[i].out);
+    }
+    bp_scratch_free(&s);
+    return NULL;
+}
+
+// Encode n documents over up to threads workers, each taking a similar
+// share of the bytes
+static void bp_encode_docs(const BpeModel* m, BpDoc* docs, int n, int threads) {
+    if (threads > n) threads = n;
+    if (threads < 1) threads = 1;
+    size_t total = 0;
+    for (int i = 0; i < n; i++) total += docs[i].len;
+    BpJob* jobs = SAGE_ALLOC(sizeof(BpJob) * (size_t)threads);
+    sage_thread_t* tids = SAGE_ALLOC(sizeof(sage_thread_t) * (size_t)threads);
+    int* started = SAGE_ALLOC(sizeof(int) * (size_t)threads);
+    int next = 0;
+    size_t seen = 0;
+    for (int t = 0; t < threads; t++) {
+        size_t target = total / (size_t)threads * (size_t)(t + 1);
+        int first = next;
+        if (t == threads - 1) {
+            next = n;
+        } else {
+            while (next < n && (next == first || seen + docs[next].len <= target)) seen += docs[next++].len;
+        }
+        jobs[t] = (BpJob){m, docs, first, next};
+        // The calling thread takes the last share itself
+        if (t < threads - 1) started[t] = sage_thread_create(&tids[t], bp_encode_worker, &jobs[t]) == 0;
+    }
+    bp_encode_worker(&jobs[threads - 1]);
+    for (int t = 0; t < threads - 1; t++) {
+        if (started[t]) sage_thread_join(tids[t], NULL);
+        else bp_encode_worker(&jobs[t]);
+    }
+    free(jobs);
+    free(tids);
+    free(started);
+}
+
+// Split one text at cuts no merge crosses, near equal shares per thread
+static int bp_split_text(const BpeModel* m, const unsigned char* p, size_t n, int parts, BpDoc* docs) {
+    int count = 0;
+    size_t start = 0;
+    for (int t = 1; t < parts && start < n; t++) {
+        size_t cut = n / (size_t)parts * (size_t)t;
+        if (cut <= start) continue;
+        while (cut < n && bp_joined(m, p[cut - 1], p[cut])) cut++;
+        if (cut >= n) break;
+        docs[count++] = (BpDoc){p + start, cut - start, {0}};
+        start = cut;
+    }
+    docs[count++] = (BpDoc){p + start, n - start, {0}};
+    return count;
+}
+
+// ============================================================================
+// Training
+// ============================================================================
+
+typedef struct {
+    uint64_t key;           // BP_EMPTY for a free slot
+    long long count;        // live occurrences
+    long long pushed;       // largest count on the heap, 0 if none
+    int* pos;               // left positions the pair was seen at (may be stale)
+    int n_pos, cap_pos;
+    int dirty;
+} BpPair;
+
+typedef struct {
+    long long count;
+    uint64_t key;
+} BpHeapItem;
+
+typedef struct {
+    BpPair* pairs;
+    size_t cap, n;
+    BpHeapItem* heap;       // max count first, then lowest key
+    size_t heap_n, heap_cap;
+    uint64_t* touched;      // pairs whose count rose during the current merge
+    size_t n_touched, touched_cap;
+} BpTrainer;
+
+static BpPair* bp_pair_find(BpTrainer* t, uint64_t key) {
+    size_t mask = t->cap - 1;
+    for (size_t i = (size_t)bp_mix(key) & mask;; i = (i + 1) & mask) {
+        if (t->pairs[i].key == key) return &t->pairs[i];
+        if (t->pairs[i].key == BP_EMPTY) return NULL;
+    }
+}
+
+static void bp_pairs_resize(BpTrainer* t, size_t cap) {
+    BpPair* old = t->pairs;
+    size_t old_cap = t->cap;
+    t->pairs = SAGE_ALLOC(sizeof(BpPair) * cap);
+    t->cap = cap;
+    for (size_t i = 0; i < cap; i++) t->pairs[i].key = BP_EMPTY;
+    size_t mask = cap - 1;
+    for (size_t i = 0; i < old_cap; i++) {
+        if (old[i].key == BP_EMPTY) continue;
+        size_t j = (size_t)bp_mix(old[i].key) & mask;
+        while (t->pairs[j].key != BP_EMPTY) j = (j + 1) & mask;
+        t->pairs[j] = old[i];
+    }
+    free(old);
+}
+
+static BpPair* bp_pair_get(BpTrainer* t, uint64_t key) {
+    BpPair* e = bp_pair_find(t, key);
+    if (e) return e;
+    if ((t->n + 1) * 2 > t->cap) bp_pairs_resize(t, t->cap * 2);
+    size_t mask = t->cap - 1;
+    size_t i = (size_t)bp_mix(key) & mask;
+    while (t->pairs[i].key != BP_EMPTY) i = (i + 1) & mask;
+    t->n++;
+    t->pairs[i].key = key;
+    return &t->pairs[i];
+}
+
+static int bp_heap_before(BpHeapItem a, BpHeapItem b) {
+    return a.count > b.count || (a.count == b.count && a.key < b.key);
+}
+
+static void bp_train_push(BpTrainer* t, BpPair* e) {
+    if (t->heap_n == t->heap_cap) {
+        t->heap_cap = t->heap_cap ? t->heap_cap * 2 : 1024;
+        t->heap = SAGE_REALLOC(t->heap, sizeof(BpHeapItem) * t->heap_cap);
+    }
+    BpHeapItem v = {e->count, e->key};
+    e->pushed = e->count;
+    size_t i = t->heap_n++;
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (!bp_heap_before(v, t->heap[parent])) break;
+        t->heap[i] = t->heap[parent];
+        i = parent;
+    }
+    t->heap[i] = v;
+}
+
+static BpHeapItem bp_train_pop(BpTrainer* t) {
+    BpHeapItem top = t->heap[0];
+    BpHeapItem v = t->heap[--t->heap_n];
+    size_t i = 0;
+    for (;;) {
+        size_t c = 2 * i + 1;
+        if (c >= t->heap_n) break;
+        if (c + 1 < t->heap_n && bp_heap_before(t->heap[c + 1], t->heap[c])) c++;
+        if (!bp_heap_before(t->heap[c], v)) break;
+        t->heap[i] = t->heap[c];
+        i = c;
+    }
+    if (t->heap_n > 0) t->heap[i] = v;
+    return top;
+}
+
+static void bp_pair_inc(BpTrainer* t, int a, int b, int pos) {
+    BpPair* e = bp_pair_get(t, bp_pair_key(a, b));
+    e->count++;
+    if (e->n_pos == e->cap_pos) {
+        e->cap_pos = e->cap_pos ? e->cap_pos * 2 : 4;
+        e->pos = SAGE_REALLOC(e->pos, sizeof(int) * (size_t)e->cap_pos);
+    }
+    e->pos[e->n_pos++] = pos;
+    if (!e->dirty && e->count > e->pushed) {
+        e->dirty = 1;
+        if (t->n_touched == t->touched_cap) {
+            t->touched_cap = t->touched_cap ? t->touched_cap * 2 : 256;
+            t->touched = SAGE_REALLOC(t->touched, sizeof(uint64_t) * t->touched_cap);
+        }
+        t->touched[t->n_touched++] = e->key;
+    }
+}
+
+static void bp_pair_dec(BpTrainer* t, int a, int b) {
+    BpPair* e = bp_pair_find(t, bp_pair_key(a, b));
+    if (e) e->count--;
+}
+
+// Heap entries for every pair whose count rose since the last flush
+static void bp_flush_touched(BpTrainer* t) {
+    for (size_t i = 0; i < t->n_touched; i++) {
+        BpPair* e = bp_pair_find(t, t->touched[i]);
+        e->dirty = 0;
+        if (e->count > e->pushed) bp_train_push(t, e);
+    }
+    t->n_touched = 0;
+}
+
+// Most frequent live pair, or NULL; stale heap entries are dropped or
+// re-queued at their current count
+static BpPair* bp_best_pair(BpTrainer* t) {
+    while (t->heap_n > 0) {
+        BpHeapItem top = t->heap[0];
+        BpPair* e = bp_pair_find(t, top.key);
+        if (top.count != e->pushed) {
+            bp_train_pop(t);
+            continue;
+        }
+        if (e->count == top.count) return e;
+        bp_train_pop(t);
+        e->pushed = 0;
+        if (e->count > 0) bp_train_push(t, e);
+    }
+    return NULL;
+}
+
+static int bp_cmp_int(const void* a, const void* b) {
+    int x = *(const int*)a, y = *(const int*)b;
+    return (x > y) - (x < y);
+}
+
+// Learn up to num_merges rules from text, continuing from the model's
+// current merges; returns the number learned
+static int bp_train(BpeModel* m, const unsigned char* text, size_t n, int num_merges) {
+    BpIds syms = {0};
+    BpScratch s;
+    memset(&s, 0, sizeof(s));
+    bp_encode_bytes(m, &s, text, n, &syms);
+    bp_scratch_free(&s);
+    int len = (int)syms.n;
+    int* sym = syms.data;
+    int* nxt = SAGE_ALLOC(sizeof(int) * (size_t)(len + 1));
+    int* prv = SAGE_ALLOC(sizeof(int) * (size_t)(len + 1));
+    for (int i = 0; i < len; i++) {
+        nxt[i] = i + 1 < len ? i + 1 : -1;
+        prv[i] = i - 1;
+    }
+
+    BpTrainer t;
+    memset(&t, 0, sizeof(t));
+    bp_pairs_resize(&t, 1024);
+    for (int i = 0; i + 1 < len; i++) bp_pair_inc(&t, sym[i], sym[i + 1], i);
+    bp_flush_touched(&t);
+
+    int learned = 0;
+    while (learned < num_merges && m->next_id < BP_MAX_VOCAB &&
+           (m->vocab_size <= 0 || m->next_id < m->vocab_size)) {
+        BpPair* best = bp_best_pair(&t);
+        if (!best || best->count < 2) break;
+        int a = (int)(best->key >> 32), b = (int)(uint32_t)best->key;
+        if (a >= m->id_cap || b >= m->id_cap || m->lens[a] < 0 || m->lens[b] < 0) {
+            // Bytes outside the vocab all read as unk_id, which has no bytes to join
+            best->count = 0;
+            continue;
+        }
+        int la = m->lens[a], lb = m->lens[b];
+        unsigned char* merged = SAGE_ALLOC((size_t)la + (size_t)lb + 1);
+        memcpy(merged, m->bytes[a], (size_t)la);
+        memcpy(merged + la, m->bytes[b], (size_t)lb);
+        int id = bp_token_find(m, merged, la + lb);
+        if (id < 0) {
+            id = m->next_id;
+            bp_token_add(m, id, merged, la + lb);
+        }
+        free(merged);
+        if (id == a || id == b) {
+            // Only the empty byte-0 token can merge into itself; retire the pair
+            best->count = 0;
+            continue;
+        }
+        bp_merge_add(m, a, b, id);
+        learned++;
+
+        int* pos = best->pos;
+        int n_pos = best->n_pos;
+        best->pos = NULL;
+        best->n_pos = best->cap_pos = 0;
+        qsort(pos, (size_t)n_pos, sizeof(int), bp_cmp_int);
+        for (int i = 0; i < n_pos; i++) {
+            int p = pos[i];
+            if (i > 0 && pos[i - 1] == p) continue;
+            int q = nxt[p];
+            if (sym[p] != a || q < 0 || sym[q] != b) continue;
+            int pp = prv[p], qq = nxt[q];
+            bp_pair_dec(&t, a, b);
+            if (pp >= 0) {
+                bp_pair_dec(&t, sym[pp], a);
+                bp_pair_inc(&t, sym[pp], id, pp);
+            }
+            if (qq >= 0) {
+                bp_pair_dec(&t, b, sym[qq]);
+                bp_pair_inc(&t, id, sym[qq], p);
+            }
+            sym[p] = id;
+            sym[q] = -1;
+            nxt[p] = qq;
+            if (qq >= 0) prv[qq] = p;
+        }
+        free(pos);
+        bp_flush_touched(&t);
+    }
+
+    for (size_t i = 0; i < t.cap; i++) free(t.pairs[i].pos);
+    free(t.pairs);
+    free(t.heap);
+    free(t.touched);
+    free(nxt);
+    free(prv);
+    free(sym);
+    return learned;
+}
+
+// ============================================================================
+// Save / load
+// ============================================================================
+
+typedef struct {
+    char magic[8];          // BP_MAGIC
+    uint32_t version;
+    uint32_t n_tokens;
+    uint32_t n_merges;
+    int32_t next_id;
+    int32_t unk_id;
+    int32_t vocab_size;
+} BpFileHeader;
+
+// Tokens are written as (id, length, bytes) and merges as (left, right,
+// result) ids in rank order
+static int bp_save(const BpeModel* m, const char* path) {
+    FILE* f = fopen(path, "wb");
+    if (!f) return 0;
+    BpFileHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, BP_MAGIC, 8);
+    h.version = BP_VERSION;
+    h.n_tokens = (uint32_t)m->n_tokens;
+    h.n_merges = (uint32_t)m->n_merges;
+    h.next_id = m->next_id;
+    h.unk_id = m->unk_id;
+    h.vocab_size = m->vocab_size;
+    int ok = fwrite(&h, sizeof(h), 1, f) == 1;
+    for (int id = 0; ok && id < m->id_cap; id++) {
+        if (m->lens[id] < 0) continue;
+        int32_t rec[2] = {id, m->lens[id]};
+        ok = fwrite(rec, sizeof(rec), 1, f) == 1 &&
+             fwrite(m->bytes[id], 1, (size_t)m->lens[id], f) == (size_t)m->lens[id];
+    }
+    for (int i = 0; ok && i < m->n_merges; i++) {
+        int32_t rec[3] = {m->merges[i].left, m->merges[i].right, m->merges[i].result};
+        ok = fwrite(rec, sizeof(rec), 1, f) == 1;
+    }
+    return fclose(f) == 0 && ok;
+}
+
+static BpeModel* bp_load(const char* path) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return NULL;
+    BpFileHeader h;
+    // Every saved id is below next_id; bound it before any array is sized from it
+    if (fread(&h, sizeof(h), 1, f) != 1 || memcmp(h.magic, BP_MAGIC, 8) != 0 || h.version != BP_VERSION ||
+        h.next_id < 0 || h.next_id > BP_MAX_VOCAB || h.n_tokens > (uint32_t)h.next_id ||
+        h.unk_id < 0 || h.unk_id >= BP_MAX_VOCAB || h.vocab_size < 0 || h.vocab_size > BP_MAX_VOCAB) {
+        fclose(f);
+        return NULL;
+    }
+    BpeModel* m = bp_model_new(h.unk_id, h.vocab_size);
+    unsigned char* buf = NULL;
+    int ok = 1;
+    for (uint32_t i = 0; ok && i < h.n_tokens; i++) {
+        int32_t rec[2];
+        ok = fread(rec, sizeof(rec), 1, f) == 1 && rec[0] >= 0 && rec[0] < h.next_id &&
+             rec[1] >= 0 && rec[1] < (1 << 24);
+        if (!ok) break;
+        buf = SAGE_REALLOC(buf, (size_t)rec[1] + 1);
+        ok = fread(buf, 1, (size_t)rec[1], f) == (size_t)rec[1];
+        if (ok) bp_token_add(m, rec[0], buf, rec[1]);
+    }
+    free(buf);
+    if (ok) bp_index_bytes(m);
+    for (uint32_t i = 0; ok && i < h.n_merges; i++) {
+        int32_t rec[3];
+        ok = fread(rec, sizeof(rec), 1, f) == 1;
+        if (!ok) break;
+        for (int j = 0; j < 3; j++) {
+            if (rec[j] >= m->id_cap || (rec[j] >= 0 && m->lens[rec[j]] < 0)) rec[j] = -1;
+        }
+        bp_merge_add(m, rec[0], rec[1], rec[2]);
+    }
+    fclose(f);
+    if (!ok) {
+        bp_free(m);
+        return NULL;
+    }
+    bp_settle_joins(m);
+    if (h.next_id > m->next_id) m->next_id = h.next_id;
+    return m;
+}
+
+// ============================================================================
+// Sage bindings
+// ============================================================================
+
+static BpeModel* bp_arg(int argCount, Value* args, const char* fn) {
+    if (argCount >= 1 && args[0].type == VAL_POINTER && args[0].as.pointer->finalize == bp_free) {
+        return (BpeModel*)args[0].as.pointer->ptr;
+    }
+    fprintf(stderr, "Runtime Error: _bpe.%s expects a model from _bpe.create or _bpe.load.\n", fn);
+    return NULL;
+}
+
+static Value bp_handle(BpeModel* m) {
+    Value handle = val_pointer(m, sizeof(BpeModel), 1);
+    handle.as.pointer->finalize = bp_free;
+    return handle;
+}
+
+// Raw bytes of a string or Bytes value; 0 if v is neither
+static int bp_text_arg(Value v, const unsigned char** data, size_t* len) {
+    if (IS_STRING(v)) {
+        *data = (const unsigned char*)AS_STRING(v);
+        *len = strlen(AS_STRING(v));
+        return 1;
+    }
+    if (IS_BYTES(v)) {
+        *data = AS_BYTES(v)->data;
+        *len = (size_t)AS_BYTES(v)->length;
+        return 1;
+    }
+    return 0;
+}
+
+static int bp_threads_arg(int argCount, Value* args, int index) {
+    return argCount > index && IS_NUMBER(args[index]) && AS_NUMBER(args[index]) >= 1
+        ? (int)AS_NUMBER(args[index]) : sage_cpu_count();
+}
+
+// A vocab size past BP_MAX_VOCAB, or not positive, means no limit
+static int bp_vocab_size_arg(Value v) {
+    return IS_NUMBER(v) && AS_NUMBER(v) > 0 && AS_NUMBER(v) <= BP_MAX_VOCAB ? (int)AS_NUMBER(v) : 0;
+}
+
+static Value bp_ids_value(const BpIds* ids) {
+    Value result = val_array();
+    for (size_t i = 0; i < ids->n; i++) array_push(&result, val_number(ids->data[i]));
+    return result;
+}
+
+static Value bp_token_value(const BpeModel* m, int id) {
+    return val_string_len((const char*)m->bytes[id], m->lens[id]);
+}
+
+static Value bp_merge_value(const BpeModel* m, const BpMerge* r) {
+    Value merge = val_dict();
+    dict_set(&merge, "left", bp_token_value(m, r->left));
+    dict_set(&merge, "right", bp_token_value(m, r->right));
+    dict_set(&merge, "result", bp_token_value(m, r->result));
+    return merge;
+}
+
+// _bpe.byte_token(byte) -> the one-byte string for byte 1..255, "" for 0
+static Value bp_byte_token_native(int argCount, Value* args) {
+    if (argCount < 1 || !IS_NUMBER(args[0]) || AS_NUMBER(args[0]) < 0 || AS_NUMBER(args[0]) > 255) {
+        fprintf(stderr, "Runtime Error: _bpe.byte_token expects a byte value 0..255.\n");
+        return val_nil();
+    }
+    char c = (char)(int)AS_NUMBER(args[0]);
+    return val_string_len(&c, c == 0 ? 0 : 1);
+}
+
+// _bpe.create(vocab, merges, [unk_id], [vocab_size]) -> model
+// vocab maps token strings to ids and merges is a list of
+// {"left", "right", "result"} dicts, as in lib/llm/tokenizer.sage
+static Value bp_create_native(int argCount, Value* args) {
+    if (argCount < 2 || !IS_DICT(args[0]) || !IS_ARRAY(args[1])) {
+        fprintf(stderr, "Runtime Error: _bpe.create expects a vocab dict and a merges list.\n");
+        return val_nil();
+    }
+    int unk_id = argCount >= 3 && IS_NUMBER(args[2]) && AS_NUMBER(args[2]) >= 0 &&
+                 AS_NUMBER(args[2]) < BP_MAX_VOCAB ? (int)AS_NUMBER(args[2]) : 3;
+    int vocab_size = argCount >= 4 ? bp_vocab_size_arg(args[3]) : 0;
+    BpeModel* m = bp_model_new(unk_id, vocab_size);
+    DictValue* vocab = AS_DICT(args[0]);
+    for (int i = 0; i < vocab->capacity; i++) {
+        DictEntry* e = &vocab->entries[i];
+        if (e->key && IS_NUMBER(e->value) && AS_NUMBER(e->value) >= 0 && AS_NUMBER(e->value) < BP_MAX_VOCAB) {
+            bp_token_add(m, (int)AS_NUMBER(e->value), (const unsigned char*)e->key, e->key_len);
+        }
+    }
+    bp_index_bytes(m);
+    ArrayValue* merges = AS_ARRAY(args[1]);
+    for (int i = 0; i < merges->count; i++) {
+        Value r = merges->elements[i];
+        int ids[3] = {-1, -1, -1};
+        static const char* fields[3] = {"left", "right", "result"};
+        for (int j = 0; IS_DICT(r) && j < 3; j++) {
+            Value tok = dict_get(&r, fields[j]);
+            if (IS_STRING(tok)) {
+                const char* s = AS_STRING(tok);
+                ids[j] = bp_token_find(m, (const unsigned char*)s, (int)strlen(s));
+            }
+        }
+        bp_merge_add(m, ids[0], ids[1], ids[2]);
+    }
+    bp_settle_joins(m);
+    return bp_handle(m);
+}
+
+// _bpe.train(model, text, num_merges, [vocab_size]) -> the learned merge dicts
+// Continues from the model's merges; stops early once no pair occurs twice
+// or next_id reaches vocab_size
+static Value bp_train_native(int argCount, Value* args) {
+    BpeModel* m = bp_arg(argCount, args, "train");
+    const unsigned char* text;
+    size_t len;
+    if (!m) return val_nil();
+    if (argCount < 3 || !bp_text_arg(args[1], &text, &len) || !IS_NUMBER(args[2])) {
+        fprintf(stderr, "Runtime Error: _bpe.train expects text (string or bytes) and a merge count.\n");
+        return val_nil();
+    }
+    if (argCount >= 4 && IS_NUMBER(args[3])) m->vocab_size = bp_vocab_size_arg(args[3]);
+    int first = m->n_merges;
+    int learned = bp_train(m, text, len, (int)AS_NUMBER(args[2]));
+    gc_pin();
+    Value result = val_array();
+    for (int i = first; i < first + learned; i++) array_push(&result, bp_merge_value(m, &m->merges[i]));
+    gc_unpin();
+    return result;
+}
+
+// _bpe.encode(model, text, [threads]) -> token ids
+// Texts over a megabyte are split across threads (default: one per CPU)
+static Value bp_encode_native(int argCount, Value* args) {
+    BpeModel* m = bp_arg(argCount, args, "encode");
+    const unsigned char* text;
+    size_t len;
+    if (!m) return val_nil();
+    if (argCount < 2 || !bp_text_arg(args[1], &text, &len)) {
+        fprintf(stderr, "Runtime Error: _bpe.encode expects text (string or bytes).\n");
+        return val_nil();
+    }
+    int threads = bp_threads_arg(argCount, args, 2);
+    int parts = (int)(len >> 20) + 1;
+    if (parts > threads) parts = threads;
+    BpDoc* docs = SAGE_ALLOC(sizeof(BpDoc) * (size_t)parts);
+    int n = bp_split_text(m, text, len, parts, docs);
+    bp_encode_docs(m, docs, n, n);
+    gc_pin();
+    Value result = val_array();
+    for (int d = 0; d < n; d++) {
+        for (size_t i = 0; i < docs[d].out.n; i++) array_push(&result, val_number(docs[d].out.data[i]));
+        free(docs[d].out.data);
+    }
+    gc_unpin();
+    free(docs);
+    return result;
+}
+
+// _bpe.encode_batch(model, texts, [threads]) -> one id list per text
+static Value bp_encode_batch_native(int argCount, Value* args) {
+    BpeModel* m = bp_arg(argCount, args, "encode_batch");
+    if (!m) return val_nil();
+    ArrayValue* texts = argCount >= 2 && IS_ARRAY(args[1]) ? AS_ARRAY(args[1]) : NULL;
+    BpDoc* docs = texts ? SAGE_ALLOC(sizeof(BpDoc) * (size_t)(texts->count + 1)) : NULL;
+    for (int i = 0; texts && i < texts->count; i++) {
+        if (!bp_text_arg(texts->elements[i], &docs[i].data, &docs[i].len)) {
+            free(docs);
+            docs = NULL;
+            break;
+        }
+    }
+    if (!docs) {
+        fprintf(stderr, "Runtime Error: _bpe.encode_batch expects a list of strings or bytes.\n");
+        return val_nil();
+    }
+    bp_encode_docs(m, docs, texts->count, bp_threads_arg(argCount, args, 2));
+    gc_pin();
+    Value result = val_array();
+    for (int i = 0; i < texts->count; i++) {
+        array_push(&result, bp_ids_value(&docs[i].out));
+        free(docs[i].out.data);
+    }
+    gc_unpin();
+    free(docs);
+    return result;
+}
+
+// _bpe.decode(model, ids) -> string; unknown ids are skipped
+static Value bp_decode_native(int argCount, Value* args) {
+    BpeModel* m = bp_arg(argCount, args, "decode");
+    if (!m) return val_nil();
+    if (argCount < 2 || !IS_ARRAY(args[1])) {
+        fprintf(stderr, "Runtime Error: _bpe.decode expects a list of token ids.\n");
+        return val_nil();
+    }
+    ArrayValue* ids = AS_ARRAY(args[1]);
+    size_t len = 0, cap = 64;
+    char* out = SAGE_ALLOC(cap);
+    for (int i = 0; i < ids->count; i++) {
+        if (!IS_NUMBER(ids->elements[i])) continue;
+        double v = AS_NUMBER(ids->elements[i]);
+        int id = (int)v;
+        if (v < 0 || id >= m->id_cap || m->lens[id] < 0) continue;
+        if (len + (size_t)m->lens[id] >= cap) {
+            while (len + (size_t)m->lens[id] >= cap) cap *= 2;
+            out = SAGE_REALLOC(out, cap);
+        }
+        memcpy(out + len, m->bytes[id], (size_t)m->lens[id]);
+        len += (size_t)m->lens[id];
+    }
+    Value result = val_string_len(out, (int)len);
+    free(out);
+    return result;
+}
+
+// _bpe.export(model) -> {vocab, id_to_token, merges, next_id, unk_id, vocab_size}
+// in the tokenizer dict layout of lib/llm/tokenizer.sage
+static Value bp_export_native(int argCount, Value* args) {
+    BpeModel* m = bp_arg(argCount, args, "export");
+    if (!m) return val_nil();
+    gc_pin();
+    Value vocab = val_dict();
+    Value id_to_token = val_dict();
+    char key[16];
+    for (int id = 0; id < m->id_cap; id++) {
+        if (m->lens[id] < 0) continue;
+        dict_set_len(&vocab, (const char*)m->bytes[id], m->lens[id], val_number(id));
+        snprintf(key, sizeof(key), "%d", id);
+        dict_set(&id_to_token, key, bp_token_value(m, id));
+    }
+    Value merges = val_array();
+    for (int i = 0; i < m->n_merges; i++) {
+        const BpMerge* r = &m->merges[i];
+        if (r->left >= 0 && r->right >= 0 && r->result >= 0) array_push(&merges, bp_merge_value(m, r));
+    }
+    Value result = val_dict();
+    dict_set(&result, "vocab", vocab);
+    dict_set(&result, "id_to_token", id_to_token);
+    dict_set(&result, "merges", merges);
+    dict_set(&result, "next_id", val_number(m->next_id));
+    dict_set(&result, "unk_id", val_number(m->unk_id));
+    dict_set(&result, "vocab_size", val_number(m->vocab_size));
+    gc_unpin();
+    return result;
+}
+
+// _bpe.save(model, path) -> true on success
+static Value bp_save_native(int argCount, Value* args) {
+    BpeModel* m = bp_arg(argCount, args, "save");
+    if (!m || argCount < 2 || !IS_STRING(args[1])) return val_bool(0);
+    return val_bool(bp_save(m, AS_STRING(args[1])));
+}
+
+// _bpe.load(path) -> model, or nil if the file is missing or not a _bpe model
+static Value bp_load_native(int argCount, Value* args) {
+    if (argCount < 1 || !IS_STRING(args[0])) return val_nil();
+    BpeModel* m = bp_load(AS_STRING(args[0]));
+    return m ? bp_handle(m) : val_nil();
+}
+
+// _bpe.stats(model) -> {tokens, merges, next_id, unk_id, vocab_size}
+static Value bp_stats_native(int argCount, Value* args) {
+    BpeModel* m = bp_arg(argCount, args, "stats");
+    if (!m) return val_nil();
+    gc_pin();
+    Value stats = val_dict();
+    dict_set(&stats, "tokens", val_number(m->n_tokens));
+    dict_set(&stats, "merges", val_number(m->n_merges));
+    dict_set(&stats, "next_id", val_number(m->next_id));
+    dict_set(&stats, "unk_id", val_number(m->unk_id));
+    dict_set(&stats, "vocab_size", val_number(m->vocab_size));
+    gc_unpin();
+    return stats;
+}
+
+Module* create_bpe_module(ModuleCache* cache) {
+    Module* m = create_native_module(cache, "_bpe");
+    Environment* e = m->env;
+
+    env_define_const(e, "byte_token", 10, val_native(bp_byte_token_native));
+    env_define_const(e, "create", 6, val_native(bp_create_native));
+    env_define_const(e, "train", 5, val_native(bp_train_native));
+    env_define_const(e, "encode", 6, val_native(bp_encode_native));
+    env_define_const(e, "encode_batch", 12, val_native(bp_encode_batch_native));
+    env_define_const(e, "decode", 6, val_native(bp_decode_native));
+    env_define_const(e, "export", 6, val_native(bp_export_native));
+    env_define_const(e, "save", 4, val_native(bp_save_native));
+    env_define_const(e, "load", 4, val_native(bp_load_native));
+    env_define_const(e, "stats", 5, val_native(bp_stats_native));
+
+    return m;
+}
@@ -10,6 +10,7 @@
 #include <unistd.h>
 
 #include "ast.h"
+#include "ast_arena.h"
 #include "gc.h"
 #include "lexer.h"
 #include "parser.h"
@@ -18,7 +19,7 @@
 #include <limits.h>
 
 // Forward declaration
-extern Stmt* parse_program(const char* source);
+extern Stmt* parse_program(const char* source, const char* input_path);
 
 // ============================================================================
 // Code Buffer Implementation
@@ -846,7 +847,7 @@ static void isel_stmt(ISelContext* ctx, Stmt* stmt) {
             if (!path) break;
             char* source = read_file(path);
             if (!source) { free(path); break; }
-            Stmt* mod_ast = parse_program(source);
+            Stmt* mod_ast = parse_program(source, path);
             char* old_mod = ctx->current_module;
             ctx->current_module = SAGE_STRDUP(stmt->as.import.module_name);
             isel_stmt_list(ctx, mod_ast);
@@ -874,7 +875,7 @@ static void isel_stmt(ISelContext* ctx, Stmt* stmt) {
 // ============================================================================
 
 VInst* isel_compile(const char* source, const char* input_path, int opt_level, int debug_info) {
-    Stmt* program = parse_program(source);
+    Stmt* program = parse_program(source, input_path);
 
     if (opt_level > 0) {
         PassContext pass_ctx;
@@ -882,6 +883,7 @@ VInst* isel_compile(const char* source, const char* input_path, int opt_level, i
         pass_ctx.debug_info = debug_info;
         pass_ctx.verbose = 0;
         pass_ctx.input_path = input_path;
+        pass_ctx.profile = NULL;
         program = run_passes(program, &pass_ctx);
     }
 
@@ -1548,10 +1550,11 @@ static void emit_asm_function_epilogue(FILE* out, CodegenTarget target) {
 
 static int write_asm_output(const char* source, const char* input_path, const char* output_path,
                             CodegenTargetSpec spec, int opt_level, int debug_info) {
-    Stmt* program = parse_program(source);
+    AstArena* arena = ast_arena_begin();
+    Stmt* program = parse_program(source, input_path);
 
     if (opt_level > 0) {
-        PassContext pass_ctx = { opt_level, debug_info, 0, input_path };
+        PassContext pass_ctx = { opt_level, debug_info, 0, input_path, NULL };
         program = run_passes(program, &pass_ctx);
     }
 
@@ -1562,7 +1565,7 @@ static int write_asm_output(const char* source, const char* input_path, const ch
     FILE* out = fopen(output_path, "w");
     if (out == NULL) {
         fprintf(stderr, "Could not open assembly output \"%s\": %s\n", output_path, strerror(errno));
-        free_stmt(program);
+        ast_arena_end(arena);
         isel_free(&ctx);
         return 0;
     }
@@ -1606,7 +1609,7 @@ static int write_asm_output(const char* source, const char* input_path, const ch
     }
 
     fclose(out);
-    free_stmt(program);
+    ast_arena_end(arena);
     isel_free(&ctx);
     return 1;
 }
@@ -5,6 +5,7 @@
 #include <errno.h>
 #include <limits.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -14,20 +15,29 @@
 #include <unistd.h>
 
 #include "ast.h"
+#include "ast_arena.h"
 #include "diagnostic.h"
+#include "gc.h"
 #include "lexer.h"
 #include "parser.h"
 #include "pass.h"
+#include "profile.h"
+
+#ifndef SAGE_VERSION_STR
+#define SAGE_VERSION_STR "dev"
+#endif
 
 typedef struct NameEntry {
   char *sage_name;
   char *c_name;
+  const char *module;  // declaring module of a global, NULL for the program
   struct NameEntry *next;
 } NameEntry;
 
 typedef struct ProcEntry {
   char *sage_name;
   char *c_name;
+  const char *module;  // declaring module, NULL for the program
   int param_count;
   struct ProcEntry *next;
 } ProcEntry;
@@ -35,6 +45,7 @@ typedef struct ProcEntry {
 typedef struct ClassInfo {
   char *class_name;
   char *parent_name;
+  const char *module;  // declaring module, NULL for the program
   Stmt *methods;
   struct ClassInfo *next;
 } ClassInfo;
@@ -59,6 +70,7 @@ typedef struct {
   const char *input_path;
   int failed;
   int in_function_body;
+  int shadow_frame;  // current function claimed shadow-stack slots
   int indent;
   int next_unique_id;
   NameEntry *globals;
@@ -67,6 +79,9 @@ typedef struct {
   ClassInfo *classes;
   ClassInfo *current_class;
   ImportedModule *modules;
+  const char *current_module;  // module being collected or emitted, NULL for the program
+  const SageProfile *profile;  // --profile-use data, NULL if none
+  int modular;  // one C unit per module: stable names, external linkage
 } Compiler;
 
 int g_sage_verbose = 0;
@@ -250,16 +265,66 @@ static NameEntry *find_name_entry(NameEntry *list, const char *sage_name) {
   return NULL;
 }
 
-static ProcEntry *find_proc_entry(ProcEntry *list, const char *sage_name) {
-  while (list != NULL) {
-    if (strcmp(list->sage_name, sage_name) == 0) {
+static int same_module(const char *left, const char *right) {
+  return left == right ||
+         (left != NULL && right != NULL && strcmp(left, right) == 0);
+}
+
+// Globals and procedures belong to the module that declares them, so two
+// modules may both define `helper`. An unqualified name resolves in the
+// current module first and otherwise to the oldest declaration anywhere,
+// which is what `from m import helper` relies on.
+static NameEntry *find_global_in(NameEntry *list, const char *module,
+                                 const char *sage_name) {
+  for (; list != NULL; list = list->next) {
+    if (same_module(list->module, module) &&
+        strcmp(list->sage_name, sage_name) == 0) {
+      return list;
+    }
+  }
+  return NULL;
+}
+
+static NameEntry *find_global_entry(Compiler *compiler,
+                                    const char *sage_name) {
+  NameEntry *oldest = NULL;
+  for (NameEntry *e = compiler->globals; e != NULL; e = e->next) {
+    if (strcmp(e->sage_name, sage_name) != 0) {
+      continue;
+    }
+    if (same_module(e->module, compiler->current_module)) {
+      return e;
+    }
+    oldest = e;
+  }
+  return oldest;
+}
+
+static ProcEntry *find_proc_in(ProcEntry *list, const char *module,
+                               const char *sage_name) {
+  for (; list != NULL; list = list->next) {
+    if (same_module(list->module, module) &&
+        strcmp(list->sage_name, sage_name) == 0) {
       return list;
     }
-    list = list->next;
   }
   return NULL;
 }
 
+static ProcEntry *find_proc_entry(Compiler *compiler, const char *sage_name) {
+  ProcEntry *oldest = NULL;
+  for (ProcEntry *e = compiler->procs; e != NULL; e = e->next) {
+    if (strcmp(e->sage_name, sage_name) != 0) {
+      continue;
+    }
+    if (same_module(e->module, compiler->current_module)) {
+      return e;
+    }
+    oldest = e;
+  }
+  return oldest;
+}
+
 static int token_span(const Token *token) {
   return (token != NULL && token->length > 0) ? token->length : 1;
 }
@@ -354,9 +419,32 @@ static char *make_unique_name(Compiler *compiler, const char *prefix,
   return sb_take(&sb);
 }
 
+// Symbols shared between units of a modular build are named after the
+// declaring module and the Sage identifier alone, so a module's generated C
+// (and its cached object) does not change when some other module gains or
+// loses a declaration, and same-named procedures in two modules still link.
+static char *make_stable_name(const char *prefix, const char *module,
+                              const char *sage_name) {
+  char *sanitized = sanitize_identifier(sage_name);
+  StringBuffer sb;
+  sb_init(&sb);
+  if (module != NULL) {
+    char *owner = sanitize_identifier(module);
+    sb_appendf(&sb, "%s__%s__%s", prefix, owner, sanitized);
+    free(owner);
+  } else {
+    sb_appendf(&sb, "%s__%s", prefix, sanitized);
+  }
+  free(sanitized);
+  return sb_take(&sb);
+}
+
 static NameEntry *add_name_entry(Compiler *compiler, NameEntry **list,
                                  const char *sage_name, const char *prefix) {
-  NameEntry *existing = find_name_entry(*list, sage_name);
+  int is_global = list == &compiler->globals;
+  const char *module = is_global ? compiler->current_module : NULL;
+  NameEntry *existing = is_global ? find_global_in(*list, module, sage_name)
+                                  : find_name_entry(*list, sage_name);
   if (existing != NULL) {
     return existing;
   }
@@ -368,7 +456,10 @@ static NameEntry *add_name_entry(Compiler *compiler, NameEntry **list,
   }
 
   entry->sage_name = str_dup(sage_name);
-  entry->c_name = make_unique_name(compiler, prefix, sage_name);
+  entry->module = module;
+  entry->c_name = compiler->modular && is_global
+                      ? make_stable_name(prefix, module, sage_name)
+                      : make_unique_name(compiler, prefix, sage_name);
   entry->next = *list;
   *list = entry;
   return entry;
@@ -377,11 +468,9 @@ static NameEntry *add_name_entry(Compiler *compiler, NameEntry **list,
 static ProcEntry *add_proc_entry(Compiler *compiler, const char *sage_name,
                                  int param_count, const Token *token) {
   (void)token;
-  ProcEntry *existing = find_proc_entry(compiler->procs, sage_name);
+  ProcEntry *existing =
+      find_proc_in(compiler->procs, compiler->current_module, sage_name);
   if (existing != NULL) {
-    /* Silently keep the first definition (module namespace collision is
-       expected when importing multiple modules that define common names like
-       'create') */
     return existing;
   }
 
@@ -392,7 +481,11 @@ static ProcEntry *add_proc_entry(Compiler *compiler, const char *sage_name,
   }
 
   entry->sage_name = str_dup(sage_name);
-  entry->c_name = make_unique_name(compiler, "sage_fn", sage_name);
+  entry->module = compiler->current_module;
+  entry->c_name =
+      compiler->modular
+          ? make_stable_name("sage_fn", compiler->current_module, sage_name)
+          : make_unique_name(compiler, "sage_fn", sage_name);
   entry->param_count = param_count;
   entry->next = compiler->procs;
   compiler->procs = entry;
@@ -532,6 +625,7 @@ static ClassInfo *add_class_info(Compiler *compiler, const char *name,
   }
   info->class_name = str_dup(name);
   info->parent_name = parent_name ? str_dup(parent_name) : NULL;
+  info->module = compiler->current_module;
   info->methods = methods;
   info->next = compiler->classes;
   compiler->classes = info;
@@ -552,8 +646,7 @@ static void free_imported_modules(ImportedModule *list) {
   while (list != NULL) {
     ImportedModule *next = list->next;
     free(list->name);
-    free(list->source);
-    free_stmt(list->ast);
+    free(list->source);  // list->ast lives in the unit's AST arena
     free(list);
     list = next;
   }
@@ -806,7 +899,8 @@ static void collect_global_lets(Compiler *compiler, Stmt *stmt) {
     switch (stmt->type) {
     case STMT_LET: {
       char *name = token_to_string(stmt->as.let.name);
-      if (find_proc_entry(compiler->procs, name) != NULL) {
+      if (find_proc_in(compiler->procs, compiler->current_module, name) !=
+          NULL) {
         compiler_error(compiler, "global '%s' conflicts with procedure name",
                        name);
       } else {
@@ -827,7 +921,8 @@ static void collect_global_lets(Compiler *compiler, Stmt *stmt) {
       break;
     case STMT_FOR: {
       char *var_name = token_to_string(stmt->as.for_stmt.variable);
-      if (find_proc_entry(compiler->procs, var_name) != NULL) {
+      if (find_proc_in(compiler->procs, compiler->current_module, var_name) !=
+          NULL) {
         compiler_error(compiler,
                        "for-loop variable '%s' conflicts with procedure name",
                        var_name);
@@ -871,7 +966,8 @@ static int is_native_module(const char *name) {
                            "socket",    "tcp",       "http",     "ssl",
                            "fat",       "gpu",       "graphics", "ml_native",
                            "compiler",  "vm_native", "vm",       "ffi",
-                           "net",       "string",
+                           "net",       "string",    "_json",
+                           "_textindex", "_vecindex", "_kvcache", "_bpe",
                            NULL};
   for (int i = 0; natives[i] != NULL; i++) {
     if (strcmp(name, natives[i]) == 0)
@@ -899,6 +995,7 @@ static void process_import(Compiler *compiler, ImportStmt *import) {
     mod->name = str_dup(import->module_name);
     mod->binding_name = str_dup(binding_name);
     mod->path = NULL;
+    mod->source = NULL;
     mod->ast = NULL;
     mod->next = compiler->modules;
     compiler->modules = mod;
@@ -956,7 +1053,9 @@ static void process_import(Compiler *compiler, ImportStmt *import) {
   /* Collect module's procs and classes — all procs must be compiled
      even if not explicitly imported, because opaque module references
      (e.g. json.repeat) need them at code emission time. */
-  for (Stmt *s = ast; s != NULL; s = s->next) {
+  const char *importer = compiler->current_module;
+  compiler->current_module = mod->name;
+  for (Stmt *s = ast; s != NULL && !compiler->failed; s = s->next) {
     if (s->type == STMT_PROC || s->type == STMT_ASYNC_PROC) {
       char *name = token_to_string(s->as.proc.name);
       add_proc_entry(compiler, name, s->as.proc.param_count, &s->as.proc.name);
@@ -975,18 +1074,17 @@ static void process_import(Compiler *compiler, ImportStmt *import) {
     }
     if (s->type == STMT_IMPORT) {
       process_import(compiler, &s->as.import);
-      if (compiler->failed)
-        return;
     }
   }
 
   /* Collect module's globals */
-  for (Stmt *s = ast; s != NULL; s = s->next) {
+  for (Stmt *s = ast; s != NULL && !compiler->failed; s = s->next) {
     if (s->type != STMT_PROC && s->type != STMT_ASYNC_PROC &&
         s->type != STMT_CLASS) {
       collect_global_lets(compiler, s);
     }
   }
+  compiler->current_module = importer;
 }
 
 static void collect_top_level_symbols(Compiler *compiler, Stmt *program) {
@@ -1032,12 +1130,12 @@ static const char *resolve_slot_name(Compiler *compiler,
     return local->c_name;
   }
 
-  NameEntry *global = find_name_entry(compiler->globals, sage_name);
+  NameEntry *global = find_global_entry(compiler, sage_name);
   if (global != NULL) {
     return global->c_name;
   }
 
-  ProcEntry *proc = find_proc_entry(compiler->procs, sage_name);
+  ProcEntry *proc = find_proc_entry(compiler, sage_name);
   if (proc != NULL) {
     return proc->c_name;
   }
@@ -1055,7 +1153,7 @@ static const char *resolve_slot_name(Compiler *compiler,
         char *name = token_to_string(s->as.proc.name);
         if (strcmp(name, sage_name) == 0) {
           free(name);
-          ProcEntry *pe = find_proc_entry(compiler->procs, sage_name);
+          ProcEntry *pe = find_proc_in(compiler->procs, mod->name, sage_name);
           if (pe)
             return pe->c_name;
         }
@@ -1064,7 +1162,7 @@ static const char *resolve_slot_name(Compiler *compiler,
         char *name = token_to_string(s->as.let.name);
         if (strcmp(name, sage_name) == 0) {
           free(name);
-          NameEntry *ge = find_name_entry(compiler->globals, sage_name);
+          NameEntry *ge = find_global_in(compiler->globals, mod->name, sage_name);
           if (ge)
             return ge->c_name;
         }
@@ -1086,7 +1184,7 @@ static const char *resolve_symbol_in_module(Compiler *compiler,
       char *sname = token_to_string(s->as.proc.name);
       if (strcmp(sname, name) == 0) {
         free(sname);
-        ProcEntry *pe = find_proc_entry(compiler->procs, name);
+        ProcEntry *pe = find_proc_in(compiler->procs, mod->name, name);
         return pe ? pe->c_name : NULL;
       }
       free(sname);
@@ -1094,7 +1192,7 @@ static const char *resolve_symbol_in_module(Compiler *compiler,
       char *sname = token_to_string(s->as.let.name);
       if (strcmp(sname, name) == 0) {
         free(sname);
-        NameEntry *ge = find_name_entry(compiler->globals, name);
+        NameEntry *ge = find_global_in(compiler->globals, mod->name, name);
         return ge ? ge->c_name : NULL;
       }
       free(sname);
@@ -1351,6 +1449,61 @@ static char *emit_binary_expr(Compiler *compiler, BinaryExpr *binary) {
   return sb_take(&sb);
 }
 
+static const char *branch_hint(int bias) {
+  return bias > 0 ? "SAGE_LIKELY" : bias < 0 ? "SAGE_UNLIKELY" : "";
+}
+
+/* Profile-guided devirtualization: a method call site that only ever saw
+ * one receiver class calls that class's method directly behind a class
+ * check, and falls back to the dynamic lookup otherwise. */
+static char *emit_devirtualized_call(Compiler *compiler, CallExpr *call,
+                                     const char *obj, const char *method) {
+  const char *class_name =
+      profile_monomorphic_class(compiler->profile, call->callee);
+  if (class_name == NULL)
+    return NULL;
+
+  for (ClassInfo *cls = find_class_info(compiler->classes, class_name);
+       cls != NULL;
+       cls = cls->parent_name ? find_class_info(compiler->classes,
+                                                cls->parent_name)
+                              : NULL) {
+    for (Stmt *m = cls->methods; m != NULL; m = m->next) {
+      if (m->type != STMT_PROC ||
+          m->as.proc.name.length != (int)strlen(method) ||
+          memcmp(m->as.proc.name.start, method, strlen(method)) != 0)
+        continue;
+      ProcStmt *proc = &m->as.proc;
+      int has_self = (proc->param_count > 0 && proc->params[0].length == 4 &&
+                      strncmp(proc->params[0].start, "self", 4) == 0);
+      if (call->arg_count != proc->param_count - (has_self ? 1 : 0))
+        return NULL;
+
+      StringBuffer sb;
+      sb_init(&sb);
+      sb_appendf(&sb, "({ SageValue _dv_obj = %s; SageValue _dv_args[%d] = {",
+                 obj, call->arg_count > 0 ? call->arg_count : 1);
+      for (int i = 0; i < call->arg_count; i++) {
+        if (i > 0)
+          sb_append(&sb, ", ");
+        char *arg = emit_expr(compiler, call->args[i]);
+        sb_append(&sb, arg);
+        free(arg);
+      }
+      if (call->arg_count == 0)
+        sb_append(&sb, "sage_nil()");
+      sb_appendf(&sb,
+                 "}; SAGE_LIKELY(sage_has_class(_dv_obj, \"%s\")) ? "
+                 "sage_method_%s_%s(_dv_obj, %d, _dv_args) : "
+                 "sage_call_method(_dv_obj, \"%s\", %d, _dv_args); })",
+                 class_name, cls->class_name, method, call->arg_count, method,
+                 call->arg_count);
+      return sb_take(&sb);
+    }
+  }
+  return NULL;
+}
+
 static char *emit_call_expr(Compiler *compiler, CallExpr *call) {
   /* Super call: super.method(args) */
   if (call->callee->type == EXPR_SUPER) {
@@ -1521,7 +1674,8 @@ static char *emit_call_expr(Compiler *compiler, CallExpr *call) {
           StringBuffer sb;
           sb_init(&sb);
           /* Pad missing optional args with sage_nil() for default params */
-          ProcEntry *pe = find_proc_entry(compiler->procs, method_name);
+          ProcEntry *pe =
+              find_proc_in(compiler->procs, target_mod->name, method_name);
           int required = pe ? pe->param_count : call->arg_count;
           int emit_count = call->arg_count > required ? call->arg_count : required;
           sb_appendf(&sb, "%s(", c_name);
@@ -1580,6 +1734,13 @@ static char *emit_call_expr(Compiler *compiler, CallExpr *call) {
 
     char *obj = emit_expr(compiler, call->callee->as.get.object);
     char *method = token_to_string(call->callee->as.get.property);
+    char *direct = emit_devirtualized_call(compiler, call, obj, method);
+    if (direct != NULL) {
+      free(obj);
+      free(method);
+      free(obj_name);
+      return direct;
+    }
     StringBuffer msb;
     sb_init(&msb);
     if (call->arg_count == 0) {
@@ -2663,7 +2824,7 @@ static char *emit_call_expr(Compiler *compiler, CallExpr *call) {
     return sb_take(&sb);
   }
 
-  ProcEntry *proc = find_proc_entry(compiler->procs, callee_name);
+  ProcEntry *proc = find_proc_entry(compiler, callee_name);
   if (proc == NULL) {
     /* Not a named proc — try dynamic dispatch for function-valued variables (callbacks, etc.) */
     char *callee_expr = emit_expr(compiler, call->callee);
@@ -2920,6 +3081,62 @@ static void emit_embedded_block(Compiler *compiler, Stmt *stmt) {
   compiler->indent--;
 }
 
+// `for v in range(...)` marked counted by the loop pass: steps a C counter
+// through the range with sage_rangeN()'s semantics instead of building the
+// array. Arguments are evaluated once, in order, before the loop.
+static void emit_counted_for(Compiler *compiler, Stmt *stmt) {
+  Expr *range = stmt->as.for_stmt.iterable;
+  int argc = range->as.call.arg_count;
+  char *var_name = token_to_string(stmt->as.for_stmt.variable);
+  const char *slot_name = resolve_slot_name(compiler, var_name);
+  if (slot_name == NULL) {
+    compiler_error_at(
+        compiler, &stmt->as.for_stmt.variable, NULL,
+        "internal compiler error: for-loop variable '%s' was not collected",
+        var_name);
+    free(var_name);
+    return;
+  }
+  char *bound[3] = {NULL, NULL, NULL};
+  for (int i = 0; i < argc; i++) {
+    bound[i] = emit_expr(compiler, range->as.call.args[i]);
+  }
+  char *idx_var = make_unique_name(compiler, "sage_idx", var_name);
+  emit_line(compiler, "{");
+  compiler->indent++;
+  if (argc == 1) {
+    emit_line(compiler, "SageValue %s_start = sage_number(0), %s_end = %s, %s_step = sage_number(1);",
+              idx_var, idx_var, bound[0], idx_var);
+  } else {
+    emit_line(compiler, "SageValue %s_start = %s;", idx_var, bound[0]);
+    emit_line(compiler, "SageValue %s_end = %s;", idx_var, bound[1]);
+    emit_line(compiler, "SageValue %s_step = %s;", idx_var,
+              argc == 3 ? bound[2] : "sage_number(1)");
+  }
+  emit_line(compiler,
+            "if (%s_start.type == SAGE_TAG_NUMBER && %s_end.type == SAGE_TAG_NUMBER && "
+            "%s_step.type == SAGE_TAG_NUMBER && (int)%s_step.as.number != 0) {",
+            idx_var, idx_var, idx_var, idx_var);
+  compiler->indent++;
+  emit_line(compiler, "long long %s_e = (int)%s_end.as.number, %s_st = (int)%s_step.as.number;",
+            idx_var, idx_var, idx_var, idx_var);
+  emit_line(compiler,
+            "for (long long %s = (int)%s_start.as.number; %s_st > 0 ? %s < %s_e : %s > %s_e; %s += %s_st) {",
+            idx_var, idx_var, idx_var, idx_var, idx_var, idx_var, idx_var, idx_var, idx_var);
+  compiler->indent++;
+  emit_line(compiler, "sage_define_slot(&%s, sage_number((double)%s));", slot_name, idx_var);
+  emit_embedded_block(compiler, stmt->as.for_stmt.body);
+  compiler->indent--;
+  emit_line(compiler, "}");
+  compiler->indent--;
+  emit_line(compiler, "}");
+  compiler->indent--;
+  emit_line(compiler, "}");
+  for (int i = 0; i < argc; i++) free(bound[i]);
+  free(idx_var);
+  free(var_name);
+}
+
 static void emit_stmt(Compiler *compiler, Stmt *stmt) {
   switch (stmt->type) {
   case STMT_PRINT: {
@@ -2956,7 +3173,10 @@ static void emit_stmt(Compiler *compiler, Stmt *stmt) {
   }
   case STMT_IF: {
     char *condition = emit_expr(compiler, stmt->as.if_stmt.condition);
-    emit_line(compiler, "if (sage_truthy(%s)) {", condition);
+    emit_line(compiler, "if (%s(sage_truthy(%s))) {",
+              branch_hint(profile_branch_bias(compiler->profile,
+                                              stmt->as.if_stmt.condition)),
+              condition);
     free(condition);
     emit_embedded_block(compiler, stmt->as.if_stmt.then_branch);
     emit_line(compiler, "}");
@@ -2972,7 +3192,11 @@ static void emit_stmt(Compiler *compiler, Stmt *stmt) {
     break;
   case STMT_WHILE: {
     char *condition = emit_expr(compiler, stmt->as.while_stmt.condition);
-    emit_line(compiler, "while (sage_truthy(%s)) {", condition);
+    emit_line(compiler, "while (%s(sage_truthy(%s))) {",
+              branch_hint(profile_loop_bias(
+                  compiler->profile,
+                  profile_anchor(stmt->as.while_stmt.condition))),
+              condition);
     free(condition);
     emit_embedded_block(compiler, stmt->as.while_stmt.body);
     emit_line(compiler, "}");
@@ -2982,8 +3206,10 @@ static void emit_stmt(Compiler *compiler, Stmt *stmt) {
     char *expr = stmt->as.ret.value != NULL
                      ? emit_expr(compiler, stmt->as.ret.value)
                      : NULL;
-    if (compiler->in_function_body) {
-      emit_line(compiler, "return sage_gc_return(&sage_gc_frame, %s);",
+    if (compiler->in_function_body && !compiler->shadow_frame) {
+      emit_line(compiler, "return %s;", expr ? expr : "sage_nil()");
+    } else if (compiler->in_function_body) {
+      emit_line(compiler, "return sage_gc_return(sage_slots, %s);",
                expr ? expr : "sage_nil()");
     } else {
       if (expr) {
@@ -3004,6 +3230,10 @@ static void emit_stmt(Compiler *compiler, Stmt *stmt) {
   case STMT_PROC:
     break;
   case STMT_FOR: {
+    if (stmt->as.for_stmt.counted) {
+      emit_counted_for(compiler, stmt);
+      break;
+    }
     char *iterable = emit_expr(compiler, stmt->as.for_stmt.iterable);
     char *var_name = token_to_string(stmt->as.for_stmt.variable);
     const char *slot_name = resolve_slot_name(compiler, var_name);
@@ -3020,7 +3250,11 @@ static void emit_stmt(Compiler *compiler, Stmt *stmt) {
     char *idx_var = make_unique_name(compiler, "sage_idx", var_name);
     emit_line(compiler, "{");
     compiler->indent++;
+    // The iterable is a temporary the body can outlive a collection with,
+    // so it gets a shadow-stack slot of its own
     emit_line(compiler, "SageValue %s = %s;", iter_var, iterable);
+    emit_line(compiler, "SageSlot* %s_root = sage_gc_enter(1);", iter_var);
+    emit_line(compiler, "sage_define_slot(%s_root, %s);", iter_var, iter_var);
     emit_line(compiler, "if (%s.type == SAGE_TAG_ARRAY) {", iter_var);
     compiler->indent++;
     emit_line(compiler, "for (int %s = 0; %s < %s.as.array->count; %s++) {",
@@ -3046,6 +3280,7 @@ static void emit_stmt(Compiler *compiler, Stmt *stmt) {
     emit_line(compiler, "}");
     compiler->indent--;
     emit_line(compiler, "}");
+    emit_line(compiler, "sage_gc_leave(%s_root);", iter_var);
     compiler->indent--;
     emit_line(compiler, "}");
     free(var_name);
@@ -3062,6 +3297,7 @@ static void emit_stmt(Compiler *compiler, Stmt *stmt) {
               "if (sage_try_depth >= SAGE_MAX_TRY_DEPTH) sage_fail(\"Runtime "
               "Error: try nesting too deep (max 1024)\");");
     emit_line(compiler, "int _caught = 0;");
+    emit_line(compiler, "SageSlot* _gc_top = sage_gc_stack_top;");
     emit_line(compiler, "sage_try_depth++;");
     emit_line(compiler,
               "if (setjmp(sage_try_stack[sage_try_depth - 1]) == 0) {");
@@ -3069,6 +3305,8 @@ static void emit_stmt(Compiler *compiler, Stmt *stmt) {
     emit_line(compiler, "} else {");
     compiler->indent++;
     emit_line(compiler, "_caught = 1;");
+    // Slots of the functions the raise unwound through are gone
+    emit_line(compiler, "sage_gc_leave(_gc_top);");
     if (try_stmt->catch_count > 0) {
       char *catch_var = token_to_string(try_stmt->catches[0]->exception_var);
       const char *catch_slot = resolve_slot_name(compiler, catch_var);
@@ -3118,14 +3356,15 @@ static void emit_stmt(Compiler *compiler, Stmt *stmt) {
 
     for (ImportedModule *m = compiler->modules; m != NULL; m = m->next) {
       if (strcmp(m->name, imp->module_name) == 0) {
-        for (Stmt *s = m->ast; s != NULL; s = s->next) {
+        const char *importer = compiler->current_module;
+        compiler->current_module = m->name;
+        for (Stmt *s = m->ast; s != NULL && !compiler->failed; s = s->next) {
           if (s->type != STMT_PROC && s->type != STMT_ASYNC_PROC &&
               s->type != STMT_CLASS) {
             emit_stmt(compiler, s);
-            if (compiler->failed)
-              return;
           }
         }
+        compiler->current_module = importer;
         break;
       }
     }
@@ -3195,7 +3434,29 @@ static void emit_stmt_list(Compiler *compiler, Stmt *stmt) {
   }
 }
 
-static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
+// How a unit sees the runtime. A whole-program file keeps every helper and
+// all mutable state (GC heap, try stack, class registry) private; a modular
+// build compiles them once into a runtime unit that the other units declare.
+typedef enum {
+  RUNTIME_STATE_PRIVATE,
+  RUNTIME_STATE_DEFINE,
+  RUNTIME_STATE_EXTERN
+} RuntimeState;
+
+static void emit_runtime_state(FILE *out, RuntimeState state,
+                               const char *declaration,
+                               const char *initializer) {
+  if (state == RUNTIME_STATE_EXTERN) {
+    fprintf(out, "extern %s;\n", declaration);
+    return;
+  }
+  fprintf(out, "%s%s%s%s;\n", state == RUNTIME_STATE_PRIVATE ? "static " : "",
+          declaration, initializer != NULL ? " = " : "",
+          initializer != NULL ? initializer : "");
+}
+
+static void emit_runtime_prelude(FILE *out, CompilerTarget target,
+                                 RuntimeState state) {
   fputs("#define _POSIX_C_SOURCE 200809L\n"
         "#include <math.h>\n"
         "#include <setjmp.h>\n"
@@ -3217,13 +3478,31 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
     fputs("#include \"pico/stdlib.h\"\n", out);
   }
 
+  // SAGE_RUNTIME helpers are compiled once into the runtime unit of a
+  // modular build; the small static inline ones on hot paths are repeated in
+  // every unit so calls to them still inline across modules.
+  fprintf(out, "\n#define SAGE_RUNTIME%s\n",
+          state == RUNTIME_STATE_PRIVATE ? " static" : "");
+
   fputs("\n"
         "// Security: Cap entire-file reads to 100MB to prevent memory exhaustion DoS attacks.\n"
         "#define SAGE_MAX_READ_SIZE (100 * 1024 * 1024)\n"
         "\n"
+        "// Profile-guided layout hints (--profile-use)\n"
+        "#if defined(__GNUC__)\n"
+        "#define SAGE_LIKELY(x) __builtin_expect(!!(x), 1)\n"
+        "#define SAGE_UNLIKELY(x) __builtin_expect(!!(x), 0)\n"
+        "#define SAGE_HOT __attribute__((hot))\n"
+        "#define SAGE_COLD __attribute__((cold))\n"
+        "#else\n"
+        "#define SAGE_LIKELY(x) (x)\n"
+        "#define SAGE_UNLIKELY(x) (x)\n"
+        "#define SAGE_HOT\n"
+        "#define SAGE_COLD\n"
+        "#endif\n"
+        "\n"
         "typedef struct SageValue SageValue;\n"
         "typedef struct SageGcHeader SageGcHeader;\n"
-        "typedef struct SageGcFrame SageGcFrame;\n"
         "\n"
         "typedef struct {\n"
         "    int count;\n"
@@ -3264,8 +3543,10 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
         "    int count;\n"
         "} SageBytes;\n"
         "\n"
+        "/* The tag is a full word so a value has no padding: values held in\n"
+        "   registers are then returned without a partial store and reload */\n"
         "struct SageValue {\n"
-        "    SageTag type;\n"
+        "    intptr_t type; /* SageTag */\n"
         "    union {\n"
         "        double number;\n"
         "        int boolean;\n"
@@ -3301,15 +3582,8 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
         "    SageGcHeader* next;\n"
         "};\n"
         "\n"
-        "struct SageGcFrame {\n"
-        "    SageGcFrame* prev;\n"
-        "    SageSlot** slots;\n"
-        "    int slot_count;\n"
-        "};\n"
-        "\n"
         "typedef struct {\n"
         "    SageGcHeader* objects;\n"
-        "    SageGcFrame* frames;\n"
         "    int object_count;\n"
         "    int collections;\n"
         "    int pin_count;\n"
@@ -3320,32 +3594,55 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
         "    int enabled;\n"
         "} SageGcState;\n"
         "\n"
-         "#define SAGE_GC_MIN_TRIGGER_BYTES 65536UL\n"
-         "#define SAGE_GC_MIN_TRIGGER_OBJECTS 128\n"
-         "static SageGcState sage_gc = {NULL, NULL, 0, 0, 0, 0, 0, "
-         "SAGE_GC_MIN_TRIGGER_BYTES, SAGE_GC_MIN_TRIGGER_OBJECTS, 1};\n"
-        "\n"
+        "#define SAGE_GC_MIN_TRIGGER_BYTES 65536UL\n"
+        "#define SAGE_GC_MIN_TRIGGER_OBJECTS 128\n",
+        out);
+  emit_runtime_state(out, state, "SageGcState sage_gc",
+                     "{NULL, 0, 0, 0, 0, 0, SAGE_GC_MIN_TRIGGER_BYTES, "
+                     "SAGE_GC_MIN_TRIGGER_OBJECTS, 1}");
+
+  // Shadow stack of rooted locals. Every function that can reach a
+  // collection claims a fixed block of slots here on entry; the block's
+  // layout is decided at compile time, so the stack itself is the stack map
+  // and the collector only walks it when it actually runs.
+  fprintf(out,
+          "\n"
+          "#ifndef SAGE_GC_STACK_SLOTS\n"
+          "#define SAGE_GC_STACK_SLOTS %d\n"
+          "#endif\n",
+          (target == COMPILER_TARGET_RP2040 ||
+           target == COMPILER_TARGET_RP2350_ARM ||
+           target == COMPILER_TARGET_RP2350_RISCV)
+              ? 1024
+              : 262144);
+  emit_runtime_state(out, state, "SageSlot sage_gc_stack[SAGE_GC_STACK_SLOTS]",
+                     NULL);
+  emit_runtime_state(out, state, "SageSlot* sage_gc_stack_top",
+                     "sage_gc_stack");
+  fputs("\n"
         "#define SAGE_STRING_LEN(v) ((int)(((SageGcHeader*)(v).as.string - 1)->size - 1))\n"
         "\n",
         out);
+  fputs("/* Exception handling via setjmp/longjmp */\n"
+        "#define SAGE_MAX_TRY_DEPTH 1024\n",
+        out);
+  emit_runtime_state(out, state, "jmp_buf sage_try_stack[SAGE_MAX_TRY_DEPTH]",
+                     NULL);
+  emit_runtime_state(out, state, "SageValue sage_exception_value", NULL);
+  emit_runtime_state(out, state, "int sage_try_depth", "0");
   fputs(
-      "/* Exception handling via setjmp/longjmp */\n"
-      "#define SAGE_MAX_TRY_DEPTH 1024\n"
-      "static jmp_buf sage_try_stack[SAGE_MAX_TRY_DEPTH];\n"
-      "static SageValue sage_exception_value;\n"
-      "static int sage_try_depth = 0;\n"
       "\n"
-      "static void sage_fail(const char* message) {\n"
+      "SAGE_RUNTIME void sage_fail(const char* message) {\n"
       "    fputs(message, stderr);\n"
       "    fputc('\\n', stderr);\n"
       "    exit(1);\n"
       "}\n"
       "\n"
-      "static unsigned long sage_gc_live_bytes(void) {\n"
+      "SAGE_RUNTIME unsigned long sage_gc_live_bytes(void) {\n"
       "    return sage_gc.bytes_allocated - sage_gc.bytes_freed;\n"
       "}\n"
       "\n"
-      "static void sage_gc_recompute_thresholds(unsigned long reclaimed_bytes, "
+      "SAGE_RUNTIME void sage_gc_recompute_thresholds(unsigned long reclaimed_bytes, "
       "int reclaimed_objects) {\n"
       "    unsigned long live_bytes = sage_gc_live_bytes();\n"
       "    int live_objects = sage_gc.object_count;\n"
@@ -3377,7 +3674,7 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
       "sage_gc.next_gc_objects = SAGE_GC_MIN_TRIGGER_OBJECTS;\n"
       "}\n"
       "\n"
-      "static int sage_gc_try_mark(void* object) {\n"
+      "SAGE_RUNTIME int sage_gc_try_mark(void* object) {\n"
       "    if (object == NULL) return 0;\n"
       "    SageGcHeader* header = ((SageGcHeader*)object) - 1;\n"
       "    if (header->marked) return 0;\n"
@@ -3385,25 +3682,19 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
       "    return 1;\n"
       "}\n"
       "\n"
-      "static void sage_gc_mark_value(SageValue value);\n"
+      "SAGE_RUNTIME void sage_gc_mark_value(SageValue value);\n"
       "extern void sage_gc_mark_program_globals(void);\n"
       "\n"
-      "static void sage_gc_mark_roots(void) {\n"
+      "SAGE_RUNTIME void sage_gc_mark_roots(void) {\n"
       "    sage_gc_mark_program_globals();\n"
-      "    for (SageGcFrame* frame = sage_gc.frames; frame != NULL; frame = "
-      "frame->prev) {\n"
-      "        if (frame->slots == NULL) continue;\n"
-      "        for (int i = 0; i < frame->slot_count; i++) {\n"
-      "            if (frame->slots[i] != NULL && frame->slots[i]->defined) {\n"
-      "                sage_gc_mark_value(frame->slots[i]->value);\n"
-      "            }\n"
-      "        }\n"
+      "    for (SageSlot* slot = sage_gc_stack; slot < sage_gc_stack_top; slot++) {\n"
+      "        if (slot->defined) sage_gc_mark_value(slot->value);\n"
       "    }\n"
       "    if (sage_try_depth > 0) sage_gc_mark_value(sage_exception_value);\n"
       "}\n"
       "\n",
       out);
-  fputs("static size_t sage_gc_release_object(SageGcHeader* header) {\n"
+  fputs("SAGE_RUNTIME size_t sage_gc_release_object(SageGcHeader* header) {\n"
         "    void* object = (void*)(header + 1);\n"
         "    size_t freed = sizeof(SageGcHeader) + header->size;\n"
         "    switch ((SageGcKind)header->kind) {\n"
@@ -3435,7 +3726,7 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
         "}\n"
         "\n",
         out);
-  fputs("static void sage_gc_collect(void) {\n"
+  fputs("SAGE_RUNTIME void sage_gc_collect(void) {\n"
         "    if (!sage_gc.enabled) return;\n"
         "    unsigned long before_bytes = sage_gc_live_bytes();\n"
         "    int before_objects = sage_gc.object_count;\n"
@@ -3460,7 +3751,7 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
         "\n",
         out);
   fputs(
-      "static int sage_gc_should_collect(size_t incoming_size) {\n"
+      "SAGE_RUNTIME int sage_gc_should_collect(size_t incoming_size) {\n"
       "    if (!sage_gc.enabled || sage_gc.pin_count > 0) return 0;\n"
       "    if ((sage_gc.object_count + 1) >= sage_gc.next_gc_objects) return "
       "1;\n"
@@ -3468,9 +3759,8 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
       "(unsigned long)incoming_size >= sage_gc.next_gc_bytes;\n"
       "}\n"
       "\n"
-      "static void* sage_gc_alloc(SageGcKind kind, size_t size) {\n"
-      "    if (sage_gc.frames != NULL && sage_gc_should_collect(size)) "
-      "sage_gc_collect();\n"
+      "SAGE_RUNTIME void* sage_gc_alloc(SageGcKind kind, size_t size) {\n"
+      "    if (sage_gc_should_collect(size)) sage_gc_collect();\n"
       "    size_t total = sizeof(SageGcHeader) + size;\n"
       "    SageGcHeader* header = (SageGcHeader*)malloc(total);\n"
       "    if (header == NULL) sage_fail(\"Runtime Error: out of memory\");\n"
@@ -3484,28 +3774,28 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
       "    return (void*)(header + 1);\n"
       "}\n"
       "\n"
-      "static void sage_gc_push_frame(SageGcFrame* frame, SageSlot** slots, "
-      "int slot_count) {\n"
-      "    frame->prev = sage_gc.frames;\n"
-      "    frame->slots = slots;\n"
-      "    frame->slot_count = slot_count;\n"
-      "    sage_gc.frames = frame;\n"
+      "static inline SageSlot* sage_gc_enter(int slot_count) {\n"
+      "    SageSlot* slots = sage_gc_stack_top;\n"
+      "    if (SAGE_UNLIKELY(slot_count > sage_gc_stack + SAGE_GC_STACK_SLOTS - slots)) "
+      "sage_fail(\"Runtime Error: stack overflow\");\n"
+      "    for (int i = 0; i < slot_count; i++) slots[i].defined = 0;\n"
+      "    sage_gc_stack_top = slots + slot_count;\n"
+      "    return slots;\n"
       "}\n"
       "\n"
-      "static void sage_gc_pop_frame(SageGcFrame* frame) {\n"
-      "    if (sage_gc.frames == frame) sage_gc.frames = frame->prev;\n"
-      "}\n"
+      "/* Also drops the slots of any for loop the function returns out of */\n"
+      "static inline void sage_gc_leave(SageSlot* slots) { sage_gc_stack_top = slots; }\n"
       "\n"
-      "static void sage_gc_pin(void) { sage_gc.pin_count++; }\n"
-      "static void sage_gc_unpin(void) { if (sage_gc.pin_count > 0) "
+      "static inline void sage_gc_pin(void) { sage_gc.pin_count++; }\n"
+      "static inline void sage_gc_unpin(void) { if (sage_gc.pin_count > 0) "
       "sage_gc.pin_count--; }\n"
       "\n"
-      "static SageValue sage_gc_return(SageGcFrame* frame, SageValue value) {\n"
-      "    sage_gc_pop_frame(frame);\n"
+      "static inline SageValue sage_gc_return(SageSlot* slots, SageValue value) {\n"
+      "    sage_gc_leave(slots);\n"
       "    return value;\n"
       "}\n"
       "\n"
-      "static void sage_gc_shutdown(void) {\n"
+      "SAGE_RUNTIME void sage_gc_shutdown(void) {\n"
       "    SageGcHeader* object = sage_gc.objects;\n"
       "    while (object != NULL) {\n"
       "        SageGcHeader* next = object->next;\n"
@@ -3518,7 +3808,7 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
       "}\n"
       "\n",
       out);
-  fputs("static void sage_gc_mark_value(SageValue value) {\n"
+  fputs("SAGE_RUNTIME void sage_gc_mark_value(SageValue value) {\n"
         "    switch (value.type) {\n"
         "        case SAGE_TAG_STRING:\n"
         "            (void)sage_gc_try_mark((void*)value.as.string);\n"
@@ -3546,7 +3836,7 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
         "    }\n"
         "}\n"
         "\n"
-        "static char* sage_dup_string(const char* text) {\n"
+        "SAGE_RUNTIME char* sage_dup_string(const char* text) {\n"
         "    size_t len = strlen(text);\n"
         "    char* copy = (char*)malloc(len + 1);\n"
         "    if (copy == NULL) sage_fail(\"Runtime Error: out of memory\");\n"
@@ -3554,14 +3844,14 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
         "    return copy;\n"
         "}\n"
         "\n"
-        "static char* sage_gc_copy_string(const char* text) {\n"
+        "SAGE_RUNTIME char* sage_gc_copy_string(const char* text) {\n"
         "    size_t len = strlen(text);\n"
         "    char* copy = (char*)sage_gc_alloc(SAGE_GC_STRING, len + 1);\n"
         "    memcpy(copy, text, len + 1);\n"
         "    return copy;\n"
         "}\n"
         "\n"
-        "static SageArray* sage_new_array(void) {\n"
+        "SAGE_RUNTIME SageArray* sage_new_array(void) {\n"
         "    SageArray* array = (SageArray*)sage_gc_alloc(SAGE_GC_ARRAY, "
         "sizeof(SageArray));\n"
         "    array->count = 0;\n"
@@ -3570,21 +3860,21 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
         "    return array;\n"
         "}\n"
         "\n"
-        "static SageValue sage_nil(void) { SageValue v; v.type = SAGE_TAG_NIL; "
+        "static inline SageValue sage_nil(void) { SageValue v; v.type = SAGE_TAG_NIL; "
         "v.as.number = 0; return v; }\n"
-        "static SageValue sage_number(double value) { SageValue v; v.type = "
+        "static inline SageValue sage_number(double value) { SageValue v; v.type = "
         "SAGE_TAG_NUMBER; v.as.number = value; return v; }\n"
-        "static SageValue sage_bool(int value) { SageValue v; v.type = "
+        "static inline SageValue sage_bool(int value) { SageValue v; v.type = "
         "SAGE_TAG_BOOL; v.as.boolean = value ? 1 : 0; return v; }\n"
-        "static SageValue sage_string(const char* value) { SageValue v; v.type "
+        "SAGE_RUNTIME SageValue sage_string(const char* value) { SageValue v; v.type "
         "= SAGE_TAG_STRING; v.as.string = sage_gc_copy_string(value == NULL ? "
         "\"\" : value); return v; }\n"
-        "static SageValue sage_string_take(char* value) { SageValue v = "
+        "SAGE_RUNTIME SageValue sage_string_take(char* value) { SageValue v = "
         "sage_string(value == NULL ? \"\" : value); free(value); return v; }\n"
-        "static SageValue sage_array(void) { SageValue v; v.type = "
+        "SAGE_RUNTIME SageValue sage_array(void) { SageValue v; v.type = "
         "SAGE_TAG_ARRAY; v.as.array = sage_new_array(); return v; }\n"
-         "static SageValue sage_function(void* fn) { SageValue v; v.type = SAGE_TAG_FUNCTION; v.as.function = fn; return v; }\n"
-         "static SageValue sage_call_any(SageValue fn, int argc, SageValue* argv) {\n"
+         "SAGE_RUNTIME SageValue sage_function(void* fn) { SageValue v; v.type = SAGE_TAG_FUNCTION; v.as.function = fn; return v; }\n"
+         "SAGE_RUNTIME SageValue sage_call_any(SageValue fn, int argc, SageValue* argv) {\n"
          "    if (fn.type == SAGE_TAG_FUNCTION) {\n"
          "        switch (argc) {\n"
          "            case 0: return ((SageValue (*)(void))fn.as.function)();\n"
@@ -3601,7 +3891,7 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
          "        }\n"
          "    }\n"
      
-         "    fprintf(stderr, \"Runtime Error: Cannot call non-function value (type=%d).\\n\", fn.type);\n"
+         "    fprintf(stderr, \"Runtime Error: Cannot call non-function value (type=%d).\\n\", (int)fn.type);\n"
          "    exit(1);\n"
          "    return sage_nil();\n"
          "}\n"
@@ -3611,18 +3901,18 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
   /* FFI runtime: dlopen/dlsym only for desktop targets.
      Pico/baremetal targets get stubs (platform bridge overrides them). */
   if (target == COMPILER_TARGET_HOST) {
-    fputs("static SageValue sage_ffi_open(SageValue libname) {\n"
+    fputs("SAGE_RUNTIME SageValue sage_ffi_open(SageValue libname) {\n"
           "    if (libname.type != SAGE_TAG_STRING) return sage_nil();\n"
           "    void* handle = dlopen(libname.as.string, RTLD_NOW);\n"
           "    if (!handle) return sage_nil();\n"
           "    SageValue v; v.type = SAGE_TAG_CLIB; v.as.clib = handle; return v;\n"
           "}\n"
-          "static SageValue sage_ffi_close(SageValue handle) {\n"
+          "SAGE_RUNTIME SageValue sage_ffi_close(SageValue handle) {\n"
           "    if (handle.type != SAGE_TAG_CLIB) return sage_nil();\n"
           "    dlclose(handle.as.clib);\n"
           "    return sage_nil();\n"
           "}\n"
-          "static SageValue sage_ffi_call(SageValue handle, SageValue name, SageValue ret_type, SageValue args) {\n"
+          "SAGE_RUNTIME SageValue sage_ffi_call(SageValue handle, SageValue name, SageValue ret_type, SageValue args) {\n"
         "    if (handle.type != SAGE_TAG_CLIB || name.type != SAGE_TAG_STRING || ret_type.type != SAGE_TAG_STRING)\n"
         "        return sage_nil();\n"
         "    void* lib_handle = handle.as.clib;\n"
@@ -3678,66 +3968,66 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
         "    #undef IS_STR\n"
         "    return sage_nil();\n"
         "}\n"
-        "static SageValue sage_ffi_call_full(SageValue h, SageValue n, SageValue r, SageValue a) { return sage_ffi_call(h,n,r,a); }\n"
+        "SAGE_RUNTIME SageValue sage_ffi_call_full(SageValue h, SageValue n, SageValue r, SageValue a) { return sage_ffi_call(h,n,r,a); }\n"
         "\n",
         out);
   } else {
     /* Pico/baremetal: stubs that platform bridge must override */
-    fputs("static SageValue sage_ffi_open(SageValue libname) {"
+    fputs("SAGE_RUNTIME SageValue sage_ffi_open(SageValue libname) {"
           " (void)libname; return sage_nil(); }\n"
-          "static SageValue sage_ffi_close(SageValue handle) {"
+          "SAGE_RUNTIME SageValue sage_ffi_close(SageValue handle) {"
           " (void)handle; return sage_nil(); }\n"
-          "static SageValue sage_ffi_call(SageValue h, SageValue n, SageValue r, SageValue a) {"
+          "SAGE_RUNTIME SageValue sage_ffi_call(SageValue h, SageValue n, SageValue r, SageValue a) {"
           " (void)h; (void)n; (void)r; (void)a; return sage_nil(); }\n"
-          "static SageValue sage_ffi_call_full(SageValue h, SageValue n, SageValue r, SageValue a) {"
+          "SAGE_RUNTIME SageValue sage_ffi_call_full(SageValue h, SageValue n, SageValue r, SageValue a) {"
           " (void)h; (void)n; (void)r; (void)a; return sage_nil(); }\n"
           "\n",
           out);
   }
 
-  fputs("static SageValue sage_atomic_new(SageValue val) {\n"
+  fputs("SAGE_RUNTIME SageValue sage_atomic_new(SageValue val) {\n"
         "    SageValue* atom = malloc(sizeof(SageValue));\n"
         "    *atom = val;\n"
         "    SageValue v; v.type = SAGE_TAG_POINTER; v.as.pointer = atom; return v;\n"
         "}\n"
-        "static SageValue sage_atomic_load(SageValue atom) {\n"
+        "SAGE_RUNTIME SageValue sage_atomic_load(SageValue atom) {\n"
         "    if (atom.type != SAGE_TAG_POINTER) return sage_nil();\n"
         "    return *(SageValue*)atom.as.pointer;\n"
         "}\n"
-        "static SageValue sage_atomic_store(SageValue atom, SageValue val) {\n"
+        "SAGE_RUNTIME SageValue sage_atomic_store(SageValue atom, SageValue val) {\n"
         "    if (atom.type != SAGE_TAG_POINTER) return sage_nil();\n"
         "    *(SageValue*)atom.as.pointer = val;\n"
         "    return val;\n"
         "}\n"
-        "static SageValue sage_atomic_add(SageValue atom, SageValue val) { return sage_nil(); }\n"
-        "static SageValue sage_atomic_cas(SageValue atom, SageValue old, SageValue new_val) { return sage_nil(); }\n"
-        "static SageValue sage_atomic_exchange(SageValue atom, SageValue val) { return sage_nil(); }\n"
+        "SAGE_RUNTIME SageValue sage_atomic_add(SageValue atom, SageValue val) { return sage_nil(); }\n"
+        "SAGE_RUNTIME SageValue sage_atomic_cas(SageValue atom, SageValue old, SageValue new_val) { return sage_nil(); }\n"
+        "SAGE_RUNTIME SageValue sage_atomic_exchange(SageValue atom, SageValue val) { return sage_nil(); }\n"
         "\n"
-        "static SageValue sage_sem_new(SageValue val) {\n"
+        "SAGE_RUNTIME SageValue sage_sem_new(SageValue val) {\n"
         "    sem_t* sem = malloc(sizeof(sem_t));\n"
         "    sem_init(sem, 0, (unsigned int)val.as.number);\n"
         "    SageValue v; v.type = SAGE_TAG_POINTER; v.as.pointer = sem; return v;\n"
         "}\n"
-        "static SageValue sage_sem_wait(SageValue sem) {\n"
+        "SAGE_RUNTIME SageValue sage_sem_wait(SageValue sem) {\n"
         "    if (sem.type != SAGE_TAG_POINTER) return sage_nil();\n"
         "    sem_wait((sem_t*)sem.as.pointer);\n"
         "    return sage_nil();\n"
         "}\n"
-        "static SageValue sage_sem_post(SageValue sem) {\n"
+        "SAGE_RUNTIME SageValue sage_sem_post(SageValue sem) {\n"
         "    if (sem.type != SAGE_TAG_POINTER) return sage_nil();\n"
         "    sem_post((sem_t*)sem.as.pointer);\n"
         "    return sage_nil();\n"
         "}\n"
-        "static SageValue sage_sem_trywait(SageValue sem) {\n"
+        "SAGE_RUNTIME SageValue sage_sem_trywait(SageValue sem) {\n"
         "    if (sem.type != SAGE_TAG_POINTER) return sage_bool(0);\n"
         "    return sage_bool(sem_trywait((sem_t*)sem.as.pointer) == 0);\n"
         "}\n"
-        "static SageSlot sage_slot_undefined(void) { SageSlot slot; "
+        "static inline SageSlot sage_slot_undefined(void) { SageSlot slot; "
         "slot.defined = 0; slot.value = sage_nil(); return slot; }\n"
         "\n",
         out);
 
-  fputs("static SageValue sage_make_dict(void) {\n"
+  fputs("SAGE_RUNTIME SageValue sage_make_dict(void) {\n"
         "    SageDict* dict = (SageDict*)sage_gc_alloc(SAGE_GC_DICT, "
         "sizeof(SageDict));\n"
         "    dict->keys = NULL;\n"
@@ -3748,7 +4038,7 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
         "    return v;\n"
         "}\n"
         "\n"
-        "static void sage_dict_set(SageDict* dict, const char* key, SageValue "
+        "SAGE_RUNTIME void sage_dict_set(SageDict* dict, const char* key, SageValue "
         "value) {\n"
         "    for (int i = 0; i < dict->count; i++) {\n"
         "        if (strcmp(dict->keys[i], key) == 0) {\n"
@@ -3773,7 +4063,7 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
         "\n",
         out);
   fputs(
-      "static SageValue sage_make_dict_from_entries(int count, const char** "
+      "SAGE_RUNTIME SageValue sage_make_dict_from_entries(int count, const char** "
       "keys, const SageValue* values) {\n"
       "    sage_gc_pin();\n"
       "    SageValue dict = sage_make_dict();\n"
@@ -3784,14 +4074,14 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
       "    return dict;\n"
       "}\n"
       "\n"
-      "static SageValue sage_dict_get(SageDict* dict, const char* key) {\n"
+      "SAGE_RUNTIME SageValue sage_dict_get(SageDict* dict, const char* key) {\n"
       "    for (int i = 0; i < dict->count; i++) {\n"
       "        if (strcmp(dict->keys[i], key) == 0) return dict->values[i];\n"
       "    }\n"
       "    return sage_nil();\n"
       "}\n"
       "\n"
-      "static SageValue sage_make_tuple(int count, const SageValue* values) {\n"
+      "SAGE_RUNTIME SageValue sage_make_tuple(int count, const SageValue* values) {\n"
       "    sage_gc_pin();\n"
       "    SageTuple* tuple = (SageTuple*)sage_gc_alloc(SAGE_GC_TUPLE, "
       "sizeof(SageTuple));\n"
@@ -3806,7 +4096,7 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
       "    return v;\n"
       "}\n"
       "\n"
-      "static void sage_raise(SageValue value) {\n"
+      "SAGE_RUNTIME void sage_raise(SageValue value) {\n"
       "    if (sage_try_depth > 0) {\n"
       "        sage_exception_value = value;\n"
       "        longjmp(sage_try_stack[sage_try_depth - 1], 1);\n"
@@ -3818,7 +4108,7 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
       "    exit(1);\n"
       "}\n"
       "\n"
-      "static void sage_array_reserve(SageArray* array, int needed) {\n"
+      "SAGE_RUNTIME void sage_array_reserve(SageArray* array, int needed) {\n"
       "    if (array->capacity >= needed) return;\n"
       "    int capacity = array->capacity == 0 ? 4 : array->capacity;\n"
       "    while (capacity < needed) capacity *= 2;\n"
@@ -3829,12 +4119,12 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
       "    array->capacity = capacity;\n"
       "}\n"
       "\n"
-      "static void sage_array_push_raw(SageArray* array, SageValue value) {\n"
+      "SAGE_RUNTIME void sage_array_push_raw(SageArray* array, SageValue value) {\n"
       "    sage_array_reserve(array, array->count + 1);\n"
       "    array->elements[array->count++] = value;\n"
       "}\n"
       "\n"
-      "static SageValue sage_make_array(int count, const SageValue* values) {\n"
+      "SAGE_RUNTIME SageValue sage_make_array(int count, const SageValue* values) {\n"
       "    sage_gc_pin();\n"
       "    SageValue array = sage_array();\n"
       "    for (int i = 0; i < count; i++) {\n"
@@ -3847,7 +4137,7 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
       out);
 
   fputs(
-      "static int sage_truthy(SageValue value) {\n"
+      "static inline int sage_truthy(SageValue value) {\n"
       "    if (value.type == SAGE_TAG_NIL) return 0;\n"
       "    if (value.type == SAGE_TAG_BOOL) return value.as.boolean;\n"
       "    if (value.type == SAGE_TAG_NUMBER) return value.as.number != 0.0;\n"
@@ -3856,7 +4146,7 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
       "    return 1;\n"
       "}\n"
       "\n"
-      "static SageValue sage_load_slot(const SageSlot* slot, const char* name) "
+      "static inline SageValue sage_load_slot(const SageSlot* slot, const char* name) "
       "{\n"
       "    if (!slot->defined) {\n"
       "        fprintf(stderr, \"Runtime Error: Undefined variable '%s'.\\n\", "
@@ -3866,12 +4156,12 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
       "    return slot->value;\n"
       "}\n"
       "\n"
-      "static void sage_define_slot(SageSlot* slot, SageValue value) {\n"
+      "static inline void sage_define_slot(SageSlot* slot, SageValue value) {\n"
       "    slot->defined = 1;\n"
       "    slot->value = value;\n"
       "}\n"
       "\n"
-      "static SageValue sage_assign_slot(SageSlot* slot, const char* name, "
+      "static inline SageValue sage_assign_slot(SageSlot* slot, const char* name, "
       "SageValue value) {\n"
       "    if (!slot->defined) {\n"
       "        fprintf(stderr, \"Runtime Error: Undefined variable '%s'.\\n\", "
@@ -3882,7 +4172,7 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
       "    return value;\n"
       "}\n"
       "\n"
-      "static int sage_values_equal(SageValue left, SageValue right) {\n"
+      "SAGE_RUNTIME int sage_values_equal(SageValue left, SageValue right) {\n"
       "    if (left.type != right.type) return 0;\n"
       "    switch (left.type) {\n"
       "        case SAGE_TAG_NIL: return 1;\n"
@@ -3919,7 +4209,7 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
       "\n",
       out);
   fputs(
-      "static void sage_print_value(SageValue value) {\n"
+      "SAGE_RUNTIME void sage_print_value(SageValue value) {\n"
       "    switch (value.type) {\n"
       "        case SAGE_TAG_NUMBER: {\n"
       "            double d = value.as.number;\n"
@@ -3961,12 +4251,12 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
       "    }\n"
       "}\n"
       "\n"
-      "static void sage_print_ln(SageValue value) {\n"
+      "SAGE_RUNTIME void sage_print_ln(SageValue value) {\n"
       "    sage_print_value(value);\n"
       "    fputc('\\n', stdout);\n"
       "}\n"
       "\n"
-      "static SageValue sage_str(SageValue value) {\n"
+      "SAGE_RUNTIME SageValue sage_str(SageValue value) {\n"
       "    char buffer[64];\n"
       "    switch (value.type) {\n"
       "        case SAGE_TAG_STRING: return value;\n"
@@ -3993,7 +4283,7 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
       "    return sage_string(\"nil\");\n"
       "}\n"
       "\n"
-      "static SageValue sage_int(SageValue value) {\n"
+      "SAGE_RUNTIME SageValue sage_int(SageValue value) {\n"
       "    if (value.type == SAGE_TAG_NUMBER) return sage_number((double)(long "
       "long)value.as.number);\n"
       "    if (value.type == SAGE_TAG_STRING) return "
@@ -4003,63 +4293,63 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
       "    return sage_number(0);\n"
       "}\n"
       "\n"
-      "static SageValue sage_abs(SageValue value) {\n"
+      "SAGE_RUNTIME SageValue sage_abs(SageValue value) {\n"
       "    if (value.type == SAGE_TAG_NUMBER) return "
       "sage_number(fabs(value.as.number));\n"
       "    return sage_nil();\n"
       "}\n"
-      "static SageValue sage_sqrt(SageValue value) {\n"
+      "SAGE_RUNTIME SageValue sage_sqrt(SageValue value) {\n"
       "    if (value.type == SAGE_TAG_NUMBER) return "
       "sage_number(sqrt(value.as.number));\n"
       "    return sage_nil();\n"
       "}\n"
       "\n"
-      "static SageValue sage_native_random(void) { return sage_number((double)rand() / (double)RAND_MAX); }\n"
-      "static SageValue sage_native_srandom(SageValue seed) { srand((unsigned int)seed.as.number); return sage_nil(); }\n"
-      "static SageValue sage_native_sin(SageValue v) { return sage_number(sin(v.as.number)); }\n"
-      "static SageValue sage_native_cos(SageValue v) { return sage_number(cos(v.as.number)); }\n"
-      "static SageValue sage_native_tan(SageValue v) { return sage_number(tan(v.as.number)); }\n"
-      "static SageValue sage_native_floor(SageValue v) { return sage_number(floor(v.as.number)); }\n"
-      "static SageValue sage_native_ceil(SageValue v) { return sage_number(ceil(v.as.number)); }\n"
-      "static SageValue sage_native_pow(SageValue a, SageValue b) { return sage_number(pow(a.as.number, b.as.number)); }\n"
-      "static SageValue sage_native_exp(SageValue v) { return sage_number(exp(v.as.number)); }\n"
-      "static SageValue sage_native_log(SageValue v) { return sage_number(log(v.as.number)); }\n"
-      "static SageValue sage_native_sqrt(SageValue v) { return sage_number(sqrt(v.as.number)); }\n"
+      "SAGE_RUNTIME SageValue sage_native_random(void) { return sage_number((double)rand() / (double)RAND_MAX); }\n"
+      "SAGE_RUNTIME SageValue sage_native_srandom(SageValue seed) { srand((unsigned int)seed.as.number); return sage_nil(); }\n"
+      "SAGE_RUNTIME SageValue sage_native_sin(SageValue v) { return sage_number(sin(v.as.number)); }\n"
+      "SAGE_RUNTIME SageValue sage_native_cos(SageValue v) { return sage_number(cos(v.as.number)); }\n"
+      "SAGE_RUNTIME SageValue sage_native_tan(SageValue v) { return sage_number(tan(v.as.number)); }\n"
+      "SAGE_RUNTIME SageValue sage_native_floor(SageValue v) { return sage_number(floor(v.as.number)); }\n"
+      "SAGE_RUNTIME SageValue sage_native_ceil(SageValue v) { return sage_number(ceil(v.as.number)); }\n"
+      "SAGE_RUNTIME SageValue sage_native_pow(SageValue a, SageValue b) { return sage_number(pow(a.as.number, b.as.number)); }\n"
+      "SAGE_RUNTIME SageValue sage_native_exp(SageValue v) { return sage_number(exp(v.as.number)); }\n"
+      "SAGE_RUNTIME SageValue sage_native_log(SageValue v) { return sage_number(log(v.as.number)); }\n"
+      "SAGE_RUNTIME SageValue sage_native_sqrt(SageValue v) { return sage_number(sqrt(v.as.number)); }\n"
       "\n",
       out);
-  fputs("static SageValue sage_native_thread_mutex(void) {\n"
+  fputs("SAGE_RUNTIME SageValue sage_native_thread_mutex(void) {\n"
       "    pthread_mutex_t* m = malloc(sizeof(pthread_mutex_t));\n"
       "    pthread_mutex_init(m, NULL);\n"
       "    SageValue v; v.type = SAGE_TAG_MUTEX; v.as.mutex = m; return v;\n"
       "}\n"
-      "static SageValue sage_native_thread_lock(SageValue m) {\n"
+      "SAGE_RUNTIME SageValue sage_native_thread_lock(SageValue m) {\n"
       "    if (m.type == SAGE_TAG_MUTEX) pthread_mutex_lock((pthread_mutex_t*)m.as.mutex);\n"
       "    return sage_nil();\n"
       "}\n"
-      "static SageValue sage_native_thread_unlock(SageValue m) {\n"
+      "SAGE_RUNTIME SageValue sage_native_thread_unlock(SageValue m) {\n"
       "    if (m.type == SAGE_TAG_MUTEX) pthread_mutex_unlock((pthread_mutex_t*)m.as.mutex);\n"
       "    return sage_nil();\n"
       "}\n"
-      "static void* sage_thread_wrapper(void* arg) {\n"
+      "SAGE_RUNTIME void* sage_thread_wrapper(void* arg) {\n"
       "    (void)arg;\n"
       "    return NULL;\n"
       "}\n"
-      "static SageValue sage_native_thread_spawn(SageValue fn, SageValue arg) {\n"
+      "SAGE_RUNTIME SageValue sage_native_thread_spawn(SageValue fn, SageValue arg) {\n"
       "    pthread_t* t = malloc(sizeof(pthread_t));\n"
       "    (void)fn; (void)arg;\n"
       "    pthread_create(t, NULL, sage_thread_wrapper, NULL);\n"
       "    SageValue v; v.type = SAGE_TAG_THREAD; v.as.thread = t; return v;\n"
       "}\n"
-      "static SageValue sage_native_thread_sleep(SageValue ms) {\n"
+      "SAGE_RUNTIME SageValue sage_native_thread_sleep(SageValue ms) {\n"
       "    struct timespec ts;\n"
       "    ts.tv_sec = (time_t)(ms.as.number / 1000);\n"
       "    ts.tv_nsec = (long)((ms.as.number - (double)(ts.tv_sec * 1000)) * 1000000);\n"
       "    nanosleep(&ts, NULL);\n"
       "    return sage_nil();\n"
       "}\n"
-      "static SageValue sage_native_thread_id(void) { return sage_number((double)(uintptr_t)pthread_self()); }\n"
+      "SAGE_RUNTIME SageValue sage_native_thread_id(void) { return sage_number((double)(uintptr_t)pthread_self()); }\n"
       "\n"
-      "static SageValue sage_native_io_readbytes(SageValue path) {\n"
+      "SAGE_RUNTIME SageValue sage_native_io_readbytes(SageValue path) {\n"
       "    if (path.type != SAGE_TAG_STRING) return sage_nil();\n"
       "    FILE* f = fopen(path.as.string, \"rb\");\n"
       "    if (!f) return sage_nil();\n"
@@ -4094,7 +4384,7 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
       "    sage_gc_unpin();\n"
       "    return arr;\n"
       "}\n"
-"static SageValue sage_native_io_writebytes(SageValue path, SageValue v) {\n"
+"SAGE_RUNTIME SageValue sage_native_io_writebytes(SageValue path, SageValue v) {\n"
 "    if (path.type != SAGE_TAG_STRING) return sage_nil();\n"
 "    FILE* f = fopen(path.as.string, \"wb\");\n"
 "    if (!f) return sage_nil();\n"
@@ -4118,7 +4408,7 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
 "    fclose(f);\n"
 "    return sage_bool(1);\n"
 "}\n"
-"static SageValue sage_native_io_appendbytes(SageValue path, SageValue v) {\n"
+"SAGE_RUNTIME SageValue sage_native_io_appendbytes(SageValue path, SageValue v) {\n"
 "    if (path.type != SAGE_TAG_STRING) return sage_nil();\n"
 "    FILE* f = fopen(path.as.string, \"ab\");\n"
 "    if (!f) return sage_nil();\n"
@@ -4142,8 +4432,8 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
 "    fclose(f);\n"
 "    return sage_bool(1);\n"
 "}\n"
-"static SageValue sage_native_io_readfile(SageValue path) { return sage_native_io_readbytes(path); }\n"
-"static SageValue sage_native_io_writefile(SageValue path, SageValue data) {\n"
+"SAGE_RUNTIME SageValue sage_native_io_readfile(SageValue path) { return sage_native_io_readbytes(path); }\n"
+"SAGE_RUNTIME SageValue sage_native_io_writefile(SageValue path, SageValue data) {\n"
 "    if (path.type != SAGE_TAG_STRING || data.type != SAGE_TAG_STRING) return sage_nil();\n"
 "    FILE* f = fopen(path.as.string, \"wb\");\n"
 "    if (!f) return sage_nil();\n"
@@ -4154,21 +4444,21 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
       "\n"
       "extern int sage_argc;\n"
       "extern char** sage_argv;\n"
-      "static SageValue sage_native_sys_args(void) {\n"
+      "SAGE_RUNTIME SageValue sage_native_sys_args(void) {\n"
       "    SageValue arr = sage_array();\n"
       "    for (int i = 0; i < sage_argc; i++) {\n"
       "        sage_array_push_raw(arr.as.array, sage_string(sage_argv[i]));\n"
       "    }\n"
       "    return arr;\n"
       "}\n"
-      "static SageValue sage_native_sys_getenv(SageValue name) {\n"
+      "SAGE_RUNTIME SageValue sage_native_sys_getenv(SageValue name) {\n"
       "    if (name.type != SAGE_TAG_STRING) return sage_nil();\n"
       "    char* val = getenv(name.as.string);\n"
       "    return val ? sage_string(val) : sage_nil();\n"
       "}\n"
-      "static SageValue sage_native_sys_clock(void) { return sage_number((double)clock() / CLOCKS_PER_SEC); }\n"
+      "SAGE_RUNTIME SageValue sage_native_sys_clock(void) { return sage_number((double)clock() / CLOCKS_PER_SEC); }\n"
       "\n"
-      "static SageValue sage_init_native_module(const char* name) {\n"
+      "SAGE_RUNTIME SageValue sage_init_native_module(const char* name) {\n"
       "    /* For now, just return an empty dict; real native modules should be "
       "linked */\n"
       "    return sage_make_dict();\n"
@@ -4177,7 +4467,7 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
       out);
 
   fputs(
-      "static SageValue sage_len(SageValue value) {\n"
+      "SAGE_RUNTIME SageValue sage_len(SageValue value) {\n"
       "    if (value.type == SAGE_TAG_STRING) return "
       "sage_number((double)SAGE_STRING_LEN(value));\n"
       "    if (value.type == SAGE_TAG_ARRAY) return "
@@ -4191,7 +4481,7 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
       "    return sage_nil();\n"
       "}\n"
       "\n"
-      "static SageValue sage_index(SageValue collection, SageValue index) {\n"
+      "SAGE_RUNTIME SageValue sage_index(SageValue collection, SageValue index) {\n"
       "    if (collection.type == SAGE_TAG_ARRAY && index.type == "
       "SAGE_TAG_NUMBER) {\n"
       "        int idx = (int)index.as.number;\n"
@@ -4228,7 +4518,7 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
       "    return sage_nil();\n"
       "}\n"
       "\n"
-      "static SageValue sage_slice(SageValue array, SageValue start, SageValue "
+      "SAGE_RUNTIME SageValue sage_slice(SageValue array, SageValue start, SageValue "
       "end) {\n"
       "    if (array.type != SAGE_TAG_ARRAY && array.type != SAGE_TAG_STRING) return sage_nil();\n"
       "    sage_gc_pin();\n"
@@ -4271,20 +4561,20 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
       "    }\n"
       "}\n"
       "\n"
-      "static SageValue sage_push(SageValue array, SageValue value) {\n"
+      "SAGE_RUNTIME SageValue sage_push(SageValue array, SageValue value) {\n"
       "    if (array.type != SAGE_TAG_ARRAY) return sage_nil();\n"
       "    sage_array_push_raw(array.as.array, value);\n"
       "    return sage_nil();\n"
       "}\n"
       "\n"
-      "static SageValue sage_pop(SageValue array) {\n"
+      "SAGE_RUNTIME SageValue sage_pop(SageValue array) {\n"
       "    if (array.type != SAGE_TAG_ARRAY || array.as.array->count == 0) "
       "return sage_nil();\n"
       "    return array.as.array->elements[--array.as.array->count];\n"
       "}\n"
       "\n",
       out);
-  fputs("static SageValue sage_array_extend(SageValue target, SageValue source) "
+  fputs("SAGE_RUNTIME SageValue sage_array_extend(SageValue target, SageValue source) "
       "{\n"
       "    if (target.type != SAGE_TAG_ARRAY || source.type != SAGE_TAG_ARRAY) "
       "return sage_nil();\n"
@@ -4299,7 +4589,7 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
       "    return sage_nil();\n"
       "}\n"
       "\n"
-      "static SageValue sage_array_reverse(SageValue array) {\n"
+      "SAGE_RUNTIME SageValue sage_array_reverse(SageValue array) {\n"
       "    if (array.type != SAGE_TAG_ARRAY) return sage_nil();\n"
       "    SageArray* src = array.as.array;\n"
       "    sage_gc_pin();\n"
@@ -4319,7 +4609,7 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
       out);
 
   fputs(
-      "static SageValue sage_range2(SageValue start, SageValue end) {\n"
+      "SAGE_RUNTIME SageValue sage_range2(SageValue start, SageValue end) {\n"
       "    if (start.type != SAGE_TAG_NUMBER || end.type != SAGE_TAG_NUMBER) "
       "return sage_nil();\n"
       "    sage_gc_pin();\n"
@@ -4330,7 +4620,7 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
       "    sage_gc_unpin();\n"
       "    return result;\n"
       "}\n"
-      "static SageValue sage_range3(SageValue start, SageValue end, SageValue step) {\n"
+      "SAGE_RUNTIME SageValue sage_range3(SageValue start, SageValue end, SageValue step) {\n"
       "    if (start.type != SAGE_TAG_NUMBER || end.type != SAGE_TAG_NUMBER || step.type != SAGE_TAG_NUMBER) "
       "return sage_nil();\n"
       "    int s = (int)start.as.number, e = (int)end.as.number, st = (int)step.as.number;\n"
@@ -4350,20 +4640,20 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
       "    return result;\n"
       "}\n"
       "\n"
-      "static SageValue sage_range1(SageValue end) {\n"
+      "SAGE_RUNTIME SageValue sage_range1(SageValue end) {\n"
       "    return sage_range2(sage_number(0), end);\n"
       "}\n"
       "\n"
-      "static SageValue sage_add(SageValue left, SageValue right);\n"
-      "static SageValue sage_sub(SageValue left, SageValue right);\n"
-      "static SageValue sage_mul(SageValue left, SageValue right);\n"
-      "static SageValue sage_div(SageValue left, SageValue right);\n"
-      "static SageValue sage_eq(SageValue left, SageValue right);\n"
-      "static SageValue sage_neq(SageValue left, SageValue right);\n"
-      "static SageValue sage_gt(SageValue left, SageValue right);\n"
-      "static SageValue sage_lt(SageValue left, SageValue right);\n"
-      "static SageValue sage_gte(SageValue left, SageValue right);\n"
-      "static SageValue sage_lte(SageValue left, SageValue right);\n"
+      "SAGE_RUNTIME SageValue sage_add(SageValue left, SageValue right);\n"
+      "SAGE_RUNTIME SageValue sage_sub(SageValue left, SageValue right);\n"
+      "SAGE_RUNTIME SageValue sage_mul(SageValue left, SageValue right);\n"
+      "SAGE_RUNTIME SageValue sage_div(SageValue left, SageValue right);\n"
+      "SAGE_RUNTIME SageValue sage_eq(SageValue left, SageValue right);\n"
+      "SAGE_RUNTIME SageValue sage_neq(SageValue left, SageValue right);\n"
+      "SAGE_RUNTIME SageValue sage_gt(SageValue left, SageValue right);\n"
+      "SAGE_RUNTIME SageValue sage_lt(SageValue left, SageValue right);\n"
+      "SAGE_RUNTIME SageValue sage_gte(SageValue left, SageValue right);\n"
+      "SAGE_RUNTIME SageValue sage_lte(SageValue left, SageValue right);\n"
       "\n"
       "static inline SageValue SAGE_ADD(SageValue a, SageValue b) {\n"
       "    if (a.type == SAGE_TAG_NUMBER && b.type == SAGE_TAG_NUMBER) return sage_number(a.as.number + b.as.number);\n"
@@ -4406,7 +4696,7 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
       "    return sage_lte(a, b);\n"
       "}\n"
       "\n"
-      "static SageValue sage_add(SageValue left, SageValue right) {\n"
+      "SAGE_RUNTIME SageValue sage_add(SageValue left, SageValue right) {\n"
       "    if (left.type == SAGE_TAG_NUMBER && right.type == SAGE_TAG_NUMBER) {\n"
       "        return sage_number(left.as.number + right.as.number);\n"
       "    }\n"
@@ -4437,59 +4727,59 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
       out);
 
   fputs(
-      "static SageValue sage_sub(SageValue left, SageValue right) {\n"
+      "SAGE_RUNTIME SageValue sage_sub(SageValue left, SageValue right) {\n"
       "    if (left.type != SAGE_TAG_NUMBER || right.type != SAGE_TAG_NUMBER) "
       "sage_fail(\"Runtime Error: Operands must be numbers.\");\n"
       "    return sage_number(left.as.number - right.as.number);\n"
       "}\n"
-      "static SageValue sage_mul(SageValue left, SageValue right) {\n"
+      "SAGE_RUNTIME SageValue sage_mul(SageValue left, SageValue right) {\n"
       "    if (left.type != SAGE_TAG_NUMBER || right.type != SAGE_TAG_NUMBER) "
       "sage_fail(\"Runtime Error: Operands must be numbers.\");\n"
       "    return sage_number(left.as.number * right.as.number);\n"
       "}\n"
-      "static SageValue sage_div(SageValue left, SageValue right) {\n"
+      "SAGE_RUNTIME SageValue sage_div(SageValue left, SageValue right) {\n"
       "    if (left.type != SAGE_TAG_NUMBER || right.type != SAGE_TAG_NUMBER) "
       "sage_fail(\"Runtime Error: Operands must be numbers.\");\n"
       "    if (right.as.number == 0) return sage_nil();\n"
       "    return sage_number(left.as.number / right.as.number);\n"
       "}\n"
-      "static SageValue sage_mod(SageValue left, SageValue right) {\n"
+      "SAGE_RUNTIME SageValue sage_mod(SageValue left, SageValue right) {\n"
       "    if (left.type != SAGE_TAG_NUMBER || right.type != SAGE_TAG_NUMBER) "
       "sage_fail(\"Runtime Error: Operands must be numbers.\");\n"
       "    if (right.as.number == 0) return sage_nil();\n"
       "    return sage_number(fmod(left.as.number, right.as.number));\n"
       "}\n"
-      "static SageValue sage_eq(SageValue left, SageValue right) { return "
+      "SAGE_RUNTIME SageValue sage_eq(SageValue left, SageValue right) { return "
       "sage_bool(sage_values_equal(left, right)); }\n"
-      "static SageValue sage_neq(SageValue left, SageValue right) { return "
+      "SAGE_RUNTIME SageValue sage_neq(SageValue left, SageValue right) { return "
       "sage_bool(!sage_values_equal(left, right)); }\n"
-      "static SageValue sage_gt(SageValue left, SageValue right) {\n"
+      "SAGE_RUNTIME SageValue sage_gt(SageValue left, SageValue right) {\n"
       "    if (left.type != SAGE_TAG_NUMBER || right.type != SAGE_TAG_NUMBER) "
       "sage_fail(\"Runtime Error: Operands must be numbers.\");\n"
       "    return sage_bool(left.as.number > right.as.number);\n"
       "}\n"
-      "static SageValue sage_lt(SageValue left, SageValue right) {\n"
+      "SAGE_RUNTIME SageValue sage_lt(SageValue left, SageValue right) {\n"
       "    if (left.type != SAGE_TAG_NUMBER || right.type != SAGE_TAG_NUMBER) "
       "sage_fail(\"Runtime Error: Operands must be numbers.\");\n"
       "    return sage_bool(left.as.number < right.as.number);\n"
       "}\n"
-      "static SageValue sage_gte(SageValue left, SageValue right) {\n"
+      "SAGE_RUNTIME SageValue sage_gte(SageValue left, SageValue right) {\n"
       "    if (left.type != SAGE_TAG_NUMBER || right.type != SAGE_TAG_NUMBER) "
       "sage_fail(\"Runtime Error: Operands must be numbers.\");\n"
       "    return sage_bool(left.as.number >= right.as.number);\n"
       "}\n"
-      "static SageValue sage_lte(SageValue left, SageValue right) {\n"
+      "SAGE_RUNTIME SageValue sage_lte(SageValue left, SageValue right) {\n"
       "    if (left.type != SAGE_TAG_NUMBER || right.type != SAGE_TAG_NUMBER) "
       "sage_fail(\"Runtime Error: Operands must be numbers.\");\n"
       "    return sage_bool(left.as.number <= right.as.number);\n"
       "}\n"
-      "static SageValue sage_not(SageValue value) { return "
+      "SAGE_RUNTIME SageValue sage_not(SageValue value) { return "
       "sage_bool(!sage_truthy(value)); }\n"
-      "static SageValue sage_and(SageValue left, SageValue right) { return "
+      "SAGE_RUNTIME SageValue sage_and(SageValue left, SageValue right) { return "
       "sage_bool(sage_truthy(left) && sage_truthy(right)); }\n"
-      "static SageValue sage_or(SageValue left, SageValue right) { return "
+      "SAGE_RUNTIME SageValue sage_or(SageValue left, SageValue right) { return "
       "sage_bool(sage_truthy(left) || sage_truthy(right)); }\n"
-      "static SageValue sage_bit_not(SageValue value) {\n"
+      "SAGE_RUNTIME SageValue sage_bit_not(SageValue value) {\n"
       "    if (value.type != SAGE_TAG_NUMBER) sage_fail(\"Runtime Error: "
       "Bitwise NOT operand must be a number.\");\n"
       "    return sage_number((double)(~(long long)value.as.number));\n"
@@ -4497,38 +4787,38 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
       out);
 
   fputs(
-      "static SageValue sage_bit_and(SageValue left, SageValue right) {\n"
+      "SAGE_RUNTIME SageValue sage_bit_and(SageValue left, SageValue right) {\n"
       "    if (left.type != SAGE_TAG_NUMBER || right.type != SAGE_TAG_NUMBER) "
       "sage_fail(\"Runtime Error: Operands must be numbers.\");\n"
       "    return sage_number((double)(((long long)left.as.number) & ((long "
       "long)right.as.number)));\n"
       "}\n"
-      "static SageValue sage_bit_or(SageValue left, SageValue right) {\n"
+      "SAGE_RUNTIME SageValue sage_bit_or(SageValue left, SageValue right) {\n"
       "    if (left.type != SAGE_TAG_NUMBER || right.type != SAGE_TAG_NUMBER) "
       "sage_fail(\"Runtime Error: Operands must be numbers.\");\n"
       "    return sage_number((double)(((long long)left.as.number) | ((long "
       "long)right.as.number)));\n"
       "}\n"
-      "static SageValue sage_bit_xor(SageValue left, SageValue right) {\n"
+      "SAGE_RUNTIME SageValue sage_bit_xor(SageValue left, SageValue right) {\n"
       "    if (left.type != SAGE_TAG_NUMBER || right.type != SAGE_TAG_NUMBER) "
       "sage_fail(\"Runtime Error: Operands must be numbers.\");\n"
       "    return sage_number((double)(((long long)left.as.number) ^ ((long "
       "long)right.as.number)));\n"
       "}\n"
-      "static SageValue sage_lshift(SageValue left, SageValue right) {\n"
+      "SAGE_RUNTIME SageValue sage_lshift(SageValue left, SageValue right) {\n"
       "    if (left.type != SAGE_TAG_NUMBER || right.type != SAGE_TAG_NUMBER) "
       "sage_fail(\"Runtime Error: Operands must be numbers.\");\n"
       "    return sage_number((double)(((unsigned long long)left.as.number) << ((long "
       "long)right.as.number)));\n"
       "}\n"
-      "static SageValue sage_rshift(SageValue left, SageValue right) {\n"
+      "SAGE_RUNTIME SageValue sage_rshift(SageValue left, SageValue right) {\n"
       "    if (left.type != SAGE_TAG_NUMBER || right.type != SAGE_TAG_NUMBER) "
       "sage_fail(\"Runtime Error: Operands must be numbers.\");\n"
       "    return sage_number((double)(((unsigned long long)left.as.number) >> ((long "
       "long)right.as.number)));\n"
       "}\n"
       "\n"
-      "static SageValue sage_tonumber(SageValue value) {\n"
+      "SAGE_RUNTIME SageValue sage_tonumber(SageValue value) {\n"
       "    if (value.type == SAGE_TAG_NUMBER) return value;\n"
       "    if (value.type == SAGE_TAG_STRING) {\n"
       "        char* end;\n"
@@ -4539,7 +4829,7 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
       "    return sage_nil();\n"
       "}\n"
       "\n"
-      "static SageValue sage_dict_keys_fn(SageValue dict_val) {\n"
+      "SAGE_RUNTIME SageValue sage_dict_keys_fn(SageValue dict_val) {\n"
       "    if (dict_val.type != SAGE_TAG_DICT) return sage_array();\n"
       "    sage_gc_pin();\n"
       "    SageValue result = sage_array();\n"
@@ -4551,7 +4841,7 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
       "    return result;\n"
       "}\n"
       "\n"
-      "static SageValue sage_dict_values_fn(SageValue dict_val) {\n"
+      "SAGE_RUNTIME SageValue sage_dict_values_fn(SageValue dict_val) {\n"
       "    if (dict_val.type != SAGE_TAG_DICT) return sage_array();\n"
       "    sage_gc_pin();\n"
       "    SageValue result = sage_array();\n"
@@ -4563,7 +4853,7 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
       "    return result;\n"
       "}\n"
       "\n"
-      "static SageValue sage_dict_has_fn(SageValue dict_val, SageValue key) {\n"
+      "SAGE_RUNTIME SageValue sage_dict_has_fn(SageValue dict_val, SageValue key) {\n"
       "    if (dict_val.type != SAGE_TAG_DICT || key.type != SAGE_TAG_STRING) "
       "return sage_bool(0);\n"
       "    for (int i = 0; i < dict_val.as.dict->count; i++) {\n"
@@ -4573,7 +4863,7 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
       "    return sage_bool(0);\n"
       "}\n"
       "\n"
-      "static SageValue sage_dict_delete_fn(SageValue dict_val, SageValue key) "
+      "SAGE_RUNTIME SageValue sage_dict_delete_fn(SageValue dict_val, SageValue key) "
       "{\n"
       "    if (dict_val.type != SAGE_TAG_DICT || key.type != SAGE_TAG_STRING) "
       "return sage_nil();\n"
@@ -4596,19 +4886,19 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
 
   // chr, ord, type builtins
   fputs(
-      "static SageValue sage_chr(SageValue v) {\n"
+      "SAGE_RUNTIME SageValue sage_chr(SageValue v) {\n"
       "    if (v.type != SAGE_TAG_NUMBER) return sage_nil();\n"
       "    char buf[2] = { (char)(int)v.as.number, 0 };\n"
       "    return sage_string(buf);\n"
       "}\n"
       "\n"
-      "static SageValue sage_ord(SageValue v) {\n"
+      "SAGE_RUNTIME SageValue sage_ord(SageValue v) {\n"
       "    if (v.type != SAGE_TAG_STRING || v.as.string == NULL || "
       "v.as.string[0] == 0) return sage_nil();\n"
       "    return sage_number((double)(unsigned char)v.as.string[0]);\n"
       "}\n"
       "\n"
-      "static SageValue sage_type(SageValue v) {\n"
+      "SAGE_RUNTIME SageValue sage_type(SageValue v) {\n"
       "    switch (v.type) {\n"
       "        case SAGE_TAG_NIL: return sage_string(\"nil\");\n"
       "        case SAGE_TAG_NUMBER: return sage_string(\"number\");\n"
@@ -4620,14 +4910,14 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
       "    }\n"
       "}\n"
       "\n"
-      "static SageValue sage_startswith(SageValue s, SageValue prefix) {\n"
+      "SAGE_RUNTIME SageValue sage_startswith(SageValue s, SageValue prefix) {\n"
       "    if (s.type != SAGE_TAG_STRING || prefix.type != SAGE_TAG_STRING) "
       "return sage_bool(0);\n"
       "    return sage_bool(strncmp(s.as.string, prefix.as.string, "
       "SAGE_STRING_LEN(prefix)) == 0);\n"
       "}\n"
       "\n"
-      "static SageValue sage_endswith(SageValue s, SageValue suffix) {\n"
+      "SAGE_RUNTIME SageValue sage_endswith(SageValue s, SageValue suffix) {\n"
       "    if (s.type != SAGE_TAG_STRING || suffix.type != SAGE_TAG_STRING) "
       "return sage_bool(0);\n"
       "    size_t slen = SAGE_STRING_LEN(s), suflen = "
@@ -4637,14 +4927,14 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
       "suffix.as.string) == 0);\n"
       "}\n"
       "\n"
-      "static SageValue sage_contains(SageValue haystack, SageValue needle) {\n"
+      "SAGE_RUNTIME SageValue sage_contains(SageValue haystack, SageValue needle) {\n"
       "    if (haystack.type != SAGE_TAG_STRING || needle.type != "
       "SAGE_TAG_STRING) return sage_bool(0);\n"
       "    return sage_bool(strstr(haystack.as.string, needle.as.string) != "
       "NULL);\n"
       "}\n"
       "\n"
-      "static SageValue sage_indexof(SageValue haystack, SageValue needle) {\n"
+      "SAGE_RUNTIME SageValue sage_indexof(SageValue haystack, SageValue needle) {\n"
       "    if (haystack.type != SAGE_TAG_STRING || needle.type != "
       "SAGE_TAG_STRING) return sage_nil();\n"
       "    char* found = strstr(haystack.as.string, needle.as.string);\n"
@@ -4652,7 +4942,7 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
       "    return sage_number((double)(found - haystack.as.string));\n"
       "}\n"
       "\n"
-      "static SageValue sage_string_count(SageValue haystack, SageValue needle) {\n"
+      "SAGE_RUNTIME SageValue sage_string_count(SageValue haystack, SageValue needle) {\n"
       "    if (haystack.type != SAGE_TAG_STRING || needle.type != "
       "SAGE_TAG_STRING) return sage_nil();\n"
       "    if (SAGE_STRING_LEN(needle) == 0) return sage_number(0);\n"
@@ -4665,7 +4955,7 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
       "    return sage_number((double)count);\n"
       "}\n"
       "\n"
-      "static SageValue sage_string_repeat(SageValue s, SageValue count) {\n"
+      "SAGE_RUNTIME SageValue sage_string_repeat(SageValue s, SageValue count) {\n"
       "    if (s.type != SAGE_TAG_STRING || count.type != SAGE_TAG_NUMBER) "
       "return sage_nil();\n"
       "    int n = (int)count.as.number;\n"
@@ -4682,7 +4972,7 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
       out);
 
   // Index set for arrays and dicts (sage_index already defined above)
-  fputs("static void sage_index_set(SageValue c, SageValue k, SageValue v) {\n"
+  fputs("SAGE_RUNTIME void sage_index_set(SageValue c, SageValue k, SageValue v) {\n"
         "    if (c.type == SAGE_TAG_ARRAY && k.type == SAGE_TAG_NUMBER) {\n"
         "        int i = (int)k.as.number;\n"
         "        if (i >= 0 && i < c.as.array->count) c.as.array->elements[i] "
@@ -4710,22 +5000,22 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
         "\n",
         out);
 
-  fputs("static SageValue sage_gc_collect_fn(void) {\n"
+  fputs("SAGE_RUNTIME SageValue sage_gc_collect_fn(void) {\n"
         "    sage_gc_collect();\n"
         "    return sage_nil();\n"
         "}\n"
         "\n"
-        "static SageValue sage_gc_enable_fn(void) {\n"
+        "SAGE_RUNTIME SageValue sage_gc_enable_fn(void) {\n"
         "    sage_gc.enabled = 1;\n"
         "    return sage_nil();\n"
         "}\n"
         "\n"
-        "static SageValue sage_gc_disable_fn(void) {\n"
+        "SAGE_RUNTIME SageValue sage_gc_disable_fn(void) {\n"
         "    sage_gc.enabled = 0;\n"
         "    return sage_nil();\n"
         "}\n"
         "\n"
-        "static SageValue sage_gc_stats_fn(void) {\n"
+        "SAGE_RUNTIME SageValue sage_gc_stats_fn(void) {\n"
         "    int next_gc = sage_gc.next_gc_objects - sage_gc.object_count;\n"
         "    if (next_gc < 0) next_gc = 0;\n"
         "    return sage_make_dict_from_entries(7,\n"
@@ -4745,7 +5035,7 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
         "\n",
         out);
 
-  fputs("static SageValue sage_gc_collections_fn(void) {\n"
+  fputs("SAGE_RUNTIME SageValue sage_gc_collections_fn(void) {\n"
         "    return sage_number((double)sage_gc.collections);\n"
         "}\n"
         "\n",
@@ -4753,7 +5043,7 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
 
   /* String builtins */
   fputs("#include <ctype.h>\n"
-        "static SageValue sage_upper(SageValue value) {\n"
+        "SAGE_RUNTIME SageValue sage_upper(SageValue value) {\n"
         "    if (value.type != SAGE_TAG_STRING) return sage_nil();\n"
         "    size_t len = strlen(value.as.string);\n"
         "    char* result = (char*)malloc(len + 1);\n"
@@ -4763,7 +5053,7 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
         "    result[len] = '\\0';\n"
         "    return sage_string_take(result);\n"
         "}\n"
-        "static SageValue sage_lower(SageValue value) {\n"
+        "SAGE_RUNTIME SageValue sage_lower(SageValue value) {\n"
         "    if (value.type != SAGE_TAG_STRING) return sage_nil();\n"
         "    size_t len = strlen(value.as.string);\n"
         "    char* result = (char*)malloc(len + 1);\n"
@@ -4773,7 +5063,7 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
         "    result[len] = '\\0';\n"
         "    return sage_string_take(result);\n"
         "}\n"
-        "static SageValue sage_strip_fn(SageValue value) {\n"
+        "SAGE_RUNTIME SageValue sage_strip_fn(SageValue value) {\n"
         "    if (value.type != SAGE_TAG_STRING) return sage_nil();\n"
         "    const char* s = value.as.string;\n"
         "    while (*s && isspace((unsigned char)*s)) s++;\n"
@@ -4790,7 +5080,7 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
         out);
 
   fputs(
-      "static SageValue sage_split_fn(SageValue str_val, SageValue delim_val) "
+      "SAGE_RUNTIME SageValue sage_split_fn(SageValue str_val, SageValue delim_val) "
       "{\n"
       "    if (str_val.type != SAGE_TAG_STRING || delim_val.type != "
       "SAGE_TAG_STRING) return sage_array();\n"
@@ -4823,7 +5113,7 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
       "    return result;\n"
       "}\n"
       "\n"
-      "static SageValue sage_join_fn(SageValue arr_val, SageValue delim_val) "
+      "SAGE_RUNTIME SageValue sage_join_fn(SageValue arr_val, SageValue delim_val) "
       "{\n"
       "    if (arr_val.type != SAGE_TAG_ARRAY || delim_val.type != "
       "SAGE_TAG_STRING) return sage_nil();\n"
@@ -4854,7 +5144,7 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
       "\n",
       out);
 
-  fputs("static SageValue sage_replace_fn(SageValue str_val, SageValue "
+  fputs("SAGE_RUNTIME SageValue sage_replace_fn(SageValue str_val, SageValue "
         "old_val, SageValue new_val) {\n"
         "    if (str_val.type != SAGE_TAG_STRING || old_val.type != "
         "SAGE_TAG_STRING || new_val.type != SAGE_TAG_STRING)\n"
@@ -4897,7 +5187,7 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
         "    int owned;\n"
         "} SagePointer;\n"
         "\n"
-        "static SageValue sage_mem_alloc(SageValue size_val) {\n"
+        "SAGE_RUNTIME SageValue sage_mem_alloc(SageValue size_val) {\n"
         "    if (size_val.type != SAGE_TAG_NUMBER) { fputs(\"mem_alloc(): "
         "expects number\\n\", stderr); return sage_nil(); }\n"
         "    size_t size = (size_t)size_val.as.number;\n"
@@ -4915,12 +5205,12 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
         "    return v;\n"
         "}\n"
         "\n"
-        "static SagePointer* sage_as_pointer(SageValue v) {\n"
+        "SAGE_RUNTIME SagePointer* sage_as_pointer(SageValue v) {\n"
         "    if (v.type != SAGE_TAG_NUMBER) return NULL;\n"
         "    return (SagePointer*)(uintptr_t)v.as.number;\n"
         "}\n"
         "\n"
-        "static SageValue sage_mem_free(SageValue ptr_val) {\n"
+        "SAGE_RUNTIME SageValue sage_mem_free(SageValue ptr_val) {\n"
         "    SagePointer* sp = sage_as_pointer(ptr_val);\n"
         "    if (sp == NULL) { fputs(\"mem_free(): expects pointer\\n\", "
         "stderr); return sage_nil(); }\n"
@@ -4933,7 +5223,7 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
         out);
 
   fputs(
-      "static SageValue sage_mem_read(SageValue ptr_val, SageValue off_val, "
+      "SAGE_RUNTIME SageValue sage_mem_read(SageValue ptr_val, SageValue off_val, "
       "SageValue type_val) {\n"
       "    SagePointer* sp = sage_as_pointer(ptr_val);\n"
       "    if (sp == NULL || sp->ptr == NULL || off_val.type != "
@@ -4953,7 +5243,7 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
       "    return sage_nil();\n"
       "}\n"
       "\n"
-      "static SageValue sage_mem_write(SageValue ptr_val, SageValue off_val, "
+      "SAGE_RUNTIME SageValue sage_mem_write(SageValue ptr_val, SageValue off_val, "
       "SageValue type_val, SageValue val) {\n"
       "    SagePointer* sp = sage_as_pointer(ptr_val);\n"
       "    if (sp == NULL || sp->ptr == NULL || off_val.type != "
@@ -4972,19 +5262,19 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
       "    return sage_nil();\n"
       "}\n"
       "\n"
-      "static SageValue sage_mem_size(SageValue ptr_val) {\n"
+      "SAGE_RUNTIME SageValue sage_mem_size(SageValue ptr_val) {\n"
       "    SagePointer* sp = sage_as_pointer(ptr_val);\n"
       "    if (sp == NULL) return sage_nil();\n"
       "    return sage_number((double)sp->size);\n"
       "}\n"
       "\n"
-      "static SageValue sage_ptr_to_int(SageValue ptr_val) {\n"
+      "SAGE_RUNTIME SageValue sage_ptr_to_int(SageValue ptr_val) {\n"
       "    if (ptr_val.type != SAGE_TAG_POINTER) return sage_nil();\n"
       "    SagePointer* sp = sage_as_pointer(ptr_val);\n"
       "    if (sp == NULL) return sage_nil();\n"
       "    return sage_number((double)(uintptr_t)sp->ptr);\n"
       "}\n"
-      "static SageValue sage_ffi_sym(SageValue handle, SageValue name) {\n"
+      "SAGE_RUNTIME SageValue sage_ffi_sym(SageValue handle, SageValue name) {\n"
       "    if (handle.type != SAGE_TAG_CLIB || name.type != SAGE_TAG_STRING)\n"
       "        return sage_bool(0);\n"
       "    void* lib = handle.as.clib;\n"
@@ -4992,7 +5282,7 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
       "    void* sym = dlsym(lib, name.as.string);\n"
       "    return sage_bool(sym != NULL);\n"
       "}\n"
-      "static SageValue sage_ffi_sym_addr(SageValue handle, SageValue name) {\n"
+      "SAGE_RUNTIME SageValue sage_ffi_sym_addr(SageValue handle, SageValue name) {\n"
       "    if (handle.type != SAGE_TAG_CLIB || name.type != SAGE_TAG_STRING)\n"
       "        return sage_nil();\n"
       "    void* lib = handle.as.clib;\n"
@@ -5001,10 +5291,10 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
       "    if (!sym) return sage_nil();\n"
       "    return sage_number((double)(uintptr_t)sym);\n"
       "}\n"
-      "static SageValue sage_addressof(SageValue val) {\n"
+      "SAGE_RUNTIME SageValue sage_addressof(SageValue val) {\n"
       "    return sage_number((double)(uintptr_t)&val);\n"
       "}\n"
-      "static SageValue sage_ptr_add(SageValue ptr_val, SageValue offset) {\n"
+      "SAGE_RUNTIME SageValue sage_ptr_add(SageValue ptr_val, SageValue offset) {\n"
       "    if (ptr_val.type != SAGE_TAG_POINTER || offset.type != SAGE_TAG_NUMBER)\n"
       "        return sage_nil();\n"
       "    SagePointer* sp = sage_as_pointer(ptr_val);\n"
@@ -5014,7 +5304,7 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
       "    sp->ptr = (void*)((uintptr_t)sp->ptr + (intptr_t)offset.as.number);\n"
       "    return v;\n"
       "}\n"
-      "static SageValue sage_sizeof(SageValue type_name) {\n"
+      "SAGE_RUNTIME SageValue sage_sizeof(SageValue type_name) {\n"
       "    if (type_name.type != SAGE_TAG_STRING) return sage_nil();\n"
       "    const char* tn = type_name.as.string;\n"
       "    if (strcmp(tn,\"char\")==0||strcmp(tn,\"byte\")==0) return sage_number(1);\n"
@@ -5030,7 +5320,7 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
       out);
 
   /* Struct builtins */
-  fputs("static int sage_struct_type_info(const char* type, size_t* out_size, "
+  fputs("SAGE_RUNTIME int sage_struct_type_info(const char* type, size_t* out_size, "
         "size_t* out_align) {\n"
         "    if (strcmp(type,\"char\")==0||strcmp(type,\"byte\")==0) { "
         "*out_size=1; *out_align=1; return 0; }\n"
@@ -5049,7 +5339,7 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
         "    return -1;\n"
         "}\n"
         "\n"
-        "static SageValue sage_struct_def(SageValue fields) {\n"
+        "SAGE_RUNTIME SageValue sage_struct_def(SageValue fields) {\n"
         "    if (fields.type != SAGE_TAG_ARRAY) return sage_nil();\n"
         "    sage_gc_pin();\n"
         "    SageValue def = sage_make_dict();\n"
@@ -5088,7 +5378,7 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
         "    return def;\n"
         "}\n"
         "\n"
-        "static SageValue sage_struct_new(SageValue def) {\n"
+        "SAGE_RUNTIME SageValue sage_struct_new(SageValue def) {\n"
         "    if (def.type != SAGE_TAG_DICT) return sage_nil();\n"
         "    SageValue size_val = sage_dict_get(def.as.dict, \"__size__\");\n"
         "    if (size_val.type != SAGE_TAG_NUMBER) return sage_nil();\n"
@@ -5108,7 +5398,7 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
         out);
 
   fputs(
-      "static SageValue sage_struct_get(SageValue ptr_val, SageValue def, "
+      "SAGE_RUNTIME SageValue sage_struct_get(SageValue ptr_val, SageValue def, "
       "SageValue field_name) {\n"
       "    SagePointer* sp = sage_as_pointer(ptr_val);\n"
       "    if (sp == NULL || sp->ptr == NULL || def.type != SAGE_TAG_DICT || "
@@ -5135,7 +5425,7 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
       "    return sage_nil();\n"
       "}\n"
       "\n"
-      "static SageValue sage_struct_set(SageValue ptr_val, SageValue def, "
+      "SAGE_RUNTIME SageValue sage_struct_set(SageValue ptr_val, SageValue def, "
       "SageValue field_name, SageValue val) {\n"
       "    SagePointer* sp = sage_as_pointer(ptr_val);\n"
       "    if (sp == NULL || sp->ptr == NULL || def.type != SAGE_TAG_DICT || "
@@ -5163,7 +5453,7 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
       "    return sage_nil();\n"
       "}\n"
       "\n"
-      "static SageValue sage_struct_size(SageValue def) {\n"
+      "SAGE_RUNTIME SageValue sage_struct_size(SageValue def) {\n"
       "    if (def.type != SAGE_TAG_DICT) return sage_nil();\n"
       "    return sage_dict_get(def.as.dict, \"__size__\");\n"
       "}\n"
@@ -5177,13 +5467,17 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
         "typedef struct { const char* name; const char* parent; } "
         "SageClassEntry;\n"
         "#define SAGE_MAX_METHODS 256\n"
-        "#define SAGE_MAX_CLASSES 64\n"
-        "static SageMethodEntry sage_method_table[SAGE_MAX_METHODS];\n"
-        "static int sage_method_count = 0;\n"
-        "static SageClassEntry sage_class_registry[SAGE_MAX_CLASSES];\n"
-        "static int sage_class_count = 0;\n"
-        "\n"
-        "static void sage_register_class(const char* name, const char* parent) "
+        "#define SAGE_MAX_CLASSES 64\n",
+        out);
+  emit_runtime_state(out, state,
+                     "SageMethodEntry sage_method_table[SAGE_MAX_METHODS]", NULL);
+  emit_runtime_state(out, state, "int sage_method_count", "0");
+  emit_runtime_state(out, state,
+                     "SageClassEntry sage_class_registry[SAGE_MAX_CLASSES]",
+                     NULL);
+  emit_runtime_state(out, state, "int sage_class_count", "0");
+  fputs("\n"
+        "SAGE_RUNTIME void sage_register_class(const char* name, const char* parent) "
         "{\n"
         "    if (sage_class_count >= SAGE_MAX_CLASSES) sage_fail(\"too many "
         "classes\");\n"
@@ -5192,7 +5486,7 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
         "    sage_class_count++;\n"
         "}\n"
         "\n"
-        "static void sage_register_method(const char* cls, const char* name, "
+        "SAGE_RUNTIME void sage_register_method(const char* cls, const char* name, "
         "SageMethodFn fn) {\n"
         "    if (sage_method_count >= SAGE_MAX_METHODS) sage_fail(\"too many "
         "methods\");\n"
@@ -5204,17 +5498,24 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
         "\n",
         out);
 
-  fputs("static SageValue sage_call_method(SageValue obj, const char* method, "
+  fputs("static inline int sage_has_class(SageValue obj, const char* cls) {\n"
+        "    if (obj.type != SAGE_TAG_DICT) return 0;\n"
+        "    SageValue class_val = sage_dict_get(obj.as.dict, \"__class__\");\n"
+        "    return class_val.type == SAGE_TAG_STRING && "
+        "strcmp(class_val.as.string, cls) == 0;\n"
+        "}\n"
+        "\n"
+        "SAGE_RUNTIME SageValue sage_call_method(SageValue obj, const char* method, "
         "int argc, SageValue* argv) {\n"
         "    if (obj.type != SAGE_TAG_DICT) {\n"
         "        fprintf(stderr, \"Runtime Error: method call on "
-        "non-instance (type=%d).\\n\", obj.type);\n"
+        "non-instance (type=%d).\\n\", (int)obj.type);\n"
         "        exit(1);\n"
         "    }\n"
         "    SageValue class_val = sage_dict_get(obj.as.dict, \"__class__\");\n"
         "    if (class_val.type != SAGE_TAG_STRING) {\n"
         "        fprintf(stderr, \"Runtime Error: no __class__ on "
-        "instance (method=%s class_val_type=%d).\\n\", method, class_val.type);\n"
+        "instance (method=%s class_val_type=%d).\\n\", method, (int)class_val.type);\n"
         "        exit(1);\n"
         "    }\n"
         "    const char* current = class_val.as.string;\n"
@@ -5242,7 +5543,7 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
         "    return sage_nil();\n"
         "}\n"
         "\n"
-        "static SageValue sage_construct(const char* class_name, const char* "
+        "SAGE_RUNTIME SageValue sage_construct(const char* class_name, const char* "
         "parent_name, int argc, SageValue* argv) {\n"
         "    sage_gc_pin();\n"
         "    SageValue inst = sage_make_dict();\n"
@@ -5277,7 +5578,7 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
         out);
 
   /* Architecture detection */
-  fputs("static SageValue sage_arch_fn(void) {\n"
+  fputs("SAGE_RUNTIME SageValue sage_arch_fn(void) {\n"
         "#if defined(__x86_64__) || defined(_M_X64)\n"
         "    return sage_string(\"x86_64\");\n"
         "#elif defined(__aarch64__) || defined(_M_ARM64)\n"
@@ -5295,10 +5596,10 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
   if (target != COMPILER_TARGET_RP2040 && target != COMPILER_TARGET_RP2350_ARM && target != COMPILER_TARGET_RP2350_RISCV) {
     fputs(
         "#include <time.h>\n"
-        "static SageValue sage_clock_fn(void) {\n"
+        "SAGE_RUNTIME SageValue sage_clock_fn(void) {\n"
         "    return sage_number((double)clock() / CLOCKS_PER_SEC);\n"
         "}\n"
-        "static SageValue sage_input_fn(SageValue prompt) {\n"
+        "SAGE_RUNTIME SageValue sage_input_fn(SageValue prompt) {\n"
         "    if (prompt.type == SAGE_TAG_STRING) fputs(prompt.as.string, "
         "stdout);\n"
         "    char buf[4096];\n"
@@ -5307,14 +5608,14 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
         "    if (len > 0 && buf[len-1] == '\\n') buf[--len] = '\\0';\n"
         "    return sage_string(buf);\n"
         "}\n"
-        "static SageValue sage_sys_args(void) {\n"
+        "SAGE_RUNTIME SageValue sage_sys_args(void) {\n"
         "    extern int sage_argc; extern char** sage_argv;\n"
         "    SageValue list = sage_array();\n"
         "    for(int i=0; i<sage_argc; i++) sage_push(list, "
         "sage_string(sage_argv[i]));\n"
         "    return list;\n"
         "}\n"
-        "static int sage_is_safe_command(const char* cmd) {\n"
+        "SAGE_RUNTIME int sage_is_safe_command(const char* cmd) {\n"
         "    if (!cmd) return 1;\n"
         "    if (cmd[0] == '-') return 0;\n"
         "    for (const char* p = cmd; *p; p++) {\n"
@@ -5325,7 +5626,7 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
         "    }\n"
         "    return 1;\n"
         "}\n"
-        "static SageValue sage_sys_exec(SageValue cmd) {\n"
+        "SAGE_RUNTIME SageValue sage_sys_exec(SageValue cmd) {\n"
         "    if(cmd.type != SAGE_TAG_STRING) return sage_number(-1);\n"
         "    if(!sage_is_safe_command(cmd.as.string)) {\n"
         "        fprintf(stderr, \"Security Error: Unsafe characters in command\\n\");\n"
@@ -5333,7 +5634,7 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
         "    }\n"
         "    return sage_number(system(cmd.as.string));\n"
         "}\n"
-        "static SageValue sage_io_readfile(SageValue p) {\n"
+        "SAGE_RUNTIME SageValue sage_io_readfile(SageValue p) {\n"
         "    if(p.type != SAGE_TAG_STRING) return sage_nil();\n"
         "    FILE* f = fopen(p.as.string, \"rb\"); if(!f) return sage_nil();\n"
         "    fseek(f, 0, SEEK_END); long size = ftell(f); fseek(f, 0, "
@@ -5344,7 +5645,7 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
         "    fread(buf, 1, size, f); buf[size] = 0; fclose(f);\n"
         "    return sage_string_take(buf);\n"
         "}\n"
-        "static SageValue sage_io_writefile(SageValue p, SageValue c) {\n"
+        "SAGE_RUNTIME SageValue sage_io_writefile(SageValue p, SageValue c) {\n"
         "    if(p.type != SAGE_TAG_STRING || c.type != SAGE_TAG_STRING) return "
         "sage_bool(0);\n"
         "    FILE* f = fopen(p.as.string, \"wb\"); if(!f) return "
@@ -5352,7 +5653,7 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
         "    fwrite(c.as.string, 1, strlen(c.as.string), f); fclose(f); return "
         "sage_bool(1);\n"
         "}\n"
-        "static SageValue sage_io_writebytes(SageValue p, SageValue v) {\n"
+        "SAGE_RUNTIME SageValue sage_io_writebytes(SageValue p, SageValue v) {\n"
         "    if(p.type != SAGE_TAG_STRING) return sage_bool(0);\n"
         "    if(v.type == SAGE_TAG_BYTES) {\n"
         "        FILE* f = fopen(p.as.string, \"wb\"); if(!f) return "
@@ -5370,7 +5671,7 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
         "    fwrite(buf, 1, a->count, f); fclose(f); free(buf); return "
         "sage_bool(1);\n"
         "}\n"
-        "static SageValue sage_io_appendbytes(SageValue p, SageValue v) {\n"
+        "SAGE_RUNTIME SageValue sage_io_appendbytes(SageValue p, SageValue v) {\n"
         "    if(p.type != SAGE_TAG_STRING) return sage_bool(0);\n"
         "    if(v.type == SAGE_TAG_BYTES) {\n"
         "        FILE* f = fopen(p.as.string, \"ab\"); if(!f) return "
@@ -5388,7 +5689,7 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
         "    fwrite(buf, 1, a->count, f); fclose(f); free(buf); return "
         "sage_bool(1);\n"
         "}\n"
-        "static SageValue sage_io_readbytes(SageValue p) {\n"
+        "SAGE_RUNTIME SageValue sage_io_readbytes(SageValue p) {\n"
         "    if(p.type != SAGE_TAG_STRING) return sage_nil();\n"
         "    FILE* f = fopen(p.as.string, \"rb\"); if(!f) return sage_nil();\n"
         "    SageValue arr = sage_array();\n"
@@ -5421,12 +5722,12 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
         "    fclose(f);\n"
         "    return arr;\n"
         "}\n"
-        "static SageValue sage_io_exists(SageValue p) {\n"
+        "SAGE_RUNTIME SageValue sage_io_exists(SageValue p) {\n"
         "    if(p.type != SAGE_TAG_STRING) return sage_bool(0);\n"
         "    FILE* f = fopen(p.as.string, \"r\"); if(f){ fclose(f); return "
         "sage_bool(1); } return sage_bool(0);\n"
         "}\n"
-        "static SageValue sage_string_substr(SageValue s, SageValue start, "
+        "SAGE_RUNTIME SageValue sage_string_substr(SageValue s, SageValue start, "
         "SageValue len) {\n"
         "    if(s.type != SAGE_TAG_STRING || start.type != SAGE_TAG_NUMBER || "
         "len.type != SAGE_TAG_NUMBER) return sage_nil();\n"
@@ -5443,17 +5744,27 @@ static void emit_runtime_prelude(FILE *out, CompilerTarget target) {
   }
 }
 
+// Procedures and methods of a modular build are called across units.
+static const char *symbol_linkage(Compiler *compiler) {
+  return compiler->modular ? "" : "static ";
+}
+
+static void emit_proc_prototype(Compiler *compiler, ProcEntry *proc) {
+  emit_indent(compiler);
+  fprintf(compiler->out, "%sSageValue %s(", symbol_linkage(compiler),
+          proc->c_name);
+  for (int i = 0; i < proc->param_count; i++) {
+    if (i > 0) {
+      fputs(", ", compiler->out);
+    }
+    fprintf(compiler->out, "SageValue arg%d", i);
+  }
+  fputs(");\n", compiler->out);
+}
+
 static void emit_proc_prototypes(Compiler *compiler) {
   for (ProcEntry *proc = compiler->procs; proc != NULL; proc = proc->next) {
-    emit_indent(compiler);
-    fprintf(compiler->out, "static SageValue %s(", proc->c_name);
-    for (int i = 0; i < proc->param_count; i++) {
-      if (i > 0) {
-        fputs(", ", compiler->out);
-      }
-      fprintf(compiler->out, "SageValue arg%d", i);
-    }
-    fputs(");\n", compiler->out);
+    emit_proc_prototype(compiler, proc);
   }
 }
 
@@ -5472,635 +5783,1750 @@ static void emit_mark_globals_function(Compiler *compiler) {
 static void emit_global_slots(Compiler *compiler) {
   for (NameEntry *global = compiler->globals; global != NULL;
        global = global->next) {
-    emit_line(compiler, "static SageSlot %s;", global->c_name);
+    emit_line(compiler, "%sSageSlot %s;", symbol_linkage(compiler),
+              global->c_name);
   }
 }
 
-static int count_name_entries(NameEntry *entries) {
-  int count = 0;
-  for (NameEntry *entry = entries; entry != NULL; entry = entry->next) {
-    count++;
+static void emit_program_globals(Compiler *compiler) {
+  emit_global_slots(compiler);
+  if (compiler->globals != NULL) {
+    fputc('\n', compiler->out);
+    emit_mark_globals_function(compiler);
+    fputc('\n', compiler->out);
+  } else {
+    fputs("void sage_gc_mark_program_globals(void) {}\n\n", compiler->out);
   }
-  return count;
 }
 
-static void emit_slot_declarations(Compiler *compiler, NameEntry *locals) {
-  for (NameEntry *local = locals; local != NULL; local = local->next) {
-    emit_line(compiler, "SageSlot %s = sage_slot_undefined();", local->c_name);
-  }
-}
+// Root analysis. A local needs a shadow-stack slot only if it can hold a
+// heap value across a safepoint: an expression that allocates or calls code
+// that may. The walk numbers those events in evaluation order and tracks,
+// per local, the definition that dominates the current point. A use keeps
+// the local live until the end of its statement, since the value it loaded
+// is an unrooted temporary until then; the local is rooted if a safepoint
+// ran between its definition and that point, or anywhere in a loop entered
+// after the definition (the back edge reaches the use again).
+//
+// Locals known to hold a scalar (number, bool or nil) carry no pointer and
+// are never rooted. That is known after assigning a scalar expression, and
+// after the local was an operand of an operator that fails on anything but
+// numbers: in fib, `n < 2` runs before any call, so `n` needs no slot.
+typedef struct {
+  int start;               // event number at loop entry
+  unsigned char *crossing; // locals used in the loop, defined outside it
+} RootLoop;
 
-static void emit_slot_frame_setup(Compiler *compiler, NameEntry *locals,
-                                  const char *roots_name,
-                                  const char *frame_name) {
-  int count = count_name_entries(locals);
+typedef struct {
+  NameEntry *locals;
+  int count;
+  int *def;                // dominating definition per local, -1 if none
+  int *last_def;           // latest definition per local, in any block
+  unsigned char *scalar;   // local holds no heap pointer at this point
+  unsigned char *rooted;
+  int *pending;            // locals used by the current statement...
+  int *pending_def;        // ...and the definitions those uses saw
+  int pending_count;
+  int pending_capacity;
+  RootLoop *loops;
+  int loop_count;
+  int loop_capacity;
+  int event;
+  int last_safepoint;
+  int uses_stack;          // iterator loops claim a shadow-stack slot
+  int root_all;            // the walk met a statement it does not model
+} RootAnalysis;
 
-  if (count == 0) {
-    emit_line(compiler, "SageGcFrame %s;", frame_name);
-    emit_line(compiler, "sage_gc_push_frame(&%s, NULL, 0);", frame_name);
-    return;
-  }
+typedef struct {
+  int *def;
+  unsigned char *scalar;
+  int event;
+} RootSnapshot;
 
-  emit_indent(compiler);
-  fprintf(compiler->out, "SageSlot* %s[%d] = {", roots_name, count);
+static int root_local_index(RootAnalysis *ra, Token name) {
   int index = 0;
-  for (NameEntry *local = locals; local != NULL; local = local->next, index++) {
-    if (index > 0) {
-      fputs(", ", compiler->out);
+  for (NameEntry *local = ra->locals; local != NULL;
+       local = local->next, index++) {
+    if ((int)strlen(local->sage_name) == name.length &&
+        strncmp(local->sage_name, name.start, name.length) == 0) {
+      return index;
     }
-    fprintf(compiler->out, "&%s", local->c_name);
   }
-  fputs("};\n", compiler->out);
-  emit_line(compiler, "SageGcFrame %s;", frame_name);
-  emit_line(compiler, "sage_gc_push_frame(&%s, %s, %d);", frame_name,
-            roots_name, count);
+  return -1;
 }
 
-// Phase 17: Emit C attributes/pragmas for decorated declarations
-static void emit_pragma_attributes(Compiler *compiler, Pragma *pragmas) {
-  for (Pragma *p = pragmas; p != NULL; p = p->next) {
-    if (strcmp(p->name, "inline") == 0) {
-      emit_line(compiler, "/* @inline */");
-      // 'inline' is applied to the function signature below
-    } else if (strcmp(p->name, "packed") == 0) {
-      emit_line(compiler, "#pragma pack(push, 1)");
-    } else if (strcmp(p->name, "section") == 0 && p->arg_count > 0) {
-      emit_line(compiler, "/* @section(\"%s\") */", p->args[0]);
-    } else if (strcmp(p->name, "align") == 0 && p->arg_count > 0) {
-      emit_line(compiler, "/* @align(%s) */", p->args[0]);
-    } else if (strcmp(p->name, "deprecated") == 0) {
-      emit_line(compiler, "/* @deprecated */");
-    } else if (strcmp(p->name, "noreturn") == 0) {
-      emit_line(compiler, "/* @noreturn */");
-    } else {
-      emit_line(compiler, "/* @%s */", p->name);
-    }
+static RootSnapshot root_save(RootAnalysis *ra) {
+  RootSnapshot snapshot;
+  snapshot.def = SAGE_ALLOC(sizeof(int) * (ra->count + 1));
+  snapshot.scalar = SAGE_ALLOC(ra->count + 1);
+  memcpy(snapshot.def, ra->def, sizeof(int) * ra->count);
+  memcpy(snapshot.scalar, ra->scalar, ra->count);
+  snapshot.event = ra->event;
+  return snapshot;
+}
+
+// Leaving a nested block: its definitions no longer dominate, and a local
+// it redefined may hold anything
+static void root_restore(RootAnalysis *ra, RootSnapshot *snapshot) {
+  for (int i = 0; i < ra->count; i++) {
+    ra->def[i] = snapshot->def[i];
+    ra->scalar[i] = snapshot->scalar[i] && ra->last_def[i] <= snapshot->event;
   }
+  free(snapshot->def);
+  free(snapshot->scalar);
 }
 
-static int has_pragma(Pragma *pragmas, const char *name) {
-  for (Pragma *p = pragmas; p != NULL; p = p->next) {
-    if (strcmp(p->name, name) == 0)
-      return 1;
+static void root_safepoint(RootAnalysis *ra) {
+  ra->last_safepoint = ++ra->event;
+}
+
+static void root_define(RootAnalysis *ra, Token name, int scalar) {
+  int index = root_local_index(ra, name);
+  if (index >= 0) {
+    ra->def[index] = ra->last_def[index] = ++ra->event;
+    ra->scalar[index] = (unsigned char)scalar;
   }
-  return 0;
 }
 
-static void emit_function_definition(Compiler *compiler, Stmt *stmt) {
-  ProcStmt *proc_stmt = &stmt->as.proc;
-  char *proc_name = token_to_string(proc_stmt->name);
-  ProcEntry *proc = find_proc_entry(compiler->procs, proc_name);
-  free(proc_name);
-  if (proc == NULL) {
-    compiler_error_at(compiler, &proc_stmt->name, NULL,
-                      "internal compiler error: missing procedure metadata "
-                      "during code generation");
+static void root_use(RootAnalysis *ra, Token name) {
+  int index = root_local_index(ra, name);
+  if (index < 0 || ra->scalar[index]) {
     return;
   }
-
-  NameEntry *params = NULL;
-  for (int i = 0; i < proc_stmt->param_count; i++) {
-    char *param_name = token_to_string(proc_stmt->params[i]);
-    if (find_name_entry(params, param_name) != NULL) {
-      compiler_error_at(
-          compiler, &proc_stmt->params[i],
-          "rename one of the parameters so every parameter name is unique",
-          "duplicate parameter '%s' in procedure '%.*s'", param_name,
-          proc_stmt->name.length, proc_stmt->name.start);
-      free(param_name);
-      return;
+  int def = ra->def[index];
+  if (def < 0) {
+    // Only defined on some paths here: no single definition to reason from
+    ra->rooted[index] = 1;
+    return;
+  }
+  for (int i = 0; i < ra->loop_count; i++) {
+    if (ra->loops[i].start > def) {
+      ra->loops[i].crossing[index] = 1;
     }
-    add_name_entry(compiler, &params, param_name, "sage_param");
-    free(param_name);
   }
+  if (ra->pending_count == ra->pending_capacity) {
+    ra->pending_capacity = ra->pending_capacity ? ra->pending_capacity * 2 : 8;
+    ra->pending = SAGE_REALLOC(ra->pending, sizeof(int) * ra->pending_capacity);
+    ra->pending_def =
+        SAGE_REALLOC(ra->pending_def, sizeof(int) * ra->pending_capacity);
+  }
+  ra->pending[ra->pending_count] = index;
+  ra->pending_def[ra->pending_count] = def;
+  ra->pending_count++;
+}
 
-  NameEntry *previous_locals = compiler->locals;
-  compiler->locals = params;
-  collect_local_lets(compiler, proc_stmt->body, &compiler->locals);
-  if (compiler->failed) {
-    free_name_entries(compiler->locals);
-    compiler->locals = previous_locals;
+// The local survived an operator that only accepts numbers, so the value
+// every use in this statement loaded was one
+static void root_mark_scalar(RootAnalysis *ra, Expr *operand) {
+  if (operand == NULL || operand->type != EXPR_VARIABLE) {
     return;
   }
-
-  // Phase 17: emit pragma attributes before function
-  if (stmt->pragmas)
-    emit_pragma_attributes(compiler, stmt->pragmas);
-
-  emit_indent(compiler);
-  if (stmt->pragmas && has_pragma(stmt->pragmas, "inline")) {
-    fprintf(compiler->out, "static inline SageValue %s(", proc->c_name);
-  } else {
-    fprintf(compiler->out, "static SageValue %s(", proc->c_name);
+  int index = root_local_index(ra, operand->as.variable.name);
+  if (index < 0) {
+    return;
   }
-  for (int i = 0; i < proc_stmt->param_count; i++) {
-    if (i > 0) {
-      fputs(", ", compiler->out);
+  ra->scalar[index] = 1;
+  int kept = 0;
+  for (int i = 0; i < ra->pending_count; i++) {
+    if (ra->pending[i] != index || ra->pending_def[i] != ra->def[index]) {
+      ra->pending[kept] = ra->pending[i];
+      ra->pending_def[kept] = ra->pending_def[i];
+      kept++;
     }
-    fprintf(compiler->out, "SageValue arg%d", i);
   }
-  fputs(") {\n", compiler->out);
-  compiler->indent++;
+  ra->pending_count = kept;
+}
 
-  emit_slot_declarations(compiler, compiler->locals);
-  emit_slot_frame_setup(compiler, compiler->locals, "sage_gc_roots",
-                        "sage_gc_frame");
-  for (int i = 0; i < proc_stmt->param_count; i++) {
-    char *param_name = token_to_string(proc_stmt->params[i]);
-    NameEntry *param = find_name_entry(compiler->locals, param_name);
-    free(param_name);
-    emit_line(compiler, "sage_define_slot(&%s, arg%d);", param->c_name, i);
+// End of a statement (or of a condition): its temporaries are dead
+static void root_flush(RootAnalysis *ra) {
+  for (int i = 0; i < ra->pending_count; i++) {
+    if (ra->last_safepoint > ra->pending_def[i]) {
+      ra->rooted[ra->pending[i]] = 1;
+    }
   }
-
-  compiler->in_function_body = 1;
-  emit_stmt_list(compiler, proc_stmt->body);
-  compiler->in_function_body = 0;
-  emit_line(compiler, "return sage_gc_return(&sage_gc_frame, sage_nil());");
-
-  compiler->indent--;
-  emit_line(compiler, "}");
-  fputc('\n', compiler->out);
-
-  free_name_entries(compiler->locals);
-  compiler->locals = previous_locals;
+  ra->pending_count = 0;
 }
 
-static void emit_method_definition(Compiler *compiler, ClassInfo *cls,
-                                   Stmt *method) {
-  ProcStmt *proc = &method->as.proc;
-  char *method_name = token_to_string(proc->name);
-
-  int has_self = (proc->param_count > 0 && proc->params[0].length == 4 &&
-                  strncmp(proc->params[0].start, "self", 4) == 0);
-  int param_start = has_self ? 1 : 0;
-
-  NameEntry *previous_locals = compiler->locals;
-  ClassInfo *previous_class = compiler->current_class;
-  compiler->locals = NULL;
-  compiler->current_class = cls;
-
-  /* Add self as a local */
-  add_name_entry(compiler, &compiler->locals, "self", "sage_local");
+// The back edge may bring any value the body assigns, so what was known
+// scalar before the loop is not inside it
+static void root_enter_loop(RootAnalysis *ra) {
+  if (ra->loop_count == ra->loop_capacity) {
+    ra->loop_capacity = ra->loop_capacity ? ra->loop_capacity * 2 : 4;
+    ra->loops = SAGE_REALLOC(ra->loops, sizeof(RootLoop) * ra->loop_capacity);
+  }
+  RootLoop *loop = &ra->loops[ra->loop_count++];
+  loop->start = ++ra->event;
+  loop->crossing = SAGE_ALLOC(ra->count + 1);
+  memset(loop->crossing, 0, ra->count + 1);
+  memset(ra->scalar, 0, ra->count);
+}
 
-  /* Add non-self params as locals */
-  for (int i = param_start; i < proc->param_count; i++) {
-    char *pname = token_to_string(proc->params[i]);
-    if (find_name_entry(compiler->locals, pname) == NULL) {
-      add_name_entry(compiler, &compiler->locals, pname, "sage_local");
+static void root_leave_loop(RootAnalysis *ra) {
+  RootLoop *loop = &ra->loops[--ra->loop_count];
+  if (ra->last_safepoint > loop->start) {
+    for (int i = 0; i < ra->count; i++) {
+      if (loop->crossing[i]) {
+        ra->rooted[i] = 1;
+      }
     }
-    free(pname);
-  }
-
-  collect_local_lets(compiler, proc->body, &compiler->locals);
-  if (compiler->failed) {
-    free_name_entries(compiler->locals);
-    compiler->locals = previous_locals;
-    free(method_name);
-    return;
   }
+  free(loop->crossing);
+}
 
-  emit_indent(compiler);
-  fprintf(compiler->out,
-          "static SageValue sage_method_%s_%s(SageValue _self, int _argc, "
-          "SageValue* _argv) {\n",
+static int numeric_operator(TokenType op) {
+  switch (op) {
+  case TOKEN_MINUS:
+  case TOKEN_STAR:
+  case TOKEN_SLASH:
+  case TOKEN_PERCENT:
+  case TOKEN_GT:
+  case TOKEN_LT:
+  case TOKEN_GTE:
+  case TOKEN_LTE:
+  case TOKEN_AMP:
+  case TOKEN_PIPE:
+  case TOKEN_CARET:
+  case TOKEN_LSHIFT:
+  case TOKEN_RSHIFT:
+  case TOKEN_TILDE:
+    return 1;
+  default:
+    return 0;
+  }
+}
+
+// Every operator but '+' yields a number, bool or nil; '+' does too when
+// both sides are scalars
+static int root_scalar_expr(RootAnalysis *ra, Expr *expr) {
+  switch (expr->type) {
+  case EXPR_NUMBER:
+  case EXPR_BOOL:
+  case EXPR_NIL:
+    return 1;
+  case EXPR_VARIABLE: {
+    int index = root_local_index(ra, expr->as.variable.name);
+    return index >= 0 && ra->scalar[index];
+  }
+  case EXPR_BINARY:
+    if (expr->as.binary.op.type != TOKEN_PLUS) {
+      return 1;
+    }
+    return root_scalar_expr(ra, expr->as.binary.left) &&
+           root_scalar_expr(ra, expr->as.binary.right);
+  default:
+    return 0;
+  }
+}
+
+static void root_walk_expr(RootAnalysis *ra, Expr *expr) {
+  if (expr == NULL) {
+    return;
+  }
+  switch (expr->type) {
+  case EXPR_NUMBER:
+  case EXPR_BOOL:
+  case EXPR_NIL:
+    return;
+  case EXPR_STRING:
+    root_safepoint(ra);
+    return;
+  case EXPR_VARIABLE:
+    root_use(ra, expr->as.variable.name);
+    return;
+  case EXPR_BINARY:
+    root_walk_expr(ra, expr->as.binary.left);
+    root_walk_expr(ra, expr->as.binary.right);
+    if (numeric_operator(expr->as.binary.op.type)) {
+      root_mark_scalar(ra, expr->as.binary.left);
+      root_mark_scalar(ra, expr->as.binary.right);
+    } else if (expr->as.binary.op.type == TOKEN_PLUS) {
+      // '+' concatenates strings and arrays
+      root_safepoint(ra);
+    }
+    return;
+  case EXPR_CALL:
+    root_walk_expr(ra, expr->as.call.callee);
+    for (int i = 0; i < expr->as.call.arg_count; i++) {
+      root_walk_expr(ra, expr->as.call.args[i]);
+    }
+    root_safepoint(ra);
+    return;
+  case EXPR_ARRAY:
+    for (int i = 0; i < expr->as.array.count; i++) {
+      root_walk_expr(ra, expr->as.array.elements[i]);
+    }
+    root_safepoint(ra);
+    return;
+  case EXPR_TUPLE:
+    for (int i = 0; i < expr->as.tuple.count; i++) {
+      root_walk_expr(ra, expr->as.tuple.elements[i]);
+    }
+    root_safepoint(ra);
+    return;
+  case EXPR_DICT:
+    for (int i = 0; i < expr->as.dict.count; i++) {
+      root_walk_expr(ra, expr->as.dict.values[i]);
+    }
+    root_safepoint(ra);
+    return;
+  case EXPR_INDEX:
+    root_walk_expr(ra, expr->as.index.array);
+    root_walk_expr(ra, expr->as.index.index);
+    root_safepoint(ra);
+    return;
+  case EXPR_INDEX_SET:
+    root_walk_expr(ra, expr->as.index_set.array);
+    root_walk_expr(ra, expr->as.index_set.index);
+    root_walk_expr(ra, expr->as.index_set.value);
+    root_safepoint(ra);
+    return;
+  case EXPR_SLICE:
+    root_walk_expr(ra, expr->as.slice.array);
+    root_walk_expr(ra, expr->as.slice.start);
+    root_walk_expr(ra, expr->as.slice.end);
+    root_safepoint(ra);
+    return;
+  case EXPR_GET:
+    root_walk_expr(ra, expr->as.get.object);
+    root_safepoint(ra);
+    return;
+  case EXPR_SET:
+    root_walk_expr(ra, expr->as.set.value);
+    if (expr->as.set.object != NULL) {
+      root_walk_expr(ra, expr->as.set.object);
+      root_safepoint(ra);
+      return;
+    }
+    root_define(ra, expr->as.set.property,
+                root_scalar_expr(ra, expr->as.set.value));
+    return;
+  case EXPR_AWAIT:
+    root_walk_expr(ra, expr->as.await.expression);
+    return;
+  case EXPR_COMPTIME:
+    root_walk_expr(ra, expr->as.comptime.expression);
+    return;
+  default:
+    ra->root_all = 1;
+    return;
+  }
+}
+
+static void root_walk_stmts(RootAnalysis *ra, Stmt *stmt);
+
+static void root_walk_block(RootAnalysis *ra, Stmt *stmt) {
+  RootSnapshot snapshot = root_save(ra);
+  root_walk_stmts(ra, stmt);
+  root_restore(ra, &snapshot);
+}
+
+static void root_walk_stmts(RootAnalysis *ra, Stmt *stmt) {
+  for (; stmt != NULL && !ra->root_all; stmt = stmt->next) {
+    switch (stmt->type) {
+    case STMT_PRINT:
+      root_walk_expr(ra, stmt->as.print.expression);
+      break;
+    case STMT_EXPRESSION:
+      root_walk_expr(ra, stmt->as.expression);
+      break;
+    case STMT_LET:
+      root_walk_expr(ra, stmt->as.let.initializer);
+      root_flush(ra);
+      root_define(ra, stmt->as.let.name,
+                  stmt->as.let.initializer == NULL ||
+                      root_scalar_expr(ra, stmt->as.let.initializer));
+      break;
+    case STMT_RETURN:
+      root_walk_expr(ra, stmt->as.ret.value);
+      break;
+    case STMT_RAISE:
+      root_walk_expr(ra, stmt->as.raise.exception);
+      break;
+    case STMT_BREAK:
+    case STMT_CONTINUE:
+      break;
+    case STMT_BLOCK:
+      root_walk_block(ra, stmt->as.block.statements);
+      break;
+    case STMT_IF:
+      root_walk_expr(ra, stmt->as.if_stmt.condition);
+      root_flush(ra);
+      root_walk_block(ra, stmt->as.if_stmt.then_branch);
+      root_walk_block(ra, stmt->as.if_stmt.else_branch);
+      break;
+    case STMT_WHILE: {
+      RootSnapshot snapshot = root_save(ra);
+      root_enter_loop(ra);
+      root_walk_expr(ra, stmt->as.while_stmt.condition);
+      root_flush(ra);
+      root_walk_stmts(ra, stmt->as.while_stmt.body);
+      root_leave_loop(ra);
+      root_restore(ra, &snapshot);
+      break;
+    }
+    case STMT_FOR: {
+      ForStmt *loop = &stmt->as.for_stmt;
+      if (loop->counted) {
+        for (int i = 0; i < loop->iterable->as.call.arg_count; i++) {
+          root_walk_expr(ra, loop->iterable->as.call.args[i]);
+        }
+      } else {
+        root_walk_expr(ra, loop->iterable);
+        ra->uses_stack = 1;
+      }
+      root_flush(ra);
+      RootSnapshot snapshot = root_save(ra);
+      root_enter_loop(ra);
+      if (!loop->counted) {
+        // Iterating a string builds a one-character string each time
+        root_safepoint(ra);
+      }
+      root_define(ra, loop->variable, loop->counted);
+      root_walk_stmts(ra, loop->body);
+      root_leave_loop(ra);
+      root_restore(ra, &snapshot);
+      break;
+    }
+    default:
+      // try needs every local in memory across setjmp; match, defer and
+      // the rest are not modelled
+      ra->root_all = 1;
+      break;
+    }
+    root_flush(ra);
+  }
+}
+
+// Marks the locals that need a shadow-stack slot in `rooted` and returns
+// whether the function needs a shadow-stack block at all. Parameters, and
+// self for methods, are bound on entry.
+static int analyze_roots(NameEntry *locals, Stmt *body, Token *params,
+                         int param_count, int defines_self,
+                         unsigned char **rooted_out) {
+  RootAnalysis ra;
+  memset(&ra, 0, sizeof(ra));
+  ra.locals = locals;
+  for (NameEntry *local = locals; local != NULL; local = local->next) {
+    ra.count++;
+  }
+  ra.def = SAGE_ALLOC(sizeof(int) * (ra.count + 1));
+  ra.last_def = SAGE_ALLOC(sizeof(int) * (ra.count + 1));
+  ra.scalar = SAGE_ALLOC(ra.count + 1);
+  ra.rooted = SAGE_ALLOC(ra.count + 1);
+  memset(ra.scalar, 0, ra.count + 1);
+  memset(ra.rooted, 0, ra.count + 1);
+  for (int i = 0; i < ra.count; i++) {
+    ra.def[i] = ra.last_def[i] = -1;
+  }
+  for (int i = 0; i < param_count; i++) {
+    root_define(&ra, params[i], 0);
+  }
+  if (defines_self) {
+    int index = 0;
+    for (NameEntry *local = locals; local != NULL;
+         local = local->next, index++) {
+      if (strcmp(local->sage_name, "self") == 0) {
+        ra.def[index] = ra.last_def[index] = ra.event;
+      }
+    }
+  }
+
+  root_walk_stmts(&ra, body);
+  while (ra.loop_count > 0) {
+    free(ra.loops[--ra.loop_count].crossing);
+  }
+
+  int rooted = 0;
+  for (int i = 0; i < ra.count; i++) {
+    if (ra.root_all) {
+      ra.rooted[i] = 1;
+    }
+    rooted += ra.rooted[i];
+  }
+  *rooted_out = ra.rooted;
+  free(ra.def);
+  free(ra.last_def);
+  free(ra.scalar);
+  free(ra.pending);
+  free(ra.pending_def);
+  free(ra.loops);
+  return rooted > 0 || ra.uses_stack || ra.root_all;
+}
+
+// Rooted locals live in a block of the shadow stack claimed on entry: the
+// i-th rooted local is sage_slots[i] for the whole body, so the layout is
+// the function's stack map and nothing is registered per call. The other
+// locals stay plain C variables, and a function with neither rooted locals
+// nor iterator loops never touches the shadow stack.
+static void emit_slot_frame_setup(Compiler *compiler, NameEntry *locals,
+                                  Stmt *body, Token *params, int param_count,
+                                  int defines_self) {
+  unsigned char *rooted = NULL;
+  int uses_stack = analyze_roots(locals, body, params, param_count,
+                                 defines_self, &rooted);
+  compiler->shadow_frame = uses_stack;
+
+  int index = 0;
+  int slot = 0;
+  for (NameEntry *local = locals; local != NULL; local = local->next, index++) {
+    if (!rooted[index]) {
+      emit_line(compiler, "SageSlot %s = sage_slot_undefined();",
+                local->c_name);
+      continue;
+    }
+    char c_name[32];
+    snprintf(c_name, sizeof(c_name), "sage_slots[%d]", slot++);
+    emit_line(compiler, "/* %s: %s */", c_name, local->sage_name);
+    free(local->c_name);
+    local->c_name = str_dup(c_name);
+  }
+  if (uses_stack) {
+    emit_line(compiler, "SageSlot* sage_slots = sage_gc_enter(%d);", slot);
+  }
+  free(rooted);
+}
+
+// Profile-guided function placement: procedures that never ran in the
+// profiled workload go to .text.unlikely, hot ones are optimized harder.
+static const char *heat_attribute(Compiler *compiler, ProcStmt *proc) {
+  switch (profile_function_heat(compiler->profile, proc)) {
+  case PROFILE_HEAT_COLD:
+    return "SAGE_COLD ";
+  case PROFILE_HEAT_HOT:
+    return "SAGE_HOT ";
+  default:
+    return "";
+  }
+}
+
+// Phase 17: Emit C attributes/pragmas for decorated declarations
+static void emit_pragma_attributes(Compiler *compiler, Pragma *pragmas) {
+  for (Pragma *p = pragmas; p != NULL; p = p->next) {
+    if (strcmp(p->name, "inline") == 0) {
+      emit_line(compiler, "/* @inline */");
+      // 'inline' is applied to the function signature below
+    } else if (strcmp(p->name, "packed") == 0) {
+      emit_line(compiler, "#pragma pack(push, 1)");
+    } else if (strcmp(p->name, "section") == 0 && p->arg_count > 0) {
+      emit_line(compiler, "/* @section(\"%s\") */", p->args[0]);
+    } else if (strcmp(p->name, "align") == 0 && p->arg_count > 0) {
+      emit_line(compiler, "/* @align(%s) */", p->args[0]);
+    } else if (strcmp(p->name, "deprecated") == 0) {
+      emit_line(compiler, "/* @deprecated */");
+    } else if (strcmp(p->name, "noreturn") == 0) {
+      emit_line(compiler, "/* @noreturn */");
+    } else {
+      emit_line(compiler, "/* @%s */", p->name);
+    }
+  }
+}
+
+static int has_pragma(Pragma *pragmas, const char *name) {
+  for (Pragma *p = pragmas; p != NULL; p = p->next) {
+    if (strcmp(p->name, name) == 0)
+      return 1;
+  }
+  return 0;
+}
+
+static void emit_function_definition(Compiler *compiler, Stmt *stmt) {
+  ProcStmt *proc_stmt = &stmt->as.proc;
+  char *proc_name = token_to_string(proc_stmt->name);
+  ProcEntry *proc =
+      find_proc_in(compiler->procs, compiler->current_module, proc_name);
+  free(proc_name);
+  if (proc == NULL) {
+    compiler_error_at(compiler, &proc_stmt->name, NULL,
+                      "internal compiler error: missing procedure metadata "
+                      "during code generation");
+    return;
+  }
+
+  NameEntry *params = NULL;
+  for (int i = 0; i < proc_stmt->param_count; i++) {
+    char *param_name = token_to_string(proc_stmt->params[i]);
+    if (find_name_entry(params, param_name) != NULL) {
+      compiler_error_at(
+          compiler, &proc_stmt->params[i],
+          "rename one of the parameters so every parameter name is unique",
+          "duplicate parameter '%s' in procedure '%.*s'", param_name,
+          proc_stmt->name.length, proc_stmt->name.start);
+      free(param_name);
+      return;
+    }
+    add_name_entry(compiler, &params, param_name, "sage_param");
+    free(param_name);
+  }
+
+  NameEntry *previous_locals = compiler->locals;
+  compiler->locals = params;
+  collect_local_lets(compiler, proc_stmt->body, &compiler->locals);
+  if (compiler->failed) {
+    free_name_entries(compiler->locals);
+    compiler->locals = previous_locals;
+    return;
+  }
+
+  // Phase 17: emit pragma attributes before function
+  if (stmt->pragmas)
+    emit_pragma_attributes(compiler, stmt->pragmas);
+
+  emit_indent(compiler);
+  if (stmt->pragmas && has_pragma(stmt->pragmas, "inline") &&
+      !compiler->modular) {
+    fprintf(compiler->out, "static inline SageValue %s(", proc->c_name);
+  } else {
+    fprintf(compiler->out, "%s%sSageValue %s(", symbol_linkage(compiler),
+            heat_attribute(compiler, proc_stmt), proc->c_name);
+  }
+  for (int i = 0; i < proc_stmt->param_count; i++) {
+    if (i > 0) {
+      fputs(", ", compiler->out);
+    }
+    fprintf(compiler->out, "SageValue arg%d", i);
+  }
+  fputs(") {\n", compiler->out);
+  compiler->indent++;
+
+  emit_slot_frame_setup(compiler, compiler->locals, proc_stmt->body,
+                        proc_stmt->params, proc_stmt->param_count, 0);
+  for (int i = 0; i < proc_stmt->param_count; i++) {
+    char *param_name = token_to_string(proc_stmt->params[i]);
+    NameEntry *param = find_name_entry(compiler->locals, param_name);
+    free(param_name);
+    emit_line(compiler, "sage_define_slot(&%s, arg%d);", param->c_name, i);
+  }
+
+  compiler->in_function_body = 1;
+  emit_stmt_list(compiler, proc_stmt->body);
+  compiler->in_function_body = 0;
+  emit_line(compiler, compiler->shadow_frame
+                          ? "return sage_gc_return(sage_slots, sage_nil());"
+                          : "return sage_nil();");
+
+  compiler->indent--;
+  emit_line(compiler, "}");
+  fputc('\n', compiler->out);
+
+  free_name_entries(compiler->locals);
+  compiler->locals = previous_locals;
+}
+
+static void emit_method_definition(Compiler *compiler, ClassInfo *cls,
+                                   Stmt *method) {
+  ProcStmt *proc = &method->as.proc;
+  char *method_name = token_to_string(proc->name);
+
+  int has_self = (proc->param_count > 0 && proc->params[0].length == 4 &&
+                  strncmp(proc->params[0].start, "self", 4) == 0);
+  int param_start = has_self ? 1 : 0;
+
+  NameEntry *previous_locals = compiler->locals;
+  ClassInfo *previous_class = compiler->current_class;
+  const char *previous_module = compiler->current_module;
+  compiler->locals = NULL;
+  compiler->current_class = cls;
+  compiler->current_module = cls->module;
+
+  /* Add self as a local */
+  add_name_entry(compiler, &compiler->locals, "self", "sage_local");
+
+  /* Add non-self params as locals */
+  for (int i = param_start; i < proc->param_count; i++) {
+    char *pname = token_to_string(proc->params[i]);
+    if (find_name_entry(compiler->locals, pname) == NULL) {
+      add_name_entry(compiler, &compiler->locals, pname, "sage_local");
+    }
+    free(pname);
+  }
+
+  collect_local_lets(compiler, proc->body, &compiler->locals);
+  if (compiler->failed) {
+    free_name_entries(compiler->locals);
+    compiler->locals = previous_locals;
+    free(method_name);
+    return;
+  }
+
+  emit_indent(compiler);
+  fprintf(compiler->out,
+          "%s%sSageValue sage_method_%s_%s(SageValue _self, int _argc, "
+          "SageValue* _argv) {\n",
+          symbol_linkage(compiler), heat_attribute(compiler, proc),
           cls->class_name, method_name);
   compiler->indent++;
 
-  emit_slot_declarations(compiler, compiler->locals);
-  emit_slot_frame_setup(compiler, compiler->locals, "sage_gc_roots",
-                        "sage_gc_frame");
+  emit_slot_frame_setup(compiler, compiler->locals, proc->body, proc->params,
+                        proc->param_count, 1);
+
+  /* Bind self */
+  NameEntry *self_entry = find_name_entry(compiler->locals, "self");
+  emit_line(compiler, "sage_define_slot(&%s, _self);", self_entry->c_name);
+
+  /* Bind params from argv */
+  int argv_idx = 0;
+  for (int i = param_start; i < proc->param_count; i++) {
+    char *pname = token_to_string(proc->params[i]);
+    NameEntry *entry = find_name_entry(compiler->locals, pname);
+    emit_line(compiler, "sage_define_slot(&%s, _argv[%d]);", entry->c_name,
+              argv_idx++);
+    free(pname);
+  }
+
+  emit_line(compiler, "(void)_argc;");
+
+  compiler->in_function_body = 1;
+  emit_stmt_list(compiler, proc->body);
+  compiler->in_function_body = 0;
+  emit_line(compiler, compiler->shadow_frame
+                          ? "return sage_gc_return(sage_slots, sage_nil());"
+                          : "return sage_nil();");
+
+  compiler->indent--;
+  emit_line(compiler, "}");
+  fputc('\n', compiler->out);
+
+  free_name_entries(compiler->locals);
+  compiler->locals = previous_locals;
+  compiler->current_class = previous_class;
+  compiler->current_module = previous_module;
+  free(method_name);
+}
+
+static void emit_method_prototypes(Compiler *compiler) {
+  for (ClassInfo *cls = compiler->classes; cls != NULL; cls = cls->next) {
+    for (Stmt *method = cls->methods; method != NULL; method = method->next) {
+      if (method->type == STMT_PROC) {
+        char *method_name = token_to_string(method->as.proc.name);
+        emit_indent(compiler);
+        fprintf(compiler->out,
+                "static SageValue sage_method_%s_%s(SageValue _self, int "
+                "_argc, SageValue* _argv);\n",
+                cls->class_name, method_name);
+        free(method_name);
+      }
+    }
+  }
+}
+
+static void emit_function_definitions(Compiler *compiler, Stmt *program) {
+  /* Emit module functions first */
+  for (ImportedModule *m = compiler->modules; m != NULL; m = m->next) {
+    compiler->current_module = m->name;
+    for (Stmt *stmt = m->ast; stmt != NULL; stmt = stmt->next) {
+      if (stmt->type == STMT_PROC || stmt->type == STMT_ASYNC_PROC) {
+        emit_function_definition(compiler, stmt);
+        if (compiler->failed)
+          break;
+      }
+    }
+    compiler->current_module = NULL;
+    if (compiler->failed)
+      return;
+  }
+
+  /* Emit class methods */
+  for (ClassInfo *cls = compiler->classes; cls != NULL; cls = cls->next) {
+    for (Stmt *method = cls->methods; method != NULL; method = method->next) {
+      if (method->type == STMT_PROC) {
+        emit_method_definition(compiler, cls, method);
+        if (compiler->failed)
+          return;
+      }
+    }
+  }
+
+  /* Emit main program functions */
+  for (Stmt *stmt = program; stmt != NULL; stmt = stmt->next) {
+    if (stmt->type == STMT_PROC || stmt->type == STMT_ASYNC_PROC) {
+      emit_function_definition(compiler, stmt);
+      if (compiler->failed) {
+        return;
+      }
+    }
+  }
+}
+
+static void emit_main_function(Compiler *compiler, Stmt *program,
+                               CompilerTarget target) {
+  emit_line(compiler, "int sage_argc; char** sage_argv;");
+  emit_line(compiler, "int main(int argc, char** argv) {");
+  emit_line(compiler, "    sage_argc = argc; sage_argv = argv;");
+  compiler->indent++;
+
+  if (target == COMPILER_TARGET_RP2040 || target == COMPILER_TARGET_RP2350_ARM || target == COMPILER_TARGET_RP2350_RISCV) {
+    emit_line(compiler, "stdio_init_all();");
+    emit_line(compiler, "sleep_ms(2000);");
+  }
 
-  /* Bind self */
-  NameEntry *self_entry = find_name_entry(compiler->locals, "self");
-  emit_line(compiler, "sage_define_slot(&%s, _self);", self_entry->c_name);
+  for (NameEntry *global = compiler->globals; global != NULL;
+       global = global->next) {
+    emit_line(compiler, "%s = sage_slot_undefined();", global->c_name);
+  }
+
+  /* Register classes and methods */
+  for (ClassInfo *cls = compiler->classes; cls != NULL; cls = cls->next) {
+    if (cls->parent_name) {
+      emit_line(compiler, "sage_register_class(\"%s\", \"%s\");",
+                cls->class_name, cls->parent_name);
+    } else {
+      emit_line(compiler, "sage_register_class(\"%s\", NULL);",
+                cls->class_name);
+    }
+    for (Stmt *method = cls->methods; method != NULL; method = method->next) {
+      if (method->type == STMT_PROC) {
+        char *mname = token_to_string(method->as.proc.name);
+        emit_line(compiler,
+                  "sage_register_method(\"%s\", \"%s\", sage_method_%s_%s);",
+                  cls->class_name, mname, cls->class_name, mname);
+        free(mname);
+      }
+    }
+  }
+
+  for (Stmt *stmt = program; stmt != NULL; stmt = stmt->next) {
+    if (stmt->type != STMT_PROC && stmt->type != STMT_ASYNC_PROC &&
+        stmt->type != STMT_CLASS) {
+      emit_stmt(compiler, stmt);
+      if (compiler->failed) {
+        compiler->indent--;
+        emit_line(compiler, "return 1;");
+        emit_line(compiler, "}");
+        return;
+      }
+    }
+  }
+
+  emit_line(compiler, "sage_gc_shutdown();");
+  emit_line(compiler, "return 0;");
+  compiler->indent--;
+  emit_line(compiler, "}");
+}
+
+Stmt *parse_program(const char *source, const char *input_path) {
+  // A private Parser context leaves any parse in progress on this thread
+  // (e.g. the script calling vm.compile) untouched.
+  Parser parser;
+  parser_open(&parser, source, input_path, false);
+  return parser_parse_all(&parser, NULL);
+}
+
+static int path_exists(const char *path) { return access(path, F_OK) == 0; }
+
+static int ensure_directory(const char *path) {
+  char buffer[PATH_MAX];
+  size_t len = strlen(path);
+  if (len == 0 || len >= sizeof(buffer)) {
+    fprintf(stderr, "Compiler error: invalid output directory path.\n");
+    return 0;
+  }
+
+  memcpy(buffer, path, len + 1);
+  if (len > 1 && buffer[len - 1] == '/') {
+    buffer[len - 1] = '\0';
+  }
+
+  for (char *cursor = buffer + 1; *cursor != '\0'; cursor++) {
+    if (*cursor == '/') {
+      *cursor = '\0';
+      if (mkdir(buffer, 0777) != 0 && errno != EEXIST) {
+        fprintf(stderr,
+                "Compiler error: could not create directory \"%s\": %s\n",
+                buffer, strerror(errno));
+        return 0;
+      }
+      *cursor = '/';
+    }
+  }
+
+  if (mkdir(buffer, 0777) != 0 && errno != EEXIST) {
+    fprintf(stderr, "Compiler error: could not create directory \"%s\": %s\n",
+            buffer, strerror(errno));
+    return 0;
+  }
+
+  return 1;
+}
+
+static char *path_join(const char *left, const char *right) {
+  size_t left_len = strlen(left);
+  size_t right_len = strlen(right);
+  int needs_sep = left_len > 0 && left[left_len - 1] != '/';
+  char *joined = malloc(left_len + right_len + (needs_sep ? 2 : 1));
+  if (joined == NULL) {
+    fprintf(stderr, "Out of memory joining compiler paths.\n");
+    exit(1);
+  }
+
+  memcpy(joined, left, left_len);
+  if (needs_sep) {
+    joined[left_len++] = '/';
+  }
+  memcpy(joined + left_len, right, right_len + 1);
+  return joined;
+}
+
+static char *derive_program_name(const char *input_path) {
+  const char *basename = strrchr(input_path, '/');
+  basename = basename == NULL ? input_path : basename + 1;
+
+  size_t len = strlen(basename);
+  const char *last_dot = strrchr(basename, '.');
+  if (last_dot != NULL) {
+    len = (size_t)(last_dot - basename);
+  }
+
+  char *raw_name = malloc(len + 1);
+  if (raw_name == NULL) {
+    fprintf(stderr, "Out of memory deriving Pico program name.\n");
+    exit(1);
+  }
+  memcpy(raw_name, basename, len);
+  raw_name[len] = '\0';
+
+  char *sanitized = sanitize_identifier(raw_name);
+  free(raw_name);
+  if (sanitized[0] == '\0') {
+    free(sanitized);
+    return str_dup("sage_program");
+  }
+  return sanitized;
+}
+
+static char *escape_cmake_string(const char *text) {
+  StringBuffer sb;
+  sb_init(&sb);
+
+  for (size_t i = 0; text[i] != '\0'; i++) {
+    if (text[i] == '\\' || text[i] == '"' || text[i] == ';') {
+      sb_append_char(&sb, '\\');
+    }
+    sb_append_char(&sb, text[i]);
+  }
+
+  return sb_take(&sb);
+}
+
+static char *find_repo_root(void) {
+  char cwd[PATH_MAX];
+  if (getcwd(cwd, sizeof(cwd)) == NULL) {
+    return NULL;
+  }
+
+  char current[PATH_MAX];
+  memcpy(current, cwd, sizeof(current));
+
+  while (1) {
+    char *candidate = path_join(current, "pico_sdk_import.cmake");
+    int found = path_exists(candidate);
+    free(candidate);
+    if (found) {
+      return str_dup(current);
+    }
+
+    char *slash = strrchr(current, '/');
+    if (slash == NULL) {
+      break;
+    }
+    if (slash == current) {
+      current[1] = '\0';
+    } else {
+      *slash = '\0';
+    }
+
+    candidate = path_join(current, "pico_sdk_import.cmake");
+    found = path_exists(candidate);
+    free(candidate);
+    if (found) {
+      return str_dup(current);
+    }
+
+    if (strcmp(current, "/") == 0) {
+      break;
+    }
+  }
+
+  return NULL;
+}
+
+static int write_pico_cmake_lists(const char *cmake_path,
+                                  const char *import_path,
+                                  const char *source_path,
+                                  const char *program_name,
+                                  const char *pico_board) {
+  FILE *out = fopen(cmake_path, "wb");
+  if (out == NULL) {
+    fprintf(stderr, "Compiler error: could not open \"%s\": %s\n", cmake_path,
+            strerror(errno));
+    return 0;
+  }
+
+  char *escaped_import = escape_cmake_string(import_path);
+  char *escaped_source = escape_cmake_string(source_path);
+  char *escaped_program = escape_cmake_string(program_name);
+  char *escaped_board = escape_cmake_string(pico_board);
+
+  fprintf(out,
+          "cmake_minimum_required(VERSION 3.13)\n"
+          "set(PICO_BOARD \"%s\" CACHE STRING \"RP2040 board\")\n"
+          "include(\"%s\")\n"
+          "project(%s LANGUAGES C CXX ASM)\n"
+          "set(CMAKE_C_STANDARD 11)\n"
+          "set(CMAKE_CXX_STANDARD 17)\n"
+          "pico_sdk_init()\n"
+          "add_executable(%s \"%s\")\n"
+          "target_link_libraries(%s pico_stdlib)\n"
+          "pico_enable_stdio_usb(%s 1)\n"
+          "pico_enable_stdio_uart(%s 0)\n"
+          "pico_add_extra_outputs(%s)\n",
+          escaped_board, escaped_import, escaped_program, escaped_program,
+          escaped_source, escaped_program, escaped_program, escaped_program,
+          escaped_program);
+
+  free(escaped_import);
+  free(escaped_source);
+  free(escaped_program);
+  free(escaped_board);
+
+  fclose(out);
+  return 1;
+}
+
+static int run_command_with_sdk(char *const argv[], const char *pico_sdk_path) {
+  pid_t pid = fork();
+  if (pid < 0) {
+    fprintf(stderr, "Compiler error: could not fork %s.\n", argv[0]);
+    return 0;
+  }
+
+  if (pid == 0) {
+    if (pico_sdk_path != NULL && pico_sdk_path[0] != '\0') {
+      setenv("PICO_SDK_PATH", pico_sdk_path, 1);
+    }
+    execvp(argv[0], argv);
+    fprintf(stderr, "Compiler error: could not execute %s: %s\n", argv[0],
+            strerror(errno));
+    _exit(127);
+  }
 
-  /* Bind params from argv */
-  int argv_idx = 0;
-  for (int i = param_start; i < proc->param_count; i++) {
-    char *pname = token_to_string(proc->params[i]);
-    NameEntry *entry = find_name_entry(compiler->locals, pname);
-    emit_line(compiler, "sage_define_slot(&%s, _argv[%d]);", entry->c_name,
-              argv_idx++);
-    free(pname);
+  int status = 0;
+  if (waitpid(pid, &status, 0) < 0) {
+    fprintf(stderr, "Compiler error: could not wait for %s.\n", argv[0]);
+    return 0;
   }
 
-  emit_line(compiler, "(void)_argc;");
+  return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
 
-  compiler->in_function_body = 1;
-  emit_stmt_list(compiler, proc->body);
-  compiler->in_function_body = 0;
-  emit_line(compiler, "return sage_gc_return(&sage_gc_frame, sage_nil());");
+// Parses and optimizes the program and collects every symbol it and its
+// imports declare. The caller owns the AST arena.
+static Stmt *compiler_load_program(Compiler *compiler, const char *source,
+                                   const char *input_path, int opt_level,
+                                   int debug_info, int modular) {
+  memset(compiler, 0, sizeof(*compiler));
+  compiler->input_path = input_path;
+  compiler->next_unique_id = 1;
+  compiler->profile = profile_active();
+  compiler->modular = modular;
 
-  compiler->indent--;
-  emit_line(compiler, "}");
-  fputc('\n', compiler->out);
+  Stmt *program = parse_program(source, input_path);
 
-  free_name_entries(compiler->locals);
-  compiler->locals = previous_locals;
-  compiler->current_class = previous_class;
-  free(method_name);
+  // Run optimization passes if requested
+  if (opt_level > 0) {
+    PassContext pass_ctx;
+    pass_ctx.opt_level = opt_level;
+    pass_ctx.debug_info = debug_info;
+    pass_ctx.verbose = 0;
+    pass_ctx.input_path = input_path;
+    pass_ctx.profile = profile_active();
+    program = run_passes(program, &pass_ctx);
+  }
+
+  collect_top_level_symbols(compiler, program);
+  return program;
 }
 
-static void emit_method_prototypes(Compiler *compiler) {
-  for (ClassInfo *cls = compiler->classes; cls != NULL; cls = cls->next) {
-    for (Stmt *method = cls->methods; method != NULL; method = method->next) {
-      if (method->type == STMT_PROC) {
-        char *method_name = token_to_string(method->as.proc.name);
-        emit_indent(compiler);
-        fprintf(compiler->out,
-                "static SageValue sage_method_%s_%s(SageValue _self, int "
-                "_argc, SageValue* _argv);\n",
-                cls->class_name, method_name);
-        free(method_name);
-      }
-    }
-  }
+static void compiler_release(Compiler *compiler) {
+  free_name_entries(compiler->globals);
+  free_proc_entries(compiler->procs);
+  free_class_info(compiler->classes);
+  free_imported_modules(compiler->modules);
 }
 
-static void emit_function_definitions(Compiler *compiler, Stmt *program) {
-  /* Emit module functions first */
-  for (ImportedModule *m = compiler->modules; m != NULL; m = m->next) {
-    for (Stmt *stmt = m->ast; stmt != NULL; stmt = stmt->next) {
-      if (stmt->type == STMT_PROC || stmt->type == STMT_ASYNC_PROC) {
-        emit_function_definition(compiler, stmt);
-        if (compiler->failed)
-          return;
-      }
-    }
+static int write_c_output_internal(const char *source, const char *input_path,
+                                   const char *output_path,
+                                   CompilerTarget target, int opt_level,
+                                   int debug_info) {
+  FILE *out = fopen(output_path, "wb");
+  if (out == NULL) {
+    fprintf(stderr, "Could not open compiler output \"%s\": %s\n", output_path,
+            strerror(errno));
+    return 0;
   }
 
-  /* Emit class methods */
-  for (ClassInfo *cls = compiler->classes; cls != NULL; cls = cls->next) {
-    for (Stmt *method = cls->methods; method != NULL; method = method->next) {
-      if (method->type == STMT_PROC) {
-        emit_method_definition(compiler, cls, method);
-        if (compiler->failed)
-          return;
-      }
-    }
-  }
+  // The whole unit (imported modules included) lives in one arena and is
+  // released in one go once the C file is written.
+  AstArena *arena = ast_arena_begin();
+  Compiler compiler;
+  Stmt *program = compiler_load_program(&compiler, source, input_path,
+                                        opt_level, debug_info, 0);
+  compiler.out = out;
 
-  /* Emit main program functions */
-  for (Stmt *stmt = program; stmt != NULL; stmt = stmt->next) {
-    if (stmt->type == STMT_PROC || stmt->type == STMT_ASYNC_PROC) {
-      emit_function_definition(compiler, stmt);
-      if (compiler->failed) {
-        return;
-      }
+  if (!compiler.failed) {
+    emit_runtime_prelude(out, target, RUNTIME_STATE_PRIVATE);
+    compiler.indent = 0;
+    emit_proc_prototypes(&compiler);
+    emit_method_prototypes(&compiler);
+    if (compiler.procs != NULL || compiler.classes != NULL) {
+      fputc('\n', out);
+    }
+    emit_program_globals(&compiler);
+    emit_function_definitions(&compiler, program);
+    if (!compiler.failed) {
+      emit_main_function(&compiler, program, target);
     }
   }
+
+  fclose(out);
+  compiler_release(&compiler);
+  ast_arena_end(arena);
+  return compiler.failed ? 0 : 1;
 }
 
-static void emit_main_function(Compiler *compiler, Stmt *program,
-                               CompilerTarget target) {
-  emit_line(compiler, "int sage_argc; char** sage_argv;");
-  emit_line(compiler, "int main(int argc, char** argv) {");
-  emit_line(compiler, "    sage_argc = argc; sage_argv = argv;");
-  compiler->indent++;
+// ============================================================================
+// Modular builds
+// ============================================================================
+//
+// `--compile` emits one C unit for the runtime, one per imported module and
+// one for the program itself, compiles them in parallel into a
+// content-addressed object cache and links the result. A unit's text depends
+// only on its own module and the names it references, so an edit to one
+// module rebuilds one object; the runtime unit is shared by every program.
 
-  if (target == COMPILER_TARGET_RP2040 || target == COMPILER_TARGET_RP2350_ARM || target == COMPILER_TARGET_RP2350_RISCV) {
-    emit_line(compiler, "stdio_init_all();");
-    emit_line(compiler, "sleep_ms(2000);");
+int g_compile_jobs = 0;
+const char *g_compile_cache_dir = NULL;
+
+typedef struct {
+  char *name;  // module name; "main" for the program's own unit
+  char *text;  // complete C source of the unit
+  size_t length;
+} CompiledUnit;
+
+static int is_identifier_char(char ch) {
+  return isalnum((unsigned char)ch) || ch == '_';
+}
+
+static ProcEntry *find_proc_by_c_name(Compiler *compiler, const char *c_name) {
+  for (ProcEntry *proc = compiler->procs; proc != NULL; proc = proc->next) {
+    if (strcmp(proc->c_name, c_name) == 0) {
+      return proc;
+    }
   }
+  return NULL;
+}
 
+static NameEntry *find_global_by_c_name(Compiler *compiler,
+                                        const char *c_name) {
   for (NameEntry *global = compiler->globals; global != NULL;
        global = global->next) {
-    emit_line(compiler, "%s = sage_slot_undefined();", global->c_name);
+    if (strcmp(global->c_name, c_name) == 0) {
+      return global;
+    }
   }
-  emit_slot_frame_setup(compiler, compiler->globals, "sage_gc_global_roots",
-                        "sage_gc_main_frame");
+  return NULL;
+}
 
-  /* Register classes and methods */
+static int is_method_symbol(Compiler *compiler, const char *symbol) {
+  const char *rest = symbol + strlen("sage_method_");
   for (ClassInfo *cls = compiler->classes; cls != NULL; cls = cls->next) {
-    if (cls->parent_name) {
-      emit_line(compiler, "sage_register_class(\"%s\", \"%s\");",
-                cls->class_name, cls->parent_name);
-    } else {
-      emit_line(compiler, "sage_register_class(\"%s\", NULL);",
-                cls->class_name);
+    size_t class_len = strlen(cls->class_name);
+    if (strncmp(rest, cls->class_name, class_len) != 0 ||
+        rest[class_len] != '_') {
+      continue;
     }
+    const char *method_name = rest + class_len + 1;
     for (Stmt *method = cls->methods; method != NULL; method = method->next) {
-      if (method->type == STMT_PROC) {
-        char *mname = token_to_string(method->as.proc.name);
-        emit_line(compiler,
-                  "sage_register_method(\"%s\", \"%s\", sage_method_%s_%s);",
-                  cls->class_name, mname, cls->class_name, mname);
-        free(mname);
+      if (method->type == STMT_PROC &&
+          (size_t)method->as.proc.name.length == strlen(method_name) &&
+          strncmp(method->as.proc.name.start, method_name,
+                  (size_t)method->as.proc.name.length) == 0) {
+        return 1;
       }
     }
   }
+  return 0;
+}
 
-  for (Stmt *stmt = program; stmt != NULL; stmt = stmt->next) {
-    if (stmt->type != STMT_PROC && stmt->type != STMT_ASYNC_PROC &&
-        stmt->type != STMT_CLASS) {
-      emit_stmt(compiler, stmt);
-      if (compiler->failed) {
-        compiler->indent--;
-        emit_line(compiler, "return 1;");
-        emit_line(compiler, "}");
-        return;
-      }
+static void emit_symbol_declaration(Compiler *compiler, const char *symbol,
+                                    int extern_globals) {
+  if (strncmp(symbol, "sage_fn__", 9) == 0) {
+    ProcEntry *proc = find_proc_by_c_name(compiler, symbol);
+    if (proc != NULL) {
+      emit_proc_prototype(compiler, proc);
+    }
+  } else if (strncmp(symbol, "sage_global__", 13) == 0) {
+    if (extern_globals && find_global_by_c_name(compiler, symbol) != NULL) {
+      emit_line(compiler, "extern SageSlot %s;", symbol);
+    }
+  } else if (strncmp(symbol, "sage_method_", 12) == 0) {
+    if (is_method_symbol(compiler, symbol)) {
+      emit_line(compiler,
+                "SageValue %s(SageValue _self, int _argc, SageValue* _argv);",
+                symbol);
     }
   }
-
-  emit_line(compiler, "sage_gc_pop_frame(&sage_gc_main_frame);");
-  emit_line(compiler, "sage_gc_shutdown();");
-  emit_line(compiler, "return 0;");
-  compiler->indent--;
-  emit_line(compiler, "}");
 }
 
-Stmt *parse_program(const char *source, const char *input_path) {
-  init_lexer(source, input_path);
-  parser_init();
-
-  Stmt *head = NULL;
-  Stmt *tail = NULL;
-
-  while (1) {
-    Stmt *stmt = parse();
-    if (stmt == NULL) {
-      break;
+// Declares the shared symbols `body` refers to, in order of first use.
+// Listing only what is referenced keeps a unit's text (and so its cache key)
+// independent of declarations elsewhere in the program.
+static void emit_unit_declarations(Compiler *compiler, const char *body,
+                                   int extern_globals) {
+  NameEntry *seen = NULL;
+  const char *cursor = body;
+  while (*cursor != '\0') {
+    if (!is_identifier_char(*cursor)) {
+      cursor++;
+      continue;
+    }
+    const char *start = cursor;
+    while (is_identifier_char(*cursor)) {
+      cursor++;
+    }
+    if (strncmp(start, "sage_fn__", 9) != 0 &&
+        strncmp(start, "sage_global__", 13) != 0 &&
+        strncmp(start, "sage_method_", 12) != 0) {
+      continue;
     }
 
-    if (head == NULL) {
-      head = stmt;
-    } else {
-      tail->next = stmt;
+    size_t len = (size_t)(cursor - start);
+    char *symbol = malloc(len + 1);
+    NameEntry *entry = malloc(sizeof(NameEntry));
+    if (symbol == NULL || entry == NULL) {
+      fprintf(stderr, "Out of memory scanning compiler unit.\n");
+      exit(1);
+    }
+    memcpy(symbol, start, len);
+    symbol[len] = '\0';
+    if (find_name_entry(seen, symbol) != NULL) {
+      free(symbol);
+      free(entry);
+      continue;
     }
-    tail = stmt;
+    entry->sage_name = symbol;
+    entry->c_name = NULL;
+    entry->module = NULL;
+    entry->next = seen;
+    seen = entry;
+    emit_symbol_declaration(compiler, symbol, extern_globals);
   }
-
-  return head;
+  free_name_entries(seen);
 }
 
-static int path_exists(const char *path) { return access(path, F_OK) == 0; }
-
-static int ensure_directory(const char *path) {
-  char buffer[PATH_MAX];
-  size_t len = strlen(path);
-  if (len == 0 || len >= sizeof(buffer)) {
-    fprintf(stderr, "Compiler error: invalid output directory path.\n");
-    return 0;
-  }
-
-  memcpy(buffer, path, len + 1);
-  if (len > 1 && buffer[len - 1] == '/') {
-    buffer[len - 1] = '\0';
-  }
-
-  for (char *cursor = buffer + 1; *cursor != '\0'; cursor++) {
-    if (*cursor == '/') {
-      *cursor = '\0';
-      if (mkdir(buffer, 0777) != 0 && errno != EEXIST) {
-        fprintf(stderr,
-                "Compiler error: could not create directory \"%s\": %s\n",
-                buffer, strerror(errno));
-        return 0;
+// Skips a brace-delimited C block starting at `cursor`, stepping over string
+// and character literals and comments. Returns the position after the `}`.
+static const char *skip_c_block(const char *cursor) {
+  int depth = 0;
+  while (*cursor != '\0') {
+    char ch = *cursor;
+    if (ch == '"' || ch == '\'') {
+      cursor++;
+      while (*cursor != '\0' && *cursor != ch) {
+        if (*cursor == '\\' && cursor[1] != '\0') {
+          cursor++;
+        }
+        cursor++;
       }
-      *cursor = '/';
+    } else if (ch == '/' && cursor[1] == '/') {
+      while (*cursor != '\0' && *cursor != '\n') {
+        cursor++;
+      }
+      continue;
+    } else if (ch == '/' && cursor[1] == '*') {
+      const char *end = strstr(cursor + 2, "*/");
+      cursor = end != NULL ? end + 1 : cursor + strlen(cursor) - 1;
+    } else if (ch == '{') {
+      depth++;
+    } else if (ch == '}' && --depth == 0) {
+      return cursor + 1;
+    }
+    if (*cursor != '\0') {
+      cursor++;
     }
   }
-
-  if (mkdir(buffer, 0777) != 0 && errno != EEXIST) {
-    fprintf(stderr, "Compiler error: could not create directory \"%s\": %s\n",
-            buffer, strerror(errno));
-    return 0;
-  }
-
-  return 1;
+  return cursor;
 }
 
-static char *path_join(const char *left, const char *right) {
-  size_t left_len = strlen(left);
-  size_t right_len = strlen(right);
-  int needs_sep = left_len > 0 && left[left_len - 1] != '/';
-  char *joined = malloc(left_len + right_len + (needs_sep ? 2 : 1));
-  if (joined == NULL) {
-    fprintf(stderr, "Out of memory joining compiler paths.\n");
-    exit(1);
-  }
-
-  memcpy(joined, left, left_len);
-  if (needs_sep) {
-    joined[left_len++] = '/';
+// Turns the runtime prelude into the header every non-runtime unit starts
+// with: types, macros and inline fast paths are kept, SAGE_RUNTIME function
+// definitions become prototypes.
+static char *runtime_declarations(const char *prelude) {
+  StringBuffer sb;
+  sb_init(&sb);
+  const char *line = prelude;
+  while (*line != '\0') {
+    const char *end = strchr(line, '\n');
+    end = end != NULL ? end + 1 : line + strlen(line);
+    if (strncmp(line, "SAGE_RUNTIME ", 13) == 0) {
+      const char *brace = line + strcspn(line, "{;");
+      if (*brace == '{') {
+        const char *sig_end = brace;
+        while (sig_end > line && isspace((unsigned char)sig_end[-1])) {
+          sig_end--;
+        }
+        sb_reserve(&sb, (size_t)(sig_end - line) + 2);
+        memcpy(sb.data + sb.len, line, (size_t)(sig_end - line));
+        sb.len += (size_t)(sig_end - line);
+        sb.data[sb.len] = '\0';
+        sb_append(&sb, ";\n");
+        const char *after = skip_c_block(brace);
+        end = strchr(after, '\n');
+        end = end != NULL ? end + 1 : after + strlen(after);
+        line = end;
+        continue;
+      }
+    }
+    size_t len = (size_t)(end - line);
+    sb_reserve(&sb, len);
+    memcpy(sb.data + sb.len, line, len);
+    sb.len += len;
+    sb.data[sb.len] = '\0';
+    line = end;
   }
-  memcpy(joined + left_len, right, right_len + 1);
-  return joined;
+  return sb_take(&sb);
 }
 
-static char *derive_program_name(const char *input_path) {
-  const char *basename = strrchr(input_path, '/');
-  basename = basename == NULL ? input_path : basename + 1;
-
-  size_t len = strlen(basename);
-  const char *last_dot = strrchr(basename, '.');
-  if (last_dot != NULL) {
-    len = (size_t)(last_dot - basename);
+// Emits the definitions that belong to one unit: the classes and procedures
+// declared at the top level of `stmts`, plus main() for the program unit.
+static void emit_unit_body(Compiler *compiler, Stmt *stmts, int is_main,
+                           CompilerTarget target) {
+  for (Stmt *stmt = stmts; stmt != NULL && !compiler->failed;
+       stmt = stmt->next) {
+    if (stmt->type != STMT_CLASS) {
+      continue;
+    }
+    char *class_name = token_to_string(stmt->as.class_stmt.name);
+    ClassInfo *cls = find_class_info(compiler->classes, class_name);
+    free(class_name);
+    // A same-named class from another module keeps the first definition.
+    if (cls == NULL || cls->methods != stmt->as.class_stmt.methods) {
+      continue;
+    }
+    for (Stmt *method = cls->methods; method != NULL && !compiler->failed;
+         method = method->next) {
+      if (method->type == STMT_PROC) {
+        emit_method_definition(compiler, cls, method);
+      }
+    }
   }
 
-  char *raw_name = malloc(len + 1);
-  if (raw_name == NULL) {
-    fprintf(stderr, "Out of memory deriving Pico program name.\n");
-    exit(1);
+  for (Stmt *stmt = stmts; stmt != NULL && !compiler->failed;
+       stmt = stmt->next) {
+    if (stmt->type == STMT_PROC || stmt->type == STMT_ASYNC_PROC) {
+      emit_function_definition(compiler, stmt);
+    }
   }
-  memcpy(raw_name, basename, len);
-  raw_name[len] = '\0';
 
-  char *sanitized = sanitize_identifier(raw_name);
-  free(raw_name);
-  if (sanitized[0] == '\0') {
-    free(sanitized);
-    return str_dup("sage_program");
+  if (is_main && !compiler->failed) {
+    emit_main_function(compiler, stmts, target);
   }
-  return sanitized;
 }
 
-static char *escape_cmake_string(const char *text) {
-  StringBuffer sb;
-  sb_init(&sb);
+static int emit_unit(Compiler *compiler, CompiledUnit *unit, const char *name,
+                     Stmt *stmts, int is_main, CompilerTarget target,
+                     const char *header) {
+  char *body = NULL;
+  size_t body_len = 0;
+  FILE *body_out = open_memstream(&body, &body_len);
+  if (body_out == NULL) {
+    fprintf(stderr, "Compiler error: could not buffer unit \"%s\".\n", name);
+    return 0;
+  }
+  // Local names restart in every unit so they do not shift when an
+  // unrelated unit grows.
+  compiler->out = body_out;
+  compiler->indent = 0;
+  compiler->next_unique_id = 1;
+  compiler->current_module = is_main ? NULL : name;
+  emit_unit_body(compiler, stmts, is_main, target);
+  compiler->current_module = NULL;
+  fclose(body_out);
+  if (compiler->failed) {
+    free(body);
+    return 0;
+  }
 
-  for (size_t i = 0; text[i] != '\0'; i++) {
-    if (text[i] == '\\' || text[i] == '"' || text[i] == ';') {
-      sb_append_char(&sb, '\\');
-    }
-    sb_append_char(&sb, text[i]);
+  FILE *out = open_memstream(&unit->text, &unit->length);
+  if (out == NULL) {
+    fprintf(stderr, "Compiler error: could not buffer unit \"%s\".\n", name);
+    free(body);
+    return 0;
+  }
+  fputs(header, out);
+  compiler->out = out;
+  emit_unit_declarations(compiler, body, !is_main);
+  fputc('\n', out);
+  if (is_main) {
+    emit_program_globals(compiler);
   }
+  fwrite(body, 1, body_len, out);
+  fclose(out);
+  free(body);
 
-  return sb_take(&sb);
+  unit->name = sanitize_identifier(name);
+  return 1;
 }
 
-static char *find_repo_root(void) {
-  char cwd[PATH_MAX];
-  if (getcwd(cwd, sizeof(cwd)) == NULL) {
-    return NULL;
+static void free_compiled_units(CompiledUnit *units, int count) {
+  for (int i = 0; i < count; i++) {
+    free(units[i].name);
+    free(units[i].text);
   }
+  free(units);
+}
 
-  char current[PATH_MAX];
-  memcpy(current, cwd, sizeof(current));
+static int emit_modular_units(const char *source, const char *input_path,
+                              CompilerTarget target, int opt_level,
+                              int debug_info, CompiledUnit **units_out,
+                              int *count_out) {
+  AstArena *arena = ast_arena_begin();
+  Compiler compiler;
+  Stmt *program = compiler_load_program(&compiler, source, input_path,
+                                        opt_level, debug_info, 1);
 
-  while (1) {
-    char *candidate = path_join(current, "pico_sdk_import.cmake");
-    int found = path_exists(candidate);
-    free(candidate);
-    if (found) {
-      return str_dup(current);
+  int capacity = 2;
+  for (ImportedModule *m = compiler.modules; m != NULL; m = m->next) {
+    capacity++;
+  }
+  CompiledUnit *units = calloc((size_t)capacity, sizeof(CompiledUnit));
+  if (units == NULL) {
+    fprintf(stderr, "Out of memory allocating compiler units.\n");
+    exit(1);
+  }
+
+  // The runtime unit comes first and the program's own unit last.
+  int count = 0;
+  char *header = NULL;
+  if (!compiler.failed) {
+    char *prelude = NULL;
+    size_t prelude_len = 0;
+    FILE *runtime_out = open_memstream(&units[0].text, &units[0].length);
+    FILE *prelude_out = open_memstream(&prelude, &prelude_len);
+    if (runtime_out == NULL || prelude_out == NULL) {
+      fprintf(stderr, "Compiler error: could not buffer the runtime unit.\n");
+      exit(1);
     }
+    emit_runtime_prelude(runtime_out, target, RUNTIME_STATE_DEFINE);
+    emit_runtime_prelude(prelude_out, target, RUNTIME_STATE_EXTERN);
+    fclose(runtime_out);
+    fclose(prelude_out);
+    units[count++].name = str_dup("sage_runtime");
+    header = runtime_declarations(prelude);
+    free(prelude);
+  }
 
-    char *slash = strrchr(current, '/');
-    if (slash == NULL) {
-      break;
+  for (ImportedModule *m = compiler.modules; m != NULL && !compiler.failed;
+       m = m->next) {
+    if (m->ast == NULL) {
+      continue;  // native module, provided by the runtime
     }
-    if (slash == current) {
-      current[1] = '\0';
-    } else {
-      *slash = '\0';
+    if (emit_unit(&compiler, &units[count], m->name, m->ast, 0, target,
+                  header)) {
+      count++;
     }
+  }
+  if (!compiler.failed && emit_unit(&compiler, &units[count], "main", program,
+                                    1, target, header)) {
+    count++;
+  }
+  free(header);
 
-    candidate = path_join(current, "pico_sdk_import.cmake");
-    found = path_exists(candidate);
-    free(candidate);
-    if (found) {
-      return str_dup(current);
-    }
+  int ok = !compiler.failed;
+  compiler_release(&compiler);
+  ast_arena_end(arena);
+  if (!ok) {
+    free_compiled_units(units, count);
+    return 0;
+  }
+  *units_out = units;
+  *count_out = count;
+  return 1;
+}
 
-    if (strcmp(current, "/") == 0) {
-      break;
+static uint64_t fnv1a64_update(uint64_t hash, const void *data,
+                               size_t length) {
+  const unsigned char *bytes = data;
+  for (size_t i = 0; i < length; i++) {
+    hash ^= bytes[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+// What an object built by `cc` depends on besides its own unit: the
+// compiler's --version banner, so upgrading or swapping the compiler behind
+// the same command rebuilds, and the Sage release plus the runtime unit that
+// every object is linked against.
+static uint64_t object_toolchain_key(const char *cc,
+                                     const CompiledUnit *runtime) {
+  uint64_t key = fnv1a64_update(14695981039346656037ULL, cc, strlen(cc) + 1);
+  key = fnv1a64_update(key, SAGE_VERSION_STR, sizeof(SAGE_VERSION_STR));
+  key = fnv1a64_update(key, runtime->text, runtime->length);
+
+  int fds[2];
+  if (pipe(fds) != 0) {
+    return key;
+  }
+  pid_t pid = fork();
+  if (pid == 0) {
+    dup2(fds[1], STDOUT_FILENO);
+    dup2(fds[1], STDERR_FILENO);
+    close(fds[0]);
+    close(fds[1]);
+    execlp(cc, cc, "--version", (char *)NULL);
+    _exit(127);
+  }
+  close(fds[1]);
+  if (pid > 0) {
+    char buffer[4096];
+    ssize_t n;
+    while ((n = read(fds[0], buffer, sizeof(buffer))) > 0) {
+      key = fnv1a64_update(key, buffer, (size_t)n);
     }
+    waitpid(pid, NULL, 0);
   }
+  close(fds[0]);
+  return key;
+}
 
-  return NULL;
+// Objects live next to the parsed-module cache unless --cache-dir says
+// otherwise.
+static char *object_cache_dir(void) {
+  if (g_compile_cache_dir != NULL && g_compile_cache_dir[0] != '\0') {
+    return str_dup(g_compile_cache_dir);
+  }
+  const char *dir = getenv("SAGE_CACHE_DIR");
+  if (dir != NULL && dir[0] != '\0') {
+    return path_join(dir, "objects");
+  }
+  if ((dir = getenv("XDG_CACHE_HOME")) != NULL && dir[0] != '\0') {
+    return path_join(dir, "sage/objects");
+  }
+  if ((dir = getenv("HOME")) != NULL && dir[0] != '\0') {
+    return path_join(dir, ".cache/sage/objects");
+  }
+  return str_dup(".tmp/objects");
 }
 
-static int write_pico_cmake_lists(const char *cmake_path,
-                                  const char *import_path,
-                                  const char *source_path,
-                                  const char *program_name,
-                                  const char *pico_board) {
-  FILE *out = fopen(cmake_path, "wb");
+static int write_text_file(const char *path, const char *text, size_t length) {
+  FILE *out = fopen(path, "wb");
   if (out == NULL) {
-    fprintf(stderr, "Compiler error: could not open \"%s\": %s\n", cmake_path,
+    fprintf(stderr, "Could not open compiler output \"%s\": %s\n", path,
             strerror(errno));
     return 0;
   }
-
-  char *escaped_import = escape_cmake_string(import_path);
-  char *escaped_source = escape_cmake_string(source_path);
-  char *escaped_program = escape_cmake_string(program_name);
-  char *escaped_board = escape_cmake_string(pico_board);
-
-  fprintf(out,
-          "cmake_minimum_required(VERSION 3.13)\n"
-          "set(PICO_BOARD \"%s\" CACHE STRING \"RP2040 board\")\n"
-          "include(\"%s\")\n"
-          "project(%s LANGUAGES C CXX ASM)\n"
-          "set(CMAKE_C_STANDARD 11)\n"
-          "set(CMAKE_CXX_STANDARD 17)\n"
-          "pico_sdk_init()\n"
-          "add_executable(%s \"%s\")\n"
-          "target_link_libraries(%s pico_stdlib)\n"
-          "pico_enable_stdio_usb(%s 1)\n"
-          "pico_enable_stdio_uart(%s 0)\n"
-          "pico_add_extra_outputs(%s)\n",
-          escaped_board, escaped_import, escaped_program, escaped_program,
-          escaped_source, escaped_program, escaped_program, escaped_program,
-          escaped_program);
-
-  free(escaped_import);
-  free(escaped_source);
-  free(escaped_program);
-  free(escaped_board);
-
-  fclose(out);
-  return 1;
+  int ok = fwrite(text, 1, length, out) == length;
+  ok = fclose(out) == 0 && ok;
+  if (!ok) {
+    fprintf(stderr, "Could not write compiler output \"%s\".\n", path);
+  }
+  return ok;
 }
 
-static int run_command_with_sdk(char *const argv[], const char *pico_sdk_path) {
+static pid_t spawn_command(char *const argv[]) {
   pid_t pid = fork();
   if (pid < 0) {
-    fprintf(stderr, "Compiler error: could not fork %s.\n", argv[0]);
-    return 0;
+    fprintf(stderr, "Could not fork compiler process.\n");
+    return -1;
   }
-
   if (pid == 0) {
-    if (pico_sdk_path != NULL && pico_sdk_path[0] != '\0') {
-      setenv("PICO_SDK_PATH", pico_sdk_path, 1);
-    }
     execvp(argv[0], argv);
-    fprintf(stderr, "Compiler error: could not execute %s: %s\n", argv[0],
+    fprintf(stderr, "Could not execute C compiler \"%s\": %s\n", argv[0],
             strerror(errno));
     _exit(127);
   }
+  return pid;
+}
 
-  int status = 0;
-  if (waitpid(pid, &status, 0) < 0) {
-    fprintf(stderr, "Compiler error: could not wait for %s.\n", argv[0]);
+typedef struct {
+  char *source_path;
+  char *object_path;
+  char *temp_path;  // objects are renamed into place once complete
+  pid_t pid;
+} UnitBuild;
+
+static int build_modular_executable(CompiledUnit *units, int count,
+                                    const char *c_output_path,
+                                    const char *exe_output_path,
+                                    const char *cc, int opt_level,
+                                    int debug_info) {
+  const char *mode_flag = debug_info ? "-g" : (opt_level >= 2 ? "-O2" : NULL);
+  char *cache_dir = object_cache_dir();
+  if (!ensure_directory(cache_dir)) {
+    free(cache_dir);
     return 0;
   }
 
-  return WIFEXITED(status) && WEXITSTATUS(status) == 0;
-}
-
-static int write_c_output_internal(const char *source, const char *input_path,
-                                   const char *output_path,
-                                   CompilerTarget target, int opt_level,
-                                   int debug_info) {
-  FILE *out = fopen(output_path, "wb");
-  if (out == NULL) {
-    fprintf(stderr, "Could not open compiler output \"%s\": %s\n", output_path,
-            strerror(errno));
-    return 0;
+  UnitBuild *builds = calloc((size_t)count, sizeof(UnitBuild));
+  if (builds == NULL) {
+    fprintf(stderr, "Out of memory allocating compiler units.\n");
+    exit(1);
   }
 
-  Compiler compiler;
-  memset(&compiler, 0, sizeof(compiler));
-  compiler.out = out;
-  compiler.input_path = input_path;
-  compiler.next_unique_id = 1;
+  int ok = 1;
+  int pending = 0;
+  uint64_t toolchain = object_toolchain_key(cc, &units[0]);
+  for (int i = 0; i < count && ok; i++) {
+    CompiledUnit *unit = &units[i];
+    uint64_t key = fnv1a64_update(toolchain, unit->text, unit->length);
+    if (mode_flag != NULL) {
+      key = fnv1a64_update(key, mode_flag, strlen(mode_flag) + 1);
+    }
 
-  Stmt *program = parse_program(source, input_path);
+    char file_name[PATH_MAX];
+    snprintf(file_name, sizeof(file_name), "%.64s-%016llx.o", unit->name,
+             (unsigned long long)key);
+    builds[i].object_path = path_join(cache_dir, file_name);
+    builds[i].pid = -1;
 
-  // Run optimization passes if requested
-  if (opt_level > 0) {
-    PassContext pass_ctx;
-    pass_ctx.opt_level = opt_level;
-    pass_ctx.debug_info = debug_info;
-    pass_ctx.verbose = 0;
-    pass_ctx.input_path = input_path;
-    program = run_passes(program, &pass_ctx);
+    // The program's own unit is also written where the caller asked for the
+    // C output; module sources only need to exist while they compile.
+    int is_main = i == count - 1;
+    if (is_main) {
+      ok = write_text_file(c_output_path, unit->text, unit->length);
+    }
+    if (!ok || path_exists(builds[i].object_path)) {
+      continue;
+    }
+    if (is_main) {
+      builds[i].source_path = str_dup(c_output_path);
+    } else {
+      file_name[strlen(file_name) - 1] = 'c';
+      builds[i].source_path = path_join(cache_dir, file_name);
+      ok = write_text_file(builds[i].source_path, unit->text, unit->length);
+    }
+    snprintf(file_name, sizeof(file_name), "%s.%ld.tmp",
+             builds[i].object_path, (long)getpid());
+    builds[i].temp_path = str_dup(file_name);
+    pending++;
   }
 
-  collect_top_level_symbols(&compiler, program);
+  int jobs = g_compile_jobs;
+  if (jobs <= 0) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    jobs = cpus > 0 ? (int)cpus : 1;
+  }
 
-  if (!compiler.failed) {
-    emit_runtime_prelude(out, target);
-    compiler.indent = 0;
-    emit_proc_prototypes(&compiler);
-    emit_method_prototypes(&compiler);
-    if (compiler.procs != NULL || compiler.classes != NULL) {
-      fputc('\n', out);
+  int next = 0;
+  int running = 0;
+  while (ok && (next < count || running > 0)) {
+    if (next < count && running < jobs) {
+      UnitBuild *build = &builds[next++];
+      if (build->temp_path == NULL) {
+        continue;
+      }
+      char *argv[9];
+      int argc = 0;
+      argv[argc++] = (char *)cc;
+      argv[argc++] = "-std=c11";
+      argv[argc++] = "-fno-strict-aliasing";
+      if (mode_flag != NULL) {
+        argv[argc++] = (char *)mode_flag;
+      }
+      argv[argc++] = "-c";
+      argv[argc++] = build->source_path;
+      argv[argc++] = "-o";
+      argv[argc++] = build->temp_path;
+      argv[argc] = NULL;
+      build->pid = spawn_command(argv);
+      if (build->pid < 0) {
+        ok = 0;
+        break;
+      }
+      running++;
+      continue;
     }
-    emit_global_slots(&compiler);
-    if (compiler.globals != NULL) {
-      fputc('\n', out);
-      emit_mark_globals_function(&compiler);
-      fputc('\n', out);
-    } else {
-      fputs("void sage_gc_mark_program_globals(void) {}\n\n", out);
+
+    int status = 0;
+    pid_t done = waitpid(-1, &status, 0);
+    if (done < 0) {
+      fprintf(stderr, "Could not wait for C compiler \"%s\".\n", cc);
+      ok = 0;
+      break;
     }
-    emit_function_definitions(&compiler, program);
-    if (!compiler.failed) {
-      emit_main_function(&compiler, program, target);
+    for (int i = 0; i < count; i++) {
+      UnitBuild *build = &builds[i];
+      if (build->pid != done) {
+        continue;
+      }
+      build->pid = -1;
+      running--;
+      if (WIFEXITED(status) && WEXITSTATUS(status) == 0 &&
+          rename(build->temp_path, build->object_path) == 0) {
+        if (i < count - 1) {
+          unlink(build->source_path);
+        }
+      } else {
+        fprintf(stderr, "C compiler \"%s\" failed while building module "
+                        "\"%s\".\n",
+                cc, units[i].name);
+        unlink(build->temp_path);
+        ok = 0;
+      }
+      break;
+    }
+  }
+  // Let compiles already in flight finish before reporting a failure.
+  while (running > 0) {
+    int status = 0;
+    pid_t done = waitpid(-1, &status, 0);
+    if (done < 0) {
+      break;
+    }
+    for (int i = 0; i < count; i++) {
+      if (builds[i].pid == done) {
+        builds[i].pid = -1;
+        unlink(builds[i].temp_path);
+        running--;
+      }
     }
   }
 
-  fclose(out);
-  free_stmt(program);
-  free_name_entries(compiler.globals);
-  free_proc_entries(compiler.procs);
-  free_class_info(compiler.classes);
-  free_imported_modules(compiler.modules);
-  return compiler.failed ? 0 : 1;
+  if (ok) {
+    if (g_sage_verbose) {
+      fprintf(stderr, "Compiled %d of %d units (%d cached) with %d jobs\n",
+              pending, count, count - pending, jobs);
+    }
+    char **argv = calloc((size_t)count + 5, sizeof(char *));
+    if (argv == NULL) {
+      fprintf(stderr, "Out of memory building link command.\n");
+      exit(1);
+    }
+    int argc = 0;
+    argv[argc++] = (char *)cc;
+    for (int i = 0; i < count; i++) {
+      argv[argc++] = builds[i].object_path;
+    }
+    argv[argc++] = "-o";
+    argv[argc++] = (char *)exe_output_path;
+    argv[argc++] = "-lm";
+    argv[argc] = NULL;
+    if (!run_command_with_sdk(argv, NULL)) {
+      fprintf(stderr, "C compiler \"%s\" failed while linking \"%s\".\n", cc,
+              exe_output_path);
+      ok = 0;
+    }
+    free(argv);
+  }
+
+  for (int i = 0; i < count; i++) {
+    free(builds[i].source_path);
+    free(builds[i].object_path);
+    free(builds[i].temp_path);
+  }
+  free(builds);
+  free(cache_dir);
+  return ok;
 }
 
 int compile_source_to_c(const char *source, const char *input_path,
@@ -6120,40 +7546,8 @@ int compile_source_to_executable(const char *source, const char *input_path,
                                  const char *c_output_path,
                                  const char *exe_output_path,
                                  const char *cc_command) {
-  if (!write_c_output_internal(source, input_path, c_output_path,
-                               COMPILER_TARGET_HOST, 0, 0)) {
-    return 0;
-  }
-
-  const char *cc =
-      (cc_command != NULL && cc_command[0] != '\0') ? cc_command : "cc";
-  pid_t pid = fork();
-  if (pid < 0) {
-    fprintf(stderr, "Could not fork compiler process.\n");
-    return 0;
-  }
-
-  if (pid == 0) {
-    execlp(cc, cc, "-std=c11", "-fno-strict-aliasing", c_output_path, "-o", exe_output_path, "-lm",
-           (char *)NULL);
-    fprintf(stderr, "Could not execute C compiler \"%s\": %s\n", cc,
-            strerror(errno));
-    _exit(127);
-  }
-
-  int status = 0;
-  if (waitpid(pid, &status, 0) < 0) {
-    fprintf(stderr, "Could not wait for C compiler \"%s\".\n", cc);
-    return 0;
-  }
-
-  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
-    fprintf(stderr, "C compiler \"%s\" failed while building \"%s\".\n", cc,
-            exe_output_path);
-    return 0;
-  }
-
-  return 1;
+  return compile_source_to_executable_opt(source, input_path, c_output_path,
+                                          exe_output_path, cc_command, 0, 0);
 }
 
 int compile_source_to_executable_opt(const char *source, const char *input_path,
@@ -6161,50 +7555,20 @@ int compile_source_to_executable_opt(const char *source, const char *input_path,
                                      const char *exe_output_path,
                                      const char *cc_command, int opt_level,
                                      int debug_info) {
-  if (!write_c_output_internal(source, input_path, c_output_path,
-                               COMPILER_TARGET_HOST, opt_level, debug_info)) {
+  CompiledUnit *units = NULL;
+  int count = 0;
+  if (!emit_modular_units(source, input_path, COMPILER_TARGET_HOST, opt_level,
+                          debug_info, &units, &count)) {
     return 0;
   }
 
   const char *cc =
       (cc_command != NULL && cc_command[0] != '\0') ? cc_command : "cc";
-  pid_t pid = fork();
-  if (pid < 0) {
-    fprintf(stderr, "Could not fork compiler process.\n");
-    return 0;
-  }
-
-  if (pid == 0) {
-    if (debug_info) {
-      execlp(cc, cc, "-std=c11", "-g", "-fno-strict-aliasing", c_output_path, "-o", exe_output_path,
-             "-lm", (char *)NULL);
-    } else {
-      if (opt_level >= 2) {
-          execlp(cc, cc, "-std=c11", "-O2", "-fno-strict-aliasing", c_output_path, "-o", exe_output_path, "-lm",
-                 (char *)NULL);
-      } else {
-          execlp(cc, cc, "-std=c11", "-fno-strict-aliasing", c_output_path, "-o", exe_output_path, "-lm",
-                 (char *)NULL);
-      }
-    }
-    fprintf(stderr, "Could not execute C compiler \"%s\": %s\n", cc,
-            strerror(errno));
-    _exit(127);
-  }
-
-  int status = 0;
-  if (waitpid(pid, &status, 0) < 0) {
-    fprintf(stderr, "Could not wait for C compiler \"%s\".\n", cc);
-    return 0;
-  }
-
-  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
-    fprintf(stderr, "C compiler \"%s\" failed while building \"%s\".\n", cc,
-            exe_output_path);
-    return 0;
-  }
-
-  return 1;
+  int ok = build_modular_executable(units, count, c_output_path,
+                                    exe_output_path, cc, opt_level,
+                                    debug_info);
+  free_compiled_units(units, count);
+  return ok;
 }
 
 int compile_source_to_pico_c(const char *source, const char *input_path,
@@ -5,6 +5,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include "gc.h"
+#include "ast_arena.h"
 
 // ============================================================================
 // Constant Folding Pass
@@ -103,7 +104,7 @@ static Expr* fold_binary(Expr* expr) {
             size_t llen = strlen(ls);
             size_t rlen = strlen(rs);
             if (llen + rlen > 65536) return expr;  // too large to fold at compile time
-            char* concat = SAGE_ALLOC(llen + rlen + 1);
+            char* concat = ast_alloc(llen + rlen + 1);
             memcpy(concat, ls, llen);
             memcpy(concat + llen, rs, rlen + 1);
 
@@ -111,6 +111,15 @@ static void collect_used_names_expr(NameSet** used, const Expr* expr) {
             collect_used_names_expr(used, expr->as.get.object);
             break;
         case EXPR_SET:
+            if (expr->as.set.object == NULL) {
+                // `x = v` still needs the binding its let creates
+                int len = expr->as.set.property.length;
+                char* name = SAGE_ALLOC((size_t)len + 1);
+                memcpy(name, expr->as.set.property.start, (size_t)len);
+                name[len] = '\0';
+                nameset_add(used, name);
+                free(name);
+            }
             collect_used_names_expr(used, expr->as.set.object);
             collect_used_names_expr(used, expr->as.set.value);
             break;
@@ -283,7 +292,9 @@ static void dce_stmt_body(Stmt* stmt, NameSet* used) {
             stmt->as.for_stmt.body = dce_stmt_list(stmt->as.for_stmt.body, used);
             break;
         case STMT_CLASS:
-            stmt->as.class_stmt.methods = dce_stmt_list(stmt->as.class_stmt.methods, used);
+            // Methods are reached through dynamic dispatch, never by name: keep
+            // them all and only clean up their bodies
+            for (Stmt* m = stmt->as.class_stmt.methods; m != NULL; m = m->next) dce_stmt_body(m, used);
             break;
         case STMT_TRY:
             stmt->as.try_stmt.try_block = dce_stmt_list(stmt->as.try_stmt.try_block, used);
@@ -324,7 +324,11 @@ static size_t gc_release_object(GCHeader* header) {
         }
         case VAL_POINTER: {
             PointerValue* pv = object;
-            if (pv->ptr && pv->owned) { freed += pv->size; free(pv->ptr); }
+            if (pv->ptr && pv->owned) {
+                freed += pv->size;
+                if (pv->finalize) pv->finalize(pv->ptr);
+                else free(pv->ptr);
+            }
             break;
         }
         case VAL_VM_PROGRAM: {
@@ -346,7 +350,9 @@ static size_t gc_release_object(GCHeader* header) {
         }
         case VAL_BYTES: {
             BytesValue* b = object;
-            if (b->data) {
+            if (b->mapped) {
+                bytes_unmap(b);
+            } else if (b->data) {
                 freed += (size_t)b->capacity;
                 free(b->data);
             }
@@ -411,6 +417,15 @@ void gc_shutdown(void) {
 void gc_pin(void) { gc.pin_count++; }
 void gc_unpin(void) { if (gc.pin_count > 0) gc.pin_count--; }
 
+// Same threshold test as the allocator, but ignoring pins: lets code that
+// pins the collector run the pending cycle itself at a safe point.
+int gc_collect_pending(void) {
+    if (!gc.enabled) return 0;
+    if (gc.phase != GC_PHASE_IDLE) return 0;
+    if ((gc.object_count + 1) >= gc.next_gc_objects) return 1;
+    return gc_live_bytes() + (unsigned long)sizeof(GCHeader) >= gc.next_gc_bytes;
+}
+
 void* gc_alloc(int type, size_t size) {
     sage_mutex_lock(&gc_mutex);
 
@@ -3,313 +3,1002 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "ast_arena.h"
 #include "gc.h"
+#include "profile.h"
 
 // ============================================================================
 // Function Inlining Pass
 //
-// Replaces calls to small, non-recursive procedures with their body.
-// Only runs at -O3.
+// Replaces calls to small, non-recursive procedures and methods with their
+// body. Runs at -O2 and -O3 with the code-size budgets below.
 //
-// Criteria for inlining:
-// - Procedure body is a single return statement
-// - Not recursive
-// - Called with correct argument count
+// Two forms:
+// - Expression inlining: a body that is a single `return expr` replaces the
+//   call wherever it appears, its parameters substituted by the arguments
+//   (only when that cannot change what the arguments evaluate to).
+// - Statement inlining: any other eligible body is spliced in front of the
+//   statement whose root is the call (`let x = f(a)`, `x = f(a)`, `f(a)`,
+//   `return f(a)`, `print f(a)`, `if f(a):`). Arguments are bound to fresh
+//   locals in order, the body's own names are renamed `__inl<N>_name`, and
+//   every `return e` becomes `__inl<N>_ret = e`. Bodies qualify when their
+//   returns are all in tail position (guard clauses `if c: ... return` are
+//   turned into if/else first) and they define nothing, yield, defer,
+//   await, use `super` or build closures.
+//
+// Methods are inlined when the receiver's class is known statically: a
+// variable bound once by `let v = Class(...)` earlier in the same block, or
+// `self` inside a class nothing derives from.
+//
+// Cost model: a call site is inlined when the callee's size (AST nodes) minus
+// the call overhead fits the level's per-callee limit, scaled up by 2x per
+// enclosing loop (up to 8x) and 4x at call sites the --profile-use profile
+// saw as hot, and the copies made so far stay within the level's growth
+// budget. With a profile, procedures that never ran and call sites never
+// reached keep their out-of-line call.
 // ============================================================================
 
+typedef struct {
+    int max_callee_size;   // AST nodes, after the call overhead is credited
+    int growth_percent;    // Total nodes added, relative to the program
+    int min_growth;        // Floor for small programs
+} InlineBudget;
+
+// Indexed by opt level; -O0/-O1 do not inline.
+static const InlineBudget g_inline_budgets[] = {
+    { 0,  0,   0 },
+    { 0,  0,   0 },
+    { 24, 20,  200 },
+    { 80, 100, 1000 },
+};
+
+#define INLINE_CALL_OVERHEAD 4   // Call node, callee and frame setup, in AST nodes
+#define INLINE_MAX_LOOP_SHIFT 3  // Loop weighting stops at 8x
+#define INLINE_HOT_WEIGHT 4      // Extra weight of a profiled-hot call site
+#define INLINE_MAX_NESTING 3     // Inlined bodies are rescanned this many levels deep
+
 // ============================================================================
-// Procedure Table - collect proc definitions for inlining
+// Name sets
 // ============================================================================
 
-typedef struct InlineCandidate {
+typedef struct NameSet {
     char* name;
-    int param_count;
-    Token* params;
-    Expr* return_expr;     // non-NULL if body is single `return expr`
-    int is_recursive;
-    struct InlineCandidate* next;
-} InlineCandidate;
+    int count;
+    struct NameSet* next;
+} NameSet;
 
-static void free_candidates(InlineCandidate* list) {
-    while (list != NULL) {
-        InlineCandidate* next = list->next;
-        free(list->name);
-        free(list);
-        list = next;
+static NameSet* nameset_find(NameSet* set, const char* name, int len) {
+    for (NameSet* n = set; n != NULL; n = n->next) {
+        if ((int)strlen(n->name) == len && memcmp(n->name, name, (size_t)len) == 0) return n;
+    }
+    return NULL;
+}
+
+static void nameset_add(NameSet** set, const char* name, int len) {
+    NameSet* n = nameset_find(*set, name, len);
+    if (n != NULL) {
+        n->count++;
+        return;
     }
+    n = SAGE_ALLOC(sizeof(NameSet));
+    n->name = SAGE_ALLOC((size_t)len + 1);
+    memcpy(n->name, name, (size_t)len);
+    n->name[len] = '\0';
+    n->count = 1;
+    n->next = *set;
+    *set = n;
 }
 
-// Check if a proc body is a single return statement
-static Expr* get_single_return_expr(const Stmt* body) {
-    if (body == NULL) return NULL;
+static int nameset_count(NameSet* set, Token name) {
+    NameSet* n = nameset_find(set, name.start, name.length);
+    return n ? n->count : 0;
+}
 
-    // Body might be a block containing statements
-    const Stmt* first = body;
-    if (first->type == STMT_BLOCK) {
-        first = first->as.block.statements;
+static void nameset_free(NameSet* set) {
+    while (set != NULL) {
+        NameSet* next = set->next;
+        free(set->name);
+        free(set);
+        set = next;
     }
+}
 
-    // Must be exactly one statement and it must be a return
-    if (first == NULL) return NULL;
-    if (first->next != NULL) return NULL;  // more than one statement
-    if (first->type != STMT_RETURN) return NULL;
+static int token_is(Token tok, const char* str) {
+    return tok.length == (int)strlen(str) && memcmp(tok.start, str, (size_t)tok.length) == 0;
+}
 
-    return first->as.ret.value;
+static int tokens_equal(Token a, Token b) {
+    return a.length == b.length && memcmp(a.start, b.start, (size_t)a.length) == 0;
 }
 
-// Check if an expression references a name
-static int expr_references_name(const Expr* expr, const char* name) {
-    if (expr == NULL) return 0;
+// ============================================================================
+// Body scan - what a procedure body declares, mentions and contains
+// ============================================================================
+
+typedef struct {
+    int size;             // AST nodes
+    int has_forbidden;    // Cannot be spliced into another body
+    int has_effects;      // Calls or assignments: argument evaluation order matters
+    int has_super;
+    NameSet* declared;    // let / for / catch names
+    NameSet* mentioned;   // Variables read or assigned
+    NameSet* assigned;    // `x = v` targets
+    NameSet* fields;      // Properties assigned on objects (`o.p = v`)
+    NameSet* properties;  // Properties read (`o.p`)
+} BodyScan;
+
+static void scan_free(BodyScan* scan) {
+    nameset_free(scan->declared);
+    nameset_free(scan->mentioned);
+    nameset_free(scan->assigned);
+    nameset_free(scan->fields);
+    nameset_free(scan->properties);
+    memset(scan, 0, sizeof(*scan));
+}
+
+static void scan_stmts(BodyScan* scan, const Stmt* stmt);
+
+static void scan_expr(BodyScan* scan, const Expr* expr) {
+    if (expr == NULL) return;
+    scan->size++;
 
     switch (expr->type) {
-        case EXPR_VARIABLE: {
-            int len = expr->as.variable.name.length;
-            if (len == (int)strlen(name) &&
-                memcmp(expr->as.variable.name.start, name, (size_t)len) == 0) {
-                return 1;
-            }
-            return 0;
-        }
+        case EXPR_VARIABLE:
+            nameset_add(&scan->mentioned, expr->as.variable.name.start, expr->as.variable.name.length);
+            break;
         case EXPR_BINARY:
-            return expr_references_name(expr->as.binary.left, name) ||
-                   expr_references_name(expr->as.binary.right, name);
+            scan_expr(scan, expr->as.binary.left);
+            scan_expr(scan, expr->as.binary.right);
+            break;
         case EXPR_CALL:
-            if (expr_references_name(expr->as.call.callee, name)) return 1;
-            for (int i = 0; i < expr->as.call.arg_count; i++) {
-                if (expr_references_name(expr->as.call.args[i], name)) return 1;
-            }
-            return 0;
+            scan->has_effects = 1;
+            scan_expr(scan, expr->as.call.callee);
+            for (int i = 0; i < expr->as.call.arg_count; i++) scan_expr(scan, expr->as.call.args[i]);
+            break;
         case EXPR_ARRAY:
-            for (int i = 0; i < expr->as.array.count; i++) {
-                if (expr_references_name(expr->as.array.elements[i], name)) return 1;
-            }
-            return 0;
+            for (int i = 0; i < expr->as.array.count; i++) scan_expr(scan, expr->as.array.elements[i]);
+            break;
         case EXPR_INDEX:
-            return expr_references_name(expr->as.index.array, name) ||
-                   expr_references_name(expr->as.index.index, name);
+            scan_expr(scan, expr->as.index.array);
+            scan_expr(scan, expr->as.index.index);
+            break;
         case EXPR_INDEX_SET:
-            return expr_references_name(expr->as.index_set.array, name) ||
-                   expr_references_name(expr->as.index_set.index, name) ||
-                   expr_references_name(expr->as.index_set.value, name);
+            scan->has_effects = 1;
+            scan_expr(scan, expr->as.index_set.array);
+            scan_expr(scan, expr->as.index_set.index);
+            scan_expr(scan, expr->as.index_set.value);
+            break;
         case EXPR_DICT:
-            for (int i = 0; i < expr->as.dict.count; i++) {
-                if (expr_references_name(expr->as.dict.values[i], name)) return 1;
-            }
-            return 0;
+            for (int i = 0; i < expr->as.dict.count; i++) scan_expr(scan, expr->as.dict.values[i]);
+            break;
         case EXPR_TUPLE:
-            for (int i = 0; i < expr->as.tuple.count; i++) {
-                if (expr_references_name(expr->as.tuple.elements[i], name)) return 1;
-            }
-            return 0;
+            for (int i = 0; i < expr->as.tuple.count; i++) scan_expr(scan, expr->as.tuple.elements[i]);
+            break;
         case EXPR_SLICE:
-            return expr_references_name(expr->as.slice.array, name) ||
-                   expr_references_name(expr->as.slice.start, name) ||
-                   expr_references_name(expr->as.slice.end, name);
+            scan_expr(scan, expr->as.slice.array);
+            scan_expr(scan, expr->as.slice.start);
+            scan_expr(scan, expr->as.slice.end);
+            break;
         case EXPR_GET:
-            return expr_references_name(expr->as.get.object, name);
+            nameset_add(&scan->properties, expr->as.get.property.start, expr->as.get.property.length);
+            scan_expr(scan, expr->as.get.object);
+            break;
         case EXPR_SET:
-            return expr_references_name(expr->as.set.object, name) ||
-                   expr_references_name(expr->as.set.value, name);
+            scan->has_effects = 1;
+            if (expr->as.set.object == NULL) {
+                nameset_add(&scan->mentioned, expr->as.set.property.start, expr->as.set.property.length);
+                nameset_add(&scan->assigned, expr->as.set.property.start, expr->as.set.property.length);
+            } else {
+                nameset_add(&scan->fields, expr->as.set.property.start, expr->as.set.property.length);
+                scan_expr(scan, expr->as.set.object);
+            }
+            scan_expr(scan, expr->as.set.value);
+            break;
+        case EXPR_SUPER:
+            scan->has_super = 1;
+            scan->has_forbidden = 1;
+            break;
         case EXPR_AWAIT:
+        case EXPR_PROC:
+        case EXPR_COMPTIME:
+            scan->has_effects = 1;
+            scan->has_forbidden = 1;
+            break;
+        default:
+            break;
+    }
+}
+
+static void scan_declare(BodyScan* scan, Token name) {
+    nameset_add(&scan->declared, name.start, name.length);
+    nameset_add(&scan->mentioned, name.start, name.length);
+}
+
+static void scan_stmts(BodyScan* scan, const Stmt* stmt) {
+    for (; stmt != NULL; stmt = stmt->next) {
+        scan->size++;
+        switch (stmt->type) {
+            case STMT_PRINT:
+                scan->has_effects = 1;
+                scan_expr(scan, stmt->as.print.expression);
+                break;
+            case STMT_EXPRESSION:
+                scan_expr(scan, stmt->as.expression);
+                break;
+            case STMT_LET:
+                scan_declare(scan, stmt->as.let.name);
+                scan_expr(scan, stmt->as.let.initializer);
+                break;
+            case STMT_IF:
+                scan_expr(scan, stmt->as.if_stmt.condition);
+                scan_stmts(scan, stmt->as.if_stmt.then_branch);
+                scan_stmts(scan, stmt->as.if_stmt.else_branch);
+                break;
+            case STMT_BLOCK:
+                scan_stmts(scan, stmt->as.block.statements);
+                break;
+            case STMT_WHILE:
+                scan_expr(scan, stmt->as.while_stmt.condition);
+                scan_stmts(scan, stmt->as.while_stmt.body);
+                break;
+            case STMT_FOR:
+                scan_declare(scan, stmt->as.for_stmt.variable);
+                scan_expr(scan, stmt->as.for_stmt.iterable);
+                scan_stmts(scan, stmt->as.for_stmt.body);
+                break;
+            case STMT_RETURN:
+                scan_expr(scan, stmt->as.ret.value);
+                break;
+            case STMT_MATCH:
+                scan_expr(scan, stmt->as.match_stmt.value);
+                for (int i = 0; i < stmt->as.match_stmt.case_count; i++) {
+                    scan_expr(scan, stmt->as.match_stmt.cases[i]->pattern);
+                    scan_expr(scan, stmt->as.match_stmt.cases[i]->guard);
+                    scan_stmts(scan, stmt->as.match_stmt.cases[i]->body);
+                }
+                scan_stmts(scan, stmt->as.match_stmt.default_case);
+                break;
+            case STMT_TRY:
+                scan->has_effects = 1;
+                scan_stmts(scan, stmt->as.try_stmt.try_block);
+                for (int i = 0; i < stmt->as.try_stmt.catch_count; i++) {
+                    scan_declare(scan, stmt->as.try_stmt.catches[i]->exception_var);
+                    scan_stmts(scan, stmt->as.try_stmt.catches[i]->body);
+                }
+                scan_stmts(scan, stmt->as.try_stmt.finally_block);
+                break;
+            case STMT_RAISE:
+                scan->has_effects = 1;
+                scan_expr(scan, stmt->as.raise.exception);
+                break;
+            case STMT_BREAK:
+            case STMT_CONTINUE:
+                break;
+            default:
+                // Definitions, imports, yield, defer, comptime, macros
+                scan->has_effects = 1;
+                scan->has_forbidden = 1;
+                break;
+        }
+    }
+}
+
+// Names assigned and fields set anywhere in the program, nested bodies included.
+static void scan_program(BodyScan* scan, const Stmt* stmt) {
+    scan_stmts(scan, stmt);
+    for (; stmt != NULL; stmt = stmt->next) {
+        if (stmt->type == STMT_PROC || stmt->type == STMT_ASYNC_PROC) {
+            scan_program(scan, stmt->as.proc.body);
+        } else if (stmt->type == STMT_CLASS) {
+            scan_program(scan, stmt->as.class_stmt.methods);
+        }
+    }
+}
+
+// ============================================================================
+// Return lowering - turn tail `return e` into `ret = e`
+// ============================================================================
+
+static int contains_return(const Stmt* stmt);
+
+static int list_contains_return(const Stmt* list) {
+    for (; list != NULL; list = list->next) {
+        if (contains_return(list)) return 1;
+    }
+    return 0;
+}
+
+static int contains_return(const Stmt* stmt) {
+    switch (stmt->type) {
+        case STMT_RETURN: return 1;
+        case STMT_IF:
+            return list_contains_return(stmt->as.if_stmt.then_branch) ||
+                   list_contains_return(stmt->as.if_stmt.else_branch);
+        case STMT_BLOCK: return list_contains_return(stmt->as.block.statements);
+        case STMT_WHILE: return list_contains_return(stmt->as.while_stmt.body);
+        case STMT_FOR:   return list_contains_return(stmt->as.for_stmt.body);
+        case STMT_MATCH:
+            for (int i = 0; i < stmt->as.match_stmt.case_count; i++) {
+                if (list_contains_return(stmt->as.match_stmt.cases[i]->body)) return 1;
+            }
+            return list_contains_return(stmt->as.match_stmt.default_case);
+        case STMT_TRY:
+            if (list_contains_return(stmt->as.try_stmt.try_block) ||
+                list_contains_return(stmt->as.try_stmt.finally_block)) return 1;
+            for (int i = 0; i < stmt->as.try_stmt.catch_count; i++) {
+                if (list_contains_return(stmt->as.try_stmt.catches[i]->body)) return 1;
+            }
             return 0;
         default:
             return 0;
     }
 }
 
-// Collect inline candidates from proc definitions
-static InlineCandidate* collect_candidates(Stmt* program) {
-    InlineCandidate* list = NULL;
+static int always_returns(const Stmt* list) {
+    const Stmt* last = list;
+    if (last == NULL) return 0;
+    while (last->next != NULL) last = last->next;
+    if (last->type == STMT_RETURN) return 1;
+    if (last->type == STMT_BLOCK) return always_returns(last->as.block.statements);
+    return last->type == STMT_IF && always_returns(last->as.if_stmt.then_branch) &&
+           always_returns(last->as.if_stmt.else_branch);
+}
 
-    for (Stmt* s = program; s != NULL; s = s->next) {
-        if (s->type != STMT_PROC) continue;
+// Every return of `list` is in tail position, counting `if c: ... return`
+// guard clauses whose rest of the list can become their else branch.
+static int returns_in_tail(const Stmt* list) {
+    for (const Stmt* s = list; s != NULL; s = s->next) {
+        if (s->next == NULL) {
+            if (s->type == STMT_RETURN) return 1;
+            if (s->type == STMT_BLOCK) return returns_in_tail(s->as.block.statements);
+            if (s->type == STMT_IF) {
+                return returns_in_tail(s->as.if_stmt.then_branch) &&
+                       returns_in_tail(s->as.if_stmt.else_branch);
+            }
+            return !contains_return(s);
+        }
+        if (!contains_return(s)) continue;
+        if (s->type != STMT_IF || s->as.if_stmt.else_branch != NULL) return 0;
+        if (!always_returns(s->as.if_stmt.then_branch) || !returns_in_tail(s->as.if_stmt.then_branch)) return 0;
+        return returns_in_tail(s->next);
+    }
+    return 1;
+}
+
+// Rewrites a list accepted by returns_in_tail(). `ret` is the result
+// variable, or NULL when the call's value is discarded.
+static void lower_returns(Stmt** list, const Token* ret) {
+    for (Stmt** link = list; *link != NULL; link = &(*link)->next) {
+        Stmt* s = *link;
+        if (s->type == STMT_BLOCK && contains_return(s)) {
+            lower_returns(&s->as.block.statements, ret);
+            return;
+        }
+        if (s->type == STMT_IF && contains_return(s)) {
+            if (s->next != NULL) {
+                s->as.if_stmt.else_branch = s->next;
+                s->next = NULL;
+            }
+            lower_returns(&s->as.if_stmt.then_branch, ret);
+            lower_returns(&s->as.if_stmt.else_branch, ret);
+            return;
+        }
+        if (s->type == STMT_RETURN) {
+            Expr* value = s->as.ret.value ? s->as.ret.value : new_nil_expr();
+            s->as.ret.value = NULL;
+            s->type = STMT_EXPRESSION;
+            s->as.expression = ret ? new_set_expr(NULL, *ret, value) : value;
+            return;
+        }
+    }
+}
+
+// ============================================================================
+// Renaming - give a spliced body's locals names of their own
+// ============================================================================
+
+static Token inline_name(Token like, int id, Token name) {
+    char buf[128];
+    int len = snprintf(buf, sizeof(buf), "__inl%d_%.*s", id, name.length, name.start);
+    if (len >= (int)sizeof(buf)) len = (int)sizeof(buf) - 1;
+    Token tok = like;
+    tok.type = TOKEN_IDENTIFIER;
+    tok.start = ast_strndup(buf, (size_t)len);
+    tok.length = len;
+    return tok;
+}
+
+static void rename_token(Token* tok, NameSet* locals, int id) {
+    if (nameset_find(locals, tok->start, tok->length)) *tok = inline_name(*tok, id, *tok);
+}
+
+static void rename_stmts(Stmt* stmt, NameSet* locals, int id);
+
+static void rename_expr(Expr* expr, NameSet* locals, int id) {
+    if (expr == NULL) return;
+    switch (expr->type) {
+        case EXPR_VARIABLE:
+            rename_token(&expr->as.variable.name, locals, id);
+            break;
+        case EXPR_BINARY:
+            rename_expr(expr->as.binary.left, locals, id);
+            rename_expr(expr->as.binary.right, locals, id);
+            break;
+        case EXPR_CALL:
+            rename_expr(expr->as.call.callee, locals, id);
+            for (int i = 0; i < expr->as.call.arg_count; i++) rename_expr(expr->as.call.args[i], locals, id);
+            break;
+        case EXPR_ARRAY:
+            for (int i = 0; i < expr->as.array.count; i++) rename_expr(expr->as.array.elements[i], locals, id);
+            break;
+        case EXPR_INDEX:
+            rename_expr(expr->as.index.array, locals, id);
+            rename_expr(expr->as.index.index, locals, id);
+            break;
+        case EXPR_INDEX_SET:
+            rename_expr(expr->as.index_set.array, locals, id);
+            rename_expr(expr->as.index_set.index, locals, id);
+            rename_expr(expr->as.index_set.value, locals, id);
+            break;
+        case EXPR_DICT:
+            for (int i = 0; i < expr->as.dict.count; i++) rename_expr(expr->as.dict.values[i], locals, id);
+            break;
+        case EXPR_TUPLE:
+            for (int i = 0; i < expr->as.tuple.count; i++) rename_expr(expr->as.tuple.elements[i], locals, id);
+            break;
+        case EXPR_SLICE:
+            rename_expr(expr->as.slice.array, locals, id);
+            rename_expr(expr->as.slice.start, locals, id);
+            rename_expr(expr->as.slice.end, locals, id);
+            break;
+        case EXPR_GET:
+            rename_expr(expr->as.get.object, locals, id);
+            break;
+        case EXPR_SET:
+            if (expr->as.set.object == NULL) rename_token(&expr->as.set.property, locals, id);
+            else rename_expr(expr->as.set.object, locals, id);
+            rename_expr(expr->as.set.value, locals, id);
+            break;
+        default:
+            break;
+    }
+}
+
+static void rename_stmts(Stmt* stmt, NameSet* locals, int id) {
+    for (; stmt != NULL; stmt = stmt->next) {
+        switch (stmt->type) {
+            case STMT_PRINT:
+                rename_expr(stmt->as.print.expression, locals, id);
+                break;
+            case STMT_EXPRESSION:
+                rename_expr(stmt->as.expression, locals, id);
+                break;
+            case STMT_LET:
+                rename_token(&stmt->as.let.name, locals, id);
+                rename_expr(stmt->as.let.initializer, locals, id);
+                break;
+            case STMT_IF:
+                rename_expr(stmt->as.if_stmt.condition, locals, id);
+                rename_stmts(stmt->as.if_stmt.then_branch, locals, id);
+                rename_stmts(stmt->as.if_stmt.else_branch, locals, id);
+                break;
+            case STMT_BLOCK:
+                rename_stmts(stmt->as.block.statements, locals, id);
+                break;
+            case STMT_WHILE:
+                rename_expr(stmt->as.while_stmt.condition, locals, id);
+                rename_stmts(stmt->as.while_stmt.body, locals, id);
+                break;
+            case STMT_FOR:
+                rename_token(&stmt->as.for_stmt.variable, locals, id);
+                rename_expr(stmt->as.for_stmt.iterable, locals, id);
+                rename_stmts(stmt->as.for_stmt.body, locals, id);
+                break;
+            case STMT_RETURN:
+                rename_expr(stmt->as.ret.value, locals, id);
+                break;
+            case STMT_MATCH:
+                rename_expr(stmt->as.match_stmt.value, locals, id);
+                for (int i = 0; i < stmt->as.match_stmt.case_count; i++) {
+                    rename_expr(stmt->as.match_stmt.cases[i]->pattern, locals, id);
+                    rename_expr(stmt->as.match_stmt.cases[i]->guard, locals, id);
+                    rename_stmts(stmt->as.match_stmt.cases[i]->body, locals, id);
+                }
+                rename_stmts(stmt->as.match_stmt.default_case, locals, id);
+                break;
+            case STMT_TRY:
+                rename_stmts(stmt->as.try_stmt.try_block, locals, id);
+                for (int i = 0; i < stmt->as.try_stmt.catch_count; i++) {
+                    rename_token(&stmt->as.try_stmt.catches[i]->exception_var, locals, id);
+                    rename_stmts(stmt->as.try_stmt.catches[i]->body, locals, id);
+                }
+                rename_stmts(stmt->as.try_stmt.finally_block, locals, id);
+                break;
+            case STMT_RAISE:
+                rename_expr(stmt->as.raise.exception, locals, id);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+// ============================================================================
+// Candidates - procedures and methods worth inlining
+// ============================================================================
+
+typedef struct InlineClass {
+    Token name;
+    Token parent;
+    int has_parent;
+    int has_subclass;
+    Stmt* methods;
+    struct InlineClass* next;
+} InlineClass;
+
+typedef struct InlineCandidate {
+    const Stmt* decl;      // The proc or method definition
+    Token name;
+    int param_count;
+    Token* params;
+    Stmt* body;            // Private copy: inlining rewrites (and frees) nodes of the originals
+    Expr* return_expr;     // Into `body` when it is a single `return expr`
+    int size;
+    int splice_ok;         // Statement inlining allowed
+    int has_effects;
+    NameSet* locals;       // Parameters and declared names, renamed when spliced
+    NameSet* free_names;   // Everything else the body mentions
+    NameSet* assigned;
+    struct InlineCandidate* next;
+} InlineCandidate;
+
+static void free_candidates(InlineCandidate* list) {
+    while (list != NULL) {
+        InlineCandidate* next = list->next;
+        free_stmt(list->body);
+        nameset_free(list->locals);
+        nameset_free(list->free_names);
+        nameset_free(list->assigned);
+        free(list);
+        list = next;
+    }
+}
+
+static void free_classes(InlineClass* list) {
+    while (list != NULL) {
+        InlineClass* next = list->next;
+        free(list);
+        list = next;
+    }
+}
 
-        Expr* ret_expr = get_single_return_expr(s->as.proc.body);
-        if (ret_expr == NULL) continue;
+// Procedure bodies are parsed as a single block.
+static Stmt* body_statements(Stmt* body) {
+    if (body != NULL && body->type == STMT_BLOCK && body->next == NULL) return body->as.block.statements;
+    return body;
+}
 
-        int len = s->as.proc.name.length;
-        char* name = SAGE_ALLOC((size_t)len + 1);
-        memcpy(name, s->as.proc.name.start, (size_t)len);
-        name[len] = '\0';
+static Expr* single_return_expr(Stmt* body) {
+    body = body_statements(body);
+    if (body == NULL || body->next != NULL || body->type != STMT_RETURN) return NULL;
+    return body->as.ret.value;
+}
 
-        // Check for recursion
-        if (expr_references_name(ret_expr, name)) { free(name); continue; }
+// `is_method`: the body may not mention its own name as a property either
+static InlineCandidate* make_candidate(const Stmt* decl, int is_method) {
+    const ProcStmt* proc = &decl->as.proc;
+    if (proc->body == NULL) return NULL;
+    for (int i = 0; i < proc->param_count; i++) {
+        if (proc->defaults != NULL && proc->defaults[i] != NULL) return NULL;
+    }
 
-        InlineCandidate* c = SAGE_ALLOC(sizeof(InlineCandidate));
-        c->name = name;  // takes ownership of dynamically allocated name
-        c->param_count = s->as.proc.param_count;
-        c->params = s->as.proc.params;
-        c->return_expr = ret_expr;
-        c->is_recursive = 0;
-        c->next = list;
-        list = c;
+    BodyScan scan;
+    memset(&scan, 0, sizeof(scan));
+    scan_stmts(&scan, proc->body);
+    int recursive = nameset_count(scan.mentioned, proc->name) > 0 ||
+                    (is_method && nameset_count(scan.properties, proc->name) > 0);
+    if (recursive || scan.has_super) {
+        scan_free(&scan);
+        return NULL;
     }
 
-    return list;
+    InlineCandidate* c = SAGE_ALLOC(sizeof(InlineCandidate));
+    memset(c, 0, sizeof(*c));
+    c->decl = decl;
+    c->name = proc->name;
+    c->param_count = proc->param_count;
+    c->params = proc->params;
+    c->body = clone_stmt_list(proc->body);
+    c->return_expr = single_return_expr(c->body);
+    c->size = scan.size;
+    c->has_effects = scan.has_effects;
+    c->splice_ok = !scan.has_forbidden && returns_in_tail(body_statements(proc->body));
+
+    for (int i = 0; i < proc->param_count; i++) nameset_add(&c->locals, proc->params[i].start, proc->params[i].length);
+    for (NameSet* n = scan.declared; n != NULL; n = n->next) nameset_add(&c->locals, n->name, (int)strlen(n->name));
+    for (NameSet* n = scan.mentioned; n != NULL; n = n->next) {
+        if (!nameset_find(c->locals, n->name, (int)strlen(n->name))) nameset_add(&c->free_names, n->name, (int)strlen(n->name));
+    }
+    c->assigned = scan.assigned;
+    scan.assigned = NULL;
+    scan_free(&scan);
+
+    if (c->return_expr == NULL && !c->splice_ok) {
+        free_candidates(c);
+        return NULL;
+    }
+    return c;
 }
 
-// Find a candidate by name
-static InlineCandidate* find_candidate(InlineCandidate* list, const char* name) {
-    for (InlineCandidate* c = list; c != NULL; c = c->next) {
-        if (strcmp(c->name, name) == 0) return c;
+static InlineClass* find_class(InlineClass* list, Token name) {
+    for (InlineClass* k = list; k != NULL; k = k->next) {
+        if (tokens_equal(k->name, name)) return k;
     }
     return NULL;
 }
 
 // ============================================================================
-// Expression substitution - replace parameter references with argument exprs
+// Inliner state
 // ============================================================================
 
-static Expr* substitute_expr(const Expr* expr, Token* params, int param_count, Expr** args) {
-    if (expr == NULL) return NULL;
+// `var` is known to hold an instance of `cls` from here to the end of the block.
+typedef struct Binding {
+    Token var;
+    InlineClass* cls;
+    struct Binding* next;
+} Binding;
 
-    // Deep clone and substitute
-    Expr* result = clone_expr(expr);
+typedef struct {
+    InlineCandidate* candidates;
+    InlineClass* classes;
+    const SageProfile* profile;
+    InlineBudget budget;
+    int growth;
+    int growth_limit;
+    int next_id;
+    BodyScan program;        // Assignments and field sets anywhere
+    NameSet* scope_locals;   // Names the enclosing proc declares, NULL at top level
+    NameSet* scope_decls;    // Declaration counts of the current scope
+    Binding* bindings;
+    int loop_depth;
+    int nesting;
+} Inliner;
 
-    if (result->type == EXPR_VARIABLE) {
-        int vlen = result->as.variable.name.length;
-        for (int i = 0; i < param_count; i++) {
-            if (params[i].length == vlen &&
-                memcmp(params[i].start, result->as.variable.name.start, (size_t)vlen) == 0) {
-                // Replace with cloned argument
-                free_expr(result);
-                return clone_expr(args[i]);
+static InlineCandidate* find_proc_candidate(Inliner* inl, Token name) {
+    // A name also bound by let or assignment may not be the proc at run time
+    if (nameset_count(inl->program.assigned, name) > 0) return NULL;
+    InlineCandidate* found = NULL;
+    for (InlineCandidate* c = inl->candidates; c != NULL; c = c->next) {
+        if (c->decl->type != STMT_PROC || !tokens_equal(c->name, name)) continue;
+        if (found != NULL) return NULL;  // Redefined
+        found = c;
+    }
+    return found;
+}
+
+static InlineClass* binding_class(Inliner* inl, Token var) {
+    for (Binding* b = inl->bindings; b != NULL; b = b->next) {
+        if (tokens_equal(b->var, var)) return b->cls;
+    }
+    return NULL;
+}
+
+static void push_binding(Inliner* inl, Token var, InlineClass* cls) {
+    Binding* b = SAGE_ALLOC(sizeof(Binding));
+    b->var = var;
+    b->cls = cls;
+    b->next = inl->bindings;
+    inl->bindings = b;
+}
+
+static void pop_bindings(Inliner* inl, Binding* mark) {
+    while (inl->bindings != mark) {
+        Binding* next = inl->bindings->next;
+        free(inl->bindings);
+        inl->bindings = next;
+    }
+}
+
+static InlineCandidate* find_method_candidate(Inliner* inl, InlineClass* cls, Token method) {
+    // An instance field of the same name would shadow the method
+    if (nameset_count(inl->program.fields, method) > 0) return NULL;
+    for (InlineClass* k = cls; k != NULL;) {
+        for (Stmt* m = k->methods; m != NULL; m = m->next) {
+            if (m->type != STMT_PROC || !tokens_equal(m->as.proc.name, method)) continue;
+            for (InlineCandidate* c = inl->candidates; c != NULL; c = c->next) {
+                if (c->decl == m) return c;
             }
+            return NULL;
         }
-    } else if (result->type == EXPR_BINARY) {
-        free_expr(result->as.binary.left);
-        free_expr(result->as.binary.right);
-        result->as.binary.left = substitute_expr(expr->as.binary.left, params, param_count, args);
-        result->as.binary.right = substitute_expr(expr->as.binary.right, params, param_count, args);
-    } else if (result->type == EXPR_CALL) {
-        free_expr(result->as.call.callee);
-        result->as.call.callee = substitute_expr(expr->as.call.callee, params, param_count, args);
-        for (int i = 0; i < result->as.call.arg_count; i++) {
-            free_expr(result->as.call.args[i]);
-            result->as.call.args[i] = substitute_expr(expr->as.call.args[i], params, param_count, args);
+        if (!k->has_parent) return NULL;
+        k = find_class(inl->classes, k->parent);  // Unknown parent: give up
+    }
+    return NULL;
+}
+
+// The candidate a call resolves to; `*receiver` is set for method calls.
+static InlineCandidate* resolve_call(Inliner* inl, Expr* call, Expr** receiver) {
+    Expr* callee = call->as.call.callee;
+    *receiver = NULL;
+    if (callee->type == EXPR_VARIABLE) {
+        if (binding_class(inl, callee->as.variable.name) != NULL) return NULL;
+        if (inl->scope_locals && nameset_count(inl->scope_locals, callee->as.variable.name) > 0) return NULL;
+        InlineCandidate* c = find_proc_candidate(inl, callee->as.variable.name);
+        return c != NULL && c->param_count == call->as.call.arg_count ? c : NULL;
+    }
+    if (callee->type == EXPR_GET && callee->as.get.object != NULL &&
+        callee->as.get.object->type == EXPR_VARIABLE) {
+        InlineClass* cls = binding_class(inl, callee->as.get.object->as.variable.name);
+        if (cls == NULL) return NULL;
+        InlineCandidate* c = find_method_candidate(inl, cls, callee->as.get.property);
+        if (c == NULL || c->param_count != call->as.call.arg_count + 1) return NULL;
+        *receiver = callee->as.get.object;
+        return c;
+    }
+    return NULL;
+}
+
+// A name the callee reads from its defining scope must mean the same thing here.
+static int captures_differ(Inliner* inl, const InlineCandidate* c) {
+    if (inl->scope_locals == NULL) return 0;
+    for (NameSet* n = c->free_names; n != NULL; n = n->next) {
+        if (nameset_find(inl->scope_locals, n->name, (int)strlen(n->name))) return 1;
+    }
+    return 0;
+}
+
+static int inline_weight(Inliner* inl, const Expr* callee) {
+    int shift = inl->loop_depth < INLINE_MAX_LOOP_SHIFT ? inl->loop_depth : INLINE_MAX_LOOP_SHIFT;
+    int weight = 1 << shift;
+    if (inl->profile != NULL) {
+        int64_t hits = profile_site_hits(inl->profile, callee);
+        if (hits == 0) return 0;
+        if (hits >= PROFILE_HOT_CALLS) weight *= INLINE_HOT_WEIGHT;
+    }
+    return weight;
+}
+
+// Charges `size` against the budget when the site is worth it.
+static int inline_affordable(Inliner* inl, const Expr* callee, int size) {
+    int weight = inline_weight(inl, callee);
+    if (weight == 0) return 0;
+    int cost = size - INLINE_CALL_OVERHEAD;
+    if (cost > inl->budget.max_callee_size * weight) return 0;
+    if (cost > 0 && inl->growth + cost > inl->growth_limit) return 0;
+    if (cost > 0) inl->growth += cost;
+    return 1;
+}
+
+// ============================================================================
+// Expression inlining
+// ============================================================================
+
+static int count_uses(const Expr* expr, Token name) {
+    if (expr == NULL) return 0;
+    switch (expr->type) {
+        case EXPR_VARIABLE: return tokens_equal(expr->as.variable.name, name);
+        case EXPR_BINARY: return count_uses(expr->as.binary.left, name) + count_uses(expr->as.binary.right, name);
+        case EXPR_CALL: {
+            int n = count_uses(expr->as.call.callee, name);
+            for (int i = 0; i < expr->as.call.arg_count; i++) n += count_uses(expr->as.call.args[i], name);
+            return n;
         }
-    } else if (result->type == EXPR_INDEX) {
-        free_expr(result->as.index.array);
-        free_expr(result->as.index.index);
-        result->as.index.array = substitute_expr(expr->as.index.array, params, param_count, args);
-        result->as.index.index = substitute_expr(expr->as.index.index, params, param_count, args);
-    } else if (result->type == EXPR_INDEX_SET) {
-        free_expr(result->as.index_set.array);
-        free_expr(result->as.index_set.index);
-        free_expr(result->as.index_set.value);
-        result->as.index_set.array = substitute_expr(expr->as.index_set.array, params, param_count, args);
-        result->as.index_set.index = substitute_expr(expr->as.index_set.index, params, param_count, args);
-        result->as.index_set.value = substitute_expr(expr->as.index_set.value, params, param_count, args);
-    } else if (result->type == EXPR_ARRAY) {
-        for (int i = 0; i < result->as.array.count; i++) {
-            free_expr(result->as.array.elements[i]);
-            result->as.array.elements[i] = substitute_expr(expr->as.array.elements[i], params, param_count, args);
+        case EXPR_ARRAY: {
+            int n = 0;
+            for (int i = 0; i < expr->as.array.count; i++) n += count_uses(expr->as.array.elements[i], name);
+            return n;
         }
-    } else if (result->type == EXPR_DICT) {
-        for (int i = 0; i < result->as.dict.count; i++) {
-            free_expr(result->as.dict.values[i]);
-            result->as.dict.values[i] = substitute_expr(expr->as.dict.values[i], params, param_count, args);
+        case EXPR_DICT: {
+            int n = 0;
+            for (int i = 0; i < expr->as.dict.count; i++) n += count_uses(expr->as.dict.values[i], name);
+            return n;
         }
-    } else if (result->type == EXPR_TUPLE) {
-        for (int i = 0; i < result->as.tuple.count; i++) {
-            free_expr(result->as.tuple.elements[i]);
-            result->as.tuple.elements[i] = substitute_expr(expr->as.tuple.elements[i], params, param_count, args);
+        case EXPR_TUPLE: {
+            int n = 0;
+            for (int i = 0; i < expr->as.tuple.count; i++) n += count_uses(expr->as.tuple.elements[i], name);
+            return n;
         }
-    } else if (result->type == EXPR_SLICE) {
-        free_expr(result->as.slice.array);
-        free_expr(result->as.slice.start);
-        free_expr(result->as.slice.end);
-        result->as.slice.array = substitute_expr(expr->as.slice.array, params, param_count, args);
-        result->as.slice.start = substitute_expr(expr->as.slice.start, params, param_count, args);
-        result->as.slice.end = substitute_expr(expr->as.slice.end, params, param_count, args);
-    } else if (result->type == EXPR_GET) {
-        free_expr(result->as.get.object);
-        result->as.get.object = substitute_expr(expr->as.get.object, params, param_count, args);
-    } else if (result->type == EXPR_SET) {
-        free_expr(result->as.set.object);
-        free_expr(result->as.set.value);
-        result->as.set.object = substitute_expr(expr->as.set.object, params, param_count, args);
-        result->as.set.value = substitute_expr(expr->as.set.value, params, param_count, args);
-    }
-
-    return result;
+        case EXPR_INDEX: return count_uses(expr->as.index.array, name) + count_uses(expr->as.index.index, name);
+        case EXPR_INDEX_SET:
+            return count_uses(expr->as.index_set.array, name) + count_uses(expr->as.index_set.index, name) +
+                   count_uses(expr->as.index_set.value, name);
+        case EXPR_SLICE:
+            return count_uses(expr->as.slice.array, name) + count_uses(expr->as.slice.start, name) +
+                   count_uses(expr->as.slice.end, name);
+        case EXPR_GET: return count_uses(expr->as.get.object, name);
+        case EXPR_SET: return count_uses(expr->as.set.object, name) + count_uses(expr->as.set.value, name);
+        default: return 0;
+    }
 }
 
-// ============================================================================
-// Inline call expressions
-// ============================================================================
+// An argument that may be evaluated where (and as often as) the parameter is
+// used instead of once at the call: a literal, or a read that nothing in the
+// callee can change.
+static int arg_is_stable(Inliner* inl, const Expr* arg, const InlineCandidate* c) {
+    switch (arg->type) {
+        case EXPR_NUMBER:
+        case EXPR_STRING:
+        case EXPR_BOOL:
+        case EXPR_NIL:
+            return 1;
+        case EXPR_VARIABLE:
+            // Proc locals are out of the callee's reach; globals are not
+            return !c->has_effects ||
+                   (inl->scope_locals != NULL && nameset_count(inl->scope_locals, arg->as.variable.name) > 0);
+        case EXPR_GET:
+            return !c->has_effects && arg_is_stable(inl, arg->as.get.object, c);
+        case EXPR_BINARY:
+            return !c->has_effects && arg_is_stable(inl, arg->as.binary.left, c) &&
+                   (arg->as.binary.right == NULL || arg_is_stable(inl, arg->as.binary.right, c));
+        default:
+            return 0;
+    }
+}
 
-static Expr* inline_expr(Expr* expr, InlineCandidate* candidates) {
+static Expr* substitute_expr(const Expr* expr, Token* params, int param_count, Expr** args);
+
+static void substitute_in_place(Expr** slot, const Expr* orig, Token* params, int param_count, Expr** args) {
+    free_expr(*slot);
+    *slot = substitute_expr(orig, params, param_count, args);
+}
+
+static Expr* substitute_expr(const Expr* expr, Token* params, int param_count, Expr** args) {
     if (expr == NULL) return NULL;
 
-    switch (expr->type) {
-        case EXPR_CALL: {
-            // First inline args and callee
-            expr->as.call.callee = inline_expr(expr->as.call.callee, candidates);
-            for (int i = 0; i < expr->as.call.arg_count; i++) {
-                expr->as.call.args[i] = inline_expr(expr->as.call.args[i], candidates);
-            }
+    if (expr->type == EXPR_VARIABLE) {
+        for (int i = 0; i < param_count; i++) {
+            if (tokens_equal(params[i], expr->as.variable.name)) return clone_expr(args[i]);
+        }
+    }
 
-            // Check if callee is a simple variable name matching a candidate
-            if (expr->as.call.callee->type == EXPR_VARIABLE) {
-                int len = expr->as.call.callee->as.variable.name.length;
-                char* name = SAGE_ALLOC((size_t)len + 1);
-                memcpy(name, expr->as.call.callee->as.variable.name.start, (size_t)len);
-                name[len] = '\0';
-
-                InlineCandidate* c = find_candidate(candidates, name);
-                free(name);
-                if (c != NULL && expr->as.call.arg_count == c->param_count) {
-                    // Perform inlining: substitute params with args in return expr
-                    Expr* inlined = substitute_expr(c->return_expr, c->params,
-                                                     c->param_count, expr->as.call.args);
-                    free_expr(expr);
-                    return inlined;
-                }
-            }
+    Expr* r = clone_expr(expr);
+    switch (r->type) {
+        case EXPR_BINARY:
+            substitute_in_place(&r->as.binary.left, expr->as.binary.left, params, param_count, args);
+            substitute_in_place(&r->as.binary.right, expr->as.binary.right, params, param_count, args);
+            break;
+        case EXPR_CALL:
+            substitute_in_place(&r->as.call.callee, expr->as.call.callee, params, param_count, args);
+            for (int i = 0; i < r->as.call.arg_count; i++)
+                substitute_in_place(&r->as.call.args[i], expr->as.call.args[i], params, param_count, args);
+            break;
+        case EXPR_INDEX:
+            substitute_in_place(&r->as.index.array, expr->as.index.array, params, param_count, args);
+            substitute_in_place(&r->as.index.index, expr->as.index.index, params, param_count, args);
+            break;
+        case EXPR_INDEX_SET:
+            substitute_in_place(&r->as.index_set.array, expr->as.index_set.array, params, param_count, args);
+            substitute_in_place(&r->as.index_set.index, expr->as.index_set.index, params, param_count, args);
+            substitute_in_place(&r->as.index_set.value, expr->as.index_set.value, params, param_count, args);
+            break;
+        case EXPR_ARRAY:
+            for (int i = 0; i < r->as.array.count; i++)
+                substitute_in_place(&r->as.array.elements[i], expr->as.array.elements[i], params, param_count, args);
+            break;
+        case EXPR_DICT:
+            for (int i = 0; i < r->as.dict.count; i++)
+                substitute_in_place(&r->as.dict.values[i], expr->as.dict.values[i], params, param_count, args);
+            break;
+        case EXPR_TUPLE:
+            for (int i = 0; i < r->as.tuple.count; i++)
+                substitute_in_place(&r->as.tuple.elements[i], expr->as.tuple.elements[i], params, param_count, args);
             break;
+        case EXPR_SLICE:
+            substitute_in_place(&r->as.slice.array, expr->as.slice.array, params, param_count, args);
+            substitute_in_place(&r->as.slice.start, expr->as.slice.start, params, param_count, args);
+            substitute_in_place(&r->as.slice.end, expr->as.slice.end, params, param_count, args);
+            break;
+        case EXPR_GET:
+            substitute_in_place(&r->as.get.object, expr->as.get.object, params, param_count, args);
+            break;
+        case EXPR_SET:
+            substitute_in_place(&r->as.set.object, expr->as.set.object, params, param_count, args);
+            substitute_in_place(&r->as.set.value, expr->as.set.value, params, param_count, args);
+            break;
+        default:
+            break;
+    }
+    return r;
+}
+
+static Expr* inline_expr(Inliner* inl, Expr* expr);
+
+// The call's actual arguments in parameter order (receiver first for methods).
+static Expr** call_actuals(Expr* call, Expr* receiver) {
+    int n = call->as.call.arg_count + (receiver ? 1 : 0);
+    Expr** actuals = SAGE_ALLOC(sizeof(Expr*) * (size_t)(n > 0 ? n : 1));
+    int k = 0;
+    if (receiver) actuals[k++] = receiver;
+    for (int i = 0; i < call->as.call.arg_count; i++) actuals[k++] = call->as.call.args[i];
+    return actuals;
+}
+
+static Expr* try_inline_expr(Inliner* inl, Expr* call) {
+    Expr* receiver;
+    InlineCandidate* c = resolve_call(inl, call, &receiver);
+    if (c == NULL || c->return_expr == NULL || captures_differ(inl, c)) return call;
+
+    Expr** actuals = call_actuals(call, receiver);
+    int size = c->size;
+    for (int i = 0; i < c->param_count; i++) {
+        int uses = count_uses(c->return_expr, c->params[i]);
+        if (!arg_is_stable(inl, actuals[i], c) || (uses != 1 && actuals[i]->type == EXPR_CALL)) {
+            free(actuals);
+            return call;
+        }
+        if (uses > 1) {
+            BodyScan arg;
+            memset(&arg, 0, sizeof(arg));
+            scan_expr(&arg, actuals[i]);
+            size += arg.size * (uses - 1);
+            scan_free(&arg);
         }
+    }
+    if (!inline_affordable(inl, call->as.call.callee, size)) {
+        free(actuals);
+        return call;
+    }
+
+    Expr* inlined = substitute_expr(c->return_expr, c->params, c->param_count, actuals);
+    free(actuals);
+    free_expr(call);
+    if (inl->nesting < INLINE_MAX_NESTING) {
+        inl->nesting++;
+        inlined = inline_expr(inl, inlined);
+        inl->nesting--;
+    }
+    return inlined;
+}
+
+static Expr* inline_expr(Inliner* inl, Expr* expr) {
+    if (expr == NULL) return NULL;
+
+    switch (expr->type) {
+        case EXPR_CALL:
+            expr->as.call.callee = inline_expr(inl, expr->as.call.callee);
+            for (int i = 0; i < expr->as.call.arg_count; i++) {
+                expr->as.call.args[i] = inline_expr(inl, expr->as.call.args[i]);
+            }
+            return try_inline_expr(inl, expr);
         case EXPR_BINARY:
-            expr->as.binary.left = inline_expr(expr->as.binary.left, candidates);
-            expr->as.binary.right = inline_expr(expr->as.binary.right, candidates);
+            expr->as.binary.left = inline_expr(inl, expr->as.binary.left);
+            expr->as.binary.right = inline_expr(inl, expr->as.binary.right);
             break;
         case EXPR_ARRAY:
             for (int i = 0; i < expr->as.array.count; i++) {
-                expr->as.array.elements[i] = inline_expr(expr->as.array.elements[i], candidates);
+                expr->as.array.elements[i] = inline_expr(inl, expr->as.array.elements[i]);
             }
             break;
         case EXPR_INDEX:
-            expr->as.index.array = inline_expr(expr->as.index.array, candidates);
-            expr->as.index.index = inline_expr(expr->as.index.index, candidates);
+            expr->as.index.array = inline_expr(inl, expr->as.index.array);
+            expr->as.index.index = inline_expr(inl, expr->as.index.index);
             break;
         case EXPR_INDEX_SET:
-            expr->as.index_set.array = inline_expr(expr->as.index_set.array, candidates);
-            expr->as.index_set.index = inline_expr(expr->as.index_set.index, candidates);
-            expr->as.index_set.value = inline_expr(expr->as.index_set.value, candidates);
+            expr->as.index_set.array = inline_expr(inl, expr->as.index_set.array);
+            expr->as.index_set.index = inline_expr(inl, expr->as.index_set.index);
+            expr->as.index_set.value = inline_expr(inl, expr->as.index_set.value);
             break;
         case EXPR_DICT:
             for (int i = 0; i < expr->as.dict.count; i++) {
-                expr->as.dict.values[i] = inline_expr(expr->as.dict.values[i], candidates);
+                expr->as.dict.values[i] = inline_expr(inl, expr->as.dict.values[i]);
             }
             break;
         case EXPR_TUPLE:
             for (int i = 0; i < expr->as.tuple.count; i++) {
-                expr->as.tuple.elements[i] = inline_expr(expr->as.tuple.elements[i], candidates);
+                expr->as.tuple.elements[i] = inline_expr(inl, expr->as.tuple.elements[i]);
             }
             break;
         case EXPR_SLICE:
-            expr->as.slice.array = inline_expr(expr->as.slice.array, candidates);
-            expr->as.slice.start = inline_expr(expr->as.slice.start, candidates);
-            expr->as.slice.end = inline_expr(expr->as.slice.end, candidates);
+            expr->as.slice.array = inline_expr(inl, expr->as.slice.array);
+            expr->as.slice.start = inline_expr(inl, expr->as.slice.start);
+            expr->as.slice.end = inline_expr(inl, expr->as.slice.end);
             break;
         case EXPR_GET:
-            expr->as.get.object = inline_expr(expr->as.get.object, candidates);
+            expr->as.get.object = inline_expr(inl, expr->as.get.object);
             break;
         case EXPR_SET:
-            expr->as.set.object = inline_expr(expr->as.set.object, candidates);
-            expr->as.set.value = inline_expr(expr->as.set.value, candidates);
-            break;
-        case EXPR_AWAIT:
+            expr->as.set.object = inline_expr(inl, expr->as.set.object);
+            expr->as.set.value = inline_expr(inl, expr->as.set.value);
             break;
         default:
             break;
@@ -318,74 +1007,232 @@ static Expr* inline_expr(Expr* expr, InlineCandidate* candidates) {
     return expr;
 }
 
-static void inline_stmt(Stmt* stmt, InlineCandidate* candidates);
+// ============================================================================
+// Statement inlining
+// ============================================================================
 
-static void inline_stmt_list(Stmt* head, InlineCandidate* candidates) {
-    for (Stmt* s = head; s != NULL; s = s->next) {
-        inline_stmt(s, candidates);
+// The slot holding the call a statement evaluates first and as a whole.
+static Expr** root_call_slot(Stmt* stmt) {
+    Expr** slot = NULL;
+    switch (stmt->type) {
+        case STMT_PRINT:      slot = &stmt->as.print.expression; break;
+        case STMT_LET:        slot = &stmt->as.let.initializer; break;
+        case STMT_RETURN:     slot = &stmt->as.ret.value; break;
+        case STMT_IF:         slot = &stmt->as.if_stmt.condition; break;
+        case STMT_EXPRESSION: {
+            Expr* e = stmt->as.expression;
+            if (e != NULL && e->type == EXPR_SET &&
+                (e->as.set.object == NULL || e->as.set.object->type == EXPR_VARIABLE)) {
+                slot = &e->as.set.value;
+            } else {
+                slot = &stmt->as.expression;
+            }
+            break;
+        }
+        default:
+            return NULL;
     }
+    return (*slot != NULL && (*slot)->type == EXPR_CALL) ? slot : NULL;
 }
 
-static void inline_stmt(Stmt* stmt, InlineCandidate* candidates) {
-    if (stmt == NULL) return;
+static void inline_block(Inliner* inl, Stmt** head);
+
+// Splices the callee of the root call of `stmt` in front of it. Returns the
+// statements to insert, or NULL. `*drop` is set when `stmt` was only the call.
+static Stmt* splice_call(Inliner* inl, Stmt* stmt, int* drop) {
+    Expr** slot = root_call_slot(stmt);
+    if (slot == NULL) return NULL;
+    Expr* call = *slot;
+    Expr* receiver;
+    InlineCandidate* c = resolve_call(inl, call, &receiver);
+    if (c == NULL || !c->splice_ok || captures_differ(inl, c)) return NULL;
+    if (!inline_affordable(inl, call->as.call.callee, c->size + c->param_count)) return NULL;
+
+    int id = inl->next_id++;
+    int used = !(stmt->type == STMT_EXPRESSION && slot == &stmt->as.expression);
+    Token like = c->name;
+    Token ret = inline_name(like, id, (Token){ .start = "ret", .length = 3 });
+
+    Stmt* pre = NULL;
+    Stmt** tail = &pre;
+    Expr** actuals = call_actuals(call, receiver);
+    for (int i = 0; i < c->param_count; i++) {
+        *tail = new_let_stmt(inline_name(c->params[i], id, c->params[i]), actuals[i]);
+        tail = &(*tail)->next;
+    }
+    free(actuals);
+    if (used) {
+        *tail = new_let_stmt(ret, new_nil_expr());
+        tail = &(*tail)->next;
+    }
+    Stmt* body = body_statements(clone_stmt_list(c->body));
+    lower_returns(&body, used ? &ret : NULL);
+    rename_stmts(body, c->locals, id);
+    *tail = body;
 
+    // The arguments now live in the lets above
+    if (receiver != NULL) call->as.call.callee->as.get.object = NULL;
+    call->as.call.arg_count = 0;
+    free_expr(call);
+    *slot = used ? new_variable_expr(ret) : NULL;
+    *drop = !used;
+
+    // A method's receiver keeps its class inside the spliced body
+    Binding* mark = inl->bindings;
+    if (receiver != NULL && nameset_count(c->assigned, c->params[0]) == 0) {
+        push_binding(inl, pre->as.let.name, binding_class(inl, receiver->as.variable.name));
+    }
+    if (inl->nesting < INLINE_MAX_NESTING) {
+        inl->nesting++;
+        inline_block(inl, &pre);
+        inl->nesting--;
+    }
+    pop_bindings(inl, mark);
+    return pre;
+}
+
+static void inline_children(Inliner* inl, Stmt* stmt);
+
+// `let v = Class(...)` makes v's class known for the rest of the block when
+// nothing else ever binds v.
+static void note_binding(Inliner* inl, Stmt* stmt) {
+    if (stmt->type != STMT_LET) return;
+    Expr* init = stmt->as.let.initializer;
+    if (init == NULL || init->type != EXPR_CALL || init->as.call.callee->type != EXPR_VARIABLE) return;
+    InlineClass* cls = find_class(inl->classes, init->as.call.callee->as.variable.name);
+    if (cls == NULL) return;
+    if (nameset_count(inl->scope_decls, stmt->as.let.name) != 1) return;
+    if (nameset_count(inl->program.assigned, stmt->as.let.name) != 0) return;
+    push_binding(inl, stmt->as.let.name, cls);
+}
+
+static void inline_block(Inliner* inl, Stmt** head) {
+    Binding* mark = inl->bindings;
+    Stmt** link = head;
+    while (*link != NULL) {
+        Stmt* stmt = *link;
+        int drop = 0;
+        Stmt* pre = splice_call(inl, stmt, &drop);
+        if (pre != NULL) {
+            Stmt* last = pre;
+            while (last->next != NULL) last = last->next;
+            if (drop) {
+                last->next = stmt->next;
+                stmt->next = NULL;
+                free_stmt(stmt);
+                *link = pre;
+                link = &last->next;
+                continue;
+            }
+            last->next = stmt;
+            *link = pre;
+            link = &last->next;
+        }
+        inline_children(inl, stmt);
+        note_binding(inl, stmt);
+        link = &stmt->next;
+    }
+    pop_bindings(inl, mark);
+}
+
+static void inline_loop_body(Inliner* inl, Stmt** body) {
+    inl->loop_depth++;
+    inline_block(inl, body);
+    inl->loop_depth--;
+}
+
+// A proc or method body: its own scope, declarations and (for a leaf class) `self`.
+static void inline_function(Inliner* inl, Stmt* proc, InlineClass* cls) {
+    BodyScan scan;
+    memset(&scan, 0, sizeof(scan));
+    scan_stmts(&scan, proc->as.proc.body);
+    for (int i = 0; i < proc->as.proc.param_count; i++) scan_declare(&scan, proc->as.proc.params[i]);
+
+    NameSet* outer_locals = inl->scope_locals;
+    NameSet* outer_decls = inl->scope_decls;
+    Binding* outer_bindings = inl->bindings;
+    int outer_depth = inl->loop_depth;
+    inl->scope_locals = scan.mentioned;  // Params, lets and anything it assigns
+    inl->scope_decls = scan.declared;
+    inl->bindings = NULL;
+    inl->loop_depth = 0;
+
+    if (cls != NULL && !cls->has_subclass && proc->as.proc.param_count > 0 &&
+        token_is(proc->as.proc.params[0], "self") && nameset_count(scan.assigned, proc->as.proc.params[0]) == 0) {
+        push_binding(inl, proc->as.proc.params[0], cls);
+    }
+    inline_block(inl, &proc->as.proc.body);
+    pop_bindings(inl, NULL);
+
+    inl->scope_locals = outer_locals;
+    inl->scope_decls = outer_decls;
+    inl->bindings = outer_bindings;
+    inl->loop_depth = outer_depth;
+    scan_free(&scan);
+}
+
+static void inline_children(Inliner* inl, Stmt* stmt) {
     switch (stmt->type) {
         case STMT_PRINT:
-            stmt->as.print.expression = inline_expr(stmt->as.print.expression, candidates);
+            stmt->as.print.expression = inline_expr(inl, stmt->as.print.expression);
             break;
         case STMT_EXPRESSION:
-            stmt->as.expression = inline_expr(stmt->as.expression, candidates);
+            stmt->as.expression = inline_expr(inl, stmt->as.expression);
             break;
         case STMT_LET:
-            stmt->as.let.initializer = inline_expr(stmt->as.let.initializer, candidates);
+            stmt->as.let.initializer = inline_expr(inl, stmt->as.let.initializer);
             break;
         case STMT_IF:
-            stmt->as.if_stmt.condition = inline_expr(stmt->as.if_stmt.condition, candidates);
-            inline_stmt_list(stmt->as.if_stmt.then_branch, candidates);
-            inline_stmt_list(stmt->as.if_stmt.else_branch, candidates);
+            stmt->as.if_stmt.condition = inline_expr(inl, stmt->as.if_stmt.condition);
+            inline_block(inl, &stmt->as.if_stmt.then_branch);
+            inline_block(inl, &stmt->as.if_stmt.else_branch);
             break;
         case STMT_BLOCK:
-            inline_stmt_list(stmt->as.block.statements, candidates);
+            inline_block(inl, &stmt->as.block.statements);
             break;
         case STMT_WHILE:
-            stmt->as.while_stmt.condition = inline_expr(stmt->as.while_stmt.condition, candidates);
-            inline_stmt_list(stmt->as.while_stmt.body, candidates);
+            inl->loop_depth++;
+            stmt->as.while_stmt.condition = inline_expr(inl, stmt->as.while_stmt.condition);
+            inl->loop_depth--;
+            inline_loop_body(inl, &stmt->as.while_stmt.body);
             break;
         case STMT_PROC:
-            inline_stmt_list(stmt->as.proc.body, candidates);
+            inline_function(inl, stmt, NULL);
             break;
         case STMT_FOR:
-            stmt->as.for_stmt.iterable = inline_expr(stmt->as.for_stmt.iterable, candidates);
-            inline_stmt_list(stmt->as.for_stmt.body, candidates);
+            stmt->as.for_stmt.iterable = inline_expr(inl, stmt->as.for_stmt.iterable);
+            inline_loop_body(inl, &stmt->as.for_stmt.body);
             break;
         case STMT_RETURN:
-            stmt->as.ret.value = inline_expr(stmt->as.ret.value, candidates);
+            stmt->as.ret.value = inline_expr(inl, stmt->as.ret.value);
             break;
-        case STMT_CLASS:
-            inline_stmt_list(stmt->as.class_stmt.methods, candidates);
+        case STMT_CLASS: {
+            InlineClass* cls = find_class(inl->classes, stmt->as.class_stmt.name);
+            for (Stmt* m = stmt->as.class_stmt.methods; m != NULL; m = m->next) {
+                if (m->type == STMT_PROC) inline_function(inl, m, cls);
+            }
             break;
+        }
         case STMT_MATCH:
-            stmt->as.match_stmt.value = inline_expr(stmt->as.match_stmt.value, candidates);
+            stmt->as.match_stmt.value = inline_expr(inl, stmt->as.match_stmt.value);
             for (int i = 0; i < stmt->as.match_stmt.case_count; i++) {
-                stmt->as.match_stmt.cases[i]->pattern = inline_expr(stmt->as.match_stmt.cases[i]->pattern, candidates);
-                inline_stmt_list(stmt->as.match_stmt.cases[i]->body, candidates);
+                stmt->as.match_stmt.cases[i]->pattern = inline_expr(inl, stmt->as.match_stmt.cases[i]->pattern);
+                inline_block(inl, &stmt->as.match_stmt.cases[i]->body);
             }
-            inline_stmt_list(stmt->as.match_stmt.default_case, candidates);
+            inline_block(inl, &stmt->as.match_stmt.default_case);
             break;
         case STMT_TRY:
-            inline_stmt_list(stmt->as.try_stmt.try_block, candidates);
+            inline_block(inl, &stmt->as.try_stmt.try_block);
             for (int i = 0; i < stmt->as.try_stmt.catch_count; i++) {
-                inline_stmt_list(stmt->as.try_stmt.catches[i]->body, candidates);
+                inline_block(inl, &stmt->as.try_stmt.catches[i]->body);
             }
-            inline_stmt_list(stmt->as.try_stmt.finally_block, candidates);
+            inline_block(inl, &stmt->as.try_stmt.finally_block);
             break;
         case STMT_RAISE:
-            stmt->as.raise.exception = inline_expr(stmt->as.raise.exception, candidates);
+            stmt->as.raise.exception = inline_expr(inl, stmt->as.raise.exception);
             break;
         case STMT_YIELD:
-            stmt->as.yield_stmt.value = inline_expr(stmt->as.yield_stmt.value, candidates);
-            break;
-        case STMT_ASYNC_PROC:
+            stmt->as.yield_stmt.value = inline_expr(inl, stmt->as.yield_stmt.value);
             break;
         default:
             break;
@@ -396,14 +1243,81 @@ static void inline_stmt(Stmt* stmt, InlineCandidate* candidates) {
 // Pass Entry Point
 // ============================================================================
 
+static void collect_candidates(Inliner* inl, Stmt* program, const PassContext* ctx) {
+    for (Stmt* s = program; s != NULL; s = s->next) {
+        if (s->type == STMT_CLASS) {
+            InlineClass* k = SAGE_ALLOC(sizeof(InlineClass));
+            k->name = s->as.class_stmt.name;
+            k->parent = s->as.class_stmt.parent;
+            k->has_parent = s->as.class_stmt.has_parent;
+            k->has_subclass = 0;
+            k->methods = s->as.class_stmt.methods;
+            k->next = inl->classes;
+            inl->classes = k;
+        }
+    }
+    for (InlineClass* k = inl->classes; k != NULL; k = k->next) {
+        if (!k->has_parent) continue;
+        InlineClass* parent = find_class(inl->classes, k->parent);
+        if (parent != NULL) parent->has_subclass = 1;
+    }
+
+    for (Stmt* s = program; s != NULL; s = s->next) {
+        if (s->type == STMT_PROC) {
+            if (ctx->profile != NULL && profile_function_heat(ctx->profile, &s->as.proc) == PROFILE_HEAT_COLD) continue;
+            InlineCandidate* c = make_candidate(s, 0);
+            if (c != NULL) {
+                c->next = inl->candidates;
+                inl->candidates = c;
+            }
+        } else if (s->type == STMT_CLASS) {
+            for (Stmt* m = s->as.class_stmt.methods; m != NULL; m = m->next) {
+                if (m->type != STMT_PROC || token_is(m->as.proc.name, "init")) continue;
+                if (m->as.proc.param_count == 0) continue;
+                if (ctx->profile != NULL && profile_function_heat(ctx->profile, &m->as.proc) == PROFILE_HEAT_COLD) continue;
+                InlineCandidate* c = make_candidate(m, 1);
+                if (c != NULL) {
+                    c->next = inl->candidates;
+                    inl->candidates = c;
+                }
+            }
+        }
+    }
+}
+
 Stmt* pass_inline(Stmt* program, PassContext* ctx) {
-    (void)ctx;
+    int level = ctx->opt_level > 3 ? 3 : ctx->opt_level;
+    if (level < 2) return program;
+
+    Inliner inl;
+    memset(&inl, 0, sizeof(inl));
+    inl.profile = ctx->profile;
+    inl.budget = g_inline_budgets[level];
+    collect_candidates(&inl, program, ctx);
+    if (inl.candidates == NULL) {
+        free_classes(inl.classes);
+        return program;
+    }
 
-    InlineCandidate* candidates = collect_candidates(program);
-    if (candidates == NULL) return program;
+    scan_program(&inl.program, program);
+    inl.growth_limit = inl.program.size * inl.budget.growth_percent / 100;
+    if (inl.growth_limit < inl.budget.min_growth) inl.growth_limit = inl.budget.min_growth;
 
-    inline_stmt_list(program, candidates);
+    // Top-level declarations, for `let v = Class()` bindings in the script
+    BodyScan top;
+    memset(&top, 0, sizeof(top));
+    scan_stmts(&top, program);
+    inl.scope_decls = top.declared;
 
-    free_candidates(candidates);
+    inline_block(&inl, &program);
+
+    if (ctx->verbose) {
+        fprintf(stderr, "[inline] %d call sites spliced, %d nodes added (budget %d)\n",
+                inl.next_id, inl.growth, inl.growth_limit);
+    }
+    scan_free(&top);
+    scan_free(&inl.program);
+    free_candidates(inl.candidates);
+    free_classes(inl.classes);
     return program;
 }
@@ -21,6 +21,7 @@
 #include "ast.h"
 #include "module.h"  // Phase 8: Module system
 #include "repl.h"    // Phase 12: REPL error recovery
+#include "parallel.h" // parallel_map / parallel_for / parallel_reduce
 
 Environment* g_global_env = NULL;
 #ifdef SAGE_BARE_METAL
@@ -158,6 +159,12 @@ static JitState* g_jit = NULL;
 void interpreter_set_jit(JitState* jit) { g_jit = jit; }
 JitState* interpreter_get_jit(void) { return g_jit; }
 
+// Execution profile — global, set by --profile-out (see profile.h)
+#include "profile.h"
+static SageProfile* g_profile = NULL;
+void interpreter_set_profile(SageProfile* profile) { g_profile = profile; }
+SageProfile* interpreter_get_profile(void) { return g_profile; }
+
 // Recursion depth tracking to prevent stack overflow
 #define MAX_RECURSION_DEPTH 500
 
@@ -1433,7 +1440,9 @@ static Value bytes_set_native(int argCount, Value* args) {
     if (argCount == 3 && args[0].type == VAL_BYTES && IS_NUMBER(args[1]) && IS_NUMBER(args[2])) {
         int idx = (int)AS_NUMBER(args[1]);
         BytesValue* b = args[0].as.bytes;
-        if (idx >= 0 && idx < b->length) {
+        if (b->mapped) {
+            fprintf(stderr, "Runtime Error: Cannot modify read-only mapped bytes.\n");
+        } else if (idx >= 0 && idx < b->length) {
             b->data[idx] = (unsigned char)(int)AS_NUMBER(args[2]);
         }
     }
@@ -2578,6 +2587,12 @@ void init_stdlib(Env* env) {
     env_define_const(env, "sem_wait", 8, val_native(sem_wait_native));
     env_define_const(env, "sem_post", 8, val_native(sem_post_native));
     env_define_const(env, "sem_trywait", 11, val_native(sem_trywait_native));
+
+    // Data-parallel builtins (persistent work-stealing pool)
+    env_define_const(env, "parallel_map", 12, val_native(parallel_map_native));
+    env_define_const(env, "parallel_for", 12, val_native(parallel_for_native));
+    env_define_const(env, "parallel_reduce", 15, val_native(parallel_reduce_native));
+    env_define_const(env, "parallel_workers", 16, val_native(parallel_workers_native));
 }
 
 // --- Helper: Truthiness ---
@@ -2615,35 +2630,47 @@ static ExecResult interpret_inner(Stmt* stmt, Env* env);
 // --- Evaluator ---
 
 static ExecResult eval_binary(BinaryExpr* b, Env* env) {
-    // Phase 19: Quickened path for numeric operations
+    Value left, right;
+
+    // Phase 19: Quickened path for numeric operations. Typecheck seeds the flag
+    // where it proved both operands numbers; a miss falls through to the
+    // generic path with the operands already evaluated.
     if (b->quickened && b->left_is_num && b->right_is_num) {
         ExecResult lr = eval_expr(b->left, env);
         if (lr.is_throwing) return lr;
+        left = lr.value;
+        int left_rooted = !IS_NUMBER(left);  // numbers hold no heap reference
+        if (left_rooted) AST_GC_PUSH(left);
         ExecResult rr = eval_expr(b->right, env);
-        if (rr.is_throwing) return rr;
-        
-        if (IS_NUMBER(lr.value) && IS_NUMBER(rr.value)) {
-            double l = AS_NUMBER(lr.value);
-            double r = AS_NUMBER(rr.value);
+        if (rr.is_throwing) { if (left_rooted) AST_GC_POP(); return rr; }
+        right = rr.value;
+
+        if (!left_rooted && IS_NUMBER(right)) {
+            double l = AS_NUMBER(left);
+            double r = AS_NUMBER(right);
             switch (b->op.type) {
                 case TOKEN_PLUS:  return EVAL_RESULT(val_number(l + r));
                 case TOKEN_MINUS: return EVAL_RESULT(val_number(l - r));
                 case TOKEN_STAR:  return EVAL_RESULT(val_number(l * r));
-                case TOKEN_SLASH: return EVAL_RESULT(r == 0 ? val_nil() : val_number(l / r));
-                case TOKEN_PERCENT: return EVAL_RESULT(r == 0 ? val_nil() : val_number(fmod(l, r)));
+                case TOKEN_SLASH: if (r != 0) return EVAL_RESULT(val_number(l / r)); break;
+                case TOKEN_PERCENT: if (r != 0) return EVAL_RESULT(val_number(fmod(l, r))); break;
                 case TOKEN_GT: return EVAL_RESULT(val_bool(l > r));
                 case TOKEN_LT: return EVAL_RESULT(val_bool(l < r));
                 case TOKEN_GTE: return EVAL_RESULT(val_bool(l >= r));
                 case TOKEN_LTE: return EVAL_RESULT(val_bool(l <= r));
                 default: break;
             }
+            // Division by zero: the generic path reports it
+        } else {
+            b->quickened = 0; // De-optimize if types changed
         }
-        b->quickened = 0; // De-optimize if types changed
+        if (!left_rooted) AST_GC_PUSH(left);  // the generic path pops it
+        goto operands_ready;
     }
 
     ExecResult left_result = eval_expr(b->left, env);
     if (left_result.is_throwing) return left_result;
-    Value left = left_result.value;
+    left = left_result.value;
 
     if (b->op.type == TOKEN_NOT) {
         return EVAL_RESULT(val_bool(!is_truthy(left)));
@@ -2684,8 +2711,9 @@ static ExecResult eval_binary(BinaryExpr* b, Env* env) {
 
     ExecResult right_result = eval_expr(b->right, env);
     if (right_result.is_throwing) { AST_GC_POP(); return right_result; }
-    Value right = right_result.value;
+    right = right_result.value;
 
+operands_ready:
     if (b->op.type == TOKEN_EQ || b->op.type == TOKEN_NEQ) {
         int equal;
         // __eq__ hook: check if left operand has custom equality method
@@ -3000,7 +3028,9 @@ static ExecResult eval_expr(Expr* expr, Env* env) {
                 result = EVAL_RESULT(value);
             } else if (arr.type == VAL_BYTES && IS_NUMBER(idx)) {
                 int index = (int)AS_NUMBER(idx);
-                if (index >= 0 && index < arr.as.bytes->length) {
+                if (arr.as.bytes->mapped) {
+                    fprintf(stderr, "Runtime Error: Cannot modify read-only mapped bytes.\n");
+                } else if (index >= 0 && index < arr.as.bytes->length) {
                     arr.as.bytes->data[index] = (unsigned char)(int)AS_NUMBER(value);
                 }
                 result = EVAL_RESULT(value);
@@ -3102,8 +3132,8 @@ static ExecResult eval_expr(Expr* expr, Env* env) {
                 if (val_result.is_throwing) return val_result;
                 Value value = val_result.value;
 
-                // Inline caching for variable assignment
-                if (expr->as.set.cached_env_id == env->id) {
+                // Inline caching for variable assignment (not shared across parallel tasks)
+                if (!PARALLEL_IN_TASK() && expr->as.set.cached_env_id == env->id) {
                     EnvNode* node = expr->as.set.cached_node;
                     if (gc.mode == GC_MODE_ARC || gc.mode == GC_MODE_ORC) {
                         arc_assign_value(&node->value, value);
@@ -3118,7 +3148,7 @@ static ExecResult eval_expr(Expr* expr, Env* env) {
                 Env* found_env = NULL;
                 EnvNode* found_node = NULL;
                 if (env_get_node(env, var_name.start, var_name.length, &found_env, &found_node)) {
-                    if (found_env == env) {
+                    if (found_env == env && !PARALLEL_IN_TASK()) {
                         expr->as.set.cached_env_id = env->id;
                         expr->as.set.cached_node = found_node;
                     }
@@ -3182,8 +3212,8 @@ static ExecResult eval_expr(Expr* expr, Env* env) {
             return eval_binary(&expr->as.binary, env);
 
         case EXPR_VARIABLE: {
-            // Inline caching for variable lookup
-            if (expr->as.variable.cached_env_id == env->id) {
+            // Inline caching for variable lookup (not shared across parallel tasks)
+            if (!PARALLEL_IN_TASK() && expr->as.variable.cached_env_id == env->id) {
                 return EVAL_RESULT(expr->as.variable.cached_node->value);
             }
 
@@ -3193,7 +3223,7 @@ static ExecResult eval_expr(Expr* expr, Env* env) {
             EnvNode* found_node = NULL;
             if (env_get_node(env, t.start, t.length, &found_env, &found_node)) {
                 // Only cache if found in the current environment (most frequent case in loops)
-                if (found_env == env) {
+                if (found_env == env && !PARALLEL_IN_TASK()) {
                     expr->as.variable.cached_env_id = env->id;
                     expr->as.variable.cached_node = found_node;
                 }
@@ -3214,6 +3244,10 @@ static ExecResult eval_expr(Expr* expr, Env* env) {
 
                 if (IS_INSTANCE(object)) {
                     Token method_token = callee_expr->as.get.property;
+                    if (g_profile) {
+                        ClassValue* cls = object.as.instance->class_def;
+                        profile_record_site(g_profile, callee_expr, cls->name, cls->name_len);
+                    }
 
                     Method* method = class_find_method(object.as.instance->class_def, method_token.start, method_token.length);
                     if (!method) {
@@ -3297,8 +3331,10 @@ static ExecResult eval_expr(Expr* expr, Env* env) {
 #endif
                     }
 
+                    if (g_profile) profile_record_call(g_profile, method_stmt, method_stmt->param_count - param_start, eval_args);
                     if (eval_args) free(eval_args);
                     ExecResult res = interpret(method_stmt->body, method_env);
+                    if (g_profile && !res.is_throwing) profile_record_return(g_profile, method_stmt, res.value);
                     AST_GC_POP_ENV();
                     AST_GC_POP_N(1 + pushed_args);
                     if (res.is_throwing) return res;
@@ -3541,6 +3577,11 @@ static ExecResult eval_expr(Expr* expr, Env* env) {
                     env_define_const(scope, paramName.start, paramName.length, eval_args[i]);
                 }
 
+                if (g_profile) {
+                    profile_record_site(g_profile, callee_expr, NULL, 0);
+                    profile_record_call(g_profile, func, func->param_count, eval_args);
+                }
+
                 // JIT: Profile this call and check if we should compile.
                 int func_id = -1;
                 if (g_jit && g_jit->enabled) {
@@ -3583,6 +3624,7 @@ jitted:
                 if (g_jit && func_id >= 0 && !res.is_throwing) {
                     jit_record_return(g_jit, func_id, res.value);
                 }
+                if (g_profile && !res.is_throwing) profile_record_return(g_profile, func, res.value);
 
                 if (res.is_throwing) return res;
                 return EVAL_RESULT(res.value);
@@ -3734,6 +3776,73 @@ jitted:
     }
 }
 
+// `for v in range(...)` calling the builtin range(): steps through the range
+// directly instead of materializing it as an array (which, for large ranges,
+// would also trip the allocation limit). Returns 0 when `stmt` is not such a
+// loop; otherwise stores the loop's result in *out.
+static int interpret_range_for(Stmt* stmt, Env* env, ExecResult* out) {
+    Expr* iterable = stmt->as.for_stmt.iterable;
+    if (iterable->type != EXPR_CALL || iterable->as.call.callee->type != EXPR_VARIABLE) return 0;
+    int argc = iterable->as.call.arg_count;
+    Token callee = iterable->as.call.callee->as.variable.name;
+    if (argc < 1 || argc > 3 || callee.length != 5 || memcmp(callee.start, "range", 5) != 0) return 0;
+    Value fn;
+    if (!env_get(env, "range", 5, &fn) || fn.type != VAL_NATIVE || fn.as.native != range_native) return 0;
+
+    Value bounds[3];
+    for (int i = 0; i < argc; i++) {
+        ExecResult arg = eval_expr(iterable->as.call.args[i], env);
+        if (arg.is_throwing) {
+            *out = arg;
+            return 1;
+        }
+        bounds[i] = arg.value;
+    }
+    int valid = 1;
+    for (int i = 0; i < argc; i++) valid = valid && IS_NUMBER(bounds[i]);
+    int start = 0, end = 0, step = 1;
+    if (valid) {
+        start = argc > 1 ? (int)AS_NUMBER(bounds[0]) : 0;
+        end = (int)AS_NUMBER(bounds[argc > 1 ? 1 : 0]);
+        step = argc == 3 ? (int)AS_NUMBER(bounds[2]) : 1;
+    }
+    *out = (ExecResult){ val_nil(), 0, 0, 0, 0, val_nil(), 0, NULL, 0, 0 };
+    if (!valid || step == 0) {
+        // range() returns nil here
+        fprintf(stderr, "Runtime Error: for loop iterable must be an array, tuple, or dict.\n");
+        return 1;
+    }
+
+    Env* loop_env = env_create(env);
+    AST_GC_PUSH_ENV(loop_env);
+    Token var = stmt->as.for_stmt.variable;
+    EnvNode* var_slot = NULL;
+    int profiled_loop = g_profile ? profile_loop_enter(g_profile, &stmt->as.for_stmt.variable) : -1;
+    for (long long i = start; step > 0 ? i < end : i > end; i += step) {
+        if (profiled_loop >= 0) profile_loop_iterate(g_profile, profiled_loop);
+        if (var_slot == NULL) {
+            env_define_const(loop_env, var.start, var.length, val_number((double)i));
+            var_slot = loop_env->head;
+        } else {
+            var_slot->value = val_number((double)i);
+        }
+
+        ExecResult res = interpret(stmt->as.for_stmt.body, loop_env);
+        if (res.is_returning || res.is_throwing) {
+            *out = res;
+            break;
+        }
+        if (res.is_yielding) {
+            if (res.next_stmt == NULL) res.next_stmt = stmt;
+            *out = res;
+            break;
+        }
+        if (res.is_breaking) break;
+    }
+    AST_GC_POP_ENV();
+    return 1;
+}
+
 ExecResult interpret(Stmt* stmt, Env* env) {
     if (++g_recursion_depth > MAX_RECURSION_DEPTH) {
         g_recursion_depth--;
@@ -3882,8 +3991,10 @@ static ExecResult interpret_inner(Stmt* stmt, Env* env) {
         case STMT_IF: {
             ExecResult cond_result = eval_expr(stmt->as.if_stmt.condition, env);
             if (cond_result.is_throwing) return cond_result;
-            
-            if (is_truthy(cond_result.value)) {
+            int taken = is_truthy(cond_result.value);
+            if (g_profile) profile_record_branch(g_profile, stmt->as.if_stmt.condition, taken);
+
+            if (taken) {
                 return interpret(stmt->as.if_stmt.then_branch, env);
             } else if (stmt->as.if_stmt.else_branch != NULL) {
                 return interpret(stmt->as.if_stmt.else_branch, env);
@@ -3893,6 +4004,7 @@ static ExecResult interpret_inner(Stmt* stmt, Env* env) {
 
         case STMT_WHILE: {
             int iterations = 0;
+            int profiled_loop = g_profile ? profile_loop_enter(g_profile, profile_anchor(stmt->as.while_stmt.condition)) : -1;
             while (1) {
                 if (++iterations > MAX_LOOP_ITERATIONS) {
                     fprintf(stderr, "Runtime Error: While loop exceeded maximum iterations (%d).\n", MAX_LOOP_ITERATIONS);
@@ -3901,6 +4013,7 @@ static ExecResult interpret_inner(Stmt* stmt, Env* env) {
                 ExecResult cond_result = eval_expr(stmt->as.while_stmt.condition, env);
                 if (cond_result.is_throwing) return cond_result;
                 if (!is_truthy(cond_result.value)) break;
+                if (profiled_loop >= 0) profile_loop_iterate(g_profile, profiled_loop);
 
                 ExecResult res = interpret(stmt->as.while_stmt.body, env);
                 if (res.is_returning || res.is_throwing) return res;
@@ -3919,6 +4032,8 @@ static ExecResult interpret_inner(Stmt* stmt, Env* env) {
         }
 
         case STMT_FOR: {
+            ExecResult range_result;
+            if (interpret_range_for(stmt, env, &range_result)) return range_result;
             ExecResult iter_result = eval_expr(stmt->as.for_stmt.iterable, env);
             if (iter_result.is_throwing) return iter_result;
             Value iterable = iter_result.value;
@@ -3959,10 +4074,12 @@ static ExecResult interpret_inner(Stmt* stmt, Env* env) {
                 }
             }
 
+            int profiled_loop = g_profile ? profile_loop_enter(g_profile, &stmt->as.for_stmt.variable) : -1;
             if (count > 0) {
                 env_define_const(loop_env, var.start, var.length, elements[0]);
                 EnvNode* var_slot = loop_env->head;
                 for (int i = 0; i < count; i++) {
+                    if (profiled_loop >= 0) profile_loop_iterate(g_profile, profiled_loop);
                     if (i > 0) {
                         GC_WRITE_BARRIER(var_slot->value);
                         var_slot->value = elements[i];
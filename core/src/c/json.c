@@ -0,0 +1,932 @@
+// src/json.c - Native JSON module for SageLang
+//
+// Provides: _json (the parser, printers and pull reader behind lib/json.sage)
+//
+// lib/json.sage keeps the cJSON-style API and calls into this module for the
+// per-character work. The parser is a single pass that writes straight into
+// arrays and dicts (parse) or into cJSON node instances (parse_nodes), with
+// the same acceptance rules as the old Sage parser. reader()/open() walk a
+// document one event at a time without building it; open() reads the file
+// in fixed-size chunks, so memory stays O(nesting + longest token).
+
+#define _DEFAULT_SOURCE
+#include "module.h"
+#include "value.h"
+#include "env.h"
+#include "gc.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+
+// Node types and nesting limit, matching the constants in lib/json.sage
+enum {
+    JSON_FALSE = 1,
+    JSON_TRUE = 2,
+    JSON_NULL = 4,
+    JSON_NUMBER = 8,
+    JSON_STRING = 16,
+    JSON_ARRAY = 32,
+    JSON_OBJECT = 64,
+    JSON_RAW = 128
+};
+
+#define JSON_NESTING_LIMIT 1000
+#define JSON_PRINT_DEPTH_LIMIT 10000   // guards the printers against cyclic trees
+#define JSON_CHUNK_SIZE 65536
+
+#define JSON_SET(node, field, v) instance_set_field(node, field, (int)sizeof(field) - 1, v)
+#define JSON_GET(node, field) instance_get_field(node, field, (int)sizeof(field) - 1)
+
+// ============================================================================
+// Growable byte buffer
+// ============================================================================
+
+typedef struct {
+    char* data;
+    size_t len;
+    size_t cap;
+} JsonBuf;
+
+static void json_buf_reserve(JsonBuf* b, size_t extra) {
+    if (b->len + extra <= b->cap) return;
+    size_t cap = b->cap ? b->cap : 256;
+    while (cap < b->len + extra) cap *= 2;
+    b->data = SAGE_REALLOC(b->data, cap);
+    b->cap = cap;
+}
+
+static void json_buf_put(JsonBuf* b, const char* s, size_t n) {
+    if (n == 0) return;
+    json_buf_reserve(b, n);
+    memcpy(b->data + b->len, s, n);
+    b->len += n;
+}
+
+static void json_buf_putc(JsonBuf* b, char c) {
+    json_buf_reserve(b, 1);
+    b->data[b->len++] = c;
+}
+
+static void json_buf_fill(JsonBuf* b, char c, size_t n) {
+    json_buf_reserve(b, n);
+    memset(b->data + b->len, c, n);
+    b->len += n;
+}
+
+static Value json_buf_take(JsonBuf* b) {
+    if (b->len > INT_MAX) {
+        fprintf(stderr, "Runtime Error: JSON output exceeds 2 GB.\n");
+        free(b->data);
+        return val_nil();
+    }
+    Value v = val_string_len(b->data ? b->data : "", (int)b->len);
+    free(b->data);
+    return v;
+}
+
+// ============================================================================
+// Scanner
+// ============================================================================
+
+typedef struct {
+    const char* p;
+    const char* end;
+    FILE* f;            // open(): refilled from here; NULL for in-memory text
+    char* chunk;        // reader-owned input (file window or copied text)
+    size_t consumed;    // bytes in earlier file chunks, for error offsets
+    int depth;
+    JsonBuf text;       // decoded string or number being scanned
+} JsonScanner;
+
+static int json_refill(JsonScanner* s) {
+    if (!s->f) return 0;
+    s->consumed += (size_t)(s->end - s->chunk);
+    size_t n = fread(s->chunk, 1, JSON_CHUNK_SIZE, s->f);
+    s->p = s->chunk;
+    s->end = s->chunk + n;
+    return n > 0;
+}
+
+#define JSON_MORE(s) ((s)->p < (s)->end || json_refill(s))
+
+static void json_skip_ws(JsonScanner* s) {
+    for (;;) {
+        while (s->p < s->end) {
+            char c = *s->p;
+            if (c != ' ' && c != '\n' && c != '\r' && c != '\t') return;
+            s->p++;
+        }
+        if (!json_refill(s)) return;
+    }
+}
+
+#define JSON_LSB 0x0101010101010101ULL
+#define JSON_MSB 0x8080808080808080ULL
+
+// Nonzero when some byte of w equals the byte repeated in pattern
+static inline uint64_t json_word_has(uint64_t w, uint64_t pattern) {
+    uint64_t x = w ^ pattern;
+    return (x - JSON_LSB) & ~x & JSON_MSB;
+}
+
+// Skip the bytes a string copies verbatim: everything before the next quote
+// or backslash. Eight bytes are tested per step; the byte loop then finds the
+// exact stop (the word test can report a false hit above a real one, never
+// miss one).
+static const char* json_plain_run(const char* p, const char* end) {
+    while (end - p >= 8) {
+        uint64_t w;
+        memcpy(&w, p, 8);
+        if (json_word_has(w, JSON_LSB * '"') | json_word_has(w, JSON_LSB * '\\')) break;
+        p += 8;
+    }
+    while (p < end && *p != '"' && *p != '\\') p++;
+    return p;
+}
+
+// Decode the string at the opening quote, appending its bytes to out.
+// As in lib/json.sage, \uXXXX below 128 becomes that byte and anything above
+// becomes "?", and an unknown escape yields the escaped character itself.
+static int json_scan_string(JsonScanner* s, JsonBuf* out) {
+    s->p++;
+    for (;;) {
+        const char* run = json_plain_run(s->p, s->end);
+        json_buf_put(out, s->p, (size_t)(run - s->p));
+        s->p = run;
+        if (s->p == s->end) {
+            if (!json_refill(s)) return 0;
+            continue;
+        }
+        if (*s->p++ == '"') return 1;
+        if (!JSON_MORE(s)) return 0;
+        char esc = *s->p++;
+        switch (esc) {
+            case 'n': json_buf_putc(out, '\n'); break;
+            case 'r': json_buf_putc(out, '\r'); break;
+            case 't': json_buf_putc(out, '\t'); break;
+            case 'b': json_buf_putc(out, '\b'); break;
+            case 'f': json_buf_putc(out, '\f'); break;
+            case 'u': {
+                int code = 0;
+                for (int i = 0; i < 4 && JSON_MORE(s); i++) {
+                    char h = *s->p++;
+                    code *= 16;
+                    if (h >= '0' && h <= '9') code += h - '0';
+                    else if (h >= 'a' && h <= 'f') code += 10 + h - 'a';
+                    else if (h >= 'A' && h <= 'F') code += 10 + h - 'A';
+                }
+                if (code >= 128) json_buf_putc(out, '?');
+                else if (code > 0) json_buf_putc(out, (char)code);
+                break;
+            }
+            default: json_buf_putc(out, esc); break;
+        }
+    }
+}
+
+static void json_scan_digits(JsonScanner* s) {
+    while (JSON_MORE(s) && *s->p >= '0' && *s->p <= '9') json_buf_putc(&s->text, *s->p++);
+}
+
+// Scan -?digits(.digits)?([eE][+-]?digits)? and convert the span like
+// tonumber() does; the span is copied so strtod cannot read past it.
+static double json_scan_number(JsonScanner* s) {
+    s->text.len = 0;
+    if (JSON_MORE(s) && *s->p == '-') json_buf_putc(&s->text, *s->p++);
+    json_scan_digits(s);
+    if (JSON_MORE(s) && *s->p == '.') {
+        json_buf_putc(&s->text, *s->p++);
+        json_scan_digits(s);
+    }
+    if (JSON_MORE(s) && (*s->p == 'e' || *s->p == 'E')) {
+        json_buf_putc(&s->text, *s->p++);
+        if (JSON_MORE(s) && (*s->p == '+' || *s->p == '-')) json_buf_putc(&s->text, *s->p++);
+        json_scan_digits(s);
+    }
+    json_buf_putc(&s->text, '\0');
+    return strtod(s->text.data, NULL);
+}
+
+static int json_scan_word(JsonScanner* s, const char* word) {
+    for (; *word; word++) {
+        if (!JSON_MORE(s) || *s->p != *word) return 0;
+        s->p++;
+    }
+    return 1;
+}
+
+static size_t json_offset(const JsonScanner* s) {
+    return s->consumed + (size_t)(s->p - s->chunk);
+}
+
+// ============================================================================
+// Tree parser
+// ============================================================================
+
+typedef struct {
+    JsonScanner s;
+    ClassValue* node_class;   // parse_nodes: build cJSON instances, else plain values
+    JsonBuf keys;             // keys of the objects being parsed, innermost last
+} JsonParser;
+
+// A node carrying the fields cJSON.init() assigns, in the same order
+static InstanceValue* json_node_new(ClassValue* cls, int type) {
+    InstanceValue* node = instance_create(cls);
+    JSON_SET(node, "next", val_nil());
+    JSON_SET(node, "prev", val_nil());
+    JSON_SET(node, "child", val_nil());
+    JSON_SET(node, "last_child", val_nil());
+    JSON_SET(node, "count", val_number(0));
+    JSON_SET(node, "type", val_number(type));
+    JSON_SET(node, "valuestring", val_nil());
+    JSON_SET(node, "valueint", val_number(0));
+    JSON_SET(node, "valuedouble", val_number(0));
+    JSON_SET(node, "string", val_nil());
+    JSON_SET(node, "string_lower", val_nil());
+    return node;
+}
+
+static Value json_node_scalar(ClassValue* cls, int type, Value v) {
+    InstanceValue* node = json_node_new(cls, type);
+    if (type == JSON_STRING) {
+        JSON_SET(node, "valuestring", v);
+    } else if (type == JSON_NUMBER) {
+        JSON_SET(node, "valuedouble", v);
+        JSON_SET(node, "valueint", v);
+    }
+    return val_instance(node);
+}
+
+// Append item to a node's child list; *last tracks the tail
+static void json_node_link(InstanceValue* parent, InstanceValue** last, Value item) {
+    if (*last == NULL) {
+        JSON_SET(parent, "child", item);
+    } else {
+        JSON_SET(*last, "next", item);
+        JSON_SET(AS_INSTANCE(item), "prev", val_instance(*last));
+    }
+    *last = AS_INSTANCE(item);
+}
+
+static void json_node_close(InstanceValue* node, InstanceValue* last, int count) {
+    JSON_SET(node, "count", val_number(count));
+    JSON_SET(node, "last_child", last ? val_instance(last) : val_nil());
+}
+
+static Value json_scalar(JsonParser* jp, int type, Value v) {
+    return jp->node_class ? json_node_scalar(jp->node_class, type, v) : v;
+}
+
+static int json_parse_value(JsonParser* jp, Value* out);
+
+static int json_parse_array(JsonParser* jp, Value* out) {
+    JsonScanner* s = &jp->s;
+    s->p++;
+    InstanceValue* node = NULL;
+    if (jp->node_class) {
+        node = json_node_new(jp->node_class, JSON_ARRAY);
+        *out = val_instance(node);
+    } else {
+        *out = val_array();
+    }
+    json_skip_ws(s);
+    if (JSON_MORE(s) && *s->p == ']') {
+        s->p++;
+        return 1;
+    }
+
+    InstanceValue* last = NULL;
+    int count = 0;
+    for (;;) {
+        Value item;
+        if (!json_parse_value(jp, &item)) return 0;
+        if (node) json_node_link(node, &last, item);
+        else array_push(out, item);
+        count++;
+
+        json_skip_ws(s);
+        if (!JSON_MORE(s)) return 0;
+        char c = *s->p++;
+        if (c == ']') break;
+        if (c != ',') return 0;
+    }
+    if (node) json_node_close(node, last, count);
+    return 1;
+}
+
+static int json_parse_object(JsonParser* jp, Value* out) {
+    JsonScanner* s = &jp->s;
+    s->p++;
+    InstanceValue* node = NULL;
+    if (jp->node_class) {
+        node = json_node_new(jp->node_class, JSON_OBJECT);
+        *out = val_instance(node);
+    } else {
+        *out = val_dict();
+    }
+    json_skip_ws(s);
+    if (JSON_MORE(s) && *s->p == '}') {
+        s->p++;
+        return 1;
+    }
+
+    InstanceValue* last = NULL;
+    int count = 0;
+    for (;;) {
+        // The key stays in jp->keys (by offset: nested objects may grow it)
+        // until its value has been parsed.
+        json_skip_ws(s);
+        if (!JSON_MORE(s) || *s->p != '"') return 0;
+        size_t key_at = jp->keys.len;
+        if (!json_scan_string(s, &jp->keys)) return 0;
+        int key_len = (int)(jp->keys.len - key_at);
+        json_skip_ws(s);
+        if (!JSON_MORE(s) || *s->p != ':') return 0;
+        s->p++;
+
+        Value item;
+        if (!json_parse_value(jp, &item)) return 0;
+        if (node) {
+            JSON_SET(AS_INSTANCE(item), "string", val_string_len(jp->keys.data + key_at, key_len));
+            json_node_link(node, &last, item);
+        } else {
+            dict_set_len(out, jp->keys.data + key_at, key_len, item);
+        }
+        jp->keys.len = key_at;
+        count++;
+
+        json_skip_ws(s);
+        if (!JSON_MORE(s)) return 0;
+        char c = *s->p++;
+        if (c == '}') break;
+        if (c != ',') return 0;
+    }
+    if (node) json_node_close(node, last, count);
+    return 1;
+}
+
+static int json_parse_value(JsonParser* jp, Value* out) {
+    JsonScanner* s = &jp->s;
+    if (++s->depth > JSON_NESTING_LIMIT) return 0;
+    json_skip_ws(s);
+    if (!JSON_MORE(s)) return 0;
+
+    int ok = 1;
+    char c = *s->p;
+    switch (c) {
+        case '"':
+            s->text.len = 0;
+            ok = json_scan_string(s, &s->text);
+            if (ok) {
+                *out = json_scalar(jp, JSON_STRING,
+                                   val_string_len(s->text.data ? s->text.data : "", (int)s->text.len));
+            }
+            break;
+        case '{': ok = json_parse_object(jp, out); break;
+        case '[': ok = json_parse_array(jp, out); break;
+        case 't':
+            ok = json_scan_word(s, "true");
+            if (ok) *out = jp->node_class ? json_node_scalar(jp->node_class, JSON_TRUE, val_nil()) : val_bool(1);
+            break;
+        case 'f':
+            ok = json_scan_word(s, "false");
+            if (ok) *out = jp->node_class ? json_node_scalar(jp->node_class, JSON_FALSE, val_nil()) : val_bool(0);
+            break;
+        case 'n':
+            ok = json_scan_word(s, "null");
+            if (ok) *out = json_scalar(jp, JSON_NULL, val_nil());
+            break;
+        default:
+            if (c == '-' || (c >= '0' && c <= '9')) *out = json_scalar(jp, JSON_NUMBER, val_number(json_scan_number(s)));
+            else ok = 0;
+            break;
+    }
+    s->depth--;
+    return ok;
+}
+
+// Parse a whole document; trailing text after the first value is ignored,
+// and any syntax error or nesting past the limit yields nil.
+static Value json_parse_document(const char* text, ClassValue* node_class) {
+    JsonParser jp;
+    memset(&jp, 0, sizeof(jp));
+    jp.s.p = text;
+    jp.s.end = text + strlen(text);
+    jp.node_class = node_class;
+
+    gc_pin();
+    Value result;
+    int ok = json_parse_value(&jp, &result);
+    gc_unpin();
+
+    free(jp.s.text.data);
+    free(jp.keys.data);
+    return ok ? result : val_nil();
+}
+
+// ============================================================================
+// Printers
+// ============================================================================
+
+// Numbers print the way str() formats them
+static void json_put_number(JsonBuf* b, double n) {
+    char tmp[64];
+    int len;
+    if (n >= -9007199254740992.0 && n <= 9007199254740992.0 && n == (long long)n) {
+        len = snprintf(tmp, sizeof(tmp), "%lld", (long long)n);
+    } else {
+        len = snprintf(tmp, sizeof(tmp), "%g", n);
+    }
+    json_buf_put(b, tmp, (size_t)len);
+}
+
+// Quote s, escaping the same characters as lib/json.sage did
+static void json_put_string(JsonBuf* b, const char* s) {
+    json_buf_putc(b, '"');
+    const char* run = s;
+    for (;; s++) {
+        const char* esc;
+        switch (*s) {
+            case '\0': json_buf_put(b, run, (size_t)(s - run)); json_buf_putc(b, '"'); return;
+            case '\\': esc = "\\\\"; break;
+            case '"': esc = "\\\""; break;
+            case '\n': esc = "\\n"; break;
+            case '\r': esc = "\\r"; break;
+            case '\t': esc = "\\t"; break;
+            case '\b': esc = "\\b"; break;
+            case '\f': esc = "\\f"; break;
+            default: continue;
+        }
+        json_buf_put(b, run, (size_t)(s - run));
+        json_buf_put(b, esc, 2);
+        run = s + 1;
+    }
+}
+
+static void json_put_open(JsonBuf* b, char open, int fmt) {
+    json_buf_putc(b, open);
+    if (fmt) json_buf_putc(b, '\n');
+}
+
+static void json_put_item_start(JsonBuf* b, int first, int fmt, int depth) {
+    if (!first) json_buf_put(b, fmt ? ",\n" : ",", fmt ? 2 : 1);
+    if (fmt) json_buf_fill(b, ' ', (size_t)(depth + 1) * 4);
+}
+
+static void json_put_key(JsonBuf* b, const char* key, int fmt) {
+    json_put_string(b, key);
+    json_buf_put(b, fmt ? ": " : ":", fmt ? 2 : 1);
+}
+
+static void json_put_close(JsonBuf* b, char close, int fmt, int depth) {
+    if (fmt) {
+        json_buf_putc(b, '\n');
+        json_buf_fill(b, ' ', (size_t)depth * 4);
+    }
+    json_buf_putc(b, close);
+}
+
+static int json_node_type(InstanceValue* node) {
+    Value t = JSON_GET(node, "type");
+    if (!IS_NUMBER(t) || AS_NUMBER(t) != (int)AS_NUMBER(t)) return -1;
+    return (int)AS_NUMBER(t);
+}
+
+static const char* json_node_text(InstanceValue* node, const char* field, int len) {
+    Value v = instance_get_field(node, field, len);
+    return IS_STRING(v) ? AS_STRING(v) : "";
+}
+
+// Serialize a cJSON node tree exactly as _print_node in lib/json.sage did:
+// four-space indentation when formatted, children in list order.
+static void json_print_node(JsonBuf* b, Value item, int fmt, int depth) {
+    if (!IS_INSTANCE(item) || depth > JSON_PRINT_DEPTH_LIMIT) {
+        json_buf_put(b, "null", 4);
+        return;
+    }
+    InstanceValue* node = AS_INSTANCE(item);
+    int type = json_node_type(node);
+    switch (type) {
+        case JSON_NULL: json_buf_put(b, "null", 4); return;
+        case JSON_FALSE: json_buf_put(b, "false", 5); return;
+        case JSON_TRUE: json_buf_put(b, "true", 4); return;
+        case JSON_NUMBER: {
+            Value n = JSON_GET(node, "valuedouble");
+            if (IS_NUMBER(n)) json_put_number(b, AS_NUMBER(n));
+            else if (IS_STRING(n)) json_buf_put(b, AS_STRING(n), strlen(AS_STRING(n)));
+            else json_buf_put(b, "null", 4);
+            return;
+        }
+        case JSON_STRING: json_put_string(b, json_node_text(node, "valuestring", 11)); return;
+        case JSON_RAW: {
+            const char* raw = json_node_text(node, "valuestring", 11);
+            json_buf_put(b, raw, strlen(raw));
+            return;
+        }
+        case JSON_ARRAY:
+        case JSON_OBJECT: {
+            Value child = JSON_GET(node, "child");
+            if (!IS_INSTANCE(child)) {
+                json_buf_put(b, type == JSON_ARRAY ? "[]" : "{}", 2);
+                return;
+            }
+            json_put_open(b, type == JSON_ARRAY ? '[' : '{', fmt);
+            for (int first = 1; IS_INSTANCE(child); first = 0) {
+                json_put_item_start(b, first, fmt, depth);
+                if (type == JSON_OBJECT) json_put_key(b, json_node_text(AS_INSTANCE(child), "string", 6), fmt);
+                json_print_node(b, child, fmt, depth + 1);
+                child = JSON_GET(AS_INSTANCE(child), "next");
+            }
+            json_put_close(b, type == JSON_ARRAY ? ']' : '}', fmt, depth);
+            return;
+        }
+        default: return;
+    }
+}
+
+// Serialize a plain Sage value the way cJSON_Print(cJSON_FromSage(v)) does:
+// dicts in iteration order, anything without a JSON form as null.
+static void json_print_value(JsonBuf* b, Value v, int fmt, int depth) {
+    if (depth > JSON_PRINT_DEPTH_LIMIT) {
+        json_buf_put(b, "null", 4);
+        return;
+    }
+    switch (v.type) {
+        case VAL_BOOL:
+            if (AS_BOOL(v)) json_buf_put(b, "true", 4);
+            else json_buf_put(b, "false", 5);
+            return;
+        case VAL_NUMBER: json_put_number(b, AS_NUMBER(v)); return;
+        case VAL_STRING: json_put_string(b, AS_STRING(v)); return;
+        case VAL_ARRAY: {
+            ArrayValue* arr = AS_ARRAY(v);
+            if (arr->count == 0) {
+                json_buf_put(b, "[]", 2);
+                return;
+            }
+            json_put_open(b, '[', fmt);
+            for (int i = 0; i < arr->count; i++) {
+                json_put_item_start(b, i == 0, fmt, depth);
+                json_print_value(b, arr->elements[i], fmt, depth + 1);
+            }
+            json_put_close(b, ']', fmt, depth);
+            return;
+        }
+        case VAL_DICT: {
+            DictValue* d = AS_DICT(v);
+            if (d->count == 0) {
+                json_buf_put(b, "{}", 2);
+                return;
+            }
+            json_put_open(b, '{', fmt);
+            int first = 1;
+            for (int i = 0; i < d->capacity; i++) {
+                if (d->entries[i].key == NULL) continue;
+                json_put_item_start(b, first, fmt, depth);
+                json_put_key(b, d->entries[i].key, fmt);
+                json_print_value(b, d->entries[i].value, fmt, depth + 1);
+                first = 0;
+            }
+            json_put_close(b, '}', fmt, depth);
+            return;
+        }
+        default: json_buf_put(b, "null", 4); return;
+    }
+}
+
+// ============================================================================
+// Tree <-> value conversion
+// ============================================================================
+
+static Value json_node_to_value(Value item, int depth) {
+    if (!IS_INSTANCE(item) || depth > JSON_PRINT_DEPTH_LIMIT) return val_nil();
+    InstanceValue* node = AS_INSTANCE(item);
+    switch (json_node_type(node)) {
+        case JSON_FALSE: return val_bool(0);
+        case JSON_TRUE: return val_bool(1);
+        case JSON_NUMBER: return JSON_GET(node, "valuedouble");
+        case JSON_STRING: return JSON_GET(node, "valuestring");
+        case JSON_ARRAY: {
+            Value arr = val_array();
+            for (Value c = JSON_GET(node, "child"); IS_INSTANCE(c); c = JSON_GET(AS_INSTANCE(c), "next")) {
+                array_push(&arr, json_node_to_value(c, depth + 1));
+            }
+            return arr;
+        }
+        case JSON_OBJECT: {
+            Value obj = val_dict();
+            for (Value c = JSON_GET(node, "child"); IS_INSTANCE(c); c = JSON_GET(AS_INSTANCE(c), "next")) {
+                Value key = JSON_GET(AS_INSTANCE(c), "string");
+                if (IS_STRING(key)) dict_set(&obj, AS_STRING(key), json_node_to_value(c, depth + 1));
+            }
+            return obj;
+        }
+        default: return val_nil();
+    }
+}
+
+static Value json_value_to_node(ClassValue* cls, Value v, int depth) {
+    if (depth > JSON_PRINT_DEPTH_LIMIT) return json_node_scalar(cls, JSON_NULL, val_nil());
+    switch (v.type) {
+        case VAL_BOOL: return json_node_scalar(cls, AS_BOOL(v) ? JSON_TRUE : JSON_FALSE, val_nil());
+        case VAL_NUMBER: return json_node_scalar(cls, JSON_NUMBER, v);
+        case VAL_STRING: return json_node_scalar(cls, JSON_STRING, v);
+        case VAL_ARRAY: {
+            InstanceValue* node = json_node_new(cls, JSON_ARRAY);
+            InstanceValue* last = NULL;
+            ArrayValue* arr = AS_ARRAY(v);
+            for (int i = 0; i < arr->count; i++) {
+                json_node_link(node, &last, json_value_to_node(cls, arr->elements[i], depth + 1));
+            }
+            json_node_close(node, last, arr->count);
+            return val_instance(node);
+        }
+        case VAL_DICT: {
+            InstanceValue* node = json_node_new(cls, JSON_OBJECT);
+            InstanceValue* last = NULL;
+            DictValue* d = AS_DICT(v);
+            int count = 0;
+            for (int i = 0; i < d->capacity; i++) {
+                DictEntry* e = &d->entries[i];
+                if (e->key == NULL) continue;
+                Value item = json_value_to_node(cls, e->value, depth + 1);
+                JSON_SET(AS_INSTANCE(item), "string", val_string_len(e->key, e->key_len));
+                json_node_link(node, &last, item);
+                count++;
+            }
+            json_node_close(node, last, count);
+            return val_instance(node);
+        }
+        default: return json_node_scalar(cls, JSON_NULL, val_nil());
+    }
+}
+
+// ============================================================================
+// Pull reader
+// ============================================================================
+
+// What the reader expects next
+enum {
+    JR_VALUE,
+    JR_FIRST_ITEM,   // just after '[': a value or ']'
+    JR_FIRST_KEY,    // just after '{': a key or '}'
+    JR_KEY,
+    JR_AFTER,        // after a value: ',', the closer, or the end of the document
+    JR_DONE
+};
+
+typedef struct {
+    JsonScanner s;
+    int state;
+    char open[JSON_NESTING_LIMIT];   // '[' or '{' for each open container
+} JsonReader;
+
+static void json_reader_close(JsonReader* r) {
+    if (r->s.f) { fclose(r->s.f); r->s.f = NULL; }
+    free(r->s.chunk);
+    free(r->s.text.data);
+    memset(&r->s, 0, sizeof(r->s));
+    r->state = JR_DONE;
+}
+
+static void json_reader_free(void* ptr) {
+    json_reader_close((JsonReader*)ptr);
+    free(ptr);
+}
+
+static JsonReader* json_as_reader(Value v) {
+    if (v.type != VAL_POINTER || v.as.pointer->finalize != json_reader_free) return NULL;
+    return (JsonReader*)v.as.pointer->ptr;
+}
+
+static Value json_reader_handle(JsonReader* r) {
+    Value handle = val_pointer(r, sizeof(JsonReader), 1);
+    handle.as.pointer->finalize = json_reader_free;
+    return handle;
+}
+
+static Value json_event(const char* kind, Value v) {
+    Value e = val_array();
+    array_push(&e, val_string(kind));
+    array_push(&e, v);
+    return e;
+}
+
+// Report a syntax error once, with the byte offset it was found at
+static Value json_reader_fail(JsonReader* r) {
+    Value e = json_event("error", val_number((double)json_offset(&r->s)));
+    json_reader_close(r);
+    return e;
+}
+
+static Value json_reader_step(JsonReader* r) {
+    JsonScanner* s = &r->s;
+    for (;;) {
+        if (r->state == JR_DONE) return val_nil();
+        json_skip_ws(s);
+        switch (r->state) {
+            case JR_FIRST_ITEM:
+            case JR_FIRST_KEY: {
+                char closer = r->state == JR_FIRST_ITEM ? ']' : '}';
+                if (JSON_MORE(s) && *s->p == closer) break;
+                r->state = r->state == JR_FIRST_ITEM ? JR_VALUE : JR_KEY;
+                continue;
+            }
+            case JR_KEY: {
+                if (!JSON_MORE(s) || *s->p != '"') return json_reader_fail(r);
+                s->text.len = 0;
+                if (!json_scan_string(s, &s->text)) return json_reader_fail(r);
+                json_skip_ws(s);
+                if (!JSON_MORE(s) || *s->p != ':') return json_reader_fail(r);
+                s->p++;
+                r->state = JR_VALUE;
+                return json_event("key", val_string_len(s->text.data ? s->text.data : "", (int)s->text.len));
+            }
+            case JR_AFTER: {
+                if (s->depth == 0) {
+                    json_reader_close(r);
+                    return val_nil();
+                }
+                if (!JSON_MORE(s)) return json_reader_fail(r);
+                char top = r->open[s->depth - 1];
+                if (*s->p == ',') {
+                    s->p++;
+                    r->state = top == '{' ? JR_KEY : JR_VALUE;
+                    continue;
+                }
+                if (*s->p != (top == '{' ? '}' : ']')) return json_reader_fail(r);
+                break;
+            }
+            default: {
+                // A value sits one level below its container, so the
+                // container count must stay under the parser's limit.
+                if (s->depth >= JSON_NESTING_LIMIT || !JSON_MORE(s)) return json_reader_fail(r);
+                char c = *s->p;
+                if (c == '[' || c == '{') {
+                    s->p++;
+                    r->open[s->depth++] = c;
+                    r->state = c == '[' ? JR_FIRST_ITEM : JR_FIRST_KEY;
+                    return json_event(c == '[' ? "array" : "object", val_nil());
+                }
+                Value v;
+                if (c == '"') {
+                    s->text.len = 0;
+                    if (!json_scan_string(s, &s->text)) return json_reader_fail(r);
+                    v = val_string_len(s->text.data ? s->text.data : "", (int)s->text.len);
+                } else if (c == 't' || c == 'f' || c == 'n') {
+                    const char* word = c == 't' ? "true" : c == 'f' ? "false" : "null";
+                    if (!json_scan_word(s, word)) return json_reader_fail(r);
+                    v = c == 'n' ? val_nil() : val_bool(c == 't');
+                } else if (c == '-' || (c >= '0' && c <= '9')) {
+                    v = val_number(json_scan_number(s));
+                } else {
+                    return json_reader_fail(r);
+                }
+                r->state = JR_AFTER;
+                return json_event("value", v);
+            }
+        }
+
+        // The current container closes here
+        s->p++;
+        char open = r->open[--s->depth];
+        r->state = JR_AFTER;
+        return json_event(open == '[' ? "end_array" : "end_object", val_nil());
+    }
+}
+
+// ============================================================================
+// Module functions
+// ============================================================================
+
+// _json.parse(text) -> dict/array/string/number/bool, or nil on error
+static Value json_parse_native(int argCount, Value* args) {
+    if (argCount < 1 || !IS_STRING(args[0])) return val_nil();
+    return json_parse_document(AS_STRING(args[0]), NULL);
+}
+
+// _json.parse_nodes(text, cJSON) -> cJSON node tree, or nil on error
+static Value json_parse_nodes_native(int argCount, Value* args) {
+    if (argCount < 2 || !IS_STRING(args[0]) || !IS_CLASS(args[1])) return val_nil();
+    return json_parse_document(AS_STRING(args[0]), AS_CLASS(args[1]));
+}
+
+// _json.print_nodes(node, formatted) -> JSON text of a cJSON node tree
+static Value json_print_nodes_native(int argCount, Value* args) {
+    if (argCount < 1) return val_nil();
+    int fmt = argCount >= 2 && IS_BOOL(args[1]) && AS_BOOL(args[1]);
+    JsonBuf b = {0};
+    json_print_node(&b, args[0], fmt, 0);
+    return json_buf_take(&b);
+}
+
+// _json.stringify(value, formatted) -> JSON text of a plain Sage value
+static Value json_stringify_native(int argCount, Value* args) {
+    if (argCount < 1) return val_nil();
+    int fmt = argCount >= 2 && IS_BOOL(args[1]) && AS_BOOL(args[1]);
+    JsonBuf b = {0};
+    json_print_value(&b, args[0], fmt, 0);
+    return json_buf_take(&b);
+}
+
+// _json.to_value(node) -> the plain Sage value of a cJSON node tree
+static Value json_to_value_native(int argCount, Value* args) {
+    if (argCount < 1) return val_nil();
+    gc_pin();
+    Value v = json_node_to_value(args[0], 0);
+    gc_unpin();
+    return v;
+}
+
+// _json.from_value(value, cJSON) -> cJSON node tree of a plain Sage value
+static Value json_from_value_native(int argCount, Value* args) {
+    if (argCount < 2 || !IS_CLASS(args[1])) return val_nil();
+    gc_pin();
+    Value v = json_value_to_node(AS_CLASS(args[1]), args[0], 0);
+    gc_unpin();
+    return v;
+}
+
+// _json.reader(text) -> pull reader over a copy of text
+static Value json_reader_native(int argCount, Value* args) {
+    if (argCount < 1 || !IS_STRING(args[0])) return val_nil();
+    size_t len = strlen(AS_STRING(args[0]));
+    JsonReader* r = calloc(1, sizeof(JsonReader));
+    char* copy = malloc(len + 1);
+    if (!r || !copy) {
+        free(r);
+        free(copy);
+        return val_nil();
+    }
+    memcpy(copy, AS_STRING(args[0]), len + 1);
+    r->s.chunk = copy;
+    r->s.p = copy;
+    r->s.end = copy + len;
+    r->state = JR_VALUE;
+    return json_reader_handle(r);
+}
+
+// _json.open(path) -> pull reader that streams the file in 64 KB chunks
+static Value json_open_native(int argCount, Value* args) {
+    if (argCount < 1 || !IS_STRING(args[0])) return val_nil();
+    FILE* f = fopen(AS_STRING(args[0]), "rb");
+    if (!f) return val_nil();
+    JsonReader* r = calloc(1, sizeof(JsonReader));
+    char* chunk = malloc(JSON_CHUNK_SIZE);
+    if (!r || !chunk) {
+        fclose(f);
+        free(r);
+        free(chunk);
+        return val_nil();
+    }
+    r->s.f = f;
+    r->s.chunk = chunk;
+    r->s.p = chunk;
+    r->s.end = chunk;
+    r->state = JR_VALUE;
+    return json_reader_handle(r);
+}
+
+// _json.next(reader) -> [event, value], or nil once the document is done.
+// Events: "object", "end_object", "array", "end_array", "key" (the key
+// string), "value" (a string, number, bool or nil) and "error" (the byte
+// offset of the bad input; the reader is closed after it).
+static Value json_next_native(int argCount, Value* args) {
+    JsonReader* r = argCount >= 1 ? json_as_reader(args[0]) : NULL;
+    if (!r) {
+        fprintf(stderr, "Runtime Error: _json.next expects a reader from _json.reader or _json.open.\n");
+        return val_nil();
+    }
+    gc_pin();
+    Value e = json_reader_step(r);
+    gc_unpin();
+    return e;
+}
+
+// _json.close(reader) -> releases the reader's file and buffers early
+static Value json_close_native(int argCount, Value* args) {
+    JsonReader* r = argCount >= 1 ? json_as_reader(args[0]) : NULL;
+    if (!r) return val_bool(0);
+    json_reader_close(r);
+    return val_bool(1);
+}
+
+Module* create_json_module(ModuleCache* cache) {
+    Module* m = create_native_module(cache, "_json");
+    Environment* e = m->env;
+
+    env_define_const(e, "parse", 5, val_native(json_parse_native));
+    env_define_const(e, "parse_nodes", 11, val_native(json_parse_nodes_native));
+    env_define_const(e, "print_nodes", 11, val_native(json_print_nodes_native));
+    env_define_const(e, "stringify", 9, val_native(json_stringify_native));
+    env_define_const(e, "to_value", 8, val_native(json_to_value_native));
+    env_define_const(e, "from_value", 10, val_native(json_from_value_native));
+    env_define_const(e, "reader", 6, val_native(json_reader_native));
+    env_define_const(e, "open", 4, val_native(json_open_native));
+    env_define_const(e, "next", 4, val_native(json_next_native));
+    env_define_const(e, "close", 5, val_native(json_close_native));
+
+    return m;
+}
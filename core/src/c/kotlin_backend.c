@@ -2178,6 +2178,7 @@ static int write_kotlin_output_internal(const char* source, const char* input_pa
         pass_ctx.debug_info = debug_info;
         pass_ctx.verbose = 0;
         pass_ctx.input_path = input_path;
+        pass_ctx.profile = NULL;
         program = run_passes(program, &pass_ctx);
     }
 
@@ -0,0 +1,389 @@
+// src/kvcache.c - Native KV cache for SageLang
+//
+// Provides: _kvcache (key/value storage and cached attention behind lib/llm/attention.sage)
+//
+// Each layer owns two contiguous f32 buffers laid out [position, head, d_head],
+// preallocated for max_seq positions and doubled if generation runs past
+// them. In window mode the buffers wrap as a ring of `window` positions plus
+// room for the largest chunk appended at once, less one: the first query of
+// a chunk still sees its full window after the chunk is stored. Memory stays
+// fixed however long generation runs and attention covers the most recent
+// window of each query. attend() scores queries against
+// the cached keys, applies a causal softmax and mixes the values without
+// building intermediate Sage arrays. Queries may carry a multiple of the
+// cached heads (grouped-query attention).
+
+#include "module.h"
+#include "value.h"
+#include "env.h"
+#include "gc.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    float* keys;            // cap * row
+    float* values;
+    int cap;                // positions the buffers can hold
+    long long total;        // positions appended since the last clear
+} KvLayer;
+
+typedef struct {
+    int n_layers;
+    int n_heads;
+    int d_head;
+    int row;                // n_heads * d_head floats per position
+    int window;             // > 0: ring buffer of the last window positions
+    KvLayer* layers;
+    float* scores;          // attend() scratch, one score per visible position
+    int scores_cap;
+    float* rows;            // append()/attend() input staging
+    size_t rows_cap;
+} KvCache;
+
+// ============================================================================
+// Storage
+// ============================================================================
+
+// Positions stored in a layer's buffers
+static int kv_stored(const KvLayer* l) {
+    return l->total < l->cap ? (int)l->total : l->cap;
+}
+
+// Positions a layer exposes: all of them, or the last window
+static int kv_held(const KvCache* c, const KvLayer* l) {
+    int n = kv_stored(l);
+    return c->window > 0 && n > c->window ? c->window : n;
+}
+
+// Buffer slot of an absolute position
+static int kv_slot(const KvCache* c, const KvLayer* l, long long pos) {
+    return c->window > 0 ? (int)(pos % l->cap) : (int)pos;
+}
+
+static void kv_grow(KvCache* c, KvLayer* l, long long need) {
+    if (c->window > 0 || need <= l->cap) return;
+    int cap = l->cap ? l->cap : 16;
+    while (cap < need) cap *= 2;
+    size_t bytes = sizeof(float) * (size_t)cap * (size_t)c->row;
+    l->keys = SAGE_REALLOC(l->keys, bytes);
+    l->values = SAGE_REALLOC(l->values, bytes);
+    l->cap = cap;
+}
+
+// Widen a ring to cap positions; stored positions move to their new slots
+static void kv_grow_ring(KvCache* c, KvLayer* l, int cap) {
+    if (cap <= l->cap) return;
+    size_t row_bytes = sizeof(float) * (size_t)c->row;
+    float* keys = SAGE_ALLOC(row_bytes * (size_t)cap);
+    float* values = SAGE_ALLOC(row_bytes * (size_t)cap);
+    for (long long p = l->total - kv_stored(l); p < l->total; p++) {
+        size_t from = (size_t)(p % l->cap) * (size_t)c->row;
+        size_t to = (size_t)(p % cap) * (size_t)c->row;
+        memcpy(keys + to, l->keys + from, row_bytes);
+        memcpy(values + to, l->values + from, row_bytes);
+    }
+    free(l->keys);
+    free(l->values);
+    l->keys = keys;
+    l->values = values;
+    l->cap = cap;
+}
+
+static void kv_append(KvCache* c, KvLayer* l, const float* k, const float* v, int n) {
+    if (c->window > 0) kv_grow_ring(c, l, c->window + n - 1);
+    else kv_grow(c, l, l->total + n);
+    size_t row_bytes = sizeof(float) * (size_t)c->row;
+    for (int i = 0; i < n; i++) {
+        int slot = kv_slot(c, l, l->total++);
+        memcpy(l->keys + (size_t)slot * (size_t)c->row, k + (size_t)i * (size_t)c->row, row_bytes);
+        memcpy(l->values + (size_t)slot * (size_t)c->row, v + (size_t)i * (size_t)c->row, row_bytes);
+    }
+}
+
+// ============================================================================
+// Attention
+// ============================================================================
+
+static float kv_dot(const float* a, const float* b, int n) {
+    float s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        s0 += a[i] * b[i];
+        s1 += a[i + 1] * b[i + 1];
+        s2 += a[i + 2] * b[i + 2];
+        s3 += a[i + 3] * b[i + 3];
+    }
+    for (; i < n; i++) s0 += a[i] * b[i];
+    return (s0 + s1) + (s2 + s3);
+}
+
+// Attention for n_q queries that belong to the newest n_q positions of the
+// layer. q and out are [n_q, q_heads, d_head]; q_heads is a multiple of
+// n_heads and each group of q_heads / n_heads query heads shares a KV head.
+static void kv_attend(KvCache* c, const KvLayer* l, const float* q, int n_q, int q_heads,
+                      int causal, float* out) {
+    int d = c->d_head;
+    int group = q_heads / c->n_heads;
+    int stored = kv_stored(l);
+    float scale = 1.0f / sqrtf((float)d);
+    long long oldest = l->total - stored;
+
+    if (c->scores_cap < stored) {
+        c->scores_cap = stored;
+        c->scores = SAGE_REALLOC(c->scores, sizeof(float) * (size_t)stored);
+    }
+
+    for (int i = 0; i < n_q; i++) {
+        long long pos = l->total - n_q + i;
+        long long hi = causal ? pos : l->total - 1;
+        long long lo = c->window > 0 ? hi - c->window + 1 : 0;
+        if (lo < oldest) lo = oldest;
+        int n = (int)(hi - lo + 1);
+
+        for (int h = 0; h < q_heads; h++) {
+            const float* qh = q + ((size_t)i * (size_t)q_heads + (size_t)h) * (size_t)d;
+            float* oh = out + ((size_t)i * (size_t)q_heads + (size_t)h) * (size_t)d;
+            size_t head_off = (size_t)(h / group) * (size_t)d;
+            memset(oh, 0, sizeof(float) * (size_t)d);
+            if (n <= 0) continue;
+
+            float max = -INFINITY;
+            for (int j = 0; j < n; j++) {
+                int slot = kv_slot(c, l, lo + j);
+                float s = kv_dot(qh, l->keys + (size_t)slot * (size_t)c->row + head_off, d) * scale;
+                c->scores[j] = s;
+                if (s > max) max = s;
+            }
+            float sum = 0;
+            for (int j = 0; j < n; j++) {
+                c->scores[j] = expf(c->scores[j] - max);
+                sum += c->scores[j];
+            }
+            for (int j = 0; j < n; j++) {
+                int slot = kv_slot(c, l, lo + j);
+                const float* vh = l->values + (size_t)slot * (size_t)c->row + head_off;
+                float w = c->scores[j] / sum;
+                for (int e = 0; e < d; e++) oh[e] += w * vh[e];
+            }
+        }
+    }
+}
+
+// ============================================================================
+// Module functions
+// ============================================================================
+
+static void kv_free(void* ptr) {
+    KvCache* c = ptr;
+    for (int i = 0; i < c->n_layers; i++) {
+        free(c->layers[i].keys);
+        free(c->layers[i].values);
+    }
+    free(c->layers);
+    free(c->scores);
+    free(c->rows);
+    free(c);
+}
+
+static KvCache* kv_as_cache(Value v) {
+    if (v.type != VAL_POINTER || v.as.pointer->finalize != kv_free) return NULL;
+    return (KvCache*)v.as.pointer->ptr;
+}
+
+// Validate the cache and layer arguments shared by most functions
+static KvLayer* kv_layer_arg(int argCount, Value* args, const char* fn, KvCache** out) {
+    KvCache* c = argCount >= 1 ? kv_as_cache(args[0]) : NULL;
+    if (!c) {
+        fprintf(stderr, "Runtime Error: _kvcache.%s expects a cache from _kvcache.create.\n", fn);
+        return NULL;
+    }
+    int layer = argCount >= 2 && IS_NUMBER(args[1]) ? (int)AS_NUMBER(args[1]) : -1;
+    if (layer < 0 || layer >= c->n_layers) {
+        fprintf(stderr, "Runtime Error: _kvcache.%s layer must be in 0..%d.\n", fn, c->n_layers - 1);
+        return NULL;
+    }
+    *out = c;
+    return &c->layers[layer];
+}
+
+// Copy a flat array of numbers into the staging buffer at offset; returns
+// its length, or -1 if v is not an array of numbers
+static int kv_stage(KvCache* c, Value v, size_t offset) {
+    if (!IS_ARRAY(v)) return -1;
+    ArrayValue* arr = AS_ARRAY(v);
+    size_t need = offset + (size_t)arr->count;
+    if (c->rows_cap < need) {
+        c->rows_cap = need;
+        c->rows = SAGE_REALLOC(c->rows, sizeof(float) * need);
+    }
+    for (int i = 0; i < arr->count; i++) {
+        if (!IS_NUMBER(arr->elements[i])) return -1;
+        c->rows[offset + (size_t)i] = (float)AS_NUMBER(arr->elements[i]);
+    }
+    return arr->count;
+}
+
+// _kvcache.create(n_layers, n_heads, d_head, [max_seq], [window]) -> cache
+// max_seq preallocates positions (default 2048); window > 0 makes each
+// layer a ring of the last window positions
+static Value kv_create_native(int argCount, Value* args) {
+    if (argCount < 3 || !IS_NUMBER(args[0]) || !IS_NUMBER(args[1]) || !IS_NUMBER(args[2]) ||
+        AS_NUMBER(args[0]) < 1 || AS_NUMBER(args[1]) < 1 || AS_NUMBER(args[2]) < 1) {
+        fprintf(stderr, "Runtime Error: _kvcache.create expects positive n_layers, n_heads and d_head.\n");
+        return val_nil();
+    }
+    int max_seq = argCount >= 4 && IS_NUMBER(args[3]) && AS_NUMBER(args[3]) >= 1 ? (int)AS_NUMBER(args[3]) : 2048;
+    int window = argCount >= 5 && IS_NUMBER(args[4]) && AS_NUMBER(args[4]) >= 1 ? (int)AS_NUMBER(args[4]) : 0;
+
+    KvCache* c = SAGE_ALLOC(sizeof(KvCache));
+    c->n_layers = (int)AS_NUMBER(args[0]);
+    c->n_heads = (int)AS_NUMBER(args[1]);
+    c->d_head = (int)AS_NUMBER(args[2]);
+    c->row = c->n_heads * c->d_head;
+    c->window = window;
+    c->layers = SAGE_ALLOC(sizeof(KvLayer) * (size_t)c->n_layers);
+    int cap = window > 0 ? window : max_seq;
+    size_t bytes = sizeof(float) * (size_t)cap * (size_t)c->row;
+    for (int i = 0; i < c->n_layers; i++) {
+        c->layers[i].keys = SAGE_ALLOC(bytes);
+        c->layers[i].values = SAGE_ALLOC(bytes);
+        c->layers[i].cap = cap;
+    }
+    Value handle = val_pointer(c, sizeof(KvCache), 1);
+    handle.as.pointer->finalize = kv_free;
+    return handle;
+}
+
+// _kvcache.append(cache, layer, keys, values) -> positions now held by the layer
+// keys and values are flat [n_tokens * n_heads * d_head]
+static Value kv_append_native(int argCount, Value* args) {
+    KvCache* c;
+    KvLayer* l = kv_layer_arg(argCount, args, "append", &c);
+    if (!l || argCount < 4) return val_nil();
+    int nk = kv_stage(c, args[2], 0);
+    int nv = nk >= 0 ? kv_stage(c, args[3], (size_t)nk) : -1;
+    if (nk < 0 || nv != nk || nk % c->row != 0) {
+        fprintf(stderr, "Runtime Error: _kvcache.append expects keys and values of n_tokens * %d numbers.\n", c->row);
+        return val_nil();
+    }
+    kv_append(c, l, c->rows, c->rows + nk, nk / c->row);
+    return val_number(kv_held(c, l));
+}
+
+// _kvcache.attend(cache, layer, q, [n_q], [causal]) -> [n_q * q_heads * d_head]
+// The queries belong to the newest n_q positions (default 1, one decode step)
+static Value kv_attend_native(int argCount, Value* args) {
+    KvCache* c;
+    KvLayer* l = kv_layer_arg(argCount, args, "attend", &c);
+    if (!l || argCount < 3) return val_nil();
+    int n_q = argCount >= 4 && IS_NUMBER(args[3]) ? (int)AS_NUMBER(args[3]) : 1;
+    int causal = argCount >= 5 ? !IS_BOOL(args[4]) || AS_BOOL(args[4]) : 1;
+    int len = kv_stage(c, args[2], 0);
+    if (len < 0 || n_q < 1 || n_q > l->total || len % ((long long)n_q * c->d_head) != 0 ||
+        (len / (n_q * c->d_head)) % c->n_heads != 0 || len == 0) {
+        fprintf(stderr, "Runtime Error: _kvcache.attend expects n_q * q_heads * %d numbers for "
+                        "n_q <= cached positions and q_heads a multiple of %d.\n", c->d_head, c->n_heads);
+        return val_nil();
+    }
+    int q_heads = len / (n_q * c->d_head);
+    // A ring keeps the window of the newest append's queries; older queries
+    // may already have lost theirs
+    long long first_lo = l->total - n_q - c->window + 1;
+    if (c->window > 0 && causal && first_lo < l->total - kv_stored(l) && first_lo > 0) {
+        fprintf(stderr, "Runtime Error: _kvcache.attend n_q = %d reaches positions the window ring "
+                        "no longer holds; attend after each append.\n", n_q);
+        return val_nil();
+    }
+
+    float* out = SAGE_ALLOC(sizeof(float) * (size_t)len);
+    kv_attend(c, l, c->rows, n_q, q_heads, causal, out);
+
+    gc_pin();
+    Value result = val_array();
+    for (int i = 0; i < len; i++) array_push(&result, val_number(out[i]));
+    gc_unpin();
+    free(out);
+    return result;
+}
+
+static Value kv_read(int argCount, Value* args, const char* fn, int values) {
+    KvCache* c;
+    KvLayer* l = kv_layer_arg(argCount, args, fn, &c);
+    if (!l) return val_nil();
+    int held = kv_held(c, l);
+    gc_pin();
+    Value result = val_array();
+    for (long long p = l->total - held; p < l->total; p++) {
+        const float* row = (values ? l->values : l->keys) + (size_t)kv_slot(c, l, p) * (size_t)c->row;
+        for (int i = 0; i < c->row; i++) array_push(&result, val_number(row[i]));
+    }
+    gc_unpin();
+    return result;
+}
+
+// _kvcache.keys(cache, layer) -> held keys, oldest position first
+static Value kv_keys_native(int argCount, Value* args) {
+    return kv_read(argCount, args, "keys", 0);
+}
+
+// _kvcache.values(cache, layer) -> held values, oldest position first
+static Value kv_values_native(int argCount, Value* args) {
+    return kv_read(argCount, args, "values", 1);
+}
+
+// _kvcache.length(cache, layer) -> positions held by the layer
+static Value kv_length_native(int argCount, Value* args) {
+    KvCache* c;
+    KvLayer* l = kv_layer_arg(argCount, args, "length", &c);
+    return l ? val_number(kv_held(c, l)) : val_nil();
+}
+
+// _kvcache.clear(cache) -> nil; keeps the buffers for reuse
+static Value kv_clear_native(int argCount, Value* args) {
+    KvCache* c = argCount >= 1 ? kv_as_cache(args[0]) : NULL;
+    if (c) {
+        for (int i = 0; i < c->n_layers; i++) c->layers[i].total = 0;
+    }
+    return val_nil();
+}
+
+// _kvcache.stats(cache) -> {layers, heads, d_head, window, capacity, length, positions, bytes}
+static Value kv_stats_native(int argCount, Value* args) {
+    KvCache* c = argCount >= 1 ? kv_as_cache(args[0]) : NULL;
+    if (!c) {
+        fprintf(stderr, "Runtime Error: _kvcache.stats expects a cache from _kvcache.create.\n");
+        return val_nil();
+    }
+    double bytes = 0;
+    for (int i = 0; i < c->n_layers; i++) bytes += 2.0 * sizeof(float) * c->layers[i].cap * c->row;
+    gc_pin();
+    Value stats = val_dict();
+    dict_set(&stats, "layers", val_number(c->n_layers));
+    dict_set(&stats, "heads", val_number(c->n_heads));
+    dict_set(&stats, "d_head", val_number(c->d_head));
+    dict_set(&stats, "window", val_number(c->window));
+    dict_set(&stats, "capacity", val_number(c->layers[0].cap));
+    dict_set(&stats, "length", val_number(kv_held(c, &c->layers[0])));
+    dict_set(&stats, "positions", val_number((double)c->layers[0].total));
+    dict_set(&stats, "bytes", val_number(bytes));
+    gc_unpin();
+    return stats;
+}
+
+Module* create_kvcache_module(ModuleCache* cache) {
+    Module* m = create_native_module(cache, "_kvcache");
+    Environment* e = m->env;
+
+    env_define_const(e, "create", 6, val_native(kv_create_native));
+    env_define_const(e, "append", 6, val_native(kv_append_native));
+    env_define_const(e, "attend", 6, val_native(kv_attend_native));
+    env_define_const(e, "keys", 4, val_native(kv_keys_native));
+    env_define_const(e, "values", 6, val_native(kv_values_native));
+    env_define_const(e, "length", 6, val_native(kv_length_native));
+    env_define_const(e, "clear", 5, val_native(kv_clear_native));
+    env_define_const(e, "stats", 5, val_native(kv_stats_native));
+
+    return m;
+}
@@ -12,11 +12,14 @@
 #include <unistd.h>
 
 #include "ast.h"
+#include "aot.h"
+#include "ast_arena.h"
 #include "gc.h"
 #include "graphics.h"
 #include "lexer.h"
 #include "parser.h"
 #include "pass.h"
+#include "profile.h"
 
 // Native C modules that don't have .sage files (handled at runtime)
 static int is_native_module(const char *name) {
@@ -25,7 +28,8 @@ static int is_native_module(const char *name) {
                              "socket",    "tcp",       "http",     "ssl",
                              "fat",       "gpu",       "graphics", "ml_native",
                              "compiler",  "vm_native", "vm",       "ffi",
-                             "net",       "string",
+                             "net",       "string",    "_json",
+                             "_textindex", "_vecindex", "_kvcache", "_bpe",
                              NULL};
     for (int i = 0; natives[i] != NULL; i++) {
         if (strcmp(name, natives[i]) == 0)
@@ -38,12 +42,13 @@ static int is_native_module(const char *name) {
 // LLVM IR Text Generation Backend
 //
 // Emits LLVM IR text (.ll files) that can be compiled with llc + cc.
-// Uses the same tagged-union SageValue model as the C backend.
+// Uses the same tagged-union SageValue model as the C backend, except for
+// values the type inference proves numeric or boolean (see Typed Lowering).
 // Runtime functions are declared as external and linked separately.
 // ============================================================================
 
 // Forward declaration
-extern Stmt* parse_program(const char* source);
+extern Stmt* parse_program(const char* source, const char* input_path);
 static int llvm_resolve_gpu_constant(const char* name, double* out_value);
 
 // ============================================================================
@@ -106,6 +111,13 @@ typedef struct {
     ImportedConst* imported_consts;
     int imported_const_count;
     int imported_const_cap;
+    // --profile-use data and the branch_weights metadata it produced
+    const SageProfile* profile;
+    uint32_t (*branch_weights)[2];
+    int branch_weight_count;
+    int branch_weight_cap;
+    // Type inference shared with the AOT backend (see Typed Lowering)
+    AotCompiler* types;
 } LLVMCompiler;
 
 static int llc_has_module(LLVMCompiler* lc, const char* name) {
@@ -223,6 +235,43 @@ static int llc_new_label(LLVMCompiler* lc) {
     return lc->next_label++;
 }
 
+// Formats the `, !prof !N` suffix of a conditional branch whose true edge
+// was taken `taken` times and false edge `not_taken` times in the profiled
+// run; leaves `buf` empty when there is nothing to say.
+static const char* llc_branch_weights(LLVMCompiler* lc, int64_t taken, int64_t not_taken,
+                                      char* buf, size_t size) {
+    buf[0] = '\0';
+    if (taken < 0 || not_taken < 0 || taken + not_taken == 0) return buf;
+    while (taken > UINT32_MAX || not_taken > UINT32_MAX) {
+        taken /= 2;
+        not_taken /= 2;
+    }
+    if (lc->branch_weight_count >= lc->branch_weight_cap) {
+        int cap = lc->branch_weight_cap == 0 ? 16 : lc->branch_weight_cap * 2;
+        void* grown = realloc(lc->branch_weights, (size_t)cap * sizeof(*lc->branch_weights));
+        if (grown == NULL) return buf;
+        lc->branch_weights = grown;
+        lc->branch_weight_cap = cap;
+    }
+    // A zero weight would tell LLVM the edge is impossible; keep it merely unlikely.
+    lc->branch_weights[lc->branch_weight_count][0] = taken > 0 ? (uint32_t)taken : 1;
+    lc->branch_weights[lc->branch_weight_count][1] = not_taken > 0 ? (uint32_t)not_taken : 1;
+    snprintf(buf, size, ", !prof !%d", lc->branch_weight_count++);
+    return buf;
+}
+
+static const char* llc_site_weights(LLVMCompiler* lc, ProfileSiteKind kind, const Token* at,
+                                    char* buf, size_t size) {
+    buf[0] = '\0';
+    const ProfileSite* site = profile_find(lc->profile, kind, at);
+    if (site == NULL) return buf;
+    if (kind == PROFILE_LOOP) {
+        // Every entry leaves the loop once; every iteration takes the body edge.
+        return llc_branch_weights(lc, site->other, site->count, buf, size);
+    }
+    return llc_branch_weights(lc, site->count, site->other, buf, size);
+}
+
 static int llc_add_string(LLVMCompiler* lc, const char* str) {
     if (lc->string_count >= lc->string_cap) {
         lc->string_cap = lc->string_cap ? lc->string_cap * 2 : 16;
@@ -248,6 +297,13 @@ static void llc_add_global(LLVMCompiler* lc, const char* name) {
     lc->global_names[lc->global_count++] = SAGE_STRDUP(name);
 }
 
+static int llc_is_global(LLVMCompiler* lc, const char* name) {
+    for (int i = 0; i < lc->global_count; i++) {
+        if (strcmp(lc->global_names[i], name) == 0) return 1;
+    }
+    return 0;
+}
+
 static void llc_free(LLVMCompiler* lc) {
     for (int i = 0; i < lc->string_count; i++) free(lc->strings[i]);
     free(lc->strings);
@@ -257,6 +313,7 @@ static void llc_free(LLVMCompiler* lc) {
     free(lc->global_names);
     for (int i = 0; i < lc->imported_module_count; i++) free(lc->imported_modules[i]);
     free(lc->imported_modules);
+    free(lc->branch_weights);
     for (int i = 0; i < lc->imported_const_count; i++) {
         free(lc->imported_consts[i].name);
         import_const_value_free(&lc->imported_consts[i].value);
@@ -477,25 +534,6 @@ static char* resolve_module_path_for_llvm(const LLVMCompiler* lc, const char* mo
     return NULL;
 }
 
-static Stmt* llvm_parse_program_with_path(const char* source, const char* input_path) {
-    init_lexer(source, input_path);
-    parser_init();
-
-    Stmt* head = NULL;
-    Stmt* tail = NULL;
-    while (1) {
-        Stmt* stmt = parse();
-        if (stmt == NULL) break;
-        if (head == NULL) {
-            head = stmt;
-        } else {
-            tail->next = stmt;
-        }
-        tail = stmt;
-    }
-    return head;
-}
-
 static ImportConstValue llvm_eval_const_expr(Expr* expr, ModuleConst* consts, int const_count) {
     if (expr == NULL) return import_const_invalid();
 
@@ -666,7 +704,7 @@ static void llvm_process_import_constants(LLVMCompiler* lc, ImportStmt* import_s
         return;
     }
 
-    Stmt* module_ast = llvm_parse_program_with_path(source, module_path);
+    Stmt* module_ast = parse_program(source, module_path);
 
     ModuleConst* consts = NULL;
     int const_count = 0;
@@ -724,6 +762,116 @@ static void emit_escaped_string(FILE* out, const char* str) {
 // Type Definitions and Runtime Declarations
 // ============================================================================
 
+// Fast paths of the runtime's value helpers, defined in the module so that
+// LLVM can inline them and fold a box/unbox pair into nothing. They keep the
+// runtime's semantics (non-numbers count as 0 in arithmetic) and call into
+// llvm_runtime.c for everything else: strings, containers, division by zero.
+static void emit_inline_helpers(LLVMCompiler* lc) {
+    static const char* const helpers =
+        "; Inline value helpers\n"
+        "define internal %SageValue @sage_ll_nil() alwaysinline {\n"
+        "  ret %SageValue { i32 0, i64 0 }\n"
+        "}\n"
+        "define internal %SageValue @sage_ll_number(double %v) alwaysinline {\n"
+        "  %bits = bitcast double %v to i64\n"
+        "  %r = insertvalue %SageValue { i32 1, i64 undef }, i64 %bits, 1\n"
+        "  ret %SageValue %r\n"
+        "}\n"
+        "define internal %SageValue @sage_ll_bool(i1 %v) alwaysinline {\n"
+        "  %w = zext i1 %v to i64\n"
+        "  %r = insertvalue %SageValue { i32 2, i64 undef }, i64 %w, 1\n"
+        "  ret %SageValue %r\n"
+        "}\n"
+        "define internal double @sage_ll_to_number(%SageValue %v) alwaysinline {\n"
+        "  %t = extractvalue %SageValue %v, 0\n"
+        "  %bits = extractvalue %SageValue %v, 1\n"
+        "  %num = icmp eq i32 %t, 1\n"
+        "  %d = bitcast i64 %bits to double\n"
+        "  %r = select i1 %num, double %d, double 0.0\n"
+        "  ret double %r\n"
+        "}\n"
+        "define internal i1 @sage_ll_truthy(%SageValue %v) alwaysinline {\n"
+        "entry:\n"
+        "  %t = extractvalue %SageValue %v, 0\n"
+        "  %bits = extractvalue %SageValue %v, 1\n"
+        "  switch i32 %t, label %other [ i32 0, label %nil\n"
+        "                                 i32 1, label %num\n"
+        "                                 i32 2, label %bool ]\n"
+        "nil:\n"
+        "  ret i1 false\n"
+        "num:\n"
+        "  %d = bitcast i64 %bits to double\n"
+        "  %nz = fcmp une double %d, 0.0\n"
+        "  ret i1 %nz\n"
+        "bool:\n"
+        "  %b = trunc i64 %bits to i32\n"
+        "  %bz = icmp ne i32 %b, 0\n"
+        "  ret i1 %bz\n"
+        "other:\n"
+        "  %o = call i32 @sage_rt_get_bool(%SageValue %v)\n"
+        "  %oz = icmp ne i32 %o, 0\n"
+        "  ret i1 %oz\n"
+        "}\n"
+        "define internal %SageValue @sage_ll_not(%SageValue %v) alwaysinline {\n"
+        "  %b = call i1 @sage_ll_truthy(%SageValue %v)\n"
+        "  %n = xor i1 %b, true\n"
+        "  %r = call %SageValue @sage_ll_bool(i1 %n)\n"
+        "  ret %SageValue %r\n"
+        "}\n";
+    fputs(helpers, lc->out);
+
+    // Arithmetic and ordering need no slow path: the runtime treats a
+    // non-number operand as 0 just like @sage_ll_to_number does.
+    static const struct { const char* name; const char* inst; int compare; } total[] = {
+        { "sub", "fsub", 0 }, { "mul", "fmul", 0 },
+        { "lt", "fcmp olt", 1 }, { "gt", "fcmp ogt", 1 },
+        { "lte", "fcmp ole", 1 }, { "gte", "fcmp oge", 1 },
+    };
+    for (size_t i = 0; i < sizeof(total) / sizeof(total[0]); i++) {
+        ll_emit(lc, "define internal %%SageValue @sage_ll_%s(%%SageValue %%a, %%SageValue %%b) alwaysinline {\n",
+                total[i].name);
+        ll_emit(lc, "  %%x = call double @sage_ll_to_number(%%SageValue %%a)\n");
+        ll_emit(lc, "  %%y = call double @sage_ll_to_number(%%SageValue %%b)\n");
+        ll_emit(lc, "  %%z = %s double %%x, %%y\n", total[i].inst);
+        ll_emit(lc, "  %%r = call %%SageValue @sage_ll_%s(%s %%z)\n",
+                total[i].compare ? "bool" : "number", total[i].compare ? "i1" : "double");
+        ll_emit(lc, "  ret %%SageValue %%r\n}\n");
+    }
+
+    // The rest are inline only while both operands are numbers (add, eq,
+    // neq) or the divisor is non-zero (div, mod, which report the error).
+    static const struct { const char* name; const char* inst; int compare; int divide; } guarded[] = {
+        { "add", "fadd", 0, 0 }, { "eq", "fcmp oeq", 1, 0 }, { "neq", "fcmp une", 1, 0 },
+        { "div", "fdiv", 0, 1 }, { "mod", "frem", 0, 1 },
+    };
+    for (size_t i = 0; i < sizeof(guarded) / sizeof(guarded[0]); i++) {
+        ll_emit(lc, "define internal %%SageValue @sage_ll_%s(%%SageValue %%a, %%SageValue %%b) alwaysinline {\n",
+                guarded[i].name);
+        ll_emit(lc, "entry:\n");
+        ll_emit(lc, "  %%x = call double @sage_ll_to_number(%%SageValue %%a)\n");
+        ll_emit(lc, "  %%y = call double @sage_ll_to_number(%%SageValue %%b)\n");
+        if (guarded[i].divide) {
+            ll_emit(lc, "  %%fast = fcmp une double %%y, 0.0\n");
+        } else {
+            ll_emit(lc, "  %%ta = extractvalue %%SageValue %%a, 0\n");
+            ll_emit(lc, "  %%tb = extractvalue %%SageValue %%b, 0\n");
+            ll_emit(lc, "  %%na = icmp eq i32 %%ta, 1\n");
+            ll_emit(lc, "  %%nb = icmp eq i32 %%tb, 1\n");
+            ll_emit(lc, "  %%fast = and i1 %%na, %%nb\n");
+        }
+        ll_emit(lc, "  br i1 %%fast, label %%inline, label %%runtime\n");
+        ll_emit(lc, "inline:\n");
+        ll_emit(lc, "  %%z = %s double %%x, %%y\n", guarded[i].inst);
+        ll_emit(lc, "  %%r = call %%SageValue @sage_ll_%s(%s %%z)\n",
+                guarded[i].compare ? "bool" : "number", guarded[i].compare ? "i1" : "double");
+        ll_emit(lc, "  ret %%SageValue %%r\n");
+        ll_emit(lc, "runtime:\n");
+        ll_emit(lc, "  %%s = call %%SageValue @sage_rt_%s(%%SageValue %%a, %%SageValue %%b)\n", guarded[i].name);
+        ll_emit(lc, "  ret %%SageValue %%s\n}\n");
+    }
+    ll_emit(lc, "\n");
+}
+
 static void emit_type_definitions(LLVMCompiler* lc) {
     ll_emit(lc, "; SageLang LLVM IR - generated by sage compiler\n");
     ll_emit(lc, "target datalayout = \"e-m:e-p270:32:32-p271:32:32-p272:64:64-i64:64-f80:128-n8:16:32:64-S128\"\n");
@@ -985,6 +1133,8 @@ static void emit_type_definitions(LLVMCompiler* lc) {
     ll_emit(lc, "declare %%SageValue @sage_rt_gpu_get_platform()\n");
     ll_emit(lc, "declare %%SageValue @sage_rt_gpu_detected_platform()\n");
     ll_emit(lc, "\n");
+
+    emit_inline_helpers(lc);
 }
 
 // ============================================================================
@@ -1292,6 +1442,239 @@ static int llvm_try_emit_gpu_call(LLVMCompiler* lc, const char* method, int* arg
     return -1;  // Not a known GPU method
 }
 
+// ============================================================================
+// Typed Lowering
+//
+// The AOT backend's inference (aot_infer_types / aot_enter_scope in aot.c)
+// proves some locals and expressions INT, FLOAT or BOOL. Those live in i64,
+// double and i1 allocas and registers and are only boxed into a %SageValue
+// where they escape: calls, returns, containers, globals and print. Globals,
+// parameters and names a proc captures stay boxed, as in the AOT backend.
+// Typed top-level lets no proc mentions become locals of main().
+// ============================================================================
+
+static int llvm_emit_expr(LLVMCompiler* lc, Expr* expr);
+static int llvm_emit_boxed(LLVMCompiler* lc, Expr* expr);
+static int llvm_emit_native(LLVMCompiler* lc, Expr* expr, JitTypeTag want);
+
+static int llvm_is_unboxed(JitTypeTag t) {
+    return t == JIT_TYPE_INT || t == JIT_TYPE_FLOAT || t == JIT_TYPE_BOOL;
+}
+
+static const char* llvm_native_type(JitTypeTag t) {
+    switch (t) {
+        case JIT_TYPE_INT:   return "i64";
+        case JIT_TYPE_FLOAT: return "double";
+        case JIT_TYPE_BOOL:  return "i1";
+        default:             return "%SageValue";
+    }
+}
+
+static JitTypeTag llvm_expr_type(LLVMCompiler* lc, Expr* expr) {
+    if (lc->types == NULL || expr == NULL) return JIT_TYPE_UNKNOWN;
+    return aot_infer_expr_type(lc->types, expr);
+}
+
+// Storage type of a local; globals are always %SageValue.
+static JitTypeTag llvm_var_type(LLVMCompiler* lc, const char* name) {
+    if (lc->types == NULL || llc_is_global(lc, name)) return JIT_TYPE_UNKNOWN;
+    JitTypeTag t = aot_get_var_type(lc->types, name);
+    return llvm_is_unboxed(t) ? t : JIT_TYPE_UNKNOWN;
+}
+
+static void llvm_emit_local_alloca(LLVMCompiler* lc, const char* name) {
+    JitTypeTag t = llvm_var_type(lc, name);
+    if (llvm_is_unboxed(t)) ll_line(lc, "%%%s = alloca %s", name, llvm_native_type(t));
+    else ll_line(lc, "%%%s = alloca %%SageValue", name);
+}
+
+static int llvm_box(LLVMCompiler* lc, JitTypeTag t, int reg) {
+    if (t == JIT_TYPE_BOOL) {
+        int r = llc_new_reg(lc);
+        ll_line(lc, "%%%d = call %%SageValue @sage_ll_bool(i1 %%%d)", r, reg);
+        return r;
+    }
+    if (t == JIT_TYPE_INT) {
+        int d = llc_new_reg(lc);
+        ll_line(lc, "%%%d = sitofp i64 %%%d to double", d, reg);
+        reg = d;
+    }
+    int r = llc_new_reg(lc);
+    ll_line(lc, "%%%d = call %%SageValue @sage_ll_number(double %%%d)", r, reg);
+    return r;
+}
+
+static int llvm_unbox(LLVMCompiler* lc, JitTypeTag t, int boxed) {
+    int r = llc_new_reg(lc);
+    if (t == JIT_TYPE_BOOL) {
+        ll_line(lc, "%%%d = call i1 @sage_ll_truthy(%%SageValue %%%d)", r, boxed);
+        return r;
+    }
+    ll_line(lc, "%%%d = call double @sage_ll_to_number(%%SageValue %%%d)", r, boxed);
+    if (t != JIT_TYPE_INT) return r;
+    int i = llc_new_reg(lc);
+    ll_line(lc, "%%%d = fptosi double %%%d to i64", i, r);
+    return i;
+}
+
+// Convert between native representations; numbers are truthy when non-zero.
+static int llvm_convert(LLVMCompiler* lc, JitTypeTag from, JitTypeTag to, int reg) {
+    if (from == to) return reg;
+    int r = llc_new_reg(lc);
+    if (to == JIT_TYPE_BOOL) {
+        if (from == JIT_TYPE_INT) ll_line(lc, "%%%d = icmp ne i64 %%%d, 0", r, reg);
+        else ll_line(lc, "%%%d = fcmp une double %%%d, 0.0", r, reg);
+    } else if (to == JIT_TYPE_FLOAT) {
+        ll_line(lc, "%%%d = %s %s %%%d to double", r,
+                from == JIT_TYPE_INT ? "sitofp" : "uitofp", llvm_native_type(from), reg);
+    } else if (from == JIT_TYPE_FLOAT) {
+        ll_line(lc, "%%%d = fptosi double %%%d to i64", r, reg);
+    } else {
+        ll_line(lc, "%%%d = zext i1 %%%d to i64", r, reg);
+    }
+    return r;
+}
+
+// i1 truth value of a condition, without a %SageValue when it is typed.
+static int llvm_emit_cond(LLVMCompiler* lc, Expr* expr) {
+    if (llvm_is_unboxed(llvm_expr_type(lc, expr))) return llvm_emit_native(lc, expr, JIT_TYPE_BOOL);
+    int boxed = llvm_emit_expr(lc, expr);
+    return llvm_unbox(lc, JIT_TYPE_BOOL, boxed);
+}
+
+static int llvm_is_nonzero_literal(Expr* expr) {
+    return expr != NULL && expr->type == EXPR_NUMBER && expr->as.number.value != 0.0;
+}
+
+// Short-circuit `and` / `or` over i1 values. Each side ends in a block of
+// our own so the phi can name its predecessors.
+static int llvm_emit_logical(LLVMCompiler* lc, Expr* expr) {
+    int is_and = expr->as.binary.op.type == TOKEN_AND;
+    int left = llvm_emit_cond(lc, expr->as.binary.left);
+    int left_label = llc_new_label(lc);
+    int right_label = llc_new_label(lc);
+    int right_end = llc_new_label(lc);
+    int merge_label = llc_new_label(lc);
+    ll_line(lc, "br label %%L%d", left_label);
+    ll_emit(lc, "L%d:\n", left_label);
+    if (is_and) ll_line(lc, "br i1 %%%d, label %%L%d, label %%L%d", left, right_label, merge_label);
+    else ll_line(lc, "br i1 %%%d, label %%L%d, label %%L%d", left, merge_label, right_label);
+    ll_emit(lc, "L%d:\n", right_label);
+    int right = llvm_emit_cond(lc, expr->as.binary.right);
+    ll_line(lc, "br label %%L%d", right_end);
+    ll_emit(lc, "L%d:\n", right_end);
+    ll_line(lc, "br label %%L%d", merge_label);
+    ll_emit(lc, "L%d:\n", merge_label);
+    int r = llc_new_reg(lc);
+    ll_line(lc, "%%%d = phi i1 [ %s, %%L%d ], [ %%%d, %%L%d ]", r,
+            is_and ? "false" : "true", left_label, right, right_end);
+    return r;
+}
+
+// Native binary operation of type `own`, or -1 when only the generic
+// runtime implements it (mixed operands, a divisor that may be zero).
+static int llvm_emit_native_binary(LLVMCompiler* lc, Expr* expr, JitTypeTag own) {
+    int op = expr->as.binary.op.type;
+    Expr* left = expr->as.binary.left;
+    Expr* right = expr->as.binary.right;
+
+    if (op == TOKEN_AND || op == TOKEN_OR) return llvm_emit_logical(lc, expr);
+    if (op == TOKEN_NOT) {
+        int a = llvm_emit_cond(lc, left);
+        int r = llc_new_reg(lc);
+        ll_line(lc, "%%%d = xor i1 %%%d, true", r, a);
+        return r;
+    }
+    if (op == TOKEN_TILDE) {
+        int a = llvm_emit_native(lc, left, JIT_TYPE_INT);
+        int r = llc_new_reg(lc);
+        ll_line(lc, "%%%d = xor i64 %%%d, -1", r, a);
+        return r;
+    }
+    if (op == TOKEN_SLASH && !llvm_is_nonzero_literal(right)) return -1;
+    if (op == TOKEN_PERCENT && own == JIT_TYPE_FLOAT && !llvm_is_nonzero_literal(right)) return -1;
+
+    // Operands are converted to the type the operation is carried out in
+    JitTypeTag operand = own;
+    if (own == JIT_TYPE_BOOL) {
+        JitTypeTag lt = llvm_expr_type(lc, left);
+        JitTypeTag rt = llvm_expr_type(lc, right);
+        if ((lt == JIT_TYPE_INT || lt == JIT_TYPE_FLOAT) && (rt == JIT_TYPE_INT || rt == JIT_TYPE_FLOAT)) {
+            operand = lt == JIT_TYPE_INT && rt == JIT_TYPE_INT ? JIT_TYPE_INT : JIT_TYPE_FLOAT;
+        } else if (!(lt == JIT_TYPE_BOOL && rt == JIT_TYPE_BOOL && (op == TOKEN_EQ || op == TOKEN_NEQ))) {
+            return -1;
+        }
+    }
+
+    const char* inst = NULL;
+    int is_int = operand == JIT_TYPE_INT;
+    switch (op) {
+        case TOKEN_PLUS:    inst = is_int ? "add" : "fadd"; break;
+        case TOKEN_MINUS:   inst = is_int ? "sub" : "fsub"; break;
+        case TOKEN_STAR:    inst = is_int ? "mul" : "fmul"; break;
+        case TOKEN_SLASH:   inst = is_int ? NULL : "fdiv"; break;
+        case TOKEN_PERCENT: inst = is_int ? "srem" : "frem"; break;
+        case TOKEN_AMP:     inst = is_int ? "and" : NULL; break;
+        case TOKEN_PIPE:    inst = is_int ? "or" : NULL; break;
+        case TOKEN_CARET:   inst = is_int ? "xor" : NULL; break;
+        case TOKEN_EQ:      inst = operand == JIT_TYPE_FLOAT ? "fcmp oeq" : "icmp eq"; break;
+        case TOKEN_NEQ:     inst = operand == JIT_TYPE_FLOAT ? "fcmp une" : "icmp ne"; break;
+        case TOKEN_LT:      inst = is_int ? "icmp slt" : "fcmp olt"; break;
+        case TOKEN_GT:      inst = is_int ? "icmp sgt" : "fcmp ogt"; break;
+        case TOKEN_LTE:     inst = is_int ? "icmp sle" : "fcmp ole"; break;
+        case TOKEN_GTE:     inst = is_int ? "icmp sge" : "fcmp oge"; break;
+        default: break;
+    }
+    if (inst == NULL) return -1;
+
+    int a = llvm_emit_native(lc, left, operand);
+    int b = llvm_emit_native(lc, right, operand);
+    int r = llc_new_reg(lc);
+    ll_line(lc, "%%%d = %s %s %%%d, %%%d", r, inst, llvm_native_type(operand), a, b);
+    return r;
+}
+
+// `expr` as an i64 / double / i1 register converted to `want`. Expressions
+// the inference could not type are evaluated boxed and unboxed.
+static int llvm_emit_native(LLVMCompiler* lc, Expr* expr, JitTypeTag want) {
+    JitTypeTag own = llvm_expr_type(lc, expr);
+    if (!llvm_is_unboxed(own)) return llvm_unbox(lc, want, llvm_emit_expr(lc, expr));
+
+    int r = -1;
+    switch (expr->type) {
+        case EXPR_NUMBER:
+            r = llc_new_reg(lc);
+            if (own == JIT_TYPE_INT) {
+                ll_line(lc, "%%%d = add i64 0, %lld", r, (long long)expr->as.number.value);
+            } else {
+                // fadd with -0.0 is the identity for every double, +0.0 included
+                ll_line(lc, "%%%d = fadd double -0.0, %.17e", r, expr->as.number.value);
+            }
+            break;
+        case EXPR_BOOL:
+            r = llc_new_reg(lc);
+            ll_line(lc, "%%%d = or i1 false, %s", r, expr->as.boolean.value ? "true" : "false");
+            break;
+        case EXPR_VARIABLE: {
+            char* name = token_to_str(expr->as.variable.name);
+            if (llvm_var_type(lc, name) == own) {
+                r = llc_new_reg(lc);
+                ll_line(lc, "%%%d = load %s, %s* %%%s", r, llvm_native_type(own), llvm_native_type(own), name);
+            }
+            free(name);
+            break;
+        }
+        case EXPR_BINARY:
+            r = llvm_emit_native_binary(lc, expr, own);
+            break;
+        default:
+            break;
+    }
+    // Typed, but only the generic runtime implements it: unbox the result
+    if (r < 0) r = llvm_unbox(lc, own, llvm_emit_boxed(lc, expr));
+    return llvm_convert(lc, own, want, r);
+}
+
 // ============================================================================
 // Collect top-level symbols
 // ============================================================================
@@ -1316,8 +1699,9 @@ static void llvm_collect_symbols(LLVMCompiler* lc, Stmt* program) {
             llc_add_proc(lc, name);
             free(name);
         } else if (s->type == STMT_LET) {
+            // Typed lets no proc can see become locals of main()
             char* name = token_to_str(s->as.let.name);
-            llc_add_global(lc, name);
+            if (!llvm_is_unboxed(aot_get_var_type(lc->types, name))) llc_add_global(lc, name);
             free(name);
         } else if (s->type == STMT_IMPORT) {
             if (s->as.import.module_name != NULL) {
@@ -1367,19 +1751,25 @@ static void llvm_collect_symbols(LLVMCompiler* lc, Stmt* program) {
 // Expression Emission - returns SSA register number
 // ============================================================================
 
-static int llvm_emit_expr(LLVMCompiler* lc, Expr* expr);
-
 static int llvm_emit_expr(LLVMCompiler* lc, Expr* expr) {
+    if (expr != NULL && (expr->type == EXPR_VARIABLE || expr->type == EXPR_BINARY)) {
+        JitTypeTag t = llvm_expr_type(lc, expr);
+        if (llvm_is_unboxed(t)) return llvm_box(lc, t, llvm_emit_native(lc, expr, t));
+    }
+    return llvm_emit_boxed(lc, expr);
+}
+
+static int llvm_emit_boxed(LLVMCompiler* lc, Expr* expr) {
     if (expr == NULL) {
         int r = llc_new_reg(lc);
-        ll_line(lc, "%%%d = call %%SageValue @sage_rt_nil()", r);
+        ll_line(lc, "%%%d = call %%SageValue @sage_ll_nil()", r);
         return r;
     }
 
     switch (expr->type) {
         case EXPR_NUMBER: {
             int r = llc_new_reg(lc);
-            ll_line(lc, "%%%d = call %%SageValue @sage_rt_number(double %.17e)", r, expr->as.number.value);
+            ll_line(lc, "%%%d = call %%SageValue @sage_ll_number(double %.17e)", r, expr->as.number.value);
             return r;
         }
         case EXPR_STRING: {
@@ -1394,12 +1784,12 @@ static int llvm_emit_expr(LLVMCompiler* lc, Expr* expr) {
         }
         case EXPR_BOOL: {
             int r = llc_new_reg(lc);
-            ll_line(lc, "%%%d = call %%SageValue @sage_rt_bool(i32 %d)", r, expr->as.boolean.value ? 1 : 0);
+            ll_line(lc, "%%%d = call %%SageValue @sage_ll_bool(i1 %s)", r, expr->as.boolean.value ? "true" : "false");
             return r;
         }
         case EXPR_NIL: {
             int r = llc_new_reg(lc);
-            ll_line(lc, "%%%d = call %%SageValue @sage_rt_nil()", r);
+            ll_line(lc, "%%%d = call %%SageValue @sage_ll_nil()", r);
             return r;
         }
         case EXPR_BINARY: {
@@ -1412,30 +1802,30 @@ static int llvm_emit_expr(LLVMCompiler* lc, Expr* expr) {
 
             if (op_len == 1) {
                 switch (*op) {
-                    case '+': ll_line(lc, "%%%d = call %%SageValue @sage_rt_add(%%SageValue %%%d, %%SageValue %%%d)", r, left, right); break;
-                    case '-': ll_line(lc, "%%%d = call %%SageValue @sage_rt_sub(%%SageValue %%%d, %%SageValue %%%d)", r, left, right); break;
-                    case '*': ll_line(lc, "%%%d = call %%SageValue @sage_rt_mul(%%SageValue %%%d, %%SageValue %%%d)", r, left, right); break;
-                    case '/': ll_line(lc, "%%%d = call %%SageValue @sage_rt_div(%%SageValue %%%d, %%SageValue %%%d)", r, left, right); break;
-                    case '%': ll_line(lc, "%%%d = call %%SageValue @sage_rt_mod(%%SageValue %%%d, %%SageValue %%%d)", r, left, right); break;
-                    case '<': ll_line(lc, "%%%d = call %%SageValue @sage_rt_lt(%%SageValue %%%d, %%SageValue %%%d)", r, left, right); break;
-                    case '>': ll_line(lc, "%%%d = call %%SageValue @sage_rt_gt(%%SageValue %%%d, %%SageValue %%%d)", r, left, right); break;
+                    case '+': ll_line(lc, "%%%d = call %%SageValue @sage_ll_add(%%SageValue %%%d, %%SageValue %%%d)", r, left, right); break;
+                    case '-': ll_line(lc, "%%%d = call %%SageValue @sage_ll_sub(%%SageValue %%%d, %%SageValue %%%d)", r, left, right); break;
+                    case '*': ll_line(lc, "%%%d = call %%SageValue @sage_ll_mul(%%SageValue %%%d, %%SageValue %%%d)", r, left, right); break;
+                    case '/': ll_line(lc, "%%%d = call %%SageValue @sage_ll_div(%%SageValue %%%d, %%SageValue %%%d)", r, left, right); break;
+                    case '%': ll_line(lc, "%%%d = call %%SageValue @sage_ll_mod(%%SageValue %%%d, %%SageValue %%%d)", r, left, right); break;
+                    case '<': ll_line(lc, "%%%d = call %%SageValue @sage_ll_lt(%%SageValue %%%d, %%SageValue %%%d)", r, left, right); break;
+                    case '>': ll_line(lc, "%%%d = call %%SageValue @sage_ll_gt(%%SageValue %%%d, %%SageValue %%%d)", r, left, right); break;
                     case '&': ll_line(lc, "%%%d = call %%SageValue @sage_rt_bit_and(%%SageValue %%%d, %%SageValue %%%d)", r, left, right); break;
                     case '|': ll_line(lc, "%%%d = call %%SageValue @sage_rt_bit_or(%%SageValue %%%d, %%SageValue %%%d)", r, left, right); break;
                     case '^': ll_line(lc, "%%%d = call %%SageValue @sage_rt_bit_xor(%%SageValue %%%d, %%SageValue %%%d)", r, left, right); break;
                     case '~': ll_line(lc, "%%%d = call %%SageValue @sage_rt_bit_not(%%SageValue %%%d)", r, left); break;
                     default:
-                        ll_line(lc, "%%%d = call %%SageValue @sage_rt_nil()", r);
+                        ll_line(lc, "%%%d = call %%SageValue @sage_ll_nil()", r);
                         break;
                 }
             } else if (op_len == 2) {
                 if (op[0] == '=' && op[1] == '=') {
-                    ll_line(lc, "%%%d = call %%SageValue @sage_rt_eq(%%SageValue %%%d, %%SageValue %%%d)", r, left, right);
+                    ll_line(lc, "%%%d = call %%SageValue @sage_ll_eq(%%SageValue %%%d, %%SageValue %%%d)", r, left, right);
                 } else if (op[0] == '!' && op[1] == '=') {
-                    ll_line(lc, "%%%d = call %%SageValue @sage_rt_neq(%%SageValue %%%d, %%SageValue %%%d)", r, left, right);
+                    ll_line(lc, "%%%d = call %%SageValue @sage_ll_neq(%%SageValue %%%d, %%SageValue %%%d)", r, left, right);
                 } else if (op[0] == '<' && op[1] == '=') {
-                    ll_line(lc, "%%%d = call %%SageValue @sage_rt_lte(%%SageValue %%%d, %%SageValue %%%d)", r, left, right);
+                    ll_line(lc, "%%%d = call %%SageValue @sage_ll_lte(%%SageValue %%%d, %%SageValue %%%d)", r, left, right);
                 } else if (op[0] == '>' && op[1] == '=') {
-                    ll_line(lc, "%%%d = call %%SageValue @sage_rt_gte(%%SageValue %%%d, %%SageValue %%%d)", r, left, right);
+                    ll_line(lc, "%%%d = call %%SageValue @sage_ll_gte(%%SageValue %%%d, %%SageValue %%%d)", r, left, right);
                 } else if (memcmp(op, "or", 2) == 0) {
                     ll_line(lc, "%%%d = call %%SageValue @sage_rt_or(%%SageValue %%%d, %%SageValue %%%d)", r, left, right);
                 } else if (op[0] == '<' && op[1] == '<') {
@@ -1443,14 +1833,14 @@ static int llvm_emit_expr(LLVMCompiler* lc, Expr* expr) {
                 } else if (op[0] == '>' && op[1] == '>') {
                     ll_line(lc, "%%%d = call %%SageValue @sage_rt_shr(%%SageValue %%%d, %%SageValue %%%d)", r, left, right);
                 } else {
-                    ll_line(lc, "%%%d = call %%SageValue @sage_rt_nil()", r);
+                    ll_line(lc, "%%%d = call %%SageValue @sage_ll_nil()", r);
                 }
             } else if (op_len == 3 && memcmp(op, "and", 3) == 0) {
                 ll_line(lc, "%%%d = call %%SageValue @sage_rt_and(%%SageValue %%%d, %%SageValue %%%d)", r, left, right);
             } else if (op_len == 3 && memcmp(op, "not", 3) == 0) {
-                ll_line(lc, "%%%d = call %%SageValue @sage_rt_not(%%SageValue %%%d)", r, left);
+                ll_line(lc, "%%%d = call %%SageValue @sage_ll_not(%%SageValue %%%d)", r, left);
             } else {
-                ll_line(lc, "%%%d = call %%SageValue @sage_rt_nil()", r);
+                ll_line(lc, "%%%d = call %%SageValue @sage_ll_nil()", r);
             }
             return r;
         }
@@ -1460,7 +1850,7 @@ static int llvm_emit_expr(LLVMCompiler* lc, Expr* expr) {
             // if we reach here, emit nil as a placeholder (module objects don't exist in LLVM mode)
             if (llc_has_module(lc, name)) {
                 int r = llc_new_reg(lc);
-                ll_line(lc, "%%%d = call %%SageValue @sage_rt_nil()", r);
+                ll_line(lc, "%%%d = call %%SageValue @sage_ll_nil()", r);
                 free(name);
                 return r;
             }
@@ -1488,7 +1878,7 @@ static int llvm_emit_expr(LLVMCompiler* lc, Expr* expr) {
                     }
                     case IMPORT_CONST_NIL:
                     default:
-                        ll_line(lc, "%%%d = call %%SageValue @sage_rt_nil()", r);
+                        ll_line(lc, "%%%d = call %%SageValue @sage_ll_nil()", r);
                         break;
                 }
                 free(name);
@@ -1514,6 +1904,10 @@ static int llvm_emit_expr(LLVMCompiler* lc, Expr* expr) {
                 ll_line(lc, "%%%d = call %%SageValue @sage_rt_make_function(i8* %%%d)", r, ptr_reg);
             } else if (is_global) {
                 ll_line(lc, "%%%d = load %%SageValue, %%SageValue* @%s", r, name);
+            } else if (llvm_is_unboxed(llvm_var_type(lc, name))) {
+                JitTypeTag t = llvm_var_type(lc, name);
+                ll_line(lc, "%%%d = load %s, %s* %%%s", r, llvm_native_type(t), llvm_native_type(t), name);
+                r = llvm_box(lc, t, r);
             } else {
                 ll_line(lc, "%%%d = load %%SageValue, %%SageValue* %%%s", r, name);
             }
@@ -1535,7 +1929,7 @@ static int llvm_emit_expr(LLVMCompiler* lc, Expr* expr) {
                 if (lc->parent_class_name == NULL) {
                     fprintf(stderr, "LLVM backend: 'super' used outside a class with a parent\n");
                     int r = llc_new_reg(lc);
-                    ll_line(lc, "%%%d = call %%SageValue @sage_rt_nil()", r);
+                    ll_line(lc, "%%%d = call %%SageValue @sage_ll_nil()", r);
                     if (arg_regs) free(arg_regs);
                     return r;
                 }
@@ -1602,11 +1996,11 @@ static int llvm_emit_expr(LLVMCompiler* lc, Expr* expr) {
                 } else if (strcmp(name, "input") == 0 && expr->as.call.arg_count == 1) {
                     ll_line(lc, "%%%d = call %%SageValue @sage_rt_input(%%SageValue %%%d)", r, arg_regs[0]);
                 } else if (strcmp(name, "gc_disable") == 0) {
-                    ll_line(lc, "%%%d = call %%SageValue @sage_rt_nil()", r);
+                    ll_line(lc, "%%%d = call %%SageValue @sage_ll_nil()", r);
                 } else if (strcmp(name, "gc_enable") == 0) {
-                    ll_line(lc, "%%%d = call %%SageValue @sage_rt_nil()", r);
+                    ll_line(lc, "%%%d = call %%SageValue @sage_ll_nil()", r);
                 } else if (strcmp(name, "gc_collect") == 0) {
-                    ll_line(lc, "%%%d = call %%SageValue @sage_rt_nil()", r);
+                    ll_line(lc, "%%%d = call %%SageValue @sage_ll_nil()", r);
                 } else {
                     // User function call
                     fprintf(lc->out, "  %%%d = call %%SageValue @sage_fn_%s(", r, name);
@@ -1702,7 +2096,7 @@ static int llvm_emit_expr(LLVMCompiler* lc, Expr* expr) {
                         handled = 1;
                     }
                     if (!handled && strcmp(method_name, "benchmark") == 0) {
-                        ll_line(lc, "%%%d = call %%SageValue @sage_rt_nil()", r);
+                        ll_line(lc, "%%%d = call %%SageValue @sage_ll_nil()", r);
                         handled = 1;
                     }
                     if (!handled && strcmp(method_name, "gpu_available") == 0) {
@@ -1717,7 +2111,7 @@ static int llvm_emit_expr(LLVMCompiler* lc, Expr* expr) {
 
                 // Fallback: emit as nil for unrecognized module calls
                 if (!handled) {
-                    ll_line(lc, "%%%d = call %%SageValue @sage_rt_nil()", r);
+                    ll_line(lc, "%%%d = call %%SageValue @sage_ll_nil()", r);
                 }
                 free(mod_name);
                 free(method_name);
@@ -1833,8 +2227,15 @@ static int llvm_emit_expr(LLVMCompiler* lc, Expr* expr) {
         case EXPR_SET: {
             if (expr->as.set.object == NULL) {
                 // Variable assignment: name = value
-                int val = llvm_emit_expr(lc, expr->as.set.value);
                 char* name = token_to_str(expr->as.set.property);
+                JitTypeTag t = llvm_var_type(lc, name);
+                if (llvm_is_unboxed(t)) {
+                    int native = llvm_emit_native(lc, expr->as.set.value, t);
+                    ll_line(lc, "store %s %%%d, %s* %%%s", llvm_native_type(t), native, llvm_native_type(t), name);
+                    free(name);
+                    return llvm_box(lc, t, native);
+                }
+                int val = llvm_emit_expr(lc, expr->as.set.value);
                 // Check if it's a global variable
                 int is_global = 0;
                 for (int i = 0; i < lc->global_count; i++) {
@@ -1865,14 +2266,14 @@ static int llvm_emit_expr(LLVMCompiler* lc, Expr* expr) {
             // Await not supported in LLVM backend
             fprintf(stderr, "LLVM backend: await not supported in compiled mode\n");
             int r = llc_new_reg(lc);
-            ll_line(lc, "%%%d = call %%SageValue @sage_rt_nil()", r);
+            ll_line(lc, "%%%d = call %%SageValue @sage_ll_nil()", r);
             return r;
         }
         case EXPR_SUPER: {
             // super.method() in LLVM: emits nil (classes are interpreter-only for now)
             // The LLVM backend doesn't support full class dispatch yet
             int r = llc_new_reg(lc);
-            ll_line(lc, "%%%d = call %%SageValue @sage_rt_nil()", r);
+            ll_line(lc, "%%%d = call %%SageValue @sage_ll_nil()", r);
             return r;
         }
         // Phase 17: comptime expression — emit inner expression
@@ -1880,7 +2281,7 @@ static int llvm_emit_expr(LLVMCompiler* lc, Expr* expr) {
             return llvm_emit_expr(lc, expr->as.comptime.expression);
         default: {
             int r = llc_new_reg(lc);
-            ll_line(lc, "%%%d = call %%SageValue @sage_rt_nil()", r);
+            ll_line(lc, "%%%d = call %%SageValue @sage_ll_nil()", r);
             return r;
         }
     }
@@ -1899,6 +2300,100 @@ static void llvm_emit_stmt_list(LLVMCompiler* lc, Stmt* head) {
     }
 }
 
+// Store the loop variable from `reg`, which holds a value of type `from`
+// (JIT_TYPE_UNKNOWN: a %SageValue).
+static void llvm_store_loop_var(LLVMCompiler* lc, const char* name, JitTypeTag from, int reg) {
+    JitTypeTag t = llvm_var_type(lc, name);
+    if (llvm_is_unboxed(t)) {
+        int native = llvm_is_unboxed(from) ? llvm_convert(lc, from, t, reg) : llvm_unbox(lc, t, reg);
+        ll_line(lc, "store %s %%%d, %s* %%%s", llvm_native_type(t), native, llvm_native_type(t), name);
+        return;
+    }
+    if (llvm_is_unboxed(from)) reg = llvm_box(lc, from, reg);
+    ll_line(lc, "store %%SageValue %%%d, %%SageValue* %%%s", reg, name);
+}
+
+// Integer value of a literal range() step: `3`, or `-3` before constant
+// folding has turned the parser's (0 - 3) into a number.
+static int llvm_literal_step(Expr* expr, long long* out) {
+    double value;
+    if (expr->type == EXPR_NUMBER) {
+        value = expr->as.number.value;
+    } else if (expr->type == EXPR_BINARY && expr->as.binary.op.type == TOKEN_MINUS &&
+               expr->as.binary.left->type == EXPR_NUMBER && expr->as.binary.left->as.number.value == 0.0 &&
+               expr->as.binary.right != NULL && expr->as.binary.right->type == EXPR_NUMBER) {
+        value = -expr->as.binary.right->as.number.value;
+    } else {
+        return 0;
+    }
+    if (value != (double)(long long)value || value == 0.0) return 0;
+    *out = (long long)value;
+    return 1;
+}
+
+// `for v in range(...)` as an i64 counting loop instead of materializing the
+// array: range(end), range(start, end) and range(start, end, step) with a
+// literal step. Bounds are truncated like the interpreter's range().
+static int llvm_emit_range_for(LLVMCompiler* lc, Stmt* stmt) {
+    Expr* iterable = stmt->as.for_stmt.iterable;
+    if (iterable == NULL || iterable->type != EXPR_CALL ||
+        iterable->as.call.callee->type != EXPR_VARIABLE) return 0;
+    Token callee = iterable->as.call.callee->as.variable.name;
+    int argc = iterable->as.call.arg_count;
+    if (callee.length != 5 || memcmp(callee.start, "range", 5) != 0 || argc < 1 || argc > 3) return 0;
+    long long step = 1;
+    if (argc == 3 && !llvm_literal_step(iterable->as.call.args[2], &step)) return 0;
+
+    int start = -1;
+    if (argc >= 2) start = llvm_emit_native(lc, iterable->as.call.args[0], JIT_TYPE_INT);
+    int end = llvm_emit_native(lc, iterable->as.call.args[argc == 1 ? 0 : 1], JIT_TYPE_INT);
+
+    char* var_name = token_to_str(stmt->as.for_stmt.variable);
+    int pre_label = llc_new_label(lc);
+    int cond_label = llc_new_label(lc);
+    int body_label = llc_new_label(lc);
+    int next_label = llc_new_label(lc);
+    int end_label = llc_new_label(lc);
+    lc->loop_cond_labels[lc->loop_depth] = next_label;
+    lc->loop_end_labels[lc->loop_depth] = end_label;
+    lc->loop_depth++;
+
+    ll_line(lc, "br label %%L%d", pre_label);
+    ll_emit(lc, "L%d:\n", pre_label);
+    ll_line(lc, "br label %%L%d", cond_label);
+    ll_emit(lc, "L%d:\n", cond_label);
+    if (start >= 0) {
+        ll_line(lc, "%%ctr%d = phi i64 [ %%%d, %%L%d ], [ %%ctr%d.next, %%L%d ]",
+                cond_label, start, pre_label, cond_label, next_label);
+    } else {
+        ll_line(lc, "%%ctr%d = phi i64 [ 0, %%L%d ], [ %%ctr%d.next, %%L%d ]",
+                cond_label, pre_label, cond_label, next_label);
+    }
+    int cmp = llc_new_reg(lc);
+    ll_line(lc, "%%%d = icmp %s i64 %%ctr%d, %%%d", cmp, step > 0 ? "slt" : "sgt", cond_label, end);
+    char prof[32];
+    llc_site_weights(lc, PROFILE_LOOP, &stmt->as.for_stmt.variable, prof, sizeof(prof));
+    ll_line(lc, "br i1 %%%d, label %%L%d, label %%L%d%s", cmp, body_label, end_label, prof);
+
+    ll_emit(lc, "L%d:\n", body_label);
+    int counter = llc_new_reg(lc);
+    ll_line(lc, "%%%d = add i64 %%ctr%d, 0", counter, cond_label);
+    llvm_store_loop_var(lc, var_name, JIT_TYPE_INT, counter);
+    lc->block_terminated = 0;
+    llvm_emit_stmt_list(lc, stmt->as.for_stmt.body);
+    if (!lc->block_terminated) ll_line(lc, "br label %%L%d", next_label);
+
+    ll_emit(lc, "L%d:\n", next_label);
+    ll_line(lc, "%%ctr%d.next = add i64 %%ctr%d, %lld", cond_label, cond_label, step);
+    ll_line(lc, "br label %%L%d", cond_label);
+
+    ll_emit(lc, "L%d:\n", end_label);
+    lc->block_terminated = 0;
+    lc->loop_depth--;
+    free(var_name);
+    return 1;
+}
+
 static void llvm_emit_stmt(LLVMCompiler* lc, Stmt* stmt) {
     if (stmt == NULL) return;
 
@@ -1914,26 +2409,31 @@ static void llvm_emit_stmt(LLVMCompiler* lc, Stmt* stmt) {
         }
         case STMT_LET: {
             char* name = token_to_str(stmt->as.let.name);
-            int val = llvm_emit_expr(lc, stmt->as.let.initializer);
-            ll_line(lc, "store %%SageValue %%%d, %%SageValue* %%%s", val, name);
+            JitTypeTag t = llvm_var_type(lc, name);
+            if (llvm_is_unboxed(t)) {
+                int native = llvm_emit_native(lc, stmt->as.let.initializer, t);
+                ll_line(lc, "store %s %%%d, %s* %%%s", llvm_native_type(t), native, llvm_native_type(t), name);
+            } else {
+                int val = llvm_emit_expr(lc, stmt->as.let.initializer);
+                ll_line(lc, "store %%SageValue %%%d, %%SageValue* %%%s", val, name);
+            }
             free(name);
             break;
         }
         case STMT_IF: {
-            int cond_val = llvm_emit_expr(lc, stmt->as.if_stmt.condition);
-            int bool_reg = llc_new_reg(lc);
-            ll_line(lc, "%%%d = call i32 @sage_rt_get_bool(%%SageValue %%%d)", bool_reg, cond_val);
-            int cmp_reg = llc_new_reg(lc);
-            ll_line(lc, "%%%d = icmp ne i32 %%%d, 0", cmp_reg, bool_reg);
+            int cmp_reg = llvm_emit_cond(lc, stmt->as.if_stmt.condition);
 
             int then_label = llc_new_label(lc);
             int else_label = llc_new_label(lc);
             int merge_label = llc_new_label(lc);
 
+            char prof[32];
+            llc_site_weights(lc, PROFILE_BRANCH, profile_anchor(stmt->as.if_stmt.condition),
+                             prof, sizeof(prof));
             if (stmt->as.if_stmt.else_branch != NULL) {
-                ll_line(lc, "br i1 %%%d, label %%L%d, label %%L%d", cmp_reg, then_label, else_label);
+                ll_line(lc, "br i1 %%%d, label %%L%d, label %%L%d%s", cmp_reg, then_label, else_label, prof);
             } else {
-                ll_line(lc, "br i1 %%%d, label %%L%d, label %%L%d", cmp_reg, then_label, merge_label);
+                ll_line(lc, "br i1 %%%d, label %%L%d, label %%L%d%s", cmp_reg, then_label, merge_label, prof);
             }
 
             ll_emit(lc, "L%d:\n", then_label);
@@ -1970,12 +2470,11 @@ static void llvm_emit_stmt(LLVMCompiler* lc, Stmt* stmt) {
             ll_line(lc, "br label %%L%d", cond_label);
             ll_emit(lc, "L%d:\n", cond_label);
 
-            int cond_val = llvm_emit_expr(lc, stmt->as.while_stmt.condition);
-            int bool_reg = llc_new_reg(lc);
-            ll_line(lc, "%%%d = call i32 @sage_rt_get_bool(%%SageValue %%%d)", bool_reg, cond_val);
-            int cmp_reg = llc_new_reg(lc);
-            ll_line(lc, "%%%d = icmp ne i32 %%%d, 0", cmp_reg, bool_reg);
-            ll_line(lc, "br i1 %%%d, label %%L%d, label %%L%d", cmp_reg, body_label, end_label);
+            int cmp_reg = llvm_emit_cond(lc, stmt->as.while_stmt.condition);
+            char prof[32];
+            llc_site_weights(lc, PROFILE_LOOP, profile_anchor(stmt->as.while_stmt.condition),
+                             prof, sizeof(prof));
+            ll_line(lc, "br i1 %%%d, label %%L%d, label %%L%d%s", cmp_reg, body_label, end_label, prof);
 
             ll_emit(lc, "L%d:\n", body_label);
             lc->block_terminated = 0;
@@ -1997,7 +2496,7 @@ static void llvm_emit_stmt(LLVMCompiler* lc, Stmt* stmt) {
                 ll_line(lc, "ret %%SageValue %%%d", r);
             } else {
                 int r = llc_new_reg(lc);
-                ll_line(lc, "%%%d = call %%SageValue @sage_rt_nil()", r);
+                ll_line(lc, "%%%d = call %%SageValue @sage_ll_nil()", r);
                 ll_line(lc, "ret %%SageValue %%%d", r);
             }
             lc->block_terminated = 1;
@@ -2013,6 +2512,8 @@ static void llvm_emit_stmt(LLVMCompiler* lc, Stmt* stmt) {
                 lc->failed = 1;
                 return;
             }
+            if (llvm_emit_range_for(lc, stmt)) break;
+
             // Emit iterable (must be array)
             int iter = llvm_emit_expr(lc, stmt->as.for_stmt.iterable);
             int len_reg = llc_new_reg(lc);
@@ -2020,53 +2521,52 @@ static void llvm_emit_stmt(LLVMCompiler* lc, Stmt* stmt) {
 
             // Loop variable (alloca already emitted by collect_local_names at function entry)
             char* var_name = token_to_str(stmt->as.for_stmt.variable);
-            int idx_ptr = llc_new_reg(lc);
-            ll_line(lc, "%%%d = alloca i32", idx_ptr);
-            ll_line(lc, "store i32 0, i32* %%%d", idx_ptr);
-
+            int pre_label = llc_new_label(lc);
             int cond_label = llc_new_label(lc);
             int body_label = llc_new_label(lc);
+            int next_label = llc_new_label(lc);
             int end_label = llc_new_label(lc);
 
             // Push loop labels for break/continue
-            lc->loop_cond_labels[lc->loop_depth] = cond_label;
+            lc->loop_cond_labels[lc->loop_depth] = next_label;
             lc->loop_end_labels[lc->loop_depth] = end_label;
             lc->loop_depth++;
 
+            // The index is a phi of the preheader and the latch (named, since
+            // the latch's increment is defined after the phi refers to it)
+            ll_line(lc, "br label %%L%d", pre_label);
+            ll_emit(lc, "L%d:\n", pre_label);
             ll_line(lc, "br label %%L%d", cond_label);
             ll_emit(lc, "L%d:\n", cond_label);
-
-            int cur_idx = llc_new_reg(lc);
-            ll_line(lc, "%%%d = load i32, i32* %%%d", cur_idx, idx_ptr);
+            ll_line(lc, "%%idx%d = phi i32 [ 0, %%L%d ], [ %%idx%d.next, %%L%d ]",
+                    cond_label, pre_label, cond_label, next_label);
             int cmp = llc_new_reg(lc);
-            ll_line(lc, "%%%d = icmp slt i32 %%%d, %%%d", cmp, cur_idx, len_reg);
-            ll_line(lc, "br i1 %%%d, label %%L%d, label %%L%d", cmp, body_label, end_label);
+            ll_line(lc, "%%%d = icmp slt i32 %%idx%d, %%%d", cmp, cond_label, len_reg);
+            char prof[32];
+            llc_site_weights(lc, PROFILE_LOOP, &stmt->as.for_stmt.variable, prof, sizeof(prof));
+            ll_line(lc, "br i1 %%%d, label %%L%d, label %%L%d%s", cmp, body_label, end_label, prof);
 
             ll_emit(lc, "L%d:\n", body_label);
 
             // Get current element: arr[idx]
-            // Convert i32 idx to SageValue number for indexing
             int idx_double = llc_new_reg(lc);
-            ll_line(lc, "%%%d = sitofp i32 %%%d to double", idx_double, cur_idx);
+            ll_line(lc, "%%%d = sitofp i32 %%idx%d to double", idx_double, cond_label);
             int idx_sage = llc_new_reg(lc);
-            ll_line(lc, "%%%d = call %%SageValue @sage_rt_number(double %%%d)", idx_sage, idx_double);
+            ll_line(lc, "%%%d = call %%SageValue @sage_ll_number(double %%%d)", idx_sage, idx_double);
             int elem = llc_new_reg(lc);
             ll_line(lc, "%%%d = call %%SageValue @sage_rt_index(%%SageValue %%%d, %%SageValue %%%d)", elem, iter, idx_sage);
-
-            // Store element in loop variable
-            ll_line(lc, "store %%SageValue %%%d, %%SageValue* %%%s", elem, var_name);
+            llvm_store_loop_var(lc, var_name, JIT_TYPE_UNKNOWN, elem);
 
             lc->block_terminated = 0;
             llvm_emit_stmt_list(lc, stmt->as.for_stmt.body);
+            if (!lc->block_terminated) ll_line(lc, "br label %%L%d", next_label);
 
-            if (!lc->block_terminated) {
-                int next_idx = llc_new_reg(lc);
-                ll_line(lc, "%%%d = add nsw i32 %%%d, 1", next_idx, cur_idx);
-                ll_line(lc, "store i32 %%%d, i32* %%%d", next_idx, idx_ptr);
-                ll_line(lc, "br label %%L%d", cond_label);
-            }
+            ll_emit(lc, "L%d:\n", next_label);
+            ll_line(lc, "%%idx%d.next = add nsw i32 %%idx%d, 1", cond_label, cond_label);
+            ll_line(lc, "br label %%L%d", cond_label);
 
             ll_emit(lc, "L%d:\n", end_label);
+            lc->block_terminated = 0;
 
             lc->loop_depth--;
             free(var_name);
@@ -2133,8 +2633,8 @@ static void llvm_emit_stmt(LLVMCompiler* lc, Stmt* stmt) {
                 int bool_reg = lc->next_reg++;
                 int lbl_then = llc_new_label(lc);
                 int lbl_next = llc_new_label(lc);
-                fprintf(lc->out, "  %%%d = call %%SageValue @sage_rt_eq(%%SageValue %%%d, %%SageValue %%%d)\n", cmp_reg, match_val, pat_reg);
-                fprintf(lc->out, "  %%%d = call i1 @sage_rt_get_bool(%%SageValue %%%d)\n", bool_reg, cmp_reg);
+                fprintf(lc->out, "  %%%d = call %%SageValue @sage_ll_eq(%%SageValue %%%d, %%SageValue %%%d)\n", cmp_reg, match_val, pat_reg);
+                fprintf(lc->out, "  %%%d = call i1 @sage_ll_truthy(%%SageValue %%%d)\n", bool_reg, cmp_reg);
                 fprintf(lc->out, "  br i1 %%%d, label %%L%d, label %%L%d\n", bool_reg, lbl_then, lbl_next);
                 fprintf(lc->out, "L%d:\n", lbl_then);
                 lc->block_terminated = 0;
@@ -2263,6 +2763,8 @@ static void collect_local_names(Stmt* stmt, char*** names, int* count, int* cap)
 static void llvm_emit_function(LLVMCompiler* lc, Stmt* proc) {
     lc->block_terminated = 0;
     char* name = token_to_str(proc->as.proc.name);
+    AotTypeEnv outer = aot_enter_scope(lc->types, proc->as.proc.params, proc->as.proc.param_count,
+                                       proc->as.proc.body, NULL);
 
     fprintf(lc->out, "define %%SageValue @sage_fn_%s(", name);
     for (int i = 0; i < proc->as.proc.param_count; i++) {
@@ -2271,7 +2773,10 @@ static void llvm_emit_function(LLVMCompiler* lc, Stmt* proc) {
         fprintf(lc->out, "%%SageValue %%arg_%s", param);
         free(param);
     }
-    fputs(") {\n", lc->out);
+    // Procedures the profiled run never entered are laid out away from hot code.
+    int cold = lc->profile != NULL &&
+               profile_function_heat(lc->profile, &proc->as.proc) == PROFILE_HEAT_COLD;
+    fputs(cold ? ") cold {\n" : ") {\n", lc->out);
     int entry_label = llc_new_label(lc);
     ll_emit(lc, "L%d:\n", entry_label);
 
@@ -2296,9 +2801,7 @@ static void llvm_emit_function(LLVMCompiler* lc, Stmt* proc) {
             free(p);
             if (is_param) break;
         }
-        if (!is_param) {
-            ll_line(lc, "%%%s = alloca %%SageValue", locals[i]);
-        }
+        if (!is_param) llvm_emit_local_alloca(lc, locals[i]);
         free(locals[i]);
     }
     free(locals);
@@ -2309,11 +2812,12 @@ static void llvm_emit_function(LLVMCompiler* lc, Stmt* proc) {
     // Default return nil (only if block not already terminated)
     if (!lc->block_terminated) {
         int nil_reg = llc_new_reg(lc);
-        ll_line(lc, "%%%d = call %%SageValue @sage_rt_nil()", nil_reg);
+        ll_line(lc, "%%%d = call %%SageValue @sage_ll_nil()", nil_reg);
         ll_line(lc, "ret %%SageValue %%%d", nil_reg);
     }
 
     fputs("}\n\n", lc->out);
+    aot_leave_scope(lc->types, outer);
     free(name);
 }
 
@@ -2333,10 +2837,16 @@ static int write_llvm_output(const char* source, const char* input_path, const c
     memset(&lc, 0, sizeof(lc));
     lc.out = out;
     lc.input_path = input_path;
+    lc.profile = profile_active();
     lc.next_reg = 0;
     lc.next_label = 0;
 
-    Stmt* program = parse_program(source);
+    AotCompiler types;
+    aot_init(&types, opt_level);
+    lc.types = &types;
+
+    AstArena* arena = ast_arena_begin();
+    Stmt* program = parse_program(source, input_path);
 
     // Run optimization passes
     if (opt_level > 0) {
@@ -2345,15 +2855,21 @@ static int write_llvm_output(const char* source, const char* input_path, const c
         pass_ctx.debug_info = debug_info;
         pass_ctx.verbose = 0;
         pass_ctx.input_path = input_path;
+        pass_ctx.profile = profile_active();
         program = run_passes(program, &pass_ctx);
     }
 
+    // Infer the script's locals before collecting symbols: typed top-level
+    // lets are kept out of the globals
+    aot_infer_types(&types, program);
+
     // Collect symbols
     llvm_collect_symbols(&lc, program);
     if (lc.failed) {
         fclose(out);
-        free_stmt(program);
+        ast_arena_end(arena);
         llc_free(&lc);
+        aot_free(&types);
         return 0;
     }
 
@@ -2431,9 +2947,7 @@ static int write_llvm_output(const char* source, const char* input_path, const c
             for (int gi = 0; gi < lc.global_count; gi++) {
                 if (strcmp(lc.global_names[gi], main_locals[ml]) == 0) { is_global = 1; break; }
             }
-            if (!is_global) {
-                ll_line(&lc, "%%%s = alloca %%SageValue", main_locals[ml]);
-            }
+            if (!is_global) llvm_emit_local_alloca(&lc, main_locals[ml]);
             free(main_locals[ml]);
         }
         free(main_locals);
@@ -2442,12 +2956,13 @@ static int write_llvm_output(const char* source, const char* input_path, const c
     // Emit top-level statements
     for (Stmt* s = program; s != NULL; s = s->next) {
         if (s->type != STMT_PROC && s->type != STMT_CLASS) {
-            if (s->type == STMT_LET) {
-                char* name = token_to_str(s->as.let.name);
+            char* let_name = s->type == STMT_LET ? token_to_str(s->as.let.name) : NULL;
+            if (let_name != NULL && llc_is_global(&lc, let_name)) {
                 int val = llvm_emit_expr(&lc, s->as.let.initializer);
-                ll_line(&lc, "store %%SageValue %%%d, %%SageValue* @%s", val, name);
-                free(name);
+                ll_line(&lc, "store %%SageValue %%%d, %%SageValue* @%s", val, let_name);
+                free(let_name);
             } else {
+                free(let_name);
                 llvm_emit_stmt(&lc, s);
             }
         }
@@ -2464,9 +2979,17 @@ static int write_llvm_output(const char* source, const char* input_path, const c
         fprintf(out, "\\00\"\n");
     }
 
+    // Profile branch weights referenced by `!prof` above
+    if (lc.branch_weight_count > 0) fputc('\n', out);
+    for (int i = 0; i < lc.branch_weight_count; i++) {
+        fprintf(out, "!%d = !{!\"branch_weights\", i32 %u, i32 %u}\n", i,
+                lc.branch_weights[i][0], lc.branch_weights[i][1]);
+    }
+
     fclose(out);
-    free_stmt(program);
+    ast_arena_end(arena);
     llc_free(&lc);
+    aot_free(&types);
     return 1;
 }
 
@@ -133,11 +133,14 @@ SageValue sage_rt_nil(void) {
 // Truthiness
 // ============================================================================
 
+// Same rules as the interpreter: nil, false, 0 and "" are falsy. The
+// nil / bool / number cases are duplicated inline by @sage_ll_truthy.
 static int is_truthy(SageValue v) {
     switch (v.type) {
         case SAGE_NIL: return 0;
         case SAGE_BOOL: return v.as.boolean != 0;
-        // Sage: 0 is truthy, only nil and false are falsy
+        case SAGE_NUMBER: return v.as.number != 0.0;
+        case SAGE_STRING: return v.as.string != NULL && v.as.string[0] != '\0';
         default: return 1;
     }
 }
@@ -227,13 +230,11 @@ SageValue sage_rt_gte(SageValue a, SageValue b) { return sage_rt_bool(as_num(a)
 // ============================================================================
 
 SageValue sage_rt_and(SageValue a, SageValue b) {
-    if (!is_truthy(a)) return a;
-    return b;
+    return sage_rt_bool(is_truthy(a) && is_truthy(b));
 }
 
 SageValue sage_rt_or(SageValue a, SageValue b) {
-    if (is_truthy(a)) return a;
-    return b;
+    return sage_rt_bool(is_truthy(a) || is_truthy(b));
 }
 
 SageValue sage_rt_not(SageValue a) {
@@ -0,0 +1,672 @@
+#include "pass.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ast_arena.h"
+#include "gc.h"
+
+// ============================================================================
+// Loop Optimization Pass
+//
+// - Range canonicalization (-O1+): `for v in range(...)` whose `range` is
+//   the builtin gets ForStmt.counted set. The C and VM backends then step a
+//   counter through the range instead of building the array first.
+// - Invariant hoisting (-O2+): `len(v)` and `v.field` reads in a `while`
+//   condition are computed once before the loop when nothing in the loop can
+//   change them: no calls, no stores to `v`, to that field or through an
+//   index. Only reads every evaluation of the condition performs are
+//   hoisted, so one that fails still fails before the first iteration.
+//   Numeric invariants are left to the SSA pass.
+// - Strength reduction (-O2+): in counted loops inside procedures with
+//   literal start and step, `v * k` for an integer literal `k` becomes a
+//   variable advanced by `step * k` at the top of each iteration.
+// ============================================================================
+
+#define LOOP_SR_MAX_FACTOR 2097152.0   // 2^21: v * k stays exact in a double
+
+typedef struct NameSet {
+    char* name;
+    struct NameSet* next;
+} NameSet;
+
+static void nameset_add(NameSet** set, const char* name, int len) {
+    for (NameSet* n = *set; n != NULL; n = n->next) {
+        if ((int)strlen(n->name) == len && memcmp(n->name, name, (size_t)len) == 0) return;
+    }
+    NameSet* n = SAGE_ALLOC(sizeof(NameSet));
+    n->name = SAGE_ALLOC((size_t)len + 1);
+    memcpy(n->name, name, (size_t)len);
+    n->name[len] = '\0';
+    n->next = *set;
+    *set = n;
+}
+
+static int nameset_has(NameSet* set, Token name) {
+    for (NameSet* n = set; n != NULL; n = n->next) {
+        if ((int)strlen(n->name) == name.length && memcmp(n->name, name.start, (size_t)name.length) == 0) return 1;
+    }
+    return 0;
+}
+
+static void nameset_free(NameSet* set) {
+    while (set != NULL) {
+        NameSet* next = set->next;
+        free(set->name);
+        free(set);
+        set = next;
+    }
+}
+
+static int token_is(Token tok, const char* str) {
+    return tok.length == (int)strlen(str) && memcmp(tok.start, str, (size_t)tok.length) == 0;
+}
+
+// ============================================================================
+// Effect scan - what a loop can change
+// ============================================================================
+
+typedef struct {
+    int has_call;         // Any call other than builtin len()
+    int has_index_set;    // Stores through `a[i] = v` (may grow a dict)
+    int has_suspend;      // yield / await: other code runs mid-loop
+    NameSet* bound;       // Names assigned, declared or defined
+    NameSet* fields;      // Properties stored to
+} LoopEffects;
+
+typedef struct {
+    NameSet* rebound;     // Names the program binds anywhere, nested bodies included
+    int wildcard_import;  // A `from m import *` may bind anything
+    int next_temp;
+} LoopPass;
+
+static int is_builtin(const LoopPass* lp, const char* name) {
+    Token tok;
+    tok.start = name;
+    tok.length = (int)strlen(name);
+    return !lp->wildcard_import && !nameset_has(lp->rebound, tok);
+}
+
+static void effects_free(LoopEffects* fx) {
+    nameset_free(fx->bound);
+    nameset_free(fx->fields);
+    memset(fx, 0, sizeof(*fx));
+}
+
+static void effects_stmts(const LoopPass* lp, LoopEffects* fx, const Stmt* stmt);
+
+static void effects_expr(const LoopPass* lp, LoopEffects* fx, const Expr* expr) {
+    if (expr == NULL) return;
+    switch (expr->type) {
+        case EXPR_BINARY:
+            effects_expr(lp, fx, expr->as.binary.left);
+            effects_expr(lp, fx, expr->as.binary.right);
+            break;
+        case EXPR_CALL: {
+            const Expr* callee = expr->as.call.callee;
+            if (!(callee->type == EXPR_VARIABLE && token_is(callee->as.variable.name, "len") &&
+                  is_builtin(lp, "len"))) {
+                fx->has_call = 1;
+            }
+            effects_expr(lp, fx, callee);
+            for (int i = 0; i < expr->as.call.arg_count; i++) effects_expr(lp, fx, expr->as.call.args[i]);
+            break;
+        }
+        case EXPR_ARRAY:
+            for (int i = 0; i < expr->as.array.count; i++) effects_expr(lp, fx, expr->as.array.elements[i]);
+            break;
+        case EXPR_DICT:
+            for (int i = 0; i < expr->as.dict.count; i++) effects_expr(lp, fx, expr->as.dict.values[i]);
+            break;
+        case EXPR_TUPLE:
+            for (int i = 0; i < expr->as.tuple.count; i++) effects_expr(lp, fx, expr->as.tuple.elements[i]);
+            break;
+        case EXPR_INDEX:
+            effects_expr(lp, fx, expr->as.index.array);
+            effects_expr(lp, fx, expr->as.index.index);
+            break;
+        case EXPR_INDEX_SET:
+            fx->has_index_set = 1;
+            effects_expr(lp, fx, expr->as.index_set.array);
+            effects_expr(lp, fx, expr->as.index_set.index);
+            effects_expr(lp, fx, expr->as.index_set.value);
+            break;
+        case EXPR_SLICE:
+            effects_expr(lp, fx, expr->as.slice.array);
+            effects_expr(lp, fx, expr->as.slice.start);
+            effects_expr(lp, fx, expr->as.slice.end);
+            break;
+        case EXPR_GET:
+            effects_expr(lp, fx, expr->as.get.object);
+            break;
+        case EXPR_SET:
+            if (expr->as.set.object == NULL) {
+                nameset_add(&fx->bound, expr->as.set.property.start, expr->as.set.property.length);
+            } else {
+                nameset_add(&fx->fields, expr->as.set.property.start, expr->as.set.property.length);
+                effects_expr(lp, fx, expr->as.set.object);
+            }
+            effects_expr(lp, fx, expr->as.set.value);
+            break;
+        case EXPR_AWAIT:
+            fx->has_suspend = 1;
+            fx->has_call = 1;
+            break;
+        case EXPR_SUPER:
+        case EXPR_COMPTIME:
+            fx->has_call = 1;
+            break;
+        default:
+            break;
+    }
+}
+
+static void effects_bind(LoopEffects* fx, Token name) {
+    nameset_add(&fx->bound, name.start, name.length);
+}
+
+static void effects_stmts(const LoopPass* lp, LoopEffects* fx, const Stmt* stmt) {
+    for (; stmt != NULL; stmt = stmt->next) {
+        switch (stmt->type) {
+            case STMT_PRINT:
+                effects_expr(lp, fx, stmt->as.print.expression);
+                break;
+            case STMT_EXPRESSION:
+                effects_expr(lp, fx, stmt->as.expression);
+                break;
+            case STMT_LET:
+                effects_bind(fx, stmt->as.let.name);
+                effects_expr(lp, fx, stmt->as.let.initializer);
+                break;
+            case STMT_IF:
+                effects_expr(lp, fx, stmt->as.if_stmt.condition);
+                effects_stmts(lp, fx, stmt->as.if_stmt.then_branch);
+                effects_stmts(lp, fx, stmt->as.if_stmt.else_branch);
+                break;
+            case STMT_BLOCK:
+                effects_stmts(lp, fx, stmt->as.block.statements);
+                break;
+            case STMT_WHILE:
+                effects_expr(lp, fx, stmt->as.while_stmt.condition);
+                effects_stmts(lp, fx, stmt->as.while_stmt.body);
+                break;
+            case STMT_FOR:
+                effects_bind(fx, stmt->as.for_stmt.variable);
+                effects_expr(lp, fx, stmt->as.for_stmt.iterable);
+                effects_stmts(lp, fx, stmt->as.for_stmt.body);
+                break;
+            case STMT_RETURN:
+                effects_expr(lp, fx, stmt->as.ret.value);
+                break;
+            case STMT_MATCH:
+                effects_expr(lp, fx, stmt->as.match_stmt.value);
+                for (int i = 0; i < stmt->as.match_stmt.case_count; i++) {
+                    effects_expr(lp, fx, stmt->as.match_stmt.cases[i]->pattern);
+                    effects_expr(lp, fx, stmt->as.match_stmt.cases[i]->guard);
+                    effects_stmts(lp, fx, stmt->as.match_stmt.cases[i]->body);
+                }
+                effects_stmts(lp, fx, stmt->as.match_stmt.default_case);
+                break;
+            case STMT_TRY:
+                effects_stmts(lp, fx, stmt->as.try_stmt.try_block);
+                for (int i = 0; i < stmt->as.try_stmt.catch_count; i++) {
+                    effects_bind(fx, stmt->as.try_stmt.catches[i]->exception_var);
+                    effects_stmts(lp, fx, stmt->as.try_stmt.catches[i]->body);
+                }
+                effects_stmts(lp, fx, stmt->as.try_stmt.finally_block);
+                break;
+            case STMT_RAISE:
+                effects_expr(lp, fx, stmt->as.raise.exception);
+                break;
+            case STMT_PROC:
+            case STMT_ASYNC_PROC:
+                effects_bind(fx, stmt->as.proc.name);
+                break;
+            case STMT_CLASS:
+                effects_bind(fx, stmt->as.class_stmt.name);
+                break;
+            case STMT_YIELD:
+                fx->has_suspend = 1;
+                effects_expr(lp, fx, stmt->as.yield_stmt.value);
+                break;
+            case STMT_BREAK:
+            case STMT_CONTINUE:
+                break;
+            default:
+                // imports, defer, comptime, macros, type declarations
+                fx->has_call = 1;
+                break;
+        }
+    }
+}
+
+static void collect_rebound(LoopPass* lp, const Stmt* list);
+
+static void collect_definitions(LoopPass* lp, const Stmt* stmt) {
+    for (; stmt != NULL; stmt = stmt->next) {
+        switch (stmt->type) {
+            case STMT_PROC:
+            case STMT_ASYNC_PROC:
+                for (int i = 0; i < stmt->as.proc.param_count; i++) {
+                    nameset_add(&lp->rebound, stmt->as.proc.params[i].start, stmt->as.proc.params[i].length);
+                }
+                collect_rebound(lp, stmt->as.proc.body);
+                break;
+            case STMT_CLASS:
+                collect_definitions(lp, stmt->as.class_stmt.methods);
+                break;
+            case STMT_IF:
+                collect_definitions(lp, stmt->as.if_stmt.then_branch);
+                collect_definitions(lp, stmt->as.if_stmt.else_branch);
+                break;
+            case STMT_BLOCK:
+                collect_definitions(lp, stmt->as.block.statements);
+                break;
+            case STMT_WHILE:
+                collect_definitions(lp, stmt->as.while_stmt.body);
+                break;
+            case STMT_FOR:
+                collect_definitions(lp, stmt->as.for_stmt.body);
+                break;
+            case STMT_MATCH:
+                for (int i = 0; i < stmt->as.match_stmt.case_count; i++) {
+                    collect_definitions(lp, stmt->as.match_stmt.cases[i]->body);
+                }
+                collect_definitions(lp, stmt->as.match_stmt.default_case);
+                break;
+            case STMT_TRY:
+                collect_definitions(lp, stmt->as.try_stmt.try_block);
+                for (int i = 0; i < stmt->as.try_stmt.catch_count; i++) {
+                    collect_definitions(lp, stmt->as.try_stmt.catches[i]->body);
+                }
+                collect_definitions(lp, stmt->as.try_stmt.finally_block);
+                break;
+            case STMT_IMPORT: {
+                const ImportStmt* imp = &stmt->as.import;
+                if (imp->import_all) {
+                    const char* bind = imp->alias ? imp->alias : imp->module_name;
+                    nameset_add(&lp->rebound, bind, (int)strlen(bind));
+                } else if (imp->items == NULL) {
+                    lp->wildcard_import = 1;
+                } else {
+                    for (int i = 0; i < imp->item_count; i++) {
+                        const char* bind = (imp->item_aliases && imp->item_aliases[i]) ? imp->item_aliases[i] : imp->items[i];
+                        nameset_add(&lp->rebound, bind, (int)strlen(bind));
+                    }
+                }
+                break;
+            }
+            default:
+                break;
+        }
+    }
+}
+
+// Every name the program binds, for telling builtins from user definitions.
+static void collect_rebound(LoopPass* lp, const Stmt* list) {
+    LoopEffects fx;
+    memset(&fx, 0, sizeof(fx));
+    effects_stmts(lp, &fx, list);
+    for (NameSet* n = fx.bound; n != NULL; n = n->next) nameset_add(&lp->rebound, n->name, (int)strlen(n->name));
+    effects_free(&fx);
+    collect_definitions(lp, list);
+}
+
+// ============================================================================
+// Range canonicalization
+// ============================================================================
+
+static void canonicalize_range(LoopPass* lp, Stmt* stmt) {
+    Expr* iterable = stmt->as.for_stmt.iterable;
+    if (iterable == NULL || iterable->type != EXPR_CALL) return;
+    Expr* callee = iterable->as.call.callee;
+    if (callee->type != EXPR_VARIABLE || !token_is(callee->as.variable.name, "range")) return;
+    if (iterable->as.call.arg_count < 1 || iterable->as.call.arg_count > 3) return;
+    if (!is_builtin(lp, "range")) return;
+    stmt->as.for_stmt.counted = 1;
+}
+
+// ============================================================================
+// Invariant hoisting out of while conditions
+// ============================================================================
+
+static Token temp_name(LoopPass* lp, const char* prefix, Token like) {
+    char buf[32];
+    int len = snprintf(buf, sizeof(buf), "__%s%d", prefix, lp->next_temp++);
+    Token name = like;
+    name.type = TOKEN_IDENTIFIER;
+    name.start = ast_strndup(buf, (size_t)len);
+    name.length = len;
+    return name;
+}
+
+// `v` or `v.field` that the loop leaves alone
+static int invariant_read(const LoopEffects* fx, const Expr* expr) {
+    if (expr->type == EXPR_VARIABLE) return !nameset_has(fx->bound, expr->as.variable.name);
+    if (expr->type == EXPR_GET && expr->as.get.object != NULL) {
+        return !fx->has_index_set && !nameset_has(fx->fields, expr->as.get.property) &&
+               expr->as.get.object->type == EXPR_VARIABLE &&
+               !nameset_has(fx->bound, expr->as.get.object->as.variable.name);
+    }
+    return 0;
+}
+
+static int hoistable(const LoopPass* lp, const LoopEffects* fx, const Expr* expr) {
+    if (expr->type == EXPR_GET) return invariant_read(fx, expr);
+    if (expr->type == EXPR_CALL && expr->as.call.arg_count == 1 &&
+        expr->as.call.callee->type == EXPR_VARIABLE &&
+        token_is(expr->as.call.callee->as.variable.name, "len") && is_builtin(lp, "len")) {
+        return !fx->has_index_set && invariant_read(fx, expr->as.call.args[0]);
+    }
+    return 0;
+}
+
+// Replaces hoistable reads in the always-evaluated part of `*slot`, adding
+// their `let`s to `*pre`.
+static void hoist_from(LoopPass* lp, const LoopEffects* fx, Expr** slot, Stmt*** pre) {
+    Expr* expr = *slot;
+    if (expr == NULL) return;
+    if (hoistable(lp, fx, expr)) {
+        Token like = expr->type == EXPR_GET ? expr->as.get.property : expr->as.call.callee->as.variable.name;
+        Token name = temp_name(lp, "loop", like);
+        **pre = new_let_stmt(name, expr);
+        *pre = &(**pre)->next;
+        *slot = new_variable_expr(name);
+        return;
+    }
+    switch (expr->type) {
+        case EXPR_BINARY:
+            hoist_from(lp, fx, &expr->as.binary.left, pre);
+            // The right operand of and/or is not always evaluated
+            if (expr->as.binary.op.type != TOKEN_AND && expr->as.binary.op.type != TOKEN_OR) {
+                hoist_from(lp, fx, &expr->as.binary.right, pre);
+            }
+            break;
+        case EXPR_INDEX:
+            hoist_from(lp, fx, &expr->as.index.array, pre);
+            hoist_from(lp, fx, &expr->as.index.index, pre);
+            break;
+        case EXPR_CALL:
+            // Only len() gets here; its argument is read regardless
+            for (int i = 0; i < expr->as.call.arg_count; i++) hoist_from(lp, fx, &expr->as.call.args[i], pre);
+            break;
+        default:
+            break;
+    }
+}
+
+// Returns the statements to put in front of the while loop.
+static Stmt* hoist_while(LoopPass* lp, Stmt* stmt) {
+    LoopEffects fx;
+    memset(&fx, 0, sizeof(fx));
+    effects_expr(lp, &fx, stmt->as.while_stmt.condition);
+    effects_stmts(lp, &fx, stmt->as.while_stmt.body);
+    Stmt* pre = NULL;
+    Stmt** tail = &pre;
+    if (!fx.has_call && !fx.has_suspend) hoist_from(lp, &fx, &stmt->as.while_stmt.condition, &tail);
+    effects_free(&fx);
+    return pre;
+}
+
+// ============================================================================
+// Strength reduction in counted loops
+// ============================================================================
+
+static int int_literal(const Expr* expr, double* out) {
+    if (expr == NULL || expr->type != EXPR_NUMBER) return 0;
+    double v = expr->as.number.value;
+    if (v != floor(v) || fabs(v) > 2147483647.0) return 0;
+    *out = v;
+    return 1;
+}
+
+typedef struct Reduction {
+    double factor;
+    Token name;
+    struct Reduction* next;
+} Reduction;
+
+// `v * k` / `k * v` -> the variable tracking it
+static void reduce_expr(LoopPass* lp, Token var, Reduction** list, Expr** slot) {
+    Expr* expr = *slot;
+    if (expr == NULL) return;
+    switch (expr->type) {
+        case EXPR_BINARY: {
+            if (expr->as.binary.op.type == TOKEN_STAR && expr->as.binary.right != NULL) {
+                Expr* l = expr->as.binary.left;
+                Expr* r = expr->as.binary.right;
+                double k;
+                int matched = 0;
+                if (l->type == EXPR_VARIABLE && l->as.variable.name.length == var.length &&
+                    memcmp(l->as.variable.name.start, var.start, (size_t)var.length) == 0 && int_literal(r, &k)) {
+                    matched = 1;
+                } else if (r->type == EXPR_VARIABLE && r->as.variable.name.length == var.length &&
+                           memcmp(r->as.variable.name.start, var.start, (size_t)var.length) == 0 && int_literal(l, &k)) {
+                    matched = 1;
+                }
+                if (matched && fabs(k) < LOOP_SR_MAX_FACTOR && k != 0) {
+                    Reduction* red = *list;
+                    while (red != NULL && red->factor != k) red = red->next;
+                    if (red == NULL) {
+                        red = SAGE_ALLOC(sizeof(Reduction));
+                        red->factor = k;
+                        red->name = temp_name(lp, "sr", var);
+                        red->next = *list;
+                        *list = red;
+                    }
+                    *slot = new_variable_expr(red->name);
+                    return;
+                }
+            }
+            reduce_expr(lp, var, list, &expr->as.binary.left);
+            reduce_expr(lp, var, list, &expr->as.binary.right);
+            break;
+        }
+        case EXPR_CALL:
+            reduce_expr(lp, var, list, &expr->as.call.callee);
+            for (int i = 0; i < expr->as.call.arg_count; i++) reduce_expr(lp, var, list, &expr->as.call.args[i]);
+            break;
+        case EXPR_ARRAY:
+            for (int i = 0; i < expr->as.array.count; i++) reduce_expr(lp, var, list, &expr->as.array.elements[i]);
+            break;
+        case EXPR_DICT:
+            for (int i = 0; i < expr->as.dict.count; i++) reduce_expr(lp, var, list, &expr->as.dict.values[i]);
+            break;
+        case EXPR_TUPLE:
+            for (int i = 0; i < expr->as.tuple.count; i++) reduce_expr(lp, var, list, &expr->as.tuple.elements[i]);
+            break;
+        case EXPR_INDEX:
+            reduce_expr(lp, var, list, &expr->as.index.array);
+            reduce_expr(lp, var, list, &expr->as.index.index);
+            break;
+        case EXPR_INDEX_SET:
+            reduce_expr(lp, var, list, &expr->as.index_set.array);
+            reduce_expr(lp, var, list, &expr->as.index_set.index);
+            reduce_expr(lp, var, list, &expr->as.index_set.value);
+            break;
+        case EXPR_SLICE:
+            reduce_expr(lp, var, list, &expr->as.slice.array);
+            reduce_expr(lp, var, list, &expr->as.slice.start);
+            reduce_expr(lp, var, list, &expr->as.slice.end);
+            break;
+        case EXPR_GET:
+            reduce_expr(lp, var, list, &expr->as.get.object);
+            break;
+        case EXPR_SET:
+            reduce_expr(lp, var, list, &expr->as.set.object);
+            reduce_expr(lp, var, list, &expr->as.set.value);
+            break;
+        default:
+            break;
+    }
+}
+
+static void reduce_stmts(LoopPass* lp, Token var, Reduction** list, Stmt* stmt) {
+    for (; stmt != NULL; stmt = stmt->next) {
+        switch (stmt->type) {
+            case STMT_PRINT:
+                reduce_expr(lp, var, list, &stmt->as.print.expression);
+                break;
+            case STMT_EXPRESSION:
+                reduce_expr(lp, var, list, &stmt->as.expression);
+                break;
+            case STMT_LET:
+                reduce_expr(lp, var, list, &stmt->as.let.initializer);
+                break;
+            case STMT_IF:
+                reduce_expr(lp, var, list, &stmt->as.if_stmt.condition);
+                reduce_stmts(lp, var, list, stmt->as.if_stmt.then_branch);
+                reduce_stmts(lp, var, list, stmt->as.if_stmt.else_branch);
+                break;
+            case STMT_BLOCK:
+                reduce_stmts(lp, var, list, stmt->as.block.statements);
+                break;
+            case STMT_WHILE:
+                reduce_expr(lp, var, list, &stmt->as.while_stmt.condition);
+                reduce_stmts(lp, var, list, stmt->as.while_stmt.body);
+                break;
+            case STMT_FOR:
+                reduce_expr(lp, var, list, &stmt->as.for_stmt.iterable);
+                reduce_stmts(lp, var, list, stmt->as.for_stmt.body);
+                break;
+            case STMT_RETURN:
+                reduce_expr(lp, var, list, &stmt->as.ret.value);
+                break;
+            case STMT_RAISE:
+                reduce_expr(lp, var, list, &stmt->as.raise.exception);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+// Returns the statements to put in front of the loop.
+static Stmt* reduce_counted(LoopPass* lp, Stmt* stmt) {
+    Expr* range = stmt->as.for_stmt.iterable;
+    double start = 0, step = 1;
+    if (range->as.call.arg_count >= 2 && !int_literal(range->as.call.args[0], &start)) return NULL;
+    if (range->as.call.arg_count == 3 && (!int_literal(range->as.call.args[2], &step) || step == 0)) return NULL;
+
+    Token var = stmt->as.for_stmt.variable;
+    LoopEffects fx;
+    memset(&fx, 0, sizeof(fx));
+    effects_stmts(lp, &fx, stmt->as.for_stmt.body);
+    int rebinds = nameset_has(fx.bound, var);
+    effects_free(&fx);
+    if (rebinds) return NULL;
+
+    Reduction* list = NULL;
+    reduce_stmts(lp, var, &list, stmt->as.for_stmt.body);
+
+    Stmt* pre = NULL;
+    Stmt** body = &stmt->as.for_stmt.body;
+    if (*body != NULL && (*body)->type == STMT_BLOCK) body = &(*body)->as.block.statements;
+    while (list != NULL) {
+        Reduction* next = list->next;
+        // Starts one step early; the first iteration advances it to start * k
+        Stmt* init = new_let_stmt(list->name, new_number_expr((start - step) * list->factor));
+        init->next = pre;
+        pre = init;
+
+        Token plus = list->name;
+        plus.type = TOKEN_PLUS;
+        plus.start = "+";
+        plus.length = 1;
+        Expr* advanced = new_binary_expr(new_variable_expr(list->name), plus, new_number_expr(step * list->factor));
+        Stmt* update = new_expr_stmt(new_set_expr(NULL, list->name, advanced));
+        update->next = *body;
+        *body = update;
+        free(list);
+        list = next;
+    }
+    return pre;
+}
+
+// ============================================================================
+// Traversal
+// ============================================================================
+
+static void loop_block(LoopPass* lp, Stmt** head, int level, int in_proc);
+
+static void loop_children(LoopPass* lp, Stmt* stmt, int level, int in_proc) {
+    switch (stmt->type) {
+        case STMT_IF:
+            loop_block(lp, &stmt->as.if_stmt.then_branch, level, in_proc);
+            loop_block(lp, &stmt->as.if_stmt.else_branch, level, in_proc);
+            break;
+        case STMT_BLOCK:
+            loop_block(lp, &stmt->as.block.statements, level, in_proc);
+            break;
+        case STMT_WHILE:
+            loop_block(lp, &stmt->as.while_stmt.body, level, in_proc);
+            break;
+        case STMT_FOR:
+            loop_block(lp, &stmt->as.for_stmt.body, level, in_proc);
+            break;
+        case STMT_PROC:
+        case STMT_ASYNC_PROC:
+            loop_block(lp, &stmt->as.proc.body, level, 1);
+            break;
+        case STMT_CLASS:
+            for (Stmt* m = stmt->as.class_stmt.methods; m != NULL; m = m->next) {
+                if (m->type == STMT_PROC) loop_block(lp, &m->as.proc.body, level, 1);
+            }
+            break;
+        case STMT_MATCH:
+            for (int i = 0; i < stmt->as.match_stmt.case_count; i++) {
+                loop_block(lp, &stmt->as.match_stmt.cases[i]->body, level, in_proc);
+            }
+            loop_block(lp, &stmt->as.match_stmt.default_case, level, in_proc);
+            break;
+        case STMT_TRY:
+            loop_block(lp, &stmt->as.try_stmt.try_block, level, in_proc);
+            for (int i = 0; i < stmt->as.try_stmt.catch_count; i++) {
+                loop_block(lp, &stmt->as.try_stmt.catches[i]->body, level, in_proc);
+            }
+            loop_block(lp, &stmt->as.try_stmt.finally_block, level, in_proc);
+            break;
+        default:
+            break;
+    }
+}
+
+static void loop_block(LoopPass* lp, Stmt** head, int level, int in_proc) {
+    for (Stmt** link = head; *link != NULL; link = &(*link)->next) {
+        Stmt* stmt = *link;
+        // Inner loops first, so their hoisted code can be hoisted further out
+        loop_children(lp, stmt, level, in_proc);
+
+        Stmt* pre = NULL;
+        if (stmt->type == STMT_FOR) {
+            canonicalize_range(lp, stmt);
+            if (level >= 2 && in_proc && stmt->as.for_stmt.counted) pre = reduce_counted(lp, stmt);
+        } else if (stmt->type == STMT_WHILE && level >= 2) {
+            pre = hoist_while(lp, stmt);
+        }
+        if (pre != NULL) {
+            Stmt* last = pre;
+            while (last->next != NULL) last = last->next;
+            last->next = stmt;
+            *link = pre;
+            link = &last->next;
+        }
+    }
+}
+
+// ============================================================================
+// Pass Entry Point
+// ============================================================================
+
+Stmt* pass_loop(Stmt* program, PassContext* ctx) {
+    LoopPass lp;
+    memset(&lp, 0, sizeof(lp));
+    collect_rebound(&lp, program);
+    loop_block(&lp, &program, ctx->opt_level, 0);
+    if (ctx->verbose && lp.next_temp > 0) {
+        fprintf(stderr, "[loop] %d loop temporaries introduced\n", lp.next_temp);
+    }
+    nameset_free(lp.rebound);
+    return program;
+}
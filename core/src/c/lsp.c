@@ -1,23 +1,43 @@
 /*
  * SageLang LSP Server
  *
- * A basic Language Server Protocol implementation for Sage.
+ * A Language Server Protocol implementation for Sage.
  * Communicates over stdin/stdout using LSP JSON-RPC wire protocol.
  * Debug/log output goes to stderr only.
  *
  * Supported features:
- *   - textDocument/didOpen, didChange, didClose
- *   - textDocument/publishDiagnostics (via linter)
- *   - textDocument/completion (keywords + builtins)
- *   - textDocument/hover (keyword/builtin docs)
+ *   - textDocument/didOpen, didChange (incremental), didClose
+ *   - textDocument/publishDiagnostics (syntax errors + linter, debounced)
+ *   - textDocument/completion (keywords, builtins, workspace symbols)
+ *   - textDocument/hover (keyword/builtin docs, symbol signatures)
+ *   - textDocument/definition, textDocument/documentSymbol
+ *   - workspace/symbol
  *   - textDocument/formatting (via formatter)
+ *   - sage/metrics (diagnostics latency and reparse counters)
  *   - initialize / initialized / shutdown / exit
+ *
+ * Document model: every open document keeps its text with a line table, so
+ * range edits are spliced in place. The text is cut into top-level statement
+ * chunks; each chunk caches its own copy of the text, a token signature, its
+ * AST and the symbols it declares. After an edit only chunks whose text
+ * changed are re-lexed, and only those whose token signature changed are
+ * re-parsed. The symbols of all open chunks plus those of the workspace files
+ * (indexed once at startup) form the workspace symbol index.
+ *
+ * Diagnostics are published by a background thread once a document has been
+ * quiet for SAGE_LSP_DEBOUNCE_MS (default 150 ms; 0 publishes synchronously
+ * after every change).
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include <dirent.h>
+#include <sys/stat.h>
 
 #include "lsp.h"
 #include "diagnostic.h"
@@ -26,7 +46,10 @@
 #include "gc.h"
 #include "env.h"
 #include "ast.h"
+#include "lexer.h"
+#include "parser.h"
 #include "value.h"
+#include "sage_thread.h"
 
 extern Environment* g_global_env;
 
@@ -44,203 +67,342 @@ static void lsp_log(const char* fmt, ...) {
     va_end(ap);
 }
 
+static double lsp_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1.0e6;
+}
+
 /* ========================================================================
- * Minimal JSON helpers (no external dependency)
+ * Minimal JSON reader (no external dependency)
+ *
+ * Each message is parsed once into a small tree; handlers then look fields
+ * up by dotted path instead of rescanning the raw text for every key.
  * ======================================================================== */
 
-/*
- * json_get_string: extract the string value for "key" from a JSON blob.
- * Returns a malloc'd string or NULL.  Handles escaped \" within values and
- * JSON escape sequences (\n, \t, \\, \/).
- */
-static char* json_get_string(const char* json, const char* key) {
-    if (!json || !key) return NULL;
+typedef enum {
+    JSON_NULL,
+    JSON_BOOL,
+    JSON_NUMBER,
+    JSON_STRING,
+    JSON_ARRAY,
+    JSON_OBJECT
+} JsonType;
+
+typedef struct JsonNode {
+    JsonType type;
+    char* key;               /* Member name when inside an object */
+    char* string;            /* String value, or the literal text of a number */
+    double number;
+    int boolean;
+    struct JsonNode* child;  /* First element / member */
+    struct JsonNode* next;
+} JsonNode;
+
+#define JSON_MAX_DEPTH 64
 
-    /* Build search pattern: "key" */
-    size_t klen = strlen(key);
-    char* pattern = SAGE_ALLOC(klen + 4);
-    snprintf(pattern, klen + 4, "\"%s\"", key);
+typedef struct {
+    const char* p;
+    int depth;
+    int failed;
+} JsonReader;
+
+static void json_free(JsonNode* node) {
+    while (node) {
+        JsonNode* next = node->next;
+        json_free(node->child);
+        free(node->key);
+        free(node->string);
+        free(node);
+        node = next;
+    }
+}
 
-    const char* p = strstr(json, pattern);
-    free(pattern);
-    if (!p) return NULL;
+static void json_skip_ws(JsonReader* r) {
+    while (*r->p == ' ' || *r->p == '\t' || *r->p == '\n' || *r->p == '\r') r->p++;
+}
 
-    /* Advance past "key" */
-    p += klen + 2;
+static int json_hex4(const char* p, unsigned* out) {
+    unsigned v = 0;
+    for (int i = 0; i < 4; i++) {
+        char c = p[i];
+        v <<= 4;
+        if (c >= '0' && c <= '9') v |= (unsigned)(c - '0');
+        else if (c >= 'a' && c <= 'f') v |= (unsigned)(c - 'a' + 10);
+        else if (c >= 'A' && c <= 'F') v |= (unsigned)(c - 'A' + 10);
+        else return 0;
+    }
+    *out = v;
+    return 1;
+}
 
-    /* Skip whitespace and colon */
-    while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r' || *p == ':') p++;
+static size_t json_put_utf8(char* out, unsigned cp) {
+    if (cp < 0x80) {
+        out[0] = (char)cp;
+        return 1;
+    }
+    if (cp < 0x800) {
+        out[0] = (char)(0xC0 | (cp >> 6));
+        out[1] = (char)(0x80 | (cp & 0x3F));
+        return 2;
+    }
+    if (cp < 0x10000) {
+        out[0] = (char)(0xE0 | (cp >> 12));
+        out[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        out[2] = (char)(0x80 | (cp & 0x3F));
+        return 3;
+    }
+    out[0] = (char)(0xF0 | (cp >> 18));
+    out[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+    out[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+    out[3] = (char)(0x80 | (cp & 0x3F));
+    return 4;
+}
 
-    if (*p != '"') return NULL;
-    p++;  /* skip opening quote */
+/* Decode a string literal at r->p (which points at the opening quote). */
+static char* json_read_string(JsonReader* r) {
+    const char* p = r->p + 1;
+    const char* end = p;
+    while (*end && *end != '"') {
+        if (*end == '\\' && end[1]) end++;
+        end++;
+    }
+    if (*end != '"') {
+        r->failed = 1;
+        return NULL;
+    }
 
-    /* Collect characters, handling escapes */
-    size_t cap = 256;
+    /* Decoding never grows the text, so the raw length is enough. */
+    char* out = SAGE_ALLOC((size_t)(end - p) + 1);
     size_t len = 0;
-    char* result = SAGE_ALLOC(cap);
-
-    while (*p && *p != '"') {
-        if (*p == '\\' && *(p+1)) {
-            p++;  /* skip backslash */
-            switch (*p) {
-                case '"':  result[len++] = '"'; break;
-                case '\\': result[len++] = '\\'; break;
-                case '/':  result[len++] = '/'; break;
-                case 'n':  result[len++] = '\n'; break;
-                case 't':  result[len++] = '\t'; break;
-                case 'r':  result[len++] = '\r'; break;
-                default:   result[len++] = *p; break;
-            }
-        } else {
-            result[len++] = *p;
+    while (p < end) {
+        if (*p != '\\') {
+            out[len++] = *p++;
+            continue;
         }
         p++;
-        if (len + 2 >= cap) {
-            cap *= 2;
-            result = SAGE_REALLOC(result, cap);
+        switch (*p) {
+            case '"':  out[len++] = '"'; break;
+            case '\\': out[len++] = '\\'; break;
+            case '/':  out[len++] = '/'; break;
+            case 'b':  out[len++] = '\b'; break;
+            case 'f':  out[len++] = '\f'; break;
+            case 'n':  out[len++] = '\n'; break;
+            case 'r':  out[len++] = '\r'; break;
+            case 't':  out[len++] = '\t'; break;
+            case 'u': {
+                unsigned cp;
+                if (!json_hex4(p + 1, &cp)) {
+                    out[len++] = 'u';
+                    break;
+                }
+                p += 4;
+                if (cp >= 0xD800 && cp <= 0xDBFF && p[1] == '\\' && p[2] == 'u') {
+                    unsigned lo;
+                    if (json_hex4(p + 3, &lo) && lo >= 0xDC00 && lo <= 0xDFFF) {
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                        p += 6;
+                    }
+                }
+                len += json_put_utf8(out + len, cp);
+                break;
+            }
+            default:   out[len++] = *p; break;
         }
+        p++;
     }
-
-    result[len] = '\0';
-    return result;
+    out[len] = '\0';
+    r->p = end + 1;
+    return out;
 }
 
-/*
- * json_get_int: extract an integer value for "key".
- * Returns the value, or default_val if not found.
- */
-static int json_get_int(const char* json, const char* key, int default_val) {
-    if (!json || !key) return default_val;
-
-    size_t klen = strlen(key);
-    char* pattern = SAGE_ALLOC(klen + 4);
-    snprintf(pattern, klen + 4, "\"%s\"", key);
-
-    const char* p = strstr(json, pattern);
-    free(pattern);
-    if (!p) return default_val;
+static JsonNode* json_read_value(JsonReader* r) {
+    json_skip_ws(r);
+    if (r->failed || ++r->depth > JSON_MAX_DEPTH) {
+        r->failed = 1;
+        return NULL;
+    }
 
-    p += klen + 2;
-    while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r' || *p == ':') p++;
+    JsonNode* node = SAGE_ALLOC(sizeof(JsonNode));
+    char c = *r->p;
+
+    if (c == '{' || c == '[') {
+        int is_object = (c == '{');
+        char close = is_object ? '}' : ']';
+        node->type = is_object ? JSON_OBJECT : JSON_ARRAY;
+        r->p++;
+        JsonNode** link = &node->child;
+        json_skip_ws(r);
+        if (*r->p == close) {
+            r->p++;
+        } else {
+            for (;;) {
+                char* key = NULL;
+                if (is_object) {
+                    json_skip_ws(r);
+                    if (*r->p != '"') { r->failed = 1; break; }
+                    key = json_read_string(r);
+                    json_skip_ws(r);
+                    if (r->failed || *r->p != ':') { free(key); r->failed = 1; break; }
+                    r->p++;
+                }
+                JsonNode* item = json_read_value(r);
+                if (!item) { free(key); break; }
+                item->key = key;
+                *link = item;
+                link = &item->next;
+                json_skip_ws(r);
+                if (*r->p == ',') { r->p++; continue; }
+                if (*r->p == close) { r->p++; break; }
+                r->failed = 1;
+                break;
+            }
+        }
+    } else if (c == '"') {
+        node->type = JSON_STRING;
+        node->string = json_read_string(r);
+    } else if (c == '-' || (c >= '0' && c <= '9')) {
+        const char* start = r->p;
+        char* end;
+        node->type = JSON_NUMBER;
+        node->number = strtod(start, &end);
+        r->p = end;
+        node->string = SAGE_ALLOC((size_t)(end - start) + 1);
+        memcpy(node->string, start, (size_t)(end - start));
+    } else if (strncmp(r->p, "true", 4) == 0) {
+        node->type = JSON_BOOL;
+        node->boolean = 1;
+        r->p += 4;
+    } else if (strncmp(r->p, "false", 5) == 0) {
+        node->type = JSON_BOOL;
+        r->p += 5;
+    } else if (strncmp(r->p, "null", 4) == 0) {
+        node->type = JSON_NULL;
+        r->p += 4;
+    } else {
+        r->failed = 1;
+    }
 
-    return atoi(p);
+    r->depth--;
+    if (r->failed) {
+        json_free(node);
+        return NULL;
+    }
+    return node;
 }
 
-/*
- * json_get_object: extract a nested object {...} for "key".
- * Returns malloc'd string with balanced braces, or NULL.
- */
-static char* json_get_object(const char* json, const char* key) {
-    if (!json || !key) return NULL;
-
-    size_t klen = strlen(key);
-    char* pattern = SAGE_ALLOC(klen + 4);
-    snprintf(pattern, klen + 4, "\"%s\"", key);
-
-    const char* p = strstr(json, pattern);
-    free(pattern);
-    if (!p) return NULL;
-
-    p += klen + 2;
-    while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r' || *p == ':') p++;
-
-    if (*p != '{') return NULL;
-
-    int depth = 0;
-    const char* start = p;
-    int in_string = 0;
+static JsonNode* json_parse(const char* text) {
+    JsonReader r = { text, 0, 0 };
+    return json_read_value(&r);
+}
 
-    while (*p) {
-        if (*p == '\\' && in_string) {
-            p++;  /* skip escaped char */
-        } else if (*p == '"') {
-            in_string = !in_string;
-        } else if (!in_string) {
-            if (*p == '{') depth++;
-            else if (*p == '}') {
-                depth--;
-                if (depth == 0) {
-                    p++;
-                    size_t len = (size_t)(p - start);
-                    char* result = SAGE_ALLOC(len + 1);
-                    memcpy(result, start, len);
-                    result[len] = '\0';
-                    return result;
+/* Look up a member by dotted path, e.g. "params.textDocument.uri". */
+static const JsonNode* json_get(const JsonNode* node, const char* path) {
+    while (node && *path) {
+        const char* dot = strchr(path, '.');
+        size_t klen = dot ? (size_t)(dot - path) : strlen(path);
+        const JsonNode* found = NULL;
+        if (node->type == JSON_OBJECT) {
+            for (const JsonNode* m = node->child; m; m = m->next) {
+                if (strncmp(m->key, path, klen) == 0 && m->key[klen] == '\0') {
+                    found = m;
+                    break;
                 }
             }
         }
-        p++;
+        node = found;
+        path = dot ? dot + 1 : path + klen;
     }
-
-    return NULL;
+    return node;
 }
 
-/*
- * json_get_bool: extract a boolean for "key". Returns default_val if not found.
- */
-__attribute__((unused))
-static int json_get_bool(const char* json, const char* key, int default_val) {
-    if (!json || !key) return default_val;
-
-    size_t klen = strlen(key);
-    char* pattern = SAGE_ALLOC(klen + 4);
-    snprintf(pattern, klen + 4, "\"%s\"", key);
-
-    const char* p = strstr(json, pattern);
-    free(pattern);
-    if (!p) return default_val;
-
-    p += klen + 2;
-    while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r' || *p == ':') p++;
+static const char* json_get_string(const JsonNode* node, const char* path) {
+    const JsonNode* v = json_get(node, path);
+    return (v && v->type == JSON_STRING) ? v->string : NULL;
+}
 
-    if (strncmp(p, "true", 4) == 0) return 1;
-    if (strncmp(p, "false", 5) == 0) return 0;
-    return default_val;
+static int json_get_int(const JsonNode* node, const char* path, int default_val) {
+    const JsonNode* v = json_get(node, path);
+    return (v && v->type == JSON_NUMBER) ? (int)v->number : default_val;
 }
 
 /* ========================================================================
- * JSON string escaping
+ * JSON output buffer
  * ======================================================================== */
 
-static char* json_escape(const char* raw) {
-    if (!raw) {
-        char* empty = SAGE_ALLOC(1);
-        empty[0] = '\0';
-        return empty;
-    }
+typedef struct {
+    char* data;
+    size_t len;
+    size_t cap;
+} JsonBuf;
+
+static void jb_reserve(JsonBuf* b, size_t extra) {
+    if (b->len + extra + 1 <= b->cap) return;
+    size_t cap = b->cap ? b->cap : 256;
+    while (b->len + extra + 1 > cap) cap *= 2;
+    b->data = SAGE_REALLOC(b->data, cap);
+    b->cap = cap;
+}
 
-    size_t cap = strlen(raw) * 2 + 1;
-    char* out = SAGE_ALLOC(cap);
-    size_t j = 0;
+static void jb_append(JsonBuf* b, const char* s) {
+    size_t n = strlen(s);
+    jb_reserve(b, n);
+    memcpy(b->data + b->len, s, n);
+    b->len += n;
+    b->data[b->len] = '\0';
+}
 
-    for (size_t i = 0; raw[i]; i++) {
-        if (j + 8 >= cap) {
-            cap *= 2;
-            out = SAGE_REALLOC(out, cap);
+static void jb_printf(JsonBuf* b, const char* fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(NULL, 0, fmt, ap);
+    va_end(ap);
+    if (n <= 0) return;
+    jb_reserve(b, (size_t)n);
+    va_start(ap, fmt);
+    vsnprintf(b->data + b->len, (size_t)n + 1, fmt, ap);
+    va_end(ap);
+    b->len += (size_t)n;
+}
+
+/* Append raw text as a quoted, escaped JSON string. */
+static void jb_string(JsonBuf* b, const char* raw) {
+    if (!raw) raw = "";
+    jb_reserve(b, strlen(raw) + 2);
+    b->data[b->len++] = '"';
+    for (const char* p = raw; *p; p++) {
+        char esc = 0;
+        switch (*p) {
+            case '"':  esc = '"'; break;
+            case '\\': esc = '\\'; break;
+            case '\n': esc = 'n'; break;
+            case '\r': esc = 'r'; break;
+            case '\t': esc = 't'; break;
+            default: break;
         }
-        switch (raw[i]) {
-            case '"':  out[j++] = '\\'; out[j++] = '"'; break;
-            case '\\': out[j++] = '\\'; out[j++] = '\\'; break;
-            case '\n': out[j++] = '\\'; out[j++] = 'n'; break;
-            case '\r': out[j++] = '\\'; out[j++] = 'r'; break;
-            case '\t': out[j++] = '\\'; out[j++] = 't'; break;
-            default:
-                if ((unsigned char)raw[i] < 0x20) {
-                    j += (size_t)snprintf(out + j, cap - j, "\\u%04x", (unsigned char)raw[i]);
-                } else {
-                    out[j++] = raw[i];
-                }
-                break;
+        if (esc) {
+            jb_reserve(b, 2);
+            b->data[b->len++] = '\\';
+            b->data[b->len++] = esc;
+        } else if ((unsigned char)*p < 0x20) {
+            jb_printf(b, "\\u%04x", (unsigned char)*p);
+        } else {
+            jb_reserve(b, 1);
+            b->data[b->len++] = *p;
         }
     }
-    out[j] = '\0';
-    return out;
+    jb_reserve(b, 1);
+    b->data[b->len++] = '"';
+    b->data[b->len] = '\0';
 }
 
 /* ========================================================================
  * LSP Wire Protocol I/O
  * ======================================================================== */
 
+/* stdout is shared with the diagnostics thread. */
+static sage_mutex_t g_out_lock = SAGE_MUTEX_INITIALIZER;
+
 /* Read a full LSP message from stdin. Returns malloc'd JSON body or NULL on EOF. */
 static char* lsp_read_message(void) {
     /* Read headers */
@@ -286,38 +448,407 @@ static char* lsp_read_message(void) {
 /* Send a JSON-RPC response/notification over stdout with Content-Length header. */
 static void lsp_send(const char* json) {
     size_t len = strlen(json);
+    sage_mutex_lock(&g_out_lock);
     fprintf(stdout, "Content-Length: %zu\r\n\r\n%s", len, json);
     fflush(stdout);
+    sage_mutex_unlock(&g_out_lock);
 }
 
-/* Send a JSON-RPC response with a given id and result body. */
-static void lsp_send_response(const char* id_str, int id_is_string, const char* result_json) {
-    size_t cap = strlen(result_json) + 256;
-    char* msg = SAGE_ALLOC(cap);
-
-    if (id_is_string) {
-        snprintf(msg, cap,
-            "{\"jsonrpc\":\"2.0\",\"id\":\"%s\",\"result\":%s}",
-            id_str, result_json);
+typedef struct {
+    char str[128];
+    int is_string;
+} RequestId;
+
+static RequestId extract_id(const JsonNode* msg) {
+    RequestId rid;
+    rid.str[0] = '\0';
+    rid.is_string = 0;
+
+    const JsonNode* id = json_get(msg, "id");
+    if (id && (id->type == JSON_STRING || id->type == JSON_NUMBER)) {
+        rid.is_string = (id->type == JSON_STRING);
+        snprintf(rid.str, sizeof(rid.str), "%s", id->string);
+    }
+    return rid;
+}
+
+static void jb_request_id(JsonBuf* b, RequestId rid) {
+    if (rid.is_string) {
+        jb_string(b, rid.str);
     } else {
-        snprintf(msg, cap,
-            "{\"jsonrpc\":\"2.0\",\"id\":%s,\"result\":%s}",
-            id_str, result_json);
+        jb_append(b, rid.str[0] ? rid.str : "null");
     }
+}
 
-    lsp_send(msg);
-    free(msg);
+/* Send a JSON-RPC response with a given id and result body. */
+static void lsp_send_response(RequestId rid, const char* result_json) {
+    JsonBuf msg = {0};
+    jb_append(&msg, "{\"jsonrpc\":\"2.0\",\"id\":");
+    jb_request_id(&msg, rid);
+    jb_append(&msg, ",\"result\":");
+    jb_append(&msg, result_json);
+    jb_append(&msg, "}");
+    lsp_send(msg.data);
+    free(msg.data);
 }
 
 /* Send a JSON-RPC notification (no id). */
 static void lsp_send_notification(const char* method, const char* params_json) {
-    size_t cap = strlen(method) + strlen(params_json) + 128;
-    char* msg = SAGE_ALLOC(cap);
-    snprintf(msg, cap,
-        "{\"jsonrpc\":\"2.0\",\"method\":\"%s\",\"params\":%s}",
-        method, params_json);
-    lsp_send(msg);
-    free(msg);
+    JsonBuf msg = {0};
+    jb_append(&msg, "{\"jsonrpc\":\"2.0\",\"method\":");
+    jb_string(&msg, method);
+    jb_append(&msg, ",\"params\":");
+    jb_append(&msg, params_json);
+    jb_append(&msg, "}");
+    lsp_send(msg.data);
+    free(msg.data);
+}
+
+/* ========================================================================
+ * URIs
+ * ======================================================================== */
+
+/* file:// URI -> malloc'd filesystem path, or NULL for other schemes. */
+static char* uri_to_path(const char* uri) {
+    if (!uri || strncmp(uri, "file://", 7) != 0) return NULL;
+    const char* p = uri + 7;
+    char* out = SAGE_ALLOC(strlen(p) + 1);
+    size_t len = 0;
+    while (*p) {
+        unsigned v;
+        char hex[5] = { '0', '0', 0, 0, 0 };
+        if (*p == '%' && p[1] && p[2]) {
+            hex[2] = p[1];
+            hex[3] = p[2];
+            if (json_hex4(hex, &v)) {
+                out[len++] = (char)v;
+                p += 3;
+                continue;
+            }
+        }
+        out[len++] = *p++;
+    }
+    out[len] = '\0';
+    return out;
+}
+
+static char* path_to_uri(const char* path) {
+    JsonBuf b = {0};
+    jb_append(&b, "file://");
+    for (const unsigned char* p = (const unsigned char*)path; *p; p++) {
+        if ((*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z') ||
+            (*p >= '0' && *p <= '9') || strchr("/-_.~", *p)) {
+            jb_reserve(&b, 1);
+            b.data[b.len++] = (char)*p;
+            b.data[b.len] = '\0';
+        } else {
+            jb_printf(&b, "%%%02X", *p);
+        }
+    }
+    return b.data;
+}
+
+/* ========================================================================
+ * Symbols
+ * ======================================================================== */
+
+/* LSP SymbolKind values */
+#define SYM_CLASS      5
+#define SYM_METHOD     6
+#define SYM_ENUM       10
+#define SYM_INTERFACE  11
+#define SYM_FUNCTION   12
+#define SYM_VARIABLE   13
+#define SYM_STRUCT     23
+
+typedef struct {
+    char* name;
+    char* detail;      /* Signature line, e.g. "proc area(w, h)" */
+    char* doc;         /* ## doc comment, or NULL */
+    char* container;   /* Enclosing class/trait, or NULL */
+    int kind;
+    int line;          /* 0-based, relative to the owning chunk */
+    int column;
+} Symbol;
+
+static void symbols_free(Symbol* syms, int count) {
+    for (int i = 0; i < count; i++) {
+        free(syms[i].name);
+        free(syms[i].detail);
+        free(syms[i].doc);
+        free(syms[i].container);
+    }
+    free(syms);
+}
+
+static char* token_text(Token tok) {
+    char* s = SAGE_ALLOC((size_t)tok.length + 1);
+    memcpy(s, tok.start, (size_t)tok.length);
+    return s;
+}
+
+typedef struct {
+    Symbol* items;
+    int count;
+    int cap;
+} SymbolList;
+
+static Symbol* symbol_add(SymbolList* list, int kind, Token name, const char* container) {
+    if (list->count >= list->cap) {
+        list->cap = list->cap ? list->cap * 2 : 4;
+        list->items = SAGE_REALLOC(list->items, sizeof(Symbol) * (size_t)list->cap);
+    }
+    Symbol* sym = &list->items[list->count++];
+    memset(sym, 0, sizeof(*sym));
+    sym->name = token_text(name);
+    sym->container = container ? strdup(container) : NULL;
+    sym->kind = kind;
+    sym->line = name.line > 0 ? name.line - 1 : 0;
+    sym->column = name.column;
+    return sym;
+}
+
+static char* proc_signature(const char* keyword, const ProcStmt* proc) {
+    JsonBuf b = {0};
+    jb_printf(&b, "%s %.*s(", keyword, proc->name.length, proc->name.start);
+    for (int i = 0; i < proc->param_count; i++) {
+        jb_printf(&b, "%s%.*s", i ? ", " : "", proc->params[i].length, proc->params[i].start);
+    }
+    jb_append(&b, ")");
+    return b.data;
+}
+
+static void collect_proc(SymbolList* list, const Stmt* stmt, const char* container) {
+    const ProcStmt* proc = stmt->type == STMT_ASYNC_PROC ? &stmt->as.async_proc : &stmt->as.proc;
+    const char* keyword = stmt->type == STMT_ASYNC_PROC ? "async proc" : "proc";
+    Symbol* sym = symbol_add(list, container ? SYM_METHOD : SYM_FUNCTION, proc->name, container);
+    sym->detail = proc_signature(keyword, proc);
+    sym->doc = proc->doc ? strdup(proc->doc) : NULL;
+}
+
+/* Declarations made by the top-level statements of one chunk. */
+static void collect_symbols(const Stmt* stmts, SymbolList* list) {
+    for (const Stmt* s = stmts; s; s = s->next) {
+        switch (s->type) {
+            case STMT_PROC:
+            case STMT_ASYNC_PROC:
+                collect_proc(list, s, NULL);
+                break;
+            case STMT_LET: {
+                Symbol* sym = symbol_add(list, SYM_VARIABLE, s->as.let.name, NULL);
+                JsonBuf b = {0};
+                jb_printf(&b, "let %s", sym->name);
+                sym->detail = b.data;
+                break;
+            }
+            case STMT_CLASS: {
+                Symbol* sym = symbol_add(list, SYM_CLASS, s->as.class_stmt.name, NULL);
+                JsonBuf b = {0};
+                jb_printf(&b, "class %s", sym->name);
+                if (s->as.class_stmt.has_parent) {
+                    jb_printf(&b, "(%.*s)", s->as.class_stmt.parent.length,
+                              s->as.class_stmt.parent.start);
+                }
+                sym->detail = b.data;
+                char* owner = strdup(sym->name);
+                for (const Stmt* m = s->as.class_stmt.methods; m; m = m->next) {
+                    if (m->type == STMT_PROC || m->type == STMT_ASYNC_PROC) {
+                        collect_proc(list, m, owner);
+                    }
+                }
+                free(owner);
+                break;
+            }
+            case STMT_STRUCT:
+            case STMT_ENUM:
+            case STMT_TRAIT: {
+                const char* keyword = s->type == STMT_STRUCT ? "struct" :
+                                      s->type == STMT_ENUM ? "enum" : "trait";
+                int kind = s->type == STMT_STRUCT ? SYM_STRUCT :
+                           s->type == STMT_ENUM ? SYM_ENUM : SYM_INTERFACE;
+                Token name = s->type == STMT_STRUCT ? s->as.struct_stmt.name :
+                             s->type == STMT_ENUM ? s->as.enum_stmt.name : s->as.trait_stmt.name;
+                Symbol* sym = symbol_add(list, kind, name, NULL);
+                JsonBuf b = {0};
+                jb_printf(&b, "%s %s", keyword, sym->name);
+                sym->detail = b.data;
+                break;
+            }
+            default:
+                break;
+        }
+    }
+}
+
+/* ========================================================================
+ * Statement chunks
+ *
+ * A chunk is one top-level statement plus the comments directly above it
+ * and the blank lines after it. Chunks parse independently, so an edit only
+ * costs re-lexing and re-parsing the statements whose text changed.
+ * ======================================================================== */
+
+typedef struct {
+    int start_line;       /* First document line (0-based) */
+    int line_count;
+    uint32_t text_hash;   /* Hash of the chunk's current document text */
+    size_t text_length;
+    char* source;         /* Text the AST was parsed from; its tokens point here */
+    uint32_t token_hash;  /* Token signature of `source` (layout-sensitive) */
+    Stmt* ast;            /* NULL when the chunk has a syntax error */
+    int failed;
+    int error_line;       /* 0-based, relative to start_line */
+    int error_column;
+    char* error_message;
+    Symbol* symbols;
+    int symbol_count;
+} DocChunk;
+
+typedef struct {
+    int start_line;
+    int line_count;
+} ChunkSpan;
+
+static uint32_t hash_bytes(uint32_t hash, const char* data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char)data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+#define HASH_SEED 2166136261u
+
+static void chunk_release(DocChunk* chunk) {
+    free_stmt(chunk->ast);
+    free(chunk->source);
+    free(chunk->error_message);
+    symbols_free(chunk->symbols, chunk->symbol_count);
+    memset(chunk, 0, sizeof(*chunk));
+}
+
+/* Token signature: kinds, lexemes and positions, but not comments or trailing
+ * whitespace. Edits that leave it unchanged cannot change the parse. Returns
+ * 0 when the chunk does not even lex, which forces a parse. */
+static uint32_t chunk_token_hash(const char* source) {
+    LexerState lexer;
+    lexer_init(&lexer, source, NULL);
+    uint32_t hash = HASH_SEED;
+    for (;;) {
+        Token tok = lexer_scan(&lexer);
+        if (tok.type == TOKEN_ERROR) return 0;
+        if (tok.type == TOKEN_EOF) break;  /* Its position moves with trailing comments */
+        int header[4] = { (int)tok.type, tok.length, tok.line, tok.column };
+        hash = hash_bytes(hash, (const char*)header, sizeof(header));
+        hash = hash_bytes(hash, tok.start, (size_t)tok.length);
+    }
+    return hash ? hash : 1;
+}
+
+static void chunk_parse(DocChunk* chunk, const char* filename) {
+    Parser parser;
+    parser_open(&parser, chunk->source, filename, true);
+    chunk->ast = parser_parse_all(&parser, NULL);
+    if (parser.failed) {
+        /* The statement that failed is already freed; drop the ones before it. */
+        free_stmt(chunk->ast);
+        chunk->ast = NULL;
+        chunk->failed = 1;
+        chunk->error_line = parser.error_line > 0 ? parser.error_line - 1 : 0;
+        chunk->error_column = parser.error_column;
+        chunk->error_message = strdup(parser.error_message);
+        return;
+    }
+
+    SymbolList list = {0};
+    collect_symbols(chunk->ast, &list);
+    chunk->symbols = list.items;
+    chunk->symbol_count = list.count;
+}
+
+static int line_is_top_level_start(const char* p, const char* end) {
+    if (p >= end) return 0;
+    char c = *p;
+    if (c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '#') return 0;
+
+    /* Clauses that continue the previous statement. */
+    static const char* const continuations[] = {
+        "else", "elif", "catch", "finally", "case", "default", NULL
+    };
+    for (int i = 0; continuations[i]; i++) {
+        size_t n = strlen(continuations[i]);
+        if ((size_t)(end - p) >= n && strncmp(p, continuations[i], n) == 0) {
+            char after = (size_t)(end - p) > n ? p[n] : '\n';
+            if (!(after == '_' || (after >= 'a' && after <= 'z') ||
+                  (after >= 'A' && after <= 'Z') || (after >= '0' && after <= '9'))) {
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+/* Split `text` (with `line_count` lines starting at `line_starts`) into
+ * chunk spans. The scan tracks brackets and multi-line strings so a
+ * column-0 line inside either does not start a statement. */
+static int split_chunks(const char* text, size_t length, const int* line_starts,
+                        int line_count, ChunkSpan** out) {
+    int cap = 16;
+    int count = 0;
+    ChunkSpan* spans = SAGE_ALLOC(sizeof(ChunkSpan) * (size_t)cap);
+    int depth = 0;
+    int in_string = 0;
+    int after_decorator = 0;
+    int current_start = 0;
+
+    for (int line = 0; line < line_count; line++) {
+        const char* p = text + line_starts[line];
+        const char* end = line + 1 < line_count ? text + line_starts[line + 1] : text + length;
+
+        if (!in_string && depth == 0 && line > 0 && line_is_top_level_start(p, end)) {
+            if (after_decorator) {
+                after_decorator = 0;
+            } else {
+                /* Comments directly above belong to this statement. */
+                int start = line;
+                while (start - 1 > current_start && text[line_starts[start - 1]] == '#') start--;
+                if (count == cap) {
+                    cap *= 2;
+                    spans = SAGE_REALLOC(spans, sizeof(ChunkSpan) * (size_t)cap);
+                }
+                spans[count].start_line = current_start;
+                spans[count].line_count = start - current_start;
+                count++;
+                current_start = start;
+            }
+            after_decorator = (*p == '@');
+        } else if (!in_string && depth == 0 && line == 0 && *p == '@') {
+            after_decorator = 1;
+        }
+
+        for (const char* c = p; c < end; c++) {
+            if (in_string) {
+                if (*c == '\\' && c + 1 < end) c++;
+                else if (*c == '"') in_string = 0;
+            } else if (*c == '"') {
+                in_string = 1;
+            } else if (*c == '#') {
+                break;
+            } else if (*c == '(' || *c == '[' || *c == '{') {
+                depth++;
+            } else if ((*c == ')' || *c == ']' || *c == '}') && depth > 0) {
+                depth--;
+            }
+        }
+    }
+
+    if (count == cap) spans = SAGE_REALLOC(spans, sizeof(ChunkSpan) * (size_t)(cap + 1));
+    spans[count].start_line = current_start;
+    spans[count].line_count = line_count - current_start;
+    count++;
+
+    *out = spans;
+    return count;
 }
 
 /* ========================================================================
@@ -328,12 +859,29 @@ static void lsp_send_notification(const char* method, const char* params_json) {
 
 typedef struct {
     char* uri;
+    char* path;            /* Filesystem path for file:// URIs */
     char* content;
+    size_t length;
+    size_t capacity;
+    int* line_starts;      /* Byte offset of each line */
+    int line_count;
+    int line_capacity;
+    int version;
+    DocChunk* chunks;
+    int chunk_count;
+    int chunks_stale;      /* Text changed since the last reparse */
+    int dirty;             /* Diagnostics not yet published */
+    double dirty_since;    /* First unpublished change (for latency) */
+    double deadline;       /* Publish once quiet until this time */
 } Document;
 
 static Document g_documents[MAX_DOCUMENTS];
 static int g_document_count = 0;
 
+/* Guards documents, the workspace index and the metrics. */
+static sage_mutex_t g_docs_lock = SAGE_MUTEX_INITIALIZER;
+static sage_cond_t g_docs_cond = SAGE_COND_INITIALIZER;
+
 static Document* doc_find(const char* uri) {
     for (int i = 0; i < g_document_count; i++) {
         if (g_documents[i].uri && strcmp(g_documents[i].uri, uri) == 0) {
@@ -343,107 +891,479 @@ static Document* doc_find(const char* uri) {
     return NULL;
 }
 
-static Document* doc_open(const char* uri, const char* content) {
-    Document* existing = doc_find(uri);
-    if (existing) {
-        free(existing->content);
-        existing->content = strdup(content);
-        return existing;
+static void doc_index_lines(Document* doc) {
+    if (doc->line_capacity < 1) {
+        doc->line_capacity = 64;
+        doc->line_starts = SAGE_REALLOC(doc->line_starts, sizeof(int) * (size_t)doc->line_capacity);
+    }
+    int count = 0;
+    doc->line_starts[count++] = 0;
+    for (size_t pos = 0; pos < doc->length; pos++) {
+        if (doc->content[pos] != '\n') continue;
+        if (count >= doc->line_capacity) {
+            doc->line_capacity *= 2;
+            doc->line_starts = SAGE_REALLOC(doc->line_starts, sizeof(int) * (size_t)doc->line_capacity);
+        }
+        doc->line_starts[count++] = (int)pos + 1;
     }
+    doc->line_count = count;
+}
 
-    if (g_document_count >= MAX_DOCUMENTS) {
-        lsp_log("Maximum open documents reached (%d)", MAX_DOCUMENTS);
-        return NULL;
+static void doc_set_text(Document* doc, const char* text) {
+    size_t len = strlen(text);
+    if (len + 1 > doc->capacity) {
+        doc->capacity = len + 1 + len / 4;
+        doc->content = SAGE_REALLOC(doc->content, doc->capacity);
     }
+    memcpy(doc->content, text, len + 1);
+    doc->length = len;
+    doc_index_lines(doc);
+    doc->chunks_stale = 1;
+}
 
-    Document* doc = &g_documents[g_document_count++];
-    doc->uri = strdup(uri);
-    doc->content = strdup(content);
-    return doc;
+/* LSP positions count UTF-16 code units; convert one to a byte offset. */
+static size_t doc_offset(const Document* doc, int line, int character) {
+    if (line < 0) return 0;
+    if (line >= doc->line_count) return doc->length;
+    size_t pos = (size_t)doc->line_starts[line];
+    size_t end = line + 1 < doc->line_count ? (size_t)doc->line_starts[line + 1] - 1 : doc->length;
+    int units = 0;
+    while (pos < end && units < character) {
+        unsigned char c = (unsigned char)doc->content[pos];
+        int bytes = c < 0x80 ? 1 : c < 0xE0 ? 2 : c < 0xF0 ? 3 : 4;
+        units += bytes == 4 ? 2 : 1;
+        pos += (size_t)bytes;
+    }
+    return pos < end ? pos : end;
 }
 
-static void doc_update(const char* uri, const char* content) {
-    Document* doc = doc_find(uri);
-    if (doc) {
-        free(doc->content);
-        doc->content = strdup(content);
+/* Replace [start, end) with `text`; lines before the edit keep their
+ * offsets, lines after it are shifted rather than rescanned. */
+static void doc_splice(Document* doc, size_t start, size_t end, const char* text) {
+    size_t ins = strlen(text);
+    size_t new_len = doc->length - (end - start) + ins;
+    if (new_len + 1 > doc->capacity) {
+        doc->capacity = new_len + 1 + new_len / 4;
+        doc->content = SAGE_REALLOC(doc->content, doc->capacity);
+    }
+
+    /* Lines touched by the edit */
+    int first = 0;
+    while (first + 1 < doc->line_count && (size_t)doc->line_starts[first + 1] <= start) first++;
+    int last = first;
+    while (last + 1 < doc->line_count && (size_t)doc->line_starts[last + 1] <= end) last++;
+    int old_lines = doc->line_count;
+
+    memmove(doc->content + start + ins, doc->content + end, doc->length - end + 1);
+    memcpy(doc->content + start, text, ins);
+    doc->length = new_len;
+
+    int new_breaks = 0;
+    for (size_t i = 0; i < ins; i++) {
+        if (text[i] == '\n') new_breaks++;
+    }
+    int tail = old_lines - (last + 1);
+    int needed = first + 1 + new_breaks + tail;
+    if (needed > doc->line_capacity) {
+        while (doc->line_capacity < needed) doc->line_capacity *= 2;
+        doc->line_starts = SAGE_REALLOC(doc->line_starts, sizeof(int) * (size_t)doc->line_capacity);
+    }
+    long delta = (long)ins - (long)(end - start);
+    memmove(doc->line_starts + first + 1 + new_breaks, doc->line_starts + last + 1,
+            sizeof(int) * (size_t)tail);
+    for (int i = 0; i < tail; i++) {
+        doc->line_starts[first + 1 + new_breaks + i] += (int)delta;
     }
+    int line = first + 1;
+    for (size_t i = 0; i < ins; i++) {
+        if (text[i] == '\n') doc->line_starts[line++] = (int)(start + i + 1);
+    }
+    doc->line_count = needed;
+    doc->chunks_stale = 1;
 }
 
-static void doc_close(const char* uri) {
-    for (int i = 0; i < g_document_count; i++) {
-        if (g_documents[i].uri && strcmp(g_documents[i].uri, uri) == 0) {
-            free(g_documents[i].uri);
-            free(g_documents[i].content);
-            /* Move last element into this slot */
-            if (i < g_document_count - 1) {
-                g_documents[i] = g_documents[g_document_count - 1];
-            }
-            g_document_count--;
-            return;
+static void doc_clear(Document* doc) {
+    for (int i = 0; i < doc->chunk_count; i++) chunk_release(&doc->chunks[i]);
+    free(doc->chunks);
+    free(doc->uri);
+    free(doc->path);
+    free(doc->content);
+    free(doc->line_starts);
+    memset(doc, 0, sizeof(*doc));
+}
+
+typedef struct {
+    long publishes;
+    long edits;
+    long chunks_parsed;
+    long chunks_relexed;
+    long chunks_reused;
+    double reparse_ms;
+    double lint_ms;
+    double latency_ms_total;
+    double latency_ms_max;
+    double latency_ring[256];   /* Most recent edit -> publish latencies */
+    int latency_count;
+} LspMetrics;
+
+static LspMetrics g_metrics;
+
+/* Bring the chunk cache up to date with the text. Chunks whose text is
+ * unchanged are kept as they are (only their position moves); changed
+ * chunks are re-lexed, and re-parsed only if their token signature moved. */
+static void doc_reparse(Document* doc) {
+    if (!doc->chunks_stale) return;
+    double t0 = lsp_now_ms();
+
+    ChunkSpan* spans;
+    int count = split_chunks(doc->content, doc->length, doc->line_starts, doc->line_count, &spans);
+    DocChunk* chunks = SAGE_ALLOC(sizeof(DocChunk) * (size_t)count);
+    for (int i = 0; i < count; i++) {
+        int start = spans[i].start_line;
+        int end_line = start + spans[i].line_count;
+        size_t from = (size_t)doc->line_starts[start];
+        size_t to = end_line < doc->line_count ? (size_t)doc->line_starts[end_line] : doc->length;
+        chunks[i].start_line = start;
+        chunks[i].line_count = spans[i].line_count;
+        chunks[i].text_length = to - from;
+        chunks[i].text_hash = hash_bytes(HASH_SEED, doc->content + from, to - from);
+    }
+    free(spans);
+
+    /* Match unchanged chunks from both ends; what remains in the middle was
+     * edited, and is paired up positionally for the token-signature check. */
+    DocChunk* old = doc->chunks;
+    int old_count = doc->chunk_count;
+    int prefix = 0;
+    while (prefix < count && prefix < old_count &&
+           old[prefix].text_hash == chunks[prefix].text_hash &&
+           old[prefix].text_length == chunks[prefix].text_length) {
+        prefix++;
+    }
+    int suffix = 0;
+    while (suffix < count - prefix && suffix < old_count - prefix &&
+           old[old_count - 1 - suffix].text_hash == chunks[count - 1 - suffix].text_hash &&
+           old[old_count - 1 - suffix].text_length == chunks[count - 1 - suffix].text_length) {
+        suffix++;
+    }
+
+    for (int i = 0; i < count; i++) {
+        DocChunk* chunk = &chunks[i];
+        DocChunk* prev = NULL;
+        int reusable = 0;
+        if (i < prefix) {
+            prev = &old[i];
+            reusable = 1;
+        } else if (i >= count - suffix) {
+            prev = &old[old_count - (count - i)];
+            reusable = 1;
+        } else if (i - prefix < old_count - prefix - suffix) {
+            prev = &old[i];
+        }
+
+        char* source = NULL;
+        uint32_t token_hash = 0;
+        if (!reusable) {
+            size_t from = (size_t)doc->line_starts[chunk->start_line];
+            source = SAGE_ALLOC(chunk->text_length + 1);
+            memcpy(source, doc->content + from, chunk->text_length);
+            token_hash = chunk_token_hash(source);
+            g_metrics.chunks_relexed++;
+            reusable = prev && token_hash != 0 && prev->token_hash == token_hash;
+        }
+
+        if (reusable) {
+            /* Take over the old chunk's tree, text and symbols. */
+            DocChunk moved = *prev;
+            moved.start_line = chunk->start_line;
+            moved.line_count = chunk->line_count;
+            moved.text_hash = chunk->text_hash;
+            moved.text_length = chunk->text_length;
+            *chunk = moved;
+            memset(prev, 0, sizeof(*prev));
+            free(source);
+            g_metrics.chunks_reused++;
+        } else {
+            chunk->source = source;
+            chunk->token_hash = token_hash;
+            chunk_parse(chunk, doc->uri);
+            g_metrics.chunks_parsed++;
         }
     }
+
+    for (int i = 0; i < old_count; i++) chunk_release(&old[i]);
+    free(old);
+    doc->chunks = chunks;
+    doc->chunk_count = count;
+    doc->chunks_stale = 0;
+    g_metrics.reparse_ms += lsp_now_ms() - t0;
 }
 
 /* ========================================================================
- * ID extraction helper
+ * Workspace symbol index
+ *
+ * Files under the workspace root are indexed once, in the background, and
+ * keep only their symbols. While a file is open its live chunks take over.
  * ======================================================================== */
 
 typedef struct {
-    char str[128];
-    int is_string;
-} RequestId;
+    char* uri;
+    char* path;
+    Symbol* symbols;      /* Lines are absolute here */
+    int symbol_count;
+} IndexedFile;
+
+static IndexedFile* g_index = NULL;
+static int g_index_count = 0;
+static int g_index_cap = 0;
+static char* g_workspace_root = NULL;
+static int g_index_pending = 0;
+
+#define INDEX_MAX_FILES 4096
+#define INDEX_MAX_DEPTH 16
+
+static IndexedFile* index_find_path(const char* path) {
+    if (!path) return NULL;
+    for (int i = 0; i < g_index_count; i++) {
+        if (strcmp(g_index[i].path, path) == 0) return &g_index[i];
+    }
+    return NULL;
+}
 
-static RequestId extract_id(const char* json) {
-    RequestId rid;
-    rid.str[0] = '\0';
-    rid.is_string = 0;
+static const Document* doc_find_path(const char* path) {
+    for (int i = 0; i < g_document_count; i++) {
+        if (g_documents[i].path && strcmp(g_documents[i].path, path) == 0) {
+            return &g_documents[i];
+        }
+    }
+    return NULL;
+}
 
-    /* Find "id" field */
-    const char* p = strstr(json, "\"id\"");
-    if (!p) return rid;
+static char* read_file_text(const char* path) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return NULL;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    if (size < 0) {
+        fclose(f);
+        return NULL;
+    }
+    char* text = SAGE_ALLOC((size_t)size + 1);
+    size_t n = fread(text, 1, (size_t)size, f);
+    text[n] = '\0';
+    fclose(f);
+    return text;
+}
 
-    p += 4;
-    while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r' || *p == ':') p++;
+/* Parse a file chunk by chunk and keep only its symbols. Runs unlocked. */
+static Symbol* index_scan_file(const char* path, const char* uri, int* count_out) {
+    *count_out = 0;
+    char* text = read_file_text(path);
+    if (!text) return NULL;
+
+    Document scratch;
+    memset(&scratch, 0, sizeof(scratch));
+    scratch.uri = (char*)uri;
+    doc_set_text(&scratch, text);
+    free(text);
+
+    ChunkSpan* spans;
+    int count = split_chunks(scratch.content, scratch.length, scratch.line_starts,
+                             scratch.line_count, &spans);
+    SymbolList all = {0};
+    for (int i = 0; i < count; i++) {
+        int start = spans[i].start_line;
+        int end_line = start + spans[i].line_count;
+        size_t from = (size_t)scratch.line_starts[start];
+        size_t to = end_line < scratch.line_count ? (size_t)scratch.line_starts[end_line] : scratch.length;
+        DocChunk chunk;
+        memset(&chunk, 0, sizeof(chunk));
+        chunk.source = SAGE_ALLOC(to - from + 1);
+        memcpy(chunk.source, scratch.content + from, to - from);
+        chunk_parse(&chunk, uri);
+        for (int s = 0; s < chunk.symbol_count; s++) {
+            if (all.count >= all.cap) {
+                all.cap = all.cap ? all.cap * 2 : 16;
+                all.items = SAGE_REALLOC(all.items, sizeof(Symbol) * (size_t)all.cap);
+            }
+            Symbol sym = chunk.symbols[s];
+            sym.line += start;
+            all.items[all.count++] = sym;
+        }
+        free(chunk.symbols);
+        chunk.symbols = NULL;
+        chunk.symbol_count = 0;
+        chunk_release(&chunk);
+    }
+    free(spans);
+    free(scratch.content);
+    free(scratch.line_starts);
 
-    if (*p == '"') {
-        /* String id */
-        rid.is_string = 1;
-        p++;
-        size_t i = 0;
-        while (*p && *p != '"' && i < sizeof(rid.str) - 1) {
-            rid.str[i++] = *p++;
+    *count_out = all.count;
+    return all.items;
+}
+
+/* Store (or replace) a file's symbols. Caller holds g_docs_lock. */
+static void index_store(const char* path, char* uri, Symbol* symbols, int count) {
+    IndexedFile* entry = index_find_path(path);
+    if (entry) {
+        symbols_free(entry->symbols, entry->symbol_count);
+        free(uri);
+    } else {
+        if (g_index_count == g_index_cap) {
+            g_index_cap = g_index_cap ? g_index_cap * 2 : 64;
+            g_index = SAGE_REALLOC(g_index, sizeof(IndexedFile) * (size_t)g_index_cap);
         }
-        rid.str[i] = '\0';
-    } else if (*p == '-' || (*p >= '0' && *p <= '9')) {
-        /* Numeric id */
-        rid.is_string = 0;
-        size_t i = 0;
-        while (*p && ((*p >= '0' && *p <= '9') || *p == '-') && i < sizeof(rid.str) - 1) {
-            rid.str[i++] = *p++;
+        entry = &g_index[g_index_count++];
+        entry->uri = uri;
+        entry->path = strdup(path);
+    }
+    entry->symbols = symbols;
+    entry->symbol_count = count;
+}
+
+static void index_collect_paths(const char* dir, int depth, char*** paths, int* count, int* cap) {
+    if (depth > INDEX_MAX_DEPTH || *count >= INDEX_MAX_FILES) return;
+    DIR* d = opendir(dir);
+    if (!d) return;
+    struct dirent* entry;
+    while ((entry = readdir(d)) != NULL && *count < INDEX_MAX_FILES) {
+        const char* name = entry->d_name;
+        if (name[0] == '.') continue;  /* ., .., and hidden directories */
+        size_t len = strlen(dir) + strlen(name) + 2;
+        char* full = SAGE_ALLOC(len);
+        snprintf(full, len, "%s/%s", dir, name);
+        struct stat st;
+        if (stat(full, &st) != 0) {
+            free(full);
+            continue;
+        }
+        size_t nlen = strlen(name);
+        if (S_ISDIR(st.st_mode)) {
+            index_collect_paths(full, depth + 1, paths, count, cap);
+            free(full);
+        } else if (S_ISREG(st.st_mode) && nlen > 5 && strcmp(name + nlen - 5, ".sage") == 0) {
+            if (*count == *cap) {
+                *cap = *cap ? *cap * 2 : 64;
+                *paths = SAGE_REALLOC(*paths, sizeof(char*) * (size_t)*cap);
+            }
+            (*paths)[(*count)++] = full;
+        } else {
+            free(full);
         }
-        rid.str[i] = '\0';
     }
+    closedir(d);
+}
 
-    return rid;
+static void index_workspace(const char* root) {
+    double t0 = lsp_now_ms();
+    char** paths = NULL;
+    int count = 0;
+    int cap = 0;
+    index_collect_paths(root, 0, &paths, &count, &cap);
+
+    int symbols = 0;
+    for (int i = 0; i < count; i++) {
+        char* uri = path_to_uri(paths[i]);
+        int n;
+        Symbol* syms = index_scan_file(paths[i], uri, &n);
+        symbols += n;
+        sage_mutex_lock(&g_docs_lock);
+        index_store(paths[i], uri, syms, n);
+        sage_mutex_unlock(&g_docs_lock);
+        free(paths[i]);
+    }
+    free(paths);
+    lsp_log("Indexed %d files (%d symbols) under %s in %.1f ms",
+            count, symbols, root, lsp_now_ms() - t0);
+}
+
+/* Walk every symbol visible in the workspace: open documents first (from
+ * their chunks), then indexed files that are not open. Stops when `visit`
+ * returns nonzero. Caller holds g_docs_lock. */
+typedef int (*SymbolVisitor)(void* ctx, const char* uri, const Symbol* sym, int line);
+
+static void index_visit(SymbolVisitor visit, void* ctx, const Document* only) {
+    for (int d = 0; d < g_document_count; d++) {
+        const Document* doc = &g_documents[d];
+        if (only && doc != only) continue;
+        for (int c = 0; c < doc->chunk_count; c++) {
+            const DocChunk* chunk = &doc->chunks[c];
+            for (int s = 0; s < chunk->symbol_count; s++) {
+                const Symbol* sym = &chunk->symbols[s];
+                if (visit(ctx, doc->uri, sym, chunk->start_line + sym->line)) return;
+            }
+        }
+    }
+    if (only) return;
+    for (int i = 0; i < g_index_count; i++) {
+        const IndexedFile* file = &g_index[i];
+        if (doc_find_path(file->path)) continue;
+        for (int s = 0; s < file->symbol_count; s++) {
+            if (visit(ctx, file->uri, &file->symbols[s], file->symbols[s].line)) return;
+        }
+    }
 }
 
 /* ========================================================================
- * Diagnostics (via linter)
+ * Diagnostics (syntax errors from the chunk cache + linter)
  * ======================================================================== */
 
-static void publish_diagnostics(const char* uri, const char* content) {
-    LintOptions opts = lint_default_options();
-    LintMessage* msgs = lint_source(content, "buffer", opts);
+static int g_debounce_ms = 150;
+static int g_worker_running = 0;
+static int g_worker_stop = 0;
+static sage_thread_t g_worker;
+
+static void record_latency(double latency) {
+    g_metrics.publishes++;
+    g_metrics.latency_ms_total += latency;
+    if (latency > g_metrics.latency_ms_max) g_metrics.latency_ms_max = latency;
+    g_metrics.latency_ring[g_metrics.latency_count % 256] = latency;
+    g_metrics.latency_count++;
+}
 
-    /* Build diagnostics JSON array */
-    size_t cap = 4096;
-    char* diags = SAGE_ALLOC(cap);
-    size_t len = 0;
+/* Reparse and publish diagnostics for g_documents[index]. Called with
+ * g_docs_lock held; the lock is dropped while the linter runs. */
+static void publish_diagnostics(int index) {
+    Document* doc = &g_documents[index];
+    double since = doc->dirty_since;
+    long parsed_before = g_metrics.chunks_parsed;
+    double t_parse = lsp_now_ms();
+    doc_reparse(doc);
+    double parse_ms = lsp_now_ms() - t_parse;
+    long parsed = g_metrics.chunks_parsed - parsed_before;
+    doc->dirty = 0;
+
+    JsonBuf diags = {0};
+    jb_append(&diags, "[");
+    int first = 1;
+    int syntax_errors = 0;
+    for (int c = 0; c < doc->chunk_count; c++) {
+        const DocChunk* chunk = &doc->chunks[c];
+        if (!chunk->failed) continue;
+        int line = chunk->start_line + chunk->error_line;
+        jb_printf(&diags,
+            "%s{\"range\":{\"start\":{\"line\":%d,\"character\":%d},"
+            "\"end\":{\"line\":%d,\"character\":%d}},"
+            "\"severity\":1,\"source\":\"sage\",\"message\":",
+            first ? "" : ",", line, chunk->error_column, line, chunk->error_column + 1);
+        jb_string(&diags, chunk->error_message);
+        jb_append(&diags, "}");
+        first = 0;
+        syntax_errors++;
+    }
 
-    diags[len++] = '[';
+    char* uri = strdup(doc->uri);
+    char* content = strdup(doc->content);
+    int version = doc->version;
+    int chunk_count = doc->chunk_count;
+    sage_mutex_unlock(&g_docs_lock);
 
-    int first = 1;
+    double t_lint = lsp_now_ms();
+    LintOptions opts = lint_default_options();
+    LintMessage* msgs = lint_source(content, "buffer", opts);
+    int lint_count = 0;
     for (LintMessage* m = msgs; m; m = m->next) {
         /* Map severity */
         int sev;
@@ -454,57 +1374,108 @@ static void publish_diagnostics(const char* uri, const char* content) {
             default:           sev = 3; break; /* Information */
         }
 
-        char* esc_msg = json_escape(m->message);
-        char* esc_rule = json_escape(m->rule ? m->rule : "");
-
-        char diag_buf[1024];
-        int diag_len = snprintf(diag_buf, sizeof(diag_buf),
+        int line = m->line > 0 ? m->line - 1 : 0;       /* LSP lines are 0-based */
+        int col = m->column > 0 ? m->column - 1 : 0;    /* LSP columns are 0-based */
+        jb_printf(&diags,
             "%s{\"range\":{\"start\":{\"line\":%d,\"character\":%d},"
             "\"end\":{\"line\":%d,\"character\":%d}},"
-            "\"severity\":%d,"
-            "\"source\":\"sage-lint\","
-            "\"code\":\"%s\","
-            "\"message\":\"%s\"}",
-            first ? "" : ",",
-            m->line > 0 ? m->line - 1 : 0,    /* LSP lines are 0-based */
-            m->column > 0 ? m->column - 1 : 0, /* LSP columns are 0-based */
-            m->line > 0 ? m->line - 1 : 0,
-            m->column > 0 ? m->column - 1 + 1 : 1, /* end 1 char further */
-            sev, esc_rule, esc_msg);
-
-        free(esc_msg);
-        free(esc_rule);
-
-        while (len + (size_t)diag_len + 2 >= cap) {
-            cap *= 2;
-            diags = SAGE_REALLOC(diags, cap);
-        }
-        memcpy(diags + len, diag_buf, (size_t)diag_len);
-        len += (size_t)diag_len;
+            "\"severity\":%d,\"source\":\"sage-lint\",\"code\":",
+            first ? "" : ",", line, col, line, col + 1, sev);
+        jb_string(&diags, m->rule ? m->rule : "");
+        jb_append(&diags, ",\"message\":");
+        jb_string(&diags, m->message);
+        jb_append(&diags, "}");
         first = 0;
+        lint_count++;
     }
+    jb_append(&diags, "]");
+    free_lint_messages(msgs);
+    free(content);
+    double lint_ms = lsp_now_ms() - t_lint;
+
+    JsonBuf params = {0};
+    jb_append(&params, "{\"uri\":");
+    jb_string(&params, uri);
+    jb_printf(&params, ",\"version\":%d,\"diagnostics\":%s}", version, diags.data);
+    free(diags.data);
+
+    sage_mutex_lock(&g_docs_lock);
+    /* A didClose while we were linting already cleared the diagnostics. */
+    if (doc_find(uri)) {
+        lsp_send_notification("textDocument/publishDiagnostics", params.data);
+        double latency = lsp_now_ms() - since;
+        g_metrics.lint_ms += lint_ms;
+        record_latency(latency);
+        lsp_log("Diagnostics %s v%d: %d syntax, %d lint; reparsed %ld/%d chunks in %.2f ms, "
+                "lint %.2f ms, latency %.1f ms",
+                uri, version, syntax_errors, lint_count, parsed, chunk_count,
+                parse_ms, lint_ms, latency);
+    }
+    free(params.data);
+    free(uri);
+}
 
-    diags[len++] = ']';
-    diags[len] = '\0';
+/* Background publisher: waits until a dirty document has been quiet for
+ * the debounce interval, then publishes it. */
+static void* diagnostics_worker(void* arg) {
+    (void)arg;
+    sage_mutex_lock(&g_docs_lock);
+    while (!g_worker_stop) {
+        if (g_index_pending) {
+            g_index_pending = 0;
+            char* root = strdup(g_workspace_root);
+            sage_mutex_unlock(&g_docs_lock);
+            index_workspace(root);
+            free(root);
+            sage_mutex_lock(&g_docs_lock);
+            continue;
+        }
 
-    free_lint_messages(msgs);
+        double now = lsp_now_ms();
+        double wait = -1.0;
+        int due = -1;
+        for (int i = 0; i < g_document_count; i++) {
+            if (!g_documents[i].dirty) continue;
+            double remaining = g_documents[i].deadline - now;
+            if (remaining <= 0) {
+                due = i;
+                break;
+            }
+            if (wait < 0 || remaining < wait) wait = remaining;
+        }
 
-    /* Build notification params */
-    char* esc_uri = json_escape(uri);
-    size_t params_cap = len + strlen(esc_uri) + 64;
-    char* params = SAGE_ALLOC(params_cap);
-    snprintf(params, params_cap,
-        "{\"uri\":\"%s\",\"diagnostics\":%s}",
-        esc_uri, diags);
-    free(esc_uri);
-    free(diags);
+        if (due >= 0) {
+            publish_diagnostics(due);
+        } else if (wait < 0) {
+            sage_cond_wait(&g_docs_cond, &g_docs_lock);
+        } else {
+            sage_mutex_unlock(&g_docs_lock);
+            sage_usleep((unsigned int)(wait * 1000.0) + 1);
+            sage_mutex_lock(&g_docs_lock);
+        }
+    }
+    sage_mutex_unlock(&g_docs_lock);
+    return NULL;
+}
 
-    lsp_send_notification("textDocument/publishDiagnostics", params);
-    free(params);
+/* Note a change to g_documents[index]; caller holds g_docs_lock. */
+static void schedule_diagnostics(int index, int immediate) {
+    Document* doc = &g_documents[index];
+    double now = lsp_now_ms();
+    if (!doc->dirty) {
+        doc->dirty = 1;
+        doc->dirty_since = now;
+    }
+    doc->deadline = immediate ? now : now + g_debounce_ms;
+    if (g_worker_running) {
+        sage_cond_signal(&g_docs_cond);
+    } else {
+        publish_diagnostics(index);
+    }
 }
 
 /* ========================================================================
- * Completion (keywords + builtins)
+ * Completion (keywords + builtins + workspace symbols)
  * ======================================================================== */
 
 typedef struct {
@@ -584,152 +1555,209 @@ static const CompletionEntry g_completions[] = {
     {NULL, 0, NULL}
 };
 
-static void handle_completion(const char* json, RequestId rid) {
-    (void)json;
-
-    /* Build items array */
-    size_t cap = 8192;
-    char* items = SAGE_ALLOC(cap);
-    size_t len = 0;
-    items[len++] = '[';
+static int is_ident_char(char c) {
+    return c == '_' || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9');
+}
 
-    int first = 1;
-    for (int i = 0; g_completions[i].label; i++) {
-        char item_buf[512];
-        char* esc_label = json_escape(g_completions[i].label);
-        char* esc_detail = json_escape(g_completions[i].detail);
-        int item_len = snprintf(item_buf, sizeof(item_buf),
-            "%s{\"label\":\"%s\",\"kind\":%d,\"detail\":\"%s\"}",
-            first ? "" : ",",
-            esc_label, g_completions[i].kind, esc_detail);
-        free(esc_label);
-        free(esc_detail);
-
-        while (len + (size_t)item_len + 2 >= cap) {
-            cap *= 2;
-            items = SAGE_REALLOC(items, cap);
-        }
-        memcpy(items + len, item_buf, (size_t)item_len);
-        len += (size_t)item_len;
-        first = 0;
+/* Word under (or ending at, with prefix_only) a position. Returns a
+ * malloc'd string or NULL. */
+static char* doc_word_at(const Document* doc, int line, int character, int prefix_only) {
+    if (line < 0 || line >= doc->line_count) return NULL;
+    size_t line_start = (size_t)doc->line_starts[line];
+    size_t line_end = line + 1 < doc->line_count ? (size_t)doc->line_starts[line + 1] - 1 : doc->length;
+    size_t pos = doc_offset(doc, line, character);
+    size_t start = pos;
+    size_t end = pos;
+    while (start > line_start && is_ident_char(doc->content[start - 1])) start--;
+    if (!prefix_only) {
+        while (end < line_end && is_ident_char(doc->content[end])) end++;
     }
-
-    items[len++] = ']';
-    items[len] = '\0';
-
-    lsp_send_response(rid.str, rid.is_string, items);
-    free(items);
+    if (start == end) return NULL;
+    char* word = SAGE_ALLOC(end - start + 1);
+    memcpy(word, doc->content + start, end - start);
+    return word;
 }
 
-/* ========================================================================
- * Hover (keyword/builtin documentation)
- * ======================================================================== */
-
-/* g_hover_docs moved to diagnostic.c */
-
-/*
- * Get the word at a given line/character position in the document content.
- * Returns a malloc'd string or NULL.
- */
-static char* get_word_at(const char* content, int line, int character) {
-    if (!content) return NULL;
-
-    /* Find the line */
-    const char* p = content;
-    for (int i = 0; i < line && *p; i++) {
-        while (*p && *p != '\n') p++;
-        if (*p == '\n') p++;
+static int completion_kind(int symbol_kind) {
+    switch (symbol_kind) {
+        case SYM_CLASS:     return 7;
+        case SYM_METHOD:    return 2;
+        case SYM_ENUM:      return 13;
+        case SYM_INTERFACE: return 8;
+        case SYM_FUNCTION:  return 3;
+        case SYM_STRUCT:    return 22;
+        default:            return 6;
     }
+}
 
-    /* Now p points to the start of the target line */
-    const char* line_start = p;
-    int line_len = 0;
-    while (line_start[line_len] && line_start[line_len] != '\n') line_len++;
-
-    if (character >= line_len) return NULL;
-
-    /* Find word boundaries */
-    int start = character;
-    int end = character;
-
-    while (start > 0 && (line_start[start-1] == '_' ||
-           (line_start[start-1] >= 'a' && line_start[start-1] <= 'z') ||
-           (line_start[start-1] >= 'A' && line_start[start-1] <= 'Z') ||
-           (line_start[start-1] >= '0' && line_start[start-1] <= '9'))) {
-        start--;
-    }
+#define COMPLETION_LIMIT 1000
 
-    while (end < line_len && (line_start[end] == '_' ||
-           (line_start[end] >= 'a' && line_start[end] <= 'z') ||
-           (line_start[end] >= 'A' && line_start[end] <= 'Z') ||
-           (line_start[end] >= '0' && line_start[end] <= '9'))) {
-        end++;
+typedef struct {
+    JsonBuf* items;
+    const char* prefix;
+    size_t prefix_len;
+    const char** seen;     /* Open-addressed set of labels already emitted */
+    size_t seen_cap;
+    int count;
+} CompletionCtx;
+
+static int completion_seen(CompletionCtx* ctx, const char* label) {
+    uint32_t h = hash_bytes(HASH_SEED, label, strlen(label));
+    size_t i = h & (ctx->seen_cap - 1);
+    while (ctx->seen[i]) {
+        if (strcmp(ctx->seen[i], label) == 0) return 1;
+        i = (i + 1) & (ctx->seen_cap - 1);
     }
+    if ((size_t)ctx->count * 2 >= ctx->seen_cap) return 1;  /* Full: stop adding */
+    ctx->seen[i] = label;
+    return 0;
+}
 
-    if (start == end) return NULL;
+static void completion_add(CompletionCtx* ctx, const char* label, int kind, const char* detail) {
+    if (ctx->prefix_len && strncmp(label, ctx->prefix, ctx->prefix_len) != 0) return;
+    if (completion_seen(ctx, label)) return;
+    jb_append(ctx->items, ctx->count ? ",{\"label\":" : "{\"label\":");
+    jb_string(ctx->items, label);
+    jb_printf(ctx->items, ",\"kind\":%d,\"detail\":", kind);
+    jb_string(ctx->items, detail);
+    jb_append(ctx->items, "}");
+    ctx->count++;
+}
 
-    int wlen = end - start;
-    char* word = SAGE_ALLOC((size_t)wlen + 1);
-    memcpy(word, line_start + start, (size_t)wlen);
-    word[wlen] = '\0';
-    return word;
+static int completion_visit(void* arg, const char* uri, const Symbol* sym, int line) {
+    (void)uri;
+    (void)line;
+    CompletionCtx* ctx = arg;
+    completion_add(ctx, sym->name, completion_kind(sym->kind), sym->detail ? sym->detail : "");
+    return ctx->count >= COMPLETION_LIMIT;
 }
 
-static void handle_hover(const char* json, RequestId rid) {
-    /* Extract params */
-    char* params = json_get_object(json, "params");
-    if (!params) {
-        lsp_send_response(rid.str, rid.is_string, "null");
-        return;
+static void handle_completion(const JsonNode* msg, RequestId rid) {
+    JsonBuf items = {0};
+    CompletionCtx ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.items = &items;
+    ctx.seen_cap = COMPLETION_LIMIT * 4;
+    ctx.seen = SAGE_ALLOC(sizeof(char*) * ctx.seen_cap);
+
+    const char* uri = json_get_string(msg, "params.textDocument.uri");
+    int line = json_get_int(msg, "params.position.line", 0);
+    int character = json_get_int(msg, "params.position.character", 0);
+
+    sage_mutex_lock(&g_docs_lock);
+    Document* doc = uri ? doc_find(uri) : NULL;
+    char* prefix = doc ? doc_word_at(doc, line, character, 1) : NULL;
+    ctx.prefix = prefix ? prefix : "";
+    ctx.prefix_len = strlen(ctx.prefix);
+
+    jb_append(&items, "{\"isIncomplete\":false,\"items\":[");
+    for (int i = 0; g_completions[i].label; i++) {
+        completion_add(&ctx, g_completions[i].label, g_completions[i].kind, g_completions[i].detail);
     }
+    if (doc) {
+        doc_reparse(doc);
+        index_visit(completion_visit, &ctx, doc);
+    }
+    if (ctx.count < COMPLETION_LIMIT) index_visit(completion_visit, &ctx, NULL);
+    sage_mutex_unlock(&g_docs_lock);
+    jb_append(&items, "]}");
+
+    lsp_send_response(rid, items.data);
+    free(items.data);
+    free(ctx.seen);
+    free(prefix);
+}
 
-    char* td = json_get_object(params, "textDocument");
-    char* pos = json_get_object(params, "position");
-
-    char* uri = td ? json_get_string(td, "uri") : NULL;
-    int line = pos ? json_get_int(pos, "line", 0) : 0;
-    int character = pos ? json_get_int(pos, "character", 0) : 0;
+/* ========================================================================
+ * Symbol lookup (hover, definition, document/workspace symbols)
+ * ======================================================================== */
 
-    free(td);
-    free(pos);
-    free(params);
+typedef struct {
+    const char* name;
+    const char* uri;
+    const Symbol* sym;
+    int line;
+} SymbolMatch;
+
+static int find_visit(void* arg, const char* uri, const Symbol* sym, int line) {
+    SymbolMatch* match = arg;
+    if (strcmp(sym->name, match->name) != 0) return 0;
+    match->uri = uri;
+    match->sym = sym;
+    match->line = line;
+    return 1;
+}
 
-    if (!uri) {
-        lsp_send_response(rid.str, rid.is_string, "null");
-        return;
-    }
+/* Find a declaration, preferring the current document. Caller holds the lock. */
+static SymbolMatch symbol_lookup(const Document* doc, const char* name) {
+    SymbolMatch match;
+    memset(&match, 0, sizeof(match));
+    match.name = name;
+    if (doc) index_visit(find_visit, &match, doc);
+    if (!match.sym) index_visit(find_visit, &match, NULL);
+    return match;
+}
 
-    Document* doc = doc_find(uri);
-    free(uri);
+static void jb_location(JsonBuf* b, const char* uri, const Symbol* sym, int line) {
+    jb_append(b, "{\"uri\":");
+    jb_string(b, uri);
+    jb_printf(b, ",\"range\":{\"start\":{\"line\":%d,\"character\":%d},"
+                 "\"end\":{\"line\":%d,\"character\":%d}}}",
+              line, sym->column, line, sym->column + (int)strlen(sym->name));
+}
 
-    if (!doc) {
-        lsp_send_response(rid.str, rid.is_string, "null");
-        return;
-    }
+/* Resolve the position in msg.params to a document and the word there. */
+static Document* doc_for_position(const JsonNode* msg, char** word) {
+    const char* uri = json_get_string(msg, "params.textDocument.uri");
+    int line = json_get_int(msg, "params.position.line", 0);
+    int character = json_get_int(msg, "params.position.character", 0);
+    Document* doc = uri ? doc_find(uri) : NULL;
+    *word = doc ? doc_word_at(doc, line, character, 0) : NULL;
+    if (doc) doc_reparse(doc);
+    return doc;
+}
 
-    char* word = get_word_at(doc->content, line, character);
+static void handle_hover(const JsonNode* msg, RequestId rid) {
+    sage_mutex_lock(&g_docs_lock);
+    char* word;
+    Document* doc = doc_for_position(msg, &word);
     if (!word) {
-        lsp_send_response(rid.str, rid.is_string, "null");
+        sage_mutex_unlock(&g_docs_lock);
+        lsp_send_response(rid, "null");
         return;
     }
 
+    JsonBuf text = {0};
+
     /* Look up hover documentation */
-    const char* hover_doc = NULL;
     for (int i = 0; g_hover_docs[i].name; i++) {
         if (strcmp(word, g_hover_docs[i].name) == 0) {
-            hover_doc = g_hover_docs[i].doc;
+            jb_append(&text, g_hover_docs[i].doc);
             break;
         }
     }
 
-    char* user_doc = NULL;
-    if (!hover_doc && g_global_env) {
+    if (!text.data) {
+        SymbolMatch match = symbol_lookup(doc, word);
+        if (match.sym) {
+            jb_append(&text, "```sage\n");
+            jb_append(&text, match.sym->detail ? match.sym->detail : match.sym->name);
+            jb_append(&text, "\n```");
+            if (match.sym->doc) {
+                jb_append(&text, "\n\n");
+                jb_append(&text, match.sym->doc);
+            }
+        }
+    }
+    sage_mutex_unlock(&g_docs_lock);
+
+    if (!text.data && g_global_env) {
         Value val;
         if (env_get(g_global_env, word, (int)strlen(word), &val)) {
             if (val.type == VAL_FUNCTION && val.as.function->proc) {
                 ProcStmt* proc = (ProcStmt*)val.as.function->proc;
                 if (proc->doc) {
-                    user_doc = strdup(proc->doc);
+                    jb_append(&text, proc->doc);
                 }
             }
         }
@@ -737,104 +1765,308 @@ static void handle_hover(const char* json, RequestId rid) {
 
     free(word);
 
-    if (!hover_doc && !user_doc) {
-        lsp_send_response(rid.str, rid.is_string, "null");
+    if (!text.data) {
+        lsp_send_response(rid, "null");
         return;
     }
 
-    const char* final_doc = hover_doc ? hover_doc : user_doc;
-    char* esc_doc = json_escape(final_doc);
-    size_t cap = strlen(esc_doc) + 128;
-    char* result = SAGE_ALLOC(cap);
-    snprintf(result, cap,
-        "{\"contents\":{\"kind\":\"markdown\",\"value\":\"%s\"}}",
-        esc_doc);
-    free(esc_doc);
-    if (user_doc) free(user_doc);
+    JsonBuf result = {0};
+    jb_append(&result, "{\"contents\":{\"kind\":\"markdown\",\"value\":");
+    jb_string(&result, text.data);
+    jb_append(&result, "}}");
+    free(text.data);
 
-    lsp_send_response(rid.str, rid.is_string, result);
-    free(result);
+    lsp_send_response(rid, result.data);
+    free(result.data);
+}
+
+static void handle_definition(const JsonNode* msg, RequestId rid) {
+    sage_mutex_lock(&g_docs_lock);
+    char* word;
+    Document* doc = doc_for_position(msg, &word);
+    JsonBuf result = {0};
+    if (word) {
+        SymbolMatch match = symbol_lookup(doc, word);
+        if (match.sym) jb_location(&result, match.uri, match.sym, match.line);
+    }
+    sage_mutex_unlock(&g_docs_lock);
+    free(word);
+
+    lsp_send_response(rid, result.data ? result.data : "null");
+    free(result.data);
+}
+
+typedef struct {
+    JsonBuf* out;
+    const char* query;   /* Case-insensitive substring; "" matches all */
+    int count;
+} SymbolQuery;
+
+#define WORKSPACE_SYMBOL_LIMIT 500
+
+static int contains_ci(const char* haystack, const char* needle) {
+    size_t n = strlen(needle);
+    for (const char* h = haystack; *h; h++) {
+        size_t i = 0;
+        while (i < n && h[i] && (h[i] | 0x20) == (needle[i] | 0x20)) i++;
+        if (i == n) return 1;
+    }
+    return n == 0;
+}
+
+static int symbol_info_visit(void* arg, const char* uri, const Symbol* sym, int line) {
+    SymbolQuery* q = arg;
+    if (!contains_ci(sym->name, q->query)) return 0;
+    jb_append(q->out, q->count ? ",{\"name\":" : "{\"name\":");
+    jb_string(q->out, sym->name);
+    jb_printf(q->out, ",\"kind\":%d,", sym->kind);
+    if (sym->container) {
+        jb_append(q->out, "\"containerName\":");
+        jb_string(q->out, sym->container);
+        jb_append(q->out, ",");
+    }
+    jb_append(q->out, "\"location\":");
+    jb_location(q->out, uri, sym, line);
+    jb_append(q->out, "}");
+    q->count++;
+    return q->count >= WORKSPACE_SYMBOL_LIMIT;
+}
+
+static void handle_symbols(const JsonNode* msg, RequestId rid, int workspace) {
+    JsonBuf out = {0};
+    SymbolQuery q = { &out, "", 0 };
+    jb_append(&out, "[");
+
+    sage_mutex_lock(&g_docs_lock);
+    if (workspace) {
+        const char* query = json_get_string(msg, "params.query");
+        q.query = query ? query : "";
+        index_visit(symbol_info_visit, &q, NULL);
+    } else {
+        const char* uri = json_get_string(msg, "params.textDocument.uri");
+        Document* doc = uri ? doc_find(uri) : NULL;
+        if (doc) {
+            doc_reparse(doc);
+            index_visit(symbol_info_visit, &q, doc);
+        }
+    }
+    sage_mutex_unlock(&g_docs_lock);
+
+    jb_append(&out, "]");
+    lsp_send_response(rid, out.data);
+    free(out.data);
 }
 
 /* ========================================================================
  * Formatting (via formatter)
  * ======================================================================== */
 
-static void handle_formatting(const char* json, RequestId rid) {
-    char* params = json_get_object(json, "params");
-    if (!params) {
-        lsp_send_response(rid.str, rid.is_string, "[]");
+static void handle_formatting(const JsonNode* msg, RequestId rid) {
+    const char* uri = json_get_string(msg, "params.textDocument.uri");
+
+    sage_mutex_lock(&g_docs_lock);
+    Document* doc = uri ? doc_find(uri) : NULL;
+    char* content = doc ? strdup(doc->content) : NULL;
+    int line_count = doc ? doc->line_count : 0;
+    sage_mutex_unlock(&g_docs_lock);
+
+    if (!content) {
+        lsp_send_response(rid, "[]");
         return;
     }
 
-    char* td = json_get_object(params, "textDocument");
-    char* uri = td ? json_get_string(td, "uri") : NULL;
-    free(td);
-    free(params);
+    FormatOptions fmt_opts = format_default_options();
+    char* formatted = format_source(content, fmt_opts);
 
-    if (!uri) {
-        lsp_send_response(rid.str, rid.is_string, "[]");
+    if (!formatted || strcmp(content, formatted) == 0) {
+        /* No changes needed */
+        free(formatted);
+        free(content);
+        lsp_send_response(rid, "[]");
         return;
     }
+    free(content);
+
+    /* Return a single TextEdit replacing the entire document */
+    JsonBuf result = {0};
+    jb_printf(&result,
+        "[{\"range\":{\"start\":{\"line\":0,\"character\":0},"
+        "\"end\":{\"line\":%d,\"character\":0}},"
+        "\"newText\":", line_count);
+    jb_string(&result, formatted);
+    jb_append(&result, "}]");
+    free(formatted);
+
+    lsp_send_response(rid, result.data);
+    free(result.data);
+}
+
+/* ========================================================================
+ * Document sync
+ * ======================================================================== */
 
+static void handle_did_open(const JsonNode* msg) {
+    const char* uri = json_get_string(msg, "params.textDocument.uri");
+    const char* text = json_get_string(msg, "params.textDocument.text");
+    if (!uri || !text) return;
+
+    sage_mutex_lock(&g_docs_lock);
     Document* doc = doc_find(uri);
-    free(uri);
+    if (!doc) {
+        if (g_document_count >= MAX_DOCUMENTS) {
+            sage_mutex_unlock(&g_docs_lock);
+            lsp_log("Maximum open documents reached (%d)", MAX_DOCUMENTS);
+            return;
+        }
+        doc = &g_documents[g_document_count++];
+        doc->uri = strdup(uri);
+        doc->path = uri_to_path(uri);
+    }
+    doc->version = json_get_int(msg, "params.textDocument.version", 0);
+    doc_set_text(doc, text);
+    lsp_log("Opened: %s (%d lines)", uri, doc->line_count);
+    schedule_diagnostics((int)(doc - g_documents), 1);
+    sage_mutex_unlock(&g_docs_lock);
+}
 
-    if (!doc || !doc->content) {
-        lsp_send_response(rid.str, rid.is_string, "[]");
+static void handle_did_change(const JsonNode* msg) {
+    const char* uri = json_get_string(msg, "params.textDocument.uri");
+    const JsonNode* changes = json_get(msg, "params.contentChanges");
+    if (!uri || !changes || changes->type != JSON_ARRAY) return;
+
+    sage_mutex_lock(&g_docs_lock);
+    Document* doc = doc_find(uri);
+    if (!doc) {
+        sage_mutex_unlock(&g_docs_lock);
         return;
     }
+    doc->version = json_get_int(msg, "params.textDocument.version", doc->version + 1);
 
-    FormatOptions fmt_opts = format_default_options();
-    char* formatted = format_source(doc->content, fmt_opts);
+    for (const JsonNode* change = changes->child; change; change = change->next) {
+        const char* text = json_get_string(change, "text");
+        if (!text) continue;
+        if (!json_get(change, "range")) {
+            doc_set_text(doc, text);  /* Full sync */
+            continue;
+        }
+        size_t start = doc_offset(doc, json_get_int(change, "range.start.line", 0),
+                                  json_get_int(change, "range.start.character", 0));
+        size_t end = doc_offset(doc, json_get_int(change, "range.end.line", 0),
+                                json_get_int(change, "range.end.character", 0));
+        if (end < start) end = start;
+        doc_splice(doc, start, end, text);
+    }
+    g_metrics.edits++;
+    schedule_diagnostics((int)(doc - g_documents), 0);
+    sage_mutex_unlock(&g_docs_lock);
+}
 
-    if (!formatted || strcmp(doc->content, formatted) == 0) {
-        /* No changes needed */
-        free(formatted);
-        lsp_send_response(rid.str, rid.is_string, "[]");
-        return;
+static void handle_did_close(const JsonNode* msg) {
+    const char* uri = json_get_string(msg, "params.textDocument.uri");
+    if (!uri) return;
+
+    sage_mutex_lock(&g_docs_lock);
+    Document* doc = doc_find(uri);
+    char* path = NULL;
+    if (doc) {
+        path = doc->path ? strdup(doc->path) : NULL;
+        doc_clear(doc);
+        int index = (int)(doc - g_documents);
+        /* Move last element into this slot */
+        if (index < g_document_count - 1) {
+            g_documents[index] = g_documents[g_document_count - 1];
+            memset(&g_documents[g_document_count - 1], 0, sizeof(Document));
+        }
+        g_document_count--;
     }
 
-    /* Count lines in original content */
-    int line_count = 1;
-    for (const char* p = doc->content; *p; p++) {
-        if (*p == '\n') line_count++;
+    /* Publish empty diagnostics to clear them */
+    JsonBuf params = {0};
+    jb_append(&params, "{\"uri\":");
+    jb_string(&params, uri);
+    jb_append(&params, ",\"diagnostics\":[]}");
+    lsp_send_notification("textDocument/publishDiagnostics", params.data);
+    free(params.data);
+
+    /* Unsaved edits are gone; an indexed file goes back to its disk contents. */
+    int indexed = path && index_find_path(path);
+    sage_mutex_unlock(&g_docs_lock);
+
+    if (indexed) {
+        int n;
+        char* file_uri = path_to_uri(path);
+        Symbol* syms = index_scan_file(path, file_uri, &n);
+        sage_mutex_lock(&g_docs_lock);
+        index_store(path, file_uri, syms, n);
+        sage_mutex_unlock(&g_docs_lock);
     }
+    free(path);
+    lsp_log("Closed: %s", uri);
+}
 
-    /* Return a single TextEdit replacing the entire document */
-    char* esc_text = json_escape(formatted);
-    free(formatted);
+/* ========================================================================
+ * Metrics
+ * ======================================================================== */
 
-    size_t cap = strlen(esc_text) + 256;
-    char* result = SAGE_ALLOC(cap);
-    snprintf(result, cap,
-        "[{\"range\":{\"start\":{\"line\":0,\"character\":0},"
-        "\"end\":{\"line\":%d,\"character\":0}},"
-        "\"newText\":\"%s\"}]",
-        line_count, esc_text);
-    free(esc_text);
+static int compare_double(const void* a, const void* b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
 
-    lsp_send_response(rid.str, rid.is_string, result);
-    free(result);
+static void handle_metrics(RequestId rid) {
+    sage_mutex_lock(&g_docs_lock);
+    LspMetrics m = g_metrics;
+    int docs = g_document_count;
+    int files = g_index_count;
+    sage_mutex_unlock(&g_docs_lock);
+
+    int n = m.latency_count < 256 ? m.latency_count : 256;
+    double sorted[256];
+    memcpy(sorted, m.latency_ring, sizeof(double) * (size_t)n);
+    qsort(sorted, (size_t)n, sizeof(double), compare_double);
+    double p50 = n ? sorted[n / 2] : 0.0;
+    double p95 = n ? sorted[(n * 95) / 100 < n ? (n * 95) / 100 : n - 1] : 0.0;
+
+    JsonBuf result = {0};
+    jb_printf(&result,
+        "{\"documents\":%d,\"indexedFiles\":%d,\"edits\":%ld,\"publishes\":%ld,"
+        "\"debounceMs\":%d,\"chunksParsed\":%ld,\"chunksRelexed\":%ld,\"chunksReused\":%ld,"
+        "\"reparseMs\":%.3f,\"lintMs\":%.3f,"
+        "\"latencyMs\":{\"mean\":%.3f,\"p50\":%.3f,\"p95\":%.3f,\"max\":%.3f}}",
+        docs, files, m.edits, m.publishes, g_debounce_ms,
+        m.chunks_parsed, m.chunks_relexed, m.chunks_reused, m.reparse_ms, m.lint_ms,
+        m.publishes ? m.latency_ms_total / (double)m.publishes : 0.0, p50, p95, m.latency_ms_max);
+    lsp_send_response(rid, result.data);
+    free(result.data);
 }
 
 /* ========================================================================
  * Lifecycle handlers
  * ======================================================================== */
 
-static void handle_initialize(const char* json, RequestId rid) {
-    (void)json;
+static void handle_initialize(const JsonNode* msg, RequestId rid) {
+    const char* root_uri = json_get_string(msg, "params.rootUri");
+    const char* root_path = json_get_string(msg, "params.rootPath");
+    const JsonNode* folders = json_get(msg, "params.workspaceFolders");
+    if (!root_uri && folders && folders->type == JSON_ARRAY && folders->child) {
+        root_uri = json_get_string(folders->child, "uri");
+    }
+    char* root = root_uri ? uri_to_path(root_uri) : (root_path ? strdup(root_path) : NULL);
 
     const char* result =
         "{"
         "\"capabilities\":{"
             "\"textDocumentSync\":{"
                 "\"openClose\":true,"
-                "\"change\":1"  /* Full sync */
+                "\"change\":2"  /* Incremental */
             "},"
             "\"completionProvider\":{"
                 "\"triggerCharacters\":[\".\"]},"
             "\"hoverProvider\":true,"
+            "\"definitionProvider\":true,"
+            "\"documentSymbolProvider\":true,"
+            "\"workspaceSymbolProvider\":true,"
             "\"documentFormattingProvider\":true"
         "},"
         "\"serverInfo\":{"
@@ -843,8 +2075,48 @@ static void handle_initialize(const char* json, RequestId rid) {
         "}"
         "}";
 
-    lsp_send_response(rid.str, rid.is_string, result);
+    lsp_send_response(rid, result);
     lsp_log("Initialized");
+
+    if (root && *root) {
+        sage_mutex_lock(&g_docs_lock);
+        free(g_workspace_root);
+        g_workspace_root = root;
+        root = NULL;
+        if (g_worker_running) {
+            g_index_pending = 1;
+            sage_cond_signal(&g_docs_cond);
+            sage_mutex_unlock(&g_docs_lock);
+        } else {
+            sage_mutex_unlock(&g_docs_lock);
+            index_workspace(g_workspace_root);
+        }
+    }
+    free(root);
+}
+
+static void lsp_start_worker(void) {
+    const char* env = getenv("SAGE_LSP_DEBOUNCE_MS");
+    if (env && *env) {
+        g_debounce_ms = atoi(env);
+        if (g_debounce_ms < 0) g_debounce_ms = 0;
+    }
+    if (g_debounce_ms == 0) return;
+    if (sage_thread_create(&g_worker, diagnostics_worker, NULL) == 0) {
+        g_worker_running = 1;
+    } else {
+        lsp_log("No diagnostics thread; publishing synchronously");
+    }
+}
+
+static void lsp_stop_worker(void) {
+    if (!g_worker_running) return;
+    sage_mutex_lock(&g_docs_lock);
+    g_worker_stop = 1;
+    sage_cond_signal(&g_docs_cond);
+    sage_mutex_unlock(&g_docs_lock);
+    sage_thread_join(g_worker, NULL);
+    g_worker_running = 0;
 }
 
 /* ========================================================================
@@ -853,6 +2125,7 @@ static void handle_initialize(const char* json, RequestId rid) {
 
 void lsp_run(void) {
     lsp_log("Starting Sage Language Server...");
+    lsp_start_worker();
 
     int shutdown_requested = 0;
 
@@ -863,179 +2136,108 @@ void lsp_run(void) {
             break;
         }
 
-        char* method = json_get_string(body, "method");
+        JsonNode* msg = json_parse(body);
+        free(body);
+        const char* method = json_get_string(msg, "method");
         if (!method) {
-            /* Response or unknown message, ignore */
-            free(body);
+            /* Response, malformed or unknown message, ignore */
+            json_free(msg);
             continue;
         }
 
-        RequestId rid = extract_id(body);
+        RequestId rid = extract_id(msg);
 
         lsp_log("Received: %s", method);
 
         /* ---- Lifecycle ---- */
         if (strcmp(method, "initialize") == 0) {
-            handle_initialize(body, rid);
+            handle_initialize(msg, rid);
         }
         else if (strcmp(method, "initialized") == 0) {
             /* No-op notification */
         }
         else if (strcmp(method, "shutdown") == 0) {
             shutdown_requested = 1;
-            lsp_send_response(rid.str, rid.is_string, "null");
+            lsp_send_response(rid, "null");
             lsp_log("Shutdown requested");
         }
         else if (strcmp(method, "exit") == 0) {
-            free(method);
-            free(body);
+            json_free(msg);
             lsp_log("Exiting (code %d)", shutdown_requested ? 0 : 1);
             exit(shutdown_requested ? 0 : 1);
         }
 
         /* ---- Document sync ---- */
         else if (strcmp(method, "textDocument/didOpen") == 0) {
-            char* params = json_get_object(body, "params");
-            char* td = params ? json_get_object(params, "textDocument") : NULL;
-            char* uri = td ? json_get_string(td, "uri") : NULL;
-            char* text = td ? json_get_string(td, "text") : NULL;
-
-            if (uri && text) {
-                doc_open(uri, text);
-                lsp_log("Opened: %s", uri);
-                publish_diagnostics(uri, text);
-            }
-
-            free(uri);
-            free(text);
-            free(td);
-            free(params);
+            handle_did_open(msg);
         }
         else if (strcmp(method, "textDocument/didChange") == 0) {
-            char* params = json_get_object(body, "params");
-            char* td = params ? json_get_object(params, "textDocument") : NULL;
-            char* uri = td ? json_get_string(td, "uri") : NULL;
-
-            /* For full sync, the text is in contentChanges[0].text */
-            /* Simple extraction: find "contentChanges" then find "text" */
-            char* text = NULL;
-            if (params) {
-                const char* cc = strstr(params, "\"contentChanges\"");
-                if (cc) {
-                    /* Find the first "text" after contentChanges */
-                    const char* text_key = strstr(cc, "\"text\"");
-                    if (text_key) {
-                        text_key += 6; /* skip "text" */
-                        while (*text_key == ' ' || *text_key == '\t' ||
-                               *text_key == '\n' || *text_key == '\r' ||
-                               *text_key == ':') text_key++;
-                        if (*text_key == '"') {
-                            /* Extract the string value manually */
-                            text_key++;
-                            size_t cap = 4096;
-                            size_t len = 0;
-                            text = SAGE_ALLOC(cap);
-                            while (*text_key && *text_key != '"') {
-                                if (*text_key == '\\' && *(text_key+1)) {
-                                    text_key++;
-                                    switch (*text_key) {
-                                        case '"':  text[len++] = '"'; break;
-                                        case '\\': text[len++] = '\\'; break;
-                                        case 'n':  text[len++] = '\n'; break;
-                                        case 'r':  text[len++] = '\r'; break;
-                                        case 't':  text[len++] = '\t'; break;
-                                        default:   text[len++] = *text_key; break;
-                                    }
-                                } else {
-                                    text[len++] = *text_key;
-                                }
-                                text_key++;
-                                if (len + 2 >= cap) {
-                                    cap *= 2;
-                                    text = SAGE_REALLOC(text, cap);
-                                }
-                            }
-                            text[len] = '\0';
-                        }
-                    }
-                }
-            }
-
-            if (uri && text) {
-                doc_update(uri, text);
-                lsp_log("Changed: %s", uri);
-                publish_diagnostics(uri, text);
-            }
-
-            free(uri);
-            free(text);
-            free(td);
-            free(params);
+            handle_did_change(msg);
         }
         else if (strcmp(method, "textDocument/didClose") == 0) {
-            char* params = json_get_object(body, "params");
-            char* td = params ? json_get_object(params, "textDocument") : NULL;
-            char* uri = td ? json_get_string(td, "uri") : NULL;
-
-            if (uri) {
-                doc_close(uri);
-                lsp_log("Closed: %s", uri);
-                /* Publish empty diagnostics to clear them */
-                char* esc_uri = json_escape(uri);
-                size_t cap2 = strlen(esc_uri) + 64;
-                char* clear_params = SAGE_ALLOC(cap2);
-                snprintf(clear_params, cap2,
-                    "{\"uri\":\"%s\",\"diagnostics\":[]}", esc_uri);
-                lsp_send_notification("textDocument/publishDiagnostics", clear_params);
-                free(clear_params);
-                free(esc_uri);
-            }
-
-            free(uri);
-            free(td);
-            free(params);
+            handle_did_close(msg);
         }
 
         /* ---- Features ---- */
         else if (strcmp(method, "textDocument/completion") == 0) {
-            handle_completion(body, rid);
+            handle_completion(msg, rid);
         }
         else if (strcmp(method, "textDocument/hover") == 0) {
-            handle_hover(body, rid);
+            handle_hover(msg, rid);
+        }
+        else if (strcmp(method, "textDocument/definition") == 0) {
+            handle_definition(msg, rid);
+        }
+        else if (strcmp(method, "textDocument/documentSymbol") == 0) {
+            handle_symbols(msg, rid, 0);
+        }
+        else if (strcmp(method, "workspace/symbol") == 0) {
+            handle_symbols(msg, rid, 1);
         }
         else if (strcmp(method, "textDocument/formatting") == 0) {
-            handle_formatting(body, rid);
+            handle_formatting(msg, rid);
+        }
+        else if (strcmp(method, "sage/metrics") == 0) {
+            handle_metrics(rid);
         }
 
         /* ---- Unknown ---- */
         else {
             /* If it has an id, respond with MethodNotFound */
             if (rid.str[0] != '\0') {
-                size_t errcap = 256 + strlen(method);
-                char* errmsg = SAGE_ALLOC(errcap);
-                char* esc_method = json_escape(method);
-                snprintf(errmsg, errcap,
-                    "{\"jsonrpc\":\"2.0\",\"id\":%s%s%s,\"error\":"
-                    "{\"code\":-32601,\"message\":\"Method not found: %s\"}}",
-                    rid.is_string ? "\"" : "",
-                    rid.str,
-                    rid.is_string ? "\"" : "",
-                    esc_method);
-                free(esc_method);
-                lsp_send(errmsg);
-                free(errmsg);
+                JsonBuf err = {0};
+                jb_append(&err, "{\"jsonrpc\":\"2.0\",\"id\":");
+                jb_request_id(&err, rid);
+                jb_append(&err, ",\"error\":{\"code\":-32601,\"message\":");
+                JsonBuf text = {0};
+                jb_printf(&text, "Method not found: %s", method);
+                jb_string(&err, text.data);
+                free(text.data);
+                jb_append(&err, "}}");
+                lsp_send(err.data);
+                free(err.data);
             }
             lsp_log("Unhandled method: %s", method);
         }
 
-        free(method);
-        free(body);
+        json_free(msg);
     }
 
-    /* Cleanup documents */
+    lsp_stop_worker();
+
+    /* Cleanup documents and the index */
     for (int i = 0; i < g_document_count; i++) {
-        free(g_documents[i].uri);
-        free(g_documents[i].content);
+        doc_clear(&g_documents[i]);
     }
     g_document_count = 0;
+    for (int i = 0; i < g_index_count; i++) {
+        free(g_index[i].uri);
+        free(g_index[i].path);
+        symbols_free(g_index[i].symbols, g_index[i].symbol_count);
+    }
+    free(g_index);
+    g_index = NULL;
+    g_index_count = g_index_cap = 0;
+    free(g_workspace_root);
+    g_workspace_root = NULL;
 }
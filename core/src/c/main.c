@@ -39,6 +39,7 @@ extern Environment* g_global_env;
 extern Stmt* parse_program(const char* source, const char* input_path);
 
 #include "diagnostic.h"
+#include "profile.h"
 
 // Phase 12: REPL error recovery globals
 int g_repl_mode = 0;
@@ -47,6 +48,9 @@ jmp_buf g_repl_error_jmp;
 static Stmt* g_program_ast = NULL;
 static Stmt* g_program_ast_tail = NULL;
 static const char* g_math_work = NULL;
+static const char* g_profile_out = NULL;   // --profile-out=FILE
+static const char* g_profile_use = NULL;   // --profile-use=FILE
+static SageProfile* g_run_profile = NULL;
 
 static void retain_program_stmt(Stmt* stmt) {
     if (stmt == NULL) {
@@ -72,18 +76,20 @@ static void cleanup_runtime_state(void) {
 static void print_usage(FILE* stream) {
     fprintf(stream,
             "Usage: sage                    Start interactive REPL\n"
-            "       sage [--runtime ast|bytecode|jit|aot|auto] [--gc:arc|--gc:orc|--gc:tracing] [--math-work=grade,exec] [--verbose] [-I dir] [path]\n"
+            "       sage [--runtime ast|bytecode|jit|aot|auto] [--gc:arc|--gc:orc|--gc:tracing] [--math-work=grade,exec] [--verbose] [--timing] [-I dir] [path]\n"
             "       sage --repl             Start interactive REPL\n"
             "       sage [--runtime ast|bytecode|jit|aot|auto] [-I dir] -c \"source\"\n"
             "       sage --compile-to-lily <input.sage>\n"
             "       sage --compile-from-lily <input.lily>\n"
             "       sage --emit-c <input.sage> [-o output.c] [-I dir] [-O0..3] [-g]\n"
             "       sage --emit-vm <input.sage> [-o output.svm] [-I dir] [-O0..3] [-g]\n"
+            "       sage --emit-vm-text <input.sage> [-o output.svm] [-I dir] [-O0..3] [-g]\n"
             "       sage --sgvm <input.sage> [-o output.sgvm] [-I dir] [-O0..3] [-g]\n"
             "       sage --run-vm <input.svm>\n"
-            "       sage --compile <input.sage> [-o output] [--cc compiler] [-I dir] [-O0..3] [-g]\n"
+            "       sage --profile-out=<file.prof> <input.sage>  Run and record an execution profile\n"
+            "       sage --compile <input.sage> [-o output] [--cc compiler] [-j jobs] [--cache-dir dir] [-I dir] [-O0..3] [-g] [--profile-use=file.prof]\n"
             "       sage --emit-llvm <input.sage> [-o output.ll] [-I dir] [-O0..3] [-g]\n"
-            "       sage --compile-llvm <input.sage> [-o output] [-I dir] [-O0..3] [-g]\n"
+            "       sage --compile-llvm <input.sage> [-o output] [-I dir] [-O0..3] [-g] [--profile-use=file.prof]\n"
             "       sage --emit-asm <input.sage> [-o output.s] [--target arch[-baremetal|-osdev|-uefi]] [-I dir] [-O0..3] [-g]\n"
             "       sage --compile-native <input.sage> [-o output] [--target arch[-baremetal|-osdev|-uefi]] [-I dir] [-O0..3] [-g]\n"
             "       sage --compile-bare <input.sage> [-o output.elf] [--target arch] [-I dir] [-O0..3] [-g]\n"
@@ -93,7 +99,7 @@ static void print_usage(FILE* stream) {
             "       sage --emit-pico-c <input.sage> [-o output.c]\n"
             "       sage --compile-pico <input.sage> [-o output_dir] [--board board] [--name program] [--sdk path] [--chip chip]\n"
             "       sage --jit <input.sage>   Run with JIT profiling and compilation\n"
-            "       sage --aot <input.sage> [-o output]  AOT compile to native binary\n"
+            "       sage --aot <input.sage> [-o output] [--profile-use=file.prof]  AOT compile to native binary\n"
             "       sage --aot --jit <input.sage> [-o output]  Profile-guided AOT compilation\n"
             "       sage fmt <file>          Format a Sage source file in-place\n"
             "       sage fmt --check <file>  Check if file is already formatted\n"
@@ -208,6 +214,20 @@ static int parse_codegen_options(int argc, const char* argv[], int start_index,
             *opt_level = 3;
         } else if (strcmp(argv[i], "-g") == 0) {
             *debug_info = 1;
+        } else if (strcmp(argv[i], "-j") == 0) {
+            if (i + 1 >= argc || atoi(argv[i + 1]) <= 0) {
+                fprintf(stderr, "Expected a positive job count after -j.\n");
+                return 0;
+            }
+            g_compile_jobs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--cache-dir") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Missing directory after --cache-dir.\n");
+                return 0;
+            }
+            g_compile_cache_dir = argv[++i];
+        } else if (strncmp(argv[i], "--profile-use=", 14) == 0) {
+            g_profile_use = argv[i] + 14;
         } else if (strcmp(argv[i], "-I") == 0) {
             if (i + 1 >= argc) {
                 fprintf(stderr, "Missing directory after -I.\n");
@@ -428,6 +448,27 @@ static char* main_read_file(const char* path) {
     return buffer;
 }
 
+// --profile-out: record while the script runs in the AST interpreter and
+// write the profile at exit, so scripts that call exit() still leave one.
+static void profile_out_flush(void) {
+    if (g_run_profile == NULL) return;
+    interpreter_set_profile(NULL);
+    profile_write(g_run_profile, g_profile_out);
+    profile_free(g_run_profile);
+    g_run_profile = NULL;
+}
+
+static void profile_out_begin(const char* path, const char* source) {
+    g_run_profile = profile_new(path, source);
+    interpreter_set_profile(g_run_profile);
+    atexit(profile_out_flush);
+}
+
+// --profile-use: a profile recorded from other source is reported and ignored.
+static void profile_use_for(const char* path, const char* source) {
+    if (g_profile_use != NULL && source != NULL) profile_use(g_profile_use, path, source);
+}
+
 static char* try_main_read_file(const char* path) {
     FILE* file = fopen(path, "rb");
     if (file == NULL) {
@@ -1132,7 +1173,8 @@ static int compile_to_sgvm(const char* input_path, const char* output_path, int
     }
     close(fd);
 
-    if (!compile_source_to_vm_artifact(source, input_path, tmp_svm, opt_level, debug_info)) {
+    if (!compile_source_to_vm_artifact(source, input_path, tmp_svm, opt_level, debug_info,
+                                       BYTECODE_ARTIFACT_TEXT)) {
         free(source);
         unlink(tmp_svm);
         return 0;
@@ -2163,6 +2205,7 @@ static void run(const char* source, const char* filename, SageRuntimeMode runtim
     g_global_env = env;
     init_stdlib(env);
     set_math_work_env(env);
+    module_prefetch_source(global_module_cache, source, filename);
 
     while (1) {
          Stmt* result = parse();
@@ -2184,7 +2227,9 @@ static int jit_is_native_module(const char* name) {
                              "socket",  "tcp",       "http",      "ssl",
                              "fat",     "gpu",       "graphics",  "ml_native",
                              "compiler","vm_native", "vm",        "ffi",
-                             "net",     "string",    NULL};
+                             "net",     "string",    "_json",
+                             "_textindex",  "_vecindex", "_kvcache", "_bpe",
+                             NULL};
     for (int i = 0; natives[i] != NULL; i++) {
         if (strcmp(name, natives[i]) == 0) return 1;
     }
@@ -2569,10 +2614,25 @@ int main(int argc, const char* argv[]) {
             g_sage_verbose = 1;
             cmd_argv += 1;
             cmd_argc -= 1;
+        } else if (strcmp(cmd_argv[1], "--timing") == 0) {
+            if (!g_module_timing) {
+                g_module_timing = 1;
+                atexit(module_timing_report);
+            }
+            cmd_argv += 1;
+            cmd_argc -= 1;
         } else if (strncmp(cmd_argv[1], "--math-work=", 12) == 0) {
             g_math_work = cmd_argv[1] + 12;
             cmd_argv += 1;
             cmd_argc -= 1;
+        } else if (strncmp(cmd_argv[1], "--profile-out=", 14) == 0) {
+            g_profile_out = cmd_argv[1] + 14;
+            cmd_argv += 1;
+            cmd_argc -= 1;
+        } else if (strncmp(cmd_argv[1], "--profile-use=", 14) == 0) {
+            g_profile_use = cmd_argv[1] + 14;
+            cmd_argv += 1;
+            cmd_argc -= 1;
         } else {
             break;
         }
@@ -2647,6 +2707,7 @@ int main(int argc, const char* argv[]) {
         }
 
         char* source = main_read_file(cmd_argv[2]);
+        profile_use_for(cmd_argv[2], source);
         char* derived_output = NULL;
         const char* output_path = explicit_output;
         if (output_path == NULL) {
@@ -2663,7 +2724,10 @@ int main(int argc, const char* argv[]) {
         free(source);
         free(derived_output);
     } else if (cmd_argc >= 3 &&
-               (strcmp(cmd_argv[1], "--emit-vm") == 0 || strcmp(cmd_argv[1], "--emit-bytecode") == 0)) {
+               (strcmp(cmd_argv[1], "--emit-vm") == 0 || strcmp(cmd_argv[1], "--emit-bytecode") == 0 ||
+                strcmp(cmd_argv[1], "--emit-vm-text") == 0)) {
+        BytecodeArtifactFormat format = strcmp(cmd_argv[1], "--emit-vm-text") == 0
+                                            ? BYTECODE_ARTIFACT_TEXT : BYTECODE_ARTIFACT_BINARY;
         const char* explicit_output = NULL;
         const char* ignored_cc = NULL;
         const char* ignored_target = NULL;
@@ -2682,7 +2746,7 @@ int main(int argc, const char* argv[]) {
             output_path = derived_output;
         }
 
-        if (!compile_source_to_vm_artifact(source, cmd_argv[2], output_path, opt_level, debug_info)) {
+        if (!compile_source_to_vm_artifact(source, cmd_argv[2], output_path, opt_level, debug_info, format)) {
             free(source);
             free(derived_output);
             CLEANUP_AND_EXIT(1);
@@ -2824,6 +2888,7 @@ int main(int argc, const char* argv[]) {
         }
 
         char* source = main_read_file(cmd_argv[2]);
+        profile_use_for(cmd_argv[2], source);
         char* derived_output = NULL;
         const char* exe_output = explicit_output;
         if (exe_output == NULL) {
@@ -2864,6 +2929,7 @@ int main(int argc, const char* argv[]) {
         }
 
         char* source = main_read_file(cmd_argv[2]);
+        profile_use_for(cmd_argv[2], source);
         char* derived_output = NULL;
         const char* output_path = explicit_output;
         if (output_path == NULL) {
@@ -2891,6 +2957,7 @@ int main(int argc, const char* argv[]) {
         }
 
         char* source = main_read_file(cmd_argv[2]);
+        profile_use_for(cmd_argv[2], source);
         char* derived_output = NULL;
         const char* exe_output = explicit_output;
         if (exe_output == NULL) {
@@ -3504,9 +3571,11 @@ int main(int argc, const char* argv[]) {
 
         // Determine output path
         const char* out_path = NULL;
-        for (int i = 3; i < cmd_argc - 1; i++) {
-            if (strcmp(cmd_argv[i], "-o") == 0) out_path = cmd_argv[i + 1];
+        for (int i = 3; i < cmd_argc; i++) {
+            if (strcmp(cmd_argv[i], "-o") == 0 && i + 1 < cmd_argc) out_path = cmd_argv[i + 1];
+            else if (strncmp(cmd_argv[i], "--profile-use=", 14) == 0) g_profile_use = cmd_argv[i] + 14;
         }
+        profile_use_for(aot_file, source);
 
         AotCompiler aot;
         aot_init(&aot, 2); // -O2 default
@@ -3541,6 +3610,10 @@ int main(int argc, const char* argv[]) {
         } else {
             module_add_source_dir(cmd_argv[1]);  // Add source file's dir to search paths
             char* source = main_read_file(cmd_argv[1]);
+            if (g_profile_out != NULL) {
+                profile_out_begin(cmd_argv[1], source);
+                runtime_mode = SAGE_RUNTIME_AST;
+            }
             run(source, cmd_argv[1], runtime_mode);
             free(source);
         }
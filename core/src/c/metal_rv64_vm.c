@@ -70,26 +70,7 @@ static void metal_rv64_print_double(MetalRV64VM* vm, double d) {
 }
 
 static int metal_rv64_string_intern(MetalRV64VM* vm, const char* s, int len) {
-    int search = 0;
-    while (search < vm->string_used) {
-        const char* existing = &vm->strings[search];
-        int existing_len = (int)strlen(existing);
-        if (existing_len == len) {
-            int match = 1;
-            for (int i = 0; i < len; i++) {
-                if (existing[i] != s[i]) { match = 0; break; }
-            }
-            if (match) return search;
-        }
-        search += existing_len + 1;
-    }
-
-    if (vm->string_used + len + 1 > METAL_STRING_POOL) return -1;
-    int idx = vm->string_used;
-    memcpy(&vm->strings[idx], s, (unsigned long)len);
-    vm->strings[idx + len] = '\0';
-    vm->string_used += len + 1;
-    return idx;
+    return metal_pool_intern(vm->strings, &vm->string_used, &vm->string_index, s, len);
 }
 
 static const char* metal_rv64_string_get(MetalRV64VM* vm, int idx) {
@@ -132,7 +113,7 @@ static int metal_rv64_dict_new(MetalRV64VM* vm) {
     int max = (int)(sizeof(vm->dicts) / sizeof(vm->dicts[0]));
     if (vm->dict_count >= max) return -1;
     int idx = vm->dict_count++;
-    vm->dicts[idx].count = 0;
+    metal_dict_reset(&vm->dicts[idx]);
     vm->dicts[idx].in_use = 1;
     return idx;
 }
@@ -140,28 +121,13 @@ static int metal_rv64_dict_new(MetalRV64VM* vm) {
 static void metal_rv64_dict_set(MetalRV64VM* vm, int dict_idx, int key_str_idx, MetalValue val) {
     int max = (int)(sizeof(vm->dicts) / sizeof(vm->dicts[0]));
     if (dict_idx < 0 || dict_idx >= max) return;
-    MetalDict* d = &vm->dicts[dict_idx];
-    for (int i = 0; i < d->count; i++) {
-        if (d->key_str_idx[i] == key_str_idx) {
-            d->values[i] = val;
-            return;
-        }
-    }
-    if (d->count < METAL_DICT_MAX_ENTRIES) {
-        d->key_str_idx[d->count] = key_str_idx;
-        d->values[d->count] = val;
-        d->count++;
-    }
+    metal_dict_store(&vm->dicts[dict_idx], vm->heap, &vm->heap_used, key_str_idx, val);
 }
 
 static MetalValue metal_rv64_dict_get(MetalRV64VM* vm, int dict_idx, int key_str_idx) {
     int max = (int)(sizeof(vm->dicts) / sizeof(vm->dicts[0]));
     if (dict_idx < 0 || dict_idx >= max) return mv_nil();
-    MetalDict* d = &vm->dicts[dict_idx];
-    for (int i = 0; i < d->count; i++) {
-        if (d->key_str_idx[i] == key_str_idx) return d->values[i];
-    }
-    return mv_nil();
+    return metal_dict_lookup(&vm->dicts[dict_idx], vm->heap, key_str_idx);
 }
 
 static void metal_rv64_print_value(MetalRV64VM* vm, MetalValue value) {
@@ -201,7 +167,9 @@ static void metal_rv64_print_value(MetalRV64VM* vm, MetalValue value) {
 
 void metal_rv64_vm_init(MetalRV64VM* vm) {
     memset(vm, 0, sizeof(MetalRV64VM));
+    for (int i = 0; i < RV64_MAX_CHUNKS; i++) vm->chunk_uop_base[i] = -1;
     vm->global_dict_idx = metal_rv64_dict_new(vm);
+    vm->x[0] = mv_num(0.0);  // x0 reads as zero before any instruction runs
 }
 
 int metal_rv64_vm_load_binary(MetalRV64VM* vm, const unsigned char* data, int size) {
@@ -303,16 +271,14 @@ RV64Instruction rv64_decode(unsigned int raw) {
 // Execution Handlers
 // ============================================================================
 
-static void handle_branch(MetalRV64VM* vm, RV64Instruction inst) {
-    MetalValue rs1_val = vm->x[inst.rs1];
-    MetalValue rs2_val = vm->x[inst.rs2];
+static int rv64_branch_taken(MetalRV64VM* vm, int funct3, MetalValue rs1_val, MetalValue rs2_val) {
     int take = 0;
 
     // We do simple float/boolean comparisons based on type
     if (rs1_val.type == MV_NUM && rs2_val.type == MV_NUM) {
         double a = rs1_val.as.number;
         double b = rs2_val.as.number;
-        switch (inst.funct3) {
+        switch (funct3) {
             case RV_F3_BEQ: take = (a == b); break;
             case RV_F3_BNE: take = (a != b); break;
             case RV_F3_BLT: take = (a < b); break;
@@ -324,7 +290,7 @@ static void handle_branch(MetalRV64VM* vm, RV64Instruction inst) {
         const char* a = metal_rv64_string_get(vm, rs1_val.as.str_idx);
         const char* b = metal_rv64_string_get(vm, rs2_val.as.str_idx);
         int cmp = strcmp(a, b);
-        switch (inst.funct3) {
+        switch (funct3) {
             case RV_F3_BEQ: take = (cmp == 0); break;
             case RV_F3_BNE: take = (cmp != 0); break;
             case RV_F3_BLT: take = (cmp < 0); break;
@@ -333,23 +299,28 @@ static void handle_branch(MetalRV64VM* vm, RV64Instruction inst) {
     } else if (rs1_val.type == MV_BOOL && rs2_val.type == MV_BOOL) {
         int a = rs1_val.as.boolean;
         int b = rs2_val.as.boolean;
-        switch (inst.funct3) {
+        switch (funct3) {
             case RV_F3_BEQ: take = (a == b); break;
             case RV_F3_BNE: take = (a != b); break;
         }
     } else if (rs1_val.type == MV_NIL && rs2_val.type == MV_NIL) {
-        switch (inst.funct3) {
+        switch (funct3) {
             case RV_F3_BEQ: take = 1; break;
             case RV_F3_BNE: take = 0; break;
         }
     } else {
         // Mismatched or other types: only BEQ/BNE valid
-        switch (inst.funct3) {
+        switch (funct3) {
             case RV_F3_BEQ: take = 0; break;
             case RV_F3_BNE: take = 1; break;
         }
     }
 
+    return take;
+}
+
+static void handle_branch(MetalRV64VM* vm, RV64Instruction inst) {
+    int take = rv64_branch_taken(vm, inst.funct3, vm->x[inst.rs1], vm->x[inst.rs2]);
     if (take) {
         vm->pc += inst.imm_b;
     } else {
@@ -413,6 +384,29 @@ static void handle_imm(MetalRV64VM* vm, RV64Instruction inst) {
     vm->pc += 4;
 }
 
+// ADD on two strings concatenates; anything else adds as numbers
+static MetalValue rv64_add(MetalRV64VM* vm, MetalValue rs1_val, MetalValue rs2_val) {
+    if (rs1_val.type == MV_STR && rs2_val.type == MV_STR) {
+        const char* s1 = metal_rv64_string_get(vm, rs1_val.as.str_idx);
+        const char* s2 = metal_rv64_string_get(vm, rs2_val.as.str_idx);
+        int len1 = (int)strlen(s1);
+        int len2 = (int)strlen(s2);
+        char concat_buf[1024];
+        if (len1 + len2 < 1024) {
+            memcpy(concat_buf, s1, len1);
+            memcpy(concat_buf + len1, s2, len2);
+            int new_idx = metal_rv64_string_intern(vm, concat_buf, len1 + len2);
+            return (MetalValue){MV_STR, {.str_idx = new_idx}};
+        }
+        vm->error = 1;
+        vm->error_msg = "String concatenation buffer overflow";
+        return mv_nil();
+    }
+    double v1 = (rs1_val.type == MV_NUM) ? rs1_val.as.number : 0.0;
+    double v2 = (rs2_val.type == MV_NUM) ? rs2_val.as.number : 0.0;
+    return mv_num(v1 + v2);
+}
+
 static void handle_reg(MetalRV64VM* vm, RV64Instruction inst) {
     MetalValue rs1_val = vm->x[inst.rs1];
     MetalValue rs2_val = vm->x[inst.rs2];
@@ -453,24 +447,8 @@ static void handle_reg(MetalRV64VM* vm, RV64Instruction inst) {
                     vm->x[inst.rd] = rs1_val;
                 } else if (inst.rs1 == 0) {
                     vm->x[inst.rd] = rs2_val;
-                } else if (rs1_val.type == MV_STR && rs2_val.type == MV_STR) {
-                    const char* s1 = metal_rv64_string_get(vm, rs1_val.as.str_idx);
-                    const char* s2 = metal_rv64_string_get(vm, rs2_val.as.str_idx);
-                    int len1 = (int)strlen(s1);
-                    int len2 = (int)strlen(s2);
-                    char concat_buf[1024];
-                    if (len1 + len2 < 1024) {
-                        memcpy(concat_buf, s1, len1);
-                        memcpy(concat_buf + len1, s2, len2);
-                        int new_idx = metal_rv64_string_intern(vm, concat_buf, len1 + len2);
-                        vm->x[inst.rd] = (MetalValue){MV_STR, {.str_idx = new_idx}};
-                    } else {
-                        vm->error = 1;
-                        vm->error_msg = "String concatenation buffer overflow";
-                        vm->x[inst.rd] = mv_nil();
-                    }
                 } else {
-                    vm->x[inst.rd] = mv_num(v1 + v2);
+                    vm->x[inst.rd] = rv64_add(vm, rs1_val, rs2_val);
                 }
             }
             break;
@@ -713,9 +691,9 @@ static void handle_vmsys(MetalRV64VM* vm, RV64Instruction inst) {
                         metal_rv64_print_str(vm, " keys=[");
                         for (int k = 0; k < d->count; k++) {
                             if (k > 0) metal_rv64_print_str(vm, ", ");
-                            metal_rv64_print_str(vm, metal_rv64_string_get(vm, d->key_str_idx[k]));
+                            metal_rv64_print_str(vm, metal_rv64_string_get(vm, metal_dict_key_at(d, vm->heap, k)));
                             metal_rv64_print_str(vm, ":");
-                            metal_rv64_print_int(vm, d->values[k].type);
+                            metal_rv64_print_int(vm, metal_dict_value_at(d, vm->heap, k).type);
                         }
                         metal_rv64_print_str(vm, "]");
                     }
@@ -1004,11 +982,555 @@ int metal_rv64_vm_step(MetalRV64VM* vm) {
     return 1;
 }
 
+// ============================================================================
+// Pre-decoded Execution
+// ============================================================================
+// metal_rv64_vm_step above is the reference decoder. The run loop executes
+// the same instructions from micro-ops; anything the translation does not
+// cover (misaligned or out-of-chunk targets, trace mode, chunks too large
+// for the cache) falls back to a single step.
+
+enum {
+    RV64_UOP_UNDECODED = 0,     // Slot not reached yet: translate its block
+    RV64_UOP_EXIT,              // Single-step this instruction
+    RV64_UOP_ILLEGAL,
+    RV64_UOP_NOP,
+    RV64_UOP_MOV,               // ADDI/ORI/XORI 0, ANDI -1, ADD/SUB x0
+    RV64_UOP_NIL,               // Unimplemented funct3 writes nil
+    RV64_UOP_LUI,
+    RV64_UOP_AUIPC,
+    RV64_UOP_JUMP,              // JAL x0
+    RV64_UOP_JAL,
+    RV64_UOP_JALR,
+    RV64_UOP_RET,               // JALR x0, 0(x1)
+    RV64_UOP_BEQ,
+    RV64_UOP_BNE,
+    RV64_UOP_BLT,
+    RV64_UOP_BGE,
+    RV64_UOP_BLTU,
+    RV64_UOP_BGEU,
+    RV64_UOP_ADDI,
+    RV64_UOP_SLTI,
+    RV64_UOP_XORI,
+    RV64_UOP_ORI,
+    RV64_UOP_ANDI,
+    RV64_UOP_SLLI,
+    RV64_UOP_SRLI,
+    RV64_UOP_SRAI,
+    RV64_UOP_ADD,
+    RV64_UOP_SUB,
+    RV64_UOP_MUL,
+    RV64_UOP_DIV,
+    RV64_UOP_REM,
+    RV64_UOP_SLL,
+    RV64_UOP_SLT,
+    RV64_UOP_XOR,
+    RV64_UOP_SRL,
+    RV64_UOP_SRA,
+    RV64_UOP_OR,
+    RV64_UOP_AND,
+    RV64_UOP_LDC,
+    RV64_UOP_LOAD,
+    RV64_UOP_STORE,
+    RV64_UOP_VM_OPS,
+    RV64_UOP_OBJ_OPS,
+    RV64_UOP_COUNT
+};
+
+// Hosted builds box numbers inline; mv_num lives in metal_vm.c
+static inline MetalValue rv64_num(double v) {
+#ifdef SAGE_BARE_METAL
+    return mv_num(v);
+#else
+    MetalValue value;
+    value.type = MV_NUM;
+    value.as.number = v;
+    return value;
+#endif
+}
+
+static int rv64_uop_writes_rd(int kind) {
+    switch (kind) {
+        case RV64_UOP_MOV: case RV64_UOP_NIL: case RV64_UOP_LUI: case RV64_UOP_AUIPC:
+        case RV64_UOP_ADDI: case RV64_UOP_SLTI: case RV64_UOP_XORI: case RV64_UOP_ORI:
+        case RV64_UOP_ANDI: case RV64_UOP_SLLI: case RV64_UOP_SRLI: case RV64_UOP_SRAI:
+        case RV64_UOP_SUB: case RV64_UOP_MUL: case RV64_UOP_SLL: case RV64_UOP_SLT:
+        case RV64_UOP_XOR: case RV64_UOP_SRL: case RV64_UOP_SRA: case RV64_UOP_OR:
+        case RV64_UOP_AND:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+// Branch and jump targets become slot indices; a target outside the chunk
+// or off a word boundary is left to the stepping path
+static int rv64_target_slot(int pc, int offset, int slots) {
+    int target = pc + offset;
+    if (target < 0 || (target & 3) != 0 || target / 4 > slots) return -1;
+    return target / 4;
+}
+
+static void rv64_translate(RV64Instruction inst, int pc, int slots, RV64MicroOp* uop) {
+    uop->rd = (unsigned char)inst.rd;
+    uop->rs1 = (unsigned char)inst.rs1;
+    uop->rs2 = (unsigned char)inst.rs2;
+    uop->imm = inst.imm_i;
+
+    switch (inst.opcode) {
+        case RV_OP_LUI:
+            uop->kind = RV64_UOP_LUI;
+            uop->imm = inst.imm_u;
+            break;
+        case RV_OP_AUIPC:
+            uop->kind = RV64_UOP_AUIPC;
+            uop->imm = pc + inst.imm_u;
+            break;
+        case RV_OP_JAL:
+            uop->imm = rv64_target_slot(pc, inst.imm_j, slots);
+            uop->kind = inst.rd == 0 ? RV64_UOP_JUMP : RV64_UOP_JAL;
+            if (uop->imm < 0) uop->kind = RV64_UOP_EXIT;
+            break;
+        case RV_OP_JALR:
+            uop->kind = (inst.rd == 0 && inst.rs1 == 1 && inst.imm_i == 0) ? RV64_UOP_RET : RV64_UOP_JALR;
+            break;
+        case RV_OP_BRANCH: {
+            static const unsigned char branch_kinds[8] = {
+                RV64_UOP_BEQ, RV64_UOP_BNE, RV64_UOP_NOP, RV64_UOP_NOP,
+                RV64_UOP_BLT, RV64_UOP_BGE, RV64_UOP_BLTU, RV64_UOP_BGEU
+            };
+            uop->kind = branch_kinds[inst.funct3];
+            // funct3 2 and 3 never branch
+            if (uop->kind == RV64_UOP_NOP) break;
+            uop->imm = rv64_target_slot(pc, inst.imm_b, slots);
+            if (uop->imm < 0) uop->kind = RV64_UOP_EXIT;
+            break;
+        }
+        case RV_OP_IMM:
+            switch (inst.funct3) {
+                case RV_F3_ADD: uop->kind = inst.imm_i == 0 ? RV64_UOP_MOV : RV64_UOP_ADDI; break;
+                case RV_F3_SLT: uop->kind = RV64_UOP_SLTI; break;
+                case RV_F3_XOR: uop->kind = inst.imm_i == 0 ? RV64_UOP_MOV : RV64_UOP_XORI; break;
+                case RV_F3_OR:  uop->kind = inst.imm_i == 0 ? RV64_UOP_MOV : RV64_UOP_ORI; break;
+                case RV_F3_AND: uop->kind = inst.imm_i == -1 ? RV64_UOP_MOV : RV64_UOP_ANDI; break;
+                case RV_F3_SLL: uop->kind = RV64_UOP_SLLI; uop->imm = inst.imm_i & 0x3F; break;
+                case RV_F3_SRL:
+                    uop->kind = inst.funct7 == 0x20 ? RV64_UOP_SRAI : RV64_UOP_SRLI;
+                    uop->imm = inst.imm_i & 0x3F;
+                    break;
+                default:        uop->kind = RV64_UOP_NIL; break;
+            }
+            break;
+        case RV_OP_REG:
+            if (inst.funct7 == 0x01) {
+                switch (inst.funct3) {
+                    case RV_F3_ADD: uop->kind = RV64_UOP_MUL; break;
+                    case RV_F3_XOR: uop->kind = RV64_UOP_DIV; break;
+                    case RV_F3_OR:  uop->kind = RV64_UOP_REM; break;
+                    default:        uop->kind = RV64_UOP_NIL; break;
+                }
+                break;
+            }
+            switch (inst.funct3) {
+                case RV_F3_ADD:
+                    if (inst.rs2 == 0) {
+                        uop->kind = RV64_UOP_MOV;
+                    } else if (inst.funct7 == 0x20) {
+                        uop->kind = RV64_UOP_SUB;
+                    } else if (inst.rs1 == 0) {
+                        uop->kind = RV64_UOP_MOV;
+                        uop->rs1 = (unsigned char)inst.rs2;
+                    } else {
+                        uop->kind = RV64_UOP_ADD;
+                    }
+                    break;
+                case RV_F3_SLL: uop->kind = RV64_UOP_SLL; break;
+                case RV_F3_SLT: uop->kind = RV64_UOP_SLT; break;
+                case RV_F3_XOR: uop->kind = RV64_UOP_XOR; break;
+                case RV_F3_SRL: uop->kind = inst.funct7 == 0x20 ? RV64_UOP_SRA : RV64_UOP_SRL; break;
+                case RV_F3_OR:  uop->kind = RV64_UOP_OR; break;
+                case RV_F3_AND: uop->kind = RV64_UOP_AND; break;
+                default:        uop->kind = RV64_UOP_NIL; break;
+            }
+            break;
+        case RV_OP_LDC:
+            uop->kind = RV64_UOP_LDC;
+            uop->imm = (inst.imm_u >> 12) & 0xFFFFF;
+            break;
+        case RV_OP_LOAD:
+            uop->kind = RV64_UOP_LOAD;
+            break;
+        case RV_OP_STORE:
+            uop->kind = RV64_UOP_STORE;
+            uop->imm = inst.imm_s;
+            break;
+        case RV_OP_VMSYS:
+            // GPU ops only print in trace mode, which never runs translated code
+            if (inst.funct3 == RV_F3_VM_OPS) uop->kind = RV64_UOP_VM_OPS;
+            else if (inst.funct3 == RV_F3_OBJ_OPS) uop->kind = RV64_UOP_OBJ_OPS;
+            else uop->kind = RV64_UOP_NOP;
+            break;
+        default:
+            uop->kind = RV64_UOP_ILLEGAL;
+            break;
+    }
+
+    // Results written to x0 are discarded, so those instructions do nothing
+    if (uop->rd == 0 && rv64_uop_writes_rd(uop->kind)) uop->kind = RV64_UOP_NOP;
+}
+
+static int rv64_uop_ends_block(int kind) {
+    return (kind >= RV64_UOP_JUMP && kind <= RV64_UOP_BGEU) ||
+           kind == RV64_UOP_VM_OPS || kind == RV64_UOP_EXIT || kind == RV64_UOP_ILLEGAL;
+}
+
+// Translate the basic block starting at slot, up to its first control transfer
+static void rv64_translate_block(MetalRV64VM* vm, RV64MicroOp* ops, int slot, const void* const* handlers) {
+    int slots = vm->bytecode_length / 4;
+    const unsigned char* code = vm->bytecode;
+    for (; slot < slots && ops[slot].kind == RV64_UOP_UNDECODED; slot++) {
+        int pc = slot * 4;
+        unsigned int raw = code[pc] | (code[pc + 1] << 8) | (code[pc + 2] << 16) | ((unsigned int)code[pc + 3] << 24);
+        RV64MicroOp* uop = &ops[slot];
+        rv64_translate(rv64_decode(raw), pc, slots, uop);
+        if (handlers) uop->handler = handlers[uop->kind];
+        if (rv64_uop_ends_block(uop->kind)) break;
+    }
+}
+
+// Micro-ops for the current chunk, allocating its slots on first entry.
+// The extra slot past the end makes running off the chunk a single step,
+// which stops the VM. NULL keeps the chunk on the stepping path.
+static RV64MicroOp* rv64_chunk_ops(MetalRV64VM* vm, const void* const* handlers) {
+    int chunk = vm->current_chunk_idx;
+    if (chunk < 0 || chunk >= vm->chunk_count || vm->bytecode != vm->chunks[chunk] ||
+        vm->bytecode_length != vm->chunk_lengths[chunk]) {
+        return (RV64MicroOp*)0;
+    }
+
+    int base = vm->chunk_uop_base[chunk];
+    if (base < 0) {
+        int slots = vm->bytecode_length / 4 + 1;
+        if (slots > RV64_UOP_CACHE_SIZE) return (RV64MicroOp*)0;
+        if (vm->uop_used + slots > RV64_UOP_CACHE_SIZE) metal_rv64_vm_invalidate(vm, -1);
+        base = vm->uop_used;
+        vm->uop_used += slots;
+        vm->chunk_uop_base[chunk] = base;
+        for (int i = 0; i < slots; i++) {
+            RV64MicroOp* uop = &vm->uops[base + i];
+            uop->kind = (i == slots - 1) ? RV64_UOP_EXIT : RV64_UOP_UNDECODED;
+            uop->handler = handlers ? handlers[uop->kind] : (const void*)0;
+        }
+    }
+    return &vm->uops[base];
+}
+
+void metal_rv64_vm_invalidate(MetalRV64VM* vm, int chunk_idx) {
+    if (chunk_idx >= 0) {
+        // The chunk's old slots are reclaimed by the next full flush
+        if (chunk_idx < RV64_MAX_CHUNKS) vm->chunk_uop_base[chunk_idx] = -1;
+        return;
+    }
+    for (int i = 0; i < RV64_MAX_CHUNKS; i++) vm->chunk_uop_base[i] = -1;
+    vm->uop_used = 0;
+}
+
+// Run translated code until the VM stops (returns 0) or reaches an
+// instruction that has to be single-stepped at vm->pc (returns 1)
+static int rv64_execute(MetalRV64VM* vm) {
+    MetalValue* x = vm->x;
+    MetalValue* stack = vm->stack;
+    RV64MicroOp* ops;
+    const RV64MicroOp* op;
+    int slots;
+
+#ifdef __GNUC__
+    static const void* const handlers[RV64_UOP_COUNT] = {
+        [RV64_UOP_UNDECODED] = &&uop_UNDECODED, [RV64_UOP_EXIT] = &&uop_EXIT,
+        [RV64_UOP_ILLEGAL] = &&uop_ILLEGAL, [RV64_UOP_NOP] = &&uop_NOP,
+        [RV64_UOP_MOV] = &&uop_MOV, [RV64_UOP_NIL] = &&uop_NIL,
+        [RV64_UOP_LUI] = &&uop_LUI, [RV64_UOP_AUIPC] = &&uop_AUIPC,
+        [RV64_UOP_JUMP] = &&uop_JUMP, [RV64_UOP_JAL] = &&uop_JAL,
+        [RV64_UOP_JALR] = &&uop_JALR, [RV64_UOP_RET] = &&uop_RET,
+        [RV64_UOP_BEQ] = &&uop_BEQ, [RV64_UOP_BNE] = &&uop_BNE,
+        [RV64_UOP_BLT] = &&uop_BLT, [RV64_UOP_BGE] = &&uop_BGE,
+        [RV64_UOP_BLTU] = &&uop_BLTU, [RV64_UOP_BGEU] = &&uop_BGEU,
+        [RV64_UOP_ADDI] = &&uop_ADDI, [RV64_UOP_SLTI] = &&uop_SLTI,
+        [RV64_UOP_XORI] = &&uop_XORI, [RV64_UOP_ORI] = &&uop_ORI,
+        [RV64_UOP_ANDI] = &&uop_ANDI, [RV64_UOP_SLLI] = &&uop_SLLI,
+        [RV64_UOP_SRLI] = &&uop_SRLI, [RV64_UOP_SRAI] = &&uop_SRAI,
+        [RV64_UOP_ADD] = &&uop_ADD, [RV64_UOP_SUB] = &&uop_SUB,
+        [RV64_UOP_MUL] = &&uop_MUL, [RV64_UOP_DIV] = &&uop_DIV,
+        [RV64_UOP_REM] = &&uop_REM, [RV64_UOP_SLL] = &&uop_SLL,
+        [RV64_UOP_SLT] = &&uop_SLT, [RV64_UOP_XOR] = &&uop_XOR,
+        [RV64_UOP_SRL] = &&uop_SRL, [RV64_UOP_SRA] = &&uop_SRA,
+        [RV64_UOP_OR] = &&uop_OR, [RV64_UOP_AND] = &&uop_AND,
+        [RV64_UOP_LDC] = &&uop_LDC, [RV64_UOP_LOAD] = &&uop_LOAD,
+        [RV64_UOP_STORE] = &&uop_STORE, [RV64_UOP_VM_OPS] = &&uop_VM_OPS,
+        [RV64_UOP_OBJ_OPS] = &&uop_OBJ_OPS
+    };
+    #define UOP(name) uop_##name
+    #define DISPATCH() goto *op->handler
+#else
+    static const void* const* const handlers = (const void* const*)0;
+    #define UOP(name) case RV64_UOP_##name
+    #define DISPATCH() goto dispatch
+#endif
+
+#define NEXT() do { op++; DISPATCH(); } while (0)
+#define JUMP_TO(slot) do { op = ops + (slot); DISPATCH(); } while (0)
+#define SLOT_PC() ((int)(op - ops) * 4)
+#define NUM(r) (x[r].type == MV_NUM ? x[r].as.number : 0.0)
+// Ops that may still write x0 restore it, as the stepping path does
+#define ZERO_X0() (x[0] = rv64_num(0.0))
+#define BRANCH(cond, funct3) \
+    do { \
+        MetalValue a = x[op->rs1], b = x[op->rs2]; \
+        int take = (a.type == MV_NUM && b.type == MV_NUM) \
+            ? (cond) : rv64_branch_taken(vm, (funct3), a, b); \
+        if (take) JUMP_TO(op->imm); \
+        NEXT(); \
+    } while (0)
+
+reload:
+    if (!vm->running || vm->halted || vm->error) return 0;
+    ZERO_X0();  // Translated MOVs read x0; the host may have written it
+    ops = rv64_chunk_ops(vm, handlers);
+    slots = vm->bytecode_length / 4;
+    if (!ops || vm->pc < 0 || (vm->pc & 3) != 0 || vm->pc / 4 > slots) return 1;
+    op = ops + vm->pc / 4;
+
+#ifdef __GNUC__
+    DISPATCH();
+#else
+dispatch:
+    switch (op->kind) {
+#endif
+        UOP(UNDECODED):
+            rv64_translate_block(vm, ops, (int)(op - ops), handlers);
+            DISPATCH();
+        UOP(EXIT):
+            vm->pc = SLOT_PC();
+            return 1;
+        UOP(ILLEGAL):
+            vm->pc = SLOT_PC();
+            vm->error = 1;
+            vm->error_msg = "Unknown RISC-V opcode";
+            vm->running = 0;
+            return 0;
+        UOP(NOP):
+            NEXT();
+        UOP(MOV):
+            x[op->rd] = x[op->rs1];
+            NEXT();
+        UOP(NIL):
+            x[op->rd] = mv_nil();
+            NEXT();
+        UOP(LUI):
+        UOP(AUIPC):
+            x[op->rd] = rv64_num((double)op->imm);
+            NEXT();
+        UOP(JUMP):
+            JUMP_TO(op->imm);
+        UOP(JAL):
+            x[op->rd] = rv64_num((double)(SLOT_PC() + 4));
+            JUMP_TO(op->imm);
+        UOP(JALR): {
+            int target = ((int)NUM(op->rs1) + op->imm) & ~1;
+            x[op->rd] = rv64_num((double)(SLOT_PC() + 4));
+            ZERO_X0();
+            vm->pc = target;
+            if (target < 0 || (target & 3) != 0 || target / 4 > slots) return 1;
+            JUMP_TO(target / 4);
+        }
+        UOP(RET):
+            vm->pc = SLOT_PC();
+            if (vm->csp == 0) {
+                vm->running = 0;
+                vm->halted = 1;
+                return 0;
+            }
+            vm->csp--;
+            vm->current_chunk_idx = vm->call_stack[vm->csp].chunk_idx;
+            vm->bytecode = vm->chunks[vm->current_chunk_idx];
+            vm->bytecode_length = vm->chunk_lengths[vm->current_chunk_idx];
+            vm->pc = vm->call_stack[vm->csp].return_pc;
+            x[1] = vm->call_stack[vm->csp].saved_ra;
+            if (vm->call_stack[vm->csp].is_constructor) {
+                x[10] = vm->call_stack[vm->csp].constructor_instance;
+            }
+            goto reload;
+        UOP(BEQ):  BRANCH(a.as.number == b.as.number, RV_F3_BEQ);
+        UOP(BNE):  BRANCH(a.as.number != b.as.number, RV_F3_BNE);
+        UOP(BLT):  BRANCH(a.as.number < b.as.number, RV_F3_BLT);
+        UOP(BGE):  BRANCH(a.as.number >= b.as.number, RV_F3_BGE);
+        UOP(BLTU): BRANCH((unsigned long long)a.as.number < (unsigned long long)b.as.number, RV_F3_BLTU);
+        UOP(BGEU): BRANCH((unsigned long long)a.as.number >= (unsigned long long)b.as.number, RV_F3_BGEU);
+        UOP(ADDI):
+            x[op->rd] = rv64_num(NUM(op->rs1) + op->imm);
+            NEXT();
+        UOP(SLTI):
+            x[op->rd] = mv_bool(NUM(op->rs1) < op->imm);
+            NEXT();
+        UOP(XORI):
+            x[op->rd] = rv64_num((double)((long long)NUM(op->rs1) ^ op->imm));
+            NEXT();
+        UOP(ORI):
+            x[op->rd] = rv64_num((double)((long long)NUM(op->rs1) | op->imm));
+            NEXT();
+        UOP(ANDI):
+            x[op->rd] = rv64_num((double)((long long)NUM(op->rs1) & op->imm));
+            NEXT();
+        UOP(SLLI):
+            x[op->rd] = rv64_num((double)((long long)NUM(op->rs1) << op->imm));
+            NEXT();
+        UOP(SRLI):
+            x[op->rd] = rv64_num((double)((unsigned long long)NUM(op->rs1) >> op->imm));
+            NEXT();
+        UOP(SRAI):
+            x[op->rd] = rv64_num((double)((long long)NUM(op->rs1) >> op->imm));
+            NEXT();
+        UOP(ADD): {
+            MetalValue a = x[op->rs1], b = x[op->rs2];
+            if (a.type == MV_NUM && b.type == MV_NUM) {
+                x[op->rd] = rv64_num(a.as.number + b.as.number);
+                ZERO_X0();
+                NEXT();
+            }
+            x[op->rd] = rv64_add(vm, a, b);
+            ZERO_X0();
+            if (vm->error) { vm->pc = SLOT_PC() + 4; return 0; }
+            NEXT();
+        }
+        UOP(SUB):
+            x[op->rd] = rv64_num(NUM(op->rs1) - NUM(op->rs2));
+            NEXT();
+        UOP(MUL):
+            x[op->rd] = rv64_num(NUM(op->rs1) * NUM(op->rs2));
+            NEXT();
+        UOP(DIV):
+        UOP(REM): {
+            double v1 = NUM(op->rs1), v2 = NUM(op->rs2);
+            if (v2 == 0.0) {
+                x[op->rd] = rv64_num(0);
+                ZERO_X0();
+                vm->pc = SLOT_PC() + 4;
+                vm->error = 1;
+                vm->error_msg = op->kind == RV64_UOP_DIV ? "division by zero" : "modulo by zero";
+                return 0;
+            }
+            x[op->rd] = rv64_num(op->kind == RV64_UOP_DIV
+                ? (double)((long long)v1 / (long long)v2)
+                : (double)((long long)v1 % (long long)v2));
+            ZERO_X0();
+            NEXT();
+        }
+        UOP(SLL):
+            x[op->rd] = rv64_num((double)((long long)NUM(op->rs1) << ((int)NUM(op->rs2) & 0x3F)));
+            NEXT();
+        UOP(SLT): {
+            MetalValue a = x[op->rs1], b = x[op->rs2];
+            if (a.type == MV_STR && b.type == MV_STR) {
+                x[op->rd] = mv_bool(strcmp(metal_rv64_string_get(vm, a.as.str_idx),
+                                           metal_rv64_string_get(vm, b.as.str_idx)) < 0);
+            } else {
+                x[op->rd] = mv_bool(NUM(op->rs1) < NUM(op->rs2));
+            }
+            NEXT();
+        }
+        UOP(XOR):
+            x[op->rd] = rv64_num((double)((long long)NUM(op->rs1) ^ (long long)NUM(op->rs2)));
+            NEXT();
+        UOP(SRL):
+            x[op->rd] = rv64_num((double)((unsigned long long)NUM(op->rs1) >> ((int)NUM(op->rs2) & 0x3F)));
+            NEXT();
+        UOP(SRA):
+            x[op->rd] = rv64_num((double)((long long)NUM(op->rs1) >> ((int)NUM(op->rs2) & 0x3F)));
+            NEXT();
+        UOP(OR):
+            x[op->rd] = rv64_num((double)((long long)NUM(op->rs1) | (long long)NUM(op->rs2)));
+            NEXT();
+        UOP(AND):
+            x[op->rd] = rv64_num((double)((long long)NUM(op->rs1) & (long long)NUM(op->rs2)));
+            NEXT();
+        UOP(LDC):
+            if (op->imm < vm->const_count) {
+                x[op->rd] = vm->constants[op->imm];
+                ZERO_X0();
+                NEXT();
+            }
+            x[op->rd] = mv_nil();
+            ZERO_X0();
+            vm->pc = SLOT_PC() + 4;
+            vm->error = 1;
+            vm->error_msg = "Constant pool access violation";
+            return 0;
+        UOP(LOAD): {
+            int addr = (x[op->rs1].type == MV_NUM ? (int)x[op->rs1].as.number : 0) + op->imm;
+            if (addr >= 0 && addr < RV64_STACK_SIZE) {
+                x[op->rd] = stack[addr];
+                ZERO_X0();
+                NEXT();
+            }
+            x[op->rd] = mv_nil();
+            ZERO_X0();
+            vm->pc = SLOT_PC() + 4;
+            vm->error = 1;
+            vm->error_msg = "Load access violation";
+            return 0;
+        }
+        UOP(STORE): {
+            int addr = (x[op->rs1].type == MV_NUM ? (int)x[op->rs1].as.number : 0) + op->imm;
+            if (addr >= 0 && addr < RV64_STACK_SIZE) {
+                stack[addr] = x[op->rs2];
+                NEXT();
+            }
+            vm->pc = SLOT_PC() + 4;
+            vm->error = 1;
+            vm->error_msg = "Store access violation";
+            return 0;
+        }
+        UOP(VM_OPS):
+        UOP(OBJ_OPS): {
+            RV64Instruction inst;
+            memset(&inst, 0, sizeof(inst));
+            inst.opcode = RV_OP_VMSYS;
+            inst.funct3 = op->kind == RV64_UOP_VM_OPS ? RV_F3_VM_OPS : RV_F3_OBJ_OPS;
+            inst.rd = op->rd;
+            inst.rs1 = op->rs1;
+            inst.rs2 = op->rs2;
+            inst.imm_i = op->imm;
+            vm->pc = SLOT_PC();
+            handle_vmsys(vm, inst);
+            ZERO_X0();
+            // Calls, returns from raise and halts change chunk or stop the VM
+            if (op->kind == RV64_UOP_VM_OPS || vm->error) goto reload;
+            NEXT();
+        }
+#ifndef __GNUC__
+        default:
+            break;
+    }
+#endif
+    return 0;
+
+#undef UOP
+#undef DISPATCH
+#undef NEXT
+#undef JUMP_TO
+#undef SLOT_PC
+#undef NUM
+#undef ZERO_X0
+#undef BRANCH
+}
+
 int metal_rv64_vm_run(MetalRV64VM* vm) {
     vm->running = 1;
     vm->halted = 0;
-    while (vm->running && metal_rv64_vm_step(vm)) {
-        // Execution loop
+    while (vm->running) {
+        // Tracing prints every fetch, so it stays on the stepping path
+        if (!vm->trace && !rv64_execute(vm)) break;
+        if (!metal_rv64_vm_step(vm)) break;
     }
     return vm->error ? -1 : 0;
 }
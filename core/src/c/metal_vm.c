@@ -109,7 +109,7 @@ MetalValue mv_num(double val) {
 }
 
 MetalValue mv_bool(int val) {
-    MetalValue v; v.type = MV_BOOL; v.as.boolean = val ? 1 : 0; return v;
+    MetalValue v; v.type = MV_BOOL; v.as.number = 0; v.as.boolean = val ? 1 : 0; return v;
 }
 
 MetalValue mv_str(MetalVM* vm, const char* s, int len) {
@@ -302,6 +302,138 @@ int metal_vm_add_constant(MetalVM* vm, MetalValue value) {
     return vm->const_count++;
 }
 
+// ============================================================================
+// Dict Storage
+// ============================================================================
+// Entries past the inline ones, and the hash index, are blocks in the VM's
+// bump heap. Blocks are referenced by offset so the VM struct can be copied.
+
+typedef struct {
+    MetalValue value;
+    int        key_str_idx;
+} MetalDictSlot;
+
+static int metal_heap_alloc(unsigned char* heap, int* heap_used, int bytes) {
+    // Align the address: the heap array itself may sit on any byte boundary
+    unsigned long addr = (unsigned long)(heap + *heap_used);
+    int offset = *heap_used + (int)((8 - (addr & 7)) & 7);
+    if (offset + bytes > METAL_HEAP_SIZE) return -1;
+    *heap_used = offset + bytes;
+    return offset;
+}
+
+static unsigned int metal_key_hash(int key_str_idx) {
+    unsigned int h = (unsigned int)key_str_idx * 2654435769u;
+    return h ^ (h >> 16);
+}
+
+void metal_dict_reset(MetalDict* d) {
+    d->count = 0;
+    d->spill = -1;
+    d->spill_cap = 0;
+    d->index = -1;
+    d->index_mask = 0;
+}
+
+int metal_dict_key_at(const MetalDict* d, const unsigned char* heap, int i) {
+    if (i < METAL_DICT_MAX_ENTRIES) return d->key_str_idx[i];
+    return ((const MetalDictSlot*)(heap + d->spill))[i - METAL_DICT_MAX_ENTRIES].key_str_idx;
+}
+
+MetalValue metal_dict_value_at(const MetalDict* d, const unsigned char* heap, int i) {
+    if (i < METAL_DICT_MAX_ENTRIES) return d->values[i];
+    return ((const MetalDictSlot*)(heap + d->spill))[i - METAL_DICT_MAX_ENTRIES].value;
+}
+
+// Position of key in d, or -1
+static int metal_dict_find(const MetalDict* d, const unsigned char* heap, int key_str_idx) {
+    if (d->index < 0) {
+        for (int i = 0; i < d->count; i++) {
+            if (metal_dict_key_at(d, heap, i) == key_str_idx) return i;
+        }
+        return -1;
+    }
+    const int* slots = (const int*)(heap + d->index);
+    unsigned int pos = metal_key_hash(key_str_idx) & (unsigned int)d->index_mask;
+    for (;;) {
+        int entry = slots[pos] - 1;
+        if (entry < 0) return -1;
+        if (metal_dict_key_at(d, heap, entry) == key_str_idx) return entry;
+        pos = (pos + 1) & (unsigned int)d->index_mask;
+    }
+}
+
+// Build an index with room for `entries` keys at 3/4 load. On heap
+// exhaustion the old index (or linear search) stays in use.
+static void metal_dict_reindex(MetalDict* d, unsigned char* heap, int* heap_used, int entries) {
+    int size = 16;
+    while (size * 3 < entries * 4) size *= 2;
+    int offset = metal_heap_alloc(heap, heap_used, size * (int)sizeof(int));
+    if (offset < 0) return;
+    int* slots = (int*)(heap + offset);
+    for (int i = 0; i < size; i++) slots[i] = 0;
+    for (int i = 0; i < d->count; i++) {
+        unsigned int pos = metal_key_hash(metal_dict_key_at(d, heap, i)) & (unsigned int)(size - 1);
+        while (slots[pos] != 0) pos = (pos + 1) & (unsigned int)(size - 1);
+        slots[pos] = i + 1;
+    }
+    d->index = offset;
+    d->index_mask = size - 1;
+}
+
+MetalValue metal_dict_lookup(const MetalDict* d, const unsigned char* heap, int key_str_idx) {
+    int i = metal_dict_find(d, heap, key_str_idx);
+    return i < 0 ? mv_nil() : metal_dict_value_at(d, heap, i);
+}
+
+int metal_dict_store(MetalDict* d, unsigned char* heap, int* heap_used, int key_str_idx, MetalValue val) {
+    int i = metal_dict_find(d, heap, key_str_idx);
+    if (i >= 0) {
+        if (i < METAL_DICT_MAX_ENTRIES) d->values[i] = val;
+        else ((MetalDictSlot*)(heap + d->spill))[i - METAL_DICT_MAX_ENTRIES].value = val;
+        return 1;
+    }
+
+    i = d->count;
+    if (i < METAL_DICT_MAX_ENTRIES) {
+        d->key_str_idx[i] = key_str_idx;
+        d->values[i] = val;
+    } else {
+        int spilled = i - METAL_DICT_MAX_ENTRIES;
+        if (spilled == d->spill_cap) {
+            // Grow by doubling; the old block is reclaimed by metal_vm_gc
+            int cap = d->spill_cap ? d->spill_cap * 2 : METAL_DICT_MAX_ENTRIES;
+            int offset = metal_heap_alloc(heap, heap_used, cap * (int)sizeof(MetalDictSlot));
+            if (offset < 0) return 0;
+            MetalDictSlot* grown = (MetalDictSlot*)(heap + offset);
+            for (int j = 0; j < spilled; j++) grown[j] = ((MetalDictSlot*)(heap + d->spill))[j];
+            d->spill = offset;
+            d->spill_cap = cap;
+        }
+        MetalDictSlot* slot = &((MetalDictSlot*)(heap + d->spill))[spilled];
+        slot->key_str_idx = key_str_idx;
+        slot->value = val;
+    }
+    d->count++;
+
+    int old_index = d->index;
+    if (d->count >= METAL_DICT_INDEX_MIN && (d->index < 0 || d->count * 4 > (d->index_mask + 1) * 3)) {
+        metal_dict_reindex(d, heap, heap_used, d->count * 2);
+    }
+    if (d->index >= 0 && d->index == old_index) {
+        // Not rebuilt: add the key, keeping one empty slot so probes end
+        if (d->count > d->index_mask) {
+            d->index = -1;
+            return 1;
+        }
+        int* slots = (int*)(heap + d->index);
+        unsigned int pos = metal_key_hash(key_str_idx) & (unsigned int)d->index_mask;
+        while (slots[pos] != 0) pos = (pos + 1) & (unsigned int)d->index_mask;
+        slots[pos] = d->count;
+    }
+    return 1;
+}
+
 // ============================================================================
 // Dict Pool
 // ============================================================================
@@ -324,13 +456,46 @@ static void metal_mark_value(MetalVM* vm, MetalValue val, unsigned char* marked_
             marked_dicts[idx] = 1;
             MetalDict* d = &vm->dicts[idx];
             for (int i = 0; i < d->count; i++) {
-                metal_mark_value(vm, d->values[i], marked_arrays, marked_dicts);
+                metal_mark_value(vm, metal_dict_value_at(d, vm->heap, i), marked_arrays, marked_dicts);
             }
         }
     }
 }
 
-void metal_vm_gc(MetalVM* vm) {
+// Slide the heap blocks of live dicts down over those of swept dicts and
+// outgrown spill/index blocks. Blocks are taken in address order, lowest
+// first, so every move is downward; no scratch memory is needed.
+static void metal_heap_compact(MetalVM* vm) {
+    int used = 0;
+    int last = -1;
+    for (;;) {
+        int* ref = (int*)0;
+        int bytes = 0;
+        for (int i = 0; i < vm->dict_count; i++) {
+            MetalDict* d = &vm->dicts[i];
+            if (!d->in_use) continue;
+            if (d->spill > last && (!ref || d->spill < *ref)) {
+                ref = &d->spill;
+                bytes = d->spill_cap * (int)sizeof(MetalDictSlot);
+            }
+            if (d->index > last && (!ref || d->index < *ref)) {
+                ref = &d->index;
+                bytes = (d->index_mask + 1) * (int)sizeof(int);
+            }
+        }
+        if (!ref) break;
+
+        last = *ref;
+        int offset = metal_heap_alloc(vm->heap, &used, bytes);
+        for (int b = 0; b < bytes; b++) vm->heap[offset + b] = vm->heap[last + b];
+        *ref = offset;
+    }
+    vm->heap_used = used;
+}
+
+// Mark-sweep over the pools. `extra` holds values the caller has popped
+// but still needs, such as the dict and value of a store in progress.
+static void metal_vm_collect(MetalVM* vm, const MetalValue* extra, int extra_count) {
     int max_arr = (int)(sizeof(vm->arrays) / sizeof(vm->arrays[0]));
     int max_dict = (int)(sizeof(vm->dicts) / sizeof(vm->dicts[0]));
     
@@ -358,6 +523,11 @@ void metal_vm_gc(MetalVM* vm) {
     for (int i = 0; i < vm->const_count; i++) {
         metal_mark_value(vm, vm->constants[i], marked_arrays, marked_dicts);
     }
+
+    // 5. Mark caller-held values
+    for (int i = 0; i < extra_count; i++) {
+        metal_mark_value(vm, extra[i], marked_arrays, marked_dicts);
+    }
     
     // Sweep arrays
     for (int i = 0; i < max_arr; i++) {
@@ -371,9 +541,15 @@ void metal_vm_gc(MetalVM* vm) {
     for (int i = 0; i < max_dict; i++) {
         if (!marked_dicts[i]) {
             vm->dicts[i].in_use = 0;
-            vm->dicts[i].count = 0;
+            metal_dict_reset(&vm->dicts[i]);
         }
     }
+
+    metal_heap_compact(vm);
+}
+
+void metal_vm_gc(MetalVM* vm) {
+    metal_vm_collect(vm, (const MetalValue*)0, 0);
 }
 
 int metal_dict_new(MetalVM* vm) {
@@ -382,7 +558,7 @@ int metal_dict_new(MetalVM* vm) {
     // Search for unused slot
     for (int i = 0; i < vm->dict_count; i++) {
         if (!vm->dicts[i].in_use) {
-            vm->dicts[i].count = 0;
+            metal_dict_reset(&vm->dicts[i]);
             vm->dicts[i].in_use = 1;
             return i;
         }
@@ -390,7 +566,7 @@ int metal_dict_new(MetalVM* vm) {
     
     if (vm->dict_count < max) {
         int idx = vm->dict_count++;
-        vm->dicts[idx].count = 0;
+        metal_dict_reset(&vm->dicts[idx]);
         vm->dicts[idx].in_use = 1;
         return idx;
     }
@@ -400,7 +576,7 @@ int metal_dict_new(MetalVM* vm) {
     
     for (int i = 0; i < vm->dict_count; i++) {
         if (!vm->dicts[i].in_use) {
-            vm->dicts[i].count = 0;
+            metal_dict_reset(&vm->dicts[i]);
             vm->dicts[i].in_use = 1;
             return i;
         }
@@ -412,28 +588,20 @@ int metal_dict_new(MetalVM* vm) {
 void metal_dict_set(MetalVM* vm, int dict_idx, int key_str_idx, MetalValue val) {
     if (dict_idx < 0 || dict_idx >= vm->dict_count) return;
     MetalDict* d = &vm->dicts[dict_idx];
-    // Update existing
-    for (int i = 0; i < d->count; i++) {
-        if (d->key_str_idx[i] == key_str_idx) {
-            d->values[i] = val;
-            return;
-        }
-    }
-    // Add new
-    if (d->count < METAL_DICT_MAX_ENTRIES) {
-        d->key_str_idx[d->count] = key_str_idx;
-        d->values[d->count] = val;
-        d->count++;
+    if (!metal_dict_store(d, vm->heap, &vm->heap_used, key_str_idx, val)) {
+        // Out of heap: collect dead dicts, compact, and retry once
+        MetalValue held[2];
+        held[0].type = MV_DICT;
+        held[0].as.dict_idx = dict_idx;
+        held[1] = val;
+        metal_vm_collect(vm, held, 2);
+        metal_dict_store(d, vm->heap, &vm->heap_used, key_str_idx, val);
     }
 }
 
 MetalValue metal_dict_get(MetalVM* vm, int dict_idx, int key_str_idx) {
     if (dict_idx < 0 || dict_idx >= vm->dict_count) return mv_nil();
-    MetalDict* d = &vm->dicts[dict_idx];
-    for (int i = 0; i < d->count; i++) {
-        if (d->key_str_idx[i] == key_str_idx) return d->values[i];
-    }
-    return mv_nil();
+    return metal_dict_lookup(&vm->dicts[dict_idx], vm->heap, key_str_idx);
 }
 
 // ============================================================================
@@ -465,31 +633,52 @@ MetalValue metal_vm_peek(MetalVM* vm, int distance) {
 // String Pool (bump allocator)
 // ============================================================================
 
-int metal_string_intern(MetalVM* vm, const char* s, int len) {
+// Does the pool string at idx equal s[0..len)?
+static int metal_pool_match(const char* strings, int idx, const char* s, int len) {
+    const char* existing = &strings[idx];
+    for (int i = 0; i < len; i++) {
+        if (existing[i] != s[i]) return 0;
+    }
+    return existing[len] == '\0';
+}
+
+int metal_pool_intern(char* strings, int* used, MetalStringIndex* index, const char* s, int len) {
     // Check if already interned
-    int search = 0;
-    while (search < vm->string_used) {
-        const char* existing = &vm->strings[search];
-        int existing_len = (int)strlen(existing);
-        if (existing_len == len) {
-            int match = 1;
-            for (int i = 0; i < len; i++) {
-                if (existing[i] != s[i]) { match = 0; break; }
-            }
-            if (match) return search;
+    unsigned int mask = METAL_STRING_INDEX - 1;
+    unsigned int pos = fnv1a_hash(s, len) & mask;
+    while (index->slots[pos] != 0) {
+        int idx = index->slots[pos] - 1;
+        if (metal_pool_match(strings, idx, s, len)) return idx;
+        pos = (pos + 1) & mask;
+    }
+    int indexed = index->count * 4 < METAL_STRING_INDEX * 3;
+    if (!indexed) {
+        // Index full: strings added since then are only in the pool
+        int search = 0;
+        while (search < *used) {
+            int existing_len = (int)strlen(&strings[search]);
+            if (existing_len == len && metal_pool_match(strings, search, s, len)) return search;
+            search += existing_len + 1;
         }
-        search += existing_len + 1;
     }
 
     // Allocate new
-    if (vm->string_used + len + 1 > METAL_STRING_POOL) return -1;
-    int idx = vm->string_used;
-    memcpy(&vm->strings[idx], s, (unsigned long)len);
-    vm->strings[idx + len] = '\0';
-    vm->string_used += len + 1;
+    if (*used + len + 1 > METAL_STRING_POOL) return -1;
+    int idx = *used;
+    memcpy(&strings[idx], s, (unsigned long)len);
+    strings[idx + len] = '\0';
+    *used += len + 1;
+    if (indexed) {
+        index->slots[pos] = idx + 1;
+        index->count++;
+    }
     return idx;
 }
 
+int metal_string_intern(MetalVM* vm, const char* s, int len) {
+    return metal_pool_intern(vm->strings, &vm->string_used, &vm->string_index, s, len);
+}
+
 const char* metal_string_get(MetalVM* vm, int idx) {
     if (idx < 0 || idx >= vm->string_used) return "";
     return &vm->strings[idx];
@@ -1095,7 +1284,8 @@ int metal_vm_step(MetalVM* vm) {
             if (cls.type == MV_DICT && parent.type == MV_DICT) {
                 MetalDict* pd = &vm->dicts[parent.as.dict_idx];
                 for (int i = 0; i < pd->count; i++) {
-                    metal_dict_set(vm, cls.as.dict_idx, pd->key_str_idx[i], pd->values[i]);
+                    metal_dict_set(vm, cls.as.dict_idx, metal_dict_key_at(pd, vm->heap, i),
+                                   metal_dict_value_at(pd, vm->heap, i));
                 }
             }
             metal_vm_push(vm, cls);
@@ -1316,8 +1506,524 @@ int metal_vm_step(MetalVM* vm) {
     return 1; // Continue execution
 }
 
+// ============================================================================
+// Threaded Execution
+// ============================================================================
+// metal_vm_step is the reference interpreter. metal_vm_run executes the same
+// bytecode from pre-decoded ops: computed goto when the compiler supports it
+// (direct threading), a switch on the op kind otherwise or with
+// -DMETAL_VM_TOKEN_THREADED. Anything the fast path does not cover (calls,
+// objects, strings, errors, stack limits) is handed to metal_vm_step.
+
+#if defined(__GNUC__) && !defined(METAL_VM_TOKEN_THREADED)
+#define METAL_DIRECT_THREADED 1
+#endif
+
+enum {
+    MT_UNDECODED = 0,           // Slot not reached yet: translate its block
+    MT_EXIT,                    // Single-step this instruction
+    MT_CONSTANT,
+    MT_NIL,
+    MT_TRUE,
+    MT_FALSE,
+    MT_POP,
+    MT_DUP,
+    MT_DEFINE_GLOBAL,
+    MT_GET_GLOBAL,
+    MT_SET_GLOBAL,
+    MT_ADD,
+    MT_SUB,
+    MT_MUL,
+    MT_DIV,
+    MT_NEGATE,
+    MT_EQUAL,
+    MT_NOT_EQUAL,
+    MT_GREATER,
+    MT_GREATER_EQUAL,
+    MT_LESS,
+    MT_LESS_EQUAL,
+    MT_NOT,
+    MT_JUMP,
+    MT_JUMP_IF_FALSE,
+    MT_LOOP_BACK,
+    MT_GET_INDEX,
+    // Superinstructions
+    MT_GLOBAL_CONSTANT,         // GET_GLOBAL x; CONSTANT k
+    MT_GLOBAL_ADD_SET,          // GET_GLOBAL x; CONSTANT k; ADD; SET_GLOBAL x
+    MT_ADD_CONSTANT,            // CONSTANT k; ADD
+    MT_SUB_CONSTANT,            // CONSTANT k; SUB
+    MT_MUL_CONSTANT,            // CONSTANT k; MUL
+    MT_EQUAL_JF,                // <compare>; JUMP_IF_FALSE t
+    MT_NOT_EQUAL_JF,
+    MT_GREATER_JF,
+    MT_GREATER_EQUAL_JF,
+    MT_LESS_JF,
+    MT_LESS_EQUAL_JF,
+    MT_COUNT
+};
+
+#ifdef SAGE_BARE_METAL
+#define metal_num mv_num
+#else
+static inline MetalValue metal_num(double v) {
+    MetalValue value;
+    value.type = MV_NUM;
+    value.as.number = v;
+    return value;
+}
+#endif
+
+static inline MetalValue metal_bool(int v) {
+    MetalValue value;
+    value.type = MV_BOOL;
+    value.as.number = 0;
+    value.as.boolean = v;
+    return value;
+}
+
+// Innermost scope slot bound to hash, as scope_lookup and scope_assign find it
+static MetalValue* scope_slot(MetalVM* vm, unsigned int hash) {
+    for (int d = vm->scope_depth; d >= 0; d--) {
+        MetalScope* s = &vm->scopes[d];
+        for (int i = 0; i < s->count; i++) {
+            if (s->name_hash[i] == (int)hash) return &s->values[i];
+        }
+    }
+    return (MetalValue*)0;
+}
+
+static int thread_u16(const unsigned char* code, int pos) {
+    return (code[pos] << 8) | code[pos + 1];
+}
+
+// Pre-hash the global name referenced by the operand at pos
+static int thread_name_hash(MetalVM* vm, const unsigned char* code, int pos, int* hash) {
+    int idx = thread_u16(code, pos);
+    if (idx >= vm->const_count || vm->constants[idx].type != MV_STR) return 0;
+    const char* name = metal_string_get(vm, vm->constants[idx].as.str_idx);
+    *hash = (int)fnv1a_hash(name, (int)strlen(name));
+    return 1;
+}
+
+static int thread_constant(MetalVM* vm, const unsigned char* code, int pos, int len, int* idx) {
+    if (pos + 3 > len || code[pos] != OP_CONSTANT) return 0;
+    *idx = thread_u16(code, pos + 1);
+    return *idx < vm->const_count;
+}
+
+// Decode the instruction at pos, fusing it with its successors when they
+// form a superinstruction. Offset len is the end of the code buffer.
+static void thread_translate(MetalVM* vm, const unsigned char* code, int pos, int len, MetalThreadOp* op) {
+    int k;
+    op->kind = MT_EXIT;
+    op->next = pos + 1;
+    switch (code[pos]) {
+        case OP_NIL:    op->kind = MT_NIL; break;
+        case OP_TRUE:   op->kind = MT_TRUE; break;
+        case OP_FALSE:  op->kind = MT_FALSE; break;
+        case OP_POP:    op->kind = MT_POP; break;
+        case OP_DUP:    op->kind = MT_DUP; break;
+        case OP_ADD:    op->kind = MT_ADD; break;
+        case OP_SUB:    op->kind = MT_SUB; break;
+        case OP_MUL:    op->kind = MT_MUL; break;
+        case OP_DIV:    op->kind = MT_DIV; break;
+        case OP_NEGATE: op->kind = MT_NEGATE; break;
+        case OP_NOT:    op->kind = MT_NOT; break;
+        case OP_GET_INDEX: op->kind = MT_GET_INDEX; break;
+
+        case OP_EQUAL:
+        case OP_NOT_EQUAL:
+        case OP_GREATER:
+        case OP_GREATER_EQUAL:
+        case OP_LESS:
+        case OP_LESS_EQUAL: {
+            static const unsigned char plain[] = {
+                MT_EQUAL, MT_NOT_EQUAL, MT_GREATER, MT_GREATER_EQUAL, MT_LESS, MT_LESS_EQUAL
+            };
+            int which = code[pos] - OP_EQUAL;
+            op->kind = plain[which];
+            if (pos + 4 <= len && code[pos + 1] == OP_JUMP_IF_FALSE) {
+                int target = thread_u16(code, pos + 2);
+                if (target <= len) {
+                    op->kind = (unsigned char)(MT_EQUAL_JF + which);
+                    op->a = target;
+                    op->next = pos + 4;
+                }
+            }
+            break;
+        }
+
+        case OP_CONSTANT:
+            if (!thread_constant(vm, code, pos, len, &op->a)) break;
+            op->kind = MT_CONSTANT;
+            op->next = pos + 3;
+            if (pos + 3 < len) {
+                switch (code[pos + 3]) {
+                    case OP_ADD: op->kind = MT_ADD_CONSTANT; op->next = pos + 4; break;
+                    case OP_SUB: op->kind = MT_SUB_CONSTANT; op->next = pos + 4; break;
+                    case OP_MUL: op->kind = MT_MUL_CONSTANT; op->next = pos + 4; break;
+                    default: break;
+                }
+            }
+            break;
+
+        case OP_GET_GLOBAL:
+            if (pos + 3 > len || !thread_name_hash(vm, code, pos + 1, &op->a)) break;
+            op->kind = MT_GET_GLOBAL;
+            op->next = pos + 3;
+            if (!thread_constant(vm, code, pos + 3, len, &k)) break;
+            op->kind = MT_GLOBAL_CONSTANT;
+            op->b = k;
+            op->next = pos + 6;
+            if (pos + 10 <= len && code[pos + 6] == OP_ADD && code[pos + 7] == OP_SET_GLOBAL &&
+                thread_u16(code, pos + 8) == thread_u16(code, pos + 1)) {
+                op->kind = MT_GLOBAL_ADD_SET;
+                op->next = pos + 10;
+            }
+            break;
+
+        case OP_SET_GLOBAL:
+        case OP_DEFINE_GLOBAL:
+            if (pos + 3 > len || !thread_name_hash(vm, code, pos + 1, &op->a)) break;
+            op->kind = code[pos] == OP_SET_GLOBAL ? MT_SET_GLOBAL : MT_DEFINE_GLOBAL;
+            op->next = pos + 3;
+            break;
+
+        case OP_JUMP:
+        case OP_JUMP_IF_FALSE:
+            if (pos + 3 > len) break;
+            op->a = thread_u16(code, pos + 1);
+            if (op->a > len) break;
+            op->kind = code[pos] == OP_JUMP ? MT_JUMP : MT_JUMP_IF_FALSE;
+            op->next = pos + 3;
+            break;
+
+        case OP_LOOP_BACK:
+            if (pos + 3 > len) break;
+            op->a = pos + 3 - thread_u16(code, pos + 1);
+            if (op->a < 0) break;
+            op->kind = MT_LOOP_BACK;
+            op->next = pos + 3;
+            break;
+
+        default:
+            break;
+    }
+}
+
+static int thread_ends_block(int kind) {
+    return kind == MT_EXIT || kind == MT_JUMP || kind == MT_JUMP_IF_FALSE ||
+           kind == MT_LOOP_BACK || (kind >= MT_EQUAL_JF && kind <= MT_LESS_EQUAL_JF);
+}
+
+// Translate the basic block starting at pos, up to its first control transfer
+static void thread_translate_block(MetalVM* vm, const unsigned char* code, MetalThreadOp* ops,
+                                   int pos, int len, const void* const* handlers) {
+    while (pos < len && ops[pos].kind == MT_UNDECODED) {
+        MetalThreadOp* op = &ops[pos];
+        thread_translate(vm, code, pos, len, op);
+        if (handlers) op->handler = handlers[op->kind];
+        if (thread_ends_block(op->kind)) break;
+        pos = op->next;
+    }
+}
+
+// Pre-decoded slots for the current code buffer, allocating them on first
+// entry. The extra slot past the end makes running off the buffer a single
+// step, which stops the VM. NULL keeps the buffer on the stepping path.
+static MetalThreadOp* thread_code_ops(MetalVM* vm, int* length, const void* const* handlers) {
+    for (int i = 0; i < vm->thread_region_count; i++) {
+        if (vm->thread_regions[i].code != vm->code) continue;
+        if (vm->code_length <= vm->thread_regions[i].length) {
+            *length = vm->thread_regions[i].length;
+            return &vm->thread_ops[vm->thread_regions[i].base];
+        }
+        // Reloaded with a longer length: decode the buffer again
+        metal_vm_invalidate(vm);
+        break;
+    }
+
+    // Functions run inside chunk 0 with their own length; cover the whole chunk
+    int len = vm->code_length;
+    for (int c = 0; c < vm->chunk_count; c++) {
+        if (vm->chunks[c] == vm->code && vm->chunk_lengths[c] > len) len = vm->chunk_lengths[c];
+    }
+    if (len + 1 > METAL_THREAD_CACHE) return (MetalThreadOp*)0;
+    if (vm->thread_used + len + 1 > METAL_THREAD_CACHE ||
+        vm->thread_region_count >= METAL_THREAD_REGIONS) {
+        metal_vm_invalidate(vm);
+    }
+
+    int base = vm->thread_used;
+    vm->thread_used += len + 1;
+    vm->thread_regions[vm->thread_region_count].code = vm->code;
+    vm->thread_regions[vm->thread_region_count].length = len;
+    vm->thread_regions[vm->thread_region_count].base = base;
+    vm->thread_region_count++;
+    for (int i = 0; i <= len; i++) {
+        MetalThreadOp* op = &vm->thread_ops[base + i];
+        op->kind = i == len ? MT_EXIT : MT_UNDECODED;
+        op->handler = handlers ? handlers[op->kind] : (const void*)0;
+    }
+    *length = len;
+    return &vm->thread_ops[base];
+}
+
+void metal_vm_invalidate(MetalVM* vm) {
+    vm->thread_used = 0;
+    vm->thread_region_count = 0;
+}
+
+// Run pre-decoded ops until the VM stops (returns 0) or reaches an
+// instruction that has to be single-stepped at vm->ip (returns 1)
+static int metal_vm_execute(MetalVM* vm) {
+    MetalValue* stack = vm->stack;
+    const unsigned char* code;
+    MetalThreadOp* ops;
+    const MetalThreadOp* op;
+    const MetalThreadOp* end;
+    int sp, len;
+
+#ifdef METAL_DIRECT_THREADED
+    static const void* const handlers[MT_COUNT] = {
+        [MT_UNDECODED] = &&mt_UNDECODED, [MT_EXIT] = &&mt_EXIT,
+        [MT_CONSTANT] = &&mt_CONSTANT, [MT_NIL] = &&mt_NIL,
+        [MT_TRUE] = &&mt_TRUE, [MT_FALSE] = &&mt_FALSE,
+        [MT_POP] = &&mt_POP, [MT_DUP] = &&mt_DUP,
+        [MT_DEFINE_GLOBAL] = &&mt_DEFINE_GLOBAL, [MT_GET_GLOBAL] = &&mt_GET_GLOBAL,
+        [MT_SET_GLOBAL] = &&mt_SET_GLOBAL, [MT_ADD] = &&mt_ADD,
+        [MT_SUB] = &&mt_SUB, [MT_MUL] = &&mt_MUL,
+        [MT_DIV] = &&mt_DIV, [MT_NEGATE] = &&mt_NEGATE,
+        [MT_EQUAL] = &&mt_EQUAL, [MT_NOT_EQUAL] = &&mt_NOT_EQUAL,
+        [MT_GREATER] = &&mt_GREATER, [MT_GREATER_EQUAL] = &&mt_GREATER_EQUAL,
+        [MT_LESS] = &&mt_LESS, [MT_LESS_EQUAL] = &&mt_LESS_EQUAL,
+        [MT_NOT] = &&mt_NOT, [MT_JUMP] = &&mt_JUMP,
+        [MT_JUMP_IF_FALSE] = &&mt_JUMP_IF_FALSE, [MT_LOOP_BACK] = &&mt_LOOP_BACK,
+        [MT_GET_INDEX] = &&mt_GET_INDEX,
+        [MT_GLOBAL_CONSTANT] = &&mt_GLOBAL_CONSTANT, [MT_GLOBAL_ADD_SET] = &&mt_GLOBAL_ADD_SET,
+        [MT_ADD_CONSTANT] = &&mt_ADD_CONSTANT, [MT_SUB_CONSTANT] = &&mt_SUB_CONSTANT,
+        [MT_MUL_CONSTANT] = &&mt_MUL_CONSTANT,
+        [MT_EQUAL_JF] = &&mt_EQUAL_JF, [MT_NOT_EQUAL_JF] = &&mt_NOT_EQUAL_JF,
+        [MT_GREATER_JF] = &&mt_GREATER_JF, [MT_GREATER_EQUAL_JF] = &&mt_GREATER_EQUAL_JF,
+        [MT_LESS_JF] = &&mt_LESS_JF, [MT_LESS_EQUAL_JF] = &&mt_LESS_EQUAL_JF
+    };
+    #define MT(name) mt_##name
+    #define DISPATCH() do { if (op >= end) goto step; goto *op->handler; } while (0)
+#else
+    static const void* const* const handlers = (const void* const*)0;
+    #define MT(name) case MT_##name
+    #define DISPATCH() goto dispatch
+#endif
+
+#define NEXT() do { op = ops + op->next; DISPATCH(); } while (0)
+#define JUMP_TO(target) do { op = ops + (target); DISPATCH(); } while (0)
+// Leave stack underflow and overflow to the stepping path, which reports them
+#define NEED(pops, pushes) \
+    do { if (sp < (pops) || sp - (pops) + (pushes) > METAL_STACK_SIZE) goto step; } while (0)
+// A superinstruction must not run past the end of the current frame
+#define FUSED() do { if (ops + op->next > end) goto step; } while (0)
+#define BOTH_NUM(a, b) ((a).type == MV_NUM && (b).type == MV_NUM)
+#define COMPARE(cond) \
+    do { \
+        NEED(2, 1); \
+        MetalValue a = stack[sp - 2], b = stack[sp - 1]; \
+        if (!BOTH_NUM(a, b)) goto step; \
+        sp--; \
+        stack[sp - 1] = metal_bool(cond); \
+        NEXT(); \
+    } while (0)
+#define COMPARE_JF(cond) \
+    do { \
+        FUSED(); \
+        NEED(2, 0); \
+        MetalValue a = stack[sp - 2], b = stack[sp - 1]; \
+        if (!BOTH_NUM(a, b)) goto step; \
+        sp -= 2; \
+        if (!(cond)) JUMP_TO(op->a); \
+        NEXT(); \
+    } while (0)
+#define ARITH(expr) \
+    do { \
+        NEED(2, 1); \
+        MetalValue a = stack[sp - 2], b = stack[sp - 1]; \
+        if (!BOTH_NUM(a, b)) goto step; \
+        sp--; \
+        stack[sp - 1] = metal_num(expr); \
+        NEXT(); \
+    } while (0)
+#define ARITH_CONSTANT(expr) \
+    do { \
+        FUSED(); \
+        NEED(1, 1); \
+        MetalValue a = stack[sp - 1], b = vm->constants[op->a]; \
+        if (!BOTH_NUM(a, b)) goto step; \
+        stack[sp - 1] = metal_num(expr); \
+        NEXT(); \
+    } while (0)
+
+    if (vm->halted || vm->error) return 0;
+    ops = thread_code_ops(vm, &len, handlers);
+    if (!ops || vm->ip < 0 || vm->ip >= vm->code_length) return 1;
+    code = vm->code;
+    end = ops + vm->code_length;
+    sp = vm->sp;
+    op = ops + vm->ip;
+
+#ifdef METAL_DIRECT_THREADED
+    DISPATCH();
+#else
+dispatch:
+    if (op >= end) goto step;
+    switch (op->kind) {
+#endif
+        MT(UNDECODED):
+            thread_translate_block(vm, code, ops, (int)(op - ops), len, handlers);
+            DISPATCH();
+        MT(EXIT):
+            goto step;
+
+        MT(CONSTANT):
+            NEED(0, 1);
+            stack[sp++] = vm->constants[op->a];
+            NEXT();
+        MT(NIL):
+            NEED(0, 1);
+            stack[sp++] = mv_nil();
+            NEXT();
+        MT(TRUE):
+            NEED(0, 1);
+            stack[sp++] = metal_bool(1);
+            NEXT();
+        MT(FALSE):
+            NEED(0, 1);
+            stack[sp++] = metal_bool(0);
+            NEXT();
+        MT(POP):
+            NEED(1, 0);
+            sp--;
+            NEXT();
+        MT(DUP):
+            NEED(1, 2);
+            stack[sp] = stack[sp - 1];
+            sp++;
+            NEXT();
+
+        MT(DEFINE_GLOBAL):
+            NEED(1, 0);
+            sp--;
+            scope_define(vm, (unsigned int)op->a, stack[sp]);
+            NEXT();
+        MT(GET_GLOBAL): {
+            NEED(0, 1);
+            MetalValue* slot = scope_slot(vm, (unsigned int)op->a);
+            stack[sp++] = slot ? *slot : mv_nil();
+            NEXT();
+        }
+        MT(SET_GLOBAL): {
+            NEED(1, 0);
+            sp--;
+            MetalValue* slot = scope_slot(vm, (unsigned int)op->a);
+            if (slot) *slot = stack[sp];
+            else scope_define(vm, (unsigned int)op->a, stack[sp]);
+            NEXT();
+        }
+
+        MT(ADD): ARITH(a.as.number + b.as.number);
+        MT(SUB): ARITH(a.as.number - b.as.number);
+        MT(MUL): ARITH(a.as.number * b.as.number);
+        MT(DIV):
+            NEED(2, 1);
+            if (stack[sp - 1].as.number == 0.0) goto step;
+            ARITH(a.as.number / b.as.number);
+        MT(NEGATE):
+            NEED(1, 1);
+            if (stack[sp - 1].type != MV_NUM) goto step;
+            stack[sp - 1] = metal_num(-stack[sp - 1].as.number);
+            NEXT();
+
+        MT(EQUAL):         COMPARE(a.as.number == b.as.number);
+        MT(NOT_EQUAL):     COMPARE(a.as.number != b.as.number);
+        MT(GREATER):       COMPARE(a.as.number > b.as.number);
+        MT(GREATER_EQUAL): COMPARE(a.as.number >= b.as.number);
+        MT(LESS):          COMPARE(a.as.number < b.as.number);
+        MT(LESS_EQUAL):    COMPARE(a.as.number <= b.as.number);
+        MT(NOT):
+            NEED(1, 1);
+            stack[sp - 1] = metal_bool(!metal_truthy(stack[sp - 1]));
+            NEXT();
+
+        MT(JUMP):
+            JUMP_TO(op->a);
+        MT(JUMP_IF_FALSE):
+            NEED(1, 0);
+            sp--;
+            if (!metal_truthy(stack[sp])) JUMP_TO(op->a);
+            NEXT();
+        MT(LOOP_BACK):
+            JUMP_TO(op->a);
+
+        MT(GET_INDEX): {
+            NEED(2, 1);
+            MetalValue obj = stack[sp - 2], idx = stack[sp - 1];
+            if (obj.type != MV_ARR) goto step;
+            sp--;
+            stack[sp - 1] = metal_array_get(vm, obj.as.arr_idx, (int)idx.as.number);
+            NEXT();
+        }
+
+        MT(GLOBAL_CONSTANT): {
+            FUSED();
+            NEED(0, 2);
+            MetalValue* slot = scope_slot(vm, (unsigned int)op->a);
+            stack[sp++] = slot ? *slot : mv_nil();
+            stack[sp++] = vm->constants[op->b];
+            NEXT();
+        }
+        MT(GLOBAL_ADD_SET): {
+            FUSED();
+            NEED(0, 2);
+            MetalValue* slot = scope_slot(vm, (unsigned int)op->a);
+            MetalValue k = vm->constants[op->b];
+            if (!slot || !BOTH_NUM(*slot, k)) goto step;
+            *slot = metal_num(slot->as.number + k.as.number);
+            NEXT();
+        }
+        MT(ADD_CONSTANT): ARITH_CONSTANT(a.as.number + b.as.number);
+        MT(SUB_CONSTANT): ARITH_CONSTANT(a.as.number - b.as.number);
+        MT(MUL_CONSTANT): ARITH_CONSTANT(a.as.number * b.as.number);
+
+        MT(EQUAL_JF):         COMPARE_JF(a.as.number == b.as.number);
+        MT(NOT_EQUAL_JF):     COMPARE_JF(a.as.number != b.as.number);
+        MT(GREATER_JF):       COMPARE_JF(a.as.number > b.as.number);
+        MT(GREATER_EQUAL_JF): COMPARE_JF(a.as.number >= b.as.number);
+        MT(LESS_JF):          COMPARE_JF(a.as.number < b.as.number);
+        MT(LESS_EQUAL_JF):    COMPARE_JF(a.as.number <= b.as.number);
+#ifndef METAL_DIRECT_THREADED
+        default:
+            goto step;
+    }
+#endif
+
+step:
+    vm->sp = sp;
+    vm->ip = (int)(op - ops);
+    return 1;
+
+#undef MT
+#undef DISPATCH
+#undef NEXT
+#undef JUMP_TO
+#undef NEED
+#undef FUSED
+#undef BOTH_NUM
+#undef COMPARE
+#undef COMPARE_JF
+#undef ARITH
+#undef ARITH_CONSTANT
+}
+
 int metal_vm_run(MetalVM* vm) {
-    while (metal_vm_step(vm)) {
+    while (metal_vm_execute(vm) && metal_vm_step(vm)) {
         // Continue executing
     }
     return vm->error ? -1 : 0;
@@ -5,10 +5,16 @@
 #include "parser.h"
 #include "ast.h"
 #include "interpreter.h"
+#include "typecheck.h"
+#include "module_cache.h"
+#include "ast_arena.h"
+#include "parallel.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <ctype.h>
 #include <limits.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 #include "gc.h"
 #include "sage_thread.h"
@@ -123,10 +129,13 @@ static char* module_name_to_path(const char* name) {
     return path_name;
 }
 
-// Resolve module path by searching in search paths
-char* resolve_module_path(ModuleCache* cache, const char* name) {
+// Resolve module path by searching in search paths. A `probe` lookup (import
+// prefetch) reports nothing and leaves packages to the real import, since
+// resolving one adds its directory to the search paths.
+static char* resolve_module_path_impl(ModuleCache* cache, const char* name, bool probe) {
     // Reject module names with path traversal attempts
     if (!is_valid_module_name(name)) {
+        if (probe) return NULL;
         fprintf(stderr, "Error: Invalid module name '%s' (path traversal not allowed)\n", name);
         return NULL;
     }
@@ -139,6 +148,7 @@ char* resolve_module_path(ModuleCache* cache, const char* name) {
     for (int i = 0; i < cache->search_path_count; i++) {
         // Try .sage extension
         if (strlen(cache->search_paths[i]) + strlen(path_name) + 7 >= MAX_MODULE_PATH) {
+            if (probe) continue;
             fprintf(stderr, "Error: Module path too long for '%s'\n", name);
             continue;
         }
@@ -149,6 +159,7 @@ char* resolve_module_path(ModuleCache* cache, const char* name) {
         if (file_exists(path)) {
 #ifndef PICO_BUILD
             if (!path_is_within(path, cache->search_paths[i])) {
+                if (probe) continue;
                 fprintf(stderr, "Error: Module '%s' resolves outside search directory\n", name);
                 continue;
             }
@@ -158,6 +169,7 @@ char* resolve_module_path(ModuleCache* cache, const char* name) {
         }
 
         // Try without extension (for directories with __init__.sage)
+        if (probe) continue;
         if (strlen(cache->search_paths[i]) + strlen(path_name) + 15 >= MAX_MODULE_PATH) continue;
         strcpy(path, cache->search_paths[i]);
         strcat(path, "/");
@@ -185,6 +197,14 @@ char* resolve_module_path(ModuleCache* cache, const char* name) {
     return NULL;
 }
 
+char* resolve_module_path(ModuleCache* cache, const char* name) {
+    return resolve_module_path_impl(cache, name, false);
+}
+
+static char* resolve_module_path_probe(ModuleCache* cache, const char* name) {
+    return resolve_module_path_impl(cache, name, true);
+}
+
 // Find a module in the cache (thread-safe)
 Module* find_module(ModuleCache* cache, const char* name) {
     sage_mutex_lock(&module_mutex);
@@ -229,6 +249,80 @@ char* read_file(const char* path) {
     return buffer;
 }
 
+// ============================================================================
+// Import timing (--timing)
+// ============================================================================
+
+int g_module_timing = 0;
+
+typedef struct {
+    char* name;
+    double read_ms;
+    double parse_ms;       // Parse (cold) or cache rebuild (warm)
+    double exec_ms;        // Includes nested imports
+    bool warm;
+} ModuleTiming;
+
+static ModuleTiming* module_timings = NULL;
+static double module_prefetch_wall_ms = 0.0;
+static int module_prefetch_count = 0;
+static int module_timing_count = 0;
+static int module_timing_capacity = 0;
+
+static double timing_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1e6;
+}
+
+static void module_timing_record(const char* name, double read_ms, double parse_ms, double exec_ms, bool warm) {
+    if (module_timing_count == module_timing_capacity) {
+        module_timing_capacity = module_timing_capacity ? module_timing_capacity * 2 : 16;
+        module_timings = SAGE_REALLOC(module_timings, sizeof(ModuleTiming) * (size_t)module_timing_capacity);
+    }
+    ModuleTiming* t = &module_timings[module_timing_count++];
+    t->name = SAGE_STRDUP(name);
+    t->read_ms = read_ms;
+    t->parse_ms = parse_ms;
+    t->exec_ms = exec_ms;
+    t->warm = warm;
+}
+
+void module_timing_report(void) {
+    if (!g_module_timing) {
+        return;
+    }
+    double read_total = 0.0, parse_total = 0.0, load_total = 0.0;
+    int warm_count = 0;
+    fprintf(stderr, "[timing] %-28s %9s %9s %9s  %s\n", "module", "read ms", "parse ms", "exec ms", "ast");
+    for (int i = 0; i < module_timing_count; i++) {
+        ModuleTiming* t = &module_timings[i];
+        fprintf(stderr, "[timing] %-28s %9.3f %9.3f %9.3f  %s\n",
+                t->name, t->read_ms, t->parse_ms, t->exec_ms, t->warm ? "cached" : "parsed");
+        read_total += t->read_ms;
+        if (t->warm) {
+            load_total += t->parse_ms;
+            warm_count++;
+        } else {
+            parse_total += t->parse_ms;
+        }
+    }
+    fprintf(stderr, "[timing] %d modules: read %.3f ms, parsed %d cold in %.3f ms, loaded %d warm in %.3f ms (cache %s)\n",
+            module_timing_count, read_total, module_timing_count - warm_count, parse_total,
+            warm_count, load_total, module_cache_enabled() ? "on" : "off");
+    if (module_prefetch_count > 0) {
+        fprintf(stderr, "[timing] prefetch: %d modules parsed ahead on %d workers in %.3f ms wall\n",
+                module_prefetch_count, parallel_worker_count(), module_prefetch_wall_ms);
+    }
+
+    for (int i = 0; i < module_timing_count; i++) {
+        free(module_timings[i].name);
+    }
+    free(module_timings);
+    module_timings = NULL;
+    module_timing_count = module_timing_capacity = 0;
+}
+
 static Environment* module_parent_env(Environment* target_env) {
     if (g_global_env != NULL) {
         return g_global_env;
@@ -236,10 +330,56 @@ static Environment* module_parent_env(Environment* target_env) {
     return target_env;
 }
 
+// Read and parse a module into module->ast, preferring the on-disk AST
+// cache. Touches only `module`, so prefetch workers run it concurrently.
+// With `recover`, a syntax error leaves module->ast NULL without reporting,
+// so the import itself re-parses and reports it in program order.
+static bool module_parse(Module* module, bool recover) {
+    double t_start = g_module_timing ? timing_now_ms() : 0.0;
+    if (module->source == NULL) {
+        module->source = read_file(module->path);
+    }
+    if (module->source == NULL) {
+        return false;
+    }
+    double t_read = g_module_timing ? timing_now_ms() : 0.0;
+
+    // Module ASTs stay alive with the module, so never build them in an AST
+    // arena that a compile backend happens to have active.
+    AstArena* outer_arena = ast_arena_activate(NULL);
+    size_t source_len = strlen(module->source);
+    module->ast = module_cache_load(module->path, module->source, source_len);
+    module->ast_cached = module->ast != NULL;
+    if (module->ast != NULL) {
+        module->ast_tail = module->ast;
+        while (module->ast_tail->next != NULL) {
+            module->ast_tail = module->ast_tail->next;
+        }
+    } else {
+        // Parse the module once and retain the AST for exported function/method lifetimes.
+        Parser parser;
+        parser_open(&parser, module->source, module->path, recover);
+        module->ast = parser_parse_all(&parser, &module->ast_tail);
+        if (parser.failed) {
+            free_stmt(module->ast);
+            module->ast = NULL;
+            module->ast_tail = NULL;
+            ast_arena_activate(outer_arena);
+            return false;
+        }
+        module_cache_store(module->path, module->source, source_len, module->ast);
+    }
+    ast_arena_activate(outer_arena);
+
+    if (g_module_timing) {
+        module->read_ms += t_read - t_start;
+        module->parse_ms = timing_now_ms() - t_read;
+    }
+    return true;
+}
+
 // Execute a module and populate its environment
 bool execute_module(Module* module, Environment* global_env) {
-    LexerState saved_lexer = lexer_get_state();
-    ParserState saved_parser = parser_get_state();
     bool ok = true;
 
     if (module->is_loaded) {
@@ -252,11 +392,8 @@ bool execute_module(Module* module, Environment* global_env) {
     }
     
     module->is_loading = true;
-    
-    if (module->source == NULL) {
-        module->source = read_file(module->path);
-    }
-    if (!module->source) {
+
+    if (module->ast == NULL && !module_parse(module, false)) {
         module->is_loading = false;
         return false;
     }
@@ -266,25 +403,16 @@ bool execute_module(Module* module, Environment* global_env) {
         module->env = env_create(module_parent_env(global_env));
     }
 
-    if (module->ast == NULL) {
-        // Parse the module once and retain the AST for exported function/method lifetimes.
-        init_lexer(module->source, module->path);
-        parser_init();
-
-        while (1) {
-            Stmt* ast = parse();
-            if (ast == NULL) {
-                break;
-            }
-
-            if (module->ast == NULL) {
-                module->ast = ast;
-            } else {
-                module->ast_tail->next = ast;
-            }
-            module->ast_tail = ast;
-        }
+    // Parse this module's own imports ahead of time, in parallel.
+    if (global_module_cache != NULL) {
+        module_prefetch_ast(global_module_cache, module->ast);
     }
+    double t_exec = g_module_timing ? timing_now_ms() : 0.0;
+
+    TypeMap types;
+    typemap_init(&types);
+    typecheck_annotate(&types, module->ast);
+    typemap_free(&types);
 
     gc_pin();
     for (Stmt* current = module->ast; current != NULL; current = current->next) {
@@ -302,33 +430,48 @@ bool execute_module(Module* module, Environment* global_env) {
     }
     gc_unpin();
 
+    if (g_module_timing) {
+        module_timing_record(module->name, module->read_ms, module->parse_ms,
+                             timing_now_ms() - t_exec, module->ast_cached);
+    }
+
     module->is_loading = false;
     if (ok) {
         module->is_loaded = true;
     }
-
-    parser_set_state(saved_parser);
-    lexer_set_state(saved_lexer);
     return ok;
 }
 
-// Load a module (create if not in cache)
-Module* load_module(ModuleCache* cache, const char* name) {
-    // Check if module is already in cache
-    Module* module = find_module(cache, name);
-    if (module) {
-        return module;
+// ============================================================================
+// Import prefetch
+// ============================================================================
+// Before a module body (or the main script) runs, its unconditional
+// top-level imports are resolved and parsed on the parallel pool, then the
+// imports of those modules, and so on until the reachable graph is parsed.
+// Execution order is unchanged: prefetched modules still run when their
+// import statement is reached, they just find their AST ready.
+
+typedef struct {
+    Module** items;
+    int count;
+    int capacity;
+} ModuleList;
+
+static int prefetch_state = 0;  // 0 = unresolved, 1 = on, -1 = off
+
+static bool prefetch_enabled(void) {
+    if (PARALLEL_IN_TASK()) {
+        return false;  // Imports from inside a parallel callback load lazily
     }
-    
-    // Resolve module path
-    char* path = resolve_module_path(cache, name);
-    if (!path) {
-        fprintf(stderr, "Error: Could not find module '%s'\n", name);
-        return NULL;
+    if (prefetch_state == 0) {
+        const char* env = getenv("SAGE_PREFETCH_IMPORTS");
+        prefetch_state = (env != NULL && strcmp(env, "0") == 0) ? -1 : 1;
     }
-    
-    // Create new module
-    module = SAGE_ALLOC(sizeof(Module));
+    return prefetch_state > 0;
+}
+
+static Module* module_new(ModuleCache* cache, const char* name, char* path) {
+    Module* module = SAGE_ALLOC(sizeof(Module));
     module->name = SAGE_STRDUP(name);
     module->path = path;
     module->source = NULL;
@@ -342,10 +485,148 @@ Module* load_module(ModuleCache* cache, const char* name) {
     module->next = cache->modules;
     cache->modules = module;
     sage_mutex_unlock(&module_mutex);
-
     return module;
 }
 
+static void prefetch_add(ModuleCache* cache, ModuleList* list, const char* name) {
+    if (find_module(cache, name) != NULL) {
+        return;
+    }
+    for (int i = 0; i < list->count; i++) {
+        if (strcmp(list->items[i]->name, name) == 0) return;
+    }
+    // Probe quietly; anything unusual is left for the import to report.
+    char* path = resolve_module_path_probe(cache, name);
+    if (path == NULL) {
+        return;
+    }
+    if (list->count == list->capacity) {
+        list->capacity = list->capacity ? list->capacity * 2 : 8;
+        list->items = SAGE_REALLOC(list->items, sizeof(Module*) * (size_t)list->capacity);
+    }
+    list->items[list->count++] = module_new(cache, name, path);
+}
+
+static void prefetch_collect(ModuleCache* cache, ModuleList* list, Stmt* ast) {
+    for (Stmt* s = ast; s != NULL; s = s->next) {
+        if (s->type == STMT_IMPORT && s->as.import.module_name != NULL) {
+            prefetch_add(cache, list, s->as.import.module_name);
+        }
+    }
+}
+
+static void prefetch_parse_task(void* ctx, long index) {
+    ModuleList* list = ctx;
+    module_parse(list->items[index], true);
+}
+
+static void prefetch_run(ModuleCache* cache, ModuleList* frontier) {
+    double t_start = g_module_timing ? timing_now_ms() : 0.0;
+    int parsed = 0;
+    while (frontier->count > 0) {
+        parallel_run_native(frontier->count, prefetch_parse_task, frontier);
+        parsed += frontier->count;
+
+        ModuleList next = {0};
+        for (int i = 0; i < frontier->count; i++) {
+            prefetch_collect(cache, &next, frontier->items[i]->ast);
+        }
+        free(frontier->items);
+        *frontier = next;
+    }
+    if (g_module_timing && parsed > 0) {
+        module_prefetch_wall_ms += timing_now_ms() - t_start;
+        module_prefetch_count += parsed;
+    }
+}
+
+void module_prefetch_ast(ModuleCache* cache, Stmt* ast) {
+    if (!prefetch_enabled()) {
+        return;
+    }
+    ModuleList frontier = {0};
+    prefetch_collect(cache, &frontier, ast);
+    prefetch_run(cache, &frontier);
+}
+
+// Token-level pre-scan for the main script, which is parsed and run one
+// statement at a time: collect `import a.b` / `from a.b import ...` at
+// indentation level zero without building an AST.
+void module_prefetch_source(ModuleCache* cache, const char* source, const char* filename) {
+    if (source == NULL || !prefetch_enabled()) {
+        return;
+    }
+    ModuleList frontier = {0};
+    LexerState lexer;
+    lexer_init(&lexer, source, filename);
+
+    int depth = 0;
+    bool at_statement = true;
+    for (;;) {
+        Token token = lexer_scan(&lexer);
+        if (token.type == TOKEN_EOF || token.type == TOKEN_ERROR) {
+            break;
+        }
+        if (token.type == TOKEN_INDENT) { depth++; continue; }
+        if (token.type == TOKEN_DEDENT) { depth--; continue; }
+        if (token.type == TOKEN_NEWLINE || token.type == TOKEN_DOC_COMMENT) {
+            at_statement = true;
+            continue;
+        }
+
+        bool starts_import = at_statement && depth == 0 &&
+                             (token.type == TOKEN_IMPORT || token.type == TOKEN_FROM);
+        at_statement = false;
+        if (!starts_import) {
+            continue;
+        }
+
+        // Dotted module name: identifier-like words joined by '.'
+        char name[MAX_MODULE_PATH];
+        size_t len = 0;
+        bool expect_word = true;
+        for (;;) {
+            Token part = lexer_scan(&lexer);
+            if (expect_word && part.length > 0 && (isalpha((unsigned char)part.start[0]) || part.start[0] == '_')
+                && len + (size_t)part.length + 1 < sizeof(name)) {
+                memcpy(name + len, part.start, (size_t)part.length);
+                len += (size_t)part.length;
+                expect_word = false;
+            } else if (!expect_word && part.type == TOKEN_DOT) {
+                name[len++] = '.';
+                expect_word = true;
+            } else {
+                if (part.type == TOKEN_NEWLINE) at_statement = true;
+                if (part.type == TOKEN_EOF || part.type == TOKEN_ERROR) expect_word = true, len = 0;
+                break;
+            }
+        }
+        if (len > 0 && !expect_word) {
+            name[len] = '\0';
+            prefetch_add(cache, &frontier, name);
+        }
+    }
+    prefetch_run(cache, &frontier);
+}
+
+// Load a module (create if not in cache)
+Module* load_module(ModuleCache* cache, const char* name) {
+    // Check if module is already in cache
+    Module* module = find_module(cache, name);
+    if (module) {
+        return module;
+    }
+    
+    // Resolve module path
+    char* path = resolve_module_path(cache, name);
+    if (!path) {
+        fprintf(stderr, "Error: Could not find module '%s'\n", name);
+        return NULL;
+    }
+    
+    return module_new(cache, name, path);
+}
+
 // Get the last component of a dotted module name (e.g., "graphics.vulkan" -> "vulkan")
 static const char* module_binding_name(const char* module_name) {
     const char* last_dot = strrchr(module_name, '.');
@@ -710,6 +991,11 @@ void register_stdlib_modules(ModuleCache* cache) {
     create_math_module(cache);
     create_io_module(cache);
     create_string_module(cache);
+    create_json_module(cache);
+    create_textindex_module(cache);
+    create_vecindex_module(cache);
+    create_kvcache_module(cache);
+    create_bpe_module(cache);
     create_sys_module(cache);
     create_vm_module(cache);
     create_thread_module(cache);
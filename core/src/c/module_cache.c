@@ -0,0 +1,1111 @@
+// src/module_cache.c
+// Persistent on-disk cache of parsed module ASTs. See include/module_cache.h.
+#define _DEFAULT_SOURCE
+#include "module_cache.h"
+#include "gc.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(PICO_BUILD) || defined(SAGE_BARE_METAL)
+
+bool module_cache_enabled(void) { return false; }
+
+Stmt* module_cache_load(const char* path, const char* source, size_t source_len) {
+    (void)path; (void)source; (void)source_len;
+    return NULL;
+}
+
+bool module_cache_store(const char* path, const char* source, size_t source_len, Stmt* ast) {
+    (void)path; (void)source; (void)source_len; (void)ast;
+    return false;
+}
+
+#else
+
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifndef SAGE_VERSION_STR
+#define SAGE_VERSION_STR "dev"
+#endif
+
+#define CACHE_MAGIC "SAGEAST"
+#define CACHE_FORMAT_VERSION 2u
+#define CACHE_BYTE_ORDER_MARK 0x01020304u
+// Changes whenever a token or node kind is added, so images written by an
+// older build with the same version string are still rejected.
+#define CACHE_SCHEMA (((uint32_t)TOKEN_ERROR << 16) | ((uint32_t)EXPR_PROC << 8) | (uint32_t)STMT_MACRO_DEF)
+#define CACHE_NULL_STRING 0xFFFFFFFFu
+#define CACHE_NULL_NODE 0xFF
+
+// ============================================================================
+// Cache location
+// ============================================================================
+
+// FNV-1a over 64-bit words (bytewise for the tail). The source is hashed on
+// every warm load, so this has to stay well below the cost of a parse.
+static uint64_t fnv1a64(const void* data, size_t length) {
+    const unsigned char* bytes = data;
+    uint64_t hash = 14695981039346656037ULL;
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= length; i += sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, bytes + i, sizeof(word));
+        hash ^= word;
+        hash *= 1099511628211ULL;
+    }
+    for (; i < length; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static pthread_once_t cache_dir_once = PTHREAD_ONCE_INIT;
+static const char* cache_dir_resolved = NULL;  // cache_dir once usable, NULL = disabled
+static char cache_dir[PATH_MAX];
+
+static void resolve_cache_dir(void) {
+    const char* toggle = getenv("SAGE_MODULE_CACHE");
+    if (toggle != NULL && (strcmp(toggle, "0") == 0 || strcmp(toggle, "off") == 0)) {
+        return;
+    }
+
+    const char* dir = getenv("SAGE_CACHE_DIR");
+    int n;
+    if (dir != NULL && dir[0] != '\0') {
+        n = snprintf(cache_dir, sizeof(cache_dir), "%s", dir);
+    } else if ((dir = getenv("XDG_CACHE_HOME")) != NULL && dir[0] != '\0') {
+        n = snprintf(cache_dir, sizeof(cache_dir), "%s/sage/modules", dir);
+    } else if ((dir = getenv("HOME")) != NULL && dir[0] != '\0') {
+        n = snprintf(cache_dir, sizeof(cache_dir), "%s/.cache/sage/modules", dir);
+    } else {
+        return;
+    }
+    if (n > 0 && (size_t)n < sizeof(cache_dir)) {
+        cache_dir_resolved = cache_dir;
+    }
+}
+
+// Imports inside parallel callbacks parse on pool workers, so the first
+// lookup can come from several threads at once.
+static const char* module_cache_dir(void) {
+    pthread_once(&cache_dir_once, resolve_cache_dir);
+    return cache_dir_resolved;
+}
+
+bool module_cache_enabled(void) {
+    return module_cache_dir() != NULL;
+}
+
+static bool make_dirs(const char* dir) {
+    char buf[PATH_MAX];
+    size_t len = strlen(dir);
+    if (len == 0 || len >= sizeof(buf)) {
+        return false;
+    }
+    memcpy(buf, dir, len + 1);
+    for (char* p = buf + 1; *p; p++) {
+        if (*p != '/') continue;
+        *p = '\0';
+        if (mkdir(buf, 0755) != 0 && errno != EEXIST) {
+            return false;
+        }
+        *p = '/';
+    }
+    return mkdir(buf, 0755) == 0 || errno == EEXIST;
+}
+
+// Entries are keyed by the canonical module path so "./lib/x.sage" and
+// "lib/x.sage" share one file. The base name is kept for readability.
+static bool cache_entry_path(const char* path, char* key, size_t key_size, char* out, size_t out_size) {
+    const char* dir = module_cache_dir();
+    if (dir == NULL) {
+        return false;
+    }
+    char resolved[PATH_MAX];
+    const char* canonical = realpath(path, resolved) != NULL ? resolved : path;
+    int n = snprintf(key, key_size, "%s", canonical);
+    if (n <= 0 || (size_t)n >= key_size) {
+        return false;
+    }
+
+    const char* base = strrchr(canonical, '/');
+    base = base != NULL ? base + 1 : canonical;
+    n = snprintf(out, out_size, "%s/%.64s-%016llx.sast", dir, base,
+                 (unsigned long long)fnv1a64(key, strlen(key)));
+    return n > 0 && (size_t)n < out_size;
+}
+
+// ============================================================================
+// Writer
+// ============================================================================
+
+typedef struct {
+    unsigned char* data;
+    size_t length;
+    size_t capacity;
+    const char* source;
+    size_t source_len;
+    bool ok;
+} CacheWriter;
+
+static void w_bytes(CacheWriter* w, const void* data, size_t length) {
+    if (w->length + length > w->capacity) {
+        size_t capacity = w->capacity ? w->capacity : 4096;
+        while (capacity < w->length + length) capacity *= 2;
+        w->data = SAGE_REALLOC(w->data, capacity);
+        w->capacity = capacity;
+    }
+    memcpy(w->data + w->length, data, length);
+    w->length += length;
+}
+
+static void w_u8(CacheWriter* w, unsigned value) {
+    unsigned char byte = (unsigned char)value;
+    w_bytes(w, &byte, 1);
+}
+
+static void w_u32(CacheWriter* w, uint32_t value) { w_bytes(w, &value, sizeof(value)); }
+static void w_i32(CacheWriter* w, int value) { int32_t v = value; w_bytes(w, &v, sizeof(v)); }
+static void w_u64(CacheWriter* w, uint64_t value) { w_bytes(w, &value, sizeof(value)); }
+
+static void w_text(CacheWriter* w, const char* text, size_t length) {
+    w_u32(w, (uint32_t)length);
+    w_bytes(w, text, length);
+}
+
+static void w_string(CacheWriter* w, const char* str) {
+    if (str == NULL) {
+        w_u32(w, CACHE_NULL_STRING);
+        return;
+    }
+    w_text(w, str, strlen(str));
+}
+
+// Offset of `ptr` in the source, -1 for NULL. Text outside the source
+// (only lexer error tokens, which never survive a successful parse) makes
+// the module uncacheable.
+static int32_t source_offset(CacheWriter* w, const char* ptr) {
+    if (ptr == NULL) {
+        return -1;
+    }
+    if (ptr < w->source || ptr > w->source + w->source_len) {
+        w->ok = false;
+        return -1;
+    }
+    return (int32_t)(ptr - w->source);
+}
+
+static void w_token(CacheWriter* w, const Token* token) {
+    w_i32(w, (int)token->type);
+    w_i32(w, source_offset(w, token->start));
+    w_i32(w, token->length);
+    w_i32(w, token->line);
+    w_i32(w, token->column);
+    w_i32(w, source_offset(w, token->line_start));
+}
+
+static void w_tokens(CacheWriter* w, const Token* tokens, int count) {
+    w_u8(w, tokens != NULL);
+    if (tokens == NULL) return;
+    for (int i = 0; i < count; i++) w_token(w, &tokens[i]);
+}
+
+static void w_expr(CacheWriter* w, const Expr* expr);
+static void w_stmt_list(CacheWriter* w, const Stmt* stmt);
+
+static void w_exprs(CacheWriter* w, Expr* const* exprs, int count) {
+    w_u8(w, exprs != NULL);
+    if (exprs == NULL) return;
+    for (int i = 0; i < count; i++) w_expr(w, exprs[i]);
+}
+
+static void w_type(CacheWriter* w, const TypeAnnotation* type) {
+    w_u8(w, type != NULL);
+    if (type == NULL) return;
+    w_token(w, &type->name);
+    w_i32(w, type->param_count);
+    w_i32(w, type->is_optional);
+    w_u8(w, type->params != NULL);
+    if (type->params == NULL) return;
+    for (int i = 0; i < type->param_count; i++) w_type(w, type->params[i]);
+}
+
+static void w_types(CacheWriter* w, TypeAnnotation* const* types, int count) {
+    w_u8(w, types != NULL);
+    if (types == NULL) return;
+    for (int i = 0; i < count; i++) w_type(w, types[i]);
+}
+
+static void w_expr(CacheWriter* w, const Expr* expr) {
+    if (expr == NULL) {
+        w_u8(w, CACHE_NULL_NODE);
+        return;
+    }
+    w_u8(w, (unsigned)expr->type);
+    switch (expr->type) {
+        case EXPR_NUMBER:
+            w_bytes(w, &expr->as.number.value, sizeof(double));
+            break;
+        case EXPR_STRING:
+            w_string(w, expr->as.string.value);
+            break;
+        case EXPR_BOOL:
+            w_i32(w, expr->as.boolean.value);
+            break;
+        case EXPR_NIL:
+            break;
+        case EXPR_BINARY:
+            w_token(w, &expr->as.binary.op);
+            w_expr(w, expr->as.binary.left);
+            w_expr(w, expr->as.binary.right);
+            break;
+        case EXPR_VARIABLE:
+            w_token(w, &expr->as.variable.name);
+            break;
+        case EXPR_CALL:
+            w_expr(w, expr->as.call.callee);
+            w_i32(w, expr->as.call.arg_count);
+            w_exprs(w, expr->as.call.args, expr->as.call.arg_count);
+            break;
+        case EXPR_ARRAY:
+            w_i32(w, expr->as.array.count);
+            w_exprs(w, expr->as.array.elements, expr->as.array.count);
+            break;
+        case EXPR_INDEX:
+            w_expr(w, expr->as.index.array);
+            w_expr(w, expr->as.index.index);
+            break;
+        case EXPR_INDEX_SET:
+            w_expr(w, expr->as.index_set.array);
+            w_expr(w, expr->as.index_set.index);
+            w_expr(w, expr->as.index_set.value);
+            break;
+        case EXPR_DICT:
+            w_i32(w, expr->as.dict.count);
+            w_u8(w, expr->as.dict.keys != NULL);
+            if (expr->as.dict.keys != NULL) {
+                for (int i = 0; i < expr->as.dict.count; i++) w_string(w, expr->as.dict.keys[i]);
+            }
+            w_exprs(w, expr->as.dict.values, expr->as.dict.count);
+            break;
+        case EXPR_TUPLE:
+            w_i32(w, expr->as.tuple.count);
+            w_exprs(w, expr->as.tuple.elements, expr->as.tuple.count);
+            break;
+        case EXPR_SLICE:
+            w_expr(w, expr->as.slice.array);
+            w_expr(w, expr->as.slice.start);
+            w_expr(w, expr->as.slice.end);
+            break;
+        case EXPR_GET:
+            w_expr(w, expr->as.get.object);
+            w_token(w, &expr->as.get.property);
+            break;
+        case EXPR_SET:
+            w_expr(w, expr->as.set.object);
+            w_token(w, &expr->as.set.property);
+            w_expr(w, expr->as.set.value);
+            break;
+        case EXPR_AWAIT:
+            w_expr(w, expr->as.await.expression);
+            break;
+        case EXPR_SUPER:
+            w_token(w, &expr->as.super_expr.method);
+            break;
+        case EXPR_COMPTIME:
+            w_expr(w, expr->as.comptime.expression);
+            break;
+        case EXPR_PROC:
+            w_i32(w, expr->as.proc_expr.param_count);
+            w_tokens(w, expr->as.proc_expr.params, expr->as.proc_expr.param_count);
+            w_stmt_list(w, expr->as.proc_expr.body);
+            break;
+    }
+}
+
+static void w_proc(CacheWriter* w, const ProcStmt* proc) {
+    w_token(w, &proc->name);
+    w_i32(w, proc->param_count);
+    w_i32(w, proc->required_count);
+    w_tokens(w, proc->params, proc->param_count);
+    w_types(w, proc->param_types, proc->param_count);
+    w_exprs(w, proc->defaults, proc->param_count);
+    w_type(w, proc->return_type);
+    w_string(w, proc->doc);
+    w_i32(w, proc->type_param_count);
+    w_tokens(w, proc->type_params, proc->type_param_count);
+    w_stmt_list(w, proc->body);
+}
+
+static void w_stmt(CacheWriter* w, const Stmt* stmt) {
+    w_u8(w, (unsigned)stmt->type);
+    switch (stmt->type) {
+        case STMT_PRINT:
+            w_expr(w, stmt->as.print.expression);
+            break;
+        case STMT_EXPRESSION:
+            w_expr(w, stmt->as.expression);
+            break;
+        case STMT_LET:
+            w_token(w, &stmt->as.let.name);
+            w_type(w, stmt->as.let.type_ann);
+            w_expr(w, stmt->as.let.initializer);
+            break;
+        case STMT_IF:
+            w_expr(w, stmt->as.if_stmt.condition);
+            w_stmt_list(w, stmt->as.if_stmt.then_branch);
+            w_stmt_list(w, stmt->as.if_stmt.else_branch);
+            break;
+        case STMT_BLOCK:
+            w_stmt_list(w, stmt->as.block.statements);
+            break;
+        case STMT_WHILE:
+            w_expr(w, stmt->as.while_stmt.condition);
+            w_stmt_list(w, stmt->as.while_stmt.body);
+            break;
+        case STMT_PROC:
+            w_proc(w, &stmt->as.proc);
+            break;
+        case STMT_ASYNC_PROC:
+            w_proc(w, &stmt->as.async_proc);
+            break;
+        case STMT_FOR:
+            w_token(w, &stmt->as.for_stmt.variable);
+            w_expr(w, stmt->as.for_stmt.iterable);
+            w_stmt_list(w, stmt->as.for_stmt.body);
+            break;
+        case STMT_RETURN:
+            w_expr(w, stmt->as.ret.value);
+            break;
+        case STMT_BREAK:
+        case STMT_CONTINUE:
+            break;
+        case STMT_CLASS:
+            w_token(w, &stmt->as.class_stmt.name);
+            w_i32(w, stmt->as.class_stmt.has_parent);
+            if (stmt->as.class_stmt.has_parent) {
+                w_token(w, &stmt->as.class_stmt.parent);
+            }
+            w_stmt_list(w, stmt->as.class_stmt.methods);
+            break;
+        case STMT_MATCH:
+            w_expr(w, stmt->as.match_stmt.value);
+            w_i32(w, stmt->as.match_stmt.case_count);
+            w_u8(w, stmt->as.match_stmt.cases != NULL);
+            if (stmt->as.match_stmt.cases != NULL) {
+                for (int i = 0; i < stmt->as.match_stmt.case_count; i++) {
+                    const CaseClause* clause = stmt->as.match_stmt.cases[i];
+                    w_u8(w, clause != NULL);
+                    if (clause == NULL) continue;
+                    w_expr(w, clause->pattern);
+                    w_expr(w, clause->guard);
+                    w_stmt_list(w, clause->body);
+                }
+            }
+            w_stmt_list(w, stmt->as.match_stmt.default_case);
+            break;
+        case STMT_DEFER:
+            w_stmt_list(w, stmt->as.defer.statement);
+            break;
+        case STMT_TRY:
+            w_stmt_list(w, stmt->as.try_stmt.try_block);
+            w_i32(w, stmt->as.try_stmt.catch_count);
+            w_u8(w, stmt->as.try_stmt.catches != NULL);
+            if (stmt->as.try_stmt.catches != NULL) {
+                for (int i = 0; i < stmt->as.try_stmt.catch_count; i++) {
+                    const CatchClause* clause = stmt->as.try_stmt.catches[i];
+                    w_u8(w, clause != NULL);
+                    if (clause == NULL) continue;
+                    w_token(w, &clause->exception_var);
+                    w_stmt_list(w, clause->body);
+                }
+            }
+            w_stmt_list(w, stmt->as.try_stmt.finally_block);
+            break;
+        case STMT_RAISE:
+            w_expr(w, stmt->as.raise.exception);
+            break;
+        case STMT_YIELD:
+            w_expr(w, stmt->as.yield_stmt.value);
+            break;
+        case STMT_IMPORT:
+            w_string(w, stmt->as.import.module_name);
+            w_i32(w, stmt->as.import.item_count);
+            w_i32(w, stmt->as.import.import_all);
+            w_string(w, stmt->as.import.alias);
+            w_u8(w, stmt->as.import.items != NULL);
+            if (stmt->as.import.items != NULL) {
+                for (int i = 0; i < stmt->as.import.item_count; i++) w_string(w, stmt->as.import.items[i]);
+            }
+            w_u8(w, stmt->as.import.item_aliases != NULL);
+            if (stmt->as.import.item_aliases != NULL) {
+                for (int i = 0; i < stmt->as.import.item_count; i++) w_string(w, stmt->as.import.item_aliases[i]);
+            }
+            break;
+        case STMT_STRUCT:
+            w_token(w, &stmt->as.struct_stmt.name);
+            w_i32(w, stmt->as.struct_stmt.field_count);
+            w_tokens(w, stmt->as.struct_stmt.field_names, stmt->as.struct_stmt.field_count);
+            w_types(w, stmt->as.struct_stmt.field_types, stmt->as.struct_stmt.field_count);
+            w_i32(w, stmt->as.struct_stmt.type_param_count);
+            w_tokens(w, stmt->as.struct_stmt.type_params, stmt->as.struct_stmt.type_param_count);
+            break;
+        case STMT_ENUM:
+            w_token(w, &stmt->as.enum_stmt.name);
+            w_i32(w, stmt->as.enum_stmt.variant_count);
+            w_tokens(w, stmt->as.enum_stmt.variant_names, stmt->as.enum_stmt.variant_count);
+            break;
+        case STMT_TRAIT:
+            w_token(w, &stmt->as.trait_stmt.name);
+            w_stmt_list(w, stmt->as.trait_stmt.methods);
+            break;
+        case STMT_COMPTIME:
+            w_stmt_list(w, stmt->as.comptime.body);
+            break;
+        case STMT_MACRO_DEF:
+            w_token(w, &stmt->as.macro_def.name);
+            w_i32(w, stmt->as.macro_def.param_count);
+            w_tokens(w, stmt->as.macro_def.params, stmt->as.macro_def.param_count);
+            w_stmt_list(w, stmt->as.macro_def.body);
+            break;
+    }
+
+    int pragma_count = 0;
+    for (const Pragma* p = stmt->pragmas; p != NULL; p = p->next) pragma_count++;
+    w_i32(w, pragma_count);
+    for (const Pragma* p = stmt->pragmas; p != NULL; p = p->next) {
+        w_string(w, p->name);
+        w_i32(w, p->arg_count);
+        for (int i = 0; i < p->arg_count; i++) w_string(w, p->args[i]);
+    }
+}
+
+// Statement chains (blocks, bodies, the module itself) are written as a
+// sequence of nodes terminated by CACHE_NULL_NODE.
+static void w_stmt_list(CacheWriter* w, const Stmt* stmt) {
+    for (; stmt != NULL; stmt = stmt->next) {
+        w_stmt(w, stmt);
+    }
+    w_u8(w, CACHE_NULL_NODE);
+}
+
+// The payload checksum covers everything after it: the version, the key
+// and the tree. It is patched in by module_cache_store once the tree is
+// written; returns the offset of its slot.
+static size_t w_header(CacheWriter* w, const char* key) {
+    w_bytes(w, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    w_u32(w, CACHE_FORMAT_VERSION);
+    w_u32(w, CACHE_SCHEMA);
+    w_u32(w, CACHE_BYTE_ORDER_MARK);
+    w_u64(w, (uint64_t)w->source_len);
+    w_u64(w, fnv1a64(w->source, w->source_len));
+    size_t checksum_at = w->length;
+    w_u64(w, 0);
+    w_string(w, SAGE_VERSION_STR);
+    w_string(w, key);
+    return checksum_at;
+}
+
+bool module_cache_store(const char* path, const char* source, size_t source_len, Stmt* ast) {
+    char key[PATH_MAX];
+    char entry[PATH_MAX + 128];
+    if (ast == NULL || !cache_entry_path(path, key, sizeof(key), entry, sizeof(entry))) {
+        return false;
+    }
+
+    CacheWriter w = {0};
+    w.source = source;
+    w.source_len = source_len;
+    w.ok = true;
+    size_t checksum_at = w_header(&w, key);
+    w_stmt_list(&w, ast);
+    if (!w.ok || !make_dirs(module_cache_dir())) {
+        free(w.data);
+        return false;
+    }
+    size_t payload_at = checksum_at + sizeof(uint64_t);
+    uint64_t checksum = fnv1a64(w.data + payload_at, w.length - payload_at);
+    memcpy(w.data + checksum_at, &checksum, sizeof(checksum));
+
+    // Write to a private temp file and rename so concurrent runs never see
+    // a half-written entry.
+    char tmp[PATH_MAX + 160];
+    snprintf(tmp, sizeof(tmp), "%s.%ld.tmp", entry, (long)getpid());
+    FILE* f = fopen(tmp, "wb");
+    bool ok = f != NULL;
+    if (ok) {
+        ok = fwrite(w.data, 1, w.length, f) == w.length;
+        ok = (fclose(f) == 0) && ok;
+    }
+    if (ok) {
+        ok = rename(tmp, entry) == 0;
+    }
+    if (!ok && f != NULL) {
+        remove(tmp);
+    }
+    free(w.data);
+    return ok;
+}
+
+// ============================================================================
+// Reader
+// ============================================================================
+
+typedef struct {
+    const unsigned char* data;
+    size_t length;
+    size_t pos;
+    const char* source;
+    size_t source_len;
+    const char* filename;
+    bool ok;
+} CacheReader;
+
+static bool r_bytes(CacheReader* r, void* out, size_t length) {
+    if (!r->ok || length > r->length - r->pos) {
+        r->ok = false;
+        memset(out, 0, length);
+        return false;
+    }
+    memcpy(out, r->data + r->pos, length);
+    r->pos += length;
+    return true;
+}
+
+static unsigned r_u8(CacheReader* r) {
+    unsigned char byte = 0;
+    r_bytes(r, &byte, 1);
+    return byte;
+}
+
+static uint32_t r_u32(CacheReader* r) { uint32_t v = 0; r_bytes(r, &v, sizeof(v)); return v; }
+static int r_i32(CacheReader* r) { int32_t v = 0; r_bytes(r, &v, sizeof(v)); return v; }
+static uint64_t r_u64(CacheReader* r) { uint64_t v = 0; r_bytes(r, &v, sizeof(v)); return v; }
+
+// Element counts are bounded by the bytes left so a corrupt entry cannot
+// request a huge allocation.
+static int r_count(CacheReader* r) {
+    int count = r_i32(r);
+    if (count < 0 || (size_t)count > r->length - r->pos) {
+        r->ok = false;
+        return 0;
+    }
+    return count;
+}
+
+static char* r_string(CacheReader* r) {
+    uint32_t length = r_u32(r);
+    if (!r->ok || length == CACHE_NULL_STRING) {
+        return NULL;
+    }
+    if (length > r->length - r->pos) {
+        r->ok = false;
+        return NULL;
+    }
+    char* str = SAGE_ALLOC((size_t)length + 1);
+    memcpy(str, r->data + r->pos, length);
+    str[length] = '\0';
+    r->pos += length;
+    return str;
+}
+
+static const char* r_source_ptr(CacheReader* r, int offset) {
+    if (offset < 0) {
+        return NULL;
+    }
+    if ((size_t)offset > r->source_len) {
+        r->ok = false;
+        return NULL;
+    }
+    return r->source + offset;
+}
+
+static Token r_token(CacheReader* r) {
+    Token token;
+    int32_t fields[6];
+    r_bytes(r, fields, sizeof(fields));
+    token.type = (TokenType)fields[0];
+    token.length = fields[2];
+    token.line = fields[3];
+    token.column = fields[4];
+    token.start = r_source_ptr(r, fields[1]);
+    token.line_start = r_source_ptr(r, fields[5]);
+    token.filename = r->filename;
+    if (fields[0] < 0 || fields[0] > TOKEN_ERROR || token.length < 0 ||
+        (token.start != NULL && (size_t)fields[1] + (size_t)token.length > r->source_len)) {
+        r->ok = false;
+        token.length = 0;
+    }
+    return token;
+}
+
+// Names (identifiers, properties, params) always point into the source;
+// consumers compare their text without checking for NULL
+static Token r_name(CacheReader* r) {
+    Token token = r_token(r);
+    if (token.start == NULL) r->ok = false;
+    return token;
+}
+
+// Every token list the parser builds is a list of names, and exists
+// whenever its count is nonzero
+static Token* r_tokens(CacheReader* r, int count) {
+    if (!r_u8(r)) {
+        if (count > 0) r->ok = false;
+        return NULL;
+    }
+    Token* tokens = SAGE_ALLOC(sizeof(Token) * (size_t)count);
+    for (int i = 0; i < count; i++) tokens[i] = r_name(r);
+    return tokens;
+}
+
+static Expr* r_expr(CacheReader* r);
+static Stmt* r_stmt_list(CacheReader* r);
+
+static Expr** r_exprs(CacheReader* r, int count) {
+    if (!r_u8(r)) return NULL;
+    Expr** exprs = SAGE_ALLOC(sizeof(Expr*) * (size_t)count);
+    for (int i = 0; i < count && r->ok; i++) exprs[i] = r_expr(r);
+    return exprs;
+}
+
+// Operands, callees and conditions the parser always sets
+static Expr* r_required(CacheReader* r) {
+    Expr* e = r_expr(r);
+    if (e == NULL) r->ok = false;
+    return e;
+}
+
+// Call arguments and list, tuple and dict elements: the array exists when
+// count is nonzero and holds no NULLs (proc defaults may, so they use r_exprs)
+static Expr** r_elements(CacheReader* r, int count) {
+    Expr** exprs = r_exprs(r, count);
+    if (exprs == NULL && count > 0) r->ok = false;
+    for (int i = 0; exprs != NULL && i < count && r->ok; i++) {
+        if (exprs[i] == NULL) r->ok = false;
+    }
+    return exprs;
+}
+
+static TypeAnnotation* r_type(CacheReader* r) {
+    if (!r_u8(r)) return NULL;
+    Token name = r_name(r);
+    int param_count = r_count(r);
+    int is_optional = r_i32(r);
+    TypeAnnotation** params = NULL;
+    if (r_u8(r)) {
+        params = SAGE_ALLOC(sizeof(TypeAnnotation*) * (size_t)param_count);
+        for (int i = 0; i < param_count && r->ok; i++) params[i] = r_type(r);
+    }
+    return new_type_annotation(name, params, param_count, is_optional);
+}
+
+static TypeAnnotation** r_types(CacheReader* r, int count) {
+    if (!r_u8(r)) return NULL;
+    TypeAnnotation** types = SAGE_ALLOC(sizeof(TypeAnnotation*) * (size_t)count);
+    for (int i = 0; i < count && r->ok; i++) types[i] = r_type(r);
+    return types;
+}
+
+// Nodes are zero-allocated and linked into their parent before their
+// children are read, so a failed read leaves a tree free_stmt can release.
+// Inline-cache fields stay zero, exactly as after a fresh parse.
+static Expr* r_expr(CacheReader* r) {
+    unsigned tag = r_u8(r);
+    if (!r->ok || tag == CACHE_NULL_NODE) {
+        return NULL;
+    }
+    if (tag > EXPR_PROC) {
+        r->ok = false;
+        return NULL;
+    }
+
+    Expr* e = SAGE_ALLOC(sizeof(Expr));
+    e->type = tag;
+    switch (e->type) {
+        case EXPR_NUMBER:
+            r_bytes(r, &e->as.number.value, sizeof(double));
+            break;
+        case EXPR_STRING:
+            e->as.string.value = r_string(r);
+            break;
+        case EXPR_BOOL:
+            e->as.boolean.value = r_i32(r);
+            break;
+        case EXPR_NIL:
+            break;
+        case EXPR_BINARY:
+            e->as.binary.op = r_token(r);
+            e->as.binary.left = r_required(r);
+            e->as.binary.right = r_required(r);
+            break;
+        case EXPR_VARIABLE:
+            e->as.variable.name = r_name(r);
+            break;
+        case EXPR_CALL:
+            e->as.call.callee = r_required(r);
+            e->as.call.arg_count = r_count(r);
+            e->as.call.args = r_elements(r, e->as.call.arg_count);
+            if (e->as.call.args == NULL) e->as.call.arg_count = 0;
+            break;
+        case EXPR_ARRAY:
+            e->as.array.count = r_count(r);
+            e->as.array.elements = r_elements(r, e->as.array.count);
+            if (e->as.array.elements == NULL) e->as.array.count = 0;
+            break;
+        case EXPR_INDEX:
+            e->as.index.array = r_required(r);
+            e->as.index.index = r_required(r);
+            break;
+        case EXPR_INDEX_SET:
+            e->as.index_set.array = r_required(r);
+            e->as.index_set.index = r_required(r);
+            e->as.index_set.value = r_required(r);
+            break;
+        case EXPR_DICT: {
+            int count = r_count(r);
+            if (r_u8(r)) {
+                e->as.dict.keys = SAGE_ALLOC(sizeof(char*) * (size_t)count);
+                for (int i = 0; i < count && r->ok; i++) {
+                    e->as.dict.keys[i] = r_string(r);
+                    if (e->as.dict.keys[i] == NULL) r->ok = false;
+                }
+            }
+            e->as.dict.values = r_elements(r, count);
+            // free_expr walks keys and values together, so only publish the
+            // count once both arrays exist.
+            if (e->as.dict.keys != NULL && e->as.dict.values != NULL) {
+                e->as.dict.count = count;
+            } else if (count > 0) {
+                r->ok = false;
+            }
+            break;
+        }
+        case EXPR_TUPLE:
+            e->as.tuple.count = r_count(r);
+            e->as.tuple.elements = r_elements(r, e->as.tuple.count);
+            if (e->as.tuple.elements == NULL) e->as.tuple.count = 0;
+            break;
+        case EXPR_SLICE:
+            e->as.slice.array = r_required(r);
+            e->as.slice.start = r_expr(r);
+            e->as.slice.end = r_expr(r);
+            break;
+        case EXPR_GET:
+            e->as.get.object = r_required(r);
+            e->as.get.property = r_name(r);
+            break;
+        case EXPR_SET:
+            e->as.set.object = r_required(r);
+            e->as.set.property = r_name(r);
+            e->as.set.value = r_required(r);
+            break;
+        case EXPR_AWAIT:
+            e->as.await.expression = r_required(r);
+            break;
+        case EXPR_SUPER:
+            e->as.super_expr.method = r_name(r);
+            break;
+        case EXPR_COMPTIME:
+            e->as.comptime.expression = r_required(r);
+            break;
+        case EXPR_PROC:
+            e->as.proc_expr.param_count = r_count(r);
+            e->as.proc_expr.params = r_tokens(r, e->as.proc_expr.param_count);
+            e->as.proc_expr.body = r_stmt_list(r);
+            break;
+    }
+    return e;
+}
+
+static void r_proc(CacheReader* r, ProcStmt* proc) {
+    proc->name = r_name(r);
+    int param_count = r_count(r);
+    proc->required_count = r_i32(r);
+    proc->params = r_tokens(r, param_count);
+    proc->param_types = r_types(r, param_count);
+    proc->defaults = r_exprs(r, param_count);
+    proc->param_count = param_count;
+    if (proc->required_count < 0 || proc->required_count > param_count) {
+        r->ok = false;
+        proc->required_count = param_count;
+    }
+    proc->return_type = r_type(r);
+    proc->doc = r_string(r);
+    proc->type_param_count = r_count(r);
+    proc->type_params = r_tokens(r, proc->type_param_count);
+    proc->body = r_stmt_list(r);
+}
+
+static void r_stmt_body(CacheReader* r, Stmt* s) {
+    switch (s->type) {
+        case STMT_PRINT:
+            s->as.print.expression = r_required(r);
+            break;
+        case STMT_EXPRESSION:
+            s->as.expression = r_required(r);
+            break;
+        case STMT_LET:
+            s->as.let.name = r_name(r);
+            s->as.let.type_ann = r_type(r);
+            s->as.let.initializer = r_expr(r);
+            break;
+        case STMT_IF:
+            s->as.if_stmt.condition = r_required(r);
+            s->as.if_stmt.then_branch = r_stmt_list(r);
+            s->as.if_stmt.else_branch = r_stmt_list(r);
+            break;
+        case STMT_BLOCK:
+            s->as.block.statements = r_stmt_list(r);
+            break;
+        case STMT_WHILE:
+            s->as.while_stmt.condition = r_required(r);
+            s->as.while_stmt.body = r_stmt_list(r);
+            break;
+        case STMT_PROC:
+            r_proc(r, &s->as.proc);
+            break;
+        case STMT_ASYNC_PROC:
+            r_proc(r, &s->as.async_proc);
+            break;
+        case STMT_FOR:
+            s->as.for_stmt.variable = r_name(r);
+            s->as.for_stmt.iterable = r_required(r);
+            s->as.for_stmt.body = r_stmt_list(r);
+            break;
+        case STMT_RETURN:
+            s->as.ret.value = r_expr(r);
+            break;
+        case STMT_BREAK:
+        case STMT_CONTINUE:
+            break;
+        case STMT_CLASS:
+            s->as.class_stmt.name = r_name(r);
+            s->as.class_stmt.has_parent = r_i32(r);
+            if (s->as.class_stmt.has_parent != 0 && s->as.class_stmt.has_parent != 1) r->ok = false;
+            if (s->as.class_stmt.has_parent) {
+                s->as.class_stmt.parent = r_name(r);
+            }
+            s->as.class_stmt.methods = r_stmt_list(r);
+            break;
+        case STMT_MATCH: {
+            s->as.match_stmt.value = r_required(r);
+            int count = r_count(r);
+            if (r_u8(r)) {
+                s->as.match_stmt.cases = SAGE_ALLOC(sizeof(CaseClause*) * (size_t)count);
+                s->as.match_stmt.case_count = count;
+                for (int i = 0; i < count && r->ok; i++) {
+                    if (!r_u8(r)) {
+                        r->ok = false;
+                        break;
+                    }
+                    CaseClause* clause = new_case_clause(NULL, NULL);
+                    s->as.match_stmt.cases[i] = clause;
+                    clause->pattern = r_required(r);
+                    clause->guard = r_expr(r);
+                    clause->body = r_stmt_list(r);
+                }
+            }
+            s->as.match_stmt.default_case = r_stmt_list(r);
+            break;
+        }
+        case STMT_DEFER:
+            s->as.defer.statement = r_stmt_list(r);
+            break;
+        case STMT_TRY: {
+            s->as.try_stmt.try_block = r_stmt_list(r);
+            int count = r_count(r);
+            if (r_u8(r)) {
+                s->as.try_stmt.catches = SAGE_ALLOC(sizeof(CatchClause*) * (size_t)count);
+                s->as.try_stmt.catch_count = count;
+                for (int i = 0; i < count && r->ok; i++) {
+                    if (!r_u8(r)) {
+                        r->ok = false;
+                        break;
+                    }
+                    Token var = r_name(r);
+                    CatchClause* clause = new_catch_clause(var, NULL);
+                    s->as.try_stmt.catches[i] = clause;
+                    clause->body = r_stmt_list(r);
+                }
+            }
+            s->as.try_stmt.finally_block = r_stmt_list(r);
+            break;
+        }
+        case STMT_RAISE:
+            s->as.raise.exception = r_required(r);
+            break;
+        case STMT_YIELD:
+            s->as.yield_stmt.value = r_expr(r);
+            break;
+        case STMT_IMPORT: {
+            s->as.import.module_name = r_string(r);
+            if (s->as.import.module_name == NULL) r->ok = false;
+            int count = r_count(r);
+            s->as.import.import_all = r_i32(r);
+            s->as.import.alias = r_string(r);
+            if (r_u8(r)) {
+                s->as.import.items = SAGE_ALLOC(sizeof(char*) * (size_t)count);
+                for (int i = 0; i < count && r->ok; i++) s->as.import.items[i] = r_string(r);
+            }
+            if (r_u8(r)) {
+                s->as.import.item_aliases = SAGE_ALLOC(sizeof(char*) * (size_t)count);
+                for (int i = 0; i < count && r->ok; i++) s->as.import.item_aliases[i] = r_string(r);
+            }
+            // free_stmt indexes both arrays up to item_count.
+            if (s->as.import.items != NULL && s->as.import.item_aliases != NULL) {
+                s->as.import.item_count = count;
+            } else if (count > 0) {
+                r->ok = false;
+            }
+            break;
+        }
+        case STMT_STRUCT:
+            s->as.struct_stmt.name = r_name(r);
+            s->as.struct_stmt.field_count = r_count(r);
+            s->as.struct_stmt.field_names = r_tokens(r, s->as.struct_stmt.field_count);
+            s->as.struct_stmt.field_types = r_types(r, s->as.struct_stmt.field_count);
+            s->as.struct_stmt.type_param_count = r_count(r);
+            s->as.struct_stmt.type_params = r_tokens(r, s->as.struct_stmt.type_param_count);
+            break;
+        case STMT_ENUM:
+            s->as.enum_stmt.name = r_name(r);
+            s->as.enum_stmt.variant_count = r_count(r);
+            s->as.enum_stmt.variant_names = r_tokens(r, s->as.enum_stmt.variant_count);
+            break;
+        case STMT_TRAIT:
+            s->as.trait_stmt.name = r_name(r);
+            s->as.trait_stmt.methods = r_stmt_list(r);
+            break;
+        case STMT_COMPTIME:
+            s->as.comptime.body = r_stmt_list(r);
+            break;
+        case STMT_MACRO_DEF:
+            s->as.macro_def.name = r_name(r);
+            s->as.macro_def.param_count = r_count(r);
+            s->as.macro_def.params = r_tokens(r, s->as.macro_def.param_count);
+            s->as.macro_def.body = r_stmt_list(r);
+            break;
+    }
+
+    int pragma_count = r_count(r);
+    Pragma* tail = NULL;
+    for (int i = 0; i < pragma_count && r->ok; i++) {
+        char* name = r_string(r);
+        int arg_count = r_count(r);
+        char** args = arg_count > 0 ? SAGE_ALLOC(sizeof(char*) * (size_t)arg_count) : NULL;
+        for (int j = 0; j < arg_count; j++) args[j] = r_string(r);
+        Pragma* p = new_pragma(name, args, arg_count);
+        if (tail == NULL) {
+            s->pragmas = p;
+        } else {
+            tail->next = p;
+        }
+        tail = p;
+    }
+}
+
+static Stmt* r_stmt_list(CacheReader* r) {
+    Stmt* head = NULL;
+    Stmt* tail = NULL;
+    while (r->ok) {
+        unsigned tag = r_u8(r);
+        if (!r->ok || tag == CACHE_NULL_NODE) {
+            break;
+        }
+        if (tag > STMT_MACRO_DEF) {
+            r->ok = false;
+            break;
+        }
+        Stmt* s = SAGE_ALLOC(sizeof(Stmt));
+        s->type = tag;
+        if (tail == NULL) {
+            head = s;
+        } else {
+            tail->next = s;
+        }
+        tail = s;
+        r_stmt_body(r, s);
+    }
+    return head;
+}
+
+static bool r_header(CacheReader* r, const char* key) {
+    char magic[sizeof(CACHE_MAGIC)];
+    r_bytes(r, magic, sizeof(magic));
+    if (!r->ok || memcmp(magic, CACHE_MAGIC, sizeof(magic)) != 0) return false;
+    if (r_u32(r) != CACHE_FORMAT_VERSION) return false;
+    if (r_u32(r) != CACHE_SCHEMA) return false;
+    if (r_u32(r) != CACHE_BYTE_ORDER_MARK) return false;
+    if (r_u64(r) != (uint64_t)r->source_len) return false;
+    if (r_u64(r) != fnv1a64(r->source, r->source_len)) return false;
+    // Nothing past this point is decoded unless it is byte-for-byte what was written
+    uint64_t checksum = r_u64(r);
+    if (!r->ok || checksum != fnv1a64(r->data + r->pos, r->length - r->pos)) return false;
+
+    char* version = r_string(r);
+    char* stored_key = r_string(r);
+    bool ok = r->ok && version != NULL && stored_key != NULL &&
+              strcmp(version, SAGE_VERSION_STR) == 0 && strcmp(stored_key, key) == 0;
+    free(version);
+    free(stored_key);
+    return ok;
+}
+
+Stmt* module_cache_load(const char* path, const char* source, size_t source_len) {
+    char key[PATH_MAX];
+    char entry[PATH_MAX + 128];
+    if (!cache_entry_path(path, key, sizeof(key), entry, sizeof(entry))) {
+        return NULL;
+    }
+
+    FILE* f = fopen(entry, "rb");
+    if (f == NULL) {
+        return NULL;
+    }
+    unsigned char* data = NULL;
+    long length = -1;
+    if (fseek(f, 0, SEEK_END) == 0) {
+        length = ftell(f);
+    }
+    if (length > 0 && fseek(f, 0, SEEK_SET) == 0) {
+        data = SAGE_ALLOC((size_t)length);
+        if (fread(data, 1, (size_t)length, f) != (size_t)length) {
+            free(data);
+            data = NULL;
+        }
+    }
+    fclose(f);
+    if (data == NULL) {
+        return NULL;
+    }
+
+    CacheReader r = {0};
+    r.data = data;
+    r.length = (size_t)length;
+    r.source = source;
+    r.source_len = source_len;
+    r.filename = path;
+    r.ok = true;
+
+    Stmt* ast = NULL;
+    if (r_header(&r, key)) {
+        ast = r_stmt_list(&r);
+
+        if (!r.ok || r.pos != r.length) {
+            free_stmt(ast);
+            ast = NULL;
+        }
+    }
+    free(data);
+    return ast;
+}
+
+#endif
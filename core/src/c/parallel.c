@@ -0,0 +1,703 @@
+// src/c/parallel.c
+// Persistent work-stealing pool behind parallel_map / parallel_for /
+// parallel_reduce.
+//
+// A job covers `count` elements split into blocks of `grain` elements. A task
+// is a range of block indices. Whoever runs a task keeps halving it, pushing
+// the upper half onto its own deque, until a single block is left; owners pop
+// from the bottom of their deque (LIFO, cache-warm) while idle workers steal
+// from the top (FIFO, the largest ranges). Callers that submit a job help run
+// tasks until the job completes, so nested parallel calls cannot deadlock.
+//
+// The collector does not stop other threads by itself, so while any pooled job
+// is running the GC is pinned. Threads running blocks ("mutators") poll a
+// safepoint between callback invocations; when the allocation threshold is
+// crossed, the first to notice waits for every other mutator to park and then
+// runs the collection on their behalf.
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "parallel.h"
+#include "sage_thread.h"
+#include "interpreter.h"
+#include "gc.h"
+#include "env.h"
+#include "ast.h"
+
+#define PARALLEL_MAX_WORKERS 256
+#define PARALLEL_BLOCKS_PER_WORKER 8   // Default blocks per worker (steal granularity)
+#define PARALLEL_DEQUE_INIT 64
+
+#ifdef SAGE_BARE_METAL
+int g_parallel_in_task = 0;
+#else
+__thread int g_parallel_in_task = 0;
+#endif
+
+typedef enum {
+    PARALLEL_MAP,
+    PARALLEL_FOR,
+    PARALLEL_REDUCE,
+    PARALLEL_NATIVE         // C callback; never touches the managed heap
+} ParallelKind;
+
+typedef struct {
+    ParallelKind kind;
+    const char* name;       // Builtin name for error messages
+    int pooled;             // Running on the pool (safepoints active)
+    Value fn;
+    Value input;            // Source array (map / reduce)
+    Value output;           // Results (map) or per-block partials (reduce)
+    long start;             // Index base for parallel_for
+    long count;             // Elements to process
+    long grain;             // Elements per block
+    sage_atomic_t blocks_left;
+    sage_atomic_t failed;
+    Value error;            // First exception raised by a callback
+    void (*native_fn)(void* ctx, long index);
+    void* native_ctx;
+    sage_mutex_t lock;
+    sage_cond_t done;
+} ParallelJob;
+
+typedef struct {
+    ParallelJob* job;
+    long lo;                // Block range [lo, hi)
+    long hi;
+} ParallelTask;
+
+typedef struct {
+    sage_mutex_t lock;
+    ParallelTask* items;
+    int head;               // Thieves take items[head]
+    int tail;               // Owner pushes/pops items[tail - 1]
+    int capacity;
+} ParallelDeque;
+
+typedef struct {
+    int started;
+    int worker_count;       // Worker threads actually running
+    int deque_count;        // One per requested worker, plus one shared slot
+    int external_slot;      // Deque used by callers that are not pool workers
+    ParallelDeque* deques;
+    int cores[PARALLEL_MAX_WORKERS];
+    int core_count;
+    sage_atomic_t queued;   // Tasks sitting in any deque
+    sage_atomic_t sleepers; // Workers parked on `wake`
+    sage_mutex_t lock;
+    sage_cond_t wake;
+
+    // Stop-the-world state for collections during pooled jobs
+    sage_mutex_t gc_lock;
+    sage_cond_t gc_cond;
+    int active_jobs;        // Pooled jobs in flight (GC pinned while > 0)
+    int mutators;           // Threads currently running blocks
+    int parked;             // Mutators stopped at a safepoint
+    sage_atomic_t stop_requested;
+} ParallelPool;
+
+static ParallelPool g_pool;
+static sage_mutex_t g_pool_init_lock = SAGE_MUTEX_INITIALIZER;
+#ifdef SAGE_BARE_METAL
+static int g_worker_index = -1;
+static unsigned int g_steal_seed = 0;
+static int g_mutator_depth = 0;
+#else
+static __thread int g_worker_index = -1;
+static __thread unsigned int g_steal_seed = 0;
+static __thread int g_mutator_depth = 0;  // Nested block depth on this thread
+#endif
+
+#ifdef SAGE_BARE_METAL
+extern Value g_ast_gc_temps[];
+extern int g_ast_gc_temp_count;
+#else
+extern __thread Value g_ast_gc_temps[];
+extern __thread int g_ast_gc_temp_count;
+#endif
+
+// Keep job values reachable while the caller waits (mirrors AST_GC_PUSH).
+static void parallel_root_push(Value v) {
+    ThreadState* ts = gc_get_thread_state();
+    if (ts) {
+        if (ts->ast_gc_temp_count < AST_GC_TEMP_MAX) ts->ast_gc_temps[ts->ast_gc_temp_count++] = v;
+    } else {
+        if (g_ast_gc_temp_count < AST_GC_TEMP_MAX) g_ast_gc_temps[g_ast_gc_temp_count++] = v;
+    }
+}
+
+static void parallel_root_pop(int n) {
+    ThreadState* ts = gc_get_thread_state();
+    if (ts) {
+        ts->ast_gc_temp_count = ts->ast_gc_temp_count > n ? ts->ast_gc_temp_count - n : 0;
+    } else {
+        g_ast_gc_temp_count = g_ast_gc_temp_count > n ? g_ast_gc_temp_count - n : 0;
+    }
+}
+
+// ============================================================================
+// Safepoints
+// ============================================================================
+
+static void parallel_gc_enter_job(void) {
+    sage_mutex_lock(&g_pool.gc_lock);
+    if (g_pool.active_jobs++ == 0) {
+        gc_lock();
+        gc_pin();
+        gc_unlock();
+    }
+    sage_mutex_unlock(&g_pool.gc_lock);
+}
+
+static void parallel_gc_leave_job(void) {
+    sage_mutex_lock(&g_pool.gc_lock);
+    if (--g_pool.active_jobs == 0) {
+        gc_lock();
+        gc_unpin();
+        gc_unlock();
+    }
+    sage_mutex_unlock(&g_pool.gc_lock);
+}
+
+// Join the mutator set; blocks while a collection is in progress.
+static void parallel_mutator_resume(void) {
+    sage_mutex_lock(&g_pool.gc_lock);
+    while (sage_atomic_load(&g_pool.stop_requested)) {
+        sage_cond_wait(&g_pool.gc_cond, &g_pool.gc_lock);
+    }
+    g_pool.mutators++;
+    sage_mutex_unlock(&g_pool.gc_lock);
+}
+
+// Leave the mutator set (finished, or about to block waiting for a job).
+static void parallel_mutator_suspend(void) {
+    sage_mutex_lock(&g_pool.gc_lock);
+    g_pool.mutators--;
+    sage_cond_broadcast(&g_pool.gc_cond);
+    sage_mutex_unlock(&g_pool.gc_lock);
+}
+
+static void parallel_mutator_enter(void) {
+    if (g_mutator_depth++ == 0) parallel_mutator_resume();
+}
+
+static void parallel_mutator_leave(void) {
+    if (--g_mutator_depth == 0) parallel_mutator_suspend();
+}
+
+// Called between callback invocations, where every live value of this thread
+// is rooted (interpreter temps, job output arrays).
+static void parallel_safepoint(void) {
+    if (!sage_atomic_load(&g_pool.stop_requested) && !gc_collect_pending()) return;
+
+    sage_mutex_lock(&g_pool.gc_lock);
+    if (!sage_atomic_load(&g_pool.stop_requested) && gc_collect_pending()) {
+        // Become the collector: wait for everyone else to park
+        sage_atomic_store(&g_pool.stop_requested, 1);
+        g_pool.parked++;
+        while (g_pool.parked < g_pool.mutators) {
+            sage_cond_wait(&g_pool.gc_cond, &g_pool.gc_lock);
+        }
+        gc_collect();
+        g_pool.parked--;
+        sage_atomic_store(&g_pool.stop_requested, 0);
+        sage_cond_broadcast(&g_pool.gc_cond);
+    } else if (sage_atomic_load(&g_pool.stop_requested)) {
+        g_pool.parked++;
+        sage_cond_broadcast(&g_pool.gc_cond);
+        while (sage_atomic_load(&g_pool.stop_requested)) {
+            sage_cond_wait(&g_pool.gc_cond, &g_pool.gc_lock);
+        }
+        g_pool.parked--;
+    }
+    sage_mutex_unlock(&g_pool.gc_lock);
+}
+
+// ============================================================================
+// Callback invocation
+// ============================================================================
+
+static int parallel_check_callable(const char* name, Value fn) {
+    if (fn.type == VAL_NATIVE) return 1;
+    if (!IS_FUNCTION(fn) || fn.as.function == NULL || fn.as.function->proc == NULL) {
+        fprintf(stderr, "Runtime Error: %s requires a function argument.\n", name);
+        return 0;
+    }
+    if (fn.as.function->is_vm) {
+        fprintf(stderr, "Runtime Error: %s requires a non-bytecode function.\n", name);
+        return 0;
+    }
+    return 1;
+}
+
+static Value parallel_call(ParallelJob* job, Value* args, int argc) {
+    if (job->fn.type == VAL_NATIVE) return job->fn.as.native(argc, args);
+
+    FunctionValue* func = job->fn.as.function;
+    ProcStmt* proc = (ProcStmt*)func->proc;
+
+    // No GC lock needed while binding: pooled jobs only collect at
+    // safepoints, and binding does not allocate on the GC heap.
+    Env* scope = env_create(func->closure);
+    for (int i = 0; i < proc->param_count; i++) {
+        Token param = proc->params[i];
+        env_define_const(scope, param.start, param.length, i < argc ? args[i] : val_nil());
+    }
+
+    ExecResult res = interpret(proc->body, scope);
+    if (res.is_throwing) {
+        sage_mutex_lock(&job->lock);
+        if (sage_atomic_exchange(&job->failed, 1) == 0) job->error = res.exception_value;
+        sage_mutex_unlock(&job->lock);
+        return val_nil();
+    }
+    return res.value;
+}
+
+static Value parallel_input_at(ParallelJob* job, long i) {
+    ArrayValue* a = job->input.as.array;
+    return i < a->count ? a->elements[i] : val_nil();
+}
+
+static void parallel_run_block(ParallelJob* job, long block) {
+    long lo = block * job->grain;
+    long hi = lo + job->grain;
+    if (hi > job->count) hi = job->count;
+
+    switch (job->kind) {
+        case PARALLEL_MAP: {
+            for (long i = lo; i < hi && !sage_atomic_load(&job->failed); i++) {
+                if (job->pooled) parallel_safepoint();
+                Value arg = parallel_input_at(job, i);
+                Value r = parallel_call(job, &arg, 1);
+                job->output.as.array->elements[i] = r;
+            }
+            break;
+        }
+        case PARALLEL_FOR: {
+            for (long i = lo; i < hi && !sage_atomic_load(&job->failed); i++) {
+                if (job->pooled) parallel_safepoint();
+                Value arg = val_number((double)(job->start + i));
+                parallel_call(job, &arg, 1);
+            }
+            break;
+        }
+        case PARALLEL_NATIVE: {
+            for (long i = lo; i < hi; i++) {
+                job->native_fn(job->native_ctx, i);
+            }
+            break;
+        }
+        case PARALLEL_REDUCE: {
+            // Each block folds from its own first element, so fn only needs to
+            // be associative; the seed is applied once when partials combine.
+            // The running accumulator lives in the (rooted) partials array.
+            Value* acc = &job->output.as.array->elements[block];
+            *acc = parallel_input_at(job, lo);
+            for (long i = lo + 1; i < hi && !sage_atomic_load(&job->failed); i++) {
+                if (job->pooled) parallel_safepoint();
+                Value pair[2] = { *acc, parallel_input_at(job, i) };
+                *acc = parallel_call(job, pair, 2);
+            }
+            break;
+        }
+    }
+}
+
+// ============================================================================
+// Deques
+// ============================================================================
+
+static void parallel_deque_init(ParallelDeque* d) {
+    sage_mutex_init(&d->lock);
+    d->capacity = PARALLEL_DEQUE_INIT;
+    d->items = SAGE_ALLOC(sizeof(ParallelTask) * (size_t)d->capacity);
+    d->head = 0;
+    d->tail = 0;
+}
+
+static void parallel_push(int self, ParallelTask task) {
+    ParallelDeque* d = &g_pool.deques[self];
+    sage_mutex_lock(&d->lock);
+    if (d->tail == d->capacity) {
+        if (d->head > 0) {
+            memmove(d->items, d->items + d->head, sizeof(ParallelTask) * (size_t)(d->tail - d->head));
+            d->tail -= d->head;
+            d->head = 0;
+        } else {
+            d->capacity *= 2;
+            d->items = SAGE_REALLOC(d->items, sizeof(ParallelTask) * (size_t)d->capacity);
+        }
+    }
+    d->items[d->tail++] = task;
+    sage_mutex_unlock(&d->lock);
+
+    sage_atomic_add(&g_pool.queued, 1);
+    if (sage_atomic_load(&g_pool.sleepers) > 0) {
+        sage_mutex_lock(&g_pool.lock);
+        sage_cond_signal(&g_pool.wake);
+        sage_mutex_unlock(&g_pool.lock);
+    }
+}
+
+static int parallel_pop(int index, int steal, ParallelTask* out) {
+    ParallelDeque* d = &g_pool.deques[index];
+    int found = 0;
+    sage_mutex_lock(&d->lock);
+    if (d->tail > d->head) {
+        *out = steal ? d->items[d->head++] : d->items[--d->tail];
+        if (d->head == d->tail) d->head = d->tail = 0;
+        found = 1;
+    }
+    sage_mutex_unlock(&d->lock);
+    if (found) sage_atomic_sub(&g_pool.queued, 1);
+    return found;
+}
+
+static int parallel_find_task(int self, ParallelTask* out) {
+    if (parallel_pop(self, 0, out)) return 1;
+    if (sage_atomic_load(&g_pool.queued) == 0) return 0;
+
+    // Start stealing at a pseudo-random victim so thieves spread out
+    int n = g_pool.deque_count;
+    g_steal_seed = g_steal_seed * 1103515245u + 12345u + (unsigned int)self;
+    int first = (int)((g_steal_seed >> 16) % (unsigned int)n);
+    for (int k = 0; k < n; k++) {
+        int victim = (first + k) % n;
+        if (victim != self && parallel_pop(victim, 1, out)) return 1;
+    }
+    return 0;
+}
+
+static void parallel_run_task(int self, ParallelTask task) {
+    while (task.hi - task.lo > 1) {
+        long mid = task.lo + (task.hi - task.lo) / 2;
+        ParallelTask upper = { task.job, mid, task.hi };
+        parallel_push(self, upper);
+        task.hi = mid;
+    }
+
+    // Native blocks never allocate managed objects, so they stay out of the
+    // mutator set and never hold up a collection.
+    ParallelJob* job = task.job;
+    int mutator = job->kind != PARALLEL_NATIVE;
+    if (mutator) parallel_mutator_enter();
+    parallel_run_block(job, task.lo);
+    if (mutator) parallel_mutator_leave();
+
+    // Decrement under the job lock: once the submitter observes zero, no
+    // worker touches the job again.
+    sage_mutex_lock(&job->lock);
+    if (sage_atomic_sub(&job->blocks_left, 1) == 1) sage_cond_broadcast(&job->done);
+    sage_mutex_unlock(&job->lock);
+}
+
+// ============================================================================
+// Pool
+// ============================================================================
+
+static void* parallel_worker_main(void* arg) {
+    int index = (int)(intptr_t)arg;
+    g_worker_index = index;
+    g_parallel_in_task = 1;
+    g_steal_seed = (unsigned int)index * 2654435761u;
+
+    ThreadState ts;
+    memset(&ts, 0, sizeof(ThreadState));
+    ts.thread_id = sage_thread_id();
+    ts.gas_limit = -1; // unlimited
+    gc_register_thread(&ts);
+
+    if (g_pool.core_count > 1) {
+        sage_thread_set_affinity(g_pool.cores[index % g_pool.core_count]);
+    }
+
+    for (;;) {
+        ParallelTask task;
+        if (parallel_find_task(index, &task)) {
+            parallel_run_task(index, task);
+            continue;
+        }
+        sage_mutex_lock(&g_pool.lock);
+        sage_atomic_add(&g_pool.sleepers, 1);
+        while (sage_atomic_load(&g_pool.queued) == 0) {
+            sage_cond_wait(&g_pool.wake, &g_pool.lock);
+        }
+        sage_atomic_sub(&g_pool.sleepers, 1);
+        sage_mutex_unlock(&g_pool.lock);
+    }
+    return NULL;
+}
+
+static void parallel_pool_start(void) {
+    sage_mutex_lock(&g_pool_init_lock);
+    if (g_pool.started) {
+        sage_mutex_unlock(&g_pool_init_lock);
+        return;
+    }
+
+    // Size the pool from the caller's affinity mask so taskset/cgroup limits
+    // and an earlier thread_set_affinity() are honoured.
+    g_pool.core_count = sage_thread_get_affinity(g_pool.cores, PARALLEL_MAX_WORKERS);
+    int workers = g_pool.core_count;
+    const char* override = getenv("SAGE_PARALLEL_WORKERS");
+    if (override && atoi(override) > 0) workers = atoi(override);
+    if (workers < 1) workers = 1;
+    if (workers > PARALLEL_MAX_WORKERS) workers = PARALLEL_MAX_WORKERS;
+
+    sage_mutex_init(&g_pool.lock);
+    sage_cond_init(&g_pool.wake);
+    sage_mutex_init(&g_pool.gc_lock);
+    sage_cond_init(&g_pool.gc_cond);
+    sage_atomic_store(&g_pool.stop_requested, 0);
+    sage_atomic_store(&g_pool.queued, 0);
+    sage_atomic_store(&g_pool.sleepers, 0);
+    g_pool.deque_count = workers + 1;
+    g_pool.external_slot = workers;
+    g_pool.deques = SAGE_ALLOC(sizeof(ParallelDeque) * (size_t)g_pool.deque_count);
+    for (int i = 0; i < g_pool.deque_count; i++) parallel_deque_init(&g_pool.deques[i]);
+
+    // Callers always help, so a pool with no workers still completes jobs.
+    int created = 0;
+#if SAGE_HAS_THREADS
+    for (int i = 0; i < workers; i++) {
+        sage_thread_t thread;
+        if (sage_thread_create(&thread, parallel_worker_main, (void*)(intptr_t)i) != 0) break;
+        sage_thread_detach(thread);
+        created++;
+    }
+#endif
+    g_pool.worker_count = created;
+    g_pool.started = 1;
+    sage_mutex_unlock(&g_pool_init_lock);
+}
+
+int parallel_worker_count(void) {
+    parallel_pool_start();
+    return g_pool.worker_count;
+}
+
+static void parallel_job_init(ParallelJob* job, ParallelKind kind, const char* name, Value fn) {
+    memset(job, 0, sizeof(*job));
+    job->kind = kind;
+    job->name = name;
+    job->fn = fn;
+    job->input = val_nil();
+    job->output = val_nil();
+    job->error = val_nil();
+    sage_atomic_store(&job->blocks_left, 0);
+    sage_atomic_store(&job->failed, 0);
+    sage_mutex_init(&job->lock);
+    sage_cond_init(&job->done);
+}
+
+static void parallel_job_destroy(ParallelJob* job) {
+    sage_cond_destroy(&job->done);
+    sage_mutex_destroy(&job->lock);
+}
+
+// Run every block of `job`, helping the pool until the last one finishes.
+static void parallel_run_job(ParallelJob* job, long blocks) {
+    sage_atomic_store(&job->blocks_left, blocks);
+
+    int saved_in_task = g_parallel_in_task;
+    g_parallel_in_task = 1;
+    int self = g_worker_index >= 0 ? g_worker_index : g_pool.external_slot;
+
+    ParallelTask root = { job, 0, blocks };
+    parallel_push(self, root);
+
+    while (sage_atomic_load(&job->blocks_left) > 0) {
+        ParallelTask task;
+        if (parallel_find_task(self, &task)) {
+            parallel_run_task(self, task);
+            continue;
+        }
+        // Nothing left to steal: the remaining blocks are running elsewhere.
+        // A nested caller is still a mutator; step aside so collections
+        // triggered by the other threads do not wait on us.
+        if (g_mutator_depth > 0) parallel_mutator_suspend();
+        sage_mutex_lock(&job->lock);
+        while (sage_atomic_load(&job->blocks_left) > 0 && sage_atomic_load(&g_pool.queued) == 0) {
+            sage_cond_wait(&job->done, &job->lock);
+        }
+        sage_mutex_unlock(&job->lock);
+        if (g_mutator_depth > 0) parallel_mutator_resume();
+    }
+
+    // Wait out the finisher still holding the lock before the job goes away.
+    sage_mutex_lock(&job->lock);
+    sage_mutex_unlock(&job->lock);
+    g_parallel_in_task = saved_in_task;
+}
+
+// Shared setup/teardown for the three builtins. Returns 0 if a callback threw.
+static int parallel_execute(ParallelJob* job, Value chunk) {
+    if (job->count <= 0) return 1;
+
+    long grain = 0;
+    if (IS_NUMBER(chunk) && AS_NUMBER(chunk) >= 1) {
+        grain = (long)AS_NUMBER(chunk);
+    } else {
+        long target = (long)parallel_worker_count() * PARALLEL_BLOCKS_PER_WORKER;
+        if (target < 1) target = 1;
+        grain = (job->count + target - 1) / target;
+    }
+    if (grain < 1) grain = 1;
+    job->grain = grain;
+    long blocks = (job->count + grain - 1) / grain;
+
+    if (job->kind == PARALLEL_REDUCE) {
+        ArrayValue* partials = job->output.as.array;
+        partials->elements = SAGE_ALLOC(sizeof(Value) * (size_t)blocks);
+        partials->count = (int)blocks;
+        partials->capacity = (int)blocks;
+        gc_track_external_allocation(sizeof(Value) * (size_t)blocks);
+        for (long b = 0; b < blocks; b++) partials->elements[b] = val_nil();
+    }
+
+    if (blocks == 1) {
+        // Not worth waking the pool for a single block
+        parallel_run_block(job, 0);
+    } else {
+        parallel_pool_start();
+        job->pooled = 1;
+        parallel_gc_enter_job();
+        parallel_run_job(job, blocks);
+        parallel_gc_leave_job();
+    }
+
+    if (sage_atomic_load(&job->failed)) {
+        fprintf(stderr, "Runtime Error: %s callback raised an exception", job->name);
+        if (IS_EXCEPTION(job->error) && AS_EXCEPTION(job->error)->message) {
+            fprintf(stderr, ": %s", AS_EXCEPTION(job->error)->message);
+        }
+        fprintf(stderr, "\n");
+        return 0;
+    }
+    return 1;
+}
+
+// ============================================================================
+// C tasks
+// ============================================================================
+
+void parallel_run_native(long count, void (*fn)(void* ctx, long index), void* ctx) {
+    if (count <= 0) return;
+    if (count == 1) {
+        fn(ctx, 0);
+        return;
+    }
+
+    ParallelJob job;
+    parallel_job_init(&job, PARALLEL_NATIVE, "parallel_run_native", val_nil());
+    job.native_fn = fn;
+    job.native_ctx = ctx;
+    job.count = count;
+    job.grain = 1;
+    parallel_pool_start();
+    parallel_run_job(&job, count);
+    parallel_job_destroy(&job);
+}
+
+// ============================================================================
+// Builtins
+// ============================================================================
+
+// parallel_map(fn, arr, chunk?) -> [fn(arr[0]), fn(arr[1]), ...]
+Value parallel_map_native(int argCount, Value* args) {
+    if (argCount < 2 || !IS_ARRAY(args[1])) {
+        fprintf(stderr, "Runtime Error: parallel_map(fn, array, chunk?) requires an array.\n");
+        return val_nil();
+    }
+    if (!parallel_check_callable("parallel_map", args[0])) return val_nil();
+
+    ParallelJob job;
+    parallel_job_init(&job, PARALLEL_MAP, "parallel_map", args[0]);
+    job.input = args[1];
+    job.count = AS_ARRAY(args[1])->count;
+
+    job.output = val_array();
+    ArrayValue* out = AS_ARRAY(job.output);
+    if (job.count > 0) {
+        out->elements = SAGE_ALLOC(sizeof(Value) * (size_t)job.count);
+        out->count = (int)job.count;
+        out->capacity = (int)job.count;
+        gc_track_external_allocation(sizeof(Value) * (size_t)job.count);
+        for (long i = 0; i < job.count; i++) out->elements[i] = val_nil();
+    }
+
+    parallel_root_push(job.output);
+    int ok = parallel_execute(&job, argCount > 2 ? args[2] : val_nil());
+    parallel_root_pop(1);
+    parallel_job_destroy(&job);
+    return ok ? job.output : val_nil();
+}
+
+// parallel_for(start, end, fn, chunk?) -> nil; calls fn(i) for start <= i < end
+Value parallel_for_native(int argCount, Value* args) {
+    if (argCount < 3 || !IS_NUMBER(args[0]) || !IS_NUMBER(args[1])) {
+        fprintf(stderr, "Runtime Error: parallel_for(start, end, fn, chunk?) requires numeric bounds.\n");
+        return val_nil();
+    }
+    if (!parallel_check_callable("parallel_for", args[2])) return val_nil();
+
+    ParallelJob job;
+    parallel_job_init(&job, PARALLEL_FOR, "parallel_for", args[2]);
+    job.start = (long)AS_NUMBER(args[0]);
+    job.count = (long)AS_NUMBER(args[1]) - job.start;
+
+    parallel_execute(&job, argCount > 3 ? args[3] : val_nil());
+    parallel_job_destroy(&job);
+    return val_nil();
+}
+
+// parallel_reduce(fn, arr, init, chunk?) -> fn(init, fold(fn, arr))
+// fn must be associative; blocks are combined in array order.
+Value parallel_reduce_native(int argCount, Value* args) {
+    if (argCount < 3 || !IS_ARRAY(args[1])) {
+        fprintf(stderr, "Runtime Error: parallel_reduce(fn, array, init, chunk?) requires an array.\n");
+        return val_nil();
+    }
+    if (!parallel_check_callable("parallel_reduce", args[0])) return val_nil();
+
+    ParallelJob job;
+    parallel_job_init(&job, PARALLEL_REDUCE, "parallel_reduce", args[0]);
+    job.input = args[1];
+    job.count = AS_ARRAY(args[1])->count;
+    job.output = val_array();
+
+    parallel_root_push(job.output);
+    if (!parallel_execute(&job, argCount > 3 ? args[3] : val_nil())) {
+        parallel_root_pop(1);
+        parallel_job_destroy(&job);
+        return val_nil();
+    }
+
+    Value acc = args[2];
+    ArrayValue* partials = AS_ARRAY(job.output);
+    for (int b = 0; b < partials->count; b++) {
+        Value pair[2] = { acc, partials->elements[b] };
+        acc = parallel_call(&job, pair, 2);
+        if (sage_atomic_load(&job.failed)) {
+            fprintf(stderr, "Runtime Error: parallel_reduce callback raised an exception\n");
+            acc = val_nil();
+            break;
+        }
+    }
+    parallel_root_pop(1);
+    parallel_job_destroy(&job);
+    return acc;
+}
+
+// parallel_workers() -> number of pool worker threads
+Value parallel_workers_native(int argCount, Value* args) {
+    (void)argCount; (void)args;
+    return val_number((double)parallel_worker_count());
+}
@@ -8,22 +8,55 @@
 #include "token.h"
 #include "gc.h"
 #include "repl.h"
-
+#include "ast_arena.h"
+#include <setjmp.h>
+
+// Where a recovering parse jumps to, and what it was complaining about.
+typedef struct {
+    jmp_buf jump;
+    Token token;
+    char message[PARSER_ERROR_MAX];
+} ParserRecovery;
+
+// Parser state is per thread, so separate threads can parse independent
+// sources at once. A Parser context carries one source's state between
+// parser_next() calls (see parser.h).
+#ifdef SAGE_BARE_METAL
 static Token current_token;
 static Token previous_token;
+static char* pending_doc = NULL;
+static ParserRecovery* parser_recover = NULL;
+#else
+static __thread Token current_token;
+static __thread Token previous_token;
+static __thread char* pending_doc = NULL;
+static __thread ParserRecovery* parser_recover = NULL;  // Set while a recovering Parser runs
+#endif
 
 // Forward declaration for anonymous proc expression parsing
 static Expr* parse_proc_expr(void);
 
 // Parser recursion depth limit to prevent stack overflow on malicious input
 #define MAX_PARSER_DEPTH 100000
+#ifdef SAGE_BARE_METAL
 static int parser_depth = 0;
+#else
+static __thread int parser_depth = 0;
+#endif
 
 static int token_span(const Token* token) {
     return (token != NULL && token->length > 0) ? token->length : 1;
 }
 
 static void parser_report(Token token, int span, const char* message, const char* help) {
+    if (parser_recover != NULL) {
+        // Recovering parsers fail silently; whoever actually needs the
+        // result re-parses and reports. parser_step_recovering frees the
+        // partial tree.
+        parser_recover->token = token;
+        snprintf(parser_recover->message, sizeof(parser_recover->message), "%s", message);
+        longjmp(parser_recover->jump, 1);
+    }
     sage_print_token_diagnosticf("error", &token, NULL, span > 0 ? span : 1,
                                  help, "%s", message);
     sage_error_exit();
@@ -117,12 +150,16 @@ ParserState parser_get_state(void) {
     ParserState state;
     state.current_token = current_token;
     state.previous_token = previous_token;
+    state.depth = parser_depth;
+    state.pending_doc = pending_doc;
     return state;
 }
 
 void parser_set_state(ParserState state) {
     current_token = state.current_token;
     previous_token = state.previous_token;
+    parser_depth = state.depth;
+    pending_doc = state.pending_doc;
 }
 
 static int check(TokenType type) {
@@ -160,7 +197,7 @@ static void consume_identifier_like(const char* message) {
 }
 
 static char* process_string_escapes(const char* src, int src_len, int* out_len) {
-    char* buf = SAGE_ALLOC(src_len + 1);
+    char* buf = ast_malloc(src_len + 1);
     int j = 0;
     for (int i = 0; i < src_len; i++) {
         if (src[i] == '\\' && i + 1 < src_len) {
@@ -321,7 +358,7 @@ static Stmt* try_statement() {
         
         if (catch_count >= catch_capacity) {
             catch_capacity = catch_capacity == 0 ? 2 : catch_capacity * 2;
-            catches = SAGE_REALLOC(catches, sizeof(CatchClause*) * catch_capacity);
+            catches = ast_realloc(catches, sizeof(CatchClause*) * catch_capacity);
         }
         catches[catch_count++] = clause;
     }
@@ -395,7 +432,7 @@ static Stmt* match_statement() {
             clause->guard = guard;
             if (case_count >= case_capacity) {
                 case_capacity = case_capacity == 0 ? 4 : case_capacity * 2;
-                cases = SAGE_REALLOC(cases, sizeof(CaseClause*) * case_capacity);
+                cases = ast_realloc(cases, sizeof(CaseClause*) * case_capacity);
             }
             cases[case_count++] = clause;
         } else {
@@ -455,7 +492,7 @@ static Stmt* import_statement() {
 
         // Build dotted module name (e.g., graphics.vulkan)
         int name_len = module_token.length;
-        char* module_name = SAGE_ALLOC(name_len + 1);
+        char* module_name = ast_malloc(name_len + 1);
         memcpy(module_name, module_token.start, module_token.length);
         module_name[name_len] = '\0';
 
@@ -467,7 +504,7 @@ static Stmt* import_statement() {
             }
             Token part = previous_token;
             int new_len = name_len + 1 + part.length;
-            module_name = SAGE_REALLOC(module_name, new_len + 1);
+            module_name = ast_realloc(module_name, new_len + 1);
             module_name[name_len] = '.';
             memcpy(module_name + name_len + 1, part.start, part.length);
             name_len = new_len;
@@ -480,8 +517,8 @@ static Stmt* import_statement() {
         if (match(TOKEN_STAR)) {
             // Use import_all=0 with a special "*" item to distinguish
             // from "import module" (which uses import_all=1)
-            char** star_items = SAGE_ALLOC(sizeof(char*));
-            char** star_aliases = SAGE_ALLOC(sizeof(char*));
+            char** star_items = ast_malloc(sizeof(char*));
+            char** star_aliases = ast_malloc(sizeof(char*));
             star_items[0] = SAGE_STRDUP("*");
             star_aliases[0] = NULL;
             return new_import_stmt(module_name, star_items, star_aliases, 1, NULL, 0);
@@ -499,12 +536,12 @@ static Stmt* import_statement() {
             
             if (item_count >= capacity) {
                 capacity = capacity == 0 ? 4 : capacity * 2;
-                items = SAGE_REALLOC(items, sizeof(char*) * capacity);
-                item_aliases = SAGE_REALLOC(item_aliases, sizeof(char*) * capacity);  // ✅ NEW
+                items = ast_realloc(items, sizeof(char*) * capacity);
+                item_aliases = ast_realloc(item_aliases, sizeof(char*) * capacity);  // ✅ NEW
             }
             
             // Store the original item name
-            items[item_count] = SAGE_ALLOC(item_token.length + 1);
+            items[item_count] = ast_malloc(item_token.length + 1);
             memcpy(items[item_count], item_token.start, item_token.length);
             items[item_count][item_token.length] = '\0';
             
@@ -513,7 +550,7 @@ static Stmt* import_statement() {
                 consume_identifier_like("Expect alias name after 'as'.");
                 Token alias_token = previous_token;
                 
-                item_aliases[item_count] = SAGE_ALLOC(alias_token.length + 1);
+                item_aliases[item_count] = ast_malloc(alias_token.length + 1);
                 memcpy(item_aliases[item_count], alias_token.start, alias_token.length);
                 item_aliases[item_count][alias_token.length] = '\0';
             } else {
@@ -533,7 +570,7 @@ static Stmt* import_statement() {
 
     // Build dotted module name (e.g., graphics.vulkan)
     int name_len = module_token.length;
-    char* module_name = SAGE_ALLOC(name_len + 1);
+    char* module_name = ast_malloc(name_len + 1);
     memcpy(module_name, module_token.start, module_token.length);
     module_name[name_len] = '\0';
 
@@ -545,7 +582,7 @@ static Stmt* import_statement() {
         }
         Token part = previous_token;
         int new_len = name_len + 1 + part.length;
-        module_name = SAGE_REALLOC(module_name, new_len + 1);
+        module_name = ast_realloc(module_name, new_len + 1);
         module_name[name_len] = '.';
         memcpy(module_name + name_len + 1, part.start, part.length);
         name_len = new_len;
@@ -557,7 +594,7 @@ static Stmt* import_statement() {
         consume_identifier_like("Expect alias after 'as'.");
         Token alias_token = previous_token;
         
-        alias = SAGE_ALLOC(alias_token.length + 1);
+        alias = ast_malloc(alias_token.length + 1);
         memcpy(alias, alias_token.start, alias_token.length);
         alias[alias_token.length] = '\0';
     }
@@ -622,14 +659,14 @@ static Expr* primary() {
             Expr** elements = NULL;
             int count = 0;
             int capacity = 4;
-            elements = SAGE_ALLOC(sizeof(Expr*) * capacity);
+            elements = ast_malloc(sizeof(Expr*) * capacity);
             elements[count++] = first;
             
             if (!check(TOKEN_RPAREN)) {
                 do {
                     if (count >= capacity) {
                         capacity *= 2;
-                        elements = SAGE_REALLOC(elements, sizeof(Expr*) * capacity);
+                        elements = ast_realloc(elements, sizeof(Expr*) * capacity);
                     }
                     elements[count++] = expression();
                 } while (match(TOKEN_COMMA) && !check(TOKEN_RPAREN));
@@ -663,8 +700,8 @@ static Expr* primary() {
                 
                 if (count >= capacity) {
                     capacity = capacity == 0 ? 4 : capacity * 2;
-                    keys = SAGE_REALLOC(keys, sizeof(char*) * capacity);
-                    values = SAGE_REALLOC(values, sizeof(Expr*) * capacity);
+                    keys = ast_realloc(keys, sizeof(char*) * capacity);
+                    values = ast_realloc(values, sizeof(Expr*) * capacity);
                 }
                 keys[count] = key;
                 values[count] = value;
@@ -688,7 +725,7 @@ static Expr* primary() {
                 Expr* elem = expression();
                 if (count >= capacity) {
                     capacity = capacity == 0 ? 4 : capacity * 2;
-                    elements = SAGE_REALLOC(elements, sizeof(Expr*) * capacity);
+                    elements = ast_realloc(elements, sizeof(Expr*) * capacity);
                 }
                 elements[count++] = elem;
             } while (match(TOKEN_COMMA));
@@ -772,7 +809,7 @@ static Expr* postfix() {
                     Expr* arg = expression();
                     if (count >= capacity) {
                         capacity = capacity == 0 ? 4 : capacity * 2;
-                        args = SAGE_REALLOC(args, sizeof(Expr*) * capacity);
+                        args = ast_realloc(args, sizeof(Expr*) * capacity);
                     }
                     args[count++] = arg;
                 } while (match(TOKEN_COMMA));
@@ -931,7 +968,7 @@ static Expr* assignment() {
     if (expr->type == EXPR_GET && match(TOKEN_ASSIGN)) {
         Expr* object = expr->as.get.object;
         Token property = expr->as.get.property;
-        free(expr);
+        ast_free(expr);
         Expr* value = assignment();
         return new_set_expr(object, property, value);
     }
@@ -940,7 +977,7 @@ static Expr* assignment() {
     if (expr->type == EXPR_INDEX && match(TOKEN_ASSIGN)) {
         Expr* array = expr->as.index.array;
         Expr* index = expr->as.index.index;
-        free(expr);
+        ast_free(expr);
         Expr* value = assignment();
         return new_index_set_expr(array, index, value);
     }
@@ -948,7 +985,7 @@ static Expr* assignment() {
     // Handle regular variable assignment: x = value
     if (expr->type == EXPR_VARIABLE && match(TOKEN_ASSIGN)) {
         Token name = expr->as.variable.name;
-        free(expr);
+        ast_free(expr);
         Expr* value = assignment();
         return new_set_expr(NULL, name, value);
     }
@@ -994,7 +1031,7 @@ static Stmt* macro_declaration() {
             consume_identifier_like("Expect parameter name.");
             if (count >= capacity) {
                 capacity = capacity == 0 ? 4 : capacity * 2;
-                params = SAGE_REALLOC(params, sizeof(Token) * capacity);
+                params = ast_realloc(params, sizeof(Token) * capacity);
             }
             params[count++] = previous_token;
         } while (match(TOKEN_COMMA));
@@ -1011,7 +1048,7 @@ static Stmt* macro_declaration() {
 static Pragma* parse_pragma(void) {
     consume_identifier_like("Expect pragma name after '@'.");
     Token name_tok = previous_token;
-    char* name = SAGE_ALLOC(name_tok.length + 1);
+    char* name = ast_malloc(name_tok.length + 1);
     memcpy(name, name_tok.start, name_tok.length);
     name[name_tok.length] = '\0';
 
@@ -1027,22 +1064,22 @@ static Pragma* parse_pragma(void) {
                 if (match(TOKEN_STRING)) {
                     Token arg_tok = previous_token;
                     int len = arg_tok.length - 2;
-                    char* arg = SAGE_ALLOC(len + 1);
+                    char* arg = ast_malloc(len + 1);
                     memcpy(arg, arg_tok.start + 1, len);
                     arg[len] = '\0';
                     if (arg_count >= arg_capacity) {
                         arg_capacity = arg_capacity == 0 ? 4 : arg_capacity * 2;
-                        args = SAGE_REALLOC(args, sizeof(char*) * arg_capacity);
+                        args = ast_realloc(args, sizeof(char*) * arg_capacity);
                     }
                     args[arg_count++] = arg;
                 } else if (match(TOKEN_IDENTIFIER) || match(TOKEN_NUMBER)) {
                     Token arg_tok = previous_token;
-                    char* arg = SAGE_ALLOC(arg_tok.length + 1);
+                    char* arg = ast_malloc(arg_tok.length + 1);
                     memcpy(arg, arg_tok.start, arg_tok.length);
                     arg[arg_tok.length] = '\0';
                     if (arg_count >= arg_capacity) {
                         arg_capacity = arg_capacity == 0 ? 4 : arg_capacity * 2;
-                        args = SAGE_REALLOC(args, sizeof(char*) * arg_capacity);
+                        args = ast_realloc(args, sizeof(char*) * arg_capacity);
                     }
                     args[arg_count++] = arg;
                 } else {
@@ -1069,7 +1106,7 @@ static void parse_generic_type_params(Token** out_params, int* out_count) {
         consume_identifier_like("Expect type parameter name.");
         if (*out_count >= capacity) {
             capacity = capacity == 0 ? 4 : capacity * 2;
-            *out_params = SAGE_REALLOC(*out_params, sizeof(Token) * capacity);
+            *out_params = ast_realloc(*out_params, sizeof(Token) * capacity);
         }
         (*out_params)[(*out_count)++] = previous_token;
     } while (match(TOKEN_COMMA));
@@ -1178,7 +1215,7 @@ static TypeAnnotation* parse_type_annotation(void) {
             if (param) {
                 if (param_count >= capacity) {
                     capacity = capacity == 0 ? 2 : capacity * 2;
-                    params = SAGE_REALLOC(params, sizeof(TypeAnnotation*) * capacity);
+                    params = ast_realloc(params, sizeof(TypeAnnotation*) * capacity);
                 }
                 params[param_count++] = param;
             }
@@ -1218,9 +1255,9 @@ static Stmt* proc_declaration() {
                 if (current_token.type == TOKEN_SELF || current_token.type == TOKEN_IDENTIFIER || current_token.type == TOKEN_MATCH || current_token.type == TOKEN_END || current_token.type == TOKEN_INIT) {
                     if (count >= capacity) {
                         capacity = capacity == 0 ? 4 : capacity * 2;
-                        params = SAGE_REALLOC(params, sizeof(Token) * capacity);
-                        param_types = SAGE_REALLOC(param_types, sizeof(TypeAnnotation*) * capacity);
-                        defaults = SAGE_REALLOC(defaults, sizeof(Expr*) * capacity);
+                        params = ast_realloc(params, sizeof(Token) * capacity);
+                        param_types = ast_realloc(param_types, sizeof(TypeAnnotation*) * capacity);
+                        defaults = ast_realloc(defaults, sizeof(Expr*) * capacity);
                     }
                     params[count] = current_token;
                     param_types[count] = NULL;
@@ -1262,13 +1299,13 @@ static Stmt* proc_declaration() {
         Stmt* body = parse_maybe_oneline_block();
 
         Stmt* s = new_proc_stmt(name, params, count, body);
-        s->as.proc.param_types = param_types;
-        s->as.proc.defaults = defaults;
+        s->as.proc.param_types = ast_adopt(param_types, sizeof(TypeAnnotation*) * (size_t)count);
+        s->as.proc.defaults = ast_adopt(defaults, sizeof(Expr*) * (size_t)count);
         s->as.proc.required_count = required;
         s->as.proc.return_type = return_type;
-        s->as.proc.type_params = type_params;
+        s->as.proc.type_params = ast_adopt(type_params, sizeof(Token) * (size_t)type_param_count);
         s->as.proc.type_param_count = type_param_count;
-        s->as.proc.doc = take_pending_doc();
+        s->as.proc.doc = ast_adopt_string(take_pending_doc());
         return s;
     }
     
@@ -1295,7 +1332,7 @@ static Expr* parse_proc_expr(void) {
                 current_token.type == TOKEN_INIT) {
                 if (param_count >= capacity) {
                     capacity = capacity == 0 ? 4 : capacity * 2;
-                    params = SAGE_REALLOC(params, sizeof(Token) * (size_t)capacity);
+                    params = ast_realloc(params, sizeof(Token) * (size_t)capacity);
                 }
                 params[param_count] = current_token;
                 advance_parser();
@@ -1322,12 +1359,11 @@ static Expr* parse_proc_expr(void) {
     // Consume optional 'end' keyword after the body
     match(TOKEN_END);
 
-    Expr* e = new_proc_expr(params, param_count, body);
     // Shrink params array to fit (optional)
     if (param_count > 0) {
-        e->as.proc_expr.params = SAGE_REALLOC(params, sizeof(Token) * (size_t)param_count);
+        params = ast_realloc(params, sizeof(Token) * (size_t)param_count);
     }
-    return e;
+    return new_proc_expr(params, param_count, body);
 }
 
 static Stmt* async_proc_declaration() {
@@ -1348,7 +1384,7 @@ static Stmt* async_proc_declaration() {
                 if (current_token.type == TOKEN_SELF || current_token.type == TOKEN_IDENTIFIER || current_token.type == TOKEN_MATCH || current_token.type == TOKEN_END || current_token.type == TOKEN_INIT) {
                     if (count >= capacity) {
                         capacity = capacity == 0 ? 4 : capacity * 2;
-                        params = SAGE_REALLOC(params, sizeof(Token) * capacity);
+                        params = ast_realloc(params, sizeof(Token) * capacity);
                     }
                     params[count++] = current_token;
                     advance_parser();
@@ -1476,8 +1512,8 @@ static Stmt* struct_declaration() {
         }
         if (count >= capacity) {
             capacity = capacity == 0 ? 4 : capacity * 2;
-            field_names = SAGE_REALLOC(field_names, sizeof(Token) * capacity);
-            field_types = SAGE_REALLOC(field_types, sizeof(TypeAnnotation*) * capacity);
+            field_names = ast_realloc(field_names, sizeof(Token) * capacity);
+            field_types = ast_realloc(field_types, sizeof(TypeAnnotation*) * capacity);
         }
         field_names[count] = fname;
         field_types[count] = ftype;
@@ -1486,7 +1522,7 @@ static Stmt* struct_declaration() {
     }
     consume(TOKEN_DEDENT, "Expect dedent after struct body.");
     Stmt* s = new_struct_stmt(name, field_names, field_types, count);
-    s->as.struct_stmt.type_params = type_params;
+    s->as.struct_stmt.type_params = ast_adopt(type_params, sizeof(Token) * (size_t)type_param_count);
     s->as.struct_stmt.type_param_count = type_param_count;
     return s;
 }
@@ -1521,7 +1557,7 @@ static Stmt* enum_declaration() {
         Token vname = previous_token;
         if (count >= capacity) {
             capacity = capacity == 0 ? 4 : capacity * 2;
-            variants = SAGE_REALLOC(variants, sizeof(Token) * capacity);
+            variants = ast_realloc(variants, sizeof(Token) * capacity);
         }
         variants[count++] = vname;
         match(TOKEN_NEWLINE);
@@ -1604,8 +1640,6 @@ static Stmt* statement() {
     return new_expr_stmt(expr);
 }
 
-static char* pending_doc = NULL;
-
 static void collect_doc_comment(void) {
     // Collect consecutive ## lines into one doc string
     if (pending_doc) { free(pending_doc); pending_doc = NULL; }
@@ -1773,3 +1807,83 @@ Stmt* parse(void) {
     if (current_token.type == TOKEN_EOF) return NULL;
     return declaration();
 }
+
+// ============================================================================
+// Reentrant parsing contexts
+// ============================================================================
+
+void parser_open(Parser* parser, const char* source, const char* filename, bool recover) {
+    memset(parser, 0, sizeof(*parser));
+    lexer_init(&parser->lexer, source, filename);
+    parser->recover = recover;
+}
+
+// One top-level statement on the installed context; the first call primes
+// the token window (which may already hit a lexer error).
+static Stmt* parser_step(Parser* parser) {
+    if (!parser->started) {
+        parser->started = true;
+        parser_init();
+    }
+    return parse();
+}
+
+static Stmt* parser_step_recovering(Parser* parser) {
+    ParserRecovery recover;
+    ParserRecovery* saved = parser_recover;
+    AstTrack track;
+    ast_track_begin(&track);
+    parser_recover = &recover;
+    if (setjmp(recover.jump) != 0) {
+        parser_recover = saved;
+        ast_track_end(&track, 1);  // Free the statement we were half-way through
+        parser->failed = true;
+        parser->error_line = recover.token.line;
+        parser->error_column = recover.token.column;
+        memcpy(parser->error_message, recover.message, sizeof(parser->error_message));
+        return NULL;
+    }
+    Stmt* stmt = parser_step(parser);
+    parser_recover = saved;
+    ast_track_end(&track, 0);
+    return stmt;
+}
+
+Stmt* parser_next(Parser* parser) {
+    if (parser->failed) {
+        return NULL;
+    }
+
+    // Swap the context in for one statement. The caller's own lexer/parser
+    // state is untouched afterwards, so contexts nest and interleave freely.
+    LexerState saved_lexer = lexer_get_state();
+    ParserState saved_parser = parser_get_state();
+    lexer_set_state(parser->lexer);
+    parser_set_state(parser->state);
+
+    Stmt* stmt = parser->recover ? parser_step_recovering(parser) : parser_step(parser);
+
+    parser->lexer = lexer_get_state();
+    parser->state = parser_get_state();
+    lexer_set_state(saved_lexer);
+    parser_set_state(saved_parser);
+    return stmt;
+}
+
+Stmt* parser_parse_all(Parser* parser, Stmt** tail_out) {
+    Stmt* head = NULL;
+    Stmt* tail = NULL;
+    Stmt* stmt;
+    while ((stmt = parser_next(parser)) != NULL) {
+        if (head == NULL) {
+            head = stmt;
+        } else {
+            tail->next = stmt;
+        }
+        tail = stmt;
+    }
+    if (tail_out != NULL) {
+        *tail_out = tail;
+    }
+    return head;
+}
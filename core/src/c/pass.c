@@ -4,6 +4,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include "gc.h"
+#include "ast_arena.h"
 
 // ============================================================================
 // Token Cloning
@@ -17,18 +18,20 @@ Token clone_token(Token tok) {
     t.length = tok.length;
     t.line_start = tok.line_start;
     t.filename = tok.filename;
-    // Token.start points into the original source; copy the string
+    // Token.start points into the original source; copy the string (interned
+    // in the active AST arena, so repeated identifiers share one copy)
     if (tok.start != NULL && tok.length > 0) {
-        char* s = SAGE_ALLOC((size_t)tok.length + 1);
-        memcpy(s, tok.start, (size_t)tok.length);
-        s[tok.length] = '\0';
-        t.start = s;
+        t.start = ast_strndup(tok.start, (size_t)tok.length);
     } else {
         t.start = NULL;
     }
     return t;
 }
 
+static char* clone_string(const char* str) {
+    return str != NULL ? ast_strndup(str, strlen(str)) : NULL;
+}
+
 // ============================================================================
 // Expression Deep Clone
 // ============================================================================
@@ -36,7 +39,7 @@ Token clone_token(Token tok) {
 Expr* clone_expr(const Expr* expr) {
     if (expr == NULL) return NULL;
 
-    Expr* e = SAGE_ALLOC(sizeof(Expr));
+    Expr* e = ast_alloc(sizeof(Expr));
     e->type = expr->type;
 
     switch (expr->type) {
@@ -44,7 +47,7 @@ Expr* clone_expr(const Expr* expr) {
             e->as.number.value = expr->as.number.value;
             break;
         case EXPR_STRING:
-            e->as.string.value = expr->as.string.value ? SAGE_STRDUP(expr->as.string.value) : NULL;
+            e->as.string.value = clone_string(expr->as.string.value);
             break;
         case EXPR_BOOL:
             e->as.boolean.value = expr->as.boolean.value;
@@ -63,7 +66,7 @@ Expr* clone_expr(const Expr* expr) {
             e->as.call.callee = clone_expr(expr->as.call.callee);
             e->as.call.arg_count = expr->as.call.arg_count;
             if (expr->as.call.arg_count > 0) {
-                e->as.call.args = SAGE_ALLOC(sizeof(Expr*) * (size_t)expr->as.call.arg_count);
+                e->as.call.args = ast_alloc(sizeof(Expr*) * (size_t)expr->as.call.arg_count);
                 for (int i = 0; i < expr->as.call.arg_count; i++) {
                     e->as.call.args[i] = clone_expr(expr->as.call.args[i]);
                 }
@@ -75,7 +78,7 @@ Expr* clone_expr(const Expr* expr) {
         case EXPR_ARRAY: {
             e->as.array.count = expr->as.array.count;
             if (expr->as.array.count > 0) {
-                e->as.array.elements = SAGE_ALLOC(sizeof(Expr*) * (size_t)expr->as.array.count);
+                e->as.array.elements = ast_alloc(sizeof(Expr*) * (size_t)expr->as.array.count);
                 for (int i = 0; i < expr->as.array.count; i++) {
                     e->as.array.elements[i] = clone_expr(expr->as.array.elements[i]);
                 }
@@ -96,10 +99,10 @@ Expr* clone_expr(const Expr* expr) {
         case EXPR_DICT: {
             e->as.dict.count = expr->as.dict.count;
             if (expr->as.dict.count > 0) {
-                e->as.dict.keys = SAGE_ALLOC(sizeof(char*) * (size_t)expr->as.dict.count);
-                e->as.dict.values = SAGE_ALLOC(sizeof(Expr*) * (size_t)expr->as.dict.count);
+                e->as.dict.keys = ast_alloc(sizeof(char*) * (size_t)expr->as.dict.count);
+                e->as.dict.values = ast_alloc(sizeof(Expr*) * (size_t)expr->as.dict.count);
                 for (int i = 0; i < expr->as.dict.count; i++) {
-                    e->as.dict.keys[i] = SAGE_STRDUP(expr->as.dict.keys[i]);
+                    e->as.dict.keys[i] = clone_string(expr->as.dict.keys[i]);
                     e->as.dict.values[i] = clone_expr(expr->as.dict.values[i]);
                 }
             } else {
@@ -111,7 +114,7 @@ Expr* clone_expr(const Expr* expr) {
         case EXPR_TUPLE: {
             e->as.tuple.count = expr->as.tuple.count;
             if (expr->as.tuple.count > 0) {
-                e->as.tuple.elements = SAGE_ALLOC(sizeof(Expr*) * (size_t)expr->as.tuple.count);
+                e->as.tuple.elements = ast_alloc(sizeof(Expr*) * (size_t)expr->as.tuple.count);
                 for (int i = 0; i < expr->as.tuple.count; i++) {
                     e->as.tuple.elements[i] = clone_expr(expr->as.tuple.elements[i]);
                 }
@@ -145,7 +148,7 @@ Expr* clone_expr(const Expr* expr) {
         case EXPR_PROC: {
             e->as.proc_expr.param_count = expr->as.proc_expr.param_count;
             if (expr->as.proc_expr.param_count > 0) {
-                e->as.proc_expr.params = SAGE_ALLOC(sizeof(Token) * (size_t)expr->as.proc_expr.param_count);
+                e->as.proc_expr.params = ast_alloc(sizeof(Token) * (size_t)expr->as.proc_expr.param_count);
                 for (int i = 0; i < expr->as.proc_expr.param_count; i++) {
                     e->as.proc_expr.params[i] = clone_token(expr->as.proc_expr.params[i]);
                 }
@@ -166,7 +169,7 @@ Expr* clone_expr(const Expr* expr) {
 
 static CaseClause* clone_case_clause(const CaseClause* c) {
     if (c == NULL) return NULL;
-    CaseClause* nc = SAGE_ALLOC(sizeof(CaseClause));
+    CaseClause* nc = ast_alloc(sizeof(CaseClause));
     nc->pattern = clone_expr(c->pattern);
     nc->body = clone_stmt_list(c->body);
     return nc;
@@ -174,7 +177,7 @@ static CaseClause* clone_case_clause(const CaseClause* c) {
 
 static CatchClause* clone_catch_clause(const CatchClause* c) {
     if (c == NULL) return NULL;
-    CatchClause* nc = SAGE_ALLOC(sizeof(CatchClause));
+    CatchClause* nc = ast_alloc(sizeof(CatchClause));
     nc->exception_var = clone_token(c->exception_var);
     nc->body = clone_stmt_list(c->body);
     return nc;
@@ -182,12 +185,12 @@ static CatchClause* clone_catch_clause(const CatchClause* c) {
 
 static TypeAnnotation* clone_type_annotation(const TypeAnnotation* ann) {
     if (ann == NULL) return NULL;
-    TypeAnnotation* na = SAGE_ALLOC(sizeof(TypeAnnotation));
+    TypeAnnotation* na = ast_alloc(sizeof(TypeAnnotation));
     na->name = clone_token(ann->name);
     na->param_count = ann->param_count;
     na->is_optional = ann->is_optional;
     if (ann->param_count > 0) {
-        na->params = SAGE_ALLOC(sizeof(TypeAnnotation*) * (size_t)ann->param_count);
+        na->params = ast_alloc(sizeof(TypeAnnotation*) * (size_t)ann->param_count);
         for (int i = 0; i < ann->param_count; i++) {
             na->params[i] = clone_type_annotation(ann->params[i]);
         }
@@ -200,7 +203,7 @@ static TypeAnnotation* clone_type_annotation(const TypeAnnotation* ann) {
 Stmt* clone_stmt(const Stmt* stmt) {
     if (stmt == NULL) return NULL;
 
-    Stmt* s = SAGE_ALLOC(sizeof(Stmt));
+    Stmt* s = ast_alloc(sizeof(Stmt));
     memset(s, 0, sizeof(Stmt));
     s->type = stmt->type;
     s->next = NULL;
@@ -232,7 +235,7 @@ Stmt* clone_stmt(const Stmt* stmt) {
             s->as.proc.name = clone_token(stmt->as.proc.name);
             s->as.proc.param_count = stmt->as.proc.param_count;
             if (stmt->as.proc.param_count > 0) {
-                s->as.proc.params = SAGE_ALLOC(sizeof(Token) * (size_t)stmt->as.proc.param_count);
+                s->as.proc.params = ast_alloc(sizeof(Token) * (size_t)stmt->as.proc.param_count);
                 for (int i = 0; i < stmt->as.proc.param_count; i++) {
                     s->as.proc.params[i] = clone_token(stmt->as.proc.params[i]);
                 }
@@ -246,6 +249,7 @@ Stmt* clone_stmt(const Stmt* stmt) {
             s->as.for_stmt.variable = clone_token(stmt->as.for_stmt.variable);
             s->as.for_stmt.iterable = clone_expr(stmt->as.for_stmt.iterable);
             s->as.for_stmt.body = clone_stmt_list(stmt->as.for_stmt.body);
+            s->as.for_stmt.counted = stmt->as.for_stmt.counted;
             break;
         case STMT_RETURN:
             s->as.ret.value = clone_expr(stmt->as.ret.value);
@@ -263,7 +267,7 @@ Stmt* clone_stmt(const Stmt* stmt) {
             s->as.match_stmt.value = clone_expr(stmt->as.match_stmt.value);
             s->as.match_stmt.case_count = stmt->as.match_stmt.case_count;
             if (stmt->as.match_stmt.case_count > 0) {
-                s->as.match_stmt.cases = SAGE_ALLOC(sizeof(CaseClause*) * (size_t)stmt->as.match_stmt.case_count);
+                s->as.match_stmt.cases = ast_alloc(sizeof(CaseClause*) * (size_t)stmt->as.match_stmt.case_count);
                 for (int i = 0; i < stmt->as.match_stmt.case_count; i++) {
                     s->as.match_stmt.cases[i] = clone_case_clause(stmt->as.match_stmt.cases[i]);
                 }
@@ -280,7 +284,7 @@ Stmt* clone_stmt(const Stmt* stmt) {
             s->as.try_stmt.try_block = clone_stmt_list(stmt->as.try_stmt.try_block);
             s->as.try_stmt.catch_count = stmt->as.try_stmt.catch_count;
             if (stmt->as.try_stmt.catch_count > 0) {
-                s->as.try_stmt.catches = SAGE_ALLOC(sizeof(CatchClause*) * (size_t)stmt->as.try_stmt.catch_count);
+                s->as.try_stmt.catches = ast_alloc(sizeof(CatchClause*) * (size_t)stmt->as.try_stmt.catch_count);
                 for (int i = 0; i < stmt->as.try_stmt.catch_count; i++) {
                     s->as.try_stmt.catches[i] = clone_catch_clause(stmt->as.try_stmt.catches[i]);
                 }
@@ -297,16 +301,16 @@ Stmt* clone_stmt(const Stmt* stmt) {
             s->as.yield_stmt.value = clone_expr(stmt->as.yield_stmt.value);
             break;
         case STMT_IMPORT: {
-            s->as.import.module_name = stmt->as.import.module_name ? SAGE_STRDUP(stmt->as.import.module_name) : NULL;
+            s->as.import.module_name = clone_string(stmt->as.import.module_name);
             s->as.import.import_all = stmt->as.import.import_all;
-            s->as.import.alias = stmt->as.import.alias ? SAGE_STRDUP(stmt->as.import.alias) : NULL;
+            s->as.import.alias = clone_string(stmt->as.import.alias);
             s->as.import.item_count = stmt->as.import.item_count;
             if (stmt->as.import.item_count > 0) {
-                s->as.import.items = SAGE_ALLOC(sizeof(char*) * (size_t)stmt->as.import.item_count);
-                s->as.import.item_aliases = SAGE_ALLOC(sizeof(char*) * (size_t)stmt->as.import.item_count);
+                s->as.import.items = ast_alloc(sizeof(char*) * (size_t)stmt->as.import.item_count);
+                s->as.import.item_aliases = ast_alloc(sizeof(char*) * (size_t)stmt->as.import.item_count);
                 for (int i = 0; i < stmt->as.import.item_count; i++) {
-                    s->as.import.items[i] = stmt->as.import.items[i] ? SAGE_STRDUP(stmt->as.import.items[i]) : NULL;
-                    s->as.import.item_aliases[i] = stmt->as.import.item_aliases[i] ? SAGE_STRDUP(stmt->as.import.item_aliases[i]) : NULL;
+                    s->as.import.items[i] = clone_string(stmt->as.import.items[i]);
+                    s->as.import.item_aliases[i] = clone_string(stmt->as.import.item_aliases[i]);
                 }
             } else {
                 s->as.import.items = NULL;
@@ -318,7 +322,7 @@ Stmt* clone_stmt(const Stmt* stmt) {
             s->as.async_proc.name = clone_token(stmt->as.async_proc.name);
             s->as.async_proc.param_count = stmt->as.async_proc.param_count;
             if (stmt->as.async_proc.param_count > 0) {
-                s->as.async_proc.params = SAGE_ALLOC(sizeof(Token) * (size_t)stmt->as.async_proc.param_count);
+                s->as.async_proc.params = ast_alloc(sizeof(Token) * (size_t)stmt->as.async_proc.param_count);
                 for (int i = 0; i < stmt->as.async_proc.param_count; i++) {
                     s->as.async_proc.params[i] = clone_token(stmt->as.async_proc.params[i]);
                 }
@@ -332,8 +336,8 @@ Stmt* clone_stmt(const Stmt* stmt) {
             s->as.struct_stmt.name = clone_token(stmt->as.struct_stmt.name);
             s->as.struct_stmt.field_count = stmt->as.struct_stmt.field_count;
             if (stmt->as.struct_stmt.field_count > 0) {
-                s->as.struct_stmt.field_names = SAGE_ALLOC(sizeof(Token) * (size_t)stmt->as.struct_stmt.field_count);
-                s->as.struct_stmt.field_types = SAGE_ALLOC(sizeof(TypeAnnotation*) * (size_t)stmt->as.struct_stmt.field_count);
+                s->as.struct_stmt.field_names = ast_alloc(sizeof(Token) * (size_t)stmt->as.struct_stmt.field_count);
+                s->as.struct_stmt.field_types = ast_alloc(sizeof(TypeAnnotation*) * (size_t)stmt->as.struct_stmt.field_count);
                 for (int i = 0; i < stmt->as.struct_stmt.field_count; i++) {
                     s->as.struct_stmt.field_names[i] = clone_token(stmt->as.struct_stmt.field_names[i]);
                     s->as.struct_stmt.field_types[i] = clone_type_annotation(stmt->as.struct_stmt.field_types[i]);
@@ -344,7 +348,7 @@ Stmt* clone_stmt(const Stmt* stmt) {
             }
             s->as.struct_stmt.type_param_count = stmt->as.struct_stmt.type_param_count;
             if (stmt->as.struct_stmt.type_param_count > 0) {
-                s->as.struct_stmt.type_params = SAGE_ALLOC(sizeof(Token) * (size_t)stmt->as.struct_stmt.type_param_count);
+                s->as.struct_stmt.type_params = ast_alloc(sizeof(Token) * (size_t)stmt->as.struct_stmt.type_param_count);
                 for (int i = 0; i < stmt->as.struct_stmt.type_param_count; i++) {
                     s->as.struct_stmt.type_params[i] = clone_token(stmt->as.struct_stmt.type_params[i]);
                 }
@@ -357,7 +361,7 @@ Stmt* clone_stmt(const Stmt* stmt) {
             s->as.enum_stmt.name = clone_token(stmt->as.enum_stmt.name);
             s->as.enum_stmt.variant_count = stmt->as.enum_stmt.variant_count;
             if (stmt->as.enum_stmt.variant_count > 0) {
-                s->as.enum_stmt.variant_names = SAGE_ALLOC(sizeof(Token) * (size_t)stmt->as.enum_stmt.variant_count);
+                s->as.enum_stmt.variant_names = ast_alloc(sizeof(Token) * (size_t)stmt->as.enum_stmt.variant_count);
                 for (int i = 0; i < stmt->as.enum_stmt.variant_count; i++) {
                     s->as.enum_stmt.variant_names[i] = clone_token(stmt->as.enum_stmt.variant_names[i]);
                 }
@@ -378,7 +382,7 @@ Stmt* clone_stmt(const Stmt* stmt) {
             s->as.macro_def.name = clone_token(stmt->as.macro_def.name);
             s->as.macro_def.param_count = stmt->as.macro_def.param_count;
             if (stmt->as.macro_def.param_count > 0) {
-                s->as.macro_def.params = SAGE_ALLOC(sizeof(Token) * (size_t)stmt->as.macro_def.param_count);
+                s->as.macro_def.params = ast_alloc(sizeof(Token) * (size_t)stmt->as.macro_def.param_count);
                 for (int i = 0; i < stmt->as.macro_def.param_count; i++) {
                     s->as.macro_def.params[i] = clone_token(stmt->as.macro_def.params[i]);
                 }
@@ -422,13 +426,17 @@ extern Stmt* pass_constfold(Stmt* program, PassContext* ctx);
 extern Stmt* pass_dce(Stmt* program, PassContext* ctx);
 extern Stmt* pass_inline(Stmt* program, PassContext* ctx);
 extern Stmt* pass_safety(Stmt* program, PassContext* ctx);
+extern Stmt* pass_ssa(Stmt* program, PassContext* ctx);
+extern Stmt* pass_loop(Stmt* program, PassContext* ctx);
 
 static PassEntry g_passes[] = {
     { "typecheck",  pass_typecheck, 0 },  // always run type inference
     { "safety",     pass_safety,    0 },  // always run safety analysis
     { "constfold",  pass_constfold, 1 },  // -O1+
+    { "ssa",        pass_ssa,       2 },  // -O2+: SCCP, copy prop, GVN, LICM (see ssa.h)
     { "dce",        pass_dce,       2 },  // -O2+
-    { "inline",     pass_inline,    3 },  // -O3 only
+    { "inline",     pass_inline,    2 },  // -O2+, size budget per level (see inline.c)
+    { "loop",       pass_loop,      1 },  // -O1+: counted range loops; -O2+: hoisting, strength reduction
 };
 
 static const int g_pass_count = (int)(sizeof(g_passes) / sizeof(g_passes[0]));
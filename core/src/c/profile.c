@@ -0,0 +1,430 @@
+#include "profile.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gc.h"
+#include "sage_thread.h"
+
+// ============================================================================
+// Execution Profiles
+//
+// One flat table of sites with an open-addressing index keyed by
+// (kind, line, column). The interpreter records into it while the script
+// runs; profile_write() dumps it as text, one site per line:
+//
+//   # sage profile v1
+//   source app.sage 9c1e2f0a55d3b671
+//   func 12:6 fib calls=21891 args=Int ret=Int
+//   branch 13:10 taken=10946 not_taken=10945
+//   loop 30:11 entries=1 iterations=1000
+//   call 41:9 hits=5000 class=Circle
+//
+// `class=-` marks a plain call site, `class=*` a polymorphic method call.
+// Only the thread that created the profile records; async procs running on
+// their own threads are not profiled.
+// ============================================================================
+
+static const char* profile_basename(const char* path) {
+    const char* slash = strrchr(path, '/');
+    return slash ? slash + 1 : path;
+}
+
+static uint64_t profile_checksum(const char* text) {
+    uint64_t h = 1469598103934665603ULL;
+    for (const unsigned char* p = (const unsigned char*)text; *p; p++) {
+        h ^= *p;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+SageProfile* profile_new(const char* source_path, const char* source_text) {
+    SageProfile* profile = SAGE_ALLOC(sizeof(SageProfile));
+    memset(profile, 0, sizeof(SageProfile));
+    profile->source = SAGE_STRDUP(profile_basename(source_path));
+    profile->checksum = source_text ? profile_checksum(source_text) : 0;
+    profile->owner = sage_thread_id();
+    return profile;
+}
+
+void profile_free(SageProfile* profile) {
+    if (!profile) return;
+    for (int i = 0; i < profile->count; i++) free(profile->sites[i].name);
+    free(profile->sites);
+    free(profile->index);
+    free(profile->source);
+    free(profile);
+}
+
+// Sites of imported modules share line numbers with the script, so every
+// lookup first checks that the token comes from the profiled file.
+static int profile_covers(const SageProfile* profile, const Token* at) {
+    if (!at || !at->filename || at->length == 0) return 0;
+    if (at->filename == profile->last_file) return 1;
+    if (strcmp(profile_basename(at->filename), profile->source) != 0) return 0;
+    ((SageProfile*)profile)->last_file = at->filename;
+    return 1;
+}
+
+static uint32_t profile_hash(ProfileSiteKind kind, int line, int column) {
+    uint32_t h = (uint32_t)kind * 2654435761u;
+    h ^= (uint32_t)line * 40503u + (uint32_t)column;
+    h ^= h >> 15;
+    h *= 2246822519u;
+    h ^= h >> 13;
+    return h;
+}
+
+static int profile_lookup(const SageProfile* profile, ProfileSiteKind kind, int line, int column) {
+    if (profile->index_capacity == 0) return -1;
+    uint32_t mask = (uint32_t)profile->index_capacity - 1;
+    for (uint32_t slot = profile_hash(kind, line, column) & mask;; slot = (slot + 1) & mask) {
+        int i = profile->index[slot];
+        if (i < 0) return -1;
+        const ProfileSite* s = &profile->sites[i];
+        if (s->kind == kind && s->line == line && s->column == column) return i;
+    }
+}
+
+static void profile_reindex(SageProfile* profile, int capacity) {
+    free(profile->index);
+    profile->index = SAGE_ALLOC(sizeof(int) * (size_t)capacity);
+    for (int i = 0; i < capacity; i++) profile->index[i] = -1;
+    profile->index_capacity = capacity;
+    uint32_t mask = (uint32_t)capacity - 1;
+    for (int i = 0; i < profile->count; i++) {
+        const ProfileSite* s = &profile->sites[i];
+        uint32_t slot = profile_hash(s->kind, s->line, s->column) & mask;
+        while (profile->index[slot] >= 0) slot = (slot + 1) & mask;
+        profile->index[slot] = i;
+    }
+}
+
+static ProfileSite* profile_site(SageProfile* profile, ProfileSiteKind kind, int line, int column) {
+    int i = profile_lookup(profile, kind, line, column);
+    if (i >= 0) return &profile->sites[i];
+
+    if (profile->count == profile->capacity) {
+        profile->capacity = profile->capacity ? profile->capacity * 2 : 64;
+        profile->sites = SAGE_REALLOC(profile->sites, sizeof(ProfileSite) * (size_t)profile->capacity);
+    }
+    ProfileSite* s = &profile->sites[profile->count++];
+    memset(s, 0, sizeof(ProfileSite));
+    s->kind = kind;
+    s->line = line;
+    s->column = column;
+    if (profile->count * 2 > profile->index_capacity) {
+        profile_reindex(profile, profile->index_capacity ? profile->index_capacity * 2 : 128);
+    } else {
+        uint32_t mask = (uint32_t)profile->index_capacity - 1;
+        uint32_t slot = profile_hash(kind, line, column) & mask;
+        while (profile->index[slot] >= 0) slot = (slot + 1) & mask;
+        profile->index[slot] = profile->count - 1;
+    }
+    return s;
+}
+
+// Binary operators anchor on the operator, so folding either operand keeps
+// the key; calls anchor on the callee's name.
+const Token* profile_anchor(const Expr* expr) {
+    if (!expr) return NULL;
+    switch (expr->type) {
+        case EXPR_BINARY:   return &expr->as.binary.op;
+        case EXPR_VARIABLE: return &expr->as.variable.name;
+        case EXPR_GET:      return &expr->as.get.property;
+        case EXPR_SET:      return &expr->as.set.property;
+        case EXPR_CALL:     return profile_anchor(expr->as.call.callee);
+        case EXPR_INDEX:    return profile_anchor(expr->as.index.array);
+        default:            return NULL;
+    }
+}
+
+// ============================================================================
+// Type Feedback
+// ============================================================================
+
+static JitTypeTag profile_classify(Value v) {
+    switch (v.type) {
+        case VAL_NUMBER: {
+            double d = v.as.number;
+            if (d == (double)(int64_t)d && d >= -2147483648.0 && d <= 2147483647.0) return JIT_TYPE_INT;
+            return JIT_TYPE_FLOAT;
+        }
+        case VAL_STRING: return JIT_TYPE_STRING;
+        case VAL_BOOL:   return JIT_TYPE_BOOL;
+        case VAL_NIL:    return JIT_TYPE_NIL;
+        case VAL_ARRAY:  return JIT_TYPE_ARRAY;
+        case VAL_DICT:   return JIT_TYPE_DICT;
+        default:         return JIT_TYPE_MIXED;
+    }
+}
+
+static JitTypeTag profile_merge(JitTypeTag seen, JitTypeTag observed) {
+    if (seen == JIT_TYPE_UNKNOWN || seen == observed) return observed;
+    return JIT_TYPE_MIXED;
+}
+
+static const char* const g_type_names[] = {
+    "?", "Int", "Float", "String", "Bool", "Array", "Dict", "Nil", "Mixed",
+};
+
+const char* profile_type_name(JitTypeTag tag) {
+    if ((int)tag < 0 || (int)tag > JIT_TYPE_MIXED) return "?";
+    return g_type_names[tag];
+}
+
+static JitTypeTag profile_parse_type(const char* text, size_t len) {
+    for (int t = 0; t <= JIT_TYPE_MIXED; t++) {
+        if (strlen(g_type_names[t]) == len && memcmp(g_type_names[t], text, len) == 0) return (JitTypeTag)t;
+    }
+    return JIT_TYPE_UNKNOWN;
+}
+
+// ============================================================================
+// Recording
+// ============================================================================
+
+static int profile_recording(const SageProfile* profile, const Token* at) {
+    return profile->owner == sage_thread_id() && profile_covers(profile, at);
+}
+
+void profile_record_call(SageProfile* profile, const ProcStmt* proc, int argc, const Value* args) {
+    if (!profile_recording(profile, &proc->name)) return;
+    ProfileSite* s = profile_site(profile, PROFILE_FUNC, proc->name.line, proc->name.column);
+    if (!s->name) {
+        s->name = SAGE_ALLOC((size_t)proc->name.length + 1);
+        memcpy(s->name, proc->name.start, (size_t)proc->name.length);
+        s->name[proc->name.length] = '\0';
+    }
+    s->count++;
+    if (argc > PROFILE_MAX_PARAMS) argc = PROFILE_MAX_PARAMS;
+    if (argc > s->param_count) s->param_count = argc;
+    for (int i = 0; i < argc; i++) s->arg_types[i] = profile_merge(s->arg_types[i], profile_classify(args[i]));
+}
+
+void profile_record_return(SageProfile* profile, const ProcStmt* proc, Value result) {
+    if (!profile_recording(profile, &proc->name)) return;
+    int i = profile_lookup(profile, PROFILE_FUNC, proc->name.line, proc->name.column);
+    if (i >= 0) profile->sites[i].return_type = profile_merge(profile->sites[i].return_type, profile_classify(result));
+}
+
+void profile_record_branch(SageProfile* profile, const Expr* condition, int taken) {
+    const Token* at = profile_anchor(condition);
+    if (!profile_recording(profile, at)) return;
+    ProfileSite* s = profile_site(profile, PROFILE_BRANCH, at->line, at->column);
+    if (taken) s->count++;
+    else s->other++;
+}
+
+int profile_loop_enter(SageProfile* profile, const Token* anchor) {
+    if (!profile_recording(profile, anchor)) return -1;
+    ProfileSite* s = profile_site(profile, PROFILE_LOOP, anchor->line, anchor->column);
+    s->count++;
+    return (int)(s - profile->sites);
+}
+
+void profile_loop_iterate(SageProfile* profile, int loop) {
+    if (loop >= 0) profile->sites[loop].other++;
+}
+
+void profile_record_site(SageProfile* profile, const Expr* callee, const char* class_name, int class_len) {
+    const Token* at = profile_anchor(callee);
+    if (!profile_recording(profile, at)) return;
+    ProfileSite* s = profile_site(profile, PROFILE_CALL, at->line, at->column);
+    s->count++;
+    if (!class_name || s->polymorphic) return;
+    if (!s->name) {
+        s->name = SAGE_ALLOC((size_t)class_len + 1);
+        memcpy(s->name, class_name, (size_t)class_len);
+        s->name[class_len] = '\0';
+    } else if ((int)strlen(s->name) != class_len || memcmp(s->name, class_name, (size_t)class_len) != 0) {
+        s->polymorphic = 1;
+        free(s->name);
+        s->name = NULL;
+    }
+}
+
+// ============================================================================
+// Serialization
+// ============================================================================
+
+int profile_write(const SageProfile* profile, const char* path) {
+    FILE* f = fopen(path, "w");
+    if (!f) {
+        fprintf(stderr, "Could not write profile '%s'.\n", path);
+        return 0;
+    }
+    fprintf(f, "# sage profile v1\n");
+    fprintf(f, "source %s %016" PRIx64 "\n", profile->source, profile->checksum);
+    for (int i = 0; i < profile->count; i++) {
+        const ProfileSite* s = &profile->sites[i];
+        switch (s->kind) {
+            case PROFILE_FUNC:
+                fprintf(f, "func %d:%d %s calls=%" PRId64 " args=", s->line, s->column, s->name, s->count);
+                if (s->param_count == 0) fputc('-', f);
+                for (int a = 0; a < s->param_count; a++)
+                    fprintf(f, "%s%s", a ? "," : "", profile_type_name(s->arg_types[a]));
+                fprintf(f, " ret=%s\n", profile_type_name(s->return_type));
+                break;
+            case PROFILE_BRANCH:
+                fprintf(f, "branch %d:%d taken=%" PRId64 " not_taken=%" PRId64 "\n",
+                        s->line, s->column, s->count, s->other);
+                break;
+            case PROFILE_LOOP:
+                fprintf(f, "loop %d:%d entries=%" PRId64 " iterations=%" PRId64 "\n",
+                        s->line, s->column, s->count, s->other);
+                break;
+            case PROFILE_CALL:
+                fprintf(f, "call %d:%d hits=%" PRId64 " class=%s\n", s->line, s->column, s->count,
+                        s->polymorphic ? "*" : (s->name ? s->name : "-"));
+                break;
+        }
+    }
+    return fclose(f) == 0;
+}
+
+static int profile_parse_site(SageProfile* profile, char* line) {
+    char kind[16];
+    int ln, col, used = 0;
+    if (sscanf(line, "%15s %d:%d %n", kind, &ln, &col, &used) != 3) return 0;
+    char* rest = line + used;
+    ProfileSite* s;
+
+    if (strcmp(kind, "func") == 0) {
+        char name[256], args[256], ret[32];
+        long long calls;
+        if (sscanf(rest, "%255s calls=%lld args=%255s ret=%31s", name, &calls, args, ret) != 4) return 0;
+        s = profile_site(profile, PROFILE_FUNC, ln, col);
+        s->name = SAGE_STRDUP(name);
+        s->count = calls;
+        if (strcmp(args, "-") != 0) {
+            for (char* a = args; *a && s->param_count < PROFILE_MAX_PARAMS;) {
+                size_t len = strcspn(a, ",");
+                s->arg_types[s->param_count++] = profile_parse_type(a, len);
+                a += len;
+                if (*a == ',') a++;
+            }
+        }
+        s->return_type = profile_parse_type(ret, strlen(ret));
+    } else if (strcmp(kind, "branch") == 0 || strcmp(kind, "loop") == 0) {
+        long long a, b;
+        const char* fmt = kind[0] == 'b' ? "taken=%lld not_taken=%lld" : "entries=%lld iterations=%lld";
+        if (sscanf(rest, fmt, &a, &b) != 2) return 0;
+        s = profile_site(profile, kind[0] == 'b' ? PROFILE_BRANCH : PROFILE_LOOP, ln, col);
+        s->count = a;
+        s->other = b;
+    } else if (strcmp(kind, "call") == 0) {
+        char cls[256];
+        long long hits;
+        if (sscanf(rest, "hits=%lld class=%255s", &hits, cls) != 2) return 0;
+        s = profile_site(profile, PROFILE_CALL, ln, col);
+        s->count = hits;
+        if (strcmp(cls, "*") == 0) s->polymorphic = 1;
+        else if (strcmp(cls, "-") != 0) s->name = SAGE_STRDUP(cls);
+    } else {
+        return 0;
+    }
+    return 1;
+}
+
+SageProfile* profile_read(const char* path) {
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "Could not open profile '%s'.\n", path);
+        return NULL;
+    }
+    SageProfile* profile = NULL;
+    char line[1024];
+    int lineno = 0;
+    while (fgets(line, sizeof(line), f)) {
+        lineno++;
+        if (line[0] == '#' || line[0] == '\n') continue;
+        if (!profile) {
+            char source[512];
+            uint64_t checksum;
+            if (sscanf(line, "source %511s %" SCNx64, source, &checksum) != 2) break;
+            profile = profile_new(source, NULL);
+            profile->checksum = checksum;
+            continue;
+        }
+        if (!profile_parse_site(profile, line)) {
+            fprintf(stderr, "%s:%d: malformed profile entry.\n", path, lineno);
+            profile_free(profile);
+            fclose(f);
+            return NULL;
+        }
+    }
+    fclose(f);
+    if (!profile) fprintf(stderr, "%s: not a sage profile.\n", path);
+    return profile;
+}
+
+// ============================================================================
+// Queries
+// ============================================================================
+
+static SageProfile* g_active_profile = NULL;
+
+int profile_use(const char* path, const char* source_path, const char* source_text) {
+    SageProfile* profile = profile_read(path);
+    if (!profile) return 0;
+    if (strcmp(profile->source, profile_basename(source_path)) != 0 ||
+        profile->checksum != profile_checksum(source_text)) {
+        fprintf(stderr, "Warning: profile '%s' was recorded for a different version of %s; ignoring it.\n",
+                path, source_path);
+        profile_free(profile);
+        return 0;
+    }
+    profile_free(g_active_profile);
+    g_active_profile = profile;
+    return 1;
+}
+
+const SageProfile* profile_active(void) {
+    return g_active_profile;
+}
+
+const ProfileSite* profile_find(const SageProfile* profile, ProfileSiteKind kind, const Token* at) {
+    if (!profile || !profile_covers(profile, at)) return NULL;
+    int i = profile_lookup(profile, kind, at->line, at->column);
+    return i >= 0 ? &profile->sites[i] : NULL;
+}
+
+ProfileHeat profile_function_heat(const SageProfile* profile, const ProcStmt* proc) {
+    if (!profile || !profile_covers(profile, &proc->name)) return PROFILE_HEAT_UNKNOWN;
+    const ProfileSite* s = profile_find(profile, PROFILE_FUNC, &proc->name);
+    if (!s || s->count == 0) return PROFILE_HEAT_COLD;
+    return s->count >= PROFILE_HOT_CALLS ? PROFILE_HEAT_HOT : PROFILE_HEAT_WARM;
+}
+
+static int profile_bias(int64_t yes, int64_t no) {
+    if (yes + no < PROFILE_MIN_SAMPLES) return 0;
+    if (yes >= (yes + no) * 9 / 10) return 1;
+    if (no >= (yes + no) * 9 / 10) return -1;
+    return 0;
+}
+
+int profile_branch_bias(const SageProfile* profile, const Expr* condition) {
+    const ProfileSite* s = profile_find(profile, PROFILE_BRANCH, profile_anchor(condition));
+    return s ? profile_bias(s->count, s->other) : 0;
+}
+
+// A loop condition is evaluated once per iteration plus once on exit.
+int profile_loop_bias(const SageProfile* profile, const Token* anchor) {
+    const ProfileSite* s = profile_find(profile, PROFILE_LOOP, anchor);
+    return s ? profile_bias(s->other, s->count) : 0;
+}
+
+const char* profile_monomorphic_class(const SageProfile* profile, const Expr* callee) {
+    const ProfileSite* s = profile_find(profile, PROFILE_CALL, profile_anchor(callee));
+    return s && !s->polymorphic ? s->name : NULL;
+}
+
+int64_t profile_site_hits(const SageProfile* profile, const Expr* callee) {
+    const Token* at = profile_anchor(callee);
+    if (!profile || !profile_covers(profile, at)) return -1;
+    const ProfileSite* s = profile_find(profile, PROFILE_CALL, at);
+    return s ? s->count : 0;
+}
@@ -13,6 +13,7 @@
 #include <sys/syscall.h>
 #include <pthread.h>
 #define pthread_setaffinity_np(thread, size, set) syscall(__NR_sched_setaffinity, 0, size, set)
+#define pthread_getaffinity_np(thread, size, set) (syscall(__NR_sched_getaffinity, 0, size, set) < 0 ? -1 : 0)
 #endif
 
 
@@ -44,6 +45,10 @@ int sage_thread_join(sage_thread_t thread, void** retval) {
     return pthread_join(thread, retval);
 }
 
+int sage_thread_detach(sage_thread_t thread) {
+    return pthread_detach(thread);
+}
+
 uintptr_t sage_thread_id(void) {
     return (uintptr_t)pthread_self();
 }
@@ -152,9 +157,30 @@ int sage_thread_set_affinity(int core_id) {
 int sage_thread_get_core(void) {
     return sched_getcpu();
 }
+
+int sage_thread_get_affinity(int* cores, int max) {
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    int n = 0;
+    if (pthread_getaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset) == 0) {
+        for (int i = 0; i < CPU_SETSIZE && n < max; i++) {
+            if (CPU_ISSET(i, &cpuset)) cores[n++] = i;
+        }
+    }
+    if (n > 0) return n;
+    int count = sage_cpu_count();
+    for (int i = 0; i < count && n < max; i++) cores[n++] = i;
+    return n;
+}
 #else
 int sage_thread_set_affinity(int core_id) { (void)core_id; return -1; }
 int sage_thread_get_core(void) { return -1; }
+int sage_thread_get_affinity(int* cores, int max) {
+    int n = 0;
+    int count = sage_cpu_count();
+    for (int i = 0; i < count && n < max; i++) cores[n++] = i;
+    return n;
+}
 #endif
 
 // ============================================================================
@@ -178,6 +204,11 @@ int sage_thread_join(sage_thread_t thread, void** retval) {
     return -1;  // Failure
 }
 
+int sage_thread_detach(sage_thread_t thread) {
+    (void)thread;
+    return -1;  // Failure
+}
+
 uintptr_t sage_thread_id(void) {
     return 0;  // Single core ID
 }
@@ -225,6 +256,7 @@ int sage_cpu_physical_cores(void) { return 1; }
 int sage_cpu_has_hyperthreading(void) { return 0; }
 int sage_thread_set_affinity(int c) { (void)c; return -1; }
 int sage_thread_get_core(void) { return 0; }
+int sage_thread_get_affinity(int* cores, int max) { if (max > 0) cores[0] = 0; return max > 0 ? 1 : 0; }
 
 void sage_usleep(unsigned int usec) {
 #ifdef PICO_BUILD
@@ -113,7 +113,7 @@ int main(int argc, char** argv) {
     int ok = 0;
     pid_t pid = fork();
     if (pid == 0) {
-        char* sage_args[] = {"./sage", "--emit-vm", argv[1], "-o", tmp_svm, NULL};
+        char* sage_args[] = {"./sage", "--emit-vm-text", argv[1], "-o", tmp_svm, NULL};
         execvp(sage_args[0], sage_args);
         _exit(127);
     } else if (pid > 0) {
@@ -0,0 +1,1943 @@
+#include "ssa.h"
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "gc.h"
+#include "ast_arena.h"
+
+// ============================================================================
+// SSA Mid-Level IR
+//
+// Construction walks the structured AST once per function and keeps, for
+// every tracked variable, the SSA value it currently holds. `if` merges the
+// two branch states in a join block, loops get header phis for every
+// variable the loop writes, break/continue states are merged into the exit
+// and header. Pure operators are hash-consed while building, so two
+// occurrences of `a * b` over the same SSA operands share a value number.
+//
+// Every analysed expression is recorded as a site. The passes only annotate
+// sites; ssa_lower() then rewrites the AST in place:
+//   copyprop - remove trivial phis, redirect reads to the oldest variable
+//              holding the same value
+//   sccp     - sparse conditional constant propagation over the CFG
+//   gvn      - replace a recomputation with the variable that holds it
+//   licm     - move non-trapping numeric expressions whose operands do not
+//              change in a loop into a `let` in front of it
+// ============================================================================
+
+#define SSA_HIDDEN INT_MAX   // SsaSlot.depth of a variable out of scope
+
+struct SsaVar {
+    Token name;
+};
+
+typedef enum {
+    SITE_OTHER,
+    SITE_LITERAL,
+    SITE_VAR,
+    SITE_BINARY,
+    SITE_UNARY
+} SiteKind;
+
+typedef enum {
+    ACTION_NONE,
+    ACTION_CONST,       // SCCP: becomes a literal
+    ACTION_VARIABLE,    // copyprop/GVN: becomes a read of `holder`
+    ACTION_HOIST        // LICM: becomes a read of a temporary set before `hoist_loop`
+} SiteAction;
+
+struct SsaSite {
+    Expr* expr;
+    int value;
+    int block;
+    SiteKind kind;
+    int var;            // SITE_VAR: tracked variable read
+    int holder;         // Visible variable already holding `value`, or -1
+    int hoist_loop;     // Outermost loop the expression is invariant in, or -1
+    int kids[2];
+    int parent;
+    SiteAction action;
+    int dead;           // Inside a subtree an ancestor already rewrote
+    int safe;           // Non-trapping with scalar operand types
+};
+
+typedef struct {
+    int value;          // -1: not declared on this path
+    int depth;          // Block nesting of the declaration; SSA_HIDDEN out of scope
+    int serial;         // When the variable got its current value
+} SsaSlot;
+
+typedef struct {
+    int block;
+    int slot;
+    SsaSlot* state;
+} SsaEdge;
+
+struct SsaLoop {
+    Stmt* stmt;
+    int parent;
+    int level;
+    int header;
+    int depth;
+    SsaSlot* entry;
+    SsaEdge* breaks;
+    int break_count;
+    SsaEdge* continues;
+    int continue_count;
+};
+
+typedef struct {
+    SsaFunction* fn;
+    SsaSlot* state;
+    int cur;            // Current block, -1 after return/break/continue
+    int depth;
+    int loop;
+    int serial;
+} Builder;
+
+// ============================================================================
+// Name scanning
+// ============================================================================
+
+typedef struct {
+    Token* items;
+    int count;
+    int capacity;
+} NameList;
+
+static int token_eq(const Token* a, const Token* b) {
+    return a->length == b->length && memcmp(a->start, b->start, (size_t)a->length) == 0;
+}
+
+static int names_find(const NameList* list, const Token* name) {
+    for (int i = 0; i < list->count; i++) {
+        if (token_eq(&list->items[i], name)) return i;
+    }
+    return -1;
+}
+
+static void names_add(NameList* list, const Token* name) {
+    if (names_find(list, name) >= 0) return;
+    if (list->count == list->capacity) {
+        list->capacity = list->capacity ? list->capacity * 2 : 16;
+        list->items = SAGE_REALLOC(list->items, sizeof(Token) * (size_t)list->capacity);
+    }
+    list->items[list->count++] = *name;
+}
+
+typedef enum {
+    NAME_READ,
+    NAME_WRITE,     // x = ...
+    NAME_LET,
+    NAME_BIND,      // for variable, catch variable
+    NAME_DEF        // proc/class/struct/enum/trait/import names
+} NameKind;
+
+typedef struct NameWalk NameWalk;
+struct NameWalk {
+    void (*on_name)(NameWalk* walk, const Token* name, NameKind kind);
+    // Nested procs, lambdas and methods are not entered; this sees them.
+    void (*on_function)(NameWalk* walk, Token* params, int param_count, Stmt* body);
+    int in_for;         // Inside a for body (lets there are loop-local)
+    int in_barrier;     // Inside a construct the builder does not model
+    int in_short;       // Inside the right operand of and/or
+    NameList* names;
+    NameList* locals;
+    int* marks;         // collect_assigned(): per-variable flags
+    SsaFunction* fn;
+};
+
+static void walk_expr(NameWalk* walk, Expr* expr);
+static void walk_list(NameWalk* walk, Stmt* head);
+
+static void walk_name(NameWalk* walk, const Token* name, NameKind kind) {
+    if (walk->on_name != NULL) walk->on_name(walk, name, kind);
+}
+
+static void walk_c_name(NameWalk* walk, const char* name) {
+    if (name == NULL) return;
+    Token tok;
+    memset(&tok, 0, sizeof(tok));
+    tok.type = TOKEN_IDENTIFIER;
+    tok.start = name;
+    tok.length = (int)strlen(name);
+    walk_name(walk, &tok, NAME_DEF);
+}
+
+static void walk_function(NameWalk* walk, Token* params, int param_count, Stmt* body) {
+    if (walk->on_function != NULL) walk->on_function(walk, params, param_count, body);
+}
+
+static void walk_expr(NameWalk* walk, Expr* expr) {
+    if (expr == NULL) return;
+    switch (expr->type) {
+        case EXPR_BINARY: {
+            walk_expr(walk, expr->as.binary.left);
+            TokenType op = expr->as.binary.op.type;
+            int saved = walk->in_short;
+            if (op == TOKEN_AND || op == TOKEN_OR) walk->in_short = 1;
+            walk_expr(walk, expr->as.binary.right);
+            walk->in_short = saved;
+            break;
+        }
+        case EXPR_VARIABLE:
+            walk_name(walk, &expr->as.variable.name, NAME_READ);
+            break;
+        case EXPR_CALL:
+            walk_expr(walk, expr->as.call.callee);
+            for (int i = 0; i < expr->as.call.arg_count; i++) walk_expr(walk, expr->as.call.args[i]);
+            break;
+        case EXPR_ARRAY:
+            for (int i = 0; i < expr->as.array.count; i++) walk_expr(walk, expr->as.array.elements[i]);
+            break;
+        case EXPR_DICT:
+            for (int i = 0; i < expr->as.dict.count; i++) walk_expr(walk, expr->as.dict.values[i]);
+            break;
+        case EXPR_TUPLE:
+            for (int i = 0; i < expr->as.tuple.count; i++) walk_expr(walk, expr->as.tuple.elements[i]);
+            break;
+        case EXPR_INDEX:
+            walk_expr(walk, expr->as.index.array);
+            walk_expr(walk, expr->as.index.index);
+            break;
+        case EXPR_INDEX_SET:
+            walk_expr(walk, expr->as.index_set.array);
+            walk_expr(walk, expr->as.index_set.index);
+            walk_expr(walk, expr->as.index_set.value);
+            break;
+        case EXPR_SLICE:
+            walk_expr(walk, expr->as.slice.array);
+            walk_expr(walk, expr->as.slice.start);
+            walk_expr(walk, expr->as.slice.end);
+            break;
+        case EXPR_GET:
+            walk_expr(walk, expr->as.get.object);
+            break;
+        case EXPR_SET:
+            if (expr->as.set.object != NULL) {
+                walk_expr(walk, expr->as.set.object);
+                walk_expr(walk, expr->as.set.value);
+            } else {
+                walk_expr(walk, expr->as.set.value);
+                walk_name(walk, &expr->as.set.property, NAME_WRITE);
+            }
+            break;
+        case EXPR_AWAIT:
+            walk_expr(walk, expr->as.await.expression);
+            break;
+        case EXPR_COMPTIME: {
+            int saved = walk->in_barrier;
+            walk->in_barrier = 1;
+            walk_expr(walk, expr->as.comptime.expression);
+            walk->in_barrier = saved;
+            break;
+        }
+        case EXPR_PROC:
+            walk_function(walk, expr->as.proc_expr.params, expr->as.proc_expr.param_count,
+                          expr->as.proc_expr.body);
+            break;
+        case EXPR_NUMBER:
+        case EXPR_STRING:
+        case EXPR_BOOL:
+        case EXPR_NIL:
+        case EXPR_SUPER:
+            break;
+    }
+}
+
+static void walk_barrier_list(NameWalk* walk, Stmt* head) {
+    int saved = walk->in_barrier;
+    walk->in_barrier = 1;
+    walk_list(walk, head);
+    walk->in_barrier = saved;
+}
+
+static void walk_stmt(NameWalk* walk, Stmt* stmt) {
+    switch (stmt->type) {
+        case STMT_PRINT:
+            walk_expr(walk, stmt->as.print.expression);
+            break;
+        case STMT_EXPRESSION:
+            walk_expr(walk, stmt->as.expression);
+            break;
+        case STMT_LET:
+            walk_expr(walk, stmt->as.let.initializer);
+            walk_name(walk, &stmt->as.let.name, NAME_LET);
+            break;
+        case STMT_IF:
+            walk_expr(walk, stmt->as.if_stmt.condition);
+            walk_list(walk, stmt->as.if_stmt.then_branch);
+            walk_list(walk, stmt->as.if_stmt.else_branch);
+            break;
+        case STMT_BLOCK:
+            walk_list(walk, stmt->as.block.statements);
+            break;
+        case STMT_WHILE:
+            walk_expr(walk, stmt->as.while_stmt.condition);
+            walk_list(walk, stmt->as.while_stmt.body);
+            break;
+        case STMT_PROC:
+        case STMT_ASYNC_PROC: {
+            walk_name(walk, &stmt->as.proc.name, NAME_DEF);
+            int saved = walk->in_barrier;
+            walk->in_barrier = 1;
+            for (int i = 0; i < stmt->as.proc.param_count; i++) {
+                if (stmt->as.proc.defaults != NULL) walk_expr(walk, stmt->as.proc.defaults[i]);
+            }
+            walk->in_barrier = saved;
+            walk_function(walk, stmt->as.proc.params, stmt->as.proc.param_count, stmt->as.proc.body);
+            break;
+        }
+        case STMT_FOR: {
+            walk_expr(walk, stmt->as.for_stmt.iterable);
+            walk_name(walk, &stmt->as.for_stmt.variable, NAME_BIND);
+            int saved = walk->in_for;
+            walk->in_for = 1;
+            walk_list(walk, stmt->as.for_stmt.body);
+            walk->in_for = saved;
+            break;
+        }
+        case STMT_RETURN:
+            walk_expr(walk, stmt->as.ret.value);
+            break;
+        case STMT_RAISE:
+            walk_expr(walk, stmt->as.raise.exception);
+            break;
+        case STMT_CLASS:
+            walk_name(walk, &stmt->as.class_stmt.name, NAME_DEF);
+            for (Stmt* m = stmt->as.class_stmt.methods; m != NULL; m = m->next) {
+                if (m->type == STMT_PROC || m->type == STMT_ASYNC_PROC) {
+                    walk_function(walk, m->as.proc.params, m->as.proc.param_count, m->as.proc.body);
+                }
+            }
+            break;
+        case STMT_MATCH: {
+            int saved = walk->in_barrier;
+            walk->in_barrier = 1;
+            walk_expr(walk, stmt->as.match_stmt.value);
+            for (int i = 0; i < stmt->as.match_stmt.case_count; i++) {
+                CaseClause* c = stmt->as.match_stmt.cases[i];
+                walk_expr(walk, c->pattern);
+                walk_expr(walk, c->guard);
+                walk_list(walk, c->body);
+            }
+            walk_list(walk, stmt->as.match_stmt.default_case);
+            walk->in_barrier = saved;
+            break;
+        }
+        case STMT_DEFER: {
+            int saved = walk->in_barrier;
+            walk->in_barrier = 1;
+            if (stmt->as.defer.statement != NULL) walk_stmt(walk, stmt->as.defer.statement);
+            walk->in_barrier = saved;
+            break;
+        }
+        case STMT_TRY:
+            walk_barrier_list(walk, stmt->as.try_stmt.try_block);
+            for (int i = 0; i < stmt->as.try_stmt.catch_count; i++) {
+                CatchClause* c = stmt->as.try_stmt.catches[i];
+                walk_name(walk, &c->exception_var, NAME_BIND);
+                walk_barrier_list(walk, c->body);
+            }
+            walk_barrier_list(walk, stmt->as.try_stmt.finally_block);
+            break;
+        case STMT_YIELD: {
+            int saved = walk->in_barrier;
+            walk->in_barrier = 1;
+            walk_expr(walk, stmt->as.yield_stmt.value);
+            walk->in_barrier = saved;
+            break;
+        }
+        case STMT_IMPORT:
+            walk_c_name(walk, stmt->as.import.module_name);
+            walk_c_name(walk, stmt->as.import.alias);
+            for (int i = 0; i < stmt->as.import.item_count; i++) {
+                walk_c_name(walk, stmt->as.import.items[i]);
+                if (stmt->as.import.item_aliases != NULL) walk_c_name(walk, stmt->as.import.item_aliases[i]);
+            }
+            break;
+        case STMT_STRUCT:
+            walk_name(walk, &stmt->as.struct_stmt.name, NAME_DEF);
+            break;
+        case STMT_ENUM:
+            walk_name(walk, &stmt->as.enum_stmt.name, NAME_DEF);
+            break;
+        case STMT_TRAIT:
+            walk_name(walk, &stmt->as.trait_stmt.name, NAME_DEF);
+            break;
+        case STMT_COMPTIME:
+            walk_barrier_list(walk, stmt->as.comptime.body);
+            break;
+        case STMT_MACRO_DEF:
+            walk_name(walk, &stmt->as.macro_def.name, NAME_DEF);
+            walk_barrier_list(walk, stmt->as.macro_def.body);
+            break;
+        case STMT_BREAK:
+        case STMT_CONTINUE:
+            break;
+    }
+}
+
+static void walk_list(NameWalk* walk, Stmt* head) {
+    for (Stmt* s = head; s != NULL; s = s->next) walk_stmt(walk, s);
+}
+
+// --- Every name mentioned anywhere, nested functions included ---------------
+
+static void mention_name(NameWalk* walk, const Token* name, NameKind kind) {
+    (void)kind;
+    names_add(walk->names, name);
+}
+
+static void mention_function(NameWalk* walk, Token* params, int param_count, Stmt* body) {
+    for (int i = 0; i < param_count; i++) names_add(walk->names, &params[i]);
+    walk_list(walk, body);
+}
+
+// --- Locals of one function: its parameters and lets -----------------------
+
+static void local_name(NameWalk* walk, const Token* name, NameKind kind) {
+    if (kind == NAME_LET) names_add(walk->names, name);
+}
+
+static void collect_locals(NameList* out, Token* params, int param_count, Stmt* body) {
+    NameWalk walk;
+    memset(&walk, 0, sizeof(walk));
+    walk.on_name = local_name;
+    walk.names = out;
+    for (int i = 0; i < param_count; i++) names_add(out, &params[i]);
+    walk_list(&walk, body);
+}
+
+// --- Script mode: names a procedure writes outside its own locals ----------
+
+static void escape_name(NameWalk* walk, const Token* name, NameKind kind) {
+    if (kind == NAME_WRITE && names_find(walk->locals, name) < 0) names_add(walk->names, name);
+}
+
+static void escape_function(NameWalk* walk, Token* params, int param_count, Stmt* body) {
+    NameList locals = { NULL, 0, 0 };
+    collect_locals(&locals, params, param_count, body);
+    NameWalk inner;
+    memset(&inner, 0, sizeof(inner));
+    inner.on_name = escape_name;
+    inner.on_function = escape_function;
+    inner.names = walk->names;
+    inner.locals = &locals;
+    walk_list(&inner, body);
+    free(locals.items);
+}
+
+// --- Exclusions for the function being built --------------------------------
+
+static void exclude_name(NameWalk* walk, const Token* name, NameKind kind) {
+    switch (kind) {
+        case NAME_LET:
+            names_add(walk->locals, name);
+            if (walk->in_for || walk->in_barrier) names_add(walk->names, name);
+            break;
+        case NAME_WRITE:
+            if (walk->in_barrier || walk->in_short) names_add(walk->names, name);
+            break;
+        case NAME_BIND:
+        case NAME_DEF:
+            names_add(walk->names, name);
+            break;
+        case NAME_READ:
+            break;
+    }
+}
+
+static void exclude_captures(NameWalk* walk, Token* params, int param_count, Stmt* body) {
+    // A nested proc may read or write any local it names at any time.
+    NameWalk inner;
+    memset(&inner, 0, sizeof(inner));
+    inner.on_name = mention_name;
+    inner.on_function = mention_function;
+    inner.names = walk->names;
+    mention_function(&inner, params, param_count, body);
+}
+
+// --- Variables a loop writes -----------------------------------------------
+
+static int var_index(const SsaFunction* fn, const Token* name) {
+    for (int i = 0; i < fn->var_count; i++) {
+        if (token_eq(&fn->vars[i].name, name)) return i;
+    }
+    return -1;
+}
+
+static void assigned_name(NameWalk* walk, const Token* name, NameKind kind) {
+    if (kind != NAME_WRITE && kind != NAME_LET) return;
+    int var = var_index(walk->fn, name);
+    if (var >= 0) walk->marks[var] = 1;
+}
+
+static void collect_assigned(SsaFunction* fn, Stmt* loop, int* marks) {
+    NameWalk walk;
+    memset(&walk, 0, sizeof(walk));
+    walk.on_name = assigned_name;
+    walk.fn = fn;
+    walk.marks = marks;
+    if (loop->type == STMT_WHILE) {
+        walk_expr(&walk, loop->as.while_stmt.condition);
+        walk_list(&walk, loop->as.while_stmt.body);
+    } else {
+        walk_list(&walk, loop->as.for_stmt.body);
+    }
+}
+
+// ============================================================================
+// IR storage
+// ============================================================================
+
+static int find_value(const SsaFunction* fn, int id) {
+    while (fn->values[id].forward >= 0) id = fn->values[id].forward;
+    return id;
+}
+
+static int new_block(SsaFunction* fn) {
+    if (fn->block_count == fn->block_capacity) {
+        fn->block_capacity = fn->block_capacity ? fn->block_capacity * 2 : 16;
+        fn->blocks = SAGE_REALLOC(fn->blocks, sizeof(SsaBlock) * (size_t)fn->block_capacity);
+    }
+    SsaBlock* block = &fn->blocks[fn->block_count];
+    memset(block, 0, sizeof(*block));
+    block->cond = -1;
+    block->succ[0] = -1;
+    block->succ[1] = -1;
+    return fn->block_count++;
+}
+
+static int new_value(SsaFunction* fn, SsaOpcode opcode, int block) {
+    if (fn->value_count == fn->value_capacity) {
+        fn->value_capacity = fn->value_capacity ? fn->value_capacity * 2 : 64;
+        fn->values = SAGE_REALLOC(fn->values, sizeof(SsaValue) * (size_t)fn->value_capacity);
+    }
+    SsaValue* v = &fn->values[fn->value_count];
+    memset(v, 0, sizeof(*v));
+    v->opcode = opcode;
+    v->block = block;
+    v->args[0] = -1;
+    v->args[1] = -1;
+    v->phi_var = -1;
+    v->forward = -1;
+    v->type = SSA_TYPE_TOP;
+    v->lattice = SSA_LAT_TOP;
+    return fn->value_count++;
+}
+
+static int new_opaque(Builder* b) {
+    int id = new_value(b->fn, SSA_OPAQUE, b->cur);
+    b->fn->values[id].type = SSA_TYPE_ANY;
+    b->fn->values[id].lattice = SSA_LAT_BOTTOM;
+    return id;
+}
+
+// --- Hash-consing of constants and pure operators ---------------------------
+
+static unsigned int value_hash(const SsaValue* v) {
+    unsigned long long bits = 0;
+    memcpy(&bits, &v->number, sizeof(bits));
+    unsigned long long h = 1469598103934665603ull;
+    unsigned long long parts[6] = {
+        (unsigned long long)v->opcode, (unsigned long long)v->op,
+        (unsigned long long)(unsigned int)v->args[0], (unsigned long long)(unsigned int)v->args[1],
+        bits, ((unsigned long long)v->type << 1) | (unsigned long long)(v->boolean != 0)
+    };
+    for (int i = 0; i < 6; i++) {
+        h ^= parts[i];
+        h *= 1099511628211ull;
+    }
+    return (unsigned int)(h ^ (h >> 32));
+}
+
+static int value_same(const SsaValue* a, const SsaValue* b) {
+    if (a->opcode != b->opcode) return 0;
+    if (a->opcode == SSA_CONST) {
+        return a->type == b->type && a->boolean == b->boolean &&
+               memcmp(&a->number, &b->number, sizeof(double)) == 0;
+    }
+    return a->op == b->op && a->args[0] == b->args[0] && a->args[1] == b->args[1];
+}
+
+static void index_insert(SsaFunction* fn, int id) {
+    unsigned int mask = (unsigned int)fn->value_index_capacity - 1;
+    unsigned int slot = value_hash(&fn->values[id]) & mask;
+    while (fn->value_index[slot] >= 0) slot = (slot + 1) & mask;
+    fn->value_index[slot] = id;
+}
+
+// Returns an existing value equal to `probe`, or -1 after reserving room.
+static int index_lookup(SsaFunction* fn, const SsaValue* probe) {
+    if ((fn->value_index_count + 1) * 10 > fn->value_index_capacity * 7) {
+        int old_capacity = fn->value_index_capacity;
+        int* old = fn->value_index;
+        fn->value_index_capacity = old_capacity ? old_capacity * 2 : 64;
+        fn->value_index = SAGE_ALLOC(sizeof(int) * (size_t)fn->value_index_capacity);
+        for (int i = 0; i < fn->value_index_capacity; i++) fn->value_index[i] = -1;
+        for (int i = 0; i < old_capacity; i++) {
+            if (old[i] >= 0) index_insert(fn, old[i]);
+        }
+        free(old);
+    }
+    unsigned int mask = (unsigned int)fn->value_index_capacity - 1;
+    unsigned int slot = value_hash(probe) & mask;
+    while (fn->value_index[slot] >= 0) {
+        if (value_same(&fn->values[fn->value_index[slot]], probe)) return fn->value_index[slot];
+        slot = (slot + 1) & mask;
+    }
+    return -1;
+}
+
+static int intern_value(Builder* b, const SsaValue* probe) {
+    int existing = index_lookup(b->fn, probe);
+    if (existing >= 0) return existing;
+    int id = new_value(b->fn, probe->opcode, b->cur);
+    SsaValue* v = &b->fn->values[id];
+    v->op = probe->op;
+    v->args[0] = probe->args[0];
+    v->args[1] = probe->args[1];
+    if (probe->opcode == SSA_CONST) {
+        v->type = probe->type;
+        v->lattice = SSA_LAT_CONST;
+        v->number = probe->number;
+        v->boolean = probe->boolean;
+    }
+    index_insert(b->fn, id);
+    b->fn->value_index_count++;
+    return id;
+}
+
+// ============================================================================
+// CFG construction
+// ============================================================================
+
+static SsaSlot* copy_state(const Builder* b, const SsaSlot* state) {
+    size_t size = sizeof(SsaSlot) * (size_t)(b->fn->var_count ? b->fn->var_count : 1);
+    SsaSlot* copy = SAGE_ALLOC(size);
+    memcpy(copy, state, sizeof(SsaSlot) * (size_t)b->fn->var_count);
+    return copy;
+}
+
+static void add_phi_arg(SsaValue* phi, int arg) {
+    phi->phi_args = SAGE_REALLOC(phi->phi_args, sizeof(int) * (size_t)(phi->phi_count + 1));
+    phi->phi_args[phi->phi_count++] = arg;
+}
+
+// Edge from slot `slot` of block `from` into `to`; existing phis of `to`
+// receive the values `state` carries along the edge.
+static void link_edge(Builder* b, int from, int slot, int to, const SsaSlot* state) {
+    SsaFunction* fn = b->fn;
+    fn->blocks[from].succ[slot] = to;
+    SsaBlock* target = &fn->blocks[to];
+    if (target->pred_count == target->pred_capacity) {
+        target->pred_capacity = target->pred_capacity ? target->pred_capacity * 2 : 4;
+        target->preds = SAGE_REALLOC(target->preds, sizeof(int) * (size_t)target->pred_capacity);
+        target->pred_slots = SAGE_REALLOC(target->pred_slots, sizeof(int) * (size_t)target->pred_capacity);
+        target->pred_live = SAGE_REALLOC(target->pred_live, (size_t)target->pred_capacity);
+    }
+    target->preds[target->pred_count] = from;
+    target->pred_slots[target->pred_count] = slot;
+    target->pred_live[target->pred_count] = 0;
+    target->pred_count++;
+    for (int i = 0; i < target->phi_count; i++) {
+        SsaValue* phi = &fn->values[target->phis[i]];
+        int arg = state[phi->phi_var].value;
+        if (arg < 0) {
+            arg = new_value(fn, SSA_OPAQUE, from);
+            fn->values[arg].type = SSA_TYPE_ANY;
+            fn->values[arg].lattice = SSA_LAT_BOTTOM;
+            phi = &fn->values[target->phis[i]];
+        }
+        add_phi_arg(phi, arg);
+    }
+}
+
+static int new_phi(Builder* b, int block, int var) {
+    SsaFunction* fn = b->fn;
+    int id = new_value(fn, SSA_PHI, block);
+    fn->values[id].phi_var = var;
+    SsaBlock* target = &fn->blocks[block];
+    if (target->phi_count == target->phi_capacity) {
+        target->phi_capacity = target->phi_capacity ? target->phi_capacity * 2 : 4;
+        target->phis = SAGE_REALLOC(target->phis, sizeof(int) * (size_t)target->phi_capacity);
+    }
+    target->phis[target->phi_count++] = id;
+    return id;
+}
+
+// Join `count` incoming states into the fresh block `to` and make it current.
+static void merge_into(Builder* b, int to, SsaEdge* in, int count) {
+    SsaFunction* fn = b->fn;
+    for (int i = 0; i < count; i++) link_edge(b, in[i].block, in[i].slot, to, in[i].state);
+    b->cur = to;
+    for (int var = 0; var < fn->var_count; var++) {
+        SsaSlot merged = in[0].state[var];
+        int differs = 0;
+        for (int i = 1; i < count && merged.value >= 0; i++) {
+            const SsaSlot* s = &in[i].state[var];
+            if (s->value < 0) {
+                merged.value = -1;
+                break;
+            }
+            if (s->value != merged.value) differs = 1;
+            if (s->depth > merged.depth) merged.depth = s->depth;
+            if (s->serial < merged.serial) merged.serial = s->serial;
+        }
+        if (merged.value >= 0 && differs) {
+            int phi = new_phi(b, to, var);
+            for (int i = 0; i < count; i++) add_phi_arg(&fn->values[phi], in[i].state[var].value);
+            merged.value = phi;
+            merged.serial = ++b->serial;
+        }
+        b->state[var] = merged;
+    }
+}
+
+static void leave_scope(Builder* b) {
+    b->depth--;
+    for (int var = 0; var < b->fn->var_count; var++) {
+        if (b->state[var].depth > b->depth) b->state[var].depth = SSA_HIDDEN;
+    }
+}
+
+static void push_edge(SsaEdge** list, int* count, int block, int slot, SsaSlot* state) {
+    *list = SAGE_REALLOC(*list, sizeof(SsaEdge) * (size_t)(*count + 1));
+    (*list)[*count].block = block;
+    (*list)[*count].slot = slot;
+    (*list)[*count].state = state;
+    (*count)++;
+}
+
+// ============================================================================
+// Expressions
+// ============================================================================
+
+static int add_site(Builder* b, Expr* expr, SiteKind kind, int value) {
+    SsaFunction* fn = b->fn;
+    if (fn->site_count == fn->site_capacity) {
+        fn->site_capacity = fn->site_capacity ? fn->site_capacity * 2 : 64;
+        fn->sites = SAGE_REALLOC(fn->sites, sizeof(SsaSite) * (size_t)fn->site_capacity);
+    }
+    SsaSite* site = &fn->sites[fn->site_count];
+    memset(site, 0, sizeof(*site));
+    site->expr = expr;
+    site->value = value;
+    site->block = b->cur;
+    site->kind = kind;
+    site->var = -1;
+    site->holder = -1;
+    site->hoist_loop = -1;
+    site->kids[0] = -1;
+    site->kids[1] = -1;
+    site->parent = -1;
+    return fn->site_count++;
+}
+
+// Oldest visible variable other than `except` that currently holds `value`.
+static int find_holder(const Builder* b, int value, int except) {
+    int best = -1;
+    for (int var = 0; var < b->fn->var_count; var++) {
+        const SsaSlot* s = &b->state[var];
+        if (var == except || s->value != value || s->depth > b->depth) continue;
+        if (best < 0 || s->serial < b->state[best].serial) best = var;
+    }
+    return best;
+}
+
+static int outermost_loop(const Builder* b) {
+    int loop = b->loop;
+    while (loop >= 0 && b->fn->loops[loop].parent >= 0) loop = b->fn->loops[loop].parent;
+    return loop;
+}
+
+// Outermost enclosing loop whose entry state gives `var` the value it has now.
+static int invariant_loop(const Builder* b, int var) {
+    int chain[64];
+    int n = 0;
+    for (int loop = b->loop; loop >= 0 && n < 64; loop = b->fn->loops[loop].parent) chain[n++] = loop;
+    for (int i = n - 1; i >= 0; i--) {
+        const SsaLoop* loop = &b->fn->loops[chain[i]];
+        const SsaSlot* entry = &loop->entry[var];
+        if (entry->value >= 0 && entry->value == b->state[var].value && entry->depth <= loop->depth) {
+            return chain[i];
+        }
+    }
+    return -1;
+}
+
+static int inner_loop(const SsaFunction* fn, int a, int b) {
+    if (a < 0 || b < 0) return -1;
+    return fn->loops[a].level >= fn->loops[b].level ? a : b;
+}
+
+static int is_modeled_binary(TokenType op) {
+    switch (op) {
+        case TOKEN_PLUS: case TOKEN_MINUS: case TOKEN_STAR: case TOKEN_SLASH: case TOKEN_PERCENT:
+        case TOKEN_EQ: case TOKEN_NEQ: case TOKEN_LT: case TOKEN_GT: case TOKEN_LTE: case TOKEN_GTE:
+        case TOKEN_AND: case TOKEN_OR:
+        case TOKEN_AMP: case TOKEN_PIPE: case TOKEN_CARET: case TOKEN_LSHIFT: case TOKEN_RSHIFT:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+static int build_expr(Builder* b, Expr* expr);
+
+// The site array may move while `expr` is built, so index it afterwards.
+static int build_value(Builder* b, Expr* expr) {
+    int site = build_expr(b, expr);
+    return b->fn->sites[site].value;
+}
+
+static void build_children(Builder* b, Expr** exprs, int count) {
+    for (int i = 0; i < count; i++) {
+        if (exprs[i] != NULL) build_expr(b, exprs[i]);
+    }
+}
+
+static int build_literal(Builder* b, Expr* expr, SsaType type, double number, int boolean) {
+    SsaValue probe;
+    memset(&probe, 0, sizeof(probe));
+    probe.opcode = SSA_CONST;
+    probe.args[0] = -1;
+    probe.args[1] = -1;
+    probe.type = type;
+    probe.number = number;
+    probe.boolean = boolean;
+    int site = add_site(b, expr, SITE_LITERAL, intern_value(b, &probe));
+    b->fn->sites[site].hoist_loop = outermost_loop(b);
+    return site;
+}
+
+static int build_expr(Builder* b, Expr* expr) {
+    SsaFunction* fn = b->fn;
+    switch (expr->type) {
+        case EXPR_NUMBER:
+            return build_literal(b, expr, SSA_TYPE_NUM, expr->as.number.value, 0);
+        case EXPR_BOOL:
+            return build_literal(b, expr, SSA_TYPE_BOOL, 0, expr->as.boolean.value != 0);
+        case EXPR_NIL:
+            return build_literal(b, expr, SSA_TYPE_NIL, 0, 0);
+        case EXPR_STRING: {
+            int value = new_value(fn, SSA_STRING, b->cur);
+            fn->values[value].type = SSA_TYPE_STR;
+            fn->values[value].lattice = SSA_LAT_BOTTOM;
+            return add_site(b, expr, SITE_OTHER, value);
+        }
+        case EXPR_VARIABLE: {
+            int var = var_index(fn, &expr->as.variable.name);
+            if (var < 0 || b->state[var].value < 0) return add_site(b, expr, SITE_OTHER, new_opaque(b));
+            int site = add_site(b, expr, SITE_VAR, b->state[var].value);
+            SsaSite* s = &fn->sites[site];
+            s->var = var;
+            int holder = find_holder(b, s->value, var);
+            if (holder >= 0 && b->state[holder].serial < b->state[var].serial) s->holder = holder;
+            s->hoist_loop = invariant_loop(b, var);
+            return site;
+        }
+        case EXPR_BINARY: {
+            TokenType op = expr->as.binary.op.type;
+            int left = build_expr(b, expr->as.binary.left);
+            if (expr->as.binary.right == NULL) {
+                int value;
+                if (op == TOKEN_NOT || op == TOKEN_TILDE) {
+                    SsaValue probe;
+                    memset(&probe, 0, sizeof(probe));
+                    probe.opcode = SSA_UNARY;
+                    probe.op = op;
+                    probe.args[0] = fn->sites[left].value;
+                    probe.args[1] = -1;
+                    value = intern_value(b, &probe);
+                } else {
+                    value = new_opaque(b);
+                }
+                int site = add_site(b, expr, SITE_UNARY, value);
+                fn->sites[left].parent = site;
+                fn->sites[site].kids[0] = left;
+                fn->sites[site].hoist_loop = fn->sites[left].hoist_loop;
+                fn->sites[site].holder = find_holder(b, value, -1);
+                return site;
+            }
+            int right = build_expr(b, expr->as.binary.right);
+            int value;
+            if (is_modeled_binary(op)) {
+                SsaValue probe;
+                memset(&probe, 0, sizeof(probe));
+                probe.opcode = SSA_BINARY;
+                probe.op = op;
+                probe.args[0] = fn->sites[left].value;
+                probe.args[1] = fn->sites[right].value;
+                value = intern_value(b, &probe);
+            } else {
+                value = new_opaque(b);
+            }
+            int site = add_site(b, expr, SITE_BINARY, value);
+            SsaSite* s = &fn->sites[site];
+            s->kids[0] = left;
+            s->kids[1] = right;
+            fn->sites[left].parent = site;
+            fn->sites[right].parent = site;
+            s->hoist_loop = inner_loop(fn, fn->sites[left].hoist_loop, fn->sites[right].hoist_loop);
+            s->holder = find_holder(b, value, -1);
+            return site;
+        }
+        case EXPR_SET: {
+            if (expr->as.set.object != NULL) {
+                build_expr(b, expr->as.set.object);
+                build_expr(b, expr->as.set.value);
+                return add_site(b, expr, SITE_OTHER, new_opaque(b));
+            }
+            int value = build_value(b, expr->as.set.value);
+            int var = var_index(fn, &expr->as.set.property);
+            if (var >= 0 && b->state[var].value >= 0) {
+                b->state[var].value = value;
+                b->state[var].serial = ++b->serial;
+            }
+            return add_site(b, expr, SITE_OTHER, value);
+        }
+        case EXPR_CALL:
+            build_expr(b, expr->as.call.callee);
+            build_children(b, expr->as.call.args, expr->as.call.arg_count);
+            break;
+        case EXPR_ARRAY:
+            build_children(b, expr->as.array.elements, expr->as.array.count);
+            break;
+        case EXPR_DICT:
+            build_children(b, expr->as.dict.values, expr->as.dict.count);
+            break;
+        case EXPR_TUPLE:
+            build_children(b, expr->as.tuple.elements, expr->as.tuple.count);
+            break;
+        case EXPR_INDEX:
+            build_expr(b, expr->as.index.array);
+            build_expr(b, expr->as.index.index);
+            break;
+        case EXPR_INDEX_SET:
+            build_expr(b, expr->as.index_set.array);
+            build_expr(b, expr->as.index_set.index);
+            build_expr(b, expr->as.index_set.value);
+            break;
+        case EXPR_SLICE:
+            build_expr(b, expr->as.slice.array);
+            if (expr->as.slice.start != NULL) build_expr(b, expr->as.slice.start);
+            if (expr->as.slice.end != NULL) build_expr(b, expr->as.slice.end);
+            break;
+        case EXPR_GET:
+            build_expr(b, expr->as.get.object);
+            break;
+        case EXPR_AWAIT:
+            build_expr(b, expr->as.await.expression);
+            break;
+        case EXPR_SUPER:
+        case EXPR_COMPTIME:
+        case EXPR_PROC:
+            break;
+    }
+    return add_site(b, expr, SITE_OTHER, new_opaque(b));
+}
+
+// ============================================================================
+// Statements
+// ============================================================================
+
+static void build_list(Builder* b, Stmt* head);
+
+// Conditional branch out of the current block on a value SCCP cannot decide;
+// slot 1 is left for the caller to link.
+static void split_opaque(Builder* b) {
+    int next = new_block(b->fn);
+    b->fn->blocks[b->cur].cond = new_opaque(b);
+    link_edge(b, b->cur, 0, next, b->state);
+    b->cur = next;
+}
+
+// Does a barrier statement leave the enclosing loop through break/continue?
+static void barrier_exits(Stmt* head, int* has_break, int* has_continue) {
+    for (Stmt* s = head; s != NULL; s = s->next) {
+        switch (s->type) {
+            case STMT_BREAK: *has_break = 1; break;
+            case STMT_CONTINUE: *has_continue = 1; break;
+            case STMT_IF:
+                barrier_exits(s->as.if_stmt.then_branch, has_break, has_continue);
+                barrier_exits(s->as.if_stmt.else_branch, has_break, has_continue);
+                break;
+            case STMT_BLOCK:
+                barrier_exits(s->as.block.statements, has_break, has_continue);
+                break;
+            case STMT_MATCH:
+                for (int i = 0; i < s->as.match_stmt.case_count; i++) {
+                    barrier_exits(s->as.match_stmt.cases[i]->body, has_break, has_continue);
+                }
+                barrier_exits(s->as.match_stmt.default_case, has_break, has_continue);
+                break;
+            case STMT_TRY:
+                barrier_exits(s->as.try_stmt.try_block, has_break, has_continue);
+                for (int i = 0; i < s->as.try_stmt.catch_count; i++) {
+                    barrier_exits(s->as.try_stmt.catches[i]->body, has_break, has_continue);
+                }
+                barrier_exits(s->as.try_stmt.finally_block, has_break, has_continue);
+                break;
+            case STMT_DEFER:
+                if (s->as.defer.statement != NULL) {
+                    Stmt* saved = s->as.defer.statement->next;
+                    s->as.defer.statement->next = NULL;
+                    barrier_exits(s->as.defer.statement, has_break, has_continue);
+                    s->as.defer.statement->next = saved;
+                }
+                break;
+            case STMT_COMPTIME:
+                barrier_exits(s->as.comptime.body, has_break, has_continue);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+static void build_barrier(Builder* b, Stmt* stmt) {
+    if (b->loop < 0) return;
+    int has_break = 0, has_continue = 0;
+    Stmt* saved = stmt->next;
+    stmt->next = NULL;
+    barrier_exits(stmt, &has_break, &has_continue);
+    stmt->next = saved;
+
+    SsaLoop* loop = &b->fn->loops[b->loop];
+    if (has_break) {
+        int from = b->cur;
+        split_opaque(b);
+        loop = &b->fn->loops[b->loop];
+        push_edge(&loop->breaks, &loop->break_count, from, 1, copy_state(b, b->state));
+    }
+    if (has_continue) {
+        int from = b->cur;
+        split_opaque(b);
+        loop = &b->fn->loops[b->loop];
+        push_edge(&loop->continues, &loop->continue_count, from, 1, copy_state(b, b->state));
+    }
+}
+
+static void build_if(Builder* b, Stmt* stmt) {
+    SsaFunction* fn = b->fn;
+    int cond = build_value(b, stmt->as.if_stmt.condition);
+    int from = b->cur;
+    fn->blocks[from].cond = cond;
+    int then_block = new_block(fn);
+    int else_block = new_block(fn);
+    link_edge(b, from, 0, then_block, b->state);
+    link_edge(b, from, 1, else_block, b->state);
+
+    SsaSlot* saved = copy_state(b, b->state);
+    SsaEdge ends[2];
+    int count = 0;
+
+    b->cur = then_block;
+    b->depth++;
+    build_list(b, stmt->as.if_stmt.then_branch);
+    leave_scope(b);
+    if (b->cur >= 0) {
+        ends[count].block = b->cur;
+        ends[count].slot = 0;
+        ends[count].state = copy_state(b, b->state);
+        count++;
+    }
+
+    memcpy(b->state, saved, sizeof(SsaSlot) * (size_t)fn->var_count);
+    b->cur = else_block;
+    b->depth++;
+    build_list(b, stmt->as.if_stmt.else_branch);
+    leave_scope(b);
+    if (b->cur >= 0) {
+        ends[count].block = b->cur;
+        ends[count].slot = 0;
+        ends[count].state = copy_state(b, b->state);
+        count++;
+    }
+
+    if (count > 0) {
+        merge_into(b, new_block(fn), ends, count);
+    } else {
+        b->cur = -1;
+    }
+    for (int i = 0; i < count; i++) free(ends[i].state);
+    free(saved);
+}
+
+static void build_loop(Builder* b, Stmt* stmt) {
+    SsaFunction* fn = b->fn;
+    int is_while = stmt->type == STMT_WHILE;
+
+    if (fn->loop_count == fn->loop_capacity) {
+        fn->loop_capacity = fn->loop_capacity ? fn->loop_capacity * 2 : 8;
+        fn->loops = SAGE_REALLOC(fn->loops, sizeof(SsaLoop) * (size_t)fn->loop_capacity);
+    }
+    int index = fn->loop_count++;
+    SsaLoop* loop = &fn->loops[index];
+    memset(loop, 0, sizeof(*loop));
+    loop->stmt = stmt;
+    loop->parent = b->loop;
+    loop->level = b->loop >= 0 ? fn->loops[b->loop].level + 1 : 0;
+    loop->depth = b->depth;
+    // Captured before the iterable: hoisted lets go in front of the whole `for`.
+    loop->entry = copy_state(b, b->state);
+    if (!is_while) build_expr(b, stmt->as.for_stmt.iterable);
+
+    int pre = b->cur;
+    int header = new_block(fn);
+    loop->header = header;
+
+    int* marks = SAGE_ALLOC(sizeof(int) * (size_t)(fn->var_count ? fn->var_count : 1));
+    collect_assigned(fn, stmt, marks);
+    for (int var = 0; var < fn->var_count; var++) {
+        if (marks[var] && b->state[var].value >= 0) {
+            new_phi(b, header, var);
+        }
+    }
+    free(marks);
+    link_edge(b, pre, 0, header, b->state);
+    for (int i = 0; i < fn->blocks[header].phi_count; i++) {
+        int phi = fn->blocks[header].phis[i];
+        b->state[fn->values[phi].phi_var].value = phi;
+        b->state[fn->values[phi].phi_var].serial = ++b->serial;
+    }
+
+    int outer = b->loop;
+    b->loop = index;
+    b->cur = header;
+    int cond = is_while ? build_value(b, stmt->as.while_stmt.condition) : new_opaque(b);
+    fn->blocks[b->cur].cond = cond;
+    int test = b->cur;
+    SsaSlot* exit_state = copy_state(b, b->state);
+
+    int body = new_block(fn);
+    link_edge(b, test, 0, body, b->state);
+    b->cur = body;
+    b->depth++;
+    build_list(b, is_while ? stmt->as.while_stmt.body : stmt->as.for_stmt.body);
+    leave_scope(b);
+
+    loop = &fn->loops[index];
+    if (b->cur >= 0) link_edge(b, b->cur, 0, header, b->state);
+    for (int i = 0; i < loop->continue_count; i++) {
+        link_edge(b, loop->continues[i].block, loop->continues[i].slot, header, loop->continues[i].state);
+    }
+
+    int exits = loop->break_count + 1;
+    SsaEdge* in = SAGE_ALLOC(sizeof(SsaEdge) * (size_t)exits);
+    in[0].block = test;
+    in[0].slot = 1;
+    in[0].state = exit_state;
+    for (int i = 0; i < loop->break_count; i++) in[i + 1] = loop->breaks[i];
+    merge_into(b, new_block(fn), in, exits);
+    free(in);
+    free(exit_state);
+    b->loop = outer;
+}
+
+static void build_stmt(Builder* b, Stmt* stmt) {
+    SsaFunction* fn = b->fn;
+    switch (stmt->type) {
+        case STMT_PRINT:
+            build_expr(b, stmt->as.print.expression);
+            break;
+        case STMT_EXPRESSION:
+            build_expr(b, stmt->as.expression);
+            break;
+        case STMT_LET: {
+            int value;
+            if (stmt->as.let.initializer != NULL) {
+                value = build_value(b, stmt->as.let.initializer);
+            } else {
+                SsaValue probe;
+                memset(&probe, 0, sizeof(probe));
+                probe.opcode = SSA_CONST;
+                probe.args[0] = -1;
+                probe.args[1] = -1;
+                probe.type = SSA_TYPE_NIL;
+                value = intern_value(b, &probe);
+            }
+            int var = var_index(fn, &stmt->as.let.name);
+            if (var >= 0) {
+                SsaSlot* slot = &b->state[var];
+                if (slot->value < 0 || slot->depth > b->depth) slot->depth = b->depth;
+                slot->value = value;
+                slot->serial = ++b->serial;
+            }
+            break;
+        }
+        case STMT_IF:
+            build_if(b, stmt);
+            break;
+        case STMT_BLOCK:
+            b->depth++;
+            build_list(b, stmt->as.block.statements);
+            leave_scope(b);
+            break;
+        case STMT_WHILE:
+        case STMT_FOR:
+            build_loop(b, stmt);
+            break;
+        case STMT_RETURN:
+            if (stmt->as.ret.value != NULL) build_expr(b, stmt->as.ret.value);
+            b->cur = -1;
+            break;
+        case STMT_RAISE:
+            if (stmt->as.raise.exception != NULL) build_expr(b, stmt->as.raise.exception);
+            b->cur = -1;
+            break;
+        case STMT_BREAK:
+        case STMT_CONTINUE:
+            if (b->loop >= 0) {
+                SsaLoop* loop = &fn->loops[b->loop];
+                if (stmt->type == STMT_BREAK) {
+                    push_edge(&loop->breaks, &loop->break_count, b->cur, 0, copy_state(b, b->state));
+                } else {
+                    push_edge(&loop->continues, &loop->continue_count, b->cur, 0, copy_state(b, b->state));
+                }
+            }
+            b->cur = -1;
+            break;
+        case STMT_MATCH:
+        case STMT_DEFER:
+        case STMT_TRY:
+        case STMT_YIELD:
+        case STMT_COMPTIME:
+            build_barrier(b, stmt);
+            break;
+        case STMT_PROC:
+        case STMT_ASYNC_PROC:
+        case STMT_CLASS:
+        case STMT_STRUCT:
+        case STMT_ENUM:
+        case STMT_TRAIT:
+        case STMT_IMPORT:
+        case STMT_MACRO_DEF:
+            break;
+    }
+}
+
+static void build_list(Builder* b, Stmt* head) {
+    for (Stmt* s = head; s != NULL && b->cur >= 0; s = s->next) build_stmt(b, s);
+}
+
+SsaFunction* ssa_build(Stmt* program, Stmt* proc) {
+    SsaFunction* fn = SAGE_ALLOC(sizeof(SsaFunction));
+    Token* params = proc != NULL ? proc->as.proc.params : NULL;
+    int param_count = proc != NULL ? proc->as.proc.param_count : 0;
+    fn->body = proc != NULL ? proc->as.proc.body : program;
+
+    // Tracked variables: locals minus everything the builder cannot follow.
+    NameList locals = { NULL, 0, 0 };
+    NameList excluded = { NULL, 0, 0 };
+    NameWalk walk;
+    memset(&walk, 0, sizeof(walk));
+    walk.on_name = exclude_name;
+    walk.on_function = proc != NULL ? exclude_captures : escape_function;
+    walk.names = &excluded;
+    walk.locals = &locals;
+    for (int i = 0; i < param_count; i++) names_add(&locals, &params[i]);
+    walk_list(&walk, fn->body);
+
+    fn->vars = SAGE_ALLOC(sizeof(SsaVar) * (size_t)(locals.count ? locals.count : 1));
+    for (int i = 0; i < locals.count; i++) {
+        if (names_find(&excluded, &locals.items[i]) >= 0) continue;
+        fn->vars[fn->var_count++].name = locals.items[i];
+    }
+    free(locals.items);
+    free(excluded.items);
+
+    Builder b;
+    memset(&b, 0, sizeof(b));
+    b.fn = fn;
+    b.loop = -1;
+    b.state = SAGE_ALLOC(sizeof(SsaSlot) * (size_t)(fn->var_count ? fn->var_count : 1));
+    for (int var = 0; var < fn->var_count; var++) {
+        b.state[var].value = -1;
+        b.state[var].depth = SSA_HIDDEN;
+    }
+    b.cur = new_block(fn);
+    for (int i = 0; i < param_count; i++) {
+        int var = var_index(fn, &params[i]);
+        if (var < 0) continue;
+        int value = new_value(fn, SSA_PARAM, b.cur);
+        fn->values[value].type = SSA_TYPE_ANY;
+        fn->values[value].lattice = SSA_LAT_BOTTOM;
+        b.state[var].value = value;
+        b.state[var].depth = 0;
+        b.state[var].serial = ++b.serial;
+    }
+    if (fn->var_count > 0) build_list(&b, fn->body);
+    free(b.state);
+    return fn;
+}
+
+// ============================================================================
+// Passes
+// ============================================================================
+
+static int is_scalar(SsaType type) {
+    return type == SSA_TYPE_NUM || type == SSA_TYPE_BOOL || type == SSA_TYPE_STR || type == SSA_TYPE_NIL;
+}
+
+static int same_constant(const SsaValue* a, const SsaValue* b) {
+    return a->type == b->type && a->boolean == b->boolean &&
+           memcmp(&a->number, &b->number, sizeof(double)) == 0;
+}
+
+static SsaType binary_type(TokenType op, SsaType l, SsaType r) {
+    if (l == SSA_TYPE_TOP || r == SSA_TYPE_TOP) return SSA_TYPE_TOP;
+    switch (op) {
+        case TOKEN_PLUS:
+            if (l == SSA_TYPE_NUM && r == SSA_TYPE_NUM) return SSA_TYPE_NUM;
+            if (l == SSA_TYPE_STR && r == SSA_TYPE_STR) return SSA_TYPE_STR;
+            return SSA_TYPE_ANY;
+        case TOKEN_MINUS: case TOKEN_STAR: case TOKEN_SLASH: case TOKEN_PERCENT:
+        case TOKEN_AMP: case TOKEN_PIPE: case TOKEN_CARET: case TOKEN_LSHIFT: case TOKEN_RSHIFT:
+            return l == SSA_TYPE_NUM && r == SSA_TYPE_NUM ? SSA_TYPE_NUM : SSA_TYPE_ANY;
+        case TOKEN_LT: case TOKEN_GT: case TOKEN_LTE: case TOKEN_GTE:
+            return l == SSA_TYPE_NUM && r == SSA_TYPE_NUM ? SSA_TYPE_BOOL : SSA_TYPE_ANY;
+        case TOKEN_EQ: case TOKEN_NEQ:
+            // Instances may overload __eq__.
+            return is_scalar(l) && is_scalar(r) ? SSA_TYPE_BOOL : SSA_TYPE_ANY;
+        case TOKEN_AND: case TOKEN_OR:
+            return l == SSA_TYPE_BOOL && r == SSA_TYPE_BOOL ? SSA_TYPE_BOOL : SSA_TYPE_ANY;
+        default:
+            return SSA_TYPE_ANY;
+    }
+}
+
+// Same folding rules as the constfold pass; anything it would leave to the
+// runtime (division by zero, inf/nan, mixed types) stays unfolded here too.
+static int fold_binary(TokenType op, const SsaValue* l, const SsaValue* r, SsaValue* out) {
+    if (l->type == SSA_TYPE_NUM && r->type == SSA_TYPE_NUM) {
+        double a = l->number, b = r->number, result;
+        out->type = SSA_TYPE_BOOL;
+        switch (op) {
+            case TOKEN_LT:  out->boolean = a < b;  return 1;
+            case TOKEN_GT:  out->boolean = a > b;  return 1;
+            case TOKEN_LTE: out->boolean = a <= b; return 1;
+            case TOKEN_GTE: out->boolean = a >= b; return 1;
+            case TOKEN_EQ:  out->boolean = a == b; return 1;
+            case TOKEN_NEQ: out->boolean = a != b; return 1;
+            case TOKEN_PLUS:  result = a + b; break;
+            case TOKEN_MINUS: result = a - b; break;
+            case TOKEN_STAR:  result = a * b; break;
+            case TOKEN_SLASH:
+                if (b == 0) return 0;
+                result = a / b;
+                break;
+            case TOKEN_PERCENT:
+                if (b == 0) return 0;
+                result = fmod(a, b);
+                break;
+            default:
+                return 0;
+        }
+        if (isinf(result) || isnan(result)) return 0;
+        out->type = SSA_TYPE_NUM;
+        out->number = result;
+        return 1;
+    }
+    if (l->type == SSA_TYPE_BOOL && r->type == SSA_TYPE_BOOL) {
+        out->type = SSA_TYPE_BOOL;
+        switch (op) {
+            case TOKEN_AND: out->boolean = l->boolean && r->boolean; return 1;
+            case TOKEN_OR:  out->boolean = l->boolean || r->boolean; return 1;
+            case TOKEN_EQ:  out->boolean = l->boolean == r->boolean; return 1;
+            case TOKEN_NEQ: out->boolean = l->boolean != r->boolean; return 1;
+            default: return 0;
+        }
+    }
+    return 0;
+}
+
+// Lattice meet of `v` into `acc`.
+static void meet(SsaValue* acc, const SsaValue* v) {
+    if (acc->type == SSA_TYPE_TOP) {
+        acc->type = v->type;
+    } else if (v->type != SSA_TYPE_TOP && v->type != acc->type) {
+        acc->type = SSA_TYPE_ANY;
+    }
+    if (v->lattice == SSA_LAT_TOP || acc->lattice == SSA_LAT_BOTTOM) return;
+    if (acc->lattice == SSA_LAT_TOP) {
+        acc->lattice = v->lattice;
+        acc->number = v->number;
+        acc->boolean = v->boolean;
+        if (v->lattice == SSA_LAT_CONST) acc->type = v->type;
+    } else if (v->lattice == SSA_LAT_BOTTOM || !same_constant(acc, v)) {
+        acc->lattice = SSA_LAT_BOTTOM;
+    }
+}
+
+static void evaluate(const SsaFunction* fn, int id, SsaValue* out) {
+    const SsaValue* v = &fn->values[id];
+    memset(out, 0, sizeof(*out));
+    out->type = SSA_TYPE_TOP;
+    out->lattice = SSA_LAT_TOP;
+    if (v->opcode == SSA_PHI) {
+        const SsaBlock* block = &fn->blocks[v->block];
+        for (int i = 0; i < v->phi_count && i < block->pred_count; i++) {
+            if (!block->pred_live[i]) continue;
+            int arg = find_value(fn, v->phi_args[i]);
+            if (arg != id) meet(out, &fn->values[arg]);
+        }
+        return;
+    }
+
+    const SsaValue* l = &fn->values[find_value(fn, v->args[0])];
+    if (v->opcode == SSA_UNARY) {
+        if (l->type == SSA_TYPE_TOP) return;
+        if (v->op == TOKEN_NOT) {
+            out->type = SSA_TYPE_BOOL;
+            if (l->lattice == SSA_LAT_CONST && l->type == SSA_TYPE_BOOL) {
+                out->lattice = SSA_LAT_CONST;
+                out->boolean = !l->boolean;
+            } else {
+                out->lattice = l->lattice == SSA_LAT_TOP ? SSA_LAT_TOP : SSA_LAT_BOTTOM;
+            }
+        } else {
+            out->type = l->type == SSA_TYPE_NUM ? SSA_TYPE_NUM : SSA_TYPE_ANY;
+            out->lattice = l->lattice == SSA_LAT_TOP ? SSA_LAT_TOP : SSA_LAT_BOTTOM;
+        }
+        return;
+    }
+
+    const SsaValue* r = &fn->values[find_value(fn, v->args[1])];
+    out->type = binary_type(v->op, l->type, r->type);
+    if (l->lattice == SSA_LAT_TOP || r->lattice == SSA_LAT_TOP) return;
+    if (l->lattice == SSA_LAT_CONST && r->lattice == SSA_LAT_CONST && fold_binary(v->op, l, r, out)) {
+        out->lattice = SSA_LAT_CONST;
+        return;
+    }
+    out->lattice = SSA_LAT_BOTTOM;
+}
+
+static int mark_edge(SsaFunction* fn, int from, int slot) {
+    int to = fn->blocks[from].succ[slot];
+    if (to < 0) return 0;
+    SsaBlock* target = &fn->blocks[to];
+    for (int i = 0; i < target->pred_count; i++) {
+        if (target->preds[i] == from && target->pred_slots[i] == slot && !target->pred_live[i]) {
+            target->pred_live[i] = 1;
+            target->executable = 1;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// --- copyprop: trivial phis, then reads of a copy become reads of the original
+
+static void pass_copyprop(SsaFunction* fn, SsaStats* stats) {
+    int changed = 1;
+    while (changed) {
+        changed = 0;
+        for (int id = 0; id < fn->value_count; id++) {
+            SsaValue* v = &fn->values[id];
+            if (v->opcode != SSA_PHI || v->forward >= 0) continue;
+            int unique = -1, trivial = 1;
+            for (int i = 0; i < v->phi_count && trivial; i++) {
+                int arg = find_value(fn, v->phi_args[i]);
+                if (arg == id) continue;
+                if (unique < 0) unique = arg;
+                else if (arg != unique) trivial = 0;
+            }
+            if (trivial && unique >= 0) {
+                v->forward = unique;
+                stats->copies++;
+                changed = 1;
+            }
+        }
+    }
+    for (int i = 0; i < fn->site_count; i++) {
+        SsaSite* site = &fn->sites[i];
+        if (site->kind == SITE_VAR && site->holder >= 0) site->action = ACTION_VARIABLE;
+    }
+}
+
+// --- sccp -------------------------------------------------------------------
+
+static void pass_sccp(SsaFunction* fn, SsaStats* stats) {
+    (void)stats;
+    for (int id = 0; id < fn->value_count; id++) {
+        SsaValue* v = &fn->values[id];
+        if (v->opcode == SSA_BINARY || v->opcode == SSA_UNARY || v->opcode == SSA_PHI) {
+            v->lattice = SSA_LAT_TOP;
+            v->type = SSA_TYPE_TOP;
+        }
+    }
+    for (int i = 0; i < fn->block_count; i++) {
+        fn->blocks[i].executable = 0;
+        memset(fn->blocks[i].pred_live, 0, (size_t)fn->blocks[i].pred_count);
+    }
+    if (fn->block_count == 0) return;
+    fn->blocks[0].executable = 1;
+
+    int changed = 1;
+    while (changed) {
+        changed = 0;
+        for (int i = 0; i < fn->block_count; i++) {
+            SsaBlock* block = &fn->blocks[i];
+            if (!block->executable) continue;
+            if (block->cond < 0) {
+                changed |= mark_edge(fn, i, 0);
+                continue;
+            }
+            const SsaValue* cond = &fn->values[find_value(fn, block->cond)];
+            if (cond->lattice == SSA_LAT_TOP) continue;
+            if (cond->lattice == SSA_LAT_CONST && cond->type == SSA_TYPE_BOOL) {
+                changed |= mark_edge(fn, i, cond->boolean ? 0 : 1);
+            } else {
+                changed |= mark_edge(fn, i, 0);
+                changed |= mark_edge(fn, i, 1);
+            }
+        }
+        for (int id = 0; id < fn->value_count; id++) {
+            SsaValue* v = &fn->values[id];
+            if (v->forward >= 0) continue;
+            if (v->opcode != SSA_BINARY && v->opcode != SSA_UNARY && v->opcode != SSA_PHI) continue;
+            SsaValue next;
+            evaluate(fn, id, &next);
+            SsaValue merged = *v;
+            meet(&merged, &next);
+            if (merged.lattice != v->lattice || merged.type != v->type ||
+                (merged.lattice == SSA_LAT_CONST && !same_constant(&merged, v))) {
+                v->lattice = merged.lattice;
+                v->type = merged.type;
+                v->number = merged.number;
+                v->boolean = merged.boolean;
+                changed = 1;
+            }
+        }
+    }
+
+    for (int i = 0; i < fn->site_count; i++) {
+        SsaSite* site = &fn->sites[i];
+        if (site->kind != SITE_VAR && site->kind != SITE_BINARY && site->kind != SITE_UNARY) continue;
+        const SsaValue* v = &fn->values[find_value(fn, site->value)];
+        if (v->lattice == SSA_LAT_CONST &&
+            (v->type == SSA_TYPE_NUM || v->type == SSA_TYPE_BOOL || v->type == SSA_TYPE_NIL)) {
+            site->action = ACTION_CONST;
+        }
+    }
+}
+
+// --- gvn --------------------------------------------------------------------
+
+static SsaType site_type(const SsaFunction* fn, int site) {
+    return fn->values[find_value(fn, fn->sites[site].value)].type;
+}
+
+static void pass_gvn(SsaFunction* fn, SsaStats* stats) {
+    (void)stats;
+    for (int i = 0; i < fn->site_count; i++) {
+        SsaSite* site = &fn->sites[i];
+        if (site->action != ACTION_NONE || site->holder < 0) continue;
+        if (site->kind != SITE_BINARY && site->kind != SITE_UNARY) continue;
+        // Only scalar operands: an instance operand may run __eq__, and `+`
+        // on arrays builds a fresh object each time.
+        if (!is_scalar(site_type(fn, i))) continue;
+        if (!is_scalar(site_type(fn, site->kids[0]))) continue;
+        if (site->kids[1] >= 0 && !is_scalar(site_type(fn, site->kids[1]))) continue;
+        site->action = ACTION_VARIABLE;
+    }
+}
+
+// --- licm -------------------------------------------------------------------
+
+static int is_safe_op(TokenType op) {
+    switch (op) {
+        case TOKEN_PLUS: case TOKEN_MINUS: case TOKEN_STAR:
+        case TOKEN_EQ: case TOKEN_NEQ: case TOKEN_LT: case TOKEN_GT: case TOKEN_LTE: case TOKEN_GTE:
+        case TOKEN_AND: case TOKEN_OR: case TOKEN_NOT:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+static int has_variable(const SsaFunction* fn, int site) {
+    if (site < 0) return 0;
+    const SsaSite* s = &fn->sites[site];
+    if (s->kind == SITE_VAR) return 1;
+    return has_variable(fn, s->kids[0]) || has_variable(fn, s->kids[1]);
+}
+
+static void pass_licm(SsaFunction* fn, SsaStats* stats) {
+    (void)stats;
+    // Hoisting runs the expression even when the loop body never does, so
+    // only operators that cannot raise on numbers/bools qualify.
+    for (int i = 0; i < fn->site_count; i++) {
+        SsaSite* site = &fn->sites[i];
+        SsaType type = site_type(fn, i);
+        int scalar = type == SSA_TYPE_NUM || type == SSA_TYPE_BOOL;
+        switch (site->kind) {
+            case SITE_LITERAL:
+            case SITE_VAR:
+                site->safe = scalar;
+                break;
+            case SITE_BINARY:
+            case SITE_UNARY:
+                site->safe = scalar && is_safe_op(site->expr->as.binary.op.type) &&
+                             fn->sites[site->kids[0]].safe &&
+                             (site->kids[1] < 0 || fn->sites[site->kids[1]].safe);
+                break;
+            case SITE_OTHER:
+                site->safe = 0;
+                break;
+        }
+    }
+    for (int i = fn->site_count - 1; i >= 0; i--) {
+        SsaSite* site = &fn->sites[i];
+        if (site->parent >= 0) {
+            const SsaSite* parent = &fn->sites[site->parent];
+            if (parent->dead || parent->action != ACTION_NONE) {
+                site->dead = 1;
+                continue;
+            }
+        }
+        if (site->action != ACTION_NONE || site->kind != SITE_BINARY) continue;
+        if (site->hoist_loop < 0 || !site->safe || !fn->blocks[site->block].executable) continue;
+        if (!has_variable(fn, i)) continue;
+        site->action = ACTION_HOIST;
+    }
+    for (int i = 0; i < fn->site_count; i++) fn->sites[i].dead = 0;
+}
+
+typedef struct {
+    const char* name;
+    void (*run)(SsaFunction* fn, SsaStats* stats);
+} SsaPass;
+
+static const SsaPass g_ssa_passes[] = {
+    { "copyprop", pass_copyprop },
+    { "sccp",     pass_sccp },
+    { "gvn",      pass_gvn },
+    { "licm",     pass_licm },
+};
+
+void ssa_optimize(SsaFunction* fn, SsaStats* stats) {
+    stats->values += fn->value_count;
+    if (fn->block_count == 0) return;
+    for (size_t i = 0; i < sizeof(g_ssa_passes) / sizeof(g_ssa_passes[0]); i++) {
+        g_ssa_passes[i].run(fn, stats);
+    }
+}
+
+// ============================================================================
+// Lowering back into the AST
+// ============================================================================
+
+typedef struct {
+    int loop;
+    int value;
+    Token name;
+} Temporary;
+
+static void clear_expr(Expr* expr) {
+    if (expr->type == EXPR_BINARY) {
+        free_expr(expr->as.binary.left);
+        free_expr(expr->as.binary.right);
+    }
+    memset(&expr->as, 0, sizeof(expr->as));
+}
+
+static void set_variable(Expr* expr, Token name) {
+    expr->type = EXPR_VARIABLE;
+    expr->as.variable.name = name;
+    expr->as.variable.cached_env_id = 0;
+    expr->as.variable.cached_node = NULL;
+}
+
+static void set_literal(Expr* expr, const SsaValue* v) {
+    switch (v->type) {
+        case SSA_TYPE_NUM:
+            expr->type = EXPR_NUMBER;
+            expr->as.number.value = v->number;
+            break;
+        case SSA_TYPE_BOOL:
+            expr->type = EXPR_BOOL;
+            expr->as.boolean.value = v->boolean;
+            break;
+        default:
+            expr->type = EXPR_NIL;
+            break;
+    }
+}
+
+// Turn the loop statement node into `let name = init` followed by the loop.
+static void insert_before_loop(SsaLoop* loop, Token name, Expr* init) {
+    Stmt* node = loop->stmt;
+    Stmt* moved = ast_alloc(sizeof(Stmt));
+    *moved = *node;
+    memset(node, 0, sizeof(*node));
+    node->type = STMT_LET;
+    node->as.let.name = name;
+    node->as.let.initializer = init;
+    node->next = moved;
+    loop->stmt = moved;
+}
+
+static Token temporary_name(const Expr* expr, SsaStats* stats) {
+    char buf[32];
+    int len = snprintf(buf, sizeof(buf), "__licm%d", stats->temporaries++);
+    Token name = expr->as.binary.op;
+    name.type = TOKEN_IDENTIFIER;
+    name.start = ast_strndup(buf, (size_t)len);
+    name.length = len;
+    return name;
+}
+
+void ssa_lower(SsaFunction* fn, SsaStats* stats) {
+    Temporary* temps = NULL;
+    int temp_count = 0;
+
+    // Parents come after their operands, so walking backwards rewrites the
+    // largest expression first and skips everything under it.
+    for (int i = fn->site_count - 1; i >= 0; i--) {
+        SsaSite* site = &fn->sites[i];
+        if (site->parent >= 0) {
+            const SsaSite* parent = &fn->sites[site->parent];
+            if (parent->dead || parent->action != ACTION_NONE) {
+                site->dead = 1;
+                continue;
+            }
+        }
+        if (site->action == ACTION_NONE) continue;
+        if (!fn->blocks[site->block].executable) {
+            site->action = ACTION_NONE;
+            continue;
+        }
+
+        Expr* expr = site->expr;
+        int value = find_value(fn, site->value);
+        switch (site->action) {
+            case ACTION_CONST:
+                clear_expr(expr);
+                set_literal(expr, &fn->values[value]);
+                stats->constants++;
+                break;
+            case ACTION_VARIABLE:
+                clear_expr(expr);
+                set_variable(expr, fn->vars[site->holder].name);
+                if (site->kind == SITE_VAR) stats->copies++;
+                else stats->redundant++;
+                break;
+            case ACTION_HOIST: {
+                int t = 0;
+                while (t < temp_count && !(temps[t].loop == site->hoist_loop && temps[t].value == value)) t++;
+                if (t == temp_count) {
+                    temps = SAGE_REALLOC(temps, sizeof(Temporary) * (size_t)(temp_count + 1));
+                    temps[t].loop = site->hoist_loop;
+                    temps[t].value = value;
+                    temps[t].name = temporary_name(expr, stats);
+                    temp_count++;
+                    Expr* moved = ast_alloc(sizeof(Expr));
+                    *moved = *expr;
+                    memset(&expr->as, 0, sizeof(expr->as));
+                    insert_before_loop(&fn->loops[site->hoist_loop], temps[t].name, moved);
+                } else {
+                    clear_expr(expr);
+                }
+                set_variable(expr, temps[t].name);
+                stats->hoisted++;
+                break;
+            }
+            case ACTION_NONE:
+                break;
+        }
+    }
+    free(temps);
+}
+
+// ============================================================================
+// Debug dump
+// ============================================================================
+
+static const char* op_name(TokenType op) {
+    switch (op) {
+        case TOKEN_PLUS: return "+";
+        case TOKEN_MINUS: return "-";
+        case TOKEN_STAR: return "*";
+        case TOKEN_SLASH: return "/";
+        case TOKEN_PERCENT: return "%";
+        case TOKEN_EQ: return "==";
+        case TOKEN_NEQ: return "!=";
+        case TOKEN_LT: return "<";
+        case TOKEN_GT: return ">";
+        case TOKEN_LTE: return "<=";
+        case TOKEN_GTE: return ">=";
+        case TOKEN_AND: return "and";
+        case TOKEN_OR: return "or";
+        case TOKEN_NOT: return "not";
+        case TOKEN_TILDE: return "~";
+        case TOKEN_AMP: return "&";
+        case TOKEN_PIPE: return "|";
+        case TOKEN_CARET: return "^";
+        case TOKEN_LSHIFT: return "<<";
+        case TOKEN_RSHIFT: return ">>";
+        default: return "?";
+    }
+}
+
+static const char* const g_type_names[] = { "top", "num", "bool", "str", "nil", "any" };
+
+void ssa_dump(const SsaFunction* fn, FILE* out) {
+    for (int b = 0; b < fn->block_count; b++) {
+        const SsaBlock* block = &fn->blocks[b];
+        fprintf(out, "b%d%s:", b, block->executable ? "" : " (dead)");
+        for (int i = 0; i < block->pred_count; i++) fprintf(out, " <-b%d", block->preds[i]);
+        fputc('\n', out);
+        for (int id = 0; id < fn->value_count; id++) {
+            const SsaValue* v = &fn->values[id];
+            if (v->block != b) continue;
+            fprintf(out, "  v%d:%s = ", id, g_type_names[v->type]);
+            switch (v->opcode) {
+                case SSA_CONST:
+                    if (v->type == SSA_TYPE_NUM) fprintf(out, "%g", v->number);
+                    else if (v->type == SSA_TYPE_BOOL) fprintf(out, "%s", v->boolean ? "true" : "false");
+                    else fprintf(out, "nil");
+                    break;
+                case SSA_STRING: fprintf(out, "string"); break;
+                case SSA_PARAM: fprintf(out, "param"); break;
+                case SSA_OPAQUE: fprintf(out, "opaque"); break;
+                case SSA_BINARY:
+                    fprintf(out, "v%d %s v%d", v->args[0], op_name(v->op), v->args[1]);
+                    break;
+                case SSA_UNARY:
+                    fprintf(out, "%s v%d", op_name(v->op), v->args[0]);
+                    break;
+                case SSA_PHI:
+                    fprintf(out, "phi %.*s", fn->vars[v->phi_var].name.length, fn->vars[v->phi_var].name.start);
+                    for (int i = 0; i < v->phi_count; i++) fprintf(out, " v%d", v->phi_args[i]);
+                    break;
+            }
+            if (v->forward >= 0) fprintf(out, "  => v%d", v->forward);
+            else if (v->lattice == SSA_LAT_CONST && v->opcode != SSA_CONST) fprintf(out, "  (const)");
+            fputc('\n', out);
+        }
+        if (block->cond >= 0) {
+            fprintf(out, "  br v%d ? b%d : b%d\n", block->cond, block->succ[0], block->succ[1]);
+        } else if (block->succ[0] >= 0) {
+            fprintf(out, "  jmp b%d\n", block->succ[0]);
+        }
+    }
+}
+
+void ssa_free(SsaFunction* fn) {
+    if (fn == NULL) return;
+    for (int i = 0; i < fn->value_count; i++) free(fn->values[i].phi_args);
+    for (int i = 0; i < fn->block_count; i++) {
+        free(fn->blocks[i].preds);
+        free(fn->blocks[i].pred_slots);
+        free(fn->blocks[i].pred_live);
+        free(fn->blocks[i].phis);
+    }
+    for (int i = 0; i < fn->loop_count; i++) {
+        SsaLoop* loop = &fn->loops[i];
+        free(loop->entry);
+        for (int j = 0; j < loop->break_count; j++) free(loop->breaks[j].state);
+        for (int j = 0; j < loop->continue_count; j++) free(loop->continues[j].state);
+        free(loop->breaks);
+        free(loop->continues);
+    }
+    free(fn->values);
+    free(fn->blocks);
+    free(fn->vars);
+    free(fn->sites);
+    free(fn->loops);
+    free(fn->value_index);
+    free(fn);
+}
+
+// ============================================================================
+// Pass Entry Point
+// ============================================================================
+
+extern Stmt* pass_constfold(Stmt* program, PassContext* ctx);
+
+static void optimize_function(Stmt* program, Stmt* proc, SsaStats* stats, PassContext* ctx) {
+    SsaFunction* fn = ssa_build(program, proc);
+    ssa_optimize(fn, stats);
+    if (ctx->verbose > 1) {
+        if (proc != NULL) fprintf(stderr, "[ssa] proc %.*s\n", proc->as.proc.name.length, proc->as.proc.name.start);
+        else fprintf(stderr, "[ssa] <script>\n");
+        ssa_dump(fn, stderr);
+    }
+    ssa_lower(fn, stats);
+    ssa_free(fn);
+}
+
+static void optimize_procs(Stmt* head, SsaStats* stats, PassContext* ctx);
+
+static void optimize_nested(Stmt* stmt, SsaStats* stats, PassContext* ctx) {
+    switch (stmt->type) {
+        case STMT_PROC:
+            optimize_function(NULL, stmt, stats, ctx);
+            optimize_procs(stmt->as.proc.body, stats, ctx);
+            break;
+        case STMT_ASYNC_PROC:
+            optimize_procs(stmt->as.async_proc.body, stats, ctx);
+            break;
+        case STMT_CLASS:
+            optimize_procs(stmt->as.class_stmt.methods, stats, ctx);
+            break;
+        case STMT_IF:
+            optimize_procs(stmt->as.if_stmt.then_branch, stats, ctx);
+            optimize_procs(stmt->as.if_stmt.else_branch, stats, ctx);
+            break;
+        case STMT_BLOCK:
+            optimize_procs(stmt->as.block.statements, stats, ctx);
+            break;
+        case STMT_WHILE:
+            optimize_procs(stmt->as.while_stmt.body, stats, ctx);
+            break;
+        case STMT_FOR:
+            optimize_procs(stmt->as.for_stmt.body, stats, ctx);
+            break;
+        case STMT_TRY:
+            optimize_procs(stmt->as.try_stmt.try_block, stats, ctx);
+            for (int i = 0; i < stmt->as.try_stmt.catch_count; i++) {
+                optimize_procs(stmt->as.try_stmt.catches[i]->body, stats, ctx);
+            }
+            optimize_procs(stmt->as.try_stmt.finally_block, stats, ctx);
+            break;
+        case STMT_MATCH:
+            for (int i = 0; i < stmt->as.match_stmt.case_count; i++) {
+                optimize_procs(stmt->as.match_stmt.cases[i]->body, stats, ctx);
+            }
+            optimize_procs(stmt->as.match_stmt.default_case, stats, ctx);
+            break;
+        default:
+            break;
+    }
+}
+
+static void optimize_procs(Stmt* head, SsaStats* stats, PassContext* ctx) {
+    for (Stmt* s = head; s != NULL; s = s->next) optimize_nested(s, stats, ctx);
+}
+
+Stmt* pass_ssa(Stmt* program, PassContext* ctx) {
+    SsaStats stats;
+    memset(&stats, 0, sizeof(stats));
+
+    optimize_function(program, NULL, &stats, ctx);
+    optimize_procs(program, &stats, ctx);
+
+    // Conditions SCCP proved constant are now literals; let constfold drop
+    // the dead branches and loops.
+    if (stats.constants > 0) program = pass_constfold(program, ctx);
+
+    if (ctx->verbose) {
+        fprintf(stderr, "[ssa] %d values: %d constants, %d copies, %d redundant, %d hoisted (%d temporaries)\n",
+                stats.values, stats.constants, stats.copies, stats.redundant, stats.hoisted,
+                stats.temporaries);
+    }
+    return program;
+}
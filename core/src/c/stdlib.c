@@ -22,6 +22,11 @@
 #include <unistd.h>
 #include <errno.h>
 #include <stdint.h>
+#include <limits.h>
+#if SAGE_HAS_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#endif
 #include "sage_thread.h"
 
 // ============================================================================
@@ -57,16 +62,10 @@ static Value vm_compile_native(int argCount, Value* args) {
     if (argCount < 1 || !IS_STRING(args[0])) return val_nil();
     const char* source = AS_STRING(args[0]);
 
-    // Save lexer and parser state to allow nested parsing (e.g. from within a running script)
-    LexerState l_state = lexer_get_state();
-    ParserState p_state = parser_get_state();
-
+    // parse_program uses its own Parser context, so the running script's
+    // parse state is left alone.
     Stmt* ast = parse_program(source, "<vm-compile>");
 
-    // Restore lexer and parser state
-    lexer_set_state(l_state);
-    parser_set_state(p_state);
-
     if (!ast) return val_nil();
 
     BytecodeProgram* program = SAGE_ALLOC(sizeof(BytecodeProgram));
@@ -180,7 +179,9 @@ static Value vm_deserialize_native(int argCount, Value* args) {
     }
     unlink(tmp_path);
 
-    return val_pointer(program, sizeof(BytecodeProgram), 1);
+    // A VM program value so vm.execute accepts it; the GC's program release
+    // also drops the artifact mapping the code is borrowed from.
+    return val_vm_program(program);
 }
 
 Module* create_vm_module(ModuleCache* cache) {
@@ -758,6 +759,130 @@ static Value io_listdir_native(int argCount, Value* args) {
     return out_val;
 }
 
+// io.mmap(path, offset?, length?) -> read-only Bytes backed by the file mapping
+// Pages are faulted in on access, so large files cost address space rather
+// than heap. A single view is limited to 2 GB; map bigger files in windows.
+static Value io_mmap_native(int argCount, Value* args) {
+    if (argCount < 1 || !IS_STRING(args[0])) return val_nil();
+#if SAGE_HAS_MMAP
+    int fd = open(AS_STRING(args[0]), O_RDONLY);
+    if (fd < 0) return val_nil();
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) { close(fd); return val_nil(); }
+
+    double offset = (argCount >= 2 && IS_NUMBER(args[1])) ? AS_NUMBER(args[1]) : 0;
+    if (offset < 0 || offset > (double)st.st_size) {
+        close(fd);
+        fprintf(stderr, "Runtime Error: io.mmap offset out of range.\n");
+        return val_nil();
+    }
+    off_t off = (off_t)offset;
+    double length = (argCount >= 3 && IS_NUMBER(args[2])) ? AS_NUMBER(args[2])
+                                                          : (double)(st.st_size - off);
+    if (length < 0) length = 0;
+    if (length > (double)(st.st_size - off)) length = (double)(st.st_size - off);
+
+    off_t page = (off_t)sysconf(_SC_PAGESIZE);
+    off_t base = off - off % page;
+    size_t delta = (size_t)(off - base);
+    if (length + (double)delta > (double)INT_MAX) {
+        close(fd);
+        fprintf(stderr, "Runtime Error: io.mmap view exceeds 2 GB; pass offset and length to map a window.\n");
+        return val_nil();
+    }
+    if (length == 0) { close(fd); return val_bytes(NULL, 0); }
+
+    size_t map_len = (size_t)length + delta;
+    void* map = mmap(NULL, map_len, PROT_READ, MAP_PRIVATE, fd, base);
+    close(fd);
+    if (map == MAP_FAILED) return val_nil();
+#ifdef MADV_SEQUENTIAL
+    madvise(map, map_len, MADV_SEQUENTIAL);
+#endif
+    return val_bytes_mapped((unsigned char*)map + delta, (int)length, map_len);
+#else
+    fprintf(stderr, "Runtime Error: io.mmap is not supported on this platform.\n");
+    return val_nil();
+#endif
+}
+
+// Streaming line reader behind io.lines(). One buffer is reused for every
+// line, so memory stays O(longest line) regardless of file size.
+typedef struct {
+    FILE* f;
+    char* buf;
+    size_t cap;
+} IoLineReader;
+
+static void io_line_reader_close(IoLineReader* r) {
+    if (r->f) { fclose(r->f); r->f = NULL; }
+    free(r->buf);
+    r->buf = NULL;
+    r->cap = 0;
+}
+
+static void io_line_reader_free(void* ptr) {
+    io_line_reader_close((IoLineReader*)ptr);
+    free(ptr);
+}
+
+static IoLineReader* io_as_line_reader(Value v) {
+    if (v.type != VAL_POINTER || v.as.pointer->finalize != io_line_reader_free) return NULL;
+    return (IoLineReader*)v.as.pointer->ptr;
+}
+
+// io.lines(path) -> line reader handle (pass to io.readline / io.close)
+static Value io_lines_native(int argCount, Value* args) {
+    if (argCount < 1 || !IS_STRING(args[0])) return val_nil();
+    FILE* f = fopen(AS_STRING(args[0]), "rb");
+    if (!f) return val_nil();
+    IoLineReader* r = calloc(1, sizeof(IoLineReader));
+    if (!r) { fclose(f); return val_nil(); }
+    r->f = f;
+    Value handle = val_pointer(r, sizeof(IoLineReader), 1);
+    handle.as.pointer->finalize = io_line_reader_free;
+    return handle;
+}
+
+// io.readline(reader) -> next line without its terminator, or nil at EOF.
+// The file is closed automatically once the last line has been read.
+static Value io_readline_native(int argCount, Value* args) {
+    IoLineReader* r = argCount >= 1 ? io_as_line_reader(args[0]) : NULL;
+    if (!r) {
+        fprintf(stderr, "Runtime Error: io.readline expects a reader from io.lines.\n");
+        return val_nil();
+    }
+    if (!r->f) return val_nil();
+
+    ssize_t n = getline(&r->buf, &r->cap, r->f);
+    if (n < 0) {
+        io_line_reader_close(r);
+        return val_nil();
+    }
+    if (n > INT_MAX) {
+        fprintf(stderr, "Runtime Error: io.readline line exceeds 2 GB.\n");
+        io_line_reader_close(r);
+        return val_nil();
+    }
+    int len = (int)n;
+    if (len > 0 && r->buf[len - 1] == '\n') len--;
+    if (len > 0 && r->buf[len - 1] == '\r') len--;
+    return val_string_len(r->buf, len);
+}
+
+// io.close(handle) -> releases a line reader or an io.mmap view early
+static Value io_close_native(int argCount, Value* args) {
+    if (argCount < 1) return val_bool(0);
+    if (args[0].type == VAL_BYTES && args[0].as.bytes->mapped) {
+        bytes_unmap(args[0].as.bytes);
+        return val_bool(1);
+    }
+    IoLineReader* r = io_as_line_reader(args[0]);
+    if (!r) return val_bool(0);
+    io_line_reader_close(r);
+    return val_bool(1);
+}
+
 Module* create_io_module(ModuleCache* cache) {
     Module* m = create_native_module(cache, "io");
     Environment* e = m->env;
@@ -774,6 +899,10 @@ Module* create_io_module(ModuleCache* cache) {
     env_define_const(e, "filesize", 8, val_native(io_filesize_native));
     env_define_const(e, "readbytes", 9, val_native(io_readbytes_native));
     env_define_const(e, "listdir", 7, val_native(io_listdir_native));
+    env_define_const(e, "mmap", 4, val_native(io_mmap_native));
+    env_define_const(e, "lines", 5, val_native(io_lines_native));
+    env_define_const(e, "readline", 8, val_native(io_readline_native));
+    env_define_const(e, "close", 5, val_native(io_close_native));
 
     return m;
 }
@@ -0,0 +1,474 @@
+// src/textindex.c - Native inverted text index for SageLang
+//
+// Provides: _textindex (keyword tokenizer and BM25 search behind lib/llm/rag.sage)
+//
+// Terms live in an open-addressing hash table. Each term keeps a posting
+// list of (document delta, term frequency) pairs packed as LEB128 varints,
+// so a posting usually costs two bytes. Documents are appended with
+// increasing ids, which keeps the deltas small and lets add() run
+// incrementally. search() scores with BM25 using each document's token
+// count and keeps the best k in a bounded min-heap.
+
+#define _DEFAULT_SOURCE
+#include "module.h"
+#include "value.h"
+#include "env.h"
+#include "gc.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#define TI_MIN_WORD 3           // shorter words are not indexed
+#define TI_DEFAULT_K1 1.2
+#define TI_DEFAULT_B 0.75
+
+typedef struct {
+    char* word;
+    int len;
+    unsigned int hash;
+    uint8_t* postings;      // varint pairs: doc - previous doc, term frequency
+    size_t size;
+    size_t cap;
+    int df;                 // documents containing the term
+    int last_doc;           // last document with a posting
+    int pending_tf;         // occurrences in the document being added
+} TiTerm;
+
+typedef struct {
+    TiTerm* terms;
+    int term_count;
+    int term_cap;
+    int* slots;             // term index per hash slot, -1 when empty
+    int slot_cap;           // power of two
+
+    uint32_t* doc_len;      // tokens per document
+    int doc_count;
+    int doc_cap;
+    double total_len;
+
+    int* touched;           // terms seen by the document being added
+    int touched_count;
+    int touched_cap;
+
+    float* acc;             // per-document score accumulator for search
+    uint32_t* seen;         // query stamp per document; acc is live where it matches
+    uint32_t stamp;         // current query
+    int* hits;              // documents the current query has touched
+    int acc_cap;
+} TextIndex;
+
+// ============================================================================
+// Tokenizer
+// ============================================================================
+
+// Words are runs of [a-z0-9_] after ASCII lowercasing, as extract_keywords
+// in rag.sage defines them. Calls emit(word, len, ctx) for each word kept.
+static void ti_tokenize(const char* text, void (*emit)(const char*, int, void*), void* ctx) {
+    char word[256];
+    int len = 0;
+    int long_word = 0;          // past the buffer: emitted from the source
+    const char* start = text;
+    for (const char* p = text;; p++) {
+        unsigned char c = (unsigned char)*p;
+        if (c >= 'A' && c <= 'Z') c = (unsigned char)(c + 32);
+        if ((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '_') {
+            if (len == 0) start = p;
+            if (len < (int)sizeof(word)) word[len] = (char)c;
+            else long_word = 1;
+            len++;
+            continue;
+        }
+        if (len >= TI_MIN_WORD) {
+            if (!long_word) {
+                emit(word, len, ctx);
+            } else {
+                char* copy = malloc((size_t)len);
+                if (copy) {
+                    for (int i = 0; i < len; i++) {
+                        char w = start[i];
+                        copy[i] = (w >= 'A' && w <= 'Z') ? (char)(w + 32) : w;
+                    }
+                    emit(copy, len, ctx);
+                    free(copy);
+                }
+            }
+        }
+        len = 0;
+        long_word = 0;
+        if (c == '\0') return;
+    }
+}
+
+// ============================================================================
+// Term table
+// ============================================================================
+
+static unsigned int ti_hash(const char* s, int len) {
+    unsigned int h = 2166136261u;
+    for (int i = 0; i < len; i++) {
+        h ^= (unsigned char)s[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static int ti_find_slot(const TextIndex* ix, const char* word, int len, unsigned int hash) {
+    int mask = ix->slot_cap - 1;
+    int i = (int)(hash & (unsigned int)mask);
+    for (;;) {
+        int t = ix->slots[i];
+        if (t < 0) return i;
+        const TiTerm* term = &ix->terms[t];
+        if (term->hash == hash && term->len == len && memcmp(term->word, word, (size_t)len) == 0) return i;
+        i = (i + 1) & mask;
+    }
+}
+
+static void ti_grow_slots(TextIndex* ix) {
+    int cap = ix->slot_cap ? ix->slot_cap * 2 : 1024;
+    free(ix->slots);
+    ix->slots = SAGE_ALLOC(sizeof(int) * (size_t)cap);
+    memset(ix->slots, 0xff, sizeof(int) * (size_t)cap);
+    ix->slot_cap = cap;
+    for (int t = 0; t < ix->term_count; t++) {
+        TiTerm* term = &ix->terms[t];
+        ix->slots[ti_find_slot(ix, term->word, term->len, term->hash)] = t;
+    }
+}
+
+static int ti_lookup(const TextIndex* ix, const char* word, int len) {
+    if (ix->slot_cap == 0) return -1;
+    return ix->slots[ti_find_slot(ix, word, len, ti_hash(word, len))];
+}
+
+static int ti_intern(TextIndex* ix, const char* word, int len) {
+    if (ix->term_count * 2 >= ix->slot_cap) ti_grow_slots(ix);
+    unsigned int hash = ti_hash(word, len);
+    int slot = ti_find_slot(ix, word, len, hash);
+    if (ix->slots[slot] >= 0) return ix->slots[slot];
+
+    if (ix->term_count == ix->term_cap) {
+        ix->term_cap = ix->term_cap ? ix->term_cap * 2 : 1024;
+        ix->terms = SAGE_REALLOC(ix->terms, sizeof(TiTerm) * (size_t)ix->term_cap);
+    }
+    TiTerm* term = &ix->terms[ix->term_count];
+    memset(term, 0, sizeof(*term));
+    term->word = SAGE_ALLOC((size_t)len + 1);
+    memcpy(term->word, word, (size_t)len);
+    term->word[len] = '\0';
+    term->len = len;
+    term->hash = hash;
+    term->last_doc = -1;
+    ix->slots[slot] = ix->term_count;
+    return ix->term_count++;
+}
+
+// ============================================================================
+// Postings
+// ============================================================================
+
+static void ti_put_varint(TiTerm* term, uint32_t v) {
+    if (term->size + 5 > term->cap) {
+        term->cap = term->cap ? term->cap * 2 : 8;
+        term->postings = SAGE_REALLOC(term->postings, term->cap);
+    }
+    while (v >= 0x80) {
+        term->postings[term->size++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    term->postings[term->size++] = (uint8_t)v;
+}
+
+static uint32_t ti_get_varint(const uint8_t** p) {
+    uint32_t v = 0;
+    int shift = 0;
+    uint8_t b;
+    do {
+        b = *(*p)++;
+        v |= (uint32_t)(b & 0x7f) << shift;
+        shift += 7;
+    } while (b & 0x80);
+    return v;
+}
+
+typedef struct {
+    TextIndex* ix;
+    uint32_t tokens;
+} TiAdd;
+
+static void ti_add_word(const char* word, int len, void* ctx) {
+    TiAdd* add = ctx;
+    TextIndex* ix = add->ix;
+    int t = ti_intern(ix, word, len);
+    TiTerm* term = &ix->terms[t];
+    add->tokens++;
+    if (term->pending_tf++ > 0) return;
+    if (ix->touched_count == ix->touched_cap) {
+        ix->touched_cap = ix->touched_cap ? ix->touched_cap * 2 : 256;
+        ix->touched = SAGE_REALLOC(ix->touched, sizeof(int) * (size_t)ix->touched_cap);
+    }
+    ix->touched[ix->touched_count++] = t;
+}
+
+// Index text as the next document and return its id
+static int ti_add(TextIndex* ix, const char* text) {
+    int doc = ix->doc_count;
+    TiAdd add = {ix, 0};
+    ti_tokenize(text, ti_add_word, &add);
+
+    for (int i = 0; i < ix->touched_count; i++) {
+        TiTerm* term = &ix->terms[ix->touched[i]];
+        ti_put_varint(term, (uint32_t)(doc - (term->last_doc < 0 ? 0 : term->last_doc)));
+        ti_put_varint(term, (uint32_t)term->pending_tf);
+        term->last_doc = doc;
+        term->pending_tf = 0;
+        term->df++;
+    }
+    ix->touched_count = 0;
+
+    if (ix->doc_count == ix->doc_cap) {
+        ix->doc_cap = ix->doc_cap ? ix->doc_cap * 2 : 1024;
+        ix->doc_len = SAGE_REALLOC(ix->doc_len, sizeof(uint32_t) * (size_t)ix->doc_cap);
+    }
+    ix->doc_len[ix->doc_count++] = add.tokens;
+    ix->total_len += add.tokens;
+    return doc;
+}
+
+// ============================================================================
+// BM25 search
+// ============================================================================
+
+typedef struct {
+    TextIndex* ix;
+    double k1;
+    double b;
+    double avg_len;
+    int hit_count;
+} TiSearch;
+
+// Add one query term's BM25 contribution to every document that holds it.
+// A term repeated in the query counts once per occurrence.
+static void ti_score_word(const char* word, int len, void* ctx) {
+    TiSearch* q = ctx;
+    TextIndex* ix = q->ix;
+    int t = ti_lookup(ix, word, len);
+    if (t < 0) return;
+    const TiTerm* term = &ix->terms[t];
+    double n = ix->doc_count;
+    double idf = log(1.0 + (n - term->df + 0.5) / (term->df + 0.5));
+
+    const uint8_t* p = term->postings;
+    const uint8_t* end = p + term->size;
+    int doc = 0;
+    while (p < end) {
+        doc += (int)ti_get_varint(&p);
+        double tf = ti_get_varint(&p);
+        double norm = q->k1 * (1.0 - q->b + q->b * ix->doc_len[doc] / q->avg_len);
+        // Scores may sum to exactly 0 with unusual k1/b, so the stamp marks first touch
+        if (ix->seen[doc] != ix->stamp) {
+            ix->seen[doc] = ix->stamp;
+            ix->acc[doc] = 0.0f;
+            ix->hits[q->hit_count++] = doc;
+        }
+        ix->acc[doc] += (float)(idf * tf * (q->k1 + 1.0) / (tf + norm));
+    }
+}
+
+typedef struct {
+    float score;
+    int doc;
+} TiHit;
+
+// Heap order: the worst hit on top. Lower scores are worse; on a tie the
+// later document is worse, so results prefer earlier chunks.
+static int ti_worse(TiHit a, TiHit b) {
+    return a.score < b.score || (a.score == b.score && a.doc > b.doc);
+}
+
+static void ti_sift_down(TiHit* heap, int n, int i) {
+    for (;;) {
+        int worst = i;
+        int l = 2 * i + 1;
+        int r = l + 1;
+        if (l < n && ti_worse(heap[l], heap[worst])) worst = l;
+        if (r < n && ti_worse(heap[r], heap[worst])) worst = r;
+        if (worst == i) return;
+        TiHit tmp = heap[i];
+        heap[i] = heap[worst];
+        heap[worst] = tmp;
+        i = worst;
+    }
+}
+
+static void ti_sift_up(TiHit* heap, int i) {
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (!ti_worse(heap[i], heap[parent])) return;
+        TiHit tmp = heap[i];
+        heap[i] = heap[parent];
+        heap[parent] = tmp;
+        i = parent;
+    }
+}
+
+// Fill out with the k best documents for query, best first; returns the count
+static int ti_search(TextIndex* ix, const char* query, int k, double k1, double b, TiHit* out) {
+    if (ix->doc_count == 0 || k <= 0) return 0;
+    if (ix->acc_cap < ix->doc_count) {
+        free(ix->acc);
+        free(ix->seen);
+        free(ix->hits);
+        ix->acc_cap = ix->doc_cap;
+        ix->acc = SAGE_ALLOC(sizeof(float) * (size_t)ix->acc_cap);
+        ix->seen = SAGE_ALLOC(sizeof(uint32_t) * (size_t)ix->acc_cap);
+        ix->hits = SAGE_ALLOC(sizeof(int) * (size_t)ix->acc_cap);
+        ix->stamp = 0;
+    }
+    if (++ix->stamp == 0) {
+        memset(ix->seen, 0, sizeof(uint32_t) * (size_t)ix->acc_cap);
+        ix->stamp = 1;
+    }
+
+    TiSearch q = {ix, k1, b, ix->total_len > 0 ? ix->total_len / ix->doc_count : 1.0, 0};
+    ti_tokenize(query, ti_score_word, &q);
+
+    int n = 0;
+    for (int i = 0; i < q.hit_count; i++) {
+        TiHit h = {ix->acc[ix->hits[i]], ix->hits[i]};
+        if (n < k) {
+            out[n] = h;
+            ti_sift_up(out, n++);
+        } else if (ti_worse(out[0], h)) {
+            out[0] = h;
+            ti_sift_down(out, n, 0);
+        }
+    }
+
+    // Pop the worst to the back until the heap is empty: best first
+    for (int end = n - 1; end > 0; end--) {
+        TiHit tmp = out[0];
+        out[0] = out[end];
+        out[end] = tmp;
+        ti_sift_down(out, end, 0);
+    }
+    return n;
+}
+
+// ============================================================================
+// Module functions
+// ============================================================================
+
+static void ti_free(void* ptr) {
+    TextIndex* ix = ptr;
+    for (int t = 0; t < ix->term_count; t++) {
+        free(ix->terms[t].word);
+        free(ix->terms[t].postings);
+    }
+    free(ix->terms);
+    free(ix->slots);
+    free(ix->doc_len);
+    free(ix->touched);
+    free(ix->acc);
+    free(ix->seen);
+    free(ix->hits);
+    free(ix);
+}
+
+static TextIndex* ti_as_index(Value v) {
+    if (v.type != VAL_POINTER || v.as.pointer->finalize != ti_free) return NULL;
+    return (TextIndex*)v.as.pointer->ptr;
+}
+
+static TextIndex* ti_arg(int argCount, Value* args, const char* fn) {
+    TextIndex* ix = argCount >= 1 ? ti_as_index(args[0]) : NULL;
+    if (!ix) fprintf(stderr, "Runtime Error: _textindex.%s expects an index from _textindex.create.\n", fn);
+    return ix;
+}
+
+// _textindex.create() -> empty index
+static Value ti_create_native(int argCount, Value* args) {
+    (void)argCount; (void)args;
+    TextIndex* ix = calloc(1, sizeof(TextIndex));
+    if (!ix) return val_nil();
+    Value handle = val_pointer(ix, sizeof(TextIndex), 1);
+    handle.as.pointer->finalize = ti_free;
+    return handle;
+}
+
+// _textindex.add(index, text) -> id of the new document (0, 1, 2, ...)
+static Value ti_add_native(int argCount, Value* args) {
+    TextIndex* ix = ti_arg(argCount, args, "add");
+    if (!ix || argCount < 2 || !IS_STRING(args[1])) return val_nil();
+    return val_number(ti_add(ix, AS_STRING(args[1])));
+}
+
+// _textindex.search(index, query, k, [k1], [b]) -> [[doc, score], ...], best first
+static Value ti_search_native(int argCount, Value* args) {
+    TextIndex* ix = ti_arg(argCount, args, "search");
+    if (!ix || argCount < 3 || !IS_STRING(args[1]) || !IS_NUMBER(args[2])) return val_nil();
+    int k = (int)AS_NUMBER(args[2]);
+    if (k > ix->doc_count) k = ix->doc_count;
+    double k1 = argCount >= 4 && IS_NUMBER(args[3]) ? AS_NUMBER(args[3]) : TI_DEFAULT_K1;
+    double b = argCount >= 5 && IS_NUMBER(args[4]) ? AS_NUMBER(args[4]) : TI_DEFAULT_B;
+
+    TiHit* hits = k > 0 ? SAGE_ALLOC(sizeof(TiHit) * (size_t)k) : NULL;
+    int n = hits ? ti_search(ix, AS_STRING(args[1]), k, k1, b, hits) : 0;
+
+    gc_pin();
+    Value result = val_array();
+    for (int i = 0; i < n; i++) {
+        Value pair = val_array();
+        array_push(&pair, val_number(hits[i].doc));
+        array_push(&pair, val_number(hits[i].score));
+        array_push(&result, pair);
+    }
+    gc_unpin();
+    free(hits);
+    return result;
+}
+
+static void ti_push_word(const char* word, int len, void* ctx) {
+    array_push((Value*)ctx, val_string_len(word, len));
+}
+
+// _textindex.keywords(text) -> the words add() would index, in order
+static Value ti_keywords_native(int argCount, Value* args) {
+    if (argCount < 1 || !IS_STRING(args[0])) return val_nil();
+    gc_pin();
+    Value words = val_array();
+    ti_tokenize(AS_STRING(args[0]), ti_push_word, &words);
+    gc_unpin();
+    return words;
+}
+
+// _textindex.stats(index) -> {documents, terms, tokens, posting_bytes}
+static Value ti_stats_native(int argCount, Value* args) {
+    TextIndex* ix = ti_arg(argCount, args, "stats");
+    if (!ix) return val_nil();
+    double bytes = 0;
+    for (int t = 0; t < ix->term_count; t++) bytes += (double)ix->terms[t].size;
+    gc_pin();
+    Value stats = val_dict();
+    dict_set(&stats, "documents", val_number(ix->doc_count));
+    dict_set(&stats, "terms", val_number(ix->term_count));
+    dict_set(&stats, "tokens", val_number(ix->total_len));
+    dict_set(&stats, "posting_bytes", val_number(bytes));
+    gc_unpin();
+    return stats;
+}
+
+Module* create_textindex_module(ModuleCache* cache) {
+    Module* m = create_native_module(cache, "_textindex");
+    Environment* e = m->env;
+
+    env_define_const(e, "create", 6, val_native(ti_create_native));
+    env_define_const(e, "add", 3, val_native(ti_add_native));
+    env_define_const(e, "search", 6, val_native(ti_search_native));
+    env_define_const(e, "keywords", 8, val_native(ti_keywords_native));
+    env_define_const(e, "stats", 5, val_native(ti_stats_native));
+
+    return m;
+}
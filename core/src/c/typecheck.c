@@ -22,6 +22,16 @@ void typemap_init(TypeMap* map) {
     map->entries = NULL;
     map->env = NULL;
     map->current_return_type = make_type(SAGE_TYPE_UNKNOWN);
+    map->facts = NULL;
+}
+
+static void typeenv_free_list(TypeEnv* v) {
+    while (v != NULL) {
+        TypeEnv* next = v->next;
+        free(v->name);
+        free(v);
+        v = next;
+    }
 }
 
 void typemap_free(TypeMap* map) {
@@ -31,15 +41,14 @@ void typemap_free(TypeMap* map) {
         free(e);
         e = next;
     }
-    TypeEnv* v = map->env;
-    while (v != NULL) {
-        TypeEnv* next = v->next;
-        free(v->name);
-        free(v);
-        v = next;
+    typeenv_free_list(map->env);
+    if (map->facts != NULL) {
+        for (int i = 0; i < TYPE_FACT_BUCKETS; i++) typeenv_free_list(map->facts[i]);
+        free(map->facts);
     }
     map->entries = NULL;
     map->env = NULL;
+    map->facts = NULL;
 }
 
 void typemap_set(TypeMap* map, const Expr* expr, SageType type) {
@@ -385,6 +394,334 @@ static void infer_stmt(TypeMap* map, Stmt* stmt) {
     }
 }
 
+// ============================================================================
+// Type Facts
+//
+// Flow-insensitive: each name gets the join of every value bound to it, so a
+// fact holds at every read of the name. Code outside the analysed program
+// (natives, FFI, other modules) can still break a fact, which is why the
+// quickened operations keep a tag guard and fall back to the generic one.
+// ============================================================================
+
+#define FACT_UNSET (-1)  // no binding seen yet (bottom of the lattice)
+
+typedef struct {
+    TypeMap* map;
+    int changed;
+    int annotate;
+} FactWalk;
+
+static unsigned fact_hash(const char* name, int length) {
+    unsigned h = 2166136261u;
+    for (int i = 0; i < length; i++) h = (h ^ (unsigned char)name[i]) * 16777619u;
+    return h % TYPE_FACT_BUCKETS;
+}
+
+static TypeEnv* fact_find(TypeMap* map, const char* name, int length) {
+    if (map->facts == NULL) return NULL;
+    for (TypeEnv* v = map->facts[fact_hash(name, length)]; v != NULL; v = v->next) {
+        if (strncmp(v->name, name, (size_t)length) == 0 && v->name[length] == '\0') return v;
+    }
+    return NULL;
+}
+
+static int fact_join(int a, int b) {
+    if (a == FACT_UNSET) return b;
+    if (b == FACT_UNSET || a == b) return a;
+    return SAGE_TYPE_UNKNOWN;
+}
+
+static void fact_bind(FactWalk* w, const char* name, int length, int kind) {
+    if (name == NULL || kind == FACT_UNSET) return;
+    TypeEnv* v = fact_find(w->map, name, length);
+    if (v != NULL) {
+        int joined = fact_join((int)v->type.kind, kind);
+        if (joined != (int)v->type.kind) {
+            v->type.kind = (SageTypeKind)joined;
+            w->changed = 1;
+        }
+        return;
+    }
+    if (w->map->facts == NULL) w->map->facts = calloc(TYPE_FACT_BUCKETS, sizeof(TypeEnv*));
+    unsigned bucket = fact_hash(name, length);
+    v = malloc(sizeof(TypeEnv));
+    v->name = SAGE_ALLOC((size_t)length + 1);
+    memcpy(v->name, name, (size_t)length);
+    v->type = make_type((SageTypeKind)kind);
+    v->next = w->map->facts[bucket];
+    w->map->facts[bucket] = v;
+    w->changed = 1;
+}
+
+static void fact_bind_token(FactWalk* w, Token name, int kind) {
+    fact_bind(w, name.start, name.length, kind);
+}
+
+static void fact_bind_string(FactWalk* w, const char* name) {
+    if (name != NULL) fact_bind(w, name, (int)strlen(name), SAGE_TYPE_UNKNOWN);
+}
+
+// Operators the quickened interpreter and VM paths handle
+static int fact_quickenable(TokenType op) {
+    switch (op) {
+        case TOKEN_PLUS: case TOKEN_MINUS: case TOKEN_STAR: case TOKEN_SLASH: case TOKEN_PERCENT:
+        case TOKEN_LT: case TOKEN_GT: case TOKEN_LTE: case TOKEN_GTE:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+static int fact_binary(TokenType op, int left, int right) {
+    switch (op) {
+        case TOKEN_NOT: case TOKEN_AND: case TOKEN_OR: case TOKEN_EQ: case TOKEN_NEQ:
+        case TOKEN_LT: case TOKEN_GT: case TOKEN_LTE: case TOKEN_GTE:
+            return SAGE_TYPE_BOOL;
+        case TOKEN_TILDE:
+            if (left == FACT_UNSET) return FACT_UNSET;
+            return left == SAGE_TYPE_NUMBER ? SAGE_TYPE_NUMBER : SAGE_TYPE_UNKNOWN;
+        case TOKEN_PLUS:
+            if (left == FACT_UNSET || right == FACT_UNSET) return FACT_UNSET;
+            if (left == right && (left == SAGE_TYPE_NUMBER || left == SAGE_TYPE_STRING || left == SAGE_TYPE_ARRAY)) return left;
+            return SAGE_TYPE_UNKNOWN;
+        case TOKEN_MINUS: case TOKEN_STAR:
+        case TOKEN_AMP: case TOKEN_PIPE: case TOKEN_CARET: case TOKEN_LSHIFT: case TOKEN_RSHIFT:
+            if (left == FACT_UNSET || right == FACT_UNSET) return FACT_UNSET;
+            return left == SAGE_TYPE_NUMBER && right == SAGE_TYPE_NUMBER ? SAGE_TYPE_NUMBER : SAGE_TYPE_UNKNOWN;
+        default:
+            return SAGE_TYPE_UNKNOWN;
+    }
+}
+
+// `/` and `%` by zero give nil on the VM, so only a literal divisor proves them
+static int fact_division(const BinaryExpr* b, int left) {
+    if (b->op.type != TOKEN_SLASH && b->op.type != TOKEN_PERCENT) return SAGE_TYPE_UNKNOWN;
+    if (b->right == NULL || b->right->type != EXPR_NUMBER || b->right->as.number.value == 0) {
+        return SAGE_TYPE_UNKNOWN;
+    }
+    return (left == SAGE_TYPE_NUMBER || left == FACT_UNSET) ? left : SAGE_TYPE_UNKNOWN;
+}
+
+static void fact_stmts(FactWalk* w, Stmt* head);
+
+static int fact_expr(FactWalk* w, Expr* expr) {
+    if (expr == NULL) return SAGE_TYPE_NIL;
+
+    switch (expr->type) {
+        case EXPR_NUMBER: return SAGE_TYPE_NUMBER;
+        case EXPR_STRING: return SAGE_TYPE_STRING;
+        case EXPR_BOOL:   return SAGE_TYPE_BOOL;
+        case EXPR_NIL:    return SAGE_TYPE_NIL;
+        case EXPR_VARIABLE: {
+            TypeEnv* v = fact_find(w->map, expr->as.variable.name.start, expr->as.variable.name.length);
+            if (v != NULL) return (int)v->type.kind;
+            // Bound outside the analysed program (builtins, earlier modules)
+            return w->annotate ? SAGE_TYPE_UNKNOWN : FACT_UNSET;
+        }
+        case EXPR_BINARY: {
+            BinaryExpr* b = &expr->as.binary;
+            int left = fact_expr(w, b->left);
+            int right = b->right != NULL ? fact_expr(w, b->right) : FACT_UNSET;
+            if (w->annotate && left == SAGE_TYPE_NUMBER && right == SAGE_TYPE_NUMBER &&
+                fact_quickenable(b->op.type)) {
+                b->quickened = 1;
+                b->left_is_num = 1;
+                b->right_is_num = 1;
+            }
+            int divided = fact_division(b, left);
+            if (divided != SAGE_TYPE_UNKNOWN) return divided;
+            return fact_binary(b->op.type, left, right);
+        }
+        case EXPR_ARRAY:
+            for (int i = 0; i < expr->as.array.count; i++) fact_expr(w, expr->as.array.elements[i]);
+            return SAGE_TYPE_ARRAY;
+        case EXPR_TUPLE:
+            for (int i = 0; i < expr->as.tuple.count; i++) fact_expr(w, expr->as.tuple.elements[i]);
+            return SAGE_TYPE_TUPLE;
+        case EXPR_DICT:
+            for (int i = 0; i < expr->as.dict.count; i++) fact_expr(w, expr->as.dict.values[i]);
+            return SAGE_TYPE_DICT;
+        case EXPR_CALL:
+            fact_expr(w, expr->as.call.callee);
+            for (int i = 0; i < expr->as.call.arg_count; i++) fact_expr(w, expr->as.call.args[i]);
+            return SAGE_TYPE_UNKNOWN;
+        case EXPR_INDEX: {
+            int array = fact_expr(w, expr->as.index.array);
+            int index = fact_expr(w, expr->as.index.index);
+            if (w->annotate && array == SAGE_TYPE_ARRAY && index == SAGE_TYPE_NUMBER) {
+                expr->as.index.quickened = 1;
+            }
+            return SAGE_TYPE_UNKNOWN;
+        }
+        case EXPR_INDEX_SET:
+            fact_expr(w, expr->as.index_set.array);
+            fact_expr(w, expr->as.index_set.index);
+            return fact_expr(w, expr->as.index_set.value);
+        case EXPR_SLICE:
+            fact_expr(w, expr->as.slice.array);
+            if (expr->as.slice.start != NULL) fact_expr(w, expr->as.slice.start);
+            if (expr->as.slice.end != NULL) fact_expr(w, expr->as.slice.end);
+            return SAGE_TYPE_UNKNOWN;
+        case EXPR_GET:
+            fact_expr(w, expr->as.get.object);
+            return SAGE_TYPE_UNKNOWN;
+        case EXPR_SET: {
+            if (expr->as.set.object != NULL) fact_expr(w, expr->as.set.object);
+            int value = fact_expr(w, expr->as.set.value);
+            if (expr->as.set.object == NULL) fact_bind_token(w, expr->as.set.property, value);
+            return value;
+        }
+        case EXPR_AWAIT:
+            fact_expr(w, expr->as.await.expression);
+            return SAGE_TYPE_UNKNOWN;
+        case EXPR_COMPTIME:
+            return fact_expr(w, expr->as.comptime.expression);
+        case EXPR_PROC:
+            for (int i = 0; i < expr->as.proc_expr.param_count; i++) {
+                fact_bind_token(w, expr->as.proc_expr.params[i], SAGE_TYPE_UNKNOWN);
+            }
+            fact_stmts(w, expr->as.proc_expr.body);
+            return SAGE_TYPE_PROC;
+        default:
+            return SAGE_TYPE_UNKNOWN;
+    }
+}
+
+static int is_range_call(FactWalk* w, const Expr* iterable) {
+    if (iterable == NULL || iterable->type != EXPR_CALL) return 0;
+    const Expr* callee = iterable->as.call.callee;
+    if (callee->type != EXPR_VARIABLE) return 0;
+    Token name = callee->as.variable.name;
+    if (name.length != 5 || strncmp(name.start, "range", 5) != 0) return 0;
+    // A program that binds its own range() gets no fact
+    return fact_find(w->map, "range", 5) == NULL;
+}
+
+static void fact_proc(FactWalk* w, ProcStmt* proc) {
+    fact_bind_token(w, proc->name, SAGE_TYPE_UNKNOWN);
+    for (int i = 0; i < proc->param_count; i++) {
+        fact_bind_token(w, proc->params[i], SAGE_TYPE_UNKNOWN);
+        if (proc->defaults != NULL && proc->defaults[i] != NULL) fact_expr(w, proc->defaults[i]);
+    }
+    fact_stmts(w, proc->body);
+}
+
+static void fact_stmt(FactWalk* w, Stmt* stmt) {
+    switch (stmt->type) {
+        case STMT_PRINT:
+            fact_expr(w, stmt->as.print.expression);
+            break;
+        case STMT_EXPRESSION:
+            fact_expr(w, stmt->as.expression);
+            break;
+        case STMT_LET:
+            fact_bind_token(w, stmt->as.let.name, fact_expr(w, stmt->as.let.initializer));
+            break;
+        case STMT_IF:
+            fact_expr(w, stmt->as.if_stmt.condition);
+            fact_stmts(w, stmt->as.if_stmt.then_branch);
+            fact_stmts(w, stmt->as.if_stmt.else_branch);
+            break;
+        case STMT_BLOCK:
+            fact_stmts(w, stmt->as.block.statements);
+            break;
+        case STMT_WHILE:
+            fact_expr(w, stmt->as.while_stmt.condition);
+            fact_stmts(w, stmt->as.while_stmt.body);
+            break;
+        case STMT_FOR:
+            fact_expr(w, stmt->as.for_stmt.iterable);
+            fact_bind_token(w, stmt->as.for_stmt.variable,
+                            is_range_call(w, stmt->as.for_stmt.iterable) ? SAGE_TYPE_NUMBER : SAGE_TYPE_UNKNOWN);
+            fact_stmts(w, stmt->as.for_stmt.body);
+            break;
+        case STMT_PROC:
+            fact_proc(w, &stmt->as.proc);
+            break;
+        case STMT_ASYNC_PROC:
+            fact_proc(w, &stmt->as.async_proc);
+            break;
+        case STMT_RETURN:
+            if (stmt->as.ret.value != NULL) fact_expr(w, stmt->as.ret.value);
+            break;
+        case STMT_CLASS:
+            fact_bind_token(w, stmt->as.class_stmt.name, SAGE_TYPE_UNKNOWN);
+            fact_stmts(w, stmt->as.class_stmt.methods);
+            break;
+        case STMT_STRUCT:
+            fact_bind_token(w, stmt->as.struct_stmt.name, SAGE_TYPE_UNKNOWN);
+            break;
+        case STMT_ENUM:
+            fact_bind_token(w, stmt->as.enum_stmt.name, SAGE_TYPE_UNKNOWN);
+            break;
+        case STMT_TRAIT:
+            fact_bind_token(w, stmt->as.trait_stmt.name, SAGE_TYPE_UNKNOWN);
+            fact_stmts(w, stmt->as.trait_stmt.methods);
+            break;
+        case STMT_MATCH:
+            fact_expr(w, stmt->as.match_stmt.value);
+            for (int i = 0; i < stmt->as.match_stmt.case_count; i++) {
+                CaseClause* c = stmt->as.match_stmt.cases[i];
+                fact_expr(w, c->pattern);
+                if (c->guard != NULL) fact_expr(w, c->guard);
+                fact_stmts(w, c->body);
+            }
+            fact_stmts(w, stmt->as.match_stmt.default_case);
+            break;
+        case STMT_DEFER:
+            fact_stmts(w, stmt->as.defer.statement);
+            break;
+        case STMT_TRY:
+            fact_stmts(w, stmt->as.try_stmt.try_block);
+            for (int i = 0; i < stmt->as.try_stmt.catch_count; i++) {
+                fact_bind_token(w, stmt->as.try_stmt.catches[i]->exception_var, SAGE_TYPE_UNKNOWN);
+                fact_stmts(w, stmt->as.try_stmt.catches[i]->body);
+            }
+            fact_stmts(w, stmt->as.try_stmt.finally_block);
+            break;
+        case STMT_RAISE:
+            fact_expr(w, stmt->as.raise.exception);
+            break;
+        case STMT_YIELD:
+            if (stmt->as.yield_stmt.value != NULL) fact_expr(w, stmt->as.yield_stmt.value);
+            break;
+        case STMT_IMPORT: {
+            ImportStmt* import = &stmt->as.import;
+            fact_bind_string(w, import->module_name);
+            fact_bind_string(w, import->alias);
+            for (int i = 0; i < import->item_count; i++) {
+                fact_bind_string(w, import->items != NULL ? import->items[i] : NULL);
+                fact_bind_string(w, import->item_aliases != NULL ? import->item_aliases[i] : NULL);
+            }
+            break;
+        }
+        case STMT_COMPTIME:
+            fact_stmts(w, stmt->as.comptime.body);
+            break;
+        case STMT_MACRO_DEF:
+            fact_bind_token(w, stmt->as.macro_def.name, SAGE_TYPE_UNKNOWN);
+            fact_stmts(w, stmt->as.macro_def.body);
+            break;
+        default:
+            break;
+    }
+}
+
+static void fact_stmts(FactWalk* w, Stmt* head) {
+    for (Stmt* s = head; s != NULL; s = s->next) fact_stmt(w, s);
+}
+
+void typecheck_annotate(TypeMap* map, Stmt* program) {
+    FactWalk w = { map, 0, 0 };
+    // Joins only climb a lattice of height two, so this settles quickly
+    do {
+        w.changed = 0;
+        fact_stmts(&w, program);
+    } while (w.changed);
+    w.annotate = 1;
+    fact_stmts(&w, program);
+}
+
 // ============================================================================
 // Type Check Pass Entry Point
 // ============================================================================
@@ -5,6 +5,11 @@
 #include "value.h"
 #include "gc.h"
 #include "module.h"
+#if SAGE_HAS_MMAP
+#include <stdint.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 const Value sage_nil = {VAL_NIL, {.number = 0.0}};
 
@@ -72,9 +77,38 @@ Value val_bytes_empty(int capacity) {
     return v;
 }
 
+// Wrap an existing read-only mapping. `data` may sit up to one page past the
+// page-aligned mapping base; `map_len` is the full length passed to mmap().
+Value val_bytes_mapped(unsigned char* data, int length, size_t map_len) {
+    Value v;
+    v.type = VAL_BYTES;
+    v.as.bytes = gc_alloc(VAL_BYTES, sizeof(BytesValue));
+    v.as.bytes->data = data;
+    v.as.bytes->length = length;
+    v.as.bytes->capacity = (int)map_len;
+    v.as.bytes->mapped = 1;
+    return v;
+}
+
+void bytes_unmap(BytesValue* b) {
+    if (!b->mapped || !b->data) return;
+#if SAGE_HAS_MMAP
+    uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+    void* base = (void*)((uintptr_t)b->data & ~(page - 1));
+    munmap(base, (size_t)b->capacity);
+#endif
+    b->data = NULL;
+    b->length = 0;
+    b->capacity = 0;
+}
+
 void bytes_push(Value* bytes_val, unsigned char byte) {
     if (bytes_val->type != VAL_BYTES) return;
     BytesValue* b = bytes_val->as.bytes;
+    if (b->mapped) {
+        fprintf(stderr, "Runtime Error: Cannot modify read-only mapped bytes.\n");
+        return;
+    }
     if (b->length >= b->capacity) {
         b->capacity = b->capacity * 2;
         b->data = SAGE_REALLOC(b->data, b->capacity);
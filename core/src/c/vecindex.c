@@ -0,0 +1,1208 @@
+// src/vecindex.c - Native vector similarity index for SageLang
+//
+// Provides: _vecindex (flat and HNSW nearest-neighbour search behind lib/llm)
+//
+// Vectors live in one contiguous f32 array, one row per id. The distance
+// kernels use SSE on x86-64 (AVX2/FMA when the CPU reports it) and NEON on
+// AArch64, with a portable fallback. Cosine indexes normalize rows on insert
+// and queries on search, so every metric is a dot product or a squared L2
+// distance over raw rows.
+//
+// A flat index scans every row. An HNSW index keeps the layered graph of
+// Malkov & Yashunin: M neighbours per node on the upper layers, 2M on layer
+// 0, neighbours picked with the diversity heuristic. Batch queries are split
+// across threads, each with its own visited set and heaps. save() writes a
+// header followed by 64-byte aligned sections; load() maps the vectors and
+// the layer-0 links straight from the file and copies them to the heap only
+// when the index is modified.
+
+#define _DEFAULT_SOURCE
+#include "module.h"
+#include "value.h"
+#include "env.h"
+#include "gc.h"
+#include "sage_thread.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#if SAGE_HAS_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(__x86_64__) && defined(__SSE2__)
+#include <immintrin.h>
+#define VI_SSE 1
+#if defined(__GNUC__)
+#define VI_AVX2 1
+#endif
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define VI_NEON 1
+#endif
+
+#define VI_DEFAULT_M 16
+#define VI_DEFAULT_EF_CONSTRUCTION 200
+#define VI_DEFAULT_EF_SEARCH 64
+#define VI_MAX_LEVEL 16
+#define VI_FILE_MAGIC "SAGEVEC1"
+#define VI_FILE_VERSION 1
+#define VI_ALIGN 64
+
+typedef enum { VI_L2, VI_DOT, VI_COSINE } ViMetric;
+
+static const char* vi_metric_names[] = {"l2", "dot", "cosine"};
+
+typedef struct {
+    float dist;             // lower is closer
+    int id;
+} ViCand;
+
+typedef struct {
+    ViCand* items;          // binary min-heap on dist
+    int count;
+    int cap;
+} ViHeap;
+
+// Per-search working memory; one per thread
+typedef struct {
+    uint32_t* visited;      // visited[id] == epoch when seen by this search
+    int visited_cap;
+    uint32_t epoch;
+    ViHeap cand;            // frontier, closest first
+    ViHeap found;           // best ef so far, keyed by -dist so the furthest is on top
+    ViCand* pick;           // sorted candidates for neighbour selection
+    int pick_cap;
+    float* query;           // normalized copy of a cosine query
+} ViScratch;
+
+typedef struct {
+    int dim;
+    ViMetric metric;
+    int hnsw;
+    int m;                  // neighbours per node on layers >= 1
+    int m0;                 // neighbours per node on layer 0
+    int ef_construction;
+    int ef_search;
+    double level_mult;      // 1 / ln(M)
+    uint64_t rng;
+
+    float* data;            // count rows of dim floats
+    int count;
+    int cap;
+
+    int* links0;            // per node: neighbour count, then m0 ids
+    int* levels;            // top layer of each node
+    int** upper;            // per node: layers 1..level of (count, m ids); NULL on layer 0 only
+    int entry;              // entry point, -1 when empty
+    int max_level;
+
+    void* map;              // file mapping behind data and links0 after load()
+    size_t map_len;
+
+    ViScratch scratch;      // for add() and single queries
+    sage_mutex_t lock;      // guards scratch
+} VecIndex;
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t dim;
+    uint32_t metric;
+    uint32_t hnsw;
+    uint32_t count;
+    uint32_t m;
+    uint32_t ef_construction;
+    uint32_t ef_search;
+    int32_t entry;
+    int32_t max_level;
+    uint64_t data_offset;   // count * dim f32
+    uint64_t links_offset;  // count * (1 + 2M) int32
+    uint64_t levels_offset; // count int32
+    uint64_t upper_offset;  // upper layers of each node with level > 0, in id order
+    uint64_t upper_ints;
+    uint64_t file_size;
+} ViFileHeader;
+
+// ============================================================================
+// Distance kernels
+// ============================================================================
+
+typedef float (*ViKernel)(const float* a, const float* b, int n);
+
+static float vi_dot_scalar(const float* a, const float* b, int n) {
+    float s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        s0 += a[i] * b[i];
+        s1 += a[i + 1] * b[i + 1];
+        s2 += a[i + 2] * b[i + 2];
+        s3 += a[i + 3] * b[i + 3];
+    }
+    for (; i < n; i++) s0 += a[i] * b[i];
+    return (s0 + s1) + (s2 + s3);
+}
+
+static float vi_l2_scalar(const float* a, const float* b, int n) {
+    float s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        float d0 = a[i] - b[i], d1 = a[i + 1] - b[i + 1];
+        float d2 = a[i + 2] - b[i + 2], d3 = a[i + 3] - b[i + 3];
+        s0 += d0 * d0;
+        s1 += d1 * d1;
+        s2 += d2 * d2;
+        s3 += d3 * d3;
+    }
+    for (; i < n; i++) {
+        float d = a[i] - b[i];
+        s0 += d * d;
+    }
+    return (s0 + s1) + (s2 + s3);
+}
+
+#ifdef VI_SSE
+static float vi_hsum_sse(__m128 v) {
+    __m128 hi = _mm_movehl_ps(v, v);
+    v = _mm_add_ps(v, hi);
+    v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 1));
+    return _mm_cvtss_f32(v);
+}
+
+static float vi_dot_sse(const float* a, const float* b, int n) {
+    __m128 s0 = _mm_setzero_ps(), s1 = _mm_setzero_ps();
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        s0 = _mm_add_ps(s0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        s1 = _mm_add_ps(s1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+    }
+    float s = vi_hsum_sse(_mm_add_ps(s0, s1));
+    for (; i < n; i++) s += a[i] * b[i];
+    return s;
+}
+
+static float vi_l2_sse(const float* a, const float* b, int n) {
+    __m128 s0 = _mm_setzero_ps(), s1 = _mm_setzero_ps();
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128 d0 = _mm_sub_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i));
+        __m128 d1 = _mm_sub_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4));
+        s0 = _mm_add_ps(s0, _mm_mul_ps(d0, d0));
+        s1 = _mm_add_ps(s1, _mm_mul_ps(d1, d1));
+    }
+    float s = vi_hsum_sse(_mm_add_ps(s0, s1));
+    for (; i < n; i++) {
+        float d = a[i] - b[i];
+        s += d * d;
+    }
+    return s;
+}
+#endif
+
+#ifdef VI_AVX2
+__attribute__((target("avx2,fma")))
+static float vi_hsum_avx2(__m256 v) {
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+    return _mm_cvtss_f32(s);
+}
+
+__attribute__((target("avx2,fma")))
+static float vi_dot_avx2(const float* a, const float* b, int n) {
+    __m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps();
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        s0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), s0);
+        s1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), s1);
+    }
+    float s = vi_hsum_avx2(_mm256_add_ps(s0, s1));
+    for (; i < n; i++) s += a[i] * b[i];
+    return s;
+}
+
+__attribute__((target("avx2,fma")))
+static float vi_l2_avx2(const float* a, const float* b, int n) {
+    __m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps();
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+        __m256 d1 = _mm256_sub_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8));
+        s0 = _mm256_fmadd_ps(d0, d0, s0);
+        s1 = _mm256_fmadd_ps(d1, d1, s1);
+    }
+    float s = vi_hsum_avx2(_mm256_add_ps(s0, s1));
+    for (; i < n; i++) {
+        float d = a[i] - b[i];
+        s += d * d;
+    }
+    return s;
+}
+#endif
+
+#ifdef VI_NEON
+static float vi_dot_neon(const float* a, const float* b, int n) {
+    float32x4_t s0 = vdupq_n_f32(0), s1 = vdupq_n_f32(0);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        s0 = vfmaq_f32(s0, vld1q_f32(a + i), vld1q_f32(b + i));
+        s1 = vfmaq_f32(s1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+    }
+    float s = vaddvq_f32(vaddq_f32(s0, s1));
+    for (; i < n; i++) s += a[i] * b[i];
+    return s;
+}
+
+static float vi_l2_neon(const float* a, const float* b, int n) {
+    float32x4_t s0 = vdupq_n_f32(0), s1 = vdupq_n_f32(0);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        float32x4_t d0 = vsubq_f32(vld1q_f32(a + i), vld1q_f32(b + i));
+        float32x4_t d1 = vsubq_f32(vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+        s0 = vfmaq_f32(s0, d0, d0);
+        s1 = vfmaq_f32(s1, d1, d1);
+    }
+    float s = vaddvq_f32(vaddq_f32(s0, s1));
+    for (; i < n; i++) {
+        float d = a[i] - b[i];
+        s += d * d;
+    }
+    return s;
+}
+#endif
+
+static ViKernel vi_dot = vi_dot_scalar;
+static ViKernel vi_l2 = vi_l2_scalar;
+static const char* vi_kernel_name = "scalar";
+
+// Pick the widest kernels this CPU runs; called before any index exists
+static void vi_init_kernels(void) {
+    static int done = 0;
+    if (done) return;
+    done = 1;
+#if defined(VI_AVX2)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        vi_dot = vi_dot_avx2;
+        vi_l2 = vi_l2_avx2;
+        vi_kernel_name = "avx2";
+        return;
+    }
+#endif
+#if defined(VI_SSE)
+    vi_dot = vi_dot_sse;
+    vi_l2 = vi_l2_sse;
+    vi_kernel_name = "sse";
+#elif defined(VI_NEON)
+    vi_dot = vi_dot_neon;
+    vi_l2 = vi_l2_neon;
+    vi_kernel_name = "neon";
+#endif
+}
+
+static inline const float* vi_row(const VecIndex* ix, int id) {
+    return ix->data + (size_t)id * (size_t)ix->dim;
+}
+
+static inline float vi_dist(const VecIndex* ix, const float* a, const float* b) {
+    return ix->metric == VI_L2 ? vi_l2(a, b, ix->dim) : -vi_dot(a, b, ix->dim);
+}
+
+// Distance as reported to Sage: similarity for dot/cosine, distance for l2
+static double vi_score(const VecIndex* ix, float dist) {
+    return ix->metric == VI_L2 ? sqrt(dist > 0 ? dist : 0) : -(double)dist;
+}
+
+static void vi_normalize(float* v, int n) {
+    float norm = sqrtf(vi_dot(v, v, n));
+    if (norm > 0) {
+        for (int i = 0; i < n; i++) v[i] /= norm;
+    }
+}
+
+// ============================================================================
+// Heaps and scratch
+// ============================================================================
+
+static void vi_heap_push(ViHeap* h, float dist, int id) {
+    if (h->count == h->cap) {
+        h->cap = h->cap ? h->cap * 2 : 64;
+        h->items = SAGE_REALLOC(h->items, sizeof(ViCand) * (size_t)h->cap);
+    }
+    int i = h->count++;
+    while (i > 0) {
+        int p = (i - 1) / 2;
+        if (h->items[p].dist <= dist) break;
+        h->items[i] = h->items[p];
+        i = p;
+    }
+    h->items[i].dist = dist;
+    h->items[i].id = id;
+}
+
+static ViCand vi_heap_pop(ViHeap* h) {
+    ViCand top = h->items[0];
+    ViCand last = h->items[--h->count];
+    int n = h->count, i = 0;
+    for (;;) {
+        int c = 2 * i + 1;
+        if (c >= n) break;
+        if (c + 1 < n && h->items[c + 1].dist < h->items[c].dist) c++;
+        if (last.dist <= h->items[c].dist) break;
+        h->items[i] = h->items[c];
+        i = c;
+    }
+    if (n > 0) h->items[i] = last;
+    return top;
+}
+
+static void vi_scratch_free(ViScratch* s) {
+    free(s->visited);
+    free(s->cand.items);
+    free(s->found.items);
+    free(s->pick);
+    free(s->query);
+    memset(s, 0, sizeof(*s));
+}
+
+// Start a new search over n nodes: fresh visited epoch, empty heaps
+static void vi_scratch_begin(ViScratch* s, int n) {
+    if (s->visited_cap < n) {
+        int cap = s->visited_cap ? s->visited_cap : 1024;
+        while (cap < n) cap *= 2;
+        free(s->visited);
+        s->visited = SAGE_ALLOC(sizeof(uint32_t) * (size_t)cap);
+        s->visited_cap = cap;
+        s->epoch = 0;
+    }
+    if (++s->epoch == 0) {
+        memset(s->visited, 0, sizeof(uint32_t) * (size_t)s->visited_cap);
+        s->epoch = 1;
+    }
+    s->cand.count = 0;
+    s->found.count = 0;
+}
+
+static void vi_scratch_reserve_pick(ViScratch* s, int n) {
+    if (s->pick_cap < n) {
+        s->pick_cap = n;
+        s->pick = SAGE_REALLOC(s->pick, sizeof(ViCand) * (size_t)n);
+    }
+}
+
+static int vi_cand_cmp(const void* a, const void* b) {
+    const ViCand* x = a;
+    const ViCand* y = b;
+    if (x->dist != y->dist) return x->dist < y->dist ? -1 : 1;
+    return (x->id > y->id) - (x->id < y->id);
+}
+
+// Drain s->found into s->pick, closest first; returns the count
+static int vi_drain_found(ViScratch* s) {
+    int n = s->found.count;
+    vi_scratch_reserve_pick(s, n);
+    for (int i = n - 1; i >= 0; i--) {
+        ViCand c = vi_heap_pop(&s->found);
+        c.dist = -c.dist;
+        s->pick[i] = c;
+    }
+    return n;
+}
+
+// ============================================================================
+// HNSW graph
+// ============================================================================
+
+static inline int* vi_links(const VecIndex* ix, int id, int level) {
+    if (level == 0) return ix->links0 + (size_t)id * (size_t)(1 + ix->m0);
+    return ix->upper[id] + (size_t)(level - 1) * (size_t)(1 + ix->m);
+}
+
+static int vi_random_level(VecIndex* ix) {
+    // xorshift64*: deterministic per index so builds are reproducible
+    ix->rng ^= ix->rng >> 12;
+    ix->rng ^= ix->rng << 25;
+    ix->rng ^= ix->rng >> 27;
+    double u = (double)((ix->rng * 2685821657736338717ULL) >> 11) / 9007199254740992.0;
+    if (u <= 0) u = 1e-300;
+    int level = (int)(-log(u) * ix->level_mult);
+    return level > VI_MAX_LEVEL ? VI_MAX_LEVEL : level;
+}
+
+// Walk greedily towards q on one layer, starting at *ep
+static void vi_greedy(const VecIndex* ix, const float* q, int* ep, float* ep_dist, int level) {
+    int changed = 1;
+    while (changed) {
+        changed = 0;
+        int* links = vi_links(ix, *ep, level);
+        for (int i = 1; i <= links[0]; i++) {
+            float d = vi_dist(ix, q, vi_row(ix, links[i]));
+            if (d < *ep_dist) {
+                *ep_dist = d;
+                *ep = links[i];
+                changed = 1;
+            }
+        }
+    }
+}
+
+static void vi_seed(ViScratch* s, int id, float dist) {
+    s->visited[id] = s->epoch;
+    vi_heap_push(&s->cand, dist, id);
+    vi_heap_push(&s->found, -dist, id);
+}
+
+// Best-first search of one layer from the seeded entries; s->found ends
+// up holding the ef closest nodes reached
+static void vi_search_layer(const VecIndex* ix, ViScratch* s, const float* q, int ef, int level) {
+    while (s->cand.count > 0) {
+        ViCand c = vi_heap_pop(&s->cand);
+        if (s->found.count >= ef && c.dist > -s->found.items[0].dist) break;
+        int* links = vi_links(ix, c.id, level);
+        int n = links[0];
+        for (int i = 1; i <= n; i++) {
+            int e = links[i];
+            if (s->visited[e] == s->epoch) continue;
+            s->visited[e] = s->epoch;
+            float d = vi_dist(ix, q, vi_row(ix, e));
+            if (s->found.count < ef || d < -s->found.items[0].dist) {
+                vi_heap_push(&s->cand, d, e);
+                vi_heap_push(&s->found, -d, e);
+                if (s->found.count > ef) vi_heap_pop(&s->found);
+            }
+        }
+    }
+}
+
+// Keep candidates (sorted closest first) that are closer to the base than
+// to any neighbour already kept; returns how many stay at the front
+static int vi_select(const VecIndex* ix, ViCand* cands, int n, int max) {
+    int kept = 0;
+    for (int i = 0; i < n && kept < max; i++) {
+        const float* row = vi_row(ix, cands[i].id);
+        int good = 1;
+        for (int j = 0; j < kept; j++) {
+            if (vi_dist(ix, row, vi_row(ix, cands[j].id)) < cands[i].dist) {
+                good = 0;
+                break;
+            }
+        }
+        if (good) cands[kept++] = cands[i];
+    }
+    return kept;
+}
+
+// Add a back link from node to id, pruning node's list when it is full
+static void vi_link_back(VecIndex* ix, ViScratch* s, int node, int id, int level) {
+    int cap = level == 0 ? ix->m0 : ix->m;
+    int* links = vi_links(ix, node, level);
+    if (links[0] < cap) {
+        links[++links[0]] = id;
+        return;
+    }
+    // Reuse the tail of pick: the caller's candidates sit at the front
+    ViCand* tmp = s->pick + s->pick_cap - (cap + 1);
+    const float* base = vi_row(ix, node);
+    for (int i = 0; i < cap; i++) {
+        tmp[i].id = links[i + 1];
+        tmp[i].dist = vi_dist(ix, base, vi_row(ix, links[i + 1]));
+    }
+    tmp[cap].id = id;
+    tmp[cap].dist = vi_dist(ix, base, vi_row(ix, id));
+    qsort(tmp, (size_t)cap + 1, sizeof(ViCand), vi_cand_cmp);
+    int kept = vi_select(ix, tmp, cap + 1, cap);
+    links[0] = kept;
+    for (int i = 0; i < kept; i++) links[i + 1] = tmp[i].id;
+}
+
+static void vi_insert(VecIndex* ix, int id) {
+    ViScratch* s = &ix->scratch;
+    int level = vi_random_level(ix);
+    ix->levels[id] = level;
+    vi_links(ix, id, 0)[0] = 0;
+    ix->upper[id] = NULL;
+    if (level > 0) ix->upper[id] = SAGE_ALLOC(sizeof(int) * (size_t)level * (size_t)(1 + ix->m));
+
+    if (ix->entry < 0) {
+        ix->entry = id;
+        ix->max_level = level;
+        return;
+    }
+
+    const float* q = vi_row(ix, id);
+    int ep = ix->entry;
+    float ep_dist = vi_dist(ix, q, vi_row(ix, ep));
+    for (int l = ix->max_level; l > level; l--) vi_greedy(ix, q, &ep, &ep_dist, l);
+
+    vi_scratch_begin(s, ix->count);
+    vi_seed(s, ep, ep_dist);
+    for (int l = level < ix->max_level ? level : ix->max_level; l >= 0; l--) {
+        vi_search_layer(ix, s, q, ix->ef_construction, l);
+        vi_scratch_reserve_pick(s, s->found.count + ix->m0 + 1);
+        int n = vi_drain_found(s);
+
+        // The whole result set seeds the next layer down
+        vi_scratch_begin(s, ix->count);
+        for (int i = 0; i < n; i++) vi_seed(s, s->pick[i].id, s->pick[i].dist);
+
+        int kept = vi_select(ix, s->pick, n, ix->m);
+        int* links = vi_links(ix, id, l);
+        links[0] = kept;
+        for (int i = 0; i < kept; i++) links[i + 1] = s->pick[i].id;
+        for (int i = 0; i < kept; i++) vi_link_back(ix, s, links[i + 1], id, l);
+    }
+
+    if (level > ix->max_level) {
+        ix->max_level = level;
+        ix->entry = id;
+    }
+}
+
+// ============================================================================
+// Index
+// ============================================================================
+
+static VecIndex* vi_new(int dim, ViMetric metric, int hnsw, int m, int ef_construction, int ef_search) {
+    vi_init_kernels();
+    VecIndex* ix = SAGE_ALLOC(sizeof(VecIndex));
+    ix->dim = dim;
+    ix->metric = metric;
+    ix->hnsw = hnsw;
+    ix->m = m < 2 ? 2 : m;
+    ix->m0 = ix->m * 2;
+    ix->ef_construction = ef_construction < ix->m ? ix->m : ef_construction;
+    ix->ef_search = ef_search < 1 ? 1 : ef_search;
+    ix->level_mult = 1.0 / log((double)ix->m);
+    ix->rng = 0x9E3779B97F4A7C15ULL;
+    ix->entry = -1;
+    sage_mutex_init(&ix->lock);
+    return ix;
+}
+
+static void vi_unmap(VecIndex* ix) {
+#if SAGE_HAS_MMAP
+    if (ix->map) munmap(ix->map, ix->map_len);
+#endif
+    ix->map = NULL;
+    ix->map_len = 0;
+}
+
+// Move a loaded index off its file mapping so it can grow
+static void vi_materialize(VecIndex* ix) {
+    if (!ix->map) return;
+    int cap = ix->count > 16 ? ix->count : 16;
+    float* data = SAGE_ALLOC(sizeof(float) * (size_t)cap * (size_t)ix->dim);
+    memcpy(data, ix->data, sizeof(float) * (size_t)ix->count * (size_t)ix->dim);
+    int* links0 = NULL;
+    if (ix->hnsw) {
+        links0 = SAGE_ALLOC(sizeof(int) * (size_t)cap * (size_t)(1 + ix->m0));
+        memcpy(links0, ix->links0, sizeof(int) * (size_t)ix->count * (size_t)(1 + ix->m0));
+    }
+    vi_unmap(ix);
+    ix->data = data;
+    ix->links0 = links0;
+    ix->cap = cap;
+}
+
+static void vi_reserve(VecIndex* ix, int n) {
+    vi_materialize(ix);
+    if (n <= ix->cap) return;
+    int cap = ix->cap ? ix->cap : 16;
+    while (cap < n) cap *= 2;
+    ix->data = SAGE_REALLOC(ix->data, sizeof(float) * (size_t)cap * (size_t)ix->dim);
+    if (ix->hnsw) {
+        ix->links0 = SAGE_REALLOC(ix->links0, sizeof(int) * (size_t)cap * (size_t)(1 + ix->m0));
+        ix->levels = SAGE_REALLOC(ix->levels, sizeof(int) * (size_t)cap);
+        ix->upper = SAGE_REALLOC(ix->upper, sizeof(int*) * (size_t)cap);
+    }
+    ix->cap = cap;
+}
+
+// Append n rows; returns the id of the first
+static int vi_add(VecIndex* ix, const float* rows, int n) {
+    int first = ix->count;
+    vi_reserve(ix, ix->count + n);
+    for (int r = 0; r < n; r++) {
+        int id = ix->count;
+        float* row = ix->data + (size_t)id * (size_t)ix->dim;
+        memcpy(row, rows + (size_t)r * (size_t)ix->dim, sizeof(float) * (size_t)ix->dim);
+        if (ix->metric == VI_COSINE) vi_normalize(row, ix->dim);
+        ix->count++;
+        if (ix->hnsw) vi_insert(ix, id);
+    }
+    return first;
+}
+
+// k nearest rows to q, closest first; returns how many were found
+static int vi_search(const VecIndex* ix, ViScratch* s, const float* query, int k, int ef, ViCand* out) {
+    if (k <= 0 || ix->count == 0) return 0;
+    const float* q = query;
+    if (ix->metric == VI_COSINE) {
+        if (!s->query) s->query = SAGE_ALLOC(sizeof(float) * (size_t)ix->dim);
+        memcpy(s->query, query, sizeof(float) * (size_t)ix->dim);
+        vi_normalize(s->query, ix->dim);
+        q = s->query;
+    }
+
+    if (!ix->hnsw) {
+        s->found.count = 0;
+        for (int id = 0; id < ix->count; id++) {
+            float d = vi_dist(ix, q, vi_row(ix, id));
+            if (s->found.count < k) {
+                vi_heap_push(&s->found, -d, id);
+            } else if (d < -s->found.items[0].dist) {
+                vi_heap_pop(&s->found);
+                vi_heap_push(&s->found, -d, id);
+            }
+        }
+    } else {
+        if (ef < k) ef = k;
+        int ep = ix->entry;
+        float ep_dist = vi_dist(ix, q, vi_row(ix, ep));
+        for (int l = ix->max_level; l > 0; l--) vi_greedy(ix, q, &ep, &ep_dist, l);
+        vi_scratch_begin(s, ix->count);
+        vi_seed(s, ep, ep_dist);
+        vi_search_layer(ix, s, q, ef, 0);
+        while (s->found.count > k) vi_heap_pop(&s->found);
+    }
+
+    int n = vi_drain_found(s);
+    memcpy(out, s->pick, sizeof(ViCand) * (size_t)n);
+    return n;
+}
+
+typedef struct {
+    const VecIndex* ix;
+    const float* queries;
+    int first, last;        // query range [first, last)
+    int k, ef;
+    ViCand* out;            // k slots per query
+    int* counts;
+} ViBatch;
+
+static void* vi_batch_worker(void* arg) {
+    ViBatch* b = arg;
+    ViScratch s;
+    memset(&s, 0, sizeof(s));
+    for (int i = b->first; i < b->last; i++) {
+        b->counts[i] = vi_search(b->ix, &s, b->queries + (size_t)i * (size_t)b->ix->dim,
+                                 b->k, b->ef, b->out + (size_t)i * (size_t)b->k);
+    }
+    vi_scratch_free(&s);
+    return NULL;
+}
+
+// Run nq queries split over up to threads workers
+static void vi_search_batch(const VecIndex* ix, const float* queries, int nq, int k, int ef,
+                            int threads, ViCand* out, int* counts) {
+    if (threads > nq) threads = nq;
+    if (threads < 1) threads = 1;
+    ViBatch* jobs = SAGE_ALLOC(sizeof(ViBatch) * (size_t)threads);
+    sage_thread_t* tids = SAGE_ALLOC(sizeof(sage_thread_t) * (size_t)threads);
+    int* started = SAGE_ALLOC(sizeof(int) * (size_t)threads);
+    for (int t = 0; t < threads; t++) {
+        jobs[t] = (ViBatch){ix, queries, (int)((long long)nq * t / threads),
+                            (int)((long long)nq * (t + 1) / threads), k, ef, out, counts};
+        // The calling thread takes the last share itself
+        if (t < threads - 1) started[t] = sage_thread_create(&tids[t], vi_batch_worker, &jobs[t]) == 0;
+    }
+    vi_batch_worker(&jobs[threads - 1]);
+    for (int t = 0; t < threads - 1; t++) {
+        if (started[t]) sage_thread_join(tids[t], NULL);
+        else vi_batch_worker(&jobs[t]);
+    }
+    free(jobs);
+    free(tids);
+    free(started);
+}
+
+static void vi_free(void* ptr) {
+    VecIndex* ix = ptr;
+    if (ix->map) {
+        vi_unmap(ix);
+    } else {
+        free(ix->data);
+        free(ix->links0);
+    }
+    if (ix->upper) {
+        for (int i = 0; i < ix->count; i++) free(ix->upper[i]);
+    }
+    free(ix->upper);
+    free(ix->levels);
+    vi_scratch_free(&ix->scratch);
+    sage_mutex_destroy(&ix->lock);
+    free(ix);
+}
+
+// ============================================================================
+// Save / load
+// ============================================================================
+
+static uint64_t vi_align(uint64_t off) {
+    return (off + VI_ALIGN - 1) & ~(uint64_t)(VI_ALIGN - 1);
+}
+
+static int vi_write_at(FILE* f, uint64_t* pos, uint64_t off, const void* data, size_t size) {
+    static const char zeros[VI_ALIGN] = {0};
+    while (*pos < off) {
+        size_t pad = off - *pos > VI_ALIGN ? VI_ALIGN : (size_t)(off - *pos);
+        if (fwrite(zeros, 1, pad, f) != pad) return 0;
+        *pos += pad;
+    }
+    if (size > 0 && fwrite(data, 1, size, f) != size) return 0;
+    *pos += size;
+    return 1;
+}
+
+static int vi_save(const VecIndex* ix, const char* path) {
+    ViFileHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, VI_FILE_MAGIC, 8);
+    h.version = VI_FILE_VERSION;
+    h.dim = (uint32_t)ix->dim;
+    h.metric = (uint32_t)ix->metric;
+    h.hnsw = (uint32_t)ix->hnsw;
+    h.count = (uint32_t)ix->count;
+    h.m = (uint32_t)ix->m;
+    h.ef_construction = (uint32_t)ix->ef_construction;
+    h.ef_search = (uint32_t)ix->ef_search;
+    h.entry = ix->entry;
+    h.max_level = ix->max_level;
+
+    uint64_t count = (uint64_t)ix->count;
+    h.data_offset = vi_align(sizeof(h));
+    uint64_t end = h.data_offset + count * (uint64_t)ix->dim * sizeof(float);
+    if (ix->hnsw) {
+        for (int i = 0; i < ix->count; i++) h.upper_ints += (uint64_t)ix->levels[i] * (uint64_t)(1 + ix->m);
+        h.links_offset = vi_align(end);
+        h.levels_offset = vi_align(h.links_offset + count * (uint64_t)(1 + ix->m0) * sizeof(int32_t));
+        h.upper_offset = vi_align(h.levels_offset + count * sizeof(int32_t));
+        end = h.upper_offset + h.upper_ints * sizeof(int32_t);
+    }
+    h.file_size = end;
+
+    FILE* f = fopen(path, "wb");
+    if (!f) return 0;
+    uint64_t pos = 0;
+    int ok = vi_write_at(f, &pos, 0, &h, sizeof(h)) &&
+             vi_write_at(f, &pos, h.data_offset, ix->data, (size_t)(count * (uint64_t)ix->dim * sizeof(float)));
+    if (ok && ix->hnsw) {
+        ok = vi_write_at(f, &pos, h.links_offset, ix->links0, (size_t)(count * (uint64_t)(1 + ix->m0) * sizeof(int32_t))) &&
+             vi_write_at(f, &pos, h.levels_offset, ix->levels, (size_t)count * sizeof(int32_t));
+        uint64_t at = h.upper_offset;
+        for (int i = 0; ok && i < ix->count; i++) {
+            if (ix->levels[i] == 0) continue;
+            size_t size = sizeof(int) * (size_t)ix->levels[i] * (size_t)(1 + ix->m);
+            ok = vi_write_at(f, &pos, at, ix->upper[i], size);
+            at += size;
+        }
+    }
+    ok = ok && vi_write_at(f, &pos, h.file_size, NULL, 0);
+    if (fclose(f) != 0) ok = 0;
+    return ok;
+}
+
+// Check a header against the file size before trusting its offsets
+static int vi_header_ok(const ViFileHeader* h, uint64_t size) {
+    if (memcmp(h->magic, VI_FILE_MAGIC, 8) != 0 || h->version != VI_FILE_VERSION) return 0;
+    if (h->dim == 0 || h->dim > (1u << 20) || h->metric > VI_COSINE || h->count > (uint32_t)INT32_MAX) return 0;
+    if (h->file_size > size || h->data_offset < sizeof(*h)) return 0;
+    uint64_t count = h->count;
+    if (h->data_offset + count * h->dim * sizeof(float) > h->file_size) return 0;
+    if (!h->hnsw) return 1;
+    if (h->m < 2 || h->m > 1024 || h->max_level < 0 || h->max_level > VI_MAX_LEVEL) return 0;
+    if (count > 0 ? (h->entry < 0 || (uint64_t)h->entry >= count) : h->entry != -1) return 0;
+    if (h->links_offset + count * (1 + 2 * (uint64_t)h->m) * sizeof(int32_t) > h->file_size) return 0;
+    if (h->levels_offset + count * sizeof(int32_t) > h->file_size) return 0;
+    return h->upper_offset + h->upper_ints * sizeof(int32_t) <= h->file_size;
+}
+
+// A neighbour on `layer` must itself reach that layer, or search would
+// read links it does not have
+static int vi_links_ok(const VecIndex* ix, const int* links, int cap, int layer) {
+    if (links[0] < 0 || links[0] > cap) return 0;
+    for (int i = 1; i <= links[0]; i++) {
+        if (links[i] < 0 || links[i] >= ix->count || ix->levels[links[i]] < layer) return 0;
+    }
+    return 1;
+}
+
+static VecIndex* vi_load(const char* path) {
+    unsigned char* base = NULL;
+    uint64_t size = 0;
+    int mapped = 0;
+#if SAGE_HAS_MMAP
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && (uint64_t)st.st_size >= sizeof(ViFileHeader)) {
+        size = (uint64_t)st.st_size;
+        void* map = mmap(NULL, (size_t)size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            base = map;
+            mapped = 1;
+        }
+    }
+    close(fd);
+#else
+    FILE* f = fopen(path, "rb");
+    if (!f) return NULL;
+    if (fseek(f, 0, SEEK_END) == 0) {
+        long len = ftell(f);
+        if (len >= (long)sizeof(ViFileHeader)) {
+            size = (uint64_t)len;
+            base = SAGE_ALLOC((size_t)size);
+            rewind(f);
+            if (fread(base, 1, (size_t)size, f) != (size_t)size) {
+                free(base);
+                base = NULL;
+            }
+        }
+    }
+    fclose(f);
+#endif
+    if (!base) return NULL;
+
+    ViFileHeader h;
+    memcpy(&h, base, sizeof(h));
+    if (!vi_header_ok(&h, size)) goto fail;
+
+    VecIndex* ix = vi_new((int)h.dim, (ViMetric)h.metric, (int)h.hnsw, (int)h.m,
+                          (int)h.ef_construction, (int)h.ef_search);
+    ix->count = (int)h.count;
+    ix->data = (float*)(base + h.data_offset);
+    if (ix->hnsw) {
+        ix->links0 = (int*)(base + h.links_offset);
+        ix->entry = h.entry;
+        ix->max_level = h.max_level;
+        size_t n = ix->count > 0 ? (size_t)ix->count : 1;
+        ix->levels = SAGE_ALLOC(sizeof(int) * n);
+        memcpy(ix->levels, base + h.levels_offset, sizeof(int) * (size_t)ix->count);
+        ix->upper = SAGE_ALLOC(sizeof(int*) * n);
+        const int32_t* up = (const int32_t*)(base + h.upper_offset);
+        uint64_t used = 0;
+        // Search starts at entry on max_level
+        int ok = ix->count == 0 || ix->levels[ix->entry] == h.max_level;
+        for (int i = 0; ok && i < ix->count; i++) {
+            int level = ix->levels[i];
+            if (level < 0 || level > h.max_level) { ok = 0; break; }
+            if (!vi_links_ok(ix, vi_links(ix, i, 0), ix->m0, 0)) { ok = 0; break; }
+            if (level == 0) continue;
+            uint64_t ints = (uint64_t)level * (uint64_t)(1 + ix->m);
+            if (used + ints > h.upper_ints) { ok = 0; break; }
+            ix->upper[i] = SAGE_ALLOC(sizeof(int) * (size_t)ints);
+            memcpy(ix->upper[i], up + used, sizeof(int) * (size_t)ints);
+            used += ints;
+            for (int l = 1; ok && l <= level; l++) ok = vi_links_ok(ix, vi_links(ix, i, l), ix->m, l);
+        }
+        if (!ok || used != h.upper_ints) {
+            ix->map = NULL;
+            ix->data = NULL;
+            ix->links0 = NULL;
+            vi_free(ix);
+            goto fail;
+        }
+    }
+
+    if (mapped) {
+        ix->map = base;
+        ix->map_len = (size_t)size;
+#ifdef MADV_RANDOM
+        // Graph search touches rows in no particular order
+        if (ix->hnsw) madvise(base, (size_t)size, MADV_RANDOM);
+#endif
+    } else {
+        // No mapping: copy the sections out of the read buffer
+        ix->map = base;
+        vi_materialize(ix);
+        free(base);
+    }
+    return ix;
+
+fail:
+#if SAGE_HAS_MMAP
+    if (mapped) munmap(base, (size_t)size);
+    else free(base);
+#else
+    free(base);
+#endif
+    return NULL;
+}
+
+// ============================================================================
+// Module functions
+// ============================================================================
+
+static VecIndex* vi_as_index(Value v) {
+    if (v.type != VAL_POINTER || v.as.pointer->finalize != vi_free) return NULL;
+    return (VecIndex*)v.as.pointer->ptr;
+}
+
+static VecIndex* vi_arg(int argCount, Value* args, const char* fn) {
+    VecIndex* ix = argCount >= 1 ? vi_as_index(args[0]) : NULL;
+    if (!ix) fprintf(stderr, "Runtime Error: _vecindex.%s expects an index from _vecindex.create or _vecindex.load.\n", fn);
+    return ix;
+}
+
+static Value vi_handle(VecIndex* ix) {
+    Value handle = val_pointer(ix, sizeof(VecIndex), 1);
+    handle.as.pointer->finalize = vi_free;
+    return handle;
+}
+
+static int vi_copy_row(const VecIndex* ix, Value v, float* dst) {
+    if (!IS_ARRAY(v) || AS_ARRAY(v)->count != ix->dim) return 0;
+    Value* elems = AS_ARRAY(v)->elements;
+    for (int i = 0; i < ix->dim; i++) {
+        if (!IS_NUMBER(elems[i])) return 0;
+        dst[i] = (float)AS_NUMBER(elems[i]);
+    }
+    return 1;
+}
+
+// Convert one vector, a list of vectors or f32 bytes into packed rows.
+// Returns the row count, or -1 (with *rows NULL) when v has the wrong shape
+static int vi_rows(const VecIndex* ix, Value v, float** rows) {
+    *rows = NULL;
+    if (IS_BYTES(v)) {
+        size_t row_bytes = sizeof(float) * (size_t)ix->dim;
+        size_t len = (size_t)AS_BYTES(v)->length;
+        if (len % row_bytes != 0) return -1;
+        int n = (int)(len / row_bytes);
+        *rows = SAGE_ALLOC(len ? len : 1);
+        memcpy(*rows, AS_BYTES(v)->data, len);
+        return n;
+    }
+    if (!IS_ARRAY(v)) return -1;
+    ArrayValue* arr = AS_ARRAY(v);
+    if (arr->count > 0 && IS_ARRAY(arr->elements[0])) {
+        *rows = SAGE_ALLOC(sizeof(float) * (size_t)arr->count * (size_t)ix->dim);
+        for (int r = 0; r < arr->count; r++) {
+            if (!vi_copy_row(ix, arr->elements[r], *rows + (size_t)r * (size_t)ix->dim)) {
+                free(*rows);
+                *rows = NULL;
+                return -1;
+            }
+        }
+        return arr->count;
+    }
+    *rows = SAGE_ALLOC(sizeof(float) * (size_t)ix->dim);
+    if (!vi_copy_row(ix, v, *rows)) {
+        free(*rows);
+        *rows = NULL;
+        return -1;
+    }
+    return 1;
+}
+
+static int vi_rows_arg(const VecIndex* ix, Value v, float** rows, const char* fn) {
+    int n = vi_rows(ix, v, rows);
+    if (n < 0) {
+        fprintf(stderr, "Runtime Error: _vecindex.%s expects vectors of %d numbers or f32 bytes.\n", fn, ix->dim);
+    }
+    return n;
+}
+
+static Value vi_hits(const VecIndex* ix, const ViCand* hits, int n) {
+    Value result = val_array();
+    for (int i = 0; i < n; i++) {
+        Value pair = val_array();
+        array_push(&pair, val_number(hits[i].id));
+        array_push(&pair, val_number(vi_score(ix, hits[i].dist)));
+        array_push(&result, pair);
+    }
+    return result;
+}
+
+static int vi_option(Value* opts, const char* key, int fallback) {
+    if (!opts || !dict_has(opts, key)) return fallback;
+    Value v = dict_get(opts, key);
+    return IS_NUMBER(v) ? (int)AS_NUMBER(v) : fallback;
+}
+
+// _vecindex.create(dim, [metric], [options]) -> empty index
+// metric is "cosine" (default), "dot" or "l2". options: kind ("flat" or
+// "hnsw"), M, ef_construction, ef_search
+static Value vi_create_native(int argCount, Value* args) {
+    if (argCount < 1 || !IS_NUMBER(args[0]) || AS_NUMBER(args[0]) < 1) {
+        fprintf(stderr, "Runtime Error: _vecindex.create expects a positive dimension.\n");
+        return val_nil();
+    }
+    ViMetric metric = VI_COSINE;
+    if (argCount >= 2 && IS_STRING(args[1])) {
+        const char* name = AS_STRING(args[1]);
+        if (strcmp(name, "l2") == 0) metric = VI_L2;
+        else if (strcmp(name, "dot") == 0) metric = VI_DOT;
+        else if (strcmp(name, "cosine") != 0) {
+            fprintf(stderr, "Runtime Error: _vecindex.create metric must be \"cosine\", \"dot\" or \"l2\".\n");
+            return val_nil();
+        }
+    }
+    Value* opts = argCount >= 3 && IS_DICT(args[2]) ? &args[2] : NULL;
+    int hnsw = 0;
+    if (opts && dict_has(opts, "kind")) {
+        Value kind = dict_get(opts, "kind");
+        hnsw = IS_STRING(kind) && strcmp(AS_STRING(kind), "hnsw") == 0;
+    }
+    VecIndex* ix = vi_new((int)AS_NUMBER(args[0]), metric, hnsw,
+                          vi_option(opts, "M", VI_DEFAULT_M),
+                          vi_option(opts, "ef_construction", VI_DEFAULT_EF_CONSTRUCTION),
+                          vi_option(opts, "ef_search", VI_DEFAULT_EF_SEARCH));
+    return vi_handle(ix);
+}
+
+// _vecindex.add(index, vectors) -> id of the first added vector (ids count from 0)
+// vectors is one vector, a list of vectors or bytes of packed f32 rows
+static Value vi_add_native(int argCount, Value* args) {
+    VecIndex* ix = vi_arg(argCount, args, "add");
+    if (!ix || argCount < 2) return val_nil();
+    float* rows;
+    int n = vi_rows_arg(ix, args[1], &rows, "add");
+    if (n < 0) return val_nil();
+    sage_mutex_lock(&ix->lock);
+    int first = vi_add(ix, rows, n);
+    sage_mutex_unlock(&ix->lock);
+    free(rows);
+    return val_number(first);
+}
+
+// _vecindex.search(index, query, k, [ef]) -> [[id, score], ...], best first
+// score is the similarity for cosine/dot and the distance for l2
+static Value vi_search_native(int argCount, Value* args) {
+    VecIndex* ix = vi_arg(argCount, args, "search");
+    if (!ix || argCount < 3 || !IS_NUMBER(args[2])) return val_nil();
+    float* query;
+    if (vi_rows_arg(ix, args[1], &query, "search") != 1) {
+        free(query);
+        return val_nil();
+    }
+    int k = (int)AS_NUMBER(args[2]);
+    if (k > ix->count) k = ix->count;
+    int ef = argCount >= 4 && IS_NUMBER(args[3]) ? (int)AS_NUMBER(args[3]) : ix->ef_search;
+
+    ViCand* hits = SAGE_ALLOC(sizeof(ViCand) * (size_t)(k > 0 ? k : 1));
+    int n;
+    if (sage_mutex_trylock(&ix->lock) == 0) {
+        n = vi_search(ix, &ix->scratch, query, k, ef, hits);
+        sage_mutex_unlock(&ix->lock);
+    } else {
+        ViScratch s;
+        memset(&s, 0, sizeof(s));
+        n = vi_search(ix, &s, query, k, ef, hits);
+        vi_scratch_free(&s);
+    }
+
+    gc_pin();
+    Value result = vi_hits(ix, hits, n);
+    gc_unpin();
+    free(hits);
+    free(query);
+    return result;
+}
+
+// _vecindex.search_batch(index, queries, k, [ef], [threads]) -> one result list per query
+// Queries are split across threads (default: one per CPU)
+static Value vi_search_batch_native(int argCount, Value* args) {
+    VecIndex* ix = vi_arg(argCount, args, "search_batch");
+    if (!ix || argCount < 3 || !IS_NUMBER(args[2])) return val_nil();
+    float* queries;
+    int nq = vi_rows_arg(ix, args[1], &queries, "search_batch");
+    if (nq < 0) return val_nil();
+    int k = (int)AS_NUMBER(args[2]);
+    if (k > ix->count) k = ix->count;
+    if (k < 0) k = 0;
+    int ef = argCount >= 4 && IS_NUMBER(args[3]) ? (int)AS_NUMBER(args[3]) : ix->ef_search;
+    int threads = argCount >= 5 && IS_NUMBER(args[4]) ? (int)AS_NUMBER(args[4]) : sage_cpu_count();
+
+    ViCand* hits = SAGE_ALLOC(sizeof(ViCand) * (size_t)(nq > 0 ? nq : 1) * (size_t)(k > 0 ? k : 1));
+    int* counts = SAGE_ALLOC(sizeof(int) * (size_t)(nq > 0 ? nq : 1));
+    if (nq > 0 && k > 0) vi_search_batch(ix, queries, nq, k, ef, threads, hits, counts);
+
+    gc_pin();
+    Value result = val_array();
+    for (int i = 0; i < nq; i++) array_push(&result, vi_hits(ix, hits + (size_t)i * (size_t)k, counts[i]));
+    gc_unpin();
+    free(hits);
+    free(counts);
+    free(queries);
+    return result;
+}
+
+// _vecindex.get(index, id) -> stored vector (unit length for cosine indexes)
+static Value vi_get_native(int argCount, Value* args) {
+    VecIndex* ix = vi_arg(argCount, args, "get");
+    if (!ix || argCount < 2 || !IS_NUMBER(args[1])) return val_nil();
+    int id = (int)AS_NUMBER(args[1]);
+    if (id < 0 || id >= ix->count) return val_nil();
+    const float* row = vi_row(ix, id);
+    gc_pin();
+    Value vec = val_array();
+    for (int i = 0; i < ix->dim; i++) array_push(&vec, val_number(row[i]));
+    gc_unpin();
+    return vec;
+}
+
+// _vecindex.set_ef(index, ef) -> nil; default candidate list size for HNSW searches
+static Value vi_set_ef_native(int argCount, Value* args) {
+    VecIndex* ix = vi_arg(argCount, args, "set_ef");
+    if (ix && argCount >= 2 && IS_NUMBER(args[1]) && AS_NUMBER(args[1]) >= 1) {
+        ix->ef_search = (int)AS_NUMBER(args[1]);
+    }
+    return val_nil();
+}
+
+// _vecindex.save(index, path) -> true on success
+static Value vi_save_native(int argCount, Value* args) {
+    VecIndex* ix = vi_arg(argCount, args, "save");
+    if (!ix || argCount < 2 || !IS_STRING(args[1])) return val_bool(0);
+    return val_bool(vi_save(ix, AS_STRING(args[1])));
+}
+
+// _vecindex.load(path) -> index backed by the file mapping, or nil
+static Value vi_load_native(int argCount, Value* args) {
+    if (argCount < 1 || !IS_STRING(args[0])) return val_nil();
+    VecIndex* ix = vi_load(AS_STRING(args[0]));
+    return ix ? vi_handle(ix) : val_nil();
+}
+
+// _vecindex.stats(index) -> {count, dim, metric, kind, M, ef_construction, ef_search, levels, mapped, kernel}
+static Value vi_stats_native(int argCount, Value* args) {
+    VecIndex* ix = vi_arg(argCount, args, "stats");
+    if (!ix) return val_nil();
+    gc_pin();
+    Value stats = val_dict();
+    dict_set(&stats, "count", val_number(ix->count));
+    dict_set(&stats, "dim", val_number(ix->dim));
+    dict_set(&stats, "metric", val_string(vi_metric_names[ix->metric]));
+    dict_set(&stats, "kind", val_string(ix->hnsw ? "hnsw" : "flat"));
+    dict_set(&stats, "M", val_number(ix->m));
+    dict_set(&stats, "ef_construction", val_number(ix->ef_construction));
+    dict_set(&stats, "ef_search", val_number(ix->ef_search));
+    dict_set(&stats, "levels", val_number(ix->hnsw && ix->entry >= 0 ? ix->max_level + 1 : 0));
+    dict_set(&stats, "mapped", val_bool(ix->map != NULL));
+    dict_set(&stats, "kernel", val_string(vi_kernel_name));
+    gc_unpin();
+    return stats;
+}
+
+Module* create_vecindex_module(ModuleCache* cache) {
+    Module* m = create_native_module(cache, "_vecindex");
+    Environment* e = m->env;
+
+    env_define_const(e, "create", 6, val_native(vi_create_native));
+    env_define_const(e, "add", 3, val_native(vi_add_native));
+    env_define_const(e, "search", 6, val_native(vi_search_native));
+    env_define_const(e, "search_batch", 12, val_native(vi_search_batch_native));
+    env_define_const(e, "get", 3, val_native(vi_get_native));
+    env_define_const(e, "set_ef", 6, val_native(vi_set_ef_native));
+    env_define_const(e, "save", 4, val_native(vi_save_native));
+    env_define_const(e, "load", 4, val_native(vi_load_native));
+    env_define_const(e, "stats", 5, val_native(vi_stats_native));
+
+    return m;
+}
@@ -16,6 +16,7 @@ typedef struct {
     int continue_target;
     int has_for_cleanup;  // for-loops need extra stack cleanup before break
     int for_pop_count;    // number of extra pops needed for for-loop break
+    int local_base;       // locals live when the loop started; deeper ones are popped on break/continue
 } LoopContext;
 
 typedef struct {
@@ -38,6 +39,7 @@ typedef struct {
     Local locals[MAX_LOCALS];
     int local_count;
     int scope_depth;
+    int quicken;          // may emit quickened ops (chunks run in-process only)
 } BytecodeCompiler;
 
 static void set_error(BytecodeCompiler* compiler, const char* message) {
@@ -88,9 +90,11 @@ void bytecode_chunk_init(BytecodeChunk* chunk) {
 }
 
 void bytecode_chunk_free(BytecodeChunk* chunk) {
-    free(chunk->code);
-    free(chunk->lines);
-    free(chunk->columns);
+    if (!chunk->code_borrowed) {
+        free(chunk->code);
+        free(chunk->lines);
+        free(chunk->columns);
+    }
     free(chunk->constants);
     free(chunk->ast_stmts);
     memset(chunk, 0, sizeof(*chunk));
@@ -394,6 +398,29 @@ static int compile_short_circuit(BytecodeCompiler* compiler, BinaryExpr* binary)
     return patch_jump(compiler, end_jump, current_offset(compiler));
 }
 
+// Quickened form of a binary op whose operands typecheck proved numbers
+static BytecodeOp binary_op(BytecodeCompiler* compiler, BinaryExpr* binary,
+                            BytecodeOp generic, BytecodeOp quickened) {
+    if (compiler->quicken && binary->quickened && binary->left_is_num && binary->right_is_num) {
+        return quickened;
+    }
+    return generic;
+}
+
+BytecodeOp bytecode_generic_op(BytecodeOp op) {
+    switch (op) {
+        case BC_OP_ADD_NUM: return BC_OP_ADD;
+        case BC_OP_SUB_NUM: return BC_OP_SUB;
+        case BC_OP_MUL_NUM: return BC_OP_MUL;
+        case BC_OP_LESS_NUM: return BC_OP_LESS;
+        case BC_OP_LESS_EQUAL_NUM: return BC_OP_LESS_EQUAL;
+        case BC_OP_GREATER_NUM: return BC_OP_GREATER;
+        case BC_OP_GREATER_EQUAL_NUM: return BC_OP_GREATER_EQUAL;
+        case BC_OP_GET_INDEX_ARR_NUM: return BC_OP_GET_INDEX;
+        default: return op;
+    }
+}
+
 static int compile_expr(BytecodeCompiler* compiler, Expr* expr) {
     if (expr == NULL) {
         return emit_op(compiler, BC_OP_NIL, 0, 0);
@@ -441,7 +468,8 @@ static int compile_expr(BytecodeCompiler* compiler, Expr* expr) {
         case EXPR_INDEX:
             return compile_expr(compiler, expr->as.index.array) &&
                    compile_expr(compiler, expr->as.index.index) &&
-                   emit_op(compiler, BC_OP_GET_INDEX, 0, 0);
+                   emit_op(compiler, compiler->quicken && expr->as.index.quickened
+                                         ? BC_OP_GET_INDEX_ARR_NUM : BC_OP_GET_INDEX, 0, 0);
         case EXPR_INDEX_SET:
             return compile_expr(compiler, expr->as.index_set.array) &&
                    compile_expr(compiler, expr->as.index_set.index) &&
@@ -528,17 +556,17 @@ static int compile_expr(BytecodeCompiler* compiler, Expr* expr) {
             if (!compile_expr(compiler, binary->right)) return 0;
 
             switch (binary->op.type) {
-                case TOKEN_PLUS: return emit_op(compiler, BC_OP_ADD, binary->op.line, binary->op.column);
-                case TOKEN_MINUS: return emit_op(compiler, BC_OP_SUB, binary->op.line, binary->op.column);
-                case TOKEN_STAR: return emit_op(compiler, BC_OP_MUL, binary->op.line, binary->op.column);
+                case TOKEN_PLUS: return emit_op(compiler, binary_op(compiler, binary, BC_OP_ADD, BC_OP_ADD_NUM), binary->op.line, binary->op.column);
+                case TOKEN_MINUS: return emit_op(compiler, binary_op(compiler, binary, BC_OP_SUB, BC_OP_SUB_NUM), binary->op.line, binary->op.column);
+                case TOKEN_STAR: return emit_op(compiler, binary_op(compiler, binary, BC_OP_MUL, BC_OP_MUL_NUM), binary->op.line, binary->op.column);
                 case TOKEN_SLASH: return emit_op(compiler, BC_OP_DIV, binary->op.line, binary->op.column);
                 case TOKEN_PERCENT: return emit_op(compiler, BC_OP_MOD, binary->op.line, binary->op.column);
                 case TOKEN_EQ: return emit_op(compiler, BC_OP_EQUAL, binary->op.line, binary->op.column);
                 case TOKEN_NEQ: return emit_op(compiler, BC_OP_NOT_EQUAL, binary->op.line, binary->op.column);
-                case TOKEN_GT: return emit_op(compiler, BC_OP_GREATER, binary->op.line, binary->op.column);
-                case TOKEN_GTE: return emit_op(compiler, BC_OP_GREATER_EQUAL, binary->op.line, binary->op.column);
-                case TOKEN_LT: return emit_op(compiler, BC_OP_LESS, binary->op.line, binary->op.column);
-                case TOKEN_LTE: return emit_op(compiler, BC_OP_LESS_EQUAL, binary->op.line, binary->op.column);
+                case TOKEN_GT: return emit_op(compiler, binary_op(compiler, binary, BC_OP_GREATER, BC_OP_GREATER_NUM), binary->op.line, binary->op.column);
+                case TOKEN_GTE: return emit_op(compiler, binary_op(compiler, binary, BC_OP_GREATER_EQUAL, BC_OP_GREATER_EQUAL_NUM), binary->op.line, binary->op.column);
+                case TOKEN_LT: return emit_op(compiler, binary_op(compiler, binary, BC_OP_LESS, BC_OP_LESS_NUM), binary->op.line, binary->op.column);
+                case TOKEN_LTE: return emit_op(compiler, binary_op(compiler, binary, BC_OP_LESS_EQUAL, BC_OP_LESS_EQUAL_NUM), binary->op.line, binary->op.column);
                 case TOKEN_AMP: return emit_op(compiler, BC_OP_BIT_AND, binary->op.line, binary->op.column);
                 case TOKEN_PIPE: return emit_op(compiler, BC_OP_BIT_OR, binary->op.line, binary->op.column);
                 case TOKEN_CARET: return emit_op(compiler, BC_OP_BIT_XOR, binary->op.line, binary->op.column);
@@ -573,6 +601,7 @@ static int push_loop(BytecodeCompiler* compiler, int continue_target, int is_for
     loop->continue_target = continue_target;
     loop->has_for_cleanup = is_for;
     loop->for_pop_count = for_pop_count;
+    loop->local_base = compiler->local_count;
     return 1;
 }
 
@@ -616,6 +645,72 @@ static int stmt_has_pragma(Stmt* stmt, const char* name) {
     return 0;
 }
 
+// `for v in range(...)` marked counted by the loop pass. Counter, end and
+// step stay on the stack as hidden locals, so the indices of locals declared
+// in the body still match their slots; inside a function the loop variable
+// gets a slot of its own below them.
+static int compile_counted_for(BytecodeCompiler* compiler, Stmt* stmt, int want_result) {
+    Token loop_var = stmt->as.for_stmt.variable;
+    Expr* range = stmt->as.for_stmt.iterable;
+    int argc = range->as.call.arg_count;
+    int line = loop_var.line;
+    int column = loop_var.column;
+    int local_var = compiler->scope_depth > 0;
+
+    if (local_var && !emit_op(compiler, BC_OP_NIL, line, column)) return 0;
+    if (argc == 1 && !emit_constant(compiler, val_number(0), line, column)) return 0;
+    for (int i = 0; i < argc; i++) {
+        if (!compile_expr(compiler, range->as.call.args[i])) return 0;
+    }
+    if (argc < 3 && !emit_constant(compiler, val_number(1), line, column)) return 0;
+    if (!emit_op(compiler, BC_OP_RANGE_PREP, line, column)) return 0;
+
+    int base = compiler->local_count;
+    Token hidden = loop_var;
+    hidden.start = "(range)";
+    hidden.length = 7;
+    if (local_var) add_local(compiler, loop_var);
+    for (int i = 0; i < 3; i++) add_local(compiler, hidden);
+    int state_slots = compiler->local_count - base;
+    if (!emit_op(compiler, BC_OP_PUSH_ENV, line, column)) return 0;
+
+    int loop_start = current_offset(compiler);
+    int exit_jump = emit_jump(compiler, BC_OP_RANGE_NEXT, line, column);
+    if (exit_jump < 0) return 0;
+    if (local_var) {
+        if (!emit_op(compiler, BC_OP_SET_LOCAL, line, column) ||
+            !emit_u16(compiler, (uint16_t)base, line, column) ||
+            !emit_op(compiler, BC_OP_POP, line, column)) {
+            return 0;
+        }
+    } else if (!emit_name_op(compiler, BC_OP_DEFINE_GLOBAL, loop_var)) {
+        return 0;
+    }
+
+    // Nothing is left on the stack between iterations: continue jumps straight back
+    if (!push_loop(compiler, loop_start, 1, state_slots)) return 0;
+    if (!compile_stmt(compiler, stmt->as.for_stmt.body, 0)) {
+        compiler->loop_depth--;
+        return 0;
+    }
+    if (!emit_op(compiler, BC_OP_JUMP, line, column) ||
+        !emit_u16(compiler, (uint16_t)loop_start, line, column)) {
+        compiler->loop_depth--;
+        return 0;
+    }
+
+    if (!patch_jump(compiler, exit_jump, current_offset(compiler))) return 0;
+    for (int i = 0; i < state_slots; i++) {
+        if (!emit_op(compiler, BC_OP_POP, line, column)) return 0;
+    }
+    if (!emit_op(compiler, BC_OP_POP_ENV, line, column)) return 0;
+    if (!pop_loop_and_patch_breaks(compiler)) return 0;
+    compiler->local_count = base;
+
+    if (want_result) return emit_op(compiler, BC_OP_NIL, line, column);
+    return 1;
+}
+
 static int compile_stmt(BytecodeCompiler* compiler, Stmt* stmt, int want_result) {
     if (stmt == NULL) {
         if (want_result) {
@@ -723,6 +818,7 @@ static int compile_stmt(BytecodeCompiler* compiler, Stmt* stmt, int want_result)
             return 1;
         }
         case STMT_FOR: {
+            if (stmt->as.for_stmt.counted) return compile_counted_for(compiler, stmt, want_result);
             Token loop_var = stmt->as.for_stmt.variable;
 
             if (!compile_expr(compiler, stmt->as.for_stmt.iterable)) break;
@@ -734,7 +830,7 @@ static int compile_stmt(BytecodeCompiler* compiler, Stmt* stmt, int want_result)
             if (!emit_dup(compiler, 0, loop_var.line, loop_var.column) ||
                 !emit_dup(compiler, 2, loop_var.line, loop_var.column) ||
                 !emit_op(compiler, BC_OP_ARRAY_LEN, loop_var.line, loop_var.column) ||
-                !emit_op(compiler, BC_OP_LESS, loop_var.line, loop_var.column)) {
+                !emit_op(compiler, compiler->quicken ? BC_OP_LESS_NUM : BC_OP_LESS, loop_var.line, loop_var.column)) {
                 return 0;
             }
             int exit_jump = emit_jump(compiler, BC_OP_JUMP_IF_FALSE, loop_var.line, loop_var.column);
@@ -743,9 +839,11 @@ static int compile_stmt(BytecodeCompiler* compiler, Stmt* stmt, int want_result)
             // Pop the condition result so the stack is just [array, index]
             if (!emit_op(compiler, BC_OP_POP, loop_var.line, loop_var.column)) return 0;
 
+            // ARRAY_LEN has already checked the iterable is an array
             if (!emit_dup(compiler, 1, loop_var.line, loop_var.column) ||
                 !emit_dup(compiler, 1, loop_var.line, loop_var.column) ||
-                !emit_op(compiler, BC_OP_GET_INDEX, loop_var.line, loop_var.column)) {
+                !emit_op(compiler, compiler->quicken ? BC_OP_GET_INDEX_ARR_NUM : BC_OP_GET_INDEX,
+                         loop_var.line, loop_var.column)) {
                 return 0;
             }
             if (compiler->scope_depth > 0) {
@@ -776,7 +874,7 @@ static int compile_stmt(BytecodeCompiler* compiler, Stmt* stmt, int want_result)
             compiler->loops[compiler->loop_depth - 1].continue_target = current_offset(compiler);
 
             if (!emit_constant(compiler, val_number(1), loop_var.line, loop_var.column) ||
-                !emit_op(compiler, BC_OP_ADD, loop_var.line, loop_var.column) ||
+                !emit_op(compiler, compiler->quicken ? BC_OP_ADD_NUM : BC_OP_ADD, loop_var.line, loop_var.column) ||
                 !emit_op(compiler, BC_OP_JUMP, loop_var.line, loop_var.column) ||
                 !emit_u16(compiler, (uint16_t)loop_start, loop_var.line, loop_var.column)) {
                 compiler->loop_depth--;
@@ -799,6 +897,9 @@ static int compile_stmt(BytecodeCompiler* compiler, Stmt* stmt, int want_result)
         case STMT_BREAK: {
             if (compiler->loop_depth <= 0) break;  // fall to AST fallback
             LoopContext* loop = &compiler->loops[compiler->loop_depth - 1];
+            for (int i = loop->local_base; i < compiler->local_count; i++) {
+                if (!emit_op(compiler, BC_OP_POP, 0, 0)) return 0;
+            }
             // For-loops need to clean up stack: pop index, pop array, and pop env
             if (loop->has_for_cleanup) {
                 for (int i = 0; i < loop->for_pop_count; i++) {
@@ -819,6 +920,9 @@ static int compile_stmt(BytecodeCompiler* compiler, Stmt* stmt, int want_result)
         case STMT_CONTINUE: {
             if (compiler->loop_depth <= 0) break;  // fall to AST fallback
             LoopContext* loop = &compiler->loops[compiler->loop_depth - 1];
+            for (int i = loop->local_base; i < compiler->local_count; i++) {
+                if (!emit_op(compiler, BC_OP_POP, 0, 0)) return 0;
+            }
             if (!emit_op(compiler, BC_OP_JUMP, 0, 0)) return 0;
             if (!emit_u16(compiler, (uint16_t)loop->continue_target, 0, 0)) return 0;
             if (want_result) return emit_op(compiler, BC_OP_NIL, 0, 0);
@@ -926,19 +1030,9 @@ static int compile_stmt(BytecodeCompiler* compiler, Stmt* stmt, int want_result)
     return 1;
 }
 
-int bytecode_compile_statement(BytecodeChunk* chunk, Stmt* stmt, char* error, size_t error_size) {
-    return bytecode_compile_statement_mode(chunk, stmt, BYTECODE_COMPILE_HYBRID, error, error_size);
-}
-
-int bytecode_compile_statement_mode(BytecodeChunk* chunk, Stmt* stmt, BytecodeCompileMode mode,
-                                    char* error, size_t error_size) {
-    return bytecode_compile_statement_with_functions(chunk, stmt, mode, NULL, NULL, error, error_size);
-}
-
-int bytecode_compile_statement_with_functions(BytecodeChunk* chunk, Stmt* stmt, BytecodeCompileMode mode,
-                                              BytecodeBuildFunctionFn build_function,
-                                              void* build_function_data,
-                                              char* error, size_t error_size) {
+static int compile_top_statement(BytecodeChunk* chunk, Stmt* stmt, BytecodeCompileMode mode,
+                                 BytecodeBuildFunctionFn build_function, void* build_function_data,
+                                 int quicken, char* error, size_t error_size) {
     gc_pin();
     BytecodeCompiler compiler;
     memset(&compiler, 0, sizeof(compiler));
@@ -949,6 +1043,7 @@ int bytecode_compile_statement_with_functions(BytecodeChunk* chunk, Stmt* stmt,
     compiler.allow_return = 0;
     compiler.error = error;
     compiler.error_size = error_size;
+    compiler.quicken = quicken;
     if (error != NULL && error_size > 0) {
         error[0] = '\0';
     }
@@ -965,6 +1060,23 @@ int bytecode_compile_statement_with_functions(BytecodeChunk* chunk, Stmt* stmt,
     return success;
 }
 
+int bytecode_compile_statement(BytecodeChunk* chunk, Stmt* stmt, char* error, size_t error_size) {
+    return compile_top_statement(chunk, stmt, BYTECODE_COMPILE_HYBRID, NULL, NULL, 1, error, error_size);
+}
+
+int bytecode_compile_statement_mode(BytecodeChunk* chunk, Stmt* stmt, BytecodeCompileMode mode,
+                                    char* error, size_t error_size) {
+    return bytecode_compile_statement_with_functions(chunk, stmt, mode, NULL, NULL, error, error_size);
+}
+
+// Program chunks can be saved as artifacts, which keep to the generic ops
+int bytecode_compile_statement_with_functions(BytecodeChunk* chunk, Stmt* stmt, BytecodeCompileMode mode,
+                                              BytecodeBuildFunctionFn build_function,
+                                              void* build_function_data,
+                                              char* error, size_t error_size) {
+    return compile_top_statement(chunk, stmt, mode, build_function, build_function_data, 0, error, error_size);
+}
+
 int bytecode_compile_function_body(BytecodeChunk* chunk, Stmt* body,
                                    char** params, int param_count,
                                    BytecodeBuildFunctionFn build_function,
@@ -11,6 +11,13 @@
 #include "parser.h"
 #include "pass.h"
 
+#if SAGE_HAS_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 static void set_program_error(char* error, size_t error_size, const char* message) {
     if (error != NULL && error_size > 0) {
         snprintf(error, error_size, "%s", message);
@@ -408,6 +415,360 @@ static int read_code_payload(FILE* file, BytecodeChunk* chunk, char** line, size
     return 1;
 }
 
+// ----------------------------------------------------------------------------
+// Binary artifact format (SAGEBC2)
+//
+//   ArtifactHeader
+//   ArtifactSection[section_count]
+//   section payloads, each 8-byte aligned
+//
+// Integers are stored in host byte order; byte_order rejects artifacts built
+// on a machine with the other endianness. The file is mapped read-only and
+// the code, line and column tables are used in place. Only the constant
+// table is rebuilt at load, because string constants must become GC strings.
+// ----------------------------------------------------------------------------
+
+#define ARTIFACT_MAGIC "SAGEBC2"
+#define ARTIFACT_VERSION 2u
+#define ARTIFACT_BYTE_ORDER 0x01020304u
+#define ARTIFACT_ALIGN 8u
+
+enum {
+    ARTIFACT_SECTION_CODE = 1,     // uint8 opcodes, every chunk back to back
+    ARTIFACT_SECTION_LINES,        // int32 per code byte
+    ARTIFACT_SECTION_COLUMNS,      // int32 per code byte
+    ARTIFACT_SECTION_CONSTANTS,    // ArtifactConstant
+    ARTIFACT_SECTION_STRINGS,      // NUL-terminated string pool
+    ARTIFACT_SECTION_PARAMS,       // uint32 string pool offsets
+    ARTIFACT_SECTION_FUNCTIONS,    // ArtifactFunction
+    ARTIFACT_SECTION_CHUNKS,       // ArtifactChunk
+    ARTIFACT_SECTION_LAST = ARTIFACT_SECTION_CHUNKS
+};
+
+enum {
+    ARTIFACT_CONST_NUMBER = 1,
+    ARTIFACT_CONST_STRING = 2
+};
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t section_count;
+    uint32_t reserved;
+    uint64_t checksum;
+    uint64_t file_size;
+} ArtifactHeader;
+
+typedef struct {
+    uint32_t kind;
+    uint32_t reserved;
+    uint64_t offset;
+    uint64_t size;
+} ArtifactSection;
+
+typedef struct {
+    uint32_t kind;
+    uint32_t length;
+    union {
+        double number;
+        uint64_t string_offset;
+    } as;
+} ArtifactConstant;
+
+typedef struct {
+    uint32_t code_offset;
+    uint32_t code_count;
+    uint32_t constant_index;
+    uint32_t constant_count;
+} ArtifactChunk;
+
+typedef struct {
+    ArtifactChunk chunk;
+    uint32_t param_index;
+    uint32_t param_count;
+} ArtifactFunction;
+
+typedef struct {
+    uint8_t* data;
+    size_t length;
+    size_t capacity;
+} ArtifactBuffer;
+
+typedef struct {
+    const uint8_t* data[ARTIFACT_SECTION_LAST + 1];
+    uint64_t size[ARTIFACT_SECTION_LAST + 1];
+} ArtifactView;
+
+// FNV-1a over 64-bit words (bytewise for the tail): cheap enough to run on
+// every load without showing up next to the constant fix-ups.
+static uint64_t artifact_checksum_update(uint64_t hash, const uint8_t* data, size_t length) {
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= length; i += sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        hash ^= word;
+        hash *= 1099511628211ULL;
+    }
+    for (; i < length; i++) {
+        hash ^= data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static int artifact_section_is_debug(uint32_t kind) {
+    return kind == ARTIFACT_SECTION_LINES || kind == ARTIFACT_SECTION_COLUMNS;
+}
+
+// Covers the section table and every payload except the line/column tables.
+// Those are debug-only and never read by the VM, so skipping them keeps their
+// pages from being faulted in at load.
+static uint64_t artifact_checksum(const uint8_t* base, const ArtifactSection* sections, uint32_t section_count) {
+    uint64_t hash = 1469598103934665603ULL;
+    hash = artifact_checksum_update(hash, (const uint8_t*)sections, sizeof(ArtifactSection) * section_count);
+    for (uint32_t i = 0; i < section_count; i++) {
+        if (!artifact_section_is_debug(sections[i].kind)) {
+            hash = artifact_checksum_update(hash, base + sections[i].offset, (size_t)sections[i].size);
+        }
+    }
+    return hash;
+}
+
+static void buffer_append(ArtifactBuffer* buffer, const void* bytes, size_t length) {
+    if (buffer->length + length > buffer->capacity) {
+        size_t new_capacity = buffer->capacity == 0 ? 256 : buffer->capacity;
+        while (new_capacity < buffer->length + length) {
+            new_capacity *= 2;
+        }
+        buffer->data = SAGE_REALLOC(buffer->data, new_capacity);
+        buffer->capacity = new_capacity;
+    }
+    if (length > 0) {
+        memcpy(buffer->data + buffer->length, bytes, length);
+    }
+    buffer->length += length;
+}
+
+static void buffer_pad(ArtifactBuffer* buffer) {
+    static const uint8_t zeros[ARTIFACT_ALIGN] = {0};
+    size_t rem = buffer->length % ARTIFACT_ALIGN;
+    if (rem != 0) {
+        buffer_append(buffer, zeros, ARTIFACT_ALIGN - rem);
+    }
+}
+
+static uint32_t artifact_add_string(ArtifactBuffer* sections, const char* text, size_t length) {
+    ArtifactBuffer* pool = &sections[ARTIFACT_SECTION_STRINGS];
+    uint32_t offset = (uint32_t)pool->length;
+    buffer_append(pool, text, length);
+    buffer_append(pool, "", 1);
+    return offset;
+}
+
+static int artifact_add_chunk(ArtifactBuffer* sections, const BytecodeChunk* chunk, ArtifactChunk* entry,
+                              char* error, size_t error_size) {
+    entry->code_offset = (uint32_t)sections[ARTIFACT_SECTION_CODE].length;
+    entry->code_count = (uint32_t)chunk->code_count;
+    entry->constant_index = (uint32_t)(sections[ARTIFACT_SECTION_CONSTANTS].length / sizeof(ArtifactConstant));
+    entry->constant_count = (uint32_t)chunk->constant_count;
+
+    buffer_append(&sections[ARTIFACT_SECTION_CODE], chunk->code, (size_t)chunk->code_count);
+    buffer_append(&sections[ARTIFACT_SECTION_LINES], chunk->lines, sizeof(int32_t) * (size_t)chunk->code_count);
+    buffer_append(&sections[ARTIFACT_SECTION_COLUMNS], chunk->columns, sizeof(int32_t) * (size_t)chunk->code_count);
+
+    for (int i = 0; i < chunk->constant_count; i++) {
+        Value constant = chunk->constants[i];
+        ArtifactConstant record;
+        memset(&record, 0, sizeof(record));
+        if (IS_NUMBER(constant)) {
+            record.kind = ARTIFACT_CONST_NUMBER;
+            record.as.number = AS_NUMBER(constant);
+        } else if (IS_STRING(constant)) {
+            size_t string_len = strlen(AS_STRING(constant));
+            record.kind = ARTIFACT_CONST_STRING;
+            record.length = (uint32_t)string_len;
+            record.as.string_offset = artifact_add_string(sections, AS_STRING(constant), string_len);
+        } else {
+            set_program_error(error, error_size,
+                              "Compiled VM artifacts only support number/string constants.");
+            return 0;
+        }
+        buffer_append(&sections[ARTIFACT_SECTION_CONSTANTS], &record, sizeof(record));
+    }
+    return 1;
+}
+
+static void release_artifact_mapping(void* mapping, size_t size) {
+    if (mapping == NULL) {
+        return;
+    }
+#if SAGE_HAS_MMAP
+    munmap(mapping, size);
+#else
+    (void)size;
+    free(mapping);
+#endif
+}
+
+static void* map_artifact(const char* input_path, size_t* size_out, char* error, size_t error_size) {
+#if SAGE_HAS_MMAP
+    int fd = open(input_path, O_RDONLY);
+    if (fd < 0) {
+        if (error != NULL && error_size > 0) {
+            snprintf(error, error_size, "Could not open \"%s\": %s", input_path, strerror(errno));
+        }
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(ArtifactHeader)) {
+        close(fd);
+        set_program_error(error, error_size, "Truncated VM artifact.");
+        return NULL;
+    }
+    void* mapping = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        set_program_error(error, error_size, "Could not map VM artifact.");
+        return NULL;
+    }
+    *size_out = (size_t)st.st_size;
+    return mapping;
+#else
+    FILE* file = fopen(input_path, "rb");
+    if (file == NULL) {
+        if (error != NULL && error_size > 0) {
+            snprintf(error, error_size, "Could not open \"%s\": %s", input_path, strerror(errno));
+        }
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (length < (long)sizeof(ArtifactHeader)) {
+        fclose(file);
+        set_program_error(error, error_size, "Truncated VM artifact.");
+        return NULL;
+    }
+    void* data = SAGE_ALLOC((size_t)length);
+    size_t read = fread(data, 1, (size_t)length, file);
+    fclose(file);
+    if (read != (size_t)length) {
+        free(data);
+        set_program_error(error, error_size, "Could not read VM artifact.");
+        return NULL;
+    }
+    *size_out = (size_t)length;
+    return data;
+#endif
+}
+
+static int artifact_parse_view(const uint8_t* base, size_t size, ArtifactView* view,
+                               char* error, size_t error_size) {
+    const ArtifactHeader* header = (const ArtifactHeader*)base;
+    memset(view, 0, sizeof(*view));
+
+    if (memcmp(header->magic, ARTIFACT_MAGIC, sizeof(header->magic)) != 0) {
+        set_program_error(error, error_size, "Invalid VM artifact header.");
+        return 0;
+    }
+    if (header->byte_order != ARTIFACT_BYTE_ORDER) {
+        set_program_error(error, error_size, "VM artifact was built for a different byte order.");
+        return 0;
+    }
+    if (header->version != ARTIFACT_VERSION) {
+        set_program_error(error, error_size, "Unsupported VM artifact version.");
+        return 0;
+    }
+    if (header->file_size != size ||
+        header->section_count > ARTIFACT_SECTION_LAST ||
+        sizeof(ArtifactHeader) + (size_t)header->section_count * sizeof(ArtifactSection) > size) {
+        set_program_error(error, error_size, "Truncated VM artifact.");
+        return 0;
+    }
+    const ArtifactSection* sections = (const ArtifactSection*)(base + sizeof(ArtifactHeader));
+    for (uint32_t i = 0; i < header->section_count; i++) {
+        const ArtifactSection* section = &sections[i];
+        if (section->kind < ARTIFACT_SECTION_CODE || section->kind > ARTIFACT_SECTION_LAST ||
+            section->offset % ARTIFACT_ALIGN != 0 ||
+            section->offset > size || section->size > size - section->offset) {
+            set_program_error(error, error_size, "Invalid section table in VM artifact.");
+            return 0;
+        }
+        view->data[section->kind] = base + section->offset;
+        view->size[section->kind] = section->size;
+    }
+    if (artifact_checksum(base, sections, header->section_count) != header->checksum) {
+        set_program_error(error, error_size, "VM artifact checksum mismatch.");
+        return 0;
+    }
+
+    uint64_t code_size = view->size[ARTIFACT_SECTION_CODE];
+    if (view->size[ARTIFACT_SECTION_LINES] != code_size * sizeof(int32_t) ||
+        view->size[ARTIFACT_SECTION_COLUMNS] != code_size * sizeof(int32_t) ||
+        view->size[ARTIFACT_SECTION_CONSTANTS] % sizeof(ArtifactConstant) != 0 ||
+        view->size[ARTIFACT_SECTION_PARAMS] % sizeof(uint32_t) != 0 ||
+        view->size[ARTIFACT_SECTION_FUNCTIONS] % sizeof(ArtifactFunction) != 0 ||
+        view->size[ARTIFACT_SECTION_CHUNKS] % sizeof(ArtifactChunk) != 0) {
+        set_program_error(error, error_size, "Inconsistent section sizes in VM artifact.");
+        return 0;
+    }
+    return 1;
+}
+
+static const char* artifact_string(const ArtifactView* view, uint64_t offset, uint64_t length) {
+    uint64_t pool_size = view->size[ARTIFACT_SECTION_STRINGS];
+    if (offset > pool_size || length >= pool_size - offset) {
+        return NULL;
+    }
+    const char* text = (const char*)view->data[ARTIFACT_SECTION_STRINGS] + offset;
+    return text[length] == '\0' ? text : NULL;
+}
+
+static int artifact_load_chunk(const ArtifactView* view, const ArtifactChunk* entry, BytecodeChunk* chunk,
+                               char* error, size_t error_size) {
+    uint64_t constant_total = view->size[ARTIFACT_SECTION_CONSTANTS] / sizeof(ArtifactConstant);
+    if ((uint64_t)entry->code_offset + entry->code_count > view->size[ARTIFACT_SECTION_CODE] ||
+        (uint64_t)entry->constant_index + entry->constant_count > constant_total ||
+        entry->code_count > 0x7fffffffu || entry->constant_count > 0x7fffffffu) {
+        set_program_error(error, error_size, "Chunk entry out of range in VM artifact.");
+        return 0;
+    }
+
+    if (entry->code_count > 0) {
+        chunk->code = (uint8_t*)view->data[ARTIFACT_SECTION_CODE] + entry->code_offset;
+        chunk->lines = (int*)view->data[ARTIFACT_SECTION_LINES] + entry->code_offset;
+        chunk->columns = (int*)view->data[ARTIFACT_SECTION_COLUMNS] + entry->code_offset;
+        chunk->code_borrowed = 1;
+    }
+    chunk->code_count = (int)entry->code_count;
+    chunk->code_capacity = (int)entry->code_count;
+
+    if (entry->constant_count > 0 && !ensure_constant_capacity(chunk, (int)entry->constant_count)) {
+        set_program_error(error, error_size, "Out of memory while storing constants.");
+        return 0;
+    }
+
+    const ArtifactConstant* records = (const ArtifactConstant*)view->data[ARTIFACT_SECTION_CONSTANTS];
+    for (uint32_t i = 0; i < entry->constant_count; i++) {
+        const ArtifactConstant* record = &records[entry->constant_index + i];
+        if (record->kind == ARTIFACT_CONST_NUMBER) {
+            append_constant(chunk, val_number(record->as.number));
+        } else if (record->kind == ARTIFACT_CONST_STRING) {
+            const char* text = artifact_string(view, record->as.string_offset, record->length);
+            if (text == NULL) {
+                set_program_error(error, error_size, "Invalid string constant in VM artifact.");
+                return 0;
+            }
+            append_constant(chunk, val_string_len(text, (int)record->length));
+        } else {
+            set_program_error(error, error_size, "Unknown constant entry in VM artifact.");
+            return 0;
+        }
+    }
+    return 1;
+}
+
 void bytecode_program_init(BytecodeProgram* program) {
     memset(program, 0, sizeof(*program));
 }
@@ -427,6 +788,8 @@ void bytecode_program_free(BytecodeProgram* program) {
     }
     free(program->functions);
 
+    release_artifact_mapping(program->mapping, program->mapping_size);
+
     memset(program, 0, sizeof(*program));
 }
 
@@ -461,8 +824,8 @@ int bytecode_compile_program(BytecodeProgram* program, Stmt* statements, Bytecod
     return 1;
 }
 
-int bytecode_program_write_file(const BytecodeProgram* program, const char* output_path,
-                                char* error, size_t error_size) {
+int bytecode_program_write_text_file(const BytecodeProgram* program, const char* output_path,
+                                     char* error, size_t error_size) {
     FILE* out = fopen(output_path, "wb");
     if (out == NULL) {
         if (error != NULL && error_size > 0) {
@@ -504,8 +867,8 @@ int bytecode_program_write_file(const BytecodeProgram* program, const char* outp
     return ok;
 }
 
-int bytecode_program_read_file(BytecodeProgram* program, const char* input_path,
-                               char* error, size_t error_size) {
+static int read_text_artifact(BytecodeProgram* program, const char* input_path,
+                              char* error, size_t error_size) {
     gc_pin();
     FILE* file = fopen(input_path, "rb");
     char* line = NULL;
@@ -654,8 +1017,214 @@ cleanup:
     return ok;
 }
 
+int bytecode_program_write_file(const BytecodeProgram* program, const char* output_path,
+                                char* error, size_t error_size) {
+    ArtifactBuffer sections[ARTIFACT_SECTION_LAST + 1];
+    ArtifactBuffer file;
+    int ok = 1;
+
+    memset(sections, 0, sizeof(sections));
+    memset(&file, 0, sizeof(file));
+    if (error != NULL && error_size > 0) {
+        error[0] = '\0';
+    }
+
+    for (int i = 0; ok && i < program->function_count; i++) {
+        const BytecodeFunction* function = &program->functions[i];
+        ArtifactFunction entry;
+        memset(&entry, 0, sizeof(entry));
+        entry.param_index = (uint32_t)(sections[ARTIFACT_SECTION_PARAMS].length / sizeof(uint32_t));
+        entry.param_count = (uint32_t)function->param_count;
+        for (int j = 0; j < function->param_count; j++) {
+            uint32_t offset = artifact_add_string(sections, function->params[j], strlen(function->params[j]));
+            buffer_append(&sections[ARTIFACT_SECTION_PARAMS], &offset, sizeof(offset));
+        }
+        ok = artifact_add_chunk(sections, &function->chunk, &entry.chunk, error, error_size);
+        buffer_append(&sections[ARTIFACT_SECTION_FUNCTIONS], &entry, sizeof(entry));
+    }
+
+    for (int i = 0; ok && i < program->chunk_count; i++) {
+        ArtifactChunk entry;
+        ok = artifact_add_chunk(sections, &program->chunks[i], &entry, error, error_size);
+        buffer_append(&sections[ARTIFACT_SECTION_CHUNKS], &entry, sizeof(entry));
+    }
+
+    for (int kind = ARTIFACT_SECTION_CODE; ok && kind <= ARTIFACT_SECTION_LAST; kind++) {
+        if (sections[kind].length > 0xffffffffu) {
+            set_program_error(error, error_size, "Compiled program is too large for a VM artifact.");
+            ok = 0;
+        }
+    }
+
+    if (ok) {
+        ArtifactHeader header;
+        ArtifactSection table[ARTIFACT_SECTION_LAST];
+        memset(&header, 0, sizeof(header));
+        memset(table, 0, sizeof(table));
+
+        uint64_t offset = sizeof(header) + sizeof(table);
+        for (int kind = ARTIFACT_SECTION_CODE; kind <= ARTIFACT_SECTION_LAST; kind++) {
+            offset = (offset + ARTIFACT_ALIGN - 1) & ~(uint64_t)(ARTIFACT_ALIGN - 1);
+            table[kind - 1].kind = (uint32_t)kind;
+            table[kind - 1].offset = offset;
+            table[kind - 1].size = sections[kind].length;
+            offset += sections[kind].length;
+        }
+
+        buffer_append(&file, &header, sizeof(header));
+        buffer_append(&file, table, sizeof(table));
+        for (int kind = ARTIFACT_SECTION_CODE; kind <= ARTIFACT_SECTION_LAST; kind++) {
+            buffer_pad(&file);
+            buffer_append(&file, sections[kind].data, sections[kind].length);
+        }
+
+        memcpy(header.magic, ARTIFACT_MAGIC, sizeof(header.magic));
+        header.version = ARTIFACT_VERSION;
+        header.byte_order = ARTIFACT_BYTE_ORDER;
+        header.section_count = ARTIFACT_SECTION_LAST;
+        header.file_size = file.length;
+        header.checksum = artifact_checksum(file.data, table, ARTIFACT_SECTION_LAST);
+        memcpy(file.data, &header, sizeof(header));
+
+        FILE* out = fopen(output_path, "wb");
+        if (out == NULL) {
+            if (error != NULL && error_size > 0) {
+                snprintf(error, error_size, "Could not open \"%s\": %s", output_path, strerror(errno));
+            }
+            ok = 0;
+        } else {
+            ok = fwrite(file.data, 1, file.length, out) == file.length;
+            if (fclose(out) != 0) {
+                ok = 0;
+            }
+            if (!ok && error != NULL && error_size > 0 && error[0] == '\0') {
+                snprintf(error, error_size, "Could not write compiled VM artifact \"%s\".", output_path);
+            }
+        }
+    }
+
+    for (int kind = 0; kind <= ARTIFACT_SECTION_LAST; kind++) {
+        free(sections[kind].data);
+    }
+    free(file.data);
+    return ok;
+}
+
+static int read_binary_artifact(BytecodeProgram* program, const char* input_path,
+                                char* error, size_t error_size) {
+    size_t size = 0;
+    uint8_t* base = map_artifact(input_path, &size, error, error_size);
+    if (base == NULL) {
+        return 0;
+    }
+
+    ArtifactView view;
+    if (sizeof(int) != sizeof(int32_t) || !artifact_parse_view(base, size, &view, error, error_size)) {
+        if (error != NULL && error_size > 0 && error[0] == '\0') {
+            set_program_error(error, error_size, "Unsupported VM artifact.");
+        }
+        release_artifact_mapping(base, size);
+        return 0;
+    }
+
+    gc_pin();
+    program->mapping = base;
+    program->mapping_size = size;
+    int ok = 0;
+
+    const ArtifactFunction* functions = (const ArtifactFunction*)view.data[ARTIFACT_SECTION_FUNCTIONS];
+    const uint32_t* params = (const uint32_t*)view.data[ARTIFACT_SECTION_PARAMS];
+    uint64_t function_total = view.size[ARTIFACT_SECTION_FUNCTIONS] / sizeof(ArtifactFunction);
+    uint64_t param_total = view.size[ARTIFACT_SECTION_PARAMS] / sizeof(uint32_t);
+
+    for (uint64_t i = 0; i < function_total; i++) {
+        const ArtifactFunction* entry = &functions[i];
+        BytecodeFunction function;
+        memset(&function, 0, sizeof(function));
+        bytecode_chunk_init(&function.chunk);
+
+        if ((uint64_t)entry->param_index + entry->param_count > param_total) {
+            set_program_error(error, error_size, "Invalid function parameter table in VM artifact.");
+            goto cleanup;
+        }
+
+        function.param_count = (int)entry->param_count;
+        if (function.param_count > 0) {
+            function.params = SAGE_ALLOC((size_t)function.param_count * sizeof(char*));
+        }
+        int params_ok = 1;
+        for (int j = 0; j < function.param_count; j++) {
+            uint32_t offset = params[entry->param_index + (uint32_t)j];
+            uint64_t pool_size = view.size[ARTIFACT_SECTION_STRINGS];
+            const char* name = offset < pool_size ? (const char*)view.data[ARTIFACT_SECTION_STRINGS] + offset : NULL;
+            size_t name_len = name != NULL ? strnlen(name, (size_t)(pool_size - offset)) : 0;
+            if (name == NULL || name_len == pool_size - offset) {
+                params_ok = 0;
+                break;
+            }
+            function.params[j] = dup_text(name, name_len);
+        }
+
+        if (!params_ok) {
+            set_program_error(error, error_size, "Invalid function parameter entry in VM artifact.");
+        }
+        if (!params_ok ||
+            !artifact_load_chunk(&view, &entry->chunk, &function.chunk, error, error_size) ||
+            !append_function(program, &function, error, error_size, NULL)) {
+            for (int j = 0; j < function.param_count; j++) free(function.params[j]);
+            free(function.params);
+            bytecode_chunk_free(&function.chunk);
+            goto cleanup;
+        }
+    }
+
+    const ArtifactChunk* chunks = (const ArtifactChunk*)view.data[ARTIFACT_SECTION_CHUNKS];
+    uint64_t chunk_total = view.size[ARTIFACT_SECTION_CHUNKS] / sizeof(ArtifactChunk);
+    for (uint64_t i = 0; i < chunk_total; i++) {
+        BytecodeChunk chunk;
+        bytecode_chunk_init(&chunk);
+
+        if (!artifact_load_chunk(&view, &chunks[i], &chunk, error, error_size) ||
+            !append_chunk(program, &chunk, error, error_size)) {
+            bytecode_chunk_free(&chunk);
+            goto cleanup;
+        }
+    }
+
+    ok = 1;
+
+cleanup:
+    if (!ok) {
+        bytecode_program_free(program);
+    }
+    gc_unpin();
+    return ok;
+}
+
+int bytecode_program_read_file(BytecodeProgram* program, const char* input_path,
+                               char* error, size_t error_size) {
+    char magic[sizeof(ARTIFACT_MAGIC)] = {0};
+    FILE* file = fopen(input_path, "rb");
+    if (file == NULL) {
+        if (error != NULL && error_size > 0) {
+            snprintf(error, error_size, "Could not open \"%s\": %s", input_path, strerror(errno));
+        }
+        return 0;
+    }
+    size_t read = fread(magic, 1, sizeof(magic), file);
+    fclose(file);
+
+    if (error != NULL && error_size > 0) {
+        error[0] = '\0';
+    }
+    if (read == sizeof(magic) && memcmp(magic, ARTIFACT_MAGIC, sizeof(magic)) == 0) {
+        return read_binary_artifact(program, input_path, error, error_size);
+    }
+    return read_text_artifact(program, input_path, error, error_size);
+}
+
 int compile_source_to_vm_artifact(const char* source, const char* input_path, const char* output_path,
-                                  int opt_level, int debug_info) {
+                                  int opt_level, int debug_info, BytecodeArtifactFormat format) {
     BytecodeProgram program;
     char error[256];
     Stmt* ast = parse_program(source, input_path);
@@ -667,6 +1236,7 @@ int compile_source_to_vm_artifact(const char* source, const char* input_path, co
         pass_ctx.debug_info = debug_info;
         pass_ctx.verbose = 0;
         pass_ctx.input_path = input_path;
+        pass_ctx.profile = NULL;
         ast = run_passes(ast, &pass_ctx);
     }
 
@@ -677,7 +1247,10 @@ int compile_source_to_vm_artifact(const char* source, const char* input_path, co
         return 0;
     }
 
-    if (!bytecode_program_write_file(&program, output_path, error, sizeof(error))) {
+    int written = format == BYTECODE_ARTIFACT_TEXT
+                      ? bytecode_program_write_text_file(&program, output_path, error, sizeof(error))
+                      : bytecode_program_write_file(&program, output_path, error, sizeof(error));
+    if (!written) {
         fprintf(stderr, "VM artifact error: %s\n", error[0] ? error : "unknown error");
         bytecode_program_free(&program);
         free_stmt(ast);
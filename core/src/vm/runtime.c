@@ -4,6 +4,7 @@
 #include "vm.h"
 #include "jit.h"
 #include "aot.h"
+#include "typecheck.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -19,6 +20,8 @@ extern JitState* interpreter_get_jit(void);
 // Per-runtime-mode persistent state
 static JitState g_repl_jit;
 static int g_repl_jit_initialized = 0;
+static TypeMap g_runtime_types;  // Type facts joined over every statement run so far
+static int g_runtime_types_initialized = 0;
 
 static ExecResult runtime_normal(Value value) {
     ExecResult result = {0};
@@ -95,6 +98,12 @@ ExecResult sage_execute_stmt(Stmt* stmt, Env* env, SageRuntimeMode mode) {
         mode = SAGE_RUNTIME_AST;
     }
 
+    if (!g_runtime_types_initialized) {
+        typemap_init(&g_runtime_types);
+        g_runtime_types_initialized = 1;
+    }
+    typecheck_annotate(&g_runtime_types, stmt);
+
     if (mode == SAGE_RUNTIME_AUTO) {
         // Auto mode: JIT profiling + interpreter (hybrid).
         // The JIT profiles function calls and provides type feedback.
@@ -393,7 +393,11 @@ ExecResult vm_execute_chunk(BytecodeChunk* chunk, Env* env) {
         &&BC_OP_GPU_CMD_DRAW_IDX, &&BC_OP_GPU_SUBMIT_SYNC, &&BC_OP_GPU_ACQUIRE_IMG,
         &&BC_OP_GPU_PRESENT, &&BC_OP_GPU_WAIT_FENCE, &&BC_OP_GPU_RESET_FENCE,
         &&BC_OP_GPU_UPDATE_UNIFORM, &&BC_OP_GPU_CMD_PUSH_CONST,
-        &&BC_OP_GPU_CMD_DISPATCH
+        &&BC_OP_GPU_CMD_DISPATCH,
+        &&BC_OP_RANGE_PREP, &&BC_OP_RANGE_NEXT,
+        &&BC_OP_ADD_NUM, &&BC_OP_SUB_NUM, &&BC_OP_MUL_NUM, &&BC_OP_LESS_NUM,
+        &&BC_OP_LESS_EQUAL_NUM, &&BC_OP_GREATER_NUM, &&BC_OP_GREATER_EQUAL_NUM,
+        &&BC_OP_GET_INDEX_ARR_NUM
     };
 
     #define DISPATCH() \
@@ -420,6 +424,22 @@ ExecResult vm_execute_chunk(BytecodeChunk* chunk, Env* env) {
 #define SYNC_SP() vm.stack_count = (int)(sp - vm.stack)
 #define READ_U8() (*ip++)
 #define READ_U16() (ip += 2, (uint16_t)((ip[-2] << 8) | ip[-1]))
+// A quickened op whose operand tags no longer match: rewrite it to the generic
+// op so later runs skip the guard, then execute that op on the same operands
+#define DEOPT(generic) \
+    do { \
+        if (!frame->chunk->code_borrowed) ip[-1] = (uint8_t)(generic); \
+        goto generic; \
+    } while (0)
+#define QUICK_NUMERIC(generic, expr) \
+    do { \
+        Value right = PEEK(0), left = PEEK(1); \
+        if (__builtin_expect(!IS_NUMBER(left) || !IS_NUMBER(right), 0)) DEOPT(generic); \
+        double l = AS_NUMBER(left), r = AS_NUMBER(right); \
+        sp--; \
+        PEEK(0) = (expr); \
+        DISPATCH(); \
+    } while (0)
 
 #ifdef __GNUC__
     DISPATCH();
@@ -590,6 +610,10 @@ ExecResult vm_execute_chunk(BytecodeChunk* chunk, Env* env) {
                 } else if (object.type == VAL_BYTES && IS_NUMBER(index)) {
                     int b_index = (int)AS_NUMBER(index);
                     BytesValue* b = object.as.bytes;
+                    if (b->mapped) {
+                        result = vm_error("VM: Cannot modify read-only mapped bytes.");
+                        goto done;
+                    }
                     if (b_index >= 0 && b_index < b->length) {
                         b->data[b_index] = (unsigned char)(int)AS_NUMBER(value);
                     }
@@ -666,6 +690,8 @@ ExecResult vm_execute_chunk(BytecodeChunk* chunk, Env* env) {
             BC_OP_SHIFT_LEFT:
             BC_OP_SHIFT_RIGHT: {
                 BytecodeOp local_op = (BytecodeOp)ip[-1];
+                // Still quickened when DEOPT could not rewrite mapped code
+                if (local_op >= BC_OP_ADD_NUM) local_op = bytecode_generic_op(local_op);
                 Value right = POP();
                 Value left = POP();
                 Value out = val_nil();
@@ -914,6 +940,52 @@ ExecResult vm_execute_chunk(BytecodeChunk* chunk, Env* env) {
                 PUSH(val_number((double)value.as.array->count));
                 DISPATCH();
             }
+            BC_OP_RANGE_PREP: {
+                // Same truncation and bounds as range(); the state stays on the stack
+                Value step = PEEK(0), end = PEEK(1), start = PEEK(2);
+                if (!IS_NUMBER(start) || !IS_NUMBER(end) || !IS_NUMBER(step) || (int)AS_NUMBER(step) == 0) {
+                    result = vm_error("range() requires numbers and a non-zero step.");
+                    goto done;
+                }
+                PEEK(2) = val_number((double)(int)AS_NUMBER(start));
+                PEEK(1) = val_number((double)(int)AS_NUMBER(end));
+                PEEK(0) = val_number((double)(int)AS_NUMBER(step));
+                DISPATCH();
+            }
+            BC_OP_RANGE_NEXT: {
+                uint16_t exit_target = READ_U16();
+                double counter = AS_NUMBER(PEEK(2)), end = AS_NUMBER(PEEK(1)), step = AS_NUMBER(PEEK(0));
+                if (step > 0 ? counter >= end : counter <= end) {
+                    ip = frame->chunk->code + exit_target;
+                    DISPATCH();
+                }
+                PEEK(2) = val_number(counter + step);
+                PUSH(val_number(counter));
+                DISPATCH();
+            }
+            BC_OP_ADD_NUM:
+                QUICK_NUMERIC(BC_OP_ADD, val_number(l + r));
+            BC_OP_SUB_NUM:
+                QUICK_NUMERIC(BC_OP_SUB, val_number(l - r));
+            BC_OP_MUL_NUM:
+                QUICK_NUMERIC(BC_OP_MUL, val_number(l * r));
+            BC_OP_LESS_NUM:
+                QUICK_NUMERIC(BC_OP_LESS, val_bool(l < r));
+            BC_OP_LESS_EQUAL_NUM:
+                QUICK_NUMERIC(BC_OP_LESS_EQUAL, val_bool(l <= r));
+            BC_OP_GREATER_NUM:
+                QUICK_NUMERIC(BC_OP_GREATER, val_bool(l > r));
+            BC_OP_GREATER_EQUAL_NUM:
+                QUICK_NUMERIC(BC_OP_GREATER_EQUAL, val_bool(l >= r));
+            BC_OP_GET_INDEX_ARR_NUM: {
+                Value index = PEEK(0), object = PEEK(1);
+                if (__builtin_expect(object.type != VAL_ARRAY || !IS_NUMBER(index), 0)) DEOPT(BC_OP_GET_INDEX);
+                ArrayValue* array = object.as.array;
+                int i = (int)AS_NUMBER(index);
+                sp--;
+                PEEK(0) = (unsigned)i < (unsigned)array->count ? array->elements[i] : val_nil();
+                DISPATCH();
+            }
             BC_OP_BREAK:
             BC_OP_CONTINUE:
             BC_OP_LOOP_BACK:
@@ -0,0 +1,106 @@
+#!/bin/bash
+## run_bpe_bench.sh — Training and encoding throughput for the native _bpe tokenizer
+## Usage: bash benchmarks/run_bpe_bench.sh [corpus_mb] [train_mb] [merges]
+##
+## Generates a Zipf-distributed text corpus, trains a byte-level BPE
+## tokenizer on the first train_mb of it, then encodes the whole corpus on
+## one thread, on one thread per CPU, and as a batch of 64 KB documents.
+## The encodings must agree and decode back to the input. Defaults are
+## sized for a quick run; 100 10 8000 is the full one.
+
+set -e
+
+CORE="$(cd "$(dirname "$0")/../../core" && pwd)"
+CORPUS_MB="${1:-10}"
+TRAIN_MB="${2:-2}"
+MERGES="${3:-4000}"
+SAGE="${SAGE:-$CORE/sage}"
+TMPDIR="/tmp/sage_bpe_bench_$$"
+mkdir -p "$TMPDIR"
+trap 'rm -rf "$TMPDIR"' EXIT
+
+BOLD='\033[1m'
+DIM_C='\033[0;90m'
+RESET='\033[0m'
+
+python3 - "$CORPUS_MB" "$TRAIN_MB" "$TMPDIR" <<'PY'
+import random, sys
+corpus_mb, train_mb, out = float(sys.argv[1]), float(sys.argv[2]), sys.argv[3]
+rnd = random.Random(7)
+parts = ["ka", "to", "ri", "me", "su", "na", "lo", "pe", "an", "the", "ing", "er", "ou", "st", "é", "ü"]
+words = ["".join(rnd.choice(parts) for _ in range(rnd.randint(1, 4))) for _ in range(5000)]
+weights = [1 / (i + 1) for i in range(len(words))]
+def text(size):
+    out, n = [], 0
+    while n < size:
+        line = " ".join(rnd.choices(words, weights, k=12)) + ".\n"
+        out.append(line)
+        n += len(line.encode())
+    return "".join(out).encode()
+corpus = text(int(corpus_mb * 1e6))
+open(f"{out}/corpus.txt", "wb").write(corpus)
+open(f"{out}/train.txt", "wb").write(corpus[:int(train_mb * 1e6)])
+PY
+
+cat > "$TMPDIR/bench.sage" <<SAGE
+gc_disable()
+import io
+import math
+import _bpe
+import llm.tokenizer
+
+let corpus = io.mmap("$TMPDIR/corpus.txt")
+let mb = len(corpus) / 1000000
+
+proc rate(seconds):
+    if seconds <= 0:
+        return "-"
+    return str(math.round(mb / seconds * 10) / 10)
+
+let tok = tokenizer.bpe_tokenizer($MERGES + 260)
+let t = clock()
+tokenizer.train_bpe(tok, io.mmap("$TMPDIR/train.txt"), $MERGES)
+print "train|" + str(math.round((clock() - t) * 100) / 100) + "|" + str(len(tok["merges"]))
+
+let model = tokenizer.bpe_model(tok)
+t = clock()
+let one = _bpe.encode(model, corpus, 1)
+print "encode 1 thread|" + rate(clock() - t) + "|" + str(len(one))
+t = clock()
+let all = _bpe.encode(model, corpus)
+print "encode all|" + rate(clock() - t) + "|" + str(len(all))
+
+let text = io.readfile("$TMPDIR/corpus.txt")
+let docs = []
+let pos = 0
+while pos < len(text):
+    push(docs, slice(text, pos, pos + 65536))
+    pos = pos + 65536
+t = clock()
+let batch = tokenizer.encode_batch(tok, docs)
+let n = 0
+for i in range(len(batch)):
+    n = n + len(batch[i])
+print "encode_batch|" + rate(clock() - t) + "|" + str(n)
+
+let same = len(one) == len(all)
+for i in range(len(one)):
+    if one[i] != all[i]:
+        same = false
+        break
+print "check|" + str(same) + "|" + str(tokenizer.decode(tok, one) == text)
+SAGE
+
+printf "\n${BOLD}  SageLang BPE Tokenizer Benchmark${RESET}\n"
+printf "  ${DIM_C}%s MB corpus, trained on %s MB, %d merges, %d CPUs${RESET}\n" \
+    "$CORPUS_MB" "$TRAIN_MB" "$MERGES" "$(nproc 2>/dev/null || echo 1)"
+printf "  ${DIM_C}───────────────────────────────────────────────${RESET}\n\n"
+printf "  ${DIM_C}%-16s %10s %12s${RESET}\n" "run" "MB/s" "tokens"
+
+"$SAGE" "$TMPDIR/bench.sage" | while IFS='|' read -r label a b; do
+    case "$label" in
+        train) printf "  %-16s %9ss %12s merges\n" "train" "$a" "$b" ;;
+        check) printf "\n  threads agree: %s, round trip: %s\n\n" "$a" "$b" ;;
+        *) printf "  %-16s %10s %12s\n" "$label" "$a" "$b" ;;
+    esac
+done
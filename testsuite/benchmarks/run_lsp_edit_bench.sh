@@ -0,0 +1,111 @@
+#!/bin/bash
+## run_lsp_edit_bench.sh — Time LSP keystroke handling on a large module
+## Usage: bash benchmarks/run_lsp_edit_bench.sh [lines] [edits]
+##
+## Opens a generated module of roughly `lines` lines in `sage --lsp`, then
+## types `edits` characters into a proc in the middle as incremental
+## (range) didChange notifications. Two passes:
+##   1. SAGE_LSP_DEBOUNCE_MS=0: diagnostics after every keystroke; reports the
+##      time from sending an edit to receiving its publishDiagnostics.
+##   2. default debounce: the same burst, sent as fast as possible; reports
+##      how many publishes it took and the server's sage/metrics counters.
+
+set -e
+
+SAGE="$(cd "$(dirname "$0")/../../core" && pwd)/sage"
+LINES="${1:-10000}"
+EDITS="${2:-50}"
+
+BOLD='\033[1m'
+CYAN='\033[0;36m'
+RESET='\033[0m'
+
+run_pass() {
+    SAGE_LSP_DEBOUNCE_MS="$1" python3 - "$SAGE" "$LINES" "$EDITS" "$1" <<'PY'
+import json, subprocess, sys, time
+
+sage, lines, edits, debounce = sys.argv[1], int(sys.argv[2]), int(sys.argv[3]), sys.argv[4]
+procs = max(1, lines // 6)
+src = []
+for i in range(procs):
+    src.append("## Step %d\nproc f%d(a, b):\n    let x = a * %d + b\n    if x > %d:\n        return x\n    return f%d(b, a)\n"
+               % (i, i, i, i, max(i - 1, 0)))
+text = "".join(src)
+mid = (procs // 2) * 6 + 2   # the `let x = ...` line of a middle proc
+uri = "file:///bench/big.sage"
+
+p = subprocess.Popen([sage, "--lsp"], stdin=subprocess.PIPE, stdout=subprocess.PIPE,
+                     stderr=subprocess.DEVNULL)
+
+def send(obj):
+    body = json.dumps(obj).encode()
+    p.stdin.write(b"Content-Length: %d\r\n\r\n" % len(body) + body)
+    p.stdin.flush()
+
+def recv():
+    length = 0
+    while True:
+        line = p.stdout.readline()
+        if line in (b"\r\n", b"\n", b""):
+            break
+        if line.startswith(b"Content-Length:"):
+            length = int(line.split(b":")[1])
+    return json.loads(p.stdout.read(length))
+
+def wait_for(pred):
+    while True:
+        msg = recv()
+        if pred(msg):
+            return msg
+
+def is_diag(version):
+    return lambda m: m.get("method") == "textDocument/publishDiagnostics" and \
+        m["params"].get("version") == version
+
+send({"jsonrpc": "2.0", "id": 1, "method": "initialize", "params": {"capabilities": {}}})
+wait_for(lambda m: m.get("id") == 1)
+t0 = time.perf_counter()
+send({"jsonrpc": "2.0", "method": "textDocument/didOpen",
+      "params": {"textDocument": {"uri": uri, "version": 1, "text": text}}})
+wait_for(is_diag(1))
+open_ms = (time.perf_counter() - t0) * 1000
+
+col = len("    let x = a")
+times = []
+for i in range(edits):
+    change = {"range": {"start": {"line": mid, "character": col + i},
+                        "end": {"line": mid, "character": col + i}}, "text": "1"}
+    t0 = time.perf_counter()
+    send({"jsonrpc": "2.0", "method": "textDocument/didChange",
+          "params": {"textDocument": {"uri": uri, "version": 2 + i}, "contentChanges": [change]}})
+    if debounce == "0":
+        wait_for(is_diag(2 + i))
+        times.append((time.perf_counter() - t0) * 1000)
+
+if debounce != "0":
+    wait_for(is_diag(1 + edits))
+send({"jsonrpc": "2.0", "id": 2, "method": "sage/metrics", "params": {}})
+metrics = wait_for(lambda m: m.get("id") == 2)["result"]
+send({"jsonrpc": "2.0", "id": 3, "method": "shutdown"})
+wait_for(lambda m: m.get("id") == 3)
+send({"jsonrpc": "2.0", "method": "exit"})
+p.wait()
+
+print("  lines: %d   open + first diagnostics: %.1f ms" % (text.count("\n"), open_ms))
+if times:
+    times.sort()
+    print("  per-keystroke edit -> diagnostics: mean %.2f ms, p50 %.2f ms, max %.2f ms"
+          % (sum(times) / len(times), times[len(times) // 2], times[-1]))
+print("  publishes: %d for %d edits; chunks parsed %d, relexed %d, reused %d"
+      % (metrics["publishes"] - 1, edits, metrics["chunksParsed"],
+         metrics["chunksRelexed"], metrics["chunksReused"]))
+print("  server reparse total %.2f ms, lint total %.2f ms, latency p50 %.1f ms"
+      % (metrics["reparseMs"], metrics["lintMs"], metrics["latencyMs"]["p50"]))
+PY
+}
+
+echo -e "${BOLD}LSP edit benchmark${RESET} (${LINES} lines, ${EDITS} keystrokes)"
+echo -e "${CYAN}Synchronous diagnostics (SAGE_LSP_DEBOUNCE_MS=0)${RESET}"
+run_pass 0
+echo -e "${CYAN}Debounced diagnostics (default)${RESET}"
+run_pass 150
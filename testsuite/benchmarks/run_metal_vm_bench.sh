@@ -0,0 +1,207 @@
+#!/bin/bash
+## run_metal_vm_bench.sh — Compare MetalVM dispatch modes in ops/s
+## Usage: bash benchmarks/run_metal_vm_bench.sh [iterations] [runs] [file.sgvm ...]
+##
+## Builds a host driver against src/c/metal_vm.c twice: direct-threaded
+## (computed goto) and token-threaded (-DMETAL_VM_TOKEN_THREADED). Each
+## .sgvm program is first single-stepped with metal_vm_step to count the
+## bytecode ops it executes, then timed through a plain metal_vm_step loop
+## (the old dispatch) and through metal_vm_run in both builds. The value left
+## on the stack must match the stepped run, so a broken fast path cannot
+## report a fast time. Without file arguments, loop, branch and
+## array programs are assembled here.
+
+set -e
+
+CORE="$(cd "$(dirname "$0")/../../core" && pwd)"
+ITERS="${1:-1000000}"
+RUNS="${2:-5}"
+shift 2 2>/dev/null || shift $#
+CC="${CC:-cc}"
+TMPDIR="/tmp/sage_metal_vm_bench_$$"
+mkdir -p "$TMPDIR"
+trap 'rm -rf "$TMPDIR"' EXIT
+
+GREEN='\033[0;32m'
+CYAN='\033[0;36m'
+DIM='\033[0;90m'
+BOLD='\033[1m'
+RESET='\033[0m'
+
+cat > "$TMPDIR/driver.c" <<'C'
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "metal_vm.h"
+
+static MetalVM vm;
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Load every chunk of the binary and run it; the result is the stack top
+static int load(const unsigned char* data, long size) {
+    metal_vm_init(&vm);
+    if (metal_vm_load_binary(&vm, data, (int)size) < 0 || metal_vm_verify(&vm) < 0) return 0;
+    return 1;
+}
+
+static double result(void) {
+    return vm.sp > 0 && vm.stack[vm.sp - 1].type == MV_NUM ? vm.stack[vm.sp - 1].as.number : -1.0;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) return 2;
+    int runs = atoi(argv[2]);
+    FILE* f = fopen(argv[1], "rb");
+    if (!f) return 2;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    unsigned char* data = malloc(size);
+    if (!data || fread(data, 1, size, f) != (size_t)size) return 2;
+    fclose(f);
+
+    // Reference: count ops with the stepping interpreter
+    long long ops = 0;
+    if (!load(data, size)) return 3;
+    for (int c = 0; c < vm.chunk_count; c++) {
+        metal_vm_load(&vm, vm.chunks[c], vm.chunk_lengths[c]);
+        while (metal_vm_step(&vm)) ops++;
+        ops++;
+    }
+    double expected = result();
+
+    // mode 0 steps one op per call, as metal_vm_run did before threading
+    double best[2] = {0, 0};
+    for (int mode = 0; mode < 2; mode++) {
+        for (int r = 0; r < runs; r++) {
+            if (!load(data, size)) return 3;
+            double start = now();
+            for (int c = 0; c < vm.chunk_count; c++) {
+                metal_vm_load(&vm, vm.chunks[c], vm.chunk_lengths[c]);
+                if (mode == 0) while (metal_vm_step(&vm)) {}
+                else metal_vm_run(&vm);
+            }
+            double elapsed = now() - start;
+            if (result() != expected || vm.error) {
+                fprintf(stderr, "result %g, expected %g\n", result(), expected);
+                return 1;
+            }
+            if (best[mode] == 0 || elapsed < best[mode]) best[mode] = elapsed;
+        }
+    }
+    printf("%lld %.1f %.1f\n", ops, ops / best[0] / 1e6, ops / best[1] / 1e6);
+    return 0;
+}
+C
+
+"$CC" -std=c11 -O2 -I"$CORE/include" "$TMPDIR/driver.c" "$CORE/src/c/metal_vm.c" \
+    -o "$TMPDIR/direct"
+"$CC" -std=c11 -O2 -DMETAL_VM_TOKEN_THREADED -I"$CORE/include" "$TMPDIR/driver.c" \
+    "$CORE/src/c/metal_vm.c" -o "$TMPDIR/token"
+
+if [ $# -gt 0 ]; then
+    PROGRAMS=("$@")
+else
+    python3 - "$ITERS" "$TMPDIR" <<'PY'
+import struct, sys
+iters, out = int(sys.argv[1]), sys.argv[2]
+OP = dict(CONSTANT=0, POP=4, GET_GLOBAL=5, DEFINE_GLOBAL=6, SET_GLOBAL=7, GET_INDEX=11,
+          ADD=15, SUB=16, MUL=17, GREATER_EQUAL=24, LESS=25, JUMP=35, JUMP_IF_FALSE=36,
+          ARRAY=39, LOOP_BACK=51, HALT=0xFF)
+
+class Asm:
+    def __init__(self):
+        self.consts, self.code, self.labels, self.fixups = [], bytearray(), {}, []
+    def const(self, v):
+        if v not in self.consts: self.consts.append(v)
+        return self.consts.index(v)
+    def op(self, name, *args):
+        self.code.append(OP[name])
+        for a in args:
+            if isinstance(a, str) and a.startswith("@"):
+                self.fixups.append((len(self.code), name, a[1:]))
+                a = 0
+            elif isinstance(a, str) or isinstance(a, float):
+                a = self.const(a)
+            self.code += struct.pack(">H", a)
+        return self
+    def label(self, name): self.labels[name] = len(self.code)
+    def build(self):
+        for pos, name, label in self.fixups:
+            target = self.labels[label]
+            value = pos + 2 - target if name == "LOOP_BACK" else target
+            self.code[pos:pos + 2] = struct.pack(">H", value)
+        data = b"SGVM\x01\x00" + struct.pack(">H", len(self.consts))
+        for c in self.consts:
+            if isinstance(c, str):
+                data += b"\x03" + struct.pack(">H", len(c)) + c.encode()
+            else:
+                data += b"\x01" + struct.pack(">d", c)
+        return data + struct.pack(">II", 1, len(self.code)) + bytes(self.code)
+
+def counted_loop(a, body):
+    a.op("CONSTANT", 0.0).op("DEFINE_GLOBAL", "i")
+    a.label("top")
+    a.op("GET_GLOBAL", "i").op("CONSTANT", float(iters)).op("LESS").op("JUMP_IF_FALSE", "@end")
+    body(a)
+    a.op("GET_GLOBAL", "i").op("CONSTANT", 1.0).op("ADD").op("SET_GLOBAL", "i")
+    a.op("LOOP_BACK", "@top")
+    a.label("end")
+
+# s = s + i * 3
+loop = Asm()
+loop.op("CONSTANT", 0.0).op("DEFINE_GLOBAL", "s")
+counted_loop(loop, lambda a: a.op("GET_GLOBAL", "s").op("GET_GLOBAL", "i").op("CONSTANT", 3.0)
+             .op("MUL").op("ADD").op("SET_GLOBAL", "s"))
+loop.op("GET_GLOBAL", "s").op("HALT")
+
+# if i - 5 >= 0: c = c + 1 else: c = c - 1
+def branch_body(a):
+    a.op("GET_GLOBAL", "i").op("CONSTANT", 5.0).op("SUB").op("CONSTANT", 0.0)
+    a.op("GREATER_EQUAL").op("JUMP_IF_FALSE", "@else")
+    a.op("GET_GLOBAL", "c").op("CONSTANT", 1.0).op("ADD").op("SET_GLOBAL", "c").op("JUMP", "@join")
+    a.label("else")
+    a.op("GET_GLOBAL", "c").op("CONSTANT", 1.0).op("SUB").op("SET_GLOBAL", "c")
+    a.label("join")
+branch = Asm()
+branch.op("CONSTANT", 0.0).op("DEFINE_GLOBAL", "c")
+counted_loop(branch, branch_body)
+branch.op("GET_GLOBAL", "c").op("HALT")
+
+# s = s + xs[2] + xs[5]
+array = Asm()
+for v in range(8): array.op("CONSTANT", float(v * v))
+array.op("ARRAY", 8).op("DEFINE_GLOBAL", "xs").op("CONSTANT", 0.0).op("DEFINE_GLOBAL", "s")
+counted_loop(array, lambda a: a.op("GET_GLOBAL", "s").op("GET_GLOBAL", "xs").op("CONSTANT", 2.0)
+             .op("GET_INDEX").op("ADD").op("GET_GLOBAL", "xs").op("CONSTANT", 5.0).op("GET_INDEX")
+             .op("ADD").op("SET_GLOBAL", "s"))
+array.op("GET_GLOBAL", "s").op("HALT")
+
+for name, a in (("loop", loop), ("branch", branch), ("array", array)):
+    open(f"{out}/{name}.sgvm", "wb").write(a.build())
+PY
+    PROGRAMS=("$TMPDIR/loop.sgvm" "$TMPDIR/branch.sgvm" "$TMPDIR/array.sgvm")
+fi
+
+printf "\n${BOLD}  SageLang MetalVM Dispatch Benchmark${RESET}\n"
+printf "  ${DIM}best of %d runs, millions of bytecode ops per second${RESET}\n" "$RUNS"
+printf "  ${DIM}───────────────────────────────────────────────${RESET}\n\n"
+printf "  ${DIM}%-14s %12s %8s %8s %8s${RESET}\n" "program" "ops" "step" "token" "direct"
+
+for prog in "${PROGRAMS[@]}"; do
+    direct=$("$TMPDIR/direct" "$prog" "$RUNS")
+    token=$("$TMPDIR/token" "$prog" "$RUNS")
+    set -- $direct
+    ops=$1 step=$2 direct=$3
+    set -- $token
+    token=$3
+    printf "  ${CYAN}%-14s${RESET} %12d ${GREEN}%8s %8s %8s${RESET}\n" \
+        "$(basename "$prog" .sgvm)" "$ops" "$step" "$token" "$direct"
+done
+printf "\n"
@@ -0,0 +1,84 @@
+#!/bin/bash
+## run_rv64_bench.sh — Measure MetalRV64 VM throughput (MIPS) with sgvm
+## Usage: bash benchmarks/run_rv64_bench.sh [iterations] [runs]
+##
+## Assembles an .sgrv loop of ALU, multiply, load/store and branch
+## instructions, runs it under sgvm and reports retired instructions per
+## second. The loop sum is checked so a broken VM cannot report a fast time.
+
+set -e
+
+SGVM="$(cd "$(dirname "$0")/../../core" && pwd)/sgvm"
+ITERS="${1:-4000000}"
+RUNS="${2:-5}"
+TMPDIR="/tmp/sage_rv64_bench_$$"
+mkdir -p "$TMPDIR"
+trap 'rm -rf "$TMPDIR"' EXIT
+
+GREEN='\033[0;32m'
+CYAN='\033[0;36m'
+DIM='\033[0;90m'
+BOLD='\033[1m'
+RESET='\033[0m'
+
+PROG="$TMPDIR/loop.sgrv"
+python3 - "$ITERS" "$PROG" <<'PY'
+import struct, sys
+iters, path = int(sys.argv[1]), sys.argv[2]
+def r(rd, f3, rs1, rs2, f7): return 0x33 | rd << 7 | f3 << 12 | rs1 << 15 | rs2 << 20 | f7 << 25
+def i(op, rd, f3, rs1, imm): return op | rd << 7 | f3 << 12 | rs1 << 15 | (imm & 0xFFF) << 20
+def s(rs1, rs2, imm): return 0x23 | (imm & 0x1F) << 7 | 3 << 12 | rs1 << 15 | rs2 << 20 | (imm >> 5) << 25
+def b(f3, rs1, rs2, imm):
+    imm &= 0x1FFF
+    return (0x63 | ((imm >> 11) & 1) << 7 | ((imm >> 1) & 0xF) << 8 | f3 << 12 | rs1 << 15 |
+            rs2 << 20 | ((imm >> 5) & 0x3F) << 25 | ((imm >> 12) & 1) << 31)
+code = [
+    i(0x13, 5, 0, 0, 0),        # x5 = 0        sum
+    i(0x13, 6, 0, 0, 0),        # x6 = 0        i
+    0x5B | 7 << 7,              # x7 = const 0  iterations
+    r(8, 0, 6, 6, 1),           # loop: x8 = i * i
+    s(0, 8, 1),                 # stack[1] = x8
+    i(0x03, 9, 3, 0, 1),        # x9 = stack[1]
+    r(9, 7, 9, 6, 0),           # x9 &= i
+    r(5, 0, 5, 9, 0),           # sum += x9
+    i(0x13, 6, 0, 6, 1),        # i += 1
+    b(4, 6, 7, -24),            # if i < n goto loop
+    i(0x13, 10, 0, 5, 0),       # a0 = sum
+    i(0x73, 0, 0, 9, 0),        # print a0
+    i(0x73, 0, 0, 1, 0),        # halt
+]
+out = b"SGRV\x00\x01" + struct.pack(">H", 1) + b"\x01" + struct.pack(">d", float(iters))
+out += struct.pack(">I", 1) + struct.pack(">I", 4 * len(code))
+out += b"".join(struct.pack("<I", w) for w in code)
+open(path, "wb").write(out)
+PY
+
+EXPECTED=$(python3 -c "print(sum((k * k) & k for k in range($ITERS)))")
+INSTRUCTIONS=$(( 3 + 7 * ITERS + 3 ))
+
+now_ns() {
+    date +%s%N 2>/dev/null || python3 -c 'import time; print(int(time.time()*1e9))'
+}
+
+OUT=$("$SGVM" "$PROG")
+if [ "$OUT" != "$EXPECTED" ]; then
+    echo "sgvm printed '$OUT', expected '$EXPECTED'" >&2
+    exit 1
+fi
+
+BEST_US=0
+for _ in $(seq 1 "$RUNS"); do
+    start=$(now_ns)
+    "$SGVM" "$PROG" > /dev/null
+    end=$(now_ns)
+    us=$(( (end - start) / 1000 ))
+    if [ "$BEST_US" -eq 0 ] || [ "$us" -lt "$BEST_US" ]; then BEST_US=$us; fi
+done
+
+printf "\n${BOLD}  SageLang MetalRV64 VM Benchmark${RESET}\n"
+printf "  ${DIM}%d iterations, %d instructions, best of %d runs${RESET}\n" "$ITERS" "$INSTRUCTIONS" "$RUNS"
+printf "  ${DIM}───────────────────────────────────────────────${RESET}\n\n"
+printf "  ${CYAN}%-24s${RESET}${GREEN}%8d us${RESET}\n" "run time" "$BEST_US"
+if [ "$BEST_US" -gt 0 ]; then
+    printf "  ${CYAN}%-24s${RESET}${GREEN}%8d${RESET}\n\n" "MIPS" $(( INSTRUCTIONS / BEST_US ))
+fi
@@ -0,0 +1,132 @@
+#!/bin/bash
+## run_vecindex_bench.sh — Recall@10 and QPS for the native _vecindex module
+## Usage: bash benchmarks/run_vecindex_bench.sh [count] [dim] [queries] [metric]
+##
+## Generates a clustered f32 dataset (numpy when available), loads it into a
+## flat index for exact ground truth and into an HNSW index (M=16,
+## efConstruction=200), then sweeps efSearch. QPS is measured single
+## threaded and with one thread per CPU through search_batch. The HNSW
+## index is saved, mapped back with load() and must return the same top
+## hits. Defaults are sized for a quick run; 100000 768 1000 is the full one.
+
+set -e
+
+CORE="$(cd "$(dirname "$0")/../../core" && pwd)"
+COUNT="${1:-20000}"
+DIM="${2:-128}"
+QUERIES="${3:-500}"
+METRIC="${4:-cosine}"
+SAGE="${SAGE:-$CORE/sage}"
+TMPDIR="/tmp/sage_vecindex_bench_$$"
+mkdir -p "$TMPDIR"
+trap 'rm -rf "$TMPDIR"' EXIT
+
+BOLD='\033[1m'
+DIM_C='\033[0;90m'
+RESET='\033[0m'
+
+python3 - "$COUNT" "$DIM" "$QUERIES" "$TMPDIR" <<'PY'
+import random, sys
+from array import array
+count, dim, nq, out = int(sys.argv[1]), int(sys.argv[2]), int(sys.argv[3]), sys.argv[4]
+clusters = max(8, count // 500)
+try:
+    import numpy as np
+    rng = np.random.default_rng(7)
+    centers = rng.standard_normal((clusters, dim)).astype(np.float32)
+    def points(n):
+        pick = rng.integers(0, clusters, n)
+        return (centers[pick] + 0.5 * rng.standard_normal((n, dim))).astype(np.float32).tobytes()
+except ImportError:
+    rnd = random.Random(7)
+    centers = [[rnd.gauss(0, 1) for _ in range(dim)] for _ in range(clusters)]
+    def points(n):
+        buf = array("f")
+        for _ in range(n):
+            c = centers[rnd.randrange(clusters)]
+            buf.extend(x + 0.5 * rnd.gauss(0, 1) for x in c)
+        return buf.tobytes()
+open(f"{out}/base.f32", "wb").write(points(count))
+open(f"{out}/query.f32", "wb").write(points(nq))
+PY
+
+cat > "$TMPDIR/bench.sage" <<SAGE
+gc_disable()
+import io
+import math
+import _vecindex
+
+let dim = $DIM
+let base = io.mmap("$TMPDIR/base.f32")
+let queries = io.mmap("$TMPDIR/query.f32")
+let nq = $QUERIES
+
+proc recall(found, truth):
+    let hits = 0
+    for q in range(len(truth)):
+        let want = {}
+        for i in range(len(truth[q])):
+            want[str(truth[q][i][0])] = true
+        for i in range(len(found[q])):
+            if dict_has(want, str(found[q][i][0])):
+                hits = hits + 1
+    return hits / (len(truth) * 10)
+
+proc qps(seconds):
+    if seconds <= 0:
+        return "-"
+    return str(math.round(nq / seconds))
+
+proc row(label, r, t1, tn):
+    print label + "|" + str(math.round(r * 1000) / 1000) + "|" + qps(t1) + "|" + qps(tn)
+
+let flat = _vecindex.create(dim, "$METRIC")
+_vecindex.add(flat, base)
+let t = clock()
+let truth = _vecindex.search_batch(flat, queries, 10, 0, 1)
+let t1 = clock() - t
+t = clock()
+_vecindex.search_batch(flat, queries, 10)
+row("flat", 1, t1, clock() - t)
+
+let hnsw = _vecindex.create(dim, "$METRIC", {"kind": "hnsw", "M": 16, "ef_construction": 200})
+t = clock()
+_vecindex.add(hnsw, base)
+print "build|" + str(math.round((clock() - t) * 100) / 100) + "|" + str(_vecindex.stats(hnsw)["levels"]) + "|" + _vecindex.stats(hnsw)["kernel"]
+
+let efs = [10, 16, 32, 64, 128, 256]
+let last = nil
+for i in range(len(efs)):
+    t = clock()
+    let found = _vecindex.search_batch(hnsw, queries, 10, efs[i], 1)
+    t1 = clock() - t
+    t = clock()
+    last = _vecindex.search_batch(hnsw, queries, 10, efs[i])
+    let tn = clock() - t
+    row("hnsw ef=" + str(efs[i]), recall(found, truth), t1, tn)
+
+_vecindex.save(hnsw, "$TMPDIR/index.vec")
+t = clock()
+let loaded = _vecindex.load("$TMPDIR/index.vec")
+let load_time = clock() - t
+let again = _vecindex.search_batch(loaded, queries, 10, 256)
+let same = _vecindex.stats(loaded)["mapped"]
+for q in range(nq):
+    if len(again[q]) != len(last[q]) or again[q][0][0] != last[q][0][0]:
+        same = false
+print "load|" + str(math.round(load_time * 100000) / 100) + "|" + str(same)
+SAGE
+
+printf "\n${BOLD}  SageLang Vector Index Benchmark${RESET}\n"
+printf "  ${DIM_C}%d x %d-dim %s vectors, %d queries, k=10, %d CPUs${RESET}\n" \
+    "$COUNT" "$DIM" "$METRIC" "$QUERIES" "$(nproc 2>/dev/null || echo 1)"
+printf "  ${DIM_C}───────────────────────────────────────────────${RESET}\n\n"
+printf "  ${DIM_C}%-16s %10s %12s %12s${RESET}\n" "index" "recall@10" "QPS 1 thr" "QPS all"
+
+"$SAGE" "$TMPDIR/bench.sage" | while IFS='|' read -r label a b c; do
+    case "$label" in
+        build) printf "\n  HNSW build: %ss, %s layers, %s kernels\n" "$a" "$b" "$c" ;;
+        load) printf "  load(): %s ms, mapped results match: %s\n\n" "$a" "$b" ;;
+        *) printf "  %-16s %10s %12s %12s\n" "$label" "$a" "$b" "$c" ;;
+    esac
+done
@@ -0,0 +1,72 @@
+#!/bin/bash
+## run_vm_load_bench.sh — Compare VM artifact load time: binary (SAGEBC2) vs hex text (SAGEBC1)
+## Usage: bash benchmarks/run_vm_load_bench.sh [functions] [runs]
+##
+## Generates a program of large functions full of string and number constants
+## that are never called, emits it in both artifact formats, then times
+## `sage --run-vm` on each. Almost nothing executes, so the timings are
+## process startup plus artifact loading; an empty artifact is timed as well
+## so the load cost can be read off directly.
+
+set -e
+
+SAGE="$(cd "$(dirname "$0")/../../core" && pwd)/sage"
+FUNCS="${1:-200}"
+RUNS="${2:-10}"
+TMPDIR="/tmp/sage_vm_load_$$"
+mkdir -p "$TMPDIR"
+trap 'rm -rf "$TMPDIR"' EXIT
+
+GREEN='\033[0;32m'
+CYAN='\033[0;36m'
+DIM='\033[0;90m'
+BOLD='\033[1m'
+RESET='\033[0m'
+
+SRC="$TMPDIR/load.sage"
+{
+    for i in $(seq 1 "$FUNCS"); do
+        printf 'proc f%d(a):\n' "$i"
+        for j in $(seq 1 100); do
+            printf '    print "function %d, generated line %d" + str(a * %d.5)\n' "$i" "$j" "$j"
+        done
+        printf '\n'
+    done
+    printf 'print 1\n'
+} > "$SRC"
+printf 'print 1\n' > "$TMPDIR/empty.sage"
+
+"$SAGE" --emit-vm "$SRC" -o "$TMPDIR/load.bin.svm" > /dev/null
+"$SAGE" --emit-vm-text "$SRC" -o "$TMPDIR/load.txt.svm" > /dev/null
+"$SAGE" --emit-vm "$TMPDIR/empty.sage" -o "$TMPDIR/empty.svm" > /dev/null
+
+now_ns() {
+    date +%s%N 2>/dev/null || python3 -c 'import time; print(int(time.time()*1e9))'
+}
+
+time_runs() {
+    local artifact="$1"
+    local start=$(now_ns)
+    for _ in $(seq 1 "$RUNS"); do
+        "$SAGE" --run-vm "$artifact" > /dev/null
+    done
+    local end=$(now_ns)
+    echo $(( (end - start) / RUNS / 1000 ))
+}
+
+printf "\n${BOLD}  SageLang VM Artifact Load Benchmark${RESET}\n"
+printf "  ${DIM}%d functions, %d runs each${RESET}\n" "$FUNCS" "$RUNS"
+printf "  ${DIM}───────────────────────────────────────────────${RESET}\n\n"
+
+BASE_US=$(time_runs "$TMPDIR/empty.svm")
+TEXT_US=$(( $(time_runs "$TMPDIR/load.txt.svm") - BASE_US ))
+BIN_US=$(( $(time_runs "$TMPDIR/load.bin.svm") - BASE_US ))
+TEXT_SIZE=$(wc -c < "$TMPDIR/load.txt.svm")
+BIN_SIZE=$(wc -c < "$TMPDIR/load.bin.svm")
+
+printf "  ${CYAN}%-24s${RESET}${GREEN}%8d us${RESET}  ${DIM}(subtracted below)${RESET}\n" "startup (empty)" "$BASE_US"
+printf "  ${CYAN}%-24s${RESET}${GREEN}%8d us${RESET}  ${DIM}(%d bytes)${RESET}\n" "text (SAGEBC1)" "$TEXT_US" "$TEXT_SIZE"
+printf "  ${CYAN}%-24s${RESET}${GREEN}%8d us${RESET}  ${DIM}(%d bytes)${RESET}\n" "binary (SAGEBC2)" "$BIN_US" "$BIN_SIZE"
+if [ "$BIN_US" -gt 0 ]; then
+    printf "\n  ${BOLD}load speedup: %d.%02dx${RESET}\n\n" $(( TEXT_US / BIN_US )) $(( TEXT_US * 100 / BIN_US % 100 ))
+fi
@@ -0,0 +1,149 @@
+// metal_vm_tables.c — MetalVM string interning, dict growth and heap compaction
+//
+// Covers dicts growing past the METAL_DICT_MAX_ENTRIES inline entries into
+// heap spill blocks, lookups after each index rehash, string identity before
+// and after the intern index fills up, and a collection that frees one dict
+// and slides the blocks of the live ones down without breaking them.
+//
+// Built and run by testsuite/run_all.sh (compiler suite) against the VM
+// sources in core/src/c.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "metal_vm.h"
+
+#define KEYS 300
+
+static MetalVM vm;
+static int failures;
+
+#define CHECK(cond, ...) \
+    do { \
+        if (!(cond)) { \
+            fprintf(stderr, "metal_vm_tables: " __VA_ARGS__); \
+            fputc('\n', stderr); \
+            failures++; \
+        } \
+    } while (0)
+
+static int intern_key(const char* prefix, int n) {
+    char text[32];
+    int len = snprintf(text, sizeof(text), "%s%d", prefix, n);
+    return metal_string_intern(&vm, text, len);
+}
+
+static MetalValue dict_value(int dict_idx) {
+    MetalValue v = mv_nil();
+    v.type = MV_DICT;
+    v.as.dict_idx = dict_idx;
+    return v;
+}
+
+// Every key of `prefix` 0..count-1 maps to base + n
+static void check_dict(int dict_idx, const char* prefix, int count, int base, const char* when) {
+    CHECK(vm.dicts[dict_idx].count == count, "%s: dict %d has %d entries, expected %d",
+          when, dict_idx, vm.dicts[dict_idx].count, count);
+    for (int n = 0; n < count; n++) {
+        MetalValue v = metal_dict_get(&vm, dict_idx, intern_key(prefix, n));
+        if (v.type != MV_NUM || v.as.number != (double)(base + n)) {
+            CHECK(0, "%s: %s%d in dict %d lost its value", when, prefix, n, dict_idx);
+            return;
+        }
+    }
+    CHECK(metal_dict_get(&vm, dict_idx, intern_key("absent", 0)).type == MV_NIL,
+          "%s: missing key found in dict %d", when, dict_idx);
+}
+
+static void test_interning(void) {
+    int a = metal_string_intern(&vm, "alpha", 5);
+    int b = metal_string_intern(&vm, "beta", 4);
+    CHECK(a >= 0 && b >= 0 && a != b, "distinct strings share an index");
+    CHECK(metal_string_intern(&vm, "alpha", 5) == a, "re-interning alpha moved it");
+    CHECK(metal_string_intern(&vm, "alphabet", 5) == a, "a prefix of a longer text is not alpha");
+    CHECK(metal_string_intern(&vm, "alp", 3) != a, "alp matched alpha");
+    CHECK(strcmp(metal_string_get(&vm, a), "alpha") == 0, "alpha reads back wrong");
+
+    // Past 3/4 of the index new strings are found by scanning the pool
+    int first[8], last[8];
+    for (int i = 0; i < 8; i++) first[i] = intern_key("s", i);
+    for (int i = 8; i < METAL_STRING_INDEX; i++) intern_key("s", i);
+    for (int i = 0; i < 8; i++) last[i] = intern_key("s", METAL_STRING_INDEX - 8 + i);
+    CHECK(vm.string_index.count * 4 >= METAL_STRING_INDEX * 3, "intern index never filled");
+    for (int i = 0; i < 8; i++) {
+        CHECK(intern_key("s", i) == first[i], "indexed string s%d moved", i);
+        CHECK(intern_key("s", METAL_STRING_INDEX - 8 + i) == last[i],
+              "unindexed string s%d moved", METAL_STRING_INDEX - 8 + i);
+    }
+    CHECK(metal_string_intern(&vm, "alpha", 5) == a, "alpha moved once the index filled");
+}
+
+static void test_growth(void) {
+    int d = metal_dict_new(&vm);
+    CHECK(d >= 0, "no dict available");
+    int last_mask = 0;
+    for (int n = 0; n < KEYS; n++) {
+        metal_dict_set(&vm, d, intern_key("g", n), mv_num((double)n));
+        if (vm.dicts[d].index_mask != last_mask) {
+            // The index was just rebuilt: every key so far must still resolve
+            last_mask = vm.dicts[d].index_mask;
+            check_dict(d, "g", n + 1, 0, "after rehash");
+        }
+    }
+    CHECK(vm.dicts[d].spill >= 0, "dict never spilled past %d entries", METAL_DICT_MAX_ENTRIES);
+    CHECK(vm.dicts[d].index >= 0, "dict has no index");
+    check_dict(d, "g", KEYS, 0, "after growth");
+
+    // Overwrites update in place, inline and spilled alike
+    for (int n = 0; n < KEYS; n++) metal_dict_set(&vm, d, intern_key("g", n), mv_num((double)(1000 + n)));
+    check_dict(d, "g", KEYS, 1000, "after overwrite");
+}
+
+static void test_compaction(void) {
+    metal_vm_init(&vm);
+    int garbage = metal_dict_new(&vm);
+    int live = metal_dict_new(&vm);
+    int nested = metal_dict_new(&vm);
+    // Interleave the inserts so the three dicts' heap blocks alternate
+    for (int n = 0; n < KEYS; n++) {
+        metal_dict_set(&vm, garbage, intern_key("x", n), mv_num((double)n));
+        metal_dict_set(&vm, live, intern_key("l", n), mv_num((double)n));
+        metal_dict_set(&vm, nested, intern_key("m", n), mv_num((double)(5000 + n)));
+    }
+    metal_dict_set(&vm, live, intern_key("child", 0), dict_value(nested));
+    metal_vm_push(&vm, dict_value(live));
+
+    int before = vm.heap_used;
+    int live_spill = vm.dicts[live].spill;
+    metal_vm_gc(&vm);
+    CHECK(!vm.dicts[garbage].in_use, "unreachable dict survived collection");
+    CHECK(vm.dicts[live].in_use && vm.dicts[nested].in_use, "reachable dict was swept");
+    CHECK(vm.heap_used < before, "compaction reclaimed nothing (%d -> %d bytes)", before, vm.heap_used);
+    CHECK(vm.dicts[live].spill <= live_spill, "live spill block moved up");
+
+    check_dict(nested, "m", KEYS, 5000, "after compaction");
+    MetalValue child = metal_dict_get(&vm, live, intern_key("child", 0));
+    CHECK(child.type == MV_DICT && child.as.dict_idx == nested, "child reference broken by compaction");
+    for (int n = 0; n < KEYS; n++) {
+        MetalValue v = metal_dict_get(&vm, live, intern_key("l", n));
+        if (v.type != MV_NUM || v.as.number != (double)n) {
+            CHECK(0, "after compaction: l%d lost its value", n);
+            break;
+        }
+    }
+
+    // The compacted blocks keep working as the dict grows again
+    for (int n = KEYS; n < 2 * KEYS; n++) metal_dict_set(&vm, nested, intern_key("m", n), mv_num((double)(5000 + n)));
+    check_dict(nested, "m", 2 * KEYS, 5000, "growth after compaction");
+}
+
+int main(void) {
+    metal_vm_init(&vm);
+    test_interning();
+    metal_vm_init(&vm);
+    test_growth();
+    test_compaction();
+    if (failures) return 1;
+    printf("metal vm tables ok\n");
+    return 0;
+}
@@ -0,0 +1,368 @@
+// metal_vm_threaded_diff.c — Differential test for the MetalVM threaded path
+//
+// Generates random programs from globals, arithmetic, comparisons, arrays,
+// if/else, counted loops and forward jumps (some landing inside what the
+// translator fuses into a superinstruction), plus stray ops that underflow
+// the stack or take the values the fast path hands back to the stepper. Each
+// program runs through metal_vm_run (pre-decoded, threaded) and through
+// metal_vm_step one instruction at a time; both must leave the same stack,
+// globals, ip and status.
+//
+// Built and run twice by testsuite/run_all.sh (compiler suite): once with
+// computed-goto dispatch and once with -DMETAL_VM_TOKEN_THREADED.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "metal_vm.h"
+
+#define PROGRAMS   3000
+#define MAX_CODE   2048
+#define MAX_MARKS  1024
+#define MAX_SKIPS  64
+#define GLOBALS    5
+#define MAX_LOOPS  3
+
+static MetalVM stepped, threaded;
+
+static unsigned long long rng_state = 0x2545F4914F6CDD1DULL;
+
+static unsigned int rnd(unsigned int n) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return (unsigned int)(rng_state % n);
+}
+
+// Constant pool shared by every program: global names, loop counters,
+// numbers (zero, negatives, fractions, an overflow to inf) and a string
+static const double numbers[] = { 0, 1, 2, 3, -1, 0.5, 7, -2.25, 100, 1e308 };
+#define NUMBERS ((int)(sizeof(numbers) / sizeof(numbers[0])))
+static int k_global[GLOBALS], k_counter[MAX_LOOPS], k_number[NUMBERS], k_string;
+
+static void setup(MetalVM* vm) {
+    char name[8];
+    metal_vm_init(vm);
+    for (int i = 0; i < GLOBALS; i++) {
+        int len = snprintf(name, sizeof(name), "g%d", i);
+        k_global[i] = metal_vm_add_constant(vm, mv_str(vm, name, len));
+    }
+    for (int i = 0; i < MAX_LOOPS; i++) {
+        int len = snprintf(name, sizeof(name), "c%d", i);
+        k_counter[i] = metal_vm_add_constant(vm, mv_str(vm, name, len));
+    }
+    for (int i = 0; i < NUMBERS; i++) k_number[i] = metal_vm_add_constant(vm, mv_num(numbers[i]));
+    k_string = metal_vm_add_constant(vm, mv_str(vm, "s", 1));
+}
+
+// ----------------------------------------------------------------------------
+// Program generator
+// ----------------------------------------------------------------------------
+
+static unsigned char code[MAX_CODE];
+static int code_len;
+
+// Instruction boundaries a forward jump may land on, tagged with the
+// innermost loop around them (0: none). Jumping into a loop from outside
+// would skip its counter reset, so a jump only targets its own loop or
+// top-level code.
+static struct { int pos, loop; } marks[MAX_MARKS];
+static int mark_count;
+static struct { int pos, loop; } skips[MAX_SKIPS];
+static int skip_count;
+static int loop_stack[MAX_LOOPS + 1], loop_depth, loop_ids;
+
+static void mark(void) {
+    if (mark_count < MAX_MARKS) {
+        marks[mark_count].pos = code_len;
+        marks[mark_count].loop = loop_stack[loop_depth];
+        mark_count++;
+    }
+}
+
+static void emit(int byte) {
+    code[code_len++] = (unsigned char)byte;
+}
+
+static void emit_op(int op, int operand) {
+    emit(op);
+    emit(operand >> 8);
+    emit(operand & 0xFF);
+}
+
+static void patch(int at, int value) {
+    code[at] = (unsigned char)(value >> 8);
+    code[at + 1] = (unsigned char)value;
+}
+
+static void leaf(void) {
+    switch (rnd(10)) {
+        case 0: emit(rnd(2) ? OP_TRUE : OP_FALSE); break;
+        case 1:
+            if (rnd(4)) emit(OP_NIL);
+            else emit_op(OP_CONSTANT, k_string);
+            break;
+        case 2: case 3: case 4:
+            emit_op(OP_GET_GLOBAL, k_global[rnd(GLOBALS)]);
+            break;
+        default:
+            emit_op(OP_CONSTANT, k_number[rnd(NUMBERS)]);
+            break;
+    }
+}
+
+static void expression(int depth) {
+    static const int binary[] = {
+        OP_ADD, OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_EQUAL, OP_NOT_EQUAL,
+        OP_GREATER, OP_GREATER_EQUAL, OP_LESS, OP_LESS_EQUAL,
+    };
+    int pick = depth > 0 ? (int)rnd(8) : 0;
+    if (pick <= 2) {
+        leaf();
+    } else if (pick <= 5) {
+        expression(depth - 1);
+        // A constant right operand forms CONSTANT k; ADD and friends
+        if (rnd(2)) emit_op(OP_CONSTANT, k_number[rnd(NUMBERS)]);
+        else expression(depth - 1);
+        emit(binary[rnd(sizeof(binary) / sizeof(binary[0]))]);
+    } else if (pick == 6) {
+        expression(depth - 1);
+        emit(rnd(2) ? OP_NEGATE : OP_NOT);
+    } else {
+        // [e, e, ...][i] with i sometimes out of range
+        int count = 1 + (int)rnd(3);
+        for (int i = 0; i < count; i++) expression(depth - 1);
+        emit_op(OP_ARRAY, count);
+        emit_op(OP_CONSTANT, k_number[rnd(5)]);
+        emit(OP_GET_INDEX);
+    }
+}
+
+static void block(int depth, int count);
+
+static void statement(int depth) {
+    mark();
+    switch (rnd(depth > 0 ? 12 : 7)) {
+        case 0: case 1:
+            expression(2);
+            emit_op(rnd(3) ? OP_SET_GLOBAL : OP_DEFINE_GLOBAL, k_global[rnd(GLOBALS)]);
+            break;
+        case 2: {
+            // g = g + k, fused into one superinstruction
+            int g = k_global[rnd(GLOBALS)];
+            emit_op(OP_GET_GLOBAL, g);
+            mark();
+            emit_op(OP_CONSTANT, k_number[rnd(NUMBERS)]);
+            mark();
+            emit(OP_ADD);
+            mark();
+            emit_op(OP_SET_GLOBAL, g);
+            break;
+        }
+        case 3:
+            expression(2);
+            emit(OP_POP);
+            break;
+        case 4: {
+            // Stray ops: may underflow, or meet values the fast path rejects
+            static const int stray[] = {
+                OP_POP, OP_DUP, OP_NEGATE, OP_NOT, OP_ADD, OP_SUB, OP_LESS, OP_GET_INDEX,
+            };
+            emit(stray[rnd(sizeof(stray) / sizeof(stray[0]))]);
+            break;
+        }
+        case 5:
+            if (skip_count < MAX_SKIPS && code_len + 3 <= MAX_CODE) {
+                skips[skip_count].pos = code_len;
+                skips[skip_count].loop = loop_stack[loop_depth];
+                skip_count++;
+                emit_op(OP_JUMP, 0);
+            }
+            break;
+        case 6:
+            // Rarely stop early: halt, an opcode the VM rejects, or x / 0
+            switch (rnd(12)) {
+                case 0: emit(OP_HALT); break;
+                case 1: emit(OP_PRINT); break;
+                case 2: leaf(); emit_op(OP_CONSTANT, k_number[0]); emit(OP_DIV); break;
+                default: emit(OP_NIL); emit(OP_POP); break;
+            }
+            break;
+        case 7: case 8: {
+            // if: cond JUMP_IF_FALSE else; then JUMP end; else: ...; end:
+            if (rnd(2)) {
+                expression(1);
+                expression(1);
+                emit(OP_EQUAL + (int)rnd(6));   // fused with the jump below
+            } else {
+                expression(2);
+            }
+            int to_else = code_len + 1;
+            emit_op(OP_JUMP_IF_FALSE, 0);
+            block(depth - 1, 1 + (int)rnd(3));
+            int to_end = code_len + 1;
+            emit_op(OP_JUMP, 0);
+            patch(to_else, code_len);
+            block(depth - 1, (int)rnd(3));
+            patch(to_end, code_len);
+            break;
+        }
+        default: {
+            // for c = 0; c < n; c = c + 1
+            if (loop_depth >= MAX_LOOPS) {
+                emit(OP_NIL);
+                emit(OP_POP);
+                break;
+            }
+            int counter = k_counter[loop_depth];
+            emit_op(OP_CONSTANT, k_number[0]);
+            emit_op(OP_SET_GLOBAL, counter);
+            loop_stack[++loop_depth] = ++loop_ids;
+            int top = code_len;
+            mark();
+            emit_op(OP_GET_GLOBAL, counter);
+            emit_op(OP_CONSTANT, k_number[1 + rnd(3)]);
+            emit(OP_LESS);
+            int to_end = code_len + 1;
+            emit_op(OP_JUMP_IF_FALSE, 0);
+            block(depth - 1, 1 + (int)rnd(4));
+            mark();
+            emit_op(OP_GET_GLOBAL, counter);
+            emit_op(OP_CONSTANT, k_number[1]);
+            emit(OP_ADD);
+            emit_op(OP_SET_GLOBAL, counter);
+            emit_op(OP_LOOP_BACK, code_len + 3 - top);
+            loop_depth--;
+            patch(to_end, code_len);
+            break;
+        }
+    }
+}
+
+static void block(int depth, int count) {
+    for (int i = 0; i < count && code_len < MAX_CODE - 256; i++) statement(depth);
+}
+
+static void build_program(void) {
+    code_len = 0;
+    mark_count = 0;
+    skip_count = 0;
+    loop_depth = 0;
+    loop_ids = 0;
+    loop_stack[0] = 0;
+
+    // Counters live in the outermost scope; DEFINE_GLOBAL in a loop body
+    // cannot shadow them because stray ops never push a scope
+    for (int i = 0; i < MAX_LOOPS; i++) {
+        emit_op(OP_CONSTANT, k_number[0]);
+        emit_op(OP_DEFINE_GLOBAL, k_counter[i]);
+    }
+    for (int i = 0; i < GLOBALS; i++) {
+        if (rnd(4) == 0) continue;   // Leave some undefined: reads give nil
+        emit_op(OP_CONSTANT, k_number[rnd(NUMBERS)]);
+        emit_op(OP_DEFINE_GLOBAL, k_global[i]);
+    }
+    block(3, 4 + (int)rnd(10));
+    mark();
+    if (rnd(2)) emit(OP_HALT);   // Otherwise run off the end
+
+    for (int s = 0; s < skip_count; s++) {
+        int options = 0;
+        for (int m = 0; m < mark_count; m++) {
+            if (marks[m].pos > skips[s].pos &&
+                (marks[m].loop == 0 || marks[m].loop == skips[s].loop)) options++;
+        }
+        int pick = (int)rnd((unsigned int)options), target = code_len;
+        for (int m = 0; m < mark_count; m++) {
+            if (marks[m].pos > skips[s].pos &&
+                (marks[m].loop == 0 || marks[m].loop == skips[s].loop) && pick-- == 0) {
+                target = marks[m].pos;
+                break;
+            }
+        }
+        patch(skips[s].pos + 1, target);
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Comparison
+// ----------------------------------------------------------------------------
+
+static int same_value(MetalVM* va, MetalValue a, MetalVM* vb, MetalValue b) {
+    if (a.type != b.type) return 0;
+    switch (a.type) {
+        case MV_NIL:  return 1;
+        case MV_BOOL: return !a.as.boolean == !b.as.boolean;
+        case MV_NUM:  return a.as.number == b.as.number ||
+                             (a.as.number != a.as.number && b.as.number != b.as.number);
+        case MV_STR:  return strcmp(metal_string_get(va, a.as.str_idx),
+                                    metal_string_get(vb, b.as.str_idx)) == 0;
+        case MV_ARR: {
+            MetalArray* x = &va->arrays[a.as.arr_idx];
+            MetalArray* y = &vb->arrays[b.as.arr_idx];
+            if (a.as.arr_idx != b.as.arr_idx || x->count != y->count) return 0;
+            for (int i = 0; i < x->count; i++)
+                if (!same_value(va, x->elems[i], vb, y->elems[i])) return 0;
+            return 1;
+        }
+        default:
+            return memcmp(&a.as, &b.as, sizeof(a.as)) == 0;
+    }
+}
+
+static const char* compare(void) {
+    if (stepped.halted != threaded.halted || stepped.error != threaded.error) return "status";
+    if (stepped.error && strcmp(stepped.error_msg, threaded.error_msg) != 0) return "error message";
+    if (stepped.ip != threaded.ip) return "ip";
+    if (stepped.sp != threaded.sp) return "stack depth";
+    for (int i = 0; i < stepped.sp; i++)
+        if (!same_value(&stepped, stepped.stack[i], &threaded, threaded.stack[i])) return "stack";
+    if (stepped.scope_depth != threaded.scope_depth) return "scope depth";
+    for (int d = 0; d <= stepped.scope_depth; d++) {
+        MetalScope* x = &stepped.scopes[d];
+        MetalScope* y = &threaded.scopes[d];
+        if (x->count != y->count) return "globals";
+        for (int i = 0; i < x->count; i++) {
+            if (x->name_hash[i] != y->name_hash[i] ||
+                !same_value(&stepped, x->values[i], &threaded, y->values[i])) return "globals";
+        }
+    }
+    return NULL;
+}
+
+static void dump(void) {
+    for (int i = 0; i < code_len; i++)
+        fprintf(stderr, "%02x%s", code[i], i % 24 == 23 ? "\n" : " ");
+    fputc('\n', stderr);
+}
+
+int main(void) {
+    int failures = 0;
+    for (int p = 0; p < PROGRAMS && failures < 5; p++) {
+        build_program();
+
+        setup(&stepped);
+        metal_vm_load(&stepped, code, code_len);
+        while (metal_vm_step(&stepped)) {}
+
+        setup(&threaded);
+        metal_vm_load(&threaded, code, code_len);
+        metal_vm_run(&threaded);
+
+        const char* why = compare();
+        if (why) {
+            fprintf(stderr, "program %d: %s differs (stepped ip %d sp %d, threaded ip %d sp %d)\n",
+                    p, why, stepped.ip, stepped.sp, threaded.ip, threaded.sp);
+            dump();
+            failures++;
+        }
+    }
+    if (failures) return 1;
+#ifdef METAL_VM_TOKEN_THREADED
+    printf("metal vm token-threaded/step agree on %d programs\n", PROGRAMS);
+#else
+    printf("metal vm threaded/step agree on %d programs\n", PROGRAMS);
+#endif
+    return 0;
+}
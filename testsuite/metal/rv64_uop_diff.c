@@ -0,0 +1,215 @@
+// rv64_uop_diff.c — Differential test for the MetalRV64 pre-decoded path
+//
+// Generates random straight-line programs with forward branches, runs each
+// through metal_rv64_vm_run (translated micro-ops) and through
+// metal_rv64_vm_step one instruction at a time, and checks that both leave
+// the same registers, memory stack, status and printed output.
+//
+// Built and run by testsuite/run_all.sh (compiler suite) against the VM
+// sources in core/src/c.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "metal_rv64_vm.h"
+
+#define PROGRAMS    3000
+#define BODY_LEN    40
+#define MAX_WORDS   (BODY_LEN + 64)
+#define OUT_SIZE    4096
+#define STACK_SLOTS 8
+
+static MetalRV64VM stepped, translated;
+static char out_buf[2][OUT_SIZE];
+static int out_len[2];
+static int out_sel;
+
+static void capture_char(char c) {
+    if (out_len[out_sel] < OUT_SIZE - 1) out_buf[out_sel][out_len[out_sel]++] = c;
+}
+
+static unsigned long long rng_state = 0x9E3779B97F4A7C15ULL;
+
+static unsigned int rnd(unsigned int n) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return (unsigned int)(rng_state % n);
+}
+
+// Mostly a handful of registers plus x0, so values flow between instructions
+static int reg(void) {
+    return rnd(4) == 0 ? 0 : 1 + (int)rnd(11);
+}
+
+static unsigned int enc_r(int f7, int rs2, int rs1, int f3, int rd) {
+    return RV_OP_REG | rd << 7 | f3 << 12 | rs1 << 15 | rs2 << 20 | (unsigned int)f7 << 25;
+}
+
+static unsigned int enc_i(int op, int rd, int f3, int rs1, int imm) {
+    return op | rd << 7 | f3 << 12 | rs1 << 15 | (unsigned int)(imm & 0xFFF) << 20;
+}
+
+static unsigned int enc_s(int rs1, int rs2, int imm) {
+    return RV_OP_STORE | (imm & 0x1F) << 7 | RV_F3_SD << 12 | rs1 << 15 | rs2 << 20 |
+           (unsigned int)((imm >> 5) & 0x7F) << 25;
+}
+
+static unsigned int enc_b(int f3, int rs1, int rs2, int imm) {
+    imm &= 0x1FFF;
+    return RV_OP_BRANCH | ((imm >> 11) & 1) << 7 | ((imm >> 1) & 0xF) << 8 | f3 << 12 |
+           rs1 << 15 | rs2 << 20 | (unsigned int)((imm >> 5) & 0x3F) << 25 |
+           (unsigned int)((imm >> 12) & 1) << 31;
+}
+
+static unsigned int enc_vm(int sub_op) {
+    return enc_i(RV_OP_VMSYS, 0, RV_F3_VM_OPS, sub_op, 0);
+}
+
+static unsigned int random_inst(int at, int len) {
+    static const int reg_ops[][2] = {
+        {0x00, RV_F3_ADD}, {0x20, RV_F3_ADD}, {0x01, RV_F3_ADD}, {0x00, RV_F3_AND},
+        {0x00, RV_F3_OR},  {0x00, RV_F3_XOR}, {0x00, RV_F3_SLT}, {0x00, RV_F3_SLL},
+        {0x00, RV_F3_SRL}, {0x20, RV_F3_SRL}, {0x01, RV_F3_XOR}, {0x01, RV_F3_OR},
+    };
+    static const int imm_ops[] = { RV_F3_ADD, RV_F3_SLT, RV_F3_XOR, RV_F3_OR, RV_F3_AND };
+    static const int branches[] = { RV_F3_BEQ, RV_F3_BNE, RV_F3_BLT, RV_F3_BGE, RV_F3_BLTU, RV_F3_BGEU };
+    int rd = reg();
+    switch (rnd(12)) {
+        case 0: case 1: {
+            const int* r = reg_ops[rnd(sizeof(reg_ops) / sizeof(reg_ops[0]))];
+            return enc_r(r[0], reg(), reg(), r[1], rd);
+        }
+        case 2: case 3:
+            // Includes the MOV forms addi rd, rs, 0 and addi rd, x0, 0
+            return enc_i(RV_OP_IMM, rd, RV_F3_ADD, reg(), rnd(3) == 0 ? 0 : (int)rnd(101) - 50);
+        case 4:
+            return enc_i(RV_OP_IMM, rd, imm_ops[rnd(5)], reg(), (int)rnd(31) - 15);
+        case 5: {
+            int f3 = rnd(2) ? RV_F3_SLL : RV_F3_SRL;
+            int sra = f3 == RV_F3_SRL && rnd(2) ? 0x400 : 0;
+            return enc_i(RV_OP_IMM, rd, f3, reg(), sra | (int)rnd(6));
+        }
+        case 6:
+            return RV_OP_LUI | rd << 7 | (rnd(16) << 12);
+        case 7:
+            return RV_OP_LDC | rd << 7;
+        case 8:
+            return enc_s(0, reg(), (int)rnd(STACK_SLOTS));
+        case 9:
+            return enc_i(RV_OP_LOAD, rd, RV_F3_LD, 0, (int)rnd(STACK_SLOTS));
+        case 10: {
+            // Forward only, so every program terminates
+            int skip = 1 + (int)rnd(5);
+            if (at + skip > len) skip = len - at;
+            return enc_b(branches[rnd(6)], reg(), reg(), skip * 4);
+        }
+        default:
+            return rnd(2) ? enc_vm(RV_VMO_NOP) : enc_vm(RV_VMO_PRINT);
+    }
+}
+
+static int build_program(unsigned char* out, unsigned int* words, int* word_count, int first) {
+    int n = 0;
+    int len = 1 + (int)rnd(BODY_LEN);
+    if (first) {
+        // nop; addi a0, x0, 0; print -- x0 read before any instruction wrote it
+        words[n++] = enc_i(RV_OP_IMM, 0, RV_F3_ADD, 0, 0);
+        words[n++] = enc_i(RV_OP_IMM, 10, RV_F3_ADD, 0, 0);
+        words[n++] = enc_vm(RV_VMO_PRINT);
+        len = 0;
+    }
+    for (int i = 0; i < len; i++) words[n++] = random_inst(i, len);
+    // Print every register the body may have written, then halt
+    for (int r = 0; r <= 11; r++) {
+        words[n++] = enc_i(RV_OP_IMM, 10, RV_F3_ADD, r, 0);
+        words[n++] = enc_vm(RV_VMO_PRINT);
+    }
+    words[n++] = enc_vm(RV_VMO_HALT);
+    *word_count = n;
+
+    int pos = 0;
+    memcpy(out, "SGRV\x00\x01", 6);
+    pos = 6;
+    out[pos++] = 0; out[pos++] = 1;              // one constant
+    out[pos++] = 1;                              // MV_NUM, big-endian double
+    union { double d; unsigned char b[8]; } k = { .d = 2.5 };
+    for (int j = 7; j >= 0; j--) out[pos++] = k.b[j];
+    out[pos++] = 0; out[pos++] = 0; out[pos++] = 0; out[pos++] = 1;  // one chunk
+    int code_len = n * 4;
+    out[pos++] = (unsigned char)(code_len >> 24); out[pos++] = (unsigned char)(code_len >> 16);
+    out[pos++] = (unsigned char)(code_len >> 8);  out[pos++] = (unsigned char)code_len;
+    for (int i = 0; i < n; i++)
+        for (int b = 0; b < 4; b++) out[pos++] = (unsigned char)(words[i] >> (8 * b));
+    return pos;
+}
+
+static void load(MetalRV64VM* vm, const unsigned char* image, int size) {
+    metal_rv64_vm_init(vm);
+    vm->write_char = capture_char;
+    if (metal_rv64_vm_load_binary(vm, image, size) != 0) {
+        fprintf(stderr, "rv64_uop_diff: generated image failed to load\n");
+        exit(2);
+    }
+    vm->current_chunk_idx = 0;
+    vm->bytecode = vm->chunks[0];
+    vm->bytecode_length = vm->chunk_lengths[0];
+    vm->pc = 0;
+}
+
+static int same_value(MetalValue a, MetalValue b) {
+    if (a.type != b.type) return 0;
+    if (a.type == MV_NUM) return a.as.number == b.as.number ||
+                                 (a.as.number != a.as.number && b.as.number != b.as.number);
+    if (a.type == MV_NIL) return 1;
+    return memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+static void dump(const unsigned int* words, int n) {
+    for (int i = 0; i < n; i++) fprintf(stderr, "  %3d: %08x\n", i * 4, words[i]);
+}
+
+int main(void) {
+    static unsigned char image[64 + MAX_WORDS * 4];
+    static unsigned int words[MAX_WORDS];
+    int failures = 0;
+
+    for (int p = 0; p < PROGRAMS && failures < 5; p++) {
+        int n;
+        int size = build_program(image, words, &n, p == 0);
+
+        out_sel = 0; out_len[0] = 0;
+        load(&stepped, image, size);
+        stepped.running = 1;
+        while (stepped.running && metal_rv64_vm_step(&stepped)) {}
+
+        out_sel = 1; out_len[1] = 0;
+        load(&translated, image, size);
+        metal_rv64_vm_run(&translated);
+
+        const char* why = NULL;
+        int bad_reg = -1;
+        for (int r = 0; r < 32 && !why; r++)
+            if (!same_value(stepped.x[r], translated.x[r])) { why = "register"; bad_reg = r; }
+        for (int s = 0; s < STACK_SLOTS && !why; s++)
+            if (!same_value(stepped.stack[s], translated.stack[s])) why = "stack";
+        if (!why && (stepped.halted != translated.halted || stepped.error != translated.error ||
+                     stepped.pc != translated.pc))
+            why = "status";
+        if (!why && (out_len[0] != out_len[1] || memcmp(out_buf[0], out_buf[1], out_len[0]) != 0))
+            why = "output";
+        if (why) {
+            out_buf[0][out_len[0]] = '\0';
+            out_buf[1][out_len[1]] = '\0';
+            fprintf(stderr, "program %d: %s differs", p, why);
+            if (bad_reg >= 0) fprintf(stderr, " (x%d)", bad_reg);
+            fprintf(stderr, "\n--- stepped:\n%s--- translated:\n%s", out_buf[0], out_buf[1]);
+            dump(words, n);
+            failures++;
+        }
+    }
+    if (failures) return 1;
+    printf("rv64 uop/step agree on %d programs\n", PROGRAMS);
+    return 0;
+}
@@ -24,6 +24,8 @@ UNIT_DIR="$SUITE_DIR/unit"
 COMPILER_DIR="$SUITE_DIR/compiler"
 SELFHOST_DIR="$SUITE_DIR/selfhost"
 BENCH_DIR="$SUITE_DIR/benchmarks"
+METAL_DIR="$SUITE_DIR/metal"
+LSP_DIR="$SUITE_DIR/lsp"
 
 export SAGE_PATH="$CORE_DIR/lib${SAGE_PATH:+:$SAGE_PATH}"
 
@@ -144,6 +146,69 @@ run_compiler() {
         fi
     }
 
+    _run_aot_test() {
+        local name="$1" sage_file="$2" expected="$3"
+        local out_bin="$TMP/aot_$name" out_file="$TMP/aot_$name.out"
+        if (cd "$CORE_DIR" && "$SAGE" --aot "$sage_file" -o "$out_bin" 2>/dev/null) && \
+           "$out_bin" > "$out_file" 2>&1 && \
+           diff -q "$expected" "$out_file" >/dev/null 2>&1; then
+            ok "AOT backend: $name"; _p=$((_p+1))
+        else
+            fail "AOT backend: $name"; _f=$((_f+1))
+        fi
+        rm -f "$out_bin.c"
+    }
+
+    # Record a profile in the interpreter, then build with --profile-use
+    _run_pgo_test() {
+        local name="$1" sage_file="$2" expected="$3" mode="$4" extra_flags="${5:-}"
+        local prof="$TMP/pgo_$name.prof" out_bin="$TMP/pgo_$name" out_file="$TMP/pgo_$name.out"
+        if (cd "$CORE_DIR" && "$SAGE" --profile-out="$prof" "$sage_file" >/dev/null 2>&1 && \
+            "$SAGE" $mode "$sage_file" -o "$out_bin" $extra_flags --profile-use="$prof" 2>/dev/null) && \
+           "$out_bin" > "$out_file" 2>&1 && \
+           diff -q "$expected" "$out_file" >/dev/null 2>&1; then
+            ok "PGO: $name"; _p=$((_p+1))
+        else
+            fail "PGO: $name"; _f=$((_f+1))
+        fi
+        rm -f "$out_bin.c"
+    }
+
+    # C harnesses linked straight against the freestanding Metal VMs
+    _run_metal_test() {
+        local name="$1" src="$2" extra_flags="${3:-}"
+        local out_bin="$TMP/metal_$name"
+        if ${CC:-cc} -std=c11 -O2 $extra_flags -I"$CORE_DIR/include" "$src" "$CORE_DIR/src/c/metal_rv64_vm.c" \
+               "$CORE_DIR/src/c/metal_vm.c" -o "$out_bin" 2>/dev/null && \
+           "$out_bin" >/dev/null 2>&1; then
+            ok "Metal VM: $name"; _p=$((_p+1))
+        else
+            fail "Metal VM: $name"; _f=$((_f+1))
+        fi
+    }
+
+    # Scripted language server sessions: each line of the .jsonl file is one
+    # JSON-RPC message. Every line of the .expected file must occur in the
+    # server's output; a line starting with '!' must not.
+    _run_lsp_test() {
+        local name="$1" session="$2" expected="$3"
+        local out_file="$TMP/lsp_$name.out" msg pattern passed=1
+        while IFS= read -r msg; do
+            printf 'Content-Length: %d\r\n\r\n%s' "$(printf '%s' "$msg" | LC_ALL=C wc -c)" "$msg"
+        done < "$session" | SAGE_LSP_DEBOUNCE_MS=0 "$SAGE" --lsp > "$out_file" 2>/dev/null || passed=0
+        while IFS= read -r pattern; do
+            case "$pattern" in
+                !*) grep -qF -- "${pattern#!}" "$out_file" && passed=0 ;;
+                *)  grep -qF -- "$pattern" "$out_file" || passed=0 ;;
+            esac
+        done < "$expected"
+        if [ "$passed" = 1 ]; then
+            ok "LSP: $name"; _p=$((_p+1))
+        else
+            fail "LSP: $name"; _f=$((_f+1))
+        fi
+    }
+
     CD="$COMPILER_DIR"
 
     # C backend tests
@@ -158,15 +223,39 @@ run_compiler() {
     _run_c_test "structs"     "$CD/compiler_structs.sage"     "$CD/compiler_structs.expected"
     _run_c_test "classes"     "$CD/compiler_classes.sage"     "$CD/compiler_classes.expected"
     _run_c_test "modules"     "$CD/compiler_modules.sage"     "$CD/compiler_modules.expected"
+    _run_c_test "units"       "$CD/compiler_units.sage"       "$CD/compiler_units.expected"
+    _run_c_test "gc_roots"    "$CD/compiler_gc_roots.sage"    "$CD/compiler_gc_roots.expected"  "-O2"
     _run_c_test "arch"        "$CD/compiler_arch.sage"        "$CD/compiler_arch.expected"
     _run_c_test "constfold"   "$CD/compiler_constfold.sage"   "$CD/compiler_constfold.expected" "-O1"
     _run_c_test "dce"         "$CD/compiler_dce.sage"         "$CD/compiler_dce.expected"       "-O2"
     _run_c_test "inline"      "$CD/compiler_inline.sage"      "$CD/compiler_inline.expected"    "-O3"
+    _run_c_test "ssa"         "$CD/compiler_ssa.sage"         "$CD/compiler_ssa.expected"       "-O2"
+    _run_c_test "loops"       "$CD/compiler_loops.sage"       "$CD/compiler_loops.expected"     "-O2"
     _run_c_test "optlevels"   "$CD/compiler_optlevels.sage"   "$CD/compiler_optlevels.expected"
 
+    # AOT backend tests
+    _run_aot_test "typed"     "$CD/compiler_aot_typed.sage"   "$CD/compiler_aot_typed.expected"
+    _run_aot_test "gc"        "$CD/compiler_aot_gc.sage"      "$CD/compiler_aot_gc.expected"
+
+    # Profile-guided builds
+    _run_pgo_test "c"         "$CD/compiler_pgo.sage"         "$CD/compiler_pgo.expected"       "--compile" "-O2"
+    _run_pgo_test "aot"       "$CD/compiler_aot_pgo.sage"     "$CD/compiler_aot_pgo.expected"   "--aot"
+
     # LLVM backend tests
     _run_llvm_test "smoke"    "$CD/compiler_smoke.sage"       "$CD/compiler_smoke.expected"
     _run_llvm_test "features" "$CD/llvm_features.sage"        "$CD/llvm_features.expected"
+    _run_llvm_test "typed"    "$CD/llvm_typed.sage"           "$CD/llvm_typed.expected"
+
+    # Metal VM harnesses
+    _run_metal_test "rv64_uop_diff"  "$METAL_DIR/rv64_uop_diff.c"
+    _run_metal_test "tables"         "$METAL_DIR/metal_vm_tables.c"
+    _run_metal_test "threaded_diff"  "$METAL_DIR/metal_vm_threaded_diff.c"
+    _run_metal_test "threaded_token" "$METAL_DIR/metal_vm_threaded_diff.c" "-DMETAL_VM_TOKEN_THREADED"
+
+    # Language server sessions (SAGE_LSP_DEBOUNCE_MS=0: diagnostics after every change)
+    _run_lsp_test "edits"       "$LSP_DIR/edits.jsonl"          "$LSP_DIR/edits.expected"
+    _run_lsp_test "reuse"       "$LSP_DIR/reuse.jsonl"          "$LSP_DIR/reuse.expected"
+    _run_lsp_test "diagnostics" "$LSP_DIR/diagnostics.jsonl"    "$LSP_DIR/diagnostics.expected"
 
     # Emit tests (no binary execution, just check output produced)
     if (cd "$CORE_DIR" && "$SAGE" --emit-llvm "$CD/compiler_smoke.sage" -o "$TMP/smoke.ll" 2>/dev/null); then